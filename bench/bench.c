@@ -0,0 +1,177 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "bench.h"
+#include "precision.h"
+#include "constants.h"
+#include "functions.h"
+#include "function_table.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+const mpfr_prec_t bench_precisions[BENCH_PRECISION_COUNT] = {53, 256, 1024, 8192};
+
+// Most iterations of one sample, so calibration cannot overflow
+#define BENCH_MAX_ITERATIONS 100000000L
+
+static double bench_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Seconds taken by iterations calls of the operation
+static double bench_time(BenchFunction function, void *state, long iterations)
+{
+    double start = bench_now();
+    for (long i = 0; i < iterations; i++)
+    {
+        function(state);
+    }
+    return bench_now() - start;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int bench_selected(const Bench *bench, const char *name)
+{
+    return !bench->filter || strstr(name, bench->filter) != NULL;
+}
+
+void bench_measure(Bench *bench, const char *name, mpfr_prec_t precision, BenchFunction function,
+                   void *state)
+{
+    if (!bench_selected(bench, name))
+    {
+        return;
+    }
+
+    // Grow the iteration count until a sample is long enough; this also
+    // warms caches and the tree's scratch values up
+    long iterations = 1;
+    for (;;)
+    {
+        double elapsed = bench_time(function, state, iterations);
+        if (elapsed >= bench->sample_seconds || iterations >= BENCH_MAX_ITERATIONS)
+        {
+            break;
+        }
+        double scale = elapsed > 0 ? 1.2 * bench->sample_seconds / elapsed : 100;
+        long next = (long)((double)iterations * (scale < 2 ? 2 : scale > 100 ? 100 : scale));
+        iterations = next > BENCH_MAX_ITERATIONS ? BENCH_MAX_ITERATIONS : next;
+    }
+
+    double *samples = malloc((size_t)bench->samples * sizeof(double));
+    if (!samples)
+    {
+        return;
+    }
+    for (int i = 0; i < bench->samples; i++)
+    {
+        samples[i] = bench_time(function, state, iterations) * 1e9 / (double)iterations;
+    }
+    qsort(samples, (size_t)bench->samples, sizeof(double), bench_compare);
+
+    fprintf(bench->out,
+            "%s    {\"name\": \"%s\", \"precision\": %ld, \"iterations\": %ld, "
+            "\"median_ns\": %.2f, \"min_ns\": %.2f, \"max_ns\": %.2f}",
+            bench->result_count ? ",\n" : "", name, (long)precision, iterations,
+            samples[bench->samples / 2], samples[0], samples[bench->samples - 1]);
+    fflush(bench->out);
+    bench->result_count++;
+    free(samples);
+}
+
+void bench_memory(Bench *bench, const char *name, mpfr_prec_t precision, size_t node_bytes,
+                  size_t literal_bytes)
+{
+    if (!bench_selected(bench, name))
+    {
+        return;
+    }
+
+    fprintf(bench->out,
+            "%s    {\"name\": \"%s\", \"precision\": %ld, \"node_bytes\": %zu, "
+            "\"literal_bytes\": %zu, \"total_bytes\": %zu}",
+            bench->result_count ? ",\n" : "", name, (long)precision, node_bytes, literal_bytes,
+            node_bytes + literal_bytes);
+    fflush(bench->out);
+    bench->result_count++;
+}
+
+static void bench_usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--filter <text>] [--samples <n>] [--quick]\n\n", program);
+    fprintf(stderr, "Writes one JSON report of every benchmark to standard output.\n");
+    fprintf(stderr, "  --filter <text>  Run only benchmarks whose name contains text\n");
+    fprintf(stderr, "  --samples <n>    Timed samples per benchmark (default 5)\n");
+    fprintf(stderr, "  --quick          Shorter samples, for smoke testing\n");
+}
+
+int main(int argc, char *argv[])
+{
+    Bench bench = {stdout, NULL, 5, 0.02, 0};
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            bench.filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+        {
+            bench.samples = atoi(argv[++i]);
+            if (bench.samples < 1)
+            {
+                fprintf(stderr, "Invalid sample count: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--quick") == 0)
+        {
+            bench.sample_seconds = 0.001;
+        }
+        else
+        {
+            bench_usage(argv[0]);
+            return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    precision_init();
+    constants_init();
+    functions_init();
+    function_table_init();
+
+    fprintf(bench.out, "{\n  \"mpfr_version\": \"%s\",\n", mpfr_get_version());
+    fprintf(bench.out, "  \"samples\": %d,\n  \"sample_seconds\": %g,\n", bench.samples,
+            bench.sample_seconds);
+    fprintf(bench.out, "  \"results\": [\n");
+
+    bench_lexer(&bench);
+    bench_parser(&bench);
+    bench_evaluator(&bench);
+    bench_constants(&bench);
+    bench_formatter(&bench);
+    bench_symbolic(&bench);
+
+    fprintf(bench.out, "\n  ]\n}\n");
+
+    formatter_cleanup();
+    evaluator_cleanup();
+    constants_cleanup();
+    functions_cleanup();
+    precision_cleanup();
+    mpfr_free_cache();
+    return ferror(bench.out) ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <mpfr.h>
+#include <stdio.h>
+
+// Precisions every precision-dependent benchmark is run at
+#define BENCH_PRECISION_COUNT 4
+extern const mpfr_prec_t bench_precisions[BENCH_PRECISION_COUNT];
+
+/**
+ * Benchmark run: settings and the JSON report being written
+ */
+typedef struct
+{
+    FILE *out;              // Report stream
+    const char *filter;     // Run only names containing this, NULL for all
+    int samples;            // Timed samples per benchmark; the median is reported
+    double sample_seconds;  // Least duration of one sample
+    int result_count;       // Results written so far
+} Bench;
+
+/**
+ * Operation being measured; called once per iteration
+ * @param state Benchmark-specific state
+ */
+typedef void (*BenchFunction)(void *state);
+
+/**
+ * Check whether a benchmark is selected by the run's filter
+ * Setting a benchmark up can be expensive, so callers check first.
+ * @param bench Benchmark run
+ * @param name Benchmark name
+ * @return 1 if the benchmark should run
+ */
+int bench_selected(const Bench *bench, const char *name);
+
+/**
+ * Time an operation and write its result to the report
+ *
+ * The iteration count is calibrated so that one sample lasts at least
+ * sample_seconds; the report holds the median, fastest and slowest sample
+ * in nanoseconds per iteration.
+ *
+ * @param bench Benchmark run
+ * @param name Benchmark name, "<stage>/<case>"
+ * @param precision Working precision the operation uses, 0 if none
+ * @param function Operation to time
+ * @param state Argument for the operation
+ */
+void bench_measure(Bench *bench, const char *name, mpfr_prec_t precision, BenchFunction function,
+                   void *state);
+
+/**
+ * Write a memory footprint to the report
+ * @param bench Benchmark run
+ * @param name Benchmark name, "<stage>/<case>"
+ * @param precision Working precision the structure was built at, 0 if none
+ * @param node_bytes Bytes of tree nodes, names and argument arrays
+ * @param literal_bytes Bytes of numeric literals and their limbs
+ */
+void bench_memory(Bench *bench, const char *name, mpfr_prec_t precision, size_t node_bytes,
+                  size_t literal_bytes);
+
+/**
+ * Benchmark the lexer: tokenizing typical input lines
+ * @param bench Benchmark run
+ */
+void bench_lexer(Bench *bench);
+
+/**
+ * Benchmark the parser: parsing typical input lines into an arena, and the
+ * arena memory one line's tree takes
+ * @param bench Benchmark run
+ */
+void bench_parser(Bench *bench);
+
+/**
+ * Benchmark the evaluator: one tree per node type, whole expressions and
+ * every function through functions_eval_ctx()
+ * @param bench Benchmark run
+ */
+void bench_evaluator(Bench *bench);
+
+/**
+ * Benchmark constant lookups, computed from scratch and from the caches
+ * @param bench Benchmark run
+ */
+void bench_constants(Bench *bench);
+
+/**
+ * Benchmark the formatter: every display mode, formatter_to_string() and
+ * binary records
+ * @param bench Benchmark run
+ */
+void bench_formatter(Bench *bench);
+
+/**
+ * Benchmark the symbolic simplifier on large generated expressions: like
+ * terms, repeated subtrees, exact trigonometric values and nested calls
+ * @param bench Benchmark run
+ */
+void bench_symbolic(Bench *bench);
+
+#endif // BENCH_H
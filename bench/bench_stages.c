@@ -0,0 +1,452 @@
+#include "bench.h"
+#include "lexer.h"
+#include "parser.h"
+#include "evaluator.h"
+#include "context.h"
+#include "variables.h"
+#include "constants.h"
+#include "functions.h"
+#include "function_table.h"
+#include "formatter.h"
+#include "binary.h"
+#include "precision.h"
+#include "symbolic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A typical input line: functions, constants, literals and operators
+static const char *bench_line = "sin(pi/4)*2.5e-3 + sqrt(16)^0.5 - log10(1000)/atan2(1, 2) + 3(x+1)";
+
+// Keeps loops whose results are not otherwise used from being removed
+static volatile long bench_sink;
+
+static void bench_name(char *name, size_t size, const char *stage, const char *item)
+{
+    snprintf(name, size, "%s/%s", stage, item);
+}
+
+// Lexer
+
+static void bench_lex_line(void *state)
+{
+    const char *line = state;
+    Lexer lexer;
+    lexer_init(&lexer, line);
+
+    long tokens = 0;
+    for (;;)
+    {
+        Token token = lexer_get_next_token(&lexer);
+        TokenType type = token.type;
+        token_free(&token);
+        if (type == TOKEN_EOF || type == TOKEN_INVALID)
+        {
+            break;
+        }
+        tokens++;
+    }
+    bench_sink = tokens;
+}
+
+void bench_lexer(Bench *bench)
+{
+    // Tokens are slices of the input, so the precision does not matter
+    bench_measure(bench, "lexer/line", 0, bench_lex_line, (void *)bench_line);
+    bench_measure(bench, "lexer/number", 0, bench_lex_line,
+                  (void *)"3.14159265358979323846264338327950288419716939937510");
+}
+
+// Parser
+
+typedef struct
+{
+    const char *line;
+    mpfr_prec_t precision;
+    ASTArena *arena;
+} BenchParse;
+
+static ASTNode *bench_parse_text(const char *text, mpfr_prec_t precision, ASTArena *arena)
+{
+    Lexer lexer;
+    lexer_init(&lexer, text);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_arena(&parser, arena);
+    parser_set_quiet(&parser, 1);
+    parser_set_precision(&parser, precision);
+
+    ASTNode *ast = parser_parse_expression(&parser);
+    if (parser_has_error(&parser) || parser.current_token.type != TOKEN_EOF)
+    {
+        ast_free(ast);
+        ast = NULL;
+    }
+    token_free(&parser.previous_token);
+    token_free(&parser.current_token);
+    return ast;
+}
+
+static void bench_parse_line(void *state)
+{
+    BenchParse *parse = state;
+    ASTNode *ast = bench_parse_text(parse->line, parse->precision, parse->arena);
+    bench_sink = ast != NULL;
+    ast_free(ast);
+    ast_arena_reset(parse->arena);
+}
+
+void bench_parser(Bench *bench)
+{
+    BenchParse parse = {bench_line, 0, ast_arena_create(0)};
+    for (int i = 0; i < BENCH_PRECISION_COUNT; i++)
+    {
+        parse.precision = bench_precisions[i];
+        bench_measure(bench, "parser/line", parse.precision, bench_parse_line, &parse);
+
+        // What the tree of one line occupies in the arena
+        ASTNode *ast = bench_parse_text(parse.line, parse.precision, parse.arena);
+        size_t literal_bytes;
+        size_t node_bytes = ast_arena_used(parse.arena, &literal_bytes);
+        ast_arena_reset(parse.arena);
+        if (ast)
+        {
+            bench_memory(bench, "parser/line_memory", parse.precision, node_bytes, literal_bytes);
+        }
+    }
+    ast_arena_destroy(parse.arena);
+}
+
+// Evaluator
+
+typedef struct
+{
+    EvalContext *ctx;
+    const ASTNode *tree;
+    mpfr_t result;
+} BenchEval;
+
+static void bench_eval_tree(void *state)
+{
+    BenchEval *eval = state;
+    evaluator_eval_ctx(eval->ctx, eval->result, eval->tree);
+}
+
+typedef struct
+{
+    EvalContext *ctx;
+    TokenType function;
+    mpfr_t args[2];
+    int arg_count;
+    mpfr_t result;
+} BenchFunctionCall;
+
+static void bench_call_function(void *state)
+{
+    BenchFunctionCall *call = state;
+    functions_eval_ctx(call->ctx, call->result, call->function, call->args, call->arg_count);
+}
+
+// One tree per node type, named by what it measures
+static const struct
+{
+    const char *name;
+    const char *text;
+    int native; // Let the hardware backends answer
+} bench_trees[] = {
+    {"number", "1.2345", 0},
+    {"constant", "pi", 0},
+    {"variable", "v", 0},
+    {"negate", "-1.2345", 0},
+    {"add", "1.2345+6.789", 0},
+    {"subtract", "1.2345-6.789", 0},
+    {"multiply", "1.2345*6.789", 0},
+    {"divide", "1.2345/6.789", 0},
+    {"power", "1.2345^6.789", 0},
+    {"compare", "1.2345<6.789", 0},
+    {"sum", "1.2345+6.789-0.25+3.5-2.125+0.0625", 0},
+    {"product", "1.2345*6.789*0.25*3.5*2.125*0.0625", 0},
+    {"expression", "sin(1.2345)*exp(-0.5) + sqrt(2)/3 - atan2(1, 2)^2", 0},
+    {"expression_native", "sin(1.2345)*exp(-0.5) + sqrt(2)/3 - atan2(1, 2)^2", 1},
+};
+
+static void bench_evaluator_at(Bench *bench, mpfr_prec_t precision, VariableTable *variables)
+{
+    char name[96];
+    EvalContext ctx;
+    eval_context_init(&ctx, precision);
+    ctx.variables = variables;
+
+    BenchEval eval = {&ctx, NULL, {{0}}};
+    mpfr_init2(eval.result, precision);
+    for (size_t i = 0; i < sizeof(bench_trees) / sizeof(bench_trees[0]); i++)
+    {
+        bench_name(name, sizeof(name), "evaluator", bench_trees[i].name);
+        if (!bench_selected(bench, name))
+        {
+            continue;
+        }
+        ASTNode *tree = bench_parse_text(bench_trees[i].text, precision, NULL);
+        if (!tree)
+        {
+            fprintf(stderr, "Cannot parse benchmark tree: %s\n", bench_trees[i].text);
+            continue;
+        }
+        ctx.native = bench_trees[i].native;
+        eval.tree = tree;
+        bench_measure(bench, name, precision, bench_eval_tree, &eval);
+        ast_free(tree);
+    }
+    mpfr_clear(eval.result);
+
+    // Every function once, skipping aliases of the same token
+    ctx.native = 0;
+    BenchFunctionCall call;
+    call.ctx = &ctx;
+    mpfr_init2(call.result, precision);
+    mpfr_init2(call.args[0], precision);
+    mpfr_init2(call.args[1], precision);
+    for (int i = 0; function_table_entry(i); i++)
+    {
+        const FunctionInfo *info = function_table_entry(i);
+        int seen = 0;
+        for (int j = 0; j < i && !seen; j++)
+        {
+            seen = function_table_entry(j)->token == info->token;
+        }
+        if (info->arg_count <= 0 || seen)
+        {
+            continue;
+        }
+
+        bench_name(name, sizeof(name), "function", info->name);
+        call.function = info->token;
+        call.arg_count = info->arg_count;
+        // Inside every function's domain
+        mpfr_set_str(call.args[0], info->token == TOKEN_ACOSH ? "1.7" : "0.7", 10, MPFR_RNDN);
+        mpfr_set_str(call.args[1], "0.3", 10, MPFR_RNDN);
+        bench_measure(bench, name, precision, bench_call_function, &call);
+    }
+    mpfr_clear(call.result);
+    mpfr_clear(call.args[0]);
+    mpfr_clear(call.args[1]);
+
+    eval_context_cleanup(&ctx);
+}
+
+void bench_evaluator(Bench *bench)
+{
+    VariableTable *variables = variables_create();
+    ASTNode *definition = bench_parse_text("1.5", 0, NULL);
+    if (!variables || !definition || variables_define(variables, "v", definition) < 0)
+    {
+        fprintf(stderr, "Cannot set up benchmark variables\n");
+        variables_destroy(variables);
+        return;
+    }
+
+    for (int i = 0; i < BENCH_PRECISION_COUNT; i++)
+    {
+        bench_evaluator_at(bench, bench_precisions[i], variables);
+    }
+    variables_destroy(variables);
+}
+
+// Constants
+
+typedef struct
+{
+    const char *name;
+    mpfr_t result;
+} BenchConstant;
+
+static void bench_constant_cold(void *state)
+{
+    BenchConstant *constant = state;
+    // Forget our caches and MPFR's own, so the value is computed again
+    constants_clear_cache();
+    mpfr_free_cache();
+    constants_get_by_name(constant->result, constant->name);
+}
+
+static void bench_constant_warm(void *state)
+{
+    BenchConstant *constant = state;
+    constants_get_by_name(constant->result, constant->name);
+}
+
+void bench_constants(Bench *bench)
+{
+    static const char *names[] = {"pi", "e", "ln2", "ln10", "gamma", "sqrt2"};
+    char name[96];
+
+    for (int i = 0; i < BENCH_PRECISION_COUNT; i++)
+    {
+        BenchConstant constant;
+        mpfr_init2(constant.result, bench_precisions[i]);
+        for (size_t j = 0; j < sizeof(names) / sizeof(names[0]); j++)
+        {
+            constant.name = names[j];
+            bench_name(name, sizeof(name), "constants/cold", names[j]);
+            bench_measure(bench, name, bench_precisions[i], bench_constant_cold, &constant);
+            bench_name(name, sizeof(name), "constants/warm", names[j]);
+            bench_measure(bench, name, bench_precisions[i], bench_constant_warm, &constant);
+        }
+        mpfr_clear(constant.result);
+    }
+    constants_clear_cache();
+}
+
+// Formatter
+
+typedef struct
+{
+    EvalContext *ctx;
+    FormatBuffer buffer;
+    mpfr_t value;
+} BenchFormat;
+
+static void bench_format_value(void *state)
+{
+    BenchFormat *format = state;
+    format_buffer_reset(&format->buffer);
+    formatter_format_value_ctx(format->ctx, &format->buffer, format->value, 0);
+}
+
+static void bench_format_to_string(void *state)
+{
+    BenchFormat *format = state;
+    char *text = formatter_to_string(format->value, FORMAT_SMART);
+    bench_sink = text != NULL;
+    free(text);
+}
+
+static void bench_format_binary(void *state)
+{
+    BenchFormat *format = state;
+    format_buffer_reset(&format->buffer);
+    binary_append_value(&format->buffer, format->value);
+}
+
+void bench_formatter(Bench *bench)
+{
+    static const struct
+    {
+        const char *name;
+        NumberFormat mode;
+    } modes[] = {{"smart", FORMAT_SMART},
+                 {"scientific", FORMAT_SCIENTIFIC},
+                 {"fixed", FORMAT_FIXED},
+                 {"auto", FORMAT_AUTO}};
+    char name[96];
+    mpfr_prec_t saved_precision = global_precision;
+
+    for (int i = 0; i < BENCH_PRECISION_COUNT; i++)
+    {
+        mpfr_prec_t precision = bench_precisions[i];
+        EvalContext ctx;
+        eval_context_init(&ctx, precision);
+        BenchFormat format;
+        format.ctx = &ctx;
+        format_buffer_init(&format.buffer);
+        mpfr_init2(format.value, precision);
+
+        // pi * 10^10 / 7: digits on both sides of the point
+        mpfr_const_pi(format.value, MPFR_RNDN);
+        mpfr_mul_ui(format.value, format.value, 10000000000UL, MPFR_RNDN);
+        mpfr_div_ui(format.value, format.value, 7, MPFR_RNDN);
+
+        for (size_t j = 0; j < sizeof(modes) / sizeof(modes[0]); j++)
+        {
+            ctx.format.mode = modes[j].mode;
+            bench_name(name, sizeof(name), "formatter", modes[j].name);
+            bench_measure(bench, name, precision, bench_format_value, &format);
+        }
+
+        // formatter_to_string() follows the global precision
+        set_precision(precision);
+        bench_measure(bench, "formatter/to_string", precision, bench_format_to_string, &format);
+        set_precision(saved_precision);
+
+        bench_measure(bench, "formatter/binary", precision, bench_format_binary, &format);
+
+        mpfr_clear(format.value);
+        format_buffer_free(&format.buffer);
+        eval_context_cleanup(&ctx);
+    }
+}
+
+// Symbolic simplification
+
+typedef struct
+{
+    const ASTNode *tree;
+} BenchSimplify;
+
+static void bench_simplify_tree(void *state)
+{
+    BenchSimplify *simplify = state;
+    ASTNode *result = symbolic_eval(simplify->tree);
+    bench_sink = result != NULL;
+    ast_free(result);
+}
+
+// Chain count parsed copies of a term into one long sum; the term's %d
+// runs over 1..7. Input lines are too short to hold such sums.
+static ASTNode *bench_sum(const char *term, int count)
+{
+    ASTNode *sum = NULL;
+    char text[128];
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(text, sizeof(text), term, i % 7 + 1);
+        ASTNode *next = bench_parse_text(text, 0, NULL);
+        if (!next)
+        {
+            ast_free(sum);
+            return NULL;
+        }
+        sum = sum ? ast_create_binop(TOKEN_PLUS, sum, next) : next;
+        if (!sum)
+        {
+            return NULL;
+        }
+    }
+    return sum;
+}
+
+void bench_symbolic(Bench *bench)
+{
+    static const struct
+    {
+        const char *name;
+        const char *term;
+        int count;
+    } cases[] = {
+        // Like terms and rational coefficients to collect
+        {"sum", "x/%d", 400},
+        // The same subtree again and again: one simplification, many table hits
+        {"repeated", "sin(x + 0)*cos(pi/3)*%d", 400},
+        // Exact trigonometric values and radicals
+        {"trig", "sin(%d*pi/6)*sqrt(8)", 200},
+        // Nested calls that peel off one by one
+        {"nested", "log(exp(abs(abs(y^1*%d))))", 200},
+    };
+    char name[96];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        ASTNode *tree = bench_sum(cases[i].term, cases[i].count);
+        if (!tree)
+        {
+            fprintf(stderr, "Cannot build symbolic benchmark %s\n", cases[i].name);
+            continue;
+        }
+
+        // Rules work on the tree's structure, so the precision does not matter
+        BenchSimplify simplify = {tree};
+        bench_name(name, sizeof(name), "symbolic", cases[i].name);
+        bench_measure(bench, name, 0, bench_simplify_tree, &simplify);
+        ast_free(tree);
+    }
+}
@@ -0,0 +1,200 @@
+#ifndef CALC_H
+#define CALC_H
+
+#include <mpfr.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Embedding API of the calculator engine (libcalc)
+ *
+ * Expressions are compiled once into a CalcExpression and evaluated any
+ * number of times in a CalcContext, which holds the precision and the
+ * variable bindings. The library writes nothing to standard output and
+ * does not depend on the REPL or readline.
+ *
+ * A compiled expression is never changed by evaluation, so one expression
+ * can be evaluated in several contexts at once, on different threads. A
+ * context must be used by one thread at a time.
+ */
+
+// Compiled expression (opaque)
+typedef struct CalcExpression CalcExpression;
+
+// Precision and variable bindings for evaluations (opaque)
+typedef struct CalcContext CalcContext;
+
+/**
+ * Initialize the engine
+ * Call once, before any other function and before starting threads that
+ * use the library.
+ * @return 0 on success
+ */
+int calc_init(void);
+
+/**
+ * Release the engine's caches
+ * Contexts and expressions must have been freed first.
+ */
+void calc_cleanup(void);
+
+/**
+ * Native function that expressions can call
+ * @param result Output variable, at the precision to round to
+ * @param args Argument values
+ * @param rounding Rounding mode
+ * @param data Pointer given at registration
+ * @return Ternary value, as for MPFR functions
+ */
+typedef int (*CalcFunction)(mpfr_ptr result, mpfr_t args[], mpfr_rnd_t rounding, void *data);
+
+/**
+ * Domain of a native function
+ * @param args Argument values
+ * @param data Pointer given at registration
+ * @return 1 if the function is defined there, 0 for a domain error
+ */
+typedef int (*CalcDomain)(mpfr_t args[], void *data);
+
+/**
+ * Register a native function for expressions compiled afterwards to call
+ * The function should round correctly, as MPFR's functions do. It is
+ * called with arguments at a few bits more than the working precision, and
+ * only by the MPFR evaluator: expressions calling it give up the hardware
+ * backends. Call before starting threads that use the library; functions
+ * stay registered until calc_cleanup().
+ * @param name Function name, an identifier that is not already taken
+ * @param arg_count Number of arguments, 1 or 2
+ * @param function Function computing the value
+ * @param domain Domain check, or NULL if defined for every argument
+ * @param data Passed to function and domain
+ * @return 0 on success, -1 on error (see calc_get_error())
+ */
+int calc_register_function(const char *name, int arg_count, CalcFunction function,
+                           CalcDomain domain, void *data);
+
+/**
+ * Compile an expression
+ * Literals are read at the given precision, so it should be the highest
+ * precision the expression will be evaluated at; repeated subexpressions
+ * are merged so that each is evaluated once.
+ * @param expression Expression text, such as "sin(x)^2 + 1/3"
+ * @param precision Precision literals are read at, in bits
+ * @return Compiled expression, or NULL on error (see calc_get_error())
+ */
+CalcExpression *calc_compile(const char *expression, mpfr_prec_t precision);
+
+/**
+ * Free a compiled expression
+ * @param expression Expression to free, may be NULL
+ */
+void calc_free(CalcExpression *expression);
+
+/**
+ * Create an evaluation context with no variables bound
+ * @param precision Working precision in bits (clamped to the valid range)
+ * @return New context, or NULL on error (see calc_get_error())
+ */
+CalcContext *calc_context_create(mpfr_prec_t precision);
+
+/**
+ * Free a context and its bindings
+ * @param ctx Context to free, may be NULL
+ */
+void calc_context_destroy(CalcContext *ctx);
+
+/**
+ * Set the working precision of a context
+ * @param ctx Context to change
+ * @param precision Precision in bits (clamped to the valid range)
+ */
+void calc_context_set_precision(CalcContext *ctx, mpfr_prec_t precision);
+
+/**
+ * Get the working precision of a context
+ * @param ctx Context to inspect
+ * @return Precision in bits
+ */
+mpfr_prec_t calc_context_get_precision(const CalcContext *ctx);
+
+/**
+ * Bind a variable to a value
+ * @param ctx Context to change
+ * @param name Variable name
+ * @param value Value, copied at its own precision
+ * @return 0 on success, -1 on error (see calc_context_get_error())
+ */
+int calc_bind(CalcContext *ctx, const char *name, mpfr_srcptr value);
+
+/**
+ * Bind a variable to a double
+ * @param ctx Context to change
+ * @param name Variable name
+ * @param value Value
+ * @return 0 on success, -1 on error (see calc_context_get_error())
+ */
+int calc_bind_d(CalcContext *ctx, const char *name, double value);
+
+/**
+ * Bind a variable to an expression
+ * The variable is computed from the expression when it is read, and
+ * follows changes to the variables the expression reads.
+ * @param ctx Context to change
+ * @param name Variable name
+ * @param definition Expression defining the variable (copied)
+ * @return 0 on success, -1 on error such as a circular definition
+ *         (see calc_context_get_error())
+ */
+int calc_define(CalcContext *ctx, const char *name, const CalcExpression *definition);
+
+/**
+ * Evaluate an expression
+ * The result is rounded to the precision of out.
+ * @param expression Compiled expression
+ * @param ctx Context supplying the precision and variables
+ * @param out Initialized output variable
+ * @return 0 on success, -1 on error (see calc_context_get_error())
+ */
+int calc_eval(const CalcExpression *expression, CalcContext *ctx, mpfr_ptr out);
+
+/**
+ * Evaluate an expression at many values of one variable
+ *
+ * Equivalent to binding the variable to each input in turn and calling
+ * calc_eval(), but at low precision whole runs of inputs go through the
+ * hardware batch backend together, falling back to MPFR only for the
+ * inputs it cannot guarantee. The variable is left bound to the last
+ * input.
+ *
+ * @param expression Compiled expression
+ * @param ctx Context supplying the precision and other variables
+ * @param variable Name the inputs are bound to
+ * @param inputs Values of the variable
+ * @param outputs Initialized output variables; failed points are set to NaN
+ * @param count Number of inputs and outputs
+ * @return Number of points that failed; the context's error is that of the last one
+ */
+size_t calc_eval_batch(const CalcExpression *expression, CalcContext *ctx, const char *variable,
+                       mpfr_t *inputs, mpfr_t *outputs, size_t count);
+
+/**
+ * Get the last error of a context
+ * @param ctx Context to inspect
+ * @return Error message, or NULL if the last call succeeded
+ */
+const char *calc_context_get_error(const CalcContext *ctx);
+
+/**
+ * Get the last compile or creation error of the calling thread
+ * @return Error message, empty if none
+ */
+const char *calc_get_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CALC_H
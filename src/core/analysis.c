@@ -0,0 +1,489 @@
+#include "analysis.h"
+#include "evaluator.h"
+#include "functions.h"
+#include "interval.h"
+#include "variables.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fixed cost of one MPFR operation in ns: the call, the special value
+// checks and the rounding
+#define ANALYSIS_BASE_NS 15.0
+
+// Cost of one limb product in ns
+#define ANALYSIS_LIMB_NS 0.5
+
+// Fixed cost of an elementary function in ns, on top of its multiplications
+#define ANALYSIS_FUNCTION_NS 400.0
+
+// Multiplications an elementary function takes per bit of precision's log
+#define ANALYSIS_FUNCTION_MULS 4.0
+
+// Most arguments a function takes
+#define ANALYSIS_MAX_ARGS 2
+
+// Points an integral typically takes, for its cost
+#define ANALYSIS_QUADRATURE_POINTS 500
+
+// Time of one operation at a working precision
+static double analysis_step_cost(TokenType op, mpfr_prec_t precision)
+{
+    double limbs = (double)precision / mp_bits_per_limb + 1;
+    // GMP leaves schoolbook multiplication after a few dozen limbs; the
+    // Karatsuba exponent is close enough over the range that matters
+    double mul = ANALYSIS_LIMB_NS * pow(limbs, 1.585);
+
+    switch (op)
+    {
+    case TOKEN_PLUS:
+    case TOKEN_MINUS:
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+    case TOKEN_LT:
+    case TOKEN_LTE:
+    case TOKEN_GT:
+    case TOKEN_GTE:
+    case TOKEN_ABS:
+    case TOKEN_FLOOR:
+    case TOKEN_CEIL:
+        return ANALYSIS_BASE_NS + ANALYSIS_LIMB_NS * limbs;
+    case TOKEN_STAR:
+        return ANALYSIS_BASE_NS + mul;
+    case TOKEN_SLASH:
+    case TOKEN_SQRT:
+        return ANALYSIS_BASE_NS + 2 * mul;
+    default:
+        // Elementary functions and general powers
+        return ANALYSIS_FUNCTION_NS + ANALYSIS_FUNCTION_MULS * mul * log2((double)precision);
+    }
+}
+
+static double analysis_tree_cost(const EvalContext *ctx, const ASTNode *node,
+                                 mpfr_prec_t precision);
+
+// Time of a sum() or integrate(): the body once per point. Sums between
+// literal bounds know their length; other sums count as one term.
+static double analysis_reduction_cost(const EvalContext *ctx, const ASTNode *node,
+                                      mpfr_prec_t precision)
+{
+    const ASTNode *from = node->function.args[2];
+    const ASTNode *to = node->function.args[3];
+    double points = ANALYSIS_QUADRATURE_POINTS;
+    if (node->function.func_type == TOKEN_SUM)
+    {
+        points = 1;
+        if (from->type == NODE_NUMBER && to->type == NODE_NUMBER &&
+            !from->number.literal->folded_from && !to->number.literal->folded_from)
+        {
+            double count = mpfr_get_d(to->number.literal->value, MPFR_RNDN) -
+                           mpfr_get_d(from->number.literal->value, MPFR_RNDN) + 1;
+            points = count > 1 ? count : 1;
+        }
+    }
+    return points * analysis_tree_cost(ctx, node->function.args[0], precision) +
+           analysis_tree_cost(ctx, from, precision) + analysis_tree_cost(ctx, to, precision);
+}
+
+static double analysis_tree_cost(const EvalContext *ctx, const ASTNode *node,
+                                 mpfr_prec_t precision)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    double cost = 0;
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        // Only a value folded at another precision is computed again
+        if (node->number.literal->folded_from &&
+            node->number.literal->folded_precision != ctx->precision)
+        {
+            cost = analysis_tree_cost(ctx, node->number.literal->folded_from, precision);
+        }
+        break;
+    case NODE_BINOP:
+        cost = analysis_step_cost(node->binop.op, precision) +
+               analysis_tree_cost(ctx, node->binop.left, precision) +
+               analysis_tree_cost(ctx, node->binop.right, precision);
+        break;
+    case NODE_UNARY:
+        cost = analysis_step_cost(TOKEN_MINUS, precision) +
+               analysis_tree_cost(ctx, node->unary.operand, precision);
+        break;
+    case NODE_NARY:
+        cost = (node->nary.count - 1) * analysis_step_cost(node->nary.op, precision);
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            cost += analysis_tree_cost(ctx, node->nary.operands[i], precision);
+        }
+        break;
+    case NODE_FUNCTION:
+        if (token_binds_variable(node->function.func_type))
+        {
+            cost = analysis_reduction_cost(ctx, node, precision);
+            break;
+        }
+        cost = analysis_step_cost(node->function.func_type, precision);
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            cost += analysis_tree_cost(ctx, node->function.args[i], precision);
+        }
+        break;
+    default:
+        // Constants and variables are cached
+        break;
+    }
+    return cost;
+}
+
+double analysis_estimate_cost(const EvalContext *ctx, const ASTNode *node)
+{
+    // Interval mode computes two bounds with extra work at the signs;
+    // adaptive mode usually settles in its first or second pass
+    if (ctx->interval)
+    {
+        return 3 * analysis_tree_cost(ctx, node, ctx->precision + EVALUATOR_INTERVAL_GUARD);
+    }
+    if (ctx->adaptive)
+    {
+        return 2 * analysis_tree_cost(ctx, node, ctx->precision + EVALUATOR_ADAPTIVE_GUARD);
+    }
+    return analysis_tree_cost(ctx, node, ctx->precision + BINOP_PRECISION_BOOST);
+}
+
+// Range of a shared subexpression, kept so a shared node is walked once
+typedef struct
+{
+    const ASTNode *node; // Node the range belongs to, NULL if none yet
+    Interval range;
+} AnalysisShared;
+
+typedef struct
+{
+    EvalContext *ctx;
+    Analysis *analysis;
+    AnalysisShared *shared; // Indexed by share slot
+    int shared_capacity;
+} AnalysisWalk;
+
+static void analysis_node(AnalysisWalk *walk, Interval *range, const ASTNode *node, int counted);
+
+// Keep the first failure's message, as evaluation reports the first error
+static void analysis_fail(AnalysisWalk *walk, const char *message)
+{
+    if (!walk->analysis->message[0])
+    {
+        snprintf(walk->analysis->message, sizeof(walk->analysis->message), "%s", message);
+    }
+}
+
+// Exponent magnitude every value of a range exceeds or reaches. The
+// evaluator's values may differ from the true ones in the last place,
+// which can move them across a power of two, so one is taken off.
+static long analysis_certain_exponent(const Interval *range)
+{
+    if (mpfr_nan_p(range->lo) || mpfr_nan_p(range->hi) || interval_contains_zero(range))
+    {
+        return 0;
+    }
+
+    // Magnitudes lie between the bound nearest zero and the farthest
+    mpfr_srcptr nearest = mpfr_sgn(range->lo) > 0 ? range->lo : range->hi;
+    mpfr_srcptr farthest = mpfr_sgn(range->lo) > 0 ? range->hi : range->lo;
+    if (!mpfr_regular_p(nearest))
+    {
+        // Overflows to infinity, which the exponent limit does not see
+        return 0;
+    }
+
+    long exponent = 0;
+    if (mpfr_get_exp(nearest) > 0)
+    {
+        exponent = (long)mpfr_get_exp(nearest);
+    }
+    else if (mpfr_regular_p(farthest) && mpfr_get_exp(farthest) < 0)
+    {
+        exponent = -(long)mpfr_get_exp(farthest);
+    }
+    return exponent > 0 ? exponent - 1 : 0;
+}
+
+static void analysis_binop(AnalysisWalk *walk, Interval *range, const ASTNode *node, int counted)
+{
+    Interval left, right;
+    interval_init2(&left, ANALYSIS_PRECISION);
+    interval_init2(&right, ANALYSIS_PRECISION);
+    analysis_node(walk, &left, node->binop.left, counted);
+    analysis_node(walk, &right, node->binop.right, counted);
+
+    switch (node->binop.op)
+    {
+    case TOKEN_PLUS:
+        interval_add(range, &left, &right);
+        break;
+    case TOKEN_MINUS:
+        interval_sub(range, &left, &right);
+        break;
+    case TOKEN_STAR:
+        interval_mul(range, &left, &right);
+        break;
+    case TOKEN_SLASH:
+        if (interval_is_point(&right) && mpfr_zero_p(right.lo))
+        {
+            if (counted)
+            {
+                walk->analysis->division_by_zero = 1;
+                analysis_fail(walk, "Division by zero");
+            }
+            interval_set_nan(range);
+        }
+        else
+        {
+            interval_div(range, &left, &right);
+        }
+        break;
+    case TOKEN_CARET:
+        interval_pow(range, &left, &right);
+        break;
+    default:
+        // Comparisons are 0 or 1
+        mpfr_set_zero(range->lo, 1);
+        mpfr_set_ui(range->hi, 1, MPFR_RNDN);
+        break;
+    }
+
+    interval_clear(&right);
+    interval_clear(&left);
+}
+
+static void analysis_nary(AnalysisWalk *walk, Interval *range, const ASTNode *node, int counted)
+{
+    Interval operand;
+    interval_init2(&operand, ANALYSIS_PRECISION);
+
+    analysis_node(walk, range, node->nary.operands[0], counted);
+    for (int i = 1; i < node->nary.count; i++)
+    {
+        analysis_node(walk, &operand, node->nary.operands[i], counted);
+        if (node->nary.op == TOKEN_PLUS)
+        {
+            interval_add(range, range, &operand);
+        }
+        else
+        {
+            interval_mul(range, range, &operand);
+        }
+    }
+
+    interval_clear(&operand);
+}
+
+static void analysis_function(AnalysisWalk *walk, Interval *range, const ASTNode *node,
+                              int counted)
+{
+    int count = node->function.arg_count;
+    if (token_binds_variable(node->function.func_type))
+    {
+        // The body is read at points the walk does not know; only the
+        // bounds are checked
+        for (int i = 2; i < count; i++)
+        {
+            Interval bound;
+            interval_init2(&bound, ANALYSIS_PRECISION);
+            analysis_node(walk, &bound, node->function.args[i], counted);
+            interval_clear(&bound);
+        }
+        interval_set_nan(range);
+        return;
+    }
+    if (count > ANALYSIS_MAX_ARGS)
+    {
+        interval_set_nan(range);
+        return;
+    }
+
+    Interval args[ANALYSIS_MAX_ARGS];
+    int unknown = 0; // Some argument is not a real number at all
+    for (int i = 0; i < count; i++)
+    {
+        interval_init2(&args[i], ANALYSIS_PRECISION);
+        analysis_node(walk, &args[i], node->function.args[i], counted);
+        unknown |= mpfr_nan_p(args[i].lo) || mpfr_nan_p(args[i].hi);
+    }
+
+    // The interval version fails exactly where the whole argument lies
+    // outside the domain, with the error the point evaluation gives
+    EvalContext *ctx = walk->ctx;
+    char function_error[EVAL_CONTEXT_ERROR_SIZE];
+    memcpy(function_error, ctx->function_error, sizeof(function_error));
+    const FunctionDef *def = node->function.def;
+    if (unknown || (def && !def->interval))
+    {
+        // Registered functions have no interval version to give a range
+        interval_set_nan(range);
+    }
+    else if (!functions_eval_interval(ctx, range, node->function.func_type, args, count))
+    {
+        if (counted)
+        {
+            walk->analysis->domain_error = 1;
+            analysis_fail(walk, ctx->function_error);
+        }
+        interval_set_nan(range);
+    }
+    memcpy(ctx->function_error, function_error, sizeof(function_error));
+
+    for (int i = 0; i < count; i++)
+    {
+        interval_clear(&args[i]);
+    }
+}
+
+// Find the slot for a shared node, growing the table as needed
+static AnalysisShared *analysis_shared(AnalysisWalk *walk, int slot)
+{
+    if (slot >= walk->shared_capacity)
+    {
+        int capacity = walk->shared_capacity ? walk->shared_capacity : 16;
+        while (capacity <= slot)
+        {
+            capacity *= 2;
+        }
+        AnalysisShared *shared = realloc(walk->shared, (size_t)capacity * sizeof(AnalysisShared));
+        if (!shared)
+        {
+            return NULL;
+        }
+        for (int i = walk->shared_capacity; i < capacity; i++)
+        {
+            shared[i].node = NULL;
+            interval_init2(&shared[i].range, ANALYSIS_PRECISION);
+        }
+        walk->shared = shared;
+        walk->shared_capacity = capacity;
+    }
+    return &walk->shared[slot];
+}
+
+// Range a node's values lie in. Operations, exponents and failures only
+// count where counted is set: nodes the MPFR pass certainly evaluates,
+// rather than definitions whose values may be cached.
+static void analysis_node(AnalysisWalk *walk, Interval *range, const ASTNode *node, int counted)
+{
+    if (!node)
+    {
+        mpfr_set_zero(range->lo, 1);
+        mpfr_set_zero(range->hi, 1);
+        return;
+    }
+
+    // A shared subexpression is evaluated once per pass
+    AnalysisShared *shared = node->share >= 0 ? analysis_shared(walk, node->share) : NULL;
+    if (shared && shared->node == node)
+    {
+        interval_set(range, &shared->range);
+        return;
+    }
+
+    EvalContext *ctx = walk->ctx;
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (node->number.literal->folded_from &&
+            node->number.literal->folded_precision != ctx->precision)
+        {
+            analysis_node(walk, range, node->number.literal->folded_from, counted);
+            break;
+        }
+        interval_set_fr(range, node->number.literal->value);
+        if (!node->exact)
+        {
+            interval_widen(range);
+        }
+        break;
+
+    case NODE_CONSTANT:
+        if (!interval_set_constant(range, node->constant.id))
+        {
+            interval_set_nan(range);
+        }
+        break;
+
+    case NODE_VARIABLE:
+    {
+        Variable *var = ctx->variables ? variables_find(ctx->variables, node->variable.name) : NULL;
+        if (var && var->definition)
+        {
+            analysis_node(walk, range, var->definition, 0);
+        }
+        else
+        {
+            interval_set_nan(range);
+        }
+        break;
+    }
+
+    case NODE_BINOP:
+        analysis_binop(walk, range, node, counted);
+        break;
+
+    case NODE_UNARY:
+        analysis_node(walk, range, node->unary.operand, counted);
+        if (node->unary.op == TOKEN_MINUS)
+        {
+            interval_neg(range, range);
+        }
+        break;
+
+    case NODE_NARY:
+        analysis_nary(walk, range, node, counted);
+        break;
+
+    case NODE_FUNCTION:
+        analysis_function(walk, range, node, counted);
+        break;
+
+    default:
+        interval_set_nan(range);
+        break;
+    }
+
+    if (counted && (node->type == NODE_BINOP || node->type == NODE_UNARY ||
+                    node->type == NODE_NARY || node->type == NODE_FUNCTION))
+    {
+        Analysis *analysis = walk->analysis;
+        analysis->operations += node->type == NODE_NARY ? node->nary.count - 1 : 1;
+        long exponent = analysis_certain_exponent(range);
+        if (exponent > analysis->exponent)
+        {
+            analysis->exponent = exponent;
+        }
+    }
+    if (shared)
+    {
+        shared->node = node;
+        interval_set(&shared->range, range);
+    }
+}
+
+void analysis_run(EvalContext *ctx, const ASTNode *node, Analysis *analysis)
+{
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->cost = analysis_estimate_cost(ctx, node);
+
+    AnalysisWalk walk = {ctx, analysis, NULL, 0};
+    Interval range;
+    interval_init2(&range, ANALYSIS_PRECISION);
+    analysis_node(&walk, &range, node, 1);
+    interval_clear(&range);
+
+    for (int i = 0; i < walk.shared_capacity; i++)
+    {
+        interval_clear(&walk.shared[i].range);
+    }
+    free(walk.shared);
+}
@@ -0,0 +1,52 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "ast.h"
+#include "context.h"
+#include <mpfr.h>
+
+// Precision of the value ranges the analysis propagates
+#define ANALYSIS_PRECISION 53
+
+/**
+ * What a tree certainly does when evaluated, found without evaluating it
+ *
+ * Ranges are propagated with interval arithmetic, so every conclusion holds
+ * for the values MPFR computes. Variables are ranged by their definitions
+ * but, being usually cached, add no operations or errors of their own.
+ */
+typedef struct
+{
+    double cost;          // Estimated evaluation time in ns (see analysis_estimate_cost())
+    long operations;      // Operations an MPFR pass performs at least
+    long exponent;        // Binary exponent magnitude some value exceeds or reaches, 0 if none
+    int division_by_zero; // A divisor is exactly zero
+    int domain_error;     // A function argument lies wholly outside its domain
+    char message[EVAL_CONTEXT_ERROR_SIZE]; // Error of the first failure found, empty if none
+} Analysis;
+
+/**
+ * Estimate how long an MPFR evaluation of a tree takes
+ *
+ * A model, not a measurement: every operation costs a fixed overhead plus
+ * multiplications of the working precision's limbs, and elementary
+ * functions a number of multiplications that grows with the precision.
+ * Shared subexpressions count at every occurrence. Cheap enough to run on
+ * every line a scheduler hands out.
+ *
+ * @param ctx Context whose precision and mode apply
+ * @param node Tree to estimate
+ * @return Estimated time in ns
+ */
+double analysis_estimate_cost(const EvalContext *ctx, const ASTNode *node);
+
+/**
+ * Propagate value ranges through a tree and collect what is certain
+ * ctx's error slots are left as they were.
+ * @param ctx Context whose precision, constants and variables apply
+ * @param node Tree to analyze
+ * @param analysis Output findings
+ */
+void analysis_run(EvalContext *ctx, const ASTNode *node, Analysis *analysis);
+
+#endif // ANALYSIS_H
@@ -0,0 +1,284 @@
+#include "calc.h"
+#include "constants.h"
+#include "context.h"
+#include "evaluator.h"
+#include "function_registry.h"
+#include "function_table.h"
+#include "functions.h"
+#include "lexer.h"
+#include "native.h"
+#include "parser.h"
+#include "precision.h"
+#include "variables.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Arena block size of one compiled expression; most fit in one block
+#define CALC_ARENA_BLOCK_SIZE 2048
+
+static _Thread_local char calc_error[256];
+
+struct CalcExpression
+{
+    ASTArena *arena; // Owns the tree and its literals
+    ASTNode *tree;
+};
+
+struct CalcContext
+{
+    EvalContext eval;
+    VariableTable *variables;
+};
+
+int calc_init(void)
+{
+    precision_init();
+    constants_init();
+    functions_init();
+    function_table_init();
+    return 0;
+}
+
+void calc_cleanup(void)
+{
+    evaluator_cleanup();
+    constants_cleanup();
+    functions_cleanup();
+    function_registry_cleanup();
+    precision_cleanup();
+}
+
+int calc_register_function(const char *name, int arg_count, CalcFunction function,
+                           CalcDomain domain, void *data)
+{
+    if (function_registry_add(name, arg_count, function, domain, data) == TOKEN_INVALID)
+    {
+        snprintf(calc_error, sizeof(calc_error), "%s", function_registry_get_error());
+        return -1;
+    }
+    calc_error[0] = '\0';
+    return 0;
+}
+
+// Parse a whole expression into an arena; sets calc_error on failure
+static ASTNode *calc_parse(const char *expression, mpfr_prec_t precision, ASTArena *arena)
+{
+    Lexer lexer;
+    lexer_init(&lexer, expression);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_arena(&parser, arena);
+    parser_set_quiet(&parser, 1);
+    parser_set_precision(&parser, precision);
+    ASTNode *tree = parser_parse_expression(&parser);
+
+    if (!tree || parser_has_error(&parser))
+    {
+        const char *message = parser_get_error_message(&parser);
+        snprintf(calc_error, sizeof(calc_error), "%s", message ? message : "Parse error");
+        tree = NULL;
+    }
+    else if (parser.current_token.type == TOKEN_INVALID)
+    {
+        snprintf(calc_error, sizeof(calc_error), "Invalid token encountered");
+        tree = NULL;
+    }
+    else if (parser.current_token.type != TOKEN_EOF)
+    {
+        snprintf(calc_error, sizeof(calc_error), "Unexpected token at end: %s",
+                 token_type_str(parser.current_token.type));
+        tree = NULL;
+    }
+
+    token_free(&parser.previous_token);
+    token_free(&parser.current_token);
+    return tree;
+}
+
+CalcExpression *calc_compile(const char *expression, mpfr_prec_t precision)
+{
+    calc_error[0] = '\0';
+    if (!expression)
+    {
+        snprintf(calc_error, sizeof(calc_error), "No expression");
+        return NULL;
+    }
+
+    CalcExpression *compiled = malloc(sizeof(CalcExpression));
+    ASTArena *arena = ast_arena_create(CALC_ARENA_BLOCK_SIZE);
+    if (!compiled || !arena)
+    {
+        snprintf(calc_error, sizeof(calc_error), "Out of memory");
+        free(compiled);
+        ast_arena_destroy(arena);
+        return NULL;
+    }
+
+    if (precision < MIN_PRECISION)
+    {
+        precision = MIN_PRECISION;
+    }
+    else if (precision > precision_max())
+    {
+        precision = precision_max();
+    }
+
+    // The parser merges repeated subexpressions as it goes
+    compiled->arena = arena;
+    compiled->tree = calc_parse(expression, precision, arena);
+    if (!compiled->tree)
+    {
+        calc_free(compiled);
+        return NULL;
+    }
+    return compiled;
+}
+
+void calc_free(CalcExpression *expression)
+{
+    if (!expression)
+    {
+        return;
+    }
+    ast_arena_destroy(expression->arena);
+    free(expression);
+}
+
+CalcContext *calc_context_create(mpfr_prec_t precision)
+{
+    calc_error[0] = '\0';
+    CalcContext *ctx = malloc(sizeof(CalcContext));
+    VariableTable *variables = variables_create();
+    if (!ctx || !variables)
+    {
+        snprintf(calc_error, sizeof(calc_error), "Out of memory");
+        free(ctx);
+        variables_destroy(variables);
+        return NULL;
+    }
+
+    eval_context_init(&ctx->eval, precision);
+    ctx->variables = variables;
+    ctx->eval.variables = variables;
+    return ctx;
+}
+
+void calc_context_destroy(CalcContext *ctx)
+{
+    if (!ctx)
+    {
+        return;
+    }
+    eval_context_cleanup(&ctx->eval);
+    variables_destroy(ctx->variables);
+    free(ctx);
+}
+
+void calc_context_set_precision(CalcContext *ctx, mpfr_prec_t precision)
+{
+    eval_context_set_precision(&ctx->eval, precision);
+}
+
+mpfr_prec_t calc_context_get_precision(const CalcContext *ctx)
+{
+    return ctx->eval.precision;
+}
+
+// Report a failed binding through the context's error slot
+static int calc_binding_result(CalcContext *ctx, int index)
+{
+    if (index < 0)
+    {
+        snprintf(ctx->eval.error, sizeof(ctx->eval.error), "%s",
+                 variables_get_error(ctx->variables));
+        return -1;
+    }
+    eval_context_clear_error(&ctx->eval);
+    return 0;
+}
+
+int calc_bind(CalcContext *ctx, const char *name, mpfr_srcptr value)
+{
+    return calc_binding_result(ctx, variables_set_value(ctx->variables, name, value));
+}
+
+int calc_bind_d(CalcContext *ctx, const char *name, double value)
+{
+    mpfr_t number;
+    mpfr_init2(number, 53);
+    mpfr_set_d(number, value, MPFR_RNDN);
+    int status = calc_bind(ctx, name, number);
+    mpfr_clear(number);
+    return status;
+}
+
+int calc_define(CalcContext *ctx, const char *name, const CalcExpression *definition)
+{
+    // The table keeps the definition, so it is copied out of the arena
+    ASTNode *tree = ast_clone(definition->tree);
+    if (!tree)
+    {
+        snprintf(ctx->eval.error, sizeof(ctx->eval.error), "Out of memory");
+        return -1;
+    }
+    return calc_binding_result(ctx, variables_define(ctx->variables, name, tree));
+}
+
+int calc_eval(const CalcExpression *expression, CalcContext *ctx, mpfr_ptr out)
+{
+    evaluator_eval_ctx(&ctx->eval, out, expression->tree);
+    return eval_context_get_error(&ctx->eval) ? -1 : 0;
+}
+
+size_t calc_eval_batch(const CalcExpression *expression, CalcContext *ctx, const char *variable,
+                       mpfr_t *inputs, mpfr_t *outputs, size_t count)
+{
+    unsigned char accepted[NATIVE_BATCH_SIZE];
+    char error[EVAL_CONTEXT_ERROR_SIZE] = "";
+    size_t failures = 0;
+
+    for (size_t start = 0; start < count; start += NATIVE_BATCH_SIZE)
+    {
+        int batch = count - start < NATIVE_BATCH_SIZE ? (int)(count - start) : NATIVE_BATCH_SIZE;
+        if (!ctx->eval.native ||
+            !native_eval_batch(&ctx->eval, expression->tree, variable, inputs + start, batch,
+                               outputs + start, accepted))
+        {
+            memset(accepted, 0, sizeof(accepted));
+        }
+
+        // Points the hardware declined are evaluated one by one
+        for (int i = 0; i < batch; i++)
+        {
+            if (accepted[i])
+            {
+                continue;
+            }
+            if (calc_bind(ctx, variable, inputs[start + i]) < 0 ||
+                calc_eval(expression, ctx, outputs[start + i]) < 0)
+            {
+                snprintf(error, sizeof(error), "%s", ctx->eval.error);
+                mpfr_set_nan(outputs[start + i]);
+                failures++;
+            }
+        }
+    }
+
+    if (count > 0)
+    {
+        variables_set_value(ctx->variables, variable, inputs[count - 1]);
+    }
+    snprintf(ctx->eval.error, sizeof(ctx->eval.error), "%s", error);
+    return failures;
+}
+
+const char *calc_context_get_error(const CalcContext *ctx)
+{
+    return eval_context_get_error(&ctx->eval);
+}
+
+const char *calc_get_error(void)
+{
+    return calc_error;
+}
@@ -0,0 +1,639 @@
+#include "compiler.h"
+#include "context.h"
+#include "evaluator.h"
+#include "precision.h"
+#include "profile.h"
+#include "constants.h"
+#include "functions.h"
+#include "multidouble.h"
+#include "rational.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// All tree levels share one working precision, so one register file
+// can serve binary, unary and function nodes alike
+_Static_assert(BINOP_PRECISION_BOOST == UNARY_PRECISION_BOOST &&
+                   BINOP_PRECISION_BOOST == FUNCTION_ARG_PRECISION_BOOST,
+               "compiler assumes a uniform precision boost");
+
+// A register loaded before the program runs: a literal or constant node,
+// an exact subtree with its value already rounded, or the input (no node)
+typedef struct
+{
+    const ASTNode *node;
+    mpfr_ptr value; // Value of an exact subtree, NULL otherwise
+} PinnedValue;
+
+// Compilation state. Scratch registers are handed out as a stack so that
+// function arguments end up in consecutive registers; pinned registers
+// are encoded as negative indices until the final register layout is
+// known.
+typedef struct
+{
+    EvalContext *ctx;
+    const char *input;
+    int input_pin;
+    mpq_t exact;
+    int exact_declined; // An enclosing exact subtree was declined, as in the evaluator
+    mpfr_prec_t working_precision;
+    Instruction *code;
+    int code_length;
+    int code_capacity;
+    PinnedValue *pinned;
+    int pinned_count;
+    int pinned_capacity;
+    int sp;
+    int max_sp;
+    int failed;
+} Compiler;
+
+static int compile_node(Compiler *c, const ASTNode *node);
+
+static void emit(Compiler *c, OpCode opcode, TokenType op, const FunctionDef *def, int dst, int a,
+                 int b)
+{
+    if (c->failed)
+    {
+        return;
+    }
+
+    if (c->code_length == c->code_capacity)
+    {
+        int new_capacity = c->code_capacity ? c->code_capacity * 2 : 16;
+        Instruction *new_code = realloc(c->code, new_capacity * sizeof(Instruction));
+        if (!new_code)
+        {
+            c->failed = 1;
+            return;
+        }
+        c->code = new_code;
+        c->code_capacity = new_capacity;
+    }
+
+    c->code[c->code_length++] = (Instruction){opcode, op, def, dst, a, b};
+}
+
+static int push_temp(Compiler *c)
+{
+    int reg = c->sp++;
+    if (c->sp > c->max_sp)
+    {
+        c->max_sp = c->sp;
+    }
+    return reg;
+}
+
+static void free_value(mpfr_ptr value)
+{
+    if (value)
+    {
+        mpfr_clear(value);
+        free(value);
+    }
+}
+
+// Pin a register; the compiler takes over value even on failure
+static int pin(Compiler *c, const ASTNode *node, mpfr_ptr value)
+{
+    if (c->pinned_count == c->pinned_capacity)
+    {
+        int new_capacity = c->pinned_capacity ? c->pinned_capacity * 2 : 8;
+        PinnedValue *new_pinned = realloc(c->pinned, new_capacity * sizeof(PinnedValue));
+        if (!new_pinned)
+        {
+            free_value(value);
+            c->failed = 1;
+            return 0;
+        }
+        c->pinned = new_pinned;
+        c->pinned_capacity = new_capacity;
+    }
+
+    c->pinned[c->pinned_count] = (PinnedValue){node, value};
+    return -(++c->pinned_count);
+}
+
+// Compute an exact subtree now and pin its value, rounded as the exact
+// tier would round it into an operand. 0 if the tier declines it.
+static int pin_exact(Compiler *c, const ASTNode *node)
+{
+    int negative_zero;
+    if (!rational_eval_signed(c->exact, &negative_zero, node, c->ctx->rounding))
+    {
+        return 0;
+    }
+
+    mpfr_ptr value = malloc(sizeof(*value));
+    if (!value)
+    {
+        c->failed = 1;
+        return 0;
+    }
+    mpfr_init2(value, c->working_precision);
+    mpfr_set_q(value, c->exact, c->ctx->rounding);
+    if (negative_zero && mpfr_zero_p(value))
+    {
+        mpfr_neg(value, value, MPFR_RNDN);
+    }
+    return pin(c, node, value);
+}
+
+// A folded value computed for another precision than the context's
+static int compiler_stale_fold(const Compiler *c, const ASTNode *node)
+{
+    return node->type == NODE_NUMBER && node->number.literal->folded_from &&
+           node->number.literal->folded_precision != c->ctx->precision;
+}
+
+// Whether the evaluator's exact tier takes a subtree (see exact_candidate())
+static int compiler_exact_candidate(const EvalContext *ctx, const ASTNode *node)
+{
+    return ctx->exact && node->exact && node->type != NODE_NUMBER;
+}
+
+static int compile_node(Compiler *c, const ASTNode *node)
+{
+    if (c->failed)
+    {
+        return 0;
+    }
+
+    if (!node)
+    {
+        c->failed = 1;
+        return 0;
+    }
+
+    int base = c->sp;
+    int reg = 0;
+    int declined = 0;
+    if (!c->exact_declined && compiler_exact_candidate(c->ctx, node))
+    {
+        reg = pin_exact(c, node);
+        if (reg || c->failed)
+        {
+            return reg;
+        }
+        c->exact_declined = declined = 1;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (compiler_stale_fold(c, node))
+        {
+            reg = compile_node(c, node->number.literal->folded_from);
+        }
+        else
+        {
+            reg = pin(c, node, NULL);
+        }
+        break;
+
+    case NODE_CONSTANT:
+        reg = pin(c, node, NULL);
+        break;
+
+    case NODE_VARIABLE:
+        // Other variables are left to the evaluator, which looks them up
+        if (!c->input || strcmp(node->variable.name, c->input) != 0)
+        {
+            c->failed = 1;
+            break;
+        }
+        if (!c->input_pin)
+        {
+            c->input_pin = pin(c, NULL, NULL);
+        }
+        reg = c->input_pin;
+        break;
+
+    case NODE_BINOP:
+    {
+        int a = compile_node(c, node->binop.left);
+        int b = compile_node(c, node->binop.right);
+        c->sp = base;
+        reg = push_temp(c);
+        emit(c, OP_BINOP, node->binop.op, NULL, reg, a, b);
+        break;
+    }
+
+    case NODE_UNARY:
+    {
+        int a = compile_node(c, node->unary.operand);
+        c->sp = base;
+        reg = push_temp(c);
+        emit(c, OP_UNARY, node->unary.op, NULL, reg, a, 0);
+        break;
+    }
+
+    case NODE_FUNCTION:
+    {
+        // Bound variables need the evaluator's reductions
+        if (!node->function.def || token_binds_variable(node->function.func_type))
+        {
+            c->failed = 1;
+            break;
+        }
+
+        // functions_call() expects its arguments as a contiguous array
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            c->sp = base + i;
+            int arg = compile_node(c, node->function.args[i]);
+            c->sp = base + i;
+            int slot = push_temp(c);
+            if (arg != slot)
+            {
+                emit(c, OP_MOVE, TOKEN_INVALID, NULL, slot, arg, 0);
+            }
+        }
+        c->sp = base;
+        reg = push_temp(c);
+        emit(c, OP_CALL, node->function.func_type, node->function.def, reg, base,
+             node->function.arg_count);
+        break;
+    }
+
+    case NODE_NARY:
+    {
+        // Sums and products also take their operands as an array. The
+        // result goes above them, as mpfr_sum() cannot write over a term.
+        int count = node->nary.count;
+        for (int i = 0; i < count; i++)
+        {
+            c->sp = base + i;
+            int operand = compile_node(c, node->nary.operands[i]);
+            c->sp = base + i;
+            int slot = push_temp(c);
+            if (operand != slot)
+            {
+                emit(c, OP_MOVE, TOKEN_INVALID, NULL, slot, operand, 0);
+            }
+        }
+        c->sp = base + count;
+        reg = push_temp(c);
+        emit(c, node->nary.op == TOKEN_PLUS ? OP_SUM : OP_PRODUCT, node->nary.op, NULL, reg,
+             base, count);
+        break;
+    }
+
+    default:
+        c->failed = 1;
+    }
+
+    if (declined)
+    {
+        c->exact_declined = 0;
+    }
+    return reg;
+}
+
+// Map a compile-time register index onto the final register layout
+static int resolve_register(int reg, int temp_count)
+{
+    return reg < 0 ? temp_count + (-reg - 1) : reg;
+}
+
+static int load_pinned(EvalContext *ctx, mpfr_t reg, const PinnedValue *pinned)
+{
+    const ASTNode *node = pinned->node;
+    if (pinned->value)
+    {
+        mpfr_swap(reg, pinned->value);
+        return 1;
+    }
+    if (!node)
+    {
+        return 1;
+    }
+    if (node->type == NODE_NUMBER)
+    {
+        mpfr_set(reg, node->number.literal->value, ctx->rounding);
+        return 1;
+    }
+    return constants_get_by_type_ctx(ctx, reg, node->constant.id) ||
+           constants_get_by_name_ctx(ctx, reg, node->constant.name);
+}
+
+// Settings under which the evaluator does more than the plain tree walk a
+// program replays. The hardware backends answer some points at the
+// precisions they serve with values the walk would round differently.
+static int compiler_declines_context(const EvalContext *ctx)
+{
+    return ctx->interval || ctx->adaptive || ctx->progress || ctx->budget.seconds > 0 ||
+           ctx->budget.max_operations || ctx->budget.max_exponent ||
+           ctx->precision > MAX_PRECISION ||
+           (ctx->native && ctx->precision <= MULTIDOUBLE_QD_MAX_PRECISION);
+}
+
+static void compiler_discard(Compiler *c)
+{
+    for (int i = 0; i < c->pinned_count; i++)
+    {
+        free_value(c->pinned[i].value);
+    }
+    free(c->pinned);
+    free(c->code);
+}
+
+CompiledProgram *compiler_compile(EvalContext *ctx, const ASTNode *node, const char *input)
+{
+    if (!node || compiler_declines_context(ctx))
+    {
+        return NULL;
+    }
+
+    Compiler c = {0};
+    c.ctx = ctx;
+    c.input = input;
+    c.working_precision = ctx->precision + BINOP_PRECISION_BOOST;
+
+    // A stale fold at the root compiles as the subtree it replaced
+    while (compiler_stale_fold(&c, node))
+    {
+        node = node->number.literal->folded_from;
+    }
+
+    // A tree the exact tier computes whole is rounded once into the
+    // result, with no program to replay
+    if (compiler_exact_candidate(ctx, node))
+    {
+        return NULL;
+    }
+
+    mpq_init(c.exact);
+    int result = compile_node(&c, node);
+    mpq_clear(c.exact);
+
+    CompiledProgram *program = NULL;
+    if (c.failed || !(program = calloc(1, sizeof(CompiledProgram))))
+    {
+        compiler_discard(&c);
+        return NULL;
+    }
+
+    program->code = c.code;
+    program->code_length = c.code_length;
+    program->temp_count = c.max_sp;
+    program->register_count = c.max_sp + c.pinned_count;
+    program->result_register = resolve_register(result, c.max_sp);
+    program->input_register = c.input_pin ? resolve_register(c.input_pin, c.max_sp) : -1;
+    program->root_type = node->type;
+    program->precision = ctx->precision;
+    program->working_precision = c.working_precision;
+    program->rounding = ctx->rounding;
+    program->exact = ctx->exact;
+    c.code = NULL;
+
+    for (int i = 0; i < program->code_length; i++)
+    {
+        Instruction *ins = &program->code[i];
+        ins->dst = resolve_register(ins->dst, c.max_sp);
+        ins->a = resolve_register(ins->a, c.max_sp);
+        if (ins->opcode == OP_BINOP)
+        {
+            ins->b = resolve_register(ins->b, c.max_sp);
+        }
+    }
+
+    if (node->type == NODE_CONSTANT)
+    {
+        // A lone constant is rounded straight to the caller's precision
+        program->root_constant = strdup(node->constant.name);
+        program->root_constant_id = node->constant.id;
+        if (!program->root_constant)
+        {
+            compiler_discard(&c);
+            compiler_free(program);
+            return NULL;
+        }
+    }
+
+    program->registers = malloc((program->register_count ? program->register_count : 1) *
+                                sizeof(mpfr_t));
+    program->operands = malloc((program->register_count ? program->register_count : 1) *
+                               sizeof(mpfr_ptr));
+    if (!program->registers || !program->operands)
+    {
+        compiler_discard(&c);
+        compiler_free(program);
+        return NULL;
+    }
+
+    for (int i = 0; i < program->register_count; i++)
+    {
+        mpfr_init2(program->registers[i], program->working_precision);
+        program->operands[i] = program->registers[i];
+    }
+    PROFILE_COUNT(PROFILE_MPFR_TEMPS, (unsigned long)program->register_count);
+
+    if (node->type == NODE_NUMBER)
+    {
+        // A lone literal is copied exactly so it is rounded only once
+        mpfr_set_prec(program->registers[program->result_register],
+                      mpfr_get_prec(node->number.literal->value));
+    }
+
+    int loaded = 1;
+    for (int i = 0; i < c.pinned_count && loaded; i++)
+    {
+        loaded = load_pinned(ctx, program->registers[c.max_sp + i], &c.pinned[i]);
+    }
+    compiler_discard(&c);
+
+    if (!loaded)
+    {
+        compiler_free(program);
+        return NULL;
+    }
+
+    return program;
+}
+
+static void run_binop(EvalContext *ctx, mpfr_t dst, TokenType op, mpfr_t left, mpfr_t right)
+{
+    mpfr_rnd_t rounding = ctx->rounding;
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        mpfr_add(dst, left, right, rounding);
+        break;
+    case TOKEN_MINUS:
+        mpfr_sub(dst, left, right, rounding);
+        break;
+    case TOKEN_STAR:
+        functions_mul(dst, left, right, rounding);
+        break;
+    case TOKEN_SLASH:
+        if (mpfr_zero_p(right))
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Division by zero");
+            mpfr_set_d(dst, 0.0, rounding);
+        }
+        else
+        {
+            functions_div(dst, left, right, rounding);
+        }
+        break;
+    case TOKEN_CARET:
+        functions_pow(dst, left, right, rounding);
+        break;
+    case TOKEN_EQ:
+        mpfr_set_d(dst, mpfr_equal_p(left, right) ? 1.0 : 0.0, rounding);
+        break;
+    case TOKEN_NEQ:
+        mpfr_set_d(dst, !mpfr_equal_p(left, right) ? 1.0 : 0.0, rounding);
+        break;
+    case TOKEN_LT:
+        mpfr_set_d(dst, mpfr_less_p(left, right) ? 1.0 : 0.0, rounding);
+        break;
+    case TOKEN_LTE:
+        mpfr_set_d(dst, mpfr_lessequal_p(left, right) ? 1.0 : 0.0, rounding);
+        break;
+    case TOKEN_GT:
+        mpfr_set_d(dst, mpfr_greater_p(left, right) ? 1.0 : 0.0, rounding);
+        break;
+    case TOKEN_GTE:
+        mpfr_set_d(dst, mpfr_greaterequal_p(left, right) ? 1.0 : 0.0, rounding);
+        break;
+    default:
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown binary operator");
+        mpfr_set_d(dst, 0.0, rounding);
+    }
+}
+
+void compiler_run(EvalContext *ctx, mpfr_t result, CompiledProgram *program, mpfr_srcptr input)
+{
+    // A run stands for a whole evaluation, so it leaves the context as one
+    eval_context_clear_error(ctx);
+    ctx->function_error[0] = '\0';
+    ctx->exact_integer = 0;
+    ctx->interval_valid = 0;
+    ctx->adaptive_passes = 0;
+
+    if (!compiler_is_current(program, ctx) || (program->input_register >= 0 && !input))
+    {
+        snprintf(ctx->error, sizeof(ctx->error),
+                 program ? "Program was compiled for other settings" : "No program to run");
+        mpfr_set_d(result, 0.0, ctx->rounding);
+        return;
+    }
+    if (evaluator_cancel_requested(ctx))
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Evaluation interrupted");
+        mpfr_set_nan(result);
+        return;
+    }
+
+    mpfr_t *regs = program->registers;
+    if (program->input_register >= 0)
+    {
+        mpfr_set(regs[program->input_register], input, ctx->rounding);
+    }
+
+    for (int i = 0; i < program->code_length; i++)
+    {
+        const Instruction *ins = &program->code[i];
+
+        switch (ins->opcode)
+        {
+        case OP_BINOP:
+            run_binop(ctx, regs[ins->dst], ins->op, regs[ins->a], regs[ins->b]);
+            break;
+
+        case OP_UNARY:
+            if (ins->op == TOKEN_PLUS)
+            {
+                mpfr_set(regs[ins->dst], regs[ins->a], ctx->rounding);
+            }
+            else if (ins->op == TOKEN_MINUS)
+            {
+                mpfr_neg(regs[ins->dst], regs[ins->a], ctx->rounding);
+            }
+            else
+            {
+                snprintf(ctx->error, sizeof(ctx->error), "Unknown unary operator");
+                mpfr_set_d(regs[ins->dst], 0.0, ctx->rounding);
+            }
+            break;
+
+        case OP_MOVE:
+            mpfr_set(regs[ins->dst], regs[ins->a], ctx->rounding);
+            break;
+
+        case OP_CALL:
+        {
+            int success = functions_call(ctx, regs[ins->dst], ins->def, &regs[ins->a]);
+            if (!success && ctx->strict_mode)
+            {
+                snprintf(ctx->error, sizeof(ctx->error), "Function evaluation failed: %.200s",
+                         ctx->function_error);
+            }
+            // The root call is flushed after rounding to the caller's precision
+            if (i != program->code_length - 1 || program->root_type != NODE_FUNCTION)
+            {
+                evaluator_flush_tiny(regs[ins->dst], program->precision);
+            }
+            break;
+        }
+
+        case OP_SUM:
+            mpfr_sum(regs[ins->dst], program->operands + ins->a, (unsigned long)ins->b,
+                     ctx->rounding);
+            break;
+
+        case OP_PRODUCT:
+            functions_product(regs[ins->dst], program->operands + ins->a, ins->b,
+                              ctx->rounding);
+            break;
+        }
+    }
+
+    if (program->root_constant)
+    {
+        if (!constants_get_by_type_ctx(ctx, result, program->root_constant_id) &&
+            !constants_get_by_name_ctx(ctx, result, program->root_constant))
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Unknown constant: %s",
+                     program->root_constant);
+            mpfr_set_d(result, 0.0, ctx->rounding);
+        }
+        return;
+    }
+
+    mpfr_set(result, regs[program->result_register], ctx->rounding);
+    if (program->root_type == NODE_FUNCTION)
+    {
+        evaluator_flush_tiny(result, program->precision);
+    }
+}
+
+int compiler_is_current(const CompiledProgram *program, const EvalContext *ctx)
+{
+    return program && program->precision == ctx->precision &&
+           program->rounding == ctx->rounding && program->exact == ctx->exact &&
+           !compiler_declines_context(ctx);
+}
+
+void compiler_free(CompiledProgram *program)
+{
+    if (!program)
+    {
+        return;
+    }
+
+    if (program->registers)
+    {
+        for (int i = 0; i < program->register_count; i++)
+        {
+            mpfr_clear(program->registers[i]);
+        }
+        free(program->registers);
+    }
+    free(program->operands);
+    free(program->root_constant);
+    free(program->code);
+    free(program);
+}
@@ -0,0 +1,108 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "ast.h"
+#include "function_registry.h"
+#include "tokens.h"
+#include <mpfr.h>
+
+typedef struct EvalContext EvalContext;
+
+/**
+ * Bytecode instruction opcodes
+ */
+typedef enum
+{
+    OP_BINOP,   // dst = a <op> b
+    OP_UNARY,   // dst = <op> a
+    OP_MOVE,    // dst = a (used to place function arguments contiguously)
+    OP_CALL,    // dst = func(a, a + 1, ...)
+    OP_SUM,     // dst = a + (a + 1) + ... with b terms, rounded once
+    OP_PRODUCT  // dst = a * (a + 1) * ... with b factors; overwrites them
+} OpCode;
+
+/**
+ * Single bytecode instruction operating on the register file
+ */
+typedef struct
+{
+    OpCode opcode;
+    TokenType op;           // Operator or function token
+    const FunctionDef *def; // Function called by OP_CALL, NULL otherwise
+    int dst;                // Destination register
+    int a;                  // First operand register (first argument for OP_CALL)
+    int b;                  // Second operand register (count for OP_CALL, OP_SUM, OP_PRODUCT)
+} Instruction;
+
+/**
+ * A flattened AST ready for repeated evaluation.
+ *
+ * Registers [0, temp_count) are scratch registers reused between
+ * instructions; the remaining registers hold literals, constants and
+ * exact subtrees that are loaded once at compile time, and the input,
+ * which every run loads. All registers share the program's working
+ * precision, so running the program does no MPFR allocation.
+ */
+typedef struct
+{
+    Instruction *code;
+    int code_length;
+    mpfr_t *registers;
+    mpfr_ptr *operands; // registers[i] as pointers, the array mpfr_sum() takes
+    int register_count;
+    int temp_count;
+    int result_register;
+    int input_register;            // Register the input is loaded into, -1 if unused
+    NodeType root_type;            // Root node type (controls final rounding)
+    char *root_constant;           // Constant name when the root is a constant
+    ConstantType root_constant_id; // Constant named by root_constant
+    mpfr_prec_t precision;         // User precision the program was compiled for
+    mpfr_prec_t working_precision; // Precision of the register file
+    mpfr_rnd_t rounding;           // Rounding mode the program was compiled for
+    int exact;                     // Exact subtrees were computed at compile time
+} CompiledProgram;
+
+/**
+ * Compile an AST into a bytecode program for a context's settings
+ *
+ * A program replays the plain tree walk of evaluator_eval_ctx(), so trees
+ * and settings for which the evaluator does more are declined: variables
+ * other than the input, sum() and integrate(), a tree the exact tier
+ * computes whole, and contexts with interval or adaptive evaluation, a
+ * budget, progress reports, a precision above MAX_PRECISION, or the
+ * hardware backends at a precision they serve.
+ *
+ * @param ctx Context supplying precision, rounding and evaluator flags
+ * @param node AST to compile (not retained after compilation)
+ * @param input Name of the variable whose value every run supplies, or NULL
+ * @return New program, or NULL if declined or out of memory
+ */
+CompiledProgram *compiler_compile(EvalContext *ctx, const ASTNode *node, const char *input);
+
+/**
+ * Run a compiled program and store the result
+ * Produces the same value and error as evaluator_eval_ctx() on the source
+ * AST with the input variable set to the given value. Errors go to the
+ * context (see eval_context_get_error()).
+ * @param ctx Context the program was compiled for
+ * @param result Output variable for result, at the context's precision
+ * @param program Program to run
+ * @param input Value of the input variable, or NULL if the program has none
+ */
+void compiler_run(EvalContext *ctx, mpfr_t result, CompiledProgram *program, mpfr_srcptr input);
+
+/**
+ * Check whether a program still matches a context's settings
+ * @param program Program to check
+ * @param ctx Context to check against
+ * @return 1 if the program can run in the context, 0 otherwise
+ */
+int compiler_is_current(const CompiledProgram *program, const EvalContext *ctx);
+
+/**
+ * Free a compiled program and its register file
+ * @param program Program to free
+ */
+void compiler_free(CompiledProgram *program);
+
+#endif // COMPILER_H
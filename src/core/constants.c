@@ -1,5 +1,10 @@
 #include "constants.h"
+#include "context.h"
 #include "precision.h"
+#include "profile.h"
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
@@ -31,30 +36,27 @@ static const ConstantMetadata constant_metadata[CONST_COUNT] = {
     [CONST_SQRT2] = {"sqrt2", compute_sqrt2}
 };
 
-// Array-based storage indexed by ConstantType
-static CachedConstant cached_constants[CONST_COUNT] = {0};
+// Highest-precision value computed so far for each constant, shared by all
+// threads. Contexts keep a copy of it so most lookups take no lock.
+static CachedConstant shared_constants[CONST_COUNT];
+static pthread_mutex_t shared_constants_lock[CONST_COUNT];
+static pthread_once_t shared_constants_once = PTHREAD_ONCE_INIT;
 
-void constants_init(void)
+// Precomputed values from a constants table, or NULL. Set once at startup
+// before any worker thread runs, and read-only afterwards.
+static const CachedConstant *stored_constants = NULL;
+
+static void shared_constants_init_locks(void)
 {
-    // Initialize all constants in the array
     for (int i = 0; i < CONST_COUNT; i++)
     {
-        cached_constants[i].is_initialized = 0;
+        pthread_mutex_init(&shared_constants_lock[i], NULL);
     }
 }
 
-static void ensure_constant_precision(CachedConstant *constant)
+void constants_init(void)
 {
-    if (!constant->is_initialized || constant->precision != global_precision)
-    {
-        if (constant->is_initialized)
-        {
-            mpfr_clear(constant->value);
-        }
-        mpfr_init2(constant->value, global_precision);
-        constant->is_initialized = 1;
-    }
-    constant->precision = global_precision;
+    constants_clear_cache();
 }
 
 // Compute functions for each constant
@@ -98,60 +100,146 @@ static void compute_sqrt2(mpfr_t result, mpfr_prec_t prec, mpfr_rnd_t rnd)
     mpfr_sqrt_ui(result, 2, rnd);
 }
 
-// Extra precision bits to add for more accurate constant computation
-#define CONSTANT_PRECISION_BOOST 128
+// Bits computed beyond a request, so nearby requests round from the same value
+#define CONSTANT_GUARD_BITS 64
+
+// Round a cached value into result when that gives the correctly rounded
+// constant at the result's precision. Cached values are correctly rounded
+// to nearest, so their error is below one ulp of the cached precision.
+static int constant_round_from(const CachedConstant *constant, mpfr_t result, mpfr_rnd_t rnd)
+{
+    mpfr_prec_t prec = mpfr_get_prec(result);
+    if (!constant->is_initialized || constant->precision < prec)
+    {
+        return 0;
+    }
+    if (!(constant->precision == prec && rnd == MPFR_RNDN) &&
+        !mpfr_can_round(constant->value, constant->precision, MPFR_RNDN, rnd,
+                        prec + (rnd == MPFR_RNDN)))
+    {
+        return 0;
+    }
+
+    mpfr_set(result, constant->value, rnd);
+    return 1;
+}
+
+static void cached_copy(CachedConstant *dst, const CachedConstant *src)
+{
+    if (dst->is_initialized)
+    {
+        mpfr_set_prec(dst->value, src->precision);
+    }
+    else
+    {
+        mpfr_init2(dst->value, src->precision);
+        dst->is_initialized = 1;
+    }
+    mpfr_set(dst->value, src->value, MPFR_RNDN);
+    dst->precision = src->precision;
+}
+
+// Compute a constant to nearest until it can be rounded to the result
+static void shared_compute(ConstantType type, CachedConstant *shared, mpfr_t result, mpfr_rnd_t rnd)
+{
+    mpfr_prec_t target = mpfr_get_prec(result) + CONSTANT_GUARD_BITS;
+    if (shared->is_initialized && target < shared->precision + shared->precision / 2)
+    {
+        // Grow geometrically so slowly rising precisions don't recompute every step
+        target = shared->precision + shared->precision / 2;
+    }
+
+    for (;;)
+    {
+        if (shared->is_initialized)
+        {
+            mpfr_set_prec(shared->value, target);
+        }
+        else
+        {
+            mpfr_init2(shared->value, target);
+            shared->is_initialized = 1;
+        }
+        constant_metadata[type].compute_fn(shared->value, target, MPFR_RNDN);
+        shared->precision = target;
+
+        if (constant_round_from(shared, result, rnd))
+        {
+            return;
+        }
+        target += target / 2;
+    }
+}
 
 // Generic getter function using enum
-static void constants_get_by_type(mpfr_t result, ConstantType type)
+static void constants_get_by_type(EvalContext *ctx, mpfr_t result, ConstantType type)
 {
     if (type < 0 || type >= CONST_COUNT)
     {
         return;
     }
 
-    // Compute constant at higher precision for better accuracy
-    mpfr_prec_t high_prec = global_precision + CONSTANT_PRECISION_BOOST;
-    mpfr_t high_precision_value;
-    mpfr_init2(high_precision_value, high_prec);
-
-    // Compute the constant at high precision
-    constant_metadata[type].compute_fn(high_precision_value, high_prec, global_rounding);
+    // Served by rounding whenever this context has seen a higher precision
+    CachedConstant *local = &ctx->constants[type];
+    if (constant_round_from(local, result, ctx->rounding))
+    {
+        PROFILE_COUNT(PROFILE_CONSTANT_HITS, 1);
+        return;
+    }
 
-    // Round down to the user's requested precision
-    mpfr_set(result, high_precision_value, global_rounding);
+    // Stored values never change, so they need no lock
+    if (stored_constants && constant_round_from(&stored_constants[type], result, ctx->rounding))
+    {
+        PROFILE_COUNT(PROFILE_CONSTANT_HITS, 1);
+        cached_copy(local, &stored_constants[type]);
+        return;
+    }
 
-    mpfr_clear(high_precision_value);
+    pthread_once(&shared_constants_once, shared_constants_init_locks);
+    pthread_mutex_lock(&shared_constants_lock[type]);
+    CachedConstant *shared = &shared_constants[type];
+    if (constant_round_from(shared, result, ctx->rounding))
+    {
+        PROFILE_COUNT(PROFILE_CONSTANT_HITS, 1);
+    }
+    else
+    {
+        PROFILE_COUNT(PROFILE_CONSTANT_MISSES, 1);
+        shared_compute(type, shared, result, ctx->rounding);
+    }
+    cached_copy(local, shared);
+    pthread_mutex_unlock(&shared_constants_lock[type]);
 }
 
 // Convenience functions for specific constants
 void constants_get_pi(mpfr_t result)
 {
-    constants_get_by_type(result, CONST_PI);
+    constants_get_by_type(eval_context_default(), result, CONST_PI);
 }
 
 void constants_get_e(mpfr_t result)
 {
-    constants_get_by_type(result, CONST_E);
+    constants_get_by_type(eval_context_default(), result, CONST_E);
 }
 
 void constants_get_ln2(mpfr_t result)
 {
-    constants_get_by_type(result, CONST_LN2);
+    constants_get_by_type(eval_context_default(), result, CONST_LN2);
 }
 
 void constants_get_ln10(mpfr_t result)
 {
-    constants_get_by_type(result, CONST_LN10);
+    constants_get_by_type(eval_context_default(), result, CONST_LN10);
 }
 
 void constants_get_gamma(mpfr_t result)
 {
-    constants_get_by_type(result, CONST_GAMMA);
+    constants_get_by_type(eval_context_default(), result, CONST_GAMMA);
 }
 
 void constants_get_sqrt2(mpfr_t result)
 {
-    constants_get_by_type(result, CONST_SQRT2);
+    constants_get_by_type(eval_context_default(), result, CONST_SQRT2);
 }
 
 int constants_is_cached_by_type(ConstantType type)
@@ -161,8 +249,18 @@ int constants_is_cached_by_type(ConstantType type)
         return 0;
     }
 
-    CachedConstant *constant = &cached_constants[type];
-    return constant->is_initialized && constant->precision == global_precision;
+    // Cached when a request at the current precision needs no computation
+    pthread_once(&shared_constants_once, shared_constants_init_locks);
+    pthread_mutex_lock(&shared_constants_lock[type]);
+    const CachedConstant *constant = &shared_constants[type];
+    int cached = constant->is_initialized &&
+                 constant->precision >= global_precision;
+    pthread_mutex_unlock(&shared_constants_lock[type]);
+    if (stored_constants && stored_constants[type].precision >= global_precision)
+    {
+        cached = 1;
+    }
+    return cached;
 }
 
 int constants_is_cached(const char *constant_name)
@@ -185,6 +283,11 @@ int constants_is_cached(const char *constant_name)
 }
 
 int constants_get_by_name(mpfr_t result, const char *constant_name)
+{
+    return constants_get_by_name_ctx(eval_context_default(), result, constant_name);
+}
+
+int constants_get_by_name_ctx(EvalContext *ctx, mpfr_t result, const char *constant_name)
 {
     if (!constant_name)
     {
@@ -197,7 +300,7 @@ int constants_get_by_name(mpfr_t result, const char *constant_name)
         if (strcasecmp(constant_metadata[i].name, constant_name) == 0)
         {
             // Found it! Use the internal getter
-            constants_get_by_type(result, i);
+            constants_get_by_type(ctx, result, i);
             return 1;
         }
     }
@@ -206,6 +309,96 @@ int constants_get_by_name(mpfr_t result, const char *constant_name)
     return 0;
 }
 
+int constants_get_by_type_ctx(EvalContext *ctx, mpfr_t result, ConstantType type)
+{
+    if (type < 0 || type >= CONST_COUNT)
+    {
+        return 0;
+    }
+    constants_get_by_type(ctx, result, type);
+    return 1;
+}
+
+int constants_get_long_double(const char *constant_name, long double *value)
+{
+    // The long double values never change, so each thread computes them once
+    static _Thread_local long double values[CONST_COUNT];
+    static _Thread_local unsigned char ready[CONST_COUNT];
+
+    if (!constant_name)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < CONST_COUNT; i++)
+    {
+        if (strcasecmp(constant_metadata[i].name, constant_name) == 0)
+        {
+            if (!ready[i])
+            {
+                mpfr_t exact;
+                mpfr_init2(exact, LDBL_MANT_DIG);
+                constant_metadata[i].compute_fn(exact, LDBL_MANT_DIG, MPFR_RNDN);
+                values[i] = mpfr_get_ld(exact, MPFR_RNDN);
+                mpfr_clear(exact);
+                ready[i] = 1;
+            }
+            *value = values[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int constants_get_double_terms(const char *constant_name, double *terms, double *error)
+{
+    // Like the long double values, computed once per thread
+    static _Thread_local double values[CONST_COUNT][CONSTANT_DOUBLE_TERMS];
+    static _Thread_local double errors[CONST_COUNT];
+    static _Thread_local unsigned char ready[CONST_COUNT];
+
+    if (!constant_name)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < CONST_COUNT; i++)
+    {
+        if (strcasecmp(constant_metadata[i].name, constant_name) == 0)
+        {
+            if (!ready[i])
+            {
+                // Peel off one double at a time; each subtraction is exact
+                const mpfr_prec_t prec = CONSTANT_DOUBLE_TERMS * DBL_MANT_DIG + 64;
+                mpfr_t rest;
+                mpfr_init2(rest, prec);
+                constant_metadata[i].compute_fn(rest, prec, MPFR_RNDN);
+                double ulp = mpfr_get_d(rest, MPFR_RNDU) * ldexp(1.0, 1 - (int)prec);
+                for (int j = 0; j < CONSTANT_DOUBLE_TERMS; j++)
+                {
+                    values[i][j] = mpfr_get_d(rest, MPFR_RNDN);
+                    mpfr_sub_d(rest, rest, values[i][j], MPFR_RNDN);
+                }
+                mpfr_abs(rest, rest, MPFR_RNDN);
+                errors[i] = mpfr_get_d(rest, MPFR_RNDU) + ulp;
+                mpfr_clear(rest);
+                ready[i] = 1;
+            }
+            memcpy(terms, values[i], sizeof(values[i]));
+            *error = errors[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void constants_set_stored(const CachedConstant *stored)
+{
+    stored_constants = stored;
+}
+
 void clear_cached(CachedConstant *constant)
 {
     if (constant->is_initialized)
@@ -217,9 +410,15 @@ void clear_cached(CachedConstant *constant)
 
 void constants_clear_cache(void)
 {
+    EvalContext *ctx = eval_context_default();
+    pthread_once(&shared_constants_once, shared_constants_init_locks);
     for (int i = 0; i < CONST_COUNT; i++)
     {
-        clear_cached(&cached_constants[i]);
+        clear_cached(&ctx->constants[i]);
+
+        pthread_mutex_lock(&shared_constants_lock[i]);
+        clear_cached(&shared_constants[i]);
+        pthread_mutex_unlock(&shared_constants_lock[i]);
     }
 }
 
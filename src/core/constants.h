@@ -19,6 +19,8 @@ typedef enum
 
 /**
  * Cached constant with precision tracking
+ * The value is the constant correctly rounded to nearest at the cached
+ * precision; any lower precision is served from it by rounding.
  */
 typedef struct
 {
@@ -27,6 +29,8 @@ typedef struct
     int is_initialized;     // Whether mpfr_t is initialized
 } CachedConstant;
 
+typedef struct EvalContext EvalContext;
+
 /**
  * Initialize constants system
  */
@@ -69,14 +73,14 @@ void constants_get_gamma(mpfr_t result);
 void constants_get_sqrt2(mpfr_t result);
 
 /**
- * Check if a constant value has been computed for current precision (enum-based)
+ * Check if a constant is available at the current precision without computing it (enum-based)
  * @param type Type of the constant
  * @return 1 if cached, 0 if needs recomputation
  */
 int constants_is_cached_by_type(ConstantType type);
 
 /**
- * Check if a constant value has been computed for current precision (string-based)
+ * Check if a constant is available at the current precision without computing it (string-based)
  * @param constant_name Name of the constant
  * @return 1 if cached, 0 if needs recomputation
  */
@@ -90,6 +94,58 @@ int constants_is_cached(const char *constant_name);
  */
 int constants_get_by_name(mpfr_t result, const char *constant_name);
 
+/**
+ * Get a constant by name, correctly rounded to the result's precision
+ * Values are cached at the highest precision requested so far, per context
+ * and process-wide, and lower precisions are derived by rounding.
+ * @param ctx Context supplying the rounding mode and its constant cache
+ * @param result Output variable for the constant value (its precision is used)
+ * @param constant_name Name of the constant (e.g., "pi", "e", "sqrt2")
+ * @return 1 if found and computed, 0 if unknown constant
+ */
+int constants_get_by_name_ctx(EvalContext *ctx, mpfr_t result, const char *constant_name);
+
+/**
+ * Get a constant by type, correctly rounded to the result's precision
+ * Like constants_get_by_name_ctx(), without looking the name up.
+ * @param ctx Context supplying the rounding mode and its constant cache
+ * @param result Output variable for the constant value (its precision is used)
+ * @param type Type of the constant
+ * @return 1 if computed, 0 if type is not a constant
+ */
+int constants_get_by_type_ctx(EvalContext *ctx, mpfr_t result, ConstantType type);
+
+/**
+ * Get a constant by name as a long double, correctly rounded to nearest
+ * Values are computed once per thread.
+ * @param constant_name Name of the constant (e.g., "pi", "e", "sqrt2")
+ * @param value Output value
+ * @return 1 if found, 0 if unknown constant
+ */
+int constants_get_long_double(const char *constant_name, long double *value);
+
+// Number of doubles constants_get_double_terms() splits a constant into
+#define CONSTANT_DOUBLE_TERMS 4
+
+/**
+ * Get a constant by name as an unevaluated sum of doubles
+ * The terms are nonoverlapping, largest first, and computed once per thread.
+ * @param constant_name Name of the constant (e.g., "pi", "e", "sqrt2")
+ * @param terms Output array of CONSTANT_DOUBLE_TERMS doubles
+ * @param error Output bound on |constant - sum of terms|
+ * @return 1 if found, 0 if unknown constant
+ */
+int constants_get_double_terms(const char *constant_name, double *terms, double *error);
+
+/**
+ * Serve constants from precomputed values before computing them
+ * Each value must be correctly rounded to nearest at its precision. The
+ * values are only read, and must outlive their use; pass NULL before
+ * releasing them. Not thread-safe: set before starting worker threads.
+ * @param stored Array of CONST_COUNT values, or NULL to stop using them
+ */
+void constants_set_stored(const CachedConstant *stored);
+
 /**
  * Clear a single cached constant
  * @param constant Pointer to the cached constant to clear
@@ -97,7 +153,7 @@ int constants_get_by_name(mpfr_t result, const char *constant_name);
 void clear_cached(CachedConstant *constant);
 
 /**
- * Clear cached constants (call when precision changes)
+ * Clear the process-wide cached constants and the calling thread's copies
  */
 void constants_clear_cache(void);
 
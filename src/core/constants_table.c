@@ -0,0 +1,366 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "constants_table.h"
+#include "constants.h"
+#include "context.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TABLE_MAGIC "CALCCTB1"
+#define TABLE_BYTE_ORDER 0x01020304u
+#define TABLE_VERSION_SIZE 32
+
+// Precision at which loaded values are checked against computed ones
+#define TABLE_CHECK_PRECISION 64
+
+// File layout: the header, one entry per constant, then the limbs of each
+// value at limb-aligned offsets. Fields are in the writer's byte order,
+// which the header records.
+typedef struct
+{
+    char magic[8];
+    uint32_t limb_bits;
+    uint32_t byte_order;
+    char mpfr_version[TABLE_VERSION_SIZE]; // mpfr_get_version() of the writer
+    uint32_t count;                        // CONST_COUNT of the writer
+    uint32_t reserved;
+    uint64_t file_size;
+    uint64_t checksum; // FNV-1a of every byte after the header
+} TableHeader;
+
+// Every constant is positive, so no sign is stored
+typedef struct
+{
+    int64_t precision;
+    int64_t exponent;
+    uint64_t limb_offset; // Bytes from the start of the file
+    uint64_t limb_count;
+} TableEntry;
+
+static char table_error[256] = "";
+
+// Mapping of the loaded table and the values pointing into it
+static void *table_map = NULL;
+static size_t table_size = 0;
+static CachedConstant table_constants[CONST_COUNT];
+static mpfr_prec_t table_min_precision = 0;
+
+static size_t table_limbs(mpfr_prec_t precision)
+{
+    return ((size_t)precision + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+}
+
+// Offset of the first value's limbs
+static size_t table_data_offset(void)
+{
+    size_t offset = sizeof(TableHeader) + CONST_COUNT * sizeof(TableEntry);
+    return (offset + sizeof(mp_limb_t) - 1) / sizeof(mp_limb_t) * sizeof(mp_limb_t);
+}
+
+#define TABLE_FNV_OFFSET UINT64_C(14695981039346656037)
+#define TABLE_FNV_PRIME UINT64_C(1099511628211)
+
+static uint64_t table_checksum(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * TABLE_FNV_PRIME;
+    }
+    return hash;
+}
+
+static int table_write(FILE *file, mpfr_t values[], mpfr_prec_t precision)
+{
+    TableHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TABLE_MAGIC, sizeof(header.magic));
+    header.limb_bits = GMP_NUMB_BITS;
+    header.byte_order = TABLE_BYTE_ORDER;
+    snprintf(header.mpfr_version, sizeof(header.mpfr_version), "%s", mpfr_get_version());
+    header.count = CONST_COUNT;
+
+    size_t value_bytes = table_limbs(precision) * sizeof(mp_limb_t);
+    size_t offset = table_data_offset();
+    header.file_size = offset + CONST_COUNT * value_bytes;
+
+    TableEntry entries[CONST_COUNT];
+    for (int i = 0; i < CONST_COUNT; i++)
+    {
+        entries[i].precision = precision;
+        entries[i].exponent = mpfr_get_exp(values[i]);
+        entries[i].limb_offset = offset + i * value_bytes;
+        entries[i].limb_count = table_limbs(precision);
+    }
+
+    static const char padding[sizeof(mp_limb_t)];
+    size_t padding_bytes = offset - sizeof(header) - sizeof(entries);
+    uint64_t hash = table_checksum(TABLE_FNV_OFFSET, entries, sizeof(entries));
+    hash = table_checksum(hash, padding, padding_bytes);
+    for (int i = 0; i < CONST_COUNT; i++)
+    {
+        hash = table_checksum(hash, mpfr_custom_get_significand(values[i]), value_bytes);
+    }
+    header.checksum = hash;
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(entries, sizeof(entries), 1, file) != 1 ||
+        fwrite(padding, 1, padding_bytes, file) != padding_bytes)
+    {
+        return 0;
+    }
+    for (int i = 0; i < CONST_COUNT; i++)
+    {
+        if (fwrite(mpfr_custom_get_significand(values[i]), value_bytes, 1, file) != 1)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int constants_table_export(const char *path, mpfr_prec_t precision)
+{
+    table_error[0] = '\0';
+    if (precision < MPFR_PREC_MIN || precision > MPFR_PREC_MAX)
+    {
+        snprintf(table_error, sizeof(table_error), "Invalid table precision: %ld",
+                 (long)precision);
+        return -1;
+    }
+
+    EvalContext ctx;
+    eval_context_init(&ctx, precision);
+    mpfr_t values[CONST_COUNT];
+    for (int i = 0; i < CONST_COUNT; i++)
+    {
+        mpfr_init2(values[i], precision);
+        constants_get_by_type_ctx(&ctx, values[i], (ConstantType)i);
+    }
+
+    // Written beside the target, then renamed over it
+    size_t length = strlen(path);
+    char *temporary = malloc(length + 5);
+    FILE *file = NULL;
+    int ok = 0;
+    if (temporary)
+    {
+        memcpy(temporary, path, length);
+        memcpy(temporary + length, ".tmp", 5);
+        file = fopen(temporary, "wb");
+    }
+    if (file)
+    {
+        ok = table_write(file, values, precision);
+        ok = fclose(file) == 0 && ok;
+        ok = ok && rename(temporary, path) == 0;
+        if (!ok)
+        {
+            snprintf(table_error, sizeof(table_error), "Cannot write constants table %s: %s", path,
+                     strerror(errno));
+            remove(temporary);
+        }
+    }
+    else
+    {
+        snprintf(table_error, sizeof(table_error), "Cannot create constants table %s: %s", path,
+                 temporary ? strerror(errno) : "out of memory");
+    }
+
+    free(temporary);
+    for (int i = 0; i < CONST_COUNT; i++)
+    {
+        mpfr_clear(values[i]);
+    }
+    eval_context_cleanup(&ctx);
+    return ok ? 0 : -1;
+}
+
+// Check the header of a mapped file
+static int table_check_header(const unsigned char *data, size_t size)
+{
+    TableHeader header;
+    if (size < table_data_offset())
+    {
+        snprintf(table_error, sizeof(table_error), "Constants table is truncated");
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, TABLE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        snprintf(table_error, sizeof(table_error), "Not a constants table");
+        return 0;
+    }
+    if (header.byte_order != TABLE_BYTE_ORDER || header.limb_bits != GMP_NUMB_BITS)
+    {
+        snprintf(table_error, sizeof(table_error),
+                 "Constants table was written for another machine layout");
+        return 0;
+    }
+    header.mpfr_version[TABLE_VERSION_SIZE - 1] = '\0';
+    if (strcmp(header.mpfr_version, mpfr_get_version()) != 0)
+    {
+        snprintf(table_error, sizeof(table_error),
+                 "Constants table was written by MPFR %s, not %s", header.mpfr_version,
+                 mpfr_get_version());
+        return 0;
+    }
+    if (header.count != CONST_COUNT || header.file_size != size)
+    {
+        snprintf(table_error, sizeof(table_error), "Constants table is stale or truncated");
+        return 0;
+    }
+    if (table_checksum(TABLE_FNV_OFFSET, data + sizeof(header), size - sizeof(header)) !=
+        header.checksum)
+    {
+        snprintf(table_error, sizeof(table_error), "Constants table checksum does not match");
+        return 0;
+    }
+    return 1;
+}
+
+// Check one entry and point its value at the mapped limbs
+static int table_install_entry(const unsigned char *data, size_t size, int index)
+{
+    TableEntry entry;
+    memcpy(&entry, data + sizeof(TableHeader) + index * sizeof(TableEntry), sizeof(entry));
+
+    int valid = entry.precision >= MPFR_PREC_MIN && entry.precision <= MPFR_PREC_MAX &&
+                entry.exponent >= mpfr_get_emin() && entry.exponent <= mpfr_get_emax() &&
+                entry.limb_count == table_limbs((mpfr_prec_t)entry.precision) &&
+                entry.limb_offset % sizeof(mp_limb_t) == 0 && entry.limb_offset <= size &&
+                entry.limb_count <= (size - entry.limb_offset) / sizeof(mp_limb_t);
+    if (valid)
+    {
+        // The top bit is set and the bits below the precision are clear
+        const mp_limb_t *limbs = (const mp_limb_t *)(data + entry.limb_offset);
+        int unused = (int)(entry.limb_count * GMP_NUMB_BITS - (uint64_t)entry.precision);
+        valid = (limbs[entry.limb_count - 1] >> (GMP_NUMB_BITS - 1)) == 1 &&
+                (unused == 0 || (limbs[0] & (((mp_limb_t)1 << unused) - 1)) == 0);
+    }
+    if (!valid)
+    {
+        snprintf(table_error, sizeof(table_error), "Constants table entry %d is corrupt", index);
+        return 0;
+    }
+
+    // The mapping is read-only; MPFR never writes to a value only read from
+    CachedConstant *constant = &table_constants[index];
+    mpfr_custom_init_set(constant->value, MPFR_REGULAR_KIND, (mpfr_exp_t)entry.exponent,
+                         (mpfr_prec_t)entry.precision, (void *)(data + entry.limb_offset));
+    constant->precision = (mpfr_prec_t)entry.precision;
+    constant->is_initialized = 1;
+    return 1;
+}
+
+// Compare the leading bits of every value with freshly computed ones
+static int table_check_values(void)
+{
+    EvalContext ctx;
+    eval_context_init(&ctx, TABLE_CHECK_PRECISION);
+    mpfr_t stored, computed;
+    mpfr_init2(stored, TABLE_CHECK_PRECISION);
+    mpfr_init2(computed, TABLE_CHECK_PRECISION);
+
+    int ok = 1;
+    for (int i = 0; i < CONST_COUNT && ok; i++)
+    {
+        mpfr_set(stored, table_constants[i].value, MPFR_RNDN);
+        constants_get_by_type_ctx(&ctx, computed, (ConstantType)i);
+        if (!mpfr_equal_p(stored, computed))
+        {
+            snprintf(table_error, sizeof(table_error),
+                     "Constants table entry %d does not match its constant", i);
+            ok = 0;
+        }
+    }
+
+    mpfr_clear(stored);
+    mpfr_clear(computed);
+    eval_context_cleanup(&ctx);
+    return ok;
+}
+
+int constants_table_load(const char *path)
+{
+    constants_table_unload();
+    table_error[0] = '\0';
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        snprintf(table_error, sizeof(table_error), "Cannot open constants table %s: %s", path,
+                 strerror(errno));
+        return -1;
+    }
+    struct stat info;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        snprintf(table_error, sizeof(table_error), "Cannot map constants table %s", path);
+        return -1;
+    }
+
+    size_t size = (size_t)info.st_size;
+    int ok = table_check_header(map, size);
+    table_min_precision = MPFR_PREC_MAX;
+    for (int i = 0; i < CONST_COUNT && ok; i++)
+    {
+        ok = table_install_entry(map, size, i);
+        if (ok && table_constants[i].precision < table_min_precision)
+        {
+            table_min_precision = table_constants[i].precision;
+        }
+    }
+    ok = ok && table_check_values();
+    if (!ok)
+    {
+        munmap(map, size);
+        table_min_precision = 0;
+        return -1;
+    }
+
+    table_map = map;
+    table_size = size;
+    constants_set_stored(table_constants);
+    return 0;
+}
+
+void constants_table_unload(void)
+{
+    if (!table_map)
+    {
+        return;
+    }
+    // Contexts hold copies, so nothing points into the mapping afterwards
+    constants_set_stored(NULL);
+    munmap(table_map, table_size);
+    table_map = NULL;
+    table_size = 0;
+    table_min_precision = 0;
+}
+
+mpfr_prec_t constants_table_precision(void)
+{
+    return table_min_precision;
+}
+
+const char *constants_table_get_error(void)
+{
+    return table_error[0] ? table_error : NULL;
+}
@@ -0,0 +1,57 @@
+#ifndef CONSTANTS_TABLE_H
+#define CONSTANTS_TABLE_H
+
+#include <mpfr.h>
+
+/*
+ * On-disk store of precomputed constants, so short-lived processes skip
+ * computing them at high precision.
+ *
+ * The file holds every ConstantType correctly rounded to nearest at one
+ * ceiling precision, with the significand limbs in the machine's own
+ * layout. Loading maps the file read-only and serves the limbs in place;
+ * lower precisions are rounded from them on demand. A file written by
+ * another MPFR version or for another limb size or byte order is refused,
+ * as is one whose values disagree with freshly computed ones.
+ */
+
+// Default ceiling: the highest precision plus room for guard bits
+#define CONSTANTS_TABLE_DEFAULT_PRECISION 10240
+
+/**
+ * Compute every constant and write them to a table file
+ * The file is written under a temporary name and renamed into place, so
+ * readers never see a partial table.
+ * @param path File to write
+ * @param precision Ceiling precision in bits
+ * @return 0 on success, -1 on error (see constants_table_get_error())
+ */
+int constants_table_export(const char *path, mpfr_prec_t precision);
+
+/**
+ * Map a table file and serve constants from it
+ * Any table loaded before is unloaded first. Not thread-safe: load before
+ * starting worker threads.
+ * @param path File to map
+ * @return 0 on success, -1 if the file is missing, stale or corrupt
+ */
+int constants_table_load(const char *path);
+
+/**
+ * Stop serving constants from the table and unmap it
+ */
+void constants_table_unload(void);
+
+/**
+ * Get the precision of the loaded table
+ * @return Ceiling precision in bits, 0 if no table is loaded
+ */
+mpfr_prec_t constants_table_precision(void);
+
+/**
+ * Get the error message of the last failed export or load
+ * @return Error message, or NULL if the last call succeeded
+ */
+const char *constants_table_get_error(void);
+
+#endif // CONSTANTS_TABLE_H
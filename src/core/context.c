@@ -0,0 +1,119 @@
+#include "context.h"
+#include "evaluator.h"
+#include "precision.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Context behind the global API, one per thread
+static _Thread_local EvalContext default_context;
+static _Thread_local int default_context_ready = 0;
+
+static mpfr_prec_t clamp_precision(mpfr_prec_t precision)
+{
+    if (precision < MIN_PRECISION)
+        precision = MIN_PRECISION;
+    if (precision > precision_max())
+        precision = precision_max();
+    return precision;
+}
+
+void eval_context_init(EvalContext *ctx, mpfr_prec_t precision)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->precision = clamp_precision(precision);
+    ctx->rounding = MPFR_RNDN;
+    ctx->native = 1;
+    ctx->exact = 1;
+    ctx->format = (FormatSettings)FORMAT_SETTINGS_DEFAULT;
+}
+
+void eval_context_cleanup(EvalContext *ctx)
+{
+    if (!ctx)
+    {
+        return;
+    }
+
+    evaluator_release_scratch(ctx);
+    for (int i = 0; i < CONST_COUNT; i++)
+    {
+        clear_cached(&ctx->constants[i]);
+    }
+    free(ctx->bindings);
+    ctx->bindings = NULL;
+    ctx->binding_count = 0;
+    ctx->binding_capacity = 0;
+}
+
+EvalContext *eval_context_default(void)
+{
+    if (!default_context_ready)
+    {
+        eval_context_init(&default_context, global_precision);
+        default_context_ready = 1;
+    }
+
+    // Follow the process-wide settings so set_precision() applies everywhere
+    default_context.precision = global_precision;
+    default_context.rounding = global_rounding;
+    return &default_context;
+}
+
+void eval_context_set_precision(EvalContext *ctx, mpfr_prec_t precision)
+{
+    ctx->precision = clamp_precision(precision);
+}
+
+long eval_context_decimal_digits(const EvalContext *ctx)
+{
+    return (long)(ctx->precision * 0.30103); // log10(2) ≈ 0.30103
+}
+
+const char *eval_context_get_error(const EvalContext *ctx)
+{
+    return ctx->error[0] ? ctx->error : NULL;
+}
+
+void eval_context_clear_error(EvalContext *ctx)
+{
+    ctx->error[0] = '\0';
+}
+
+int eval_context_bind(EvalContext *ctx, const char *name, mpfr_srcptr value)
+{
+    if (ctx->binding_count == ctx->binding_capacity)
+    {
+        int new_capacity = ctx->binding_capacity ? ctx->binding_capacity * 2 : 4;
+        EvalBinding *new_bindings = realloc(ctx->bindings, new_capacity * sizeof(EvalBinding));
+        if (!new_bindings)
+        {
+            return 0;
+        }
+        ctx->bindings = new_bindings;
+        ctx->binding_capacity = new_capacity;
+    }
+    ctx->bindings[ctx->binding_count].name = name;
+    ctx->bindings[ctx->binding_count].value = value;
+    ctx->binding_count++;
+    return 1;
+}
+
+void eval_context_unbind(EvalContext *ctx)
+{
+    if (ctx->binding_count > 0)
+    {
+        ctx->binding_count--;
+    }
+}
+
+mpfr_srcptr eval_context_find_binding(const EvalContext *ctx, const char *name)
+{
+    for (int i = ctx->binding_count - 1; i >= 0; i--)
+    {
+        if (strcmp(ctx->bindings[i].name, name) == 0)
+        {
+            return ctx->bindings[i].value;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,197 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "constants.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include <mpfr.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Size of the error message slots in a context
+#define EVAL_CONTEXT_ERROR_SIZE 256
+
+// One level of the evaluator's scratch pool (defined by the evaluator)
+typedef struct ScratchLevel ScratchLevel;
+
+// Value of a shared subexpression (defined by the evaluator)
+typedef struct SharedValue SharedValue;
+
+// Variable definitions (see variables.h)
+typedef struct VariableTable VariableTable;
+
+// A variable bound by a sum() or integrate() call under way (see reduce.h)
+typedef struct
+{
+    const char *name;
+    mpfr_srcptr value; // Owned by the call that bound it
+} EvalBinding;
+
+/**
+ * Everything one evaluation depends on or changes.
+ *
+ * Contexts are independent: expressions can be evaluated and formatted at
+ * different precisions at the same time, on any threads, as long as each
+ * context is used by one thread at a time. A context must be initialized
+ * with eval_context_init() and released with eval_context_cleanup().
+ */
+typedef struct EvalContext
+{
+    mpfr_prec_t precision; // User precision in bits
+    mpfr_rnd_t rounding;   // Rounding mode for every operation
+    int strict_mode;       // Evaluator: function domain failures are errors
+    int strict_domain;     // Functions: domain failures give NaN
+    int adaptive;          // Evaluator: adaptive precision instead of fixed boosts
+    int native;            // Evaluator: try the hardware backends at low precision
+    int exact;             // Evaluator: compute integer/rational subtrees exactly
+    int interval;          // Evaluator: enclose every value in certified bounds
+    int adaptive_passes;   // Passes the last adaptive evaluation took, 0 otherwise
+
+    char error[EVAL_CONTEXT_ERROR_SIZE];          // Evaluation error, empty if none
+    char function_error[EVAL_CONTEXT_ERROR_SIZE]; // Last function error, empty if none
+
+    FormatSettings format; // Display settings for the formatter_*_ctx() API
+
+    // Evaluator scratch pool, indexed by recursion depth
+    ScratchLevel **scratch_levels;
+    int scratch_count;
+    int scratch_capacity;
+    mpfr_prec_t scratch_precision;
+
+    // Operand values of n-ary sums and products, used as a stack. Terms
+    // are allocated one by one, so a term keeps its address when the
+    // array grows.
+    mpfr_ptr *terms;
+    int term_top;      // Terms in use by the nodes under way
+    int term_count;    // Terms initialized
+    int term_capacity; // Length of the array
+
+    // Values of shared subexpressions, indexed by share slot
+    SharedValue *shared;
+    int shared_capacity;
+    unsigned long shared_pass; // Evaluation pass under way; values of older ones are stale
+
+    // Exact tier (see rational.h); exact_value is initialized on first use
+    mpq_t exact_value;
+    int exact_ready;
+    int exact_declined; // An enclosing subtree fell back to MPFR, so this one does too
+    int exact_integer;  // The last result was an exact integer, kept in exact_value
+
+    // Bounds of the last interval evaluation; initialized on first use
+    mpfr_t interval_lo;
+    mpfr_t interval_hi;
+    int interval_ready;
+    int interval_valid; // The last evaluation was an interval one, its bounds kept
+
+    // Constants computed for this context, indexed by ConstantType
+    CachedConstant constants[CONST_COUNT];
+
+    // Variables the evaluator resolves names in, NULL for none (not owned)
+    VariableTable *variables;
+
+    // Variables bound by the sum() and integrate() calls under way,
+    // innermost last. They hide table variables of the same name, but not
+    // from the definitions of table variables.
+    EvalBinding *bindings;
+    int binding_count;
+    int binding_capacity;
+
+    // Progress reports of MPFR evaluations, NULL for none
+    EvalProgress progress;
+    void *progress_data;
+    uint64_t progress_interval; // Least time between reports in ns
+    long progress_done;
+    long progress_total;
+    uint64_t progress_start; // Start of the evaluation (profile_now() ns)
+    uint64_t progress_next;  // When the next report is due
+
+    // Limits on each evaluation and how much of them it has used
+    EvalBudget budget;
+    int budget_active;        // Some limit is set
+    int budget_exceeded;      // Limit the evaluation ran over, 0 if none
+    long budget_operations;   // Operations so far
+    uint64_t budget_deadline; // When the time limit runs out (profile_now() ns)
+
+    // Stops this context's evaluations like evaluator_cancel() once set by
+    // any thread, NULL for none (not owned)
+    const atomic_int *cancel;
+} EvalContext;
+
+/**
+ * Initialize a context with default settings
+ * @param ctx Context to initialize
+ * @param precision User precision in bits (clamped to valid range)
+ */
+void eval_context_init(EvalContext *ctx, mpfr_prec_t precision);
+
+/**
+ * Release the scratch pool and cached constants held by a context
+ * The context keeps its settings and can be used again afterwards.
+ * @param ctx Context to clean up
+ */
+void eval_context_cleanup(EvalContext *ctx);
+
+/**
+ * Get the calling thread's default context.
+ *
+ * This is the context behind the global API (evaluator_eval(),
+ * functions_eval(), formatter_print_*() and friends). Its precision and
+ * rounding follow global_precision and global_rounding; its strict flags,
+ * error slots, scratch pool and constant cache belong to the thread.
+ *
+ * @return Default context for the calling thread
+ */
+EvalContext *eval_context_default(void);
+
+/**
+ * Set the precision of a context
+ * @param ctx Context to change
+ * @param precision Precision in bits (clamped to valid range)
+ */
+void eval_context_set_precision(EvalContext *ctx, mpfr_prec_t precision);
+
+/**
+ * Get equivalent decimal digits for a context's precision
+ * @param ctx Context to inspect
+ * @return Approximate decimal digits
+ */
+long eval_context_decimal_digits(const EvalContext *ctx);
+
+/**
+ * Get the evaluation error stored in a context
+ * @param ctx Context to inspect
+ * @return Error message or NULL if no error
+ */
+const char *eval_context_get_error(const EvalContext *ctx);
+
+/**
+ * Clear the evaluation error stored in a context
+ * @param ctx Context to change
+ */
+void eval_context_clear_error(EvalContext *ctx);
+
+/**
+ * Bind a variable for the evaluations that follow, hiding any binding or
+ * table variable of the same name until eval_context_unbind()
+ * @param ctx Context to change
+ * @param name Variable name, kept by reference
+ * @param value Value, kept by reference
+ * @return 1 on success, 0 if out of memory
+ */
+int eval_context_bind(EvalContext *ctx, const char *name, mpfr_srcptr value);
+
+/**
+ * Remove the innermost binding
+ * @param ctx Context to change
+ */
+void eval_context_unbind(EvalContext *ctx);
+
+/**
+ * Find the innermost binding of a name
+ * @param ctx Context to search
+ * @param name Variable name
+ * @return Bound value, or NULL if the name is not bound
+ */
+mpfr_srcptr eval_context_find_binding(const EvalContext *ctx, const char *name);
+
+#endif // CONTEXT_H
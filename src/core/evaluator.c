@@ -1,243 +1,2239 @@
 #include "evaluator.h"
+#include "analysis.h"
+#include "context.h"
 #include "precision.h"
 #include "constants.h"
+#include "function_table.h"
 #include "functions.h"
+#include "interval.h"
+#include "multidouble.h"
+#include "native.h"
+#include "profile.h"
+#include "rational.h"
+#include "reduce.h"
+#include "result_cache.h"
+#include "variables.h"
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-// Evaluation state
-static int strict_mode = 0;
-static char last_error[256] = {0};
+// All tree levels share one scratch precision
+_Static_assert(BINOP_PRECISION_BOOST == UNARY_PRECISION_BOOST &&
+                   BINOP_PRECISION_BOOST == FUNCTION_ARG_PRECISION_BOOST,
+               "scratch pool assumes a uniform precision boost");
+
+// Max 2 args for current functions; binary operators use the same slots
+#define SCRATCH_OPERANDS 2
+
+// Working-precision values an MPFR function holds internally at most, as
+// far as the memory estimate is concerned
+#define EVALUATOR_FUNCTION_TEMPS 16
+
+// Temporaries for one level of recursion. Each node evaluates its children
+// into its own level and is the only user of that level while it runs.
+struct ScratchLevel
+{
+    mpfr_t operands[SCRATCH_OPERANDS];
+    mpfr_t result;
+};
+
+// A shared subexpression's value, valid for the rest of the pass that
+// computed it. Nodes of different trees evaluated together (an expression
+// and the definitions of its variables) may use the same slot; the node
+// says whose value it is.
+struct SharedValue
+{
+    mpfr_t value;
+    const ASTNode *node; // Node the value belongs to, NULL if none yet
+    unsigned long pass;  // ctx->shared_pass it was computed in
+    mpfr_exp_t error;    // Adaptive passes: error bound of the value
+    long operations;     // Operations it took, for progress reports
+};
 
 // Forward declarations for static functions
-static void evaluator_eval_constant(mpfr_t result, const char *const_name);
-static void evaluator_eval_binop(mpfr_t result, const ASTNode *node);
-static void evaluator_eval_unary(mpfr_t result, const ASTNode *node);
-static void evaluator_eval_function(mpfr_t result, const ASTNode *node);
+static void evaluator_eval_node(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth);
+static void evaluator_eval_constant(EvalContext *ctx, mpfr_t result, const ASTNode *node);
+static void evaluator_eval_variable(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                    int depth);
+static void evaluator_eval_binop(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth);
+static void evaluator_eval_unary(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth);
+static void evaluator_eval_nary(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth);
+static void evaluator_eval_function(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                    int depth);
+static mpfr_exp_t evaluator_eval_reduction(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                           int depth);
+static void evaluator_eval_adaptive(EvalContext *ctx, mpfr_t result, const ASTNode *node);
+static void evaluator_eval_interval(EvalContext *ctx, mpfr_t result, const ASTNode *node);
+
+// Bring every level of a context's pool to a working precision. Only does
+// work when the precision differs from the last evaluation's.
+static void scratch_sync_precision(EvalContext *ctx, mpfr_prec_t prec)
+{
+    if (prec == ctx->scratch_precision)
+    {
+        return;
+    }
+
+    for (int i = 0; i < ctx->scratch_count; i++)
+    {
+        for (int j = 0; j < SCRATCH_OPERANDS; j++)
+        {
+            mpfr_set_prec(ctx->scratch_levels[i]->operands[j], prec);
+        }
+        mpfr_set_prec(ctx->scratch_levels[i]->result, prec);
+    }
+    for (int i = 0; i < ctx->term_count; i++)
+    {
+        mpfr_set_prec(ctx->terms[i], prec);
+    }
+    ctx->scratch_precision = prec;
+}
+
+// Get the temporaries for a recursion depth, growing the pool on first use.
+// Levels are allocated one by one so that growing the pool never moves a
+// level that is still in use.
+static ScratchLevel *scratch_get(EvalContext *ctx, int depth)
+{
+    if (depth < ctx->scratch_count)
+    {
+        return ctx->scratch_levels[depth];
+    }
+
+    if (ctx->scratch_count == ctx->scratch_capacity)
+    {
+        int new_capacity = ctx->scratch_capacity ? ctx->scratch_capacity * 2 : 16;
+        ScratchLevel **new_levels =
+            realloc(ctx->scratch_levels, new_capacity * sizeof(ScratchLevel *));
+        if (!new_levels)
+        {
+            return NULL;
+        }
+        ctx->scratch_levels = new_levels;
+        ctx->scratch_capacity = new_capacity;
+    }
+
+    ScratchLevel *level = malloc(sizeof(ScratchLevel));
+    if (!level)
+    {
+        return NULL;
+    }
+    for (int j = 0; j < SCRATCH_OPERANDS; j++)
+    {
+        mpfr_init2(level->operands[j], ctx->scratch_precision);
+    }
+    mpfr_init2(level->result, ctx->scratch_precision);
+    PROFILE_COUNT(PROFILE_MPFR_TEMPS, SCRATCH_OPERANDS + 1);
+
+    ctx->scratch_levels[ctx->scratch_count++] = level;
+    return level;
+}
+
+// Take count terms off the term stack for an n-ary node's operands,
+// returning the index of the first or -1 when out of memory. The node
+// gives them back by restoring ctx->term_top to that index. Nested nodes
+// may grow the array, so operands are reached through ctx->terms each time.
+static int terms_push(EvalContext *ctx, int count)
+{
+    int base = ctx->term_top;
+    if (base + count > ctx->term_capacity)
+    {
+        int new_capacity = ctx->term_capacity ? ctx->term_capacity : 16;
+        while (new_capacity < base + count)
+        {
+            new_capacity *= 2;
+        }
+        mpfr_ptr *new_terms = realloc(ctx->terms, new_capacity * sizeof(mpfr_ptr));
+        if (!new_terms)
+        {
+            return -1;
+        }
+        ctx->terms = new_terms;
+        ctx->term_capacity = new_capacity;
+    }
+
+    while (ctx->term_count < base + count)
+    {
+        mpfr_ptr term = malloc(sizeof(__mpfr_struct));
+        if (!term)
+        {
+            return -1;
+        }
+        mpfr_init2(term, ctx->scratch_precision);
+        PROFILE_COUNT(PROFILE_MPFR_TEMPS, 1);
+        ctx->terms[ctx->term_count++] = term;
+    }
+    ctx->term_top = base + count;
+    return base;
+}
+
+// Where a node computes its value: straight into the result when that has
+// the working precision already, as every operand does, so interior nodes
+// skip a copy. Only the root rounds from the level's own result.
+static mpfr_ptr evaluator_target(ScratchLevel *level, mpfr_ptr result)
+{
+    return mpfr_get_prec(result) == mpfr_get_prec(level->result) ? result : level->result;
+}
+
+// The value a shared node already has in this pass at the result's
+// precision, or NULL
+static SharedValue *shared_lookup(EvalContext *ctx, const ASTNode *node, mpfr_srcptr result)
+{
+    if (node->share >= ctx->shared_capacity)
+    {
+        return NULL;
+    }
+    SharedValue *shared = &ctx->shared[node->share];
+    if (shared->node != node || shared->pass != ctx->shared_pass ||
+        mpfr_get_prec(shared->value) != mpfr_get_prec(result))
+    {
+        return NULL;
+    }
+    PROFILE_COUNT(PROFILE_SHARED_HITS, 1);
+    if (ctx->progress)
+    {
+        ctx->progress_done += shared->operations;
+    }
+    return shared;
+}
+
+// Keep a shared node's value for the rest of the pass. Nothing is kept
+// once the pass has seen an error, so a failing subexpression reports its
+// error again every time it is evaluated.
+static void shared_store(EvalContext *ctx, const ASTNode *node, mpfr_srcptr value,
+                         mpfr_exp_t error, long operations)
+{
+    if (ctx->error[0] || ctx->function_error[0] || ctx->budget_exceeded)
+    {
+        return;
+    }
+
+    if (node->share >= ctx->shared_capacity)
+    {
+        int new_capacity = ctx->shared_capacity ? ctx->shared_capacity * 2 : 16;
+        while (new_capacity <= node->share)
+        {
+            new_capacity *= 2;
+        }
+        SharedValue *new_shared = realloc(ctx->shared, new_capacity * sizeof(SharedValue));
+        if (!new_shared)
+        {
+            return;
+        }
+        for (int i = ctx->shared_capacity; i < new_capacity; i++)
+        {
+            mpfr_init2(new_shared[i].value, mpfr_get_prec(value));
+            new_shared[i].node = NULL;
+        }
+        PROFILE_COUNT(PROFILE_MPFR_TEMPS, (unsigned long)(new_capacity - ctx->shared_capacity));
+        ctx->shared = new_shared;
+        ctx->shared_capacity = new_capacity;
+    }
+
+    SharedValue *shared = &ctx->shared[node->share];
+    if (mpfr_get_prec(shared->value) != mpfr_get_prec(value))
+    {
+        mpfr_set_prec(shared->value, mpfr_get_prec(value));
+    }
+    mpfr_set(shared->value, value, MPFR_RNDN);
+    shared->node = node;
+    shared->pass = ctx->shared_pass;
+    shared->error = error;
+    shared->operations = operations;
+}
+
+// Set by evaluator_cancel(), possibly from a signal handler
+static atomic_int evaluator_cancelled = 0;
+
+// Why an evaluation was stopped, as kept in ctx->budget_exceeded
+enum
+{
+    BUDGET_OK,
+    BUDGET_CANCELLED,
+    BUDGET_OPERATIONS,
+    BUDGET_EXPONENT,
+    BUDGET_TIME,
+    BUDGET_ESTIMATE
+};
+
+// Account for finished operations: report progress when a report is due
+// and stop the evaluation when it runs over its budget or is cancelled
+static void evaluator_step(EvalContext *ctx, mpfr_srcptr value, long steps)
+{
+    if (ctx->progress)
+    {
+        ctx->progress_done += steps;
+        uint64_t now = profile_now();
+        if (now >= ctx->progress_next)
+        {
+            ctx->progress(ctx->progress_data, ctx->progress_done, ctx->progress_total,
+                          (double)(now - ctx->progress_start) * 1e-9);
+            ctx->progress_next = now + ctx->progress_interval;
+        }
+    }
+
+    const EvalBudget *budget = &ctx->budget;
+    if (evaluator_cancel_requested(ctx))
+        ctx->budget_exceeded = BUDGET_CANCELLED;
+    else if (budget->max_operations &&
+             (ctx->budget_operations += steps) > budget->max_operations)
+        ctx->budget_exceeded = BUDGET_OPERATIONS;
+    else if (budget->max_exponent && mpfr_regular_p(value) &&
+             labs((long)mpfr_get_exp(value)) > budget->max_exponent)
+        ctx->budget_exceeded = BUDGET_EXPONENT;
+    else if (ctx->budget_deadline && profile_now() > ctx->budget_deadline)
+        ctx->budget_exceeded = BUDGET_TIME;
+}
+
+// Nothing to do per operation unless progress, a budget or a cancel is on
+#define EVALUATOR_STEPS(ctx, value, steps)                                    \
+    do                                                                        \
+    {                                                                         \
+        if ((ctx)->progress || (ctx)->budget_active || (ctx)->cancel ||       \
+            atomic_load_explicit(&evaluator_cancelled, memory_order_relaxed)) \
+            evaluator_step(ctx, value, steps);                                \
+    } while (0)
+#define EVALUATOR_STEP(ctx, value) EVALUATOR_STEPS(ctx, value, 1)
+
+// Operations a node stands for: an n-ary sum or product of n operands
+// counts as the n - 1 binary ones it replaces
+static long node_steps(const ASTNode *node)
+{
+    return node->type == NODE_NARY ? node->nary.count - 1 : 1;
+}
+
+// Replace whatever error the abandoned tree left with the reason it stopped
+static void evaluator_budget_error(EvalContext *ctx)
+{
+    const EvalBudget *budget = &ctx->budget;
+    switch (ctx->budget_exceeded)
+    {
+    case BUDGET_CANCELLED:
+        snprintf(ctx->error, sizeof(ctx->error), "Evaluation interrupted");
+        break;
+    case BUDGET_OPERATIONS:
+        snprintf(ctx->error, sizeof(ctx->error), "Budget exceeded: more than %ld operations",
+                 budget->max_operations);
+        break;
+    case BUDGET_EXPONENT:
+        snprintf(ctx->error, sizeof(ctx->error),
+                 "Budget exceeded: a value needs an exponent beyond 2^%ld", budget->max_exponent);
+        break;
+    case BUDGET_ESTIMATE:
+        snprintf(ctx->error, sizeof(ctx->error),
+                 "Budget exceeded: estimated to take far longer than %g s", budget->seconds);
+        break;
+    default:
+        snprintf(ctx->error, sizeof(ctx->error), "Budget exceeded: took longer than %g s",
+                 budget->seconds);
+    }
+}
+
+// Refuse an evaluation the budget certainly cannot cover, or one that would
+// certainly fail in strict mode, before any of it runs. Returns 1 to go on.
+static int evaluator_precheck(EvalContext *ctx, const ASTNode *node)
+{
+    Analysis analysis;
+    analysis_run(ctx, node, &analysis);
+
+    const EvalBudget *budget = &ctx->budget;
+    if (budget->max_operations && analysis.operations > budget->max_operations)
+        ctx->budget_exceeded = BUDGET_OPERATIONS;
+    else if (budget->max_exponent && analysis.exponent > budget->max_exponent)
+        ctx->budget_exceeded = BUDGET_EXPONENT;
+    else if (budget->seconds > 0 &&
+             analysis.cost > budget->seconds * 1e9 * EVALUATOR_ESTIMATE_MARGIN)
+        ctx->budget_exceeded = BUDGET_ESTIMATE;
+
+    ctx->adaptive_passes = 0;
+    ctx->function_error[0] = '\0';
+    if (ctx->budget_exceeded)
+    {
+        evaluator_budget_error(ctx);
+        return 0;
+    }
+    if (analysis.division_by_zero || (analysis.domain_error && ctx->strict_mode))
+    {
+        if (analysis.division_by_zero)
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "%s", analysis.message);
+        }
+        else
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Function evaluation failed: %.200s",
+                     analysis.message);
+        }
+        return 0;
+    }
+    return 1;
+}
+
+// Operations, depth, share slots and n-ary terms of a tree, for progress
+// totals and memory estimates. Shared subexpressions count at every
+// occurrence.
+static void evaluator_measure(const ASTNode *node, int depth, long *operations, int *max_depth,
+                              int *slots, int *terms)
+{
+    if (!node)
+    {
+        return;
+    }
+    if (depth > *max_depth)
+    {
+        *max_depth = depth;
+    }
+    if (node->share >= *slots)
+    {
+        *slots = node->share + 1;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        evaluator_measure(node->number.literal->folded_from, depth, operations,
+                          max_depth, slots, terms);
+        break;
+    case NODE_BINOP:
+        (*operations)++;
+        evaluator_measure(node->binop.left, depth + 1, operations, max_depth, slots, terms);
+        evaluator_measure(node->binop.right, depth + 1, operations, max_depth, slots, terms);
+        break;
+    case NODE_UNARY:
+        (*operations)++;
+        evaluator_measure(node->unary.operand, depth + 1, operations, max_depth, slots, terms);
+        break;
+    case NODE_NARY:
+        *operations += node_steps(node);
+        *terms += node->nary.count;
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            evaluator_measure(node->nary.operands[i], depth + 1, operations, max_depth, slots,
+                              terms);
+        }
+        break;
+    case NODE_FUNCTION:
+        (*operations)++;
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            evaluator_measure(node->function.args[i], depth + 1, operations, max_depth, slots, terms);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// A folded value computed for another precision than the context's
+static int is_stale_fold(const EvalContext *ctx, const ASTNode *node)
+{
+    return node->number.literal->folded_from &&
+           node->number.literal->folded_precision != ctx->precision;
+}
+
+// Check whether a subtree should go to the exact tier. A literal is
+// copied faster than it is converted, and below a subtree the tier
+// declined it would only decline again. Operation and exponent limits
+// are metered by the MPFR paths only.
+static int exact_candidate(const EvalContext *ctx, const ASTNode *node)
+{
+    return ctx->exact && !ctx->exact_declined && node->exact && node->type != NODE_NUMBER &&
+           !ctx->budget.max_operations && !ctx->budget.max_exponent;
+}
+
+// Compute a subtree with the exact tier and round it once into result,
+// returning the ternary value in inexact. 0 if the tier declines.
+static int evaluator_eval_exact_node(EvalContext *ctx, mpfr_ptr result, const ASTNode *node,
+                                     mpfr_rnd_t rounding, int *inexact)
+{
+    if (!ctx->exact_ready)
+    {
+        mpq_init(ctx->exact_value);
+        ctx->exact_ready = 1;
+    }
+    int negative_zero;
+    if (!rational_eval_signed(ctx->exact_value, &negative_zero, node, ctx->rounding))
+    {
+        return 0;
+    }
+    *inexact = mpfr_set_q(result, ctx->exact_value, rounding);
+    if (negative_zero && mpfr_zero_p(result))
+    {
+        mpfr_neg(result, result, MPFR_RNDN);
+    }
+    return 1;
+}
+
+// Evaluate a whole tree with the exact tier, keeping an integer result
+// for display
+static int evaluator_eval_exact(EvalContext *ctx, mpfr_t result, const ASTNode *node)
+{
+    // Cancellation is reported by the MPFR path
+    int inexact;
+    if (evaluator_cancel_requested(ctx) ||
+        !evaluator_eval_exact_node(ctx, result, node, ctx->rounding, &inexact))
+    {
+        return 0;
+    }
+
+    eval_context_clear_error(ctx);
+    ctx->function_error[0] = '\0';
+    ctx->adaptive_passes = 0;
+    ctx->exact_integer = mpz_cmp_ui(mpq_denref(ctx->exact_value), 1) == 0;
+    PROFILE_COUNT(PROFILE_EXACT, 1);
+    return 1;
+}
+
+void evaluator_eval(mpfr_t result, const ASTNode *node)
+{
+    evaluator_eval_ctx(eval_context_default(), result, node);
+}
+
+// Evaluate without consulting the result cache
+static void evaluator_eval_uncached(EvalContext *ctx, mpfr_t result, const ASTNode *node)
+{
+    // The hardware backends only answer when their result is correctly
+    // rounded, which is also what the adaptive mode guarantees. Trees the
+    // long double backend declines may still fit double-double when they
+    // gain from it. A number folded at this precision is only a copy, so it
+    // skips them.
+    int folded = node->type == NODE_NUMBER && !is_stale_fold(ctx, node);
+    if (ctx->native && !ctx->interval && !folded &&
+        (native_eval(ctx, result, node) ||
+         (multidouble_pays_off(ctx, result, node) && multidouble_eval(ctx, result, node))))
+    {
+        eval_context_clear_error(ctx);
+        ctx->function_error[0] = '\0';
+        ctx->adaptive_passes = 0;
+        return;
+    }
+
+    // Above the normal cap the pool alone can outgrow the machine, so an
+    // evaluation that cannot fit is refused before anything is allocated
+    if (ctx->precision > MAX_PRECISION)
+    {
+        size_t needed = evaluator_estimate_memory(ctx, node);
+        size_t limit = precision_get_memory_limit();
+        if (limit && needed > limit)
+        {
+            snprintf(ctx->error, sizeof(ctx->error),
+                     "Not enough memory: needs about %zu MiB at %ld bits (limit %zu MiB)",
+                     needed >> 20, (long)ctx->precision, limit >> 20);
+            mpfr_set_nan(result);
+            return;
+        }
+    }
+
+    ctx->budget_active = ctx->budget.seconds > 0 || ctx->budget.max_operations > 0 ||
+                         ctx->budget.max_exponent > 0;
+    ctx->budget_exceeded = BUDGET_OK;
+    ctx->budget_operations = 0;
+    ctx->budget_deadline = 0;
+    if (ctx->budget.seconds > 0)
+    {
+        ctx->budget_deadline = profile_now() + (uint64_t)(ctx->budget.seconds * 1e9);
+    }
+    if (ctx->budget_active && !evaluator_precheck(ctx, node))
+    {
+        mpfr_set_nan(result);
+        return;
+    }
+
+    if (ctx->progress)
+    {
+        int max_depth = 0;
+        int slots = 0;
+        int terms = 0;
+        ctx->progress_total = 0;
+        evaluator_measure(node, 0, &ctx->progress_total, &max_depth, &slots, &terms);
+        ctx->progress_start = profile_now();
+        ctx->progress_next = ctx->progress_start + ctx->progress_interval;
+        ctx->progress_done = 0;
+    }
+
+    if (ctx->interval)
+    {
+        evaluator_eval_interval(ctx, result, node);
+    }
+    else if (ctx->adaptive)
+    {
+        evaluator_eval_adaptive(ctx, result, node);
+    }
+    else
+    {
+        ctx->adaptive_passes = 0;
+        scratch_sync_precision(ctx, ctx->precision + BINOP_PRECISION_BOOST);
+        eval_context_clear_error(ctx);
+        ctx->shared_pass++;
+        evaluator_eval_node(ctx, result, node, 0);
+    }
+
+    if (ctx->budget_exceeded)
+    {
+        evaluator_budget_error(ctx);
+        mpfr_set_nan(result);
+    }
+}
+
+// Evaluate with MPFR or the hardware backends, through the result cache
+static void evaluator_eval_cached(EvalContext *ctx, mpfr_t result, const ASTNode *node)
+{
+    if (!result_cache_enabled())
+    {
+        evaluator_eval_uncached(ctx, result, node);
+        return;
+    }
+
+    ResultCacheKey key;
+    result_cache_key_build(&key, ctx, node, mpfr_get_prec(result));
+    if (result_cache_lookup(&key, result))
+    {
+        eval_context_clear_error(ctx);
+        ctx->function_error[0] = '\0';
+        ctx->adaptive_passes = 0;
+    }
+    else
+    {
+        evaluator_eval_uncached(ctx, result, node);
+
+        // Only clean results are cached, so a hit never hides an error
+        if (!eval_context_get_error(ctx) && !ctx->function_error[0])
+        {
+            result_cache_store(&key, result);
+        }
+    }
+    result_cache_key_free(&key);
+}
+
+void evaluator_eval_ctx(EvalContext *ctx, mpfr_t result, const ASTNode *node)
+{
+    // Exact results skip the cache: they are cheap to compute again, and
+    // only a fresh evaluation has the exact integer for display
+    ctx->exact_integer = 0;
+    ctx->interval_valid = 0;
+    if (node && ctx->interval)
+    {
+        // Bounds are only certain when every step was rounded outward
+        evaluator_eval_uncached(ctx, result, node);
+        return;
+    }
+    if (!node || !exact_candidate(ctx, node))
+    {
+        evaluator_eval_cached(ctx, result, node);
+        return;
+    }
+    if (evaluator_eval_exact(ctx, result, node))
+    {
+        return;
+    }
+
+    ctx->exact_declined = 1;
+    evaluator_eval_cached(ctx, result, node);
+    ctx->exact_declined = 0;
+}
+
+void evaluator_eval_subtree(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth)
+{
+    ctx->shared_pass++;
+    evaluator_eval_node(ctx, result, node, depth);
+}
+
+static void evaluator_eval_node(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth)
+{
+    // A stopped evaluation abandons the rest of the tree
+    if (ctx->budget_exceeded)
+    {
+        mpfr_set_nan(result);
+        return;
+    }
+    if (!node)
+    {
+        mpfr_set_d(result, 0.0, ctx->rounding);
+        return;
+    }
+
+    // A shared subexpression is evaluated once per pass
+    long operations = ctx->progress_done;
+    if (node->share >= 0)
+    {
+        const SharedValue *shared = shared_lookup(ctx, node, result);
+        if (shared)
+        {
+            mpfr_set(result, shared->value, ctx->rounding);
+            return;
+        }
+    }
+
+    // Integer and rational subtrees are computed exactly and rounded once
+    int declined = 0;
+    if (exact_candidate(ctx, node))
+    {
+        int inexact;
+        if (evaluator_eval_exact_node(ctx, result, node, ctx->rounding, &inexact))
+        {
+            EVALUATOR_STEP(ctx, result);
+            if (node->share >= 0)
+            {
+                shared_store(ctx, node, result, 0, ctx->progress_done - operations);
+            }
+            return;
+        }
+        ctx->exact_declined = declined = 1;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (is_stale_fold(ctx, node))
+        {
+            // Folded for another precision: fall back to the original subtree
+            evaluator_eval_node(ctx, result, node->number.literal->folded_from, depth);
+        }
+        else
+        {
+            mpfr_set(result, node->number.literal->value, ctx->rounding);
+        }
+        break;
+
+    case NODE_CONSTANT:
+        evaluator_eval_constant(ctx, result, node);
+        break;
+
+    case NODE_VARIABLE:
+        evaluator_eval_variable(ctx, result, node, depth);
+        break;
+
+    case NODE_BINOP:
+        evaluator_eval_binop(ctx, result, node, depth);
+        break;
+
+    case NODE_UNARY:
+        evaluator_eval_unary(ctx, result, node, depth);
+        break;
+
+    case NODE_NARY:
+        evaluator_eval_nary(ctx, result, node, depth);
+        break;
+
+    case NODE_FUNCTION:
+        if (token_binds_variable(node->function.func_type))
+        {
+            evaluator_eval_reduction(ctx, result, node, depth);
+            evaluator_flush_tiny(result, ctx->precision);
+            EVALUATOR_STEP(ctx, result);
+        }
+        else
+        {
+            evaluator_eval_function(ctx, result, node, depth);
+        }
+        break;
+
+    default:
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown node type");
+        mpfr_set_d(result, 0.0, ctx->rounding);
+    }
+
+    if (declined)
+    {
+        ctx->exact_declined = 0;
+    }
+    if (node->share >= 0)
+    {
+        shared_store(ctx, node, result, 0, ctx->progress_done - operations);
+    }
+}
+
+static void evaluator_eval_constant(EvalContext *ctx, mpfr_t result, const ASTNode *node)
+{
+    // The parser resolved the name; other trees fall back to the name lookup
+    if (!constants_get_by_type_ctx(ctx, result, node->constant.id) &&
+        !constants_get_by_name_ctx(ctx, result, node->constant.name))
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown constant: %s", node->constant.name);
+        mpfr_set_d(result, 0.0, ctx->rounding);
+    }
+}
+
+// Look up the definition a variable node refers to
+static Variable *evaluator_find_variable(EvalContext *ctx, const ASTNode *node)
+{
+    Variable *var = ctx->variables ? variables_find(ctx->variables, node->variable.name) : NULL;
+    if (!var || !var->definition)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Undefined variable: %.200s",
+                 node->variable.name);
+        return NULL;
+    }
+
+    // Literals like 0.1 are read again at a new precision, as a line is
+    variables_refresh(ctx->variables, var, ctx->precision);
+    return var;
+}
+
+static void evaluator_eval_variable(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                    int depth)
+{
+    mpfr_srcptr bound = ctx->binding_count
+                            ? eval_context_find_binding(ctx, node->variable.name)
+                            : NULL;
+    if (bound)
+    {
+        mpfr_set(result, bound, ctx->rounding);
+        return;
+    }
+
+    Variable *var = evaluator_find_variable(ctx, node);
+    if (!var)
+    {
+        mpfr_set_d(result, 0.0, ctx->rounding);
+        return;
+    }
+
+    if (!variables_is_current(var, ctx))
+    {
+        // The definition takes this node's place in the tree, so it can use
+        // the scratch levels from this depth down. Definitions cannot be
+        // circular, so the recursion ends. Variables bound by sum() and
+        // integrate() are not visible to it, so its value is the same
+        // wherever it is read.
+        int earlier_error = eval_context_get_error(ctx) != NULL;
+        int binding_count = ctx->binding_count;
+        ctx->binding_count = 0;
+        mpfr_set_prec(var->value, ctx->scratch_precision);
+        evaluator_eval_node(ctx, var->value, var->definition, depth);
+        ctx->binding_count = binding_count;
+        if (!earlier_error)
+        {
+            if (eval_context_get_error(ctx))
+            {
+                mpfr_set_d(result, 0.0, ctx->rounding);
+                return;
+            }
+            variables_set_current(var, ctx);
+        }
+    }
+
+    mpfr_set(result, var->value, ctx->rounding);
+}
+
+static void evaluator_eval_binop(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth)
+{
+    // Intermediate calculations use the pool's higher precision
+    ScratchLevel *level = scratch_get(ctx, depth);
+    if (!level)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+        mpfr_set_d(result, 0.0, ctx->rounding);
+        return;
+    }
+    mpfr_ptr left = level->operands[0];
+    mpfr_ptr right = level->operands[1];
+    mpfr_ptr high_prec_result = evaluator_target(level, result);
+
+    evaluator_eval_node(ctx, left, node->binop.left, depth + 1);
+    evaluator_eval_node(ctx, right, node->binop.right, depth + 1);
+
+    switch (node->binop.op)
+    {
+    case TOKEN_PLUS:
+        mpfr_add(high_prec_result, left, right, ctx->rounding);
+        break;
+    case TOKEN_MINUS:
+        mpfr_sub(high_prec_result, left, right, ctx->rounding);
+        break;
+    case TOKEN_STAR:
+        functions_mul(high_prec_result, left, right, ctx->rounding);
+        break;
+    case TOKEN_SLASH:
+        if (mpfr_zero_p(right))
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Division by zero");
+            mpfr_set_d(high_prec_result, 0.0, ctx->rounding);
+        }
+        else
+        {
+            functions_div(high_prec_result, left, right, ctx->rounding);
+        }
+        break;
+    case TOKEN_CARET:
+        functions_pow(high_prec_result, left, right, ctx->rounding);
+        break;
+    case TOKEN_EQ:
+        mpfr_set_d(high_prec_result, mpfr_equal_p(left, right) ? 1.0 : 0.0, ctx->rounding);
+        break;
+    case TOKEN_NEQ:
+        mpfr_set_d(high_prec_result, !mpfr_equal_p(left, right) ? 1.0 : 0.0, ctx->rounding);
+        break;
+    case TOKEN_LT:
+        mpfr_set_d(high_prec_result, mpfr_less_p(left, right) ? 1.0 : 0.0, ctx->rounding);
+        break;
+    case TOKEN_LTE:
+        mpfr_set_d(high_prec_result, mpfr_lessequal_p(left, right) ? 1.0 : 0.0, ctx->rounding);
+        break;
+    case TOKEN_GT:
+        mpfr_set_d(high_prec_result, mpfr_greater_p(left, right) ? 1.0 : 0.0, ctx->rounding);
+        break;
+    case TOKEN_GTE:
+        mpfr_set_d(high_prec_result, mpfr_greaterequal_p(left, right) ? 1.0 : 0.0, ctx->rounding);
+        break;
+    default:
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown binary operator");
+        mpfr_set_d(high_prec_result, 0.0, ctx->rounding);
+    }
+
+    // Round result back to user's precision
+    if (high_prec_result != result)
+    {
+        mpfr_set(result, high_prec_result, ctx->rounding);
+    }
+    EVALUATOR_STEP(ctx, result);
+}
+
+static void evaluator_eval_unary(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth)
+{
+    // Intermediate calculations use the pool's higher precision
+    ScratchLevel *level = scratch_get(ctx, depth);
+    if (!level)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+        mpfr_set_d(result, 0.0, ctx->rounding);
+        return;
+    }
+    mpfr_ptr operand = level->operands[0];
+    mpfr_ptr high_prec_result = evaluator_target(level, result);
+
+    evaluator_eval_node(ctx, operand, node->unary.operand, depth + 1);
+
+    switch (node->unary.op)
+    {
+    case TOKEN_PLUS:
+        mpfr_set(high_prec_result, operand, ctx->rounding);
+        break;
+    case TOKEN_MINUS:
+        mpfr_neg(high_prec_result, operand, ctx->rounding);
+        break;
+    default:
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown unary operator");
+        mpfr_set_d(high_prec_result, 0.0, ctx->rounding);
+    }
+
+    // Round result back to user's precision
+    if (high_prec_result != result)
+    {
+        mpfr_set(result, high_prec_result, ctx->rounding);
+    }
+    EVALUATOR_STEP(ctx, result);
+}
+
+static void evaluator_eval_nary(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth)
+{
+    ScratchLevel *level = scratch_get(ctx, depth);
+    int base = level ? terms_push(ctx, node->nary.count) : -1;
+    if (base < 0)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+        mpfr_set_d(result, 0.0, ctx->rounding);
+        return;
+    }
+
+    for (int i = 0; i < node->nary.count; i++)
+    {
+        evaluator_eval_node(ctx, ctx->terms[base + i], node->nary.operands[i], depth + 1);
+    }
+
+    // A sum is rounded once however many terms it has, so cancellation
+    // between them costs nothing
+    mpfr_ptr high_prec_result = evaluator_target(level, result);
+    if (node->nary.op == TOKEN_PLUS)
+    {
+        mpfr_sum(high_prec_result, ctx->terms + base, node->nary.count, ctx->rounding);
+    }
+    else
+    {
+        functions_product(high_prec_result, ctx->terms + base, node->nary.count, ctx->rounding);
+    }
+    ctx->term_top = base;
+
+    // Round result back to user's precision
+    if (high_prec_result != result)
+    {
+        mpfr_set(result, high_prec_result, ctx->rounding);
+    }
+    EVALUATOR_STEPS(ctx, result, node_steps(node));
+}
+
+static void evaluator_eval_function(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                    int depth)
+{
+    // Function arguments use the pool's higher precision to reduce cumulative error
+    ScratchLevel *level = scratch_get(ctx, depth);
+    if (!level || node->function.arg_count > SCRATCH_OPERANDS)
+    {
+        snprintf(ctx->error, sizeof(ctx->error),
+                 level ? "Too many function arguments" : "Out of memory");
+        mpfr_set_d(result, 0.0, ctx->rounding);
+        return;
+    }
+
+    for (int i = 0; i < node->function.arg_count; i++)
+    {
+        evaluator_eval_node(ctx, level->operands[i], node->function.args[i], depth + 1);
+    }
+
+    // Compute function at high precision then round to user's precision
+    mpfr_ptr high_prec_result = evaluator_target(level, result);
+
+    // Delegate to functions module
+    int success = functions_call(ctx, high_prec_result, node->function.def, level->operands);
+
+    if (!success && ctx->strict_mode)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Function evaluation failed: %.200s",
+                 ctx->function_error);
+    }
+
+    // Round result to user's precision
+    if (high_prec_result != result)
+    {
+        mpfr_set(result, high_prec_result, ctx->rounding);
+    }
+
+    evaluator_flush_tiny(result, ctx->precision);
+    EVALUATOR_STEP(ctx, result);
+}
+
+// Adaptive evaluation keeps a bound on the absolute error of every node:
+// the computed value is within 2^bound of the subtree's exact value, with
+// literals taken as the exact values they were parsed to. Intermediate
+// results round to nearest at a working precision a few guard bits above
+// the result's; a pass is accepted once its bound shows that rounding it
+// gives the correctly rounded result, and retried with more guard bits
+// otherwise.
+typedef mpfr_exp_t ErrorBound;
+
+#define ERROR_EXACT LONG_MIN     // Value is exact
+#define ERROR_UNBOUNDED LONG_MAX // No useful bound, e.g. near a singularity
+
+// Bound of the sum of two errors
+static ErrorBound error_sum(ErrorBound a, ErrorBound b)
+{
+    if (a == ERROR_UNBOUNDED || b == ERROR_UNBOUNDED)
+        return ERROR_UNBOUNDED;
+    if (a == ERROR_EXACT)
+        return b;
+    if (b == ERROR_EXACT)
+        return a;
+    return (a > b ? a : b) + 1;
+}
+
+// Bound of an error multiplied by 2^shift
+static ErrorBound error_scale(ErrorBound a, mpfr_exp_t shift)
+{
+    if (a == ERROR_EXACT || a == ERROR_UNBOUNDED)
+        return a;
+    return a + shift;
+}
+
+// Bound of the product of two errors
+static ErrorBound error_product(ErrorBound a, ErrorBound b)
+{
+    if (a == ERROR_EXACT || b == ERROR_EXACT)
+        return ERROR_EXACT;
+    if (a == ERROR_UNBOUNDED || b == ERROR_UNBOUNDED)
+        return ERROR_UNBOUNDED;
+    return a + b;
+}
+
+// Bound of an error multiplied by |x|
+static ErrorBound error_times(ErrorBound a, mpfr_srcptr x)
+{
+    if (a == ERROR_EXACT || mpfr_zero_p(x))
+        return ERROR_EXACT;
+    if (!mpfr_regular_p(x))
+        return ERROR_UNBOUNDED;
+    return error_scale(a, mpfr_get_exp(x));
+}
+
+// Add the rounding error of a result computed at its own precision
+static ErrorBound error_rounded(ErrorBound a, mpfr_srcptr result, int inexact)
+{
+    if (!inexact)
+        return a;
+    if (!mpfr_regular_p(result))
+        return ERROR_UNBOUNDED; // Overflow or underflow
+    return error_sum(a, mpfr_get_exp(result) - (mpfr_exp_t)mpfr_get_prec(result));
+}
+
+// Check that an error is at most |x| / 2^shift, so x keeps its sign and
+// magnitude over the whole error interval. Zero, infinite and NaN values
+// have no magnitude, so callers may read the exponent of x when this holds.
+static int error_below(ErrorBound a, mpfr_srcptr x, mpfr_exp_t shift)
+{
+    if (!mpfr_regular_p(x))
+        return 0;
+    return a == ERROR_EXACT || (a != ERROR_UNBOUNDED && a <= mpfr_get_exp(x) - shift);
+}
+
+// ceil(e / 2) for either sign
+static mpfr_exp_t exp_half_up(mpfr_exp_t e)
+{
+    return e >= 0 ? (e + 1) / 2 : -((-e) / 2);
+}
+
+static ErrorBound adaptive_eval_node(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                     int depth);
+
+// Evaluate sum() or integrate(): the bounds once, then the body for many
+// values of the variable the call binds (see reduce.h). Both evaluation
+// modes use it; the bound it returns is only read by the adaptive passes.
+static ErrorBound evaluator_eval_reduction(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                           int depth)
+{
+    ScratchLevel *level = scratch_get(ctx, depth);
+    if (!level)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+        mpfr_set_nan(result);
+        return ERROR_UNBOUNDED;
+    }
+
+    // The body is evaluated from the next level down, which leaves the
+    // bounds in place
+    evaluator_eval_node(ctx, level->operands[0], node->function.args[2], depth + 1);
+    evaluator_eval_node(ctx, level->operands[1], node->function.args[3], depth + 1);
+    if (ctx->budget_exceeded || eval_context_get_error(ctx))
+    {
+        mpfr_set_nan(result);
+        return ERROR_UNBOUNDED;
+    }
+
+    // Every term costs a full evaluation of the body, so the reduction
+    // stops a few guard bits past the user's precision rather than at the
+    // working precision
+    mpfr_prec_t precision = ctx->precision + REDUCE_GUARD_BITS;
+    if (precision > mpfr_get_prec(result))
+    {
+        precision = mpfr_get_prec(result);
+    }
+
+    PROFILE_START(start);
+    ErrorBound error = ERROR_UNBOUNDED;
+    int ok = reduce_eval(ctx, result, node, level->operands[0], level->operands[1], precision,
+                         depth + 1, &error);
+    PROFILE_FUNCTION(node->function.func_type, start);
+
+    // Shared values computed for the last point do not hold outside the call
+    ctx->shared_pass++;
+    return ok ? error : ERROR_UNBOUNDED;
+}
+
+// Error of x^y from the errors of x and y:
+// |d(x^y)| <= |x^y| * (|y| * |dx| / |x| + |ln x| * |dy|)
+static ErrorBound adaptive_pow_error(mpfr_srcptr result, mpfr_srcptr x, ErrorBound ex,
+                                     mpfr_srcptr y, ErrorBound ey)
+{
+    if (!mpfr_number_p(result))
+        return ERROR_UNBOUNDED; // A domain error or a pole, e.g. (-2)^0.5 or 0^-1
+    if (ex == ERROR_EXACT && ey == ERROR_EXACT)
+        return ERROR_EXACT;
+    if (ex == ERROR_UNBOUNDED || ey == ERROR_UNBOUNDED || !mpfr_regular_p(result) ||
+        !error_below(ex, x, 2))
+        return ERROR_UNBOUNDED;
+    if (mpfr_sgn(x) < 0 && ey != ERROR_EXACT)
+        return ERROR_UNBOUNDED; // An inexact exponent may not be an integer
+
+    // |y| + ey and |ln x'| for x' within a factor of 2 of x
+    mpfr_exp_t y_exp = mpfr_regular_p(y) ? mpfr_get_exp(y) : ERROR_EXACT;
+    if (ey != ERROR_EXACT && ey > y_exp)
+        y_exp = ey;
+    unsigned long log_bound = labs((long)mpfr_get_exp(x)) + 2;
+    mpfr_exp_t log_exp = 0;
+    while (log_bound >> log_exp)
+        log_exp++;
+
+    ErrorBound relative = ERROR_EXACT;
+    if (y_exp != ERROR_EXACT)
+        relative = error_scale(ex, y_exp + 1 + 2 - mpfr_get_exp(x));
+    relative = error_sum(relative, error_scale(ey, log_exp));
+    if (relative != ERROR_EXACT && relative > -2)
+        return ERROR_UNBOUNDED;
+
+    // e^r - 1 <= 2r for r <= 1/4
+    return error_scale(relative, mpfr_get_exp(result) + 1);
+}
+
+// Error a comparison result inherits: none if the difference of its
+// operands is larger than their combined error, unbounded otherwise
+static ErrorBound adaptive_compare_error(mpfr_ptr scratch, mpfr_srcptr left, ErrorBound el,
+                                         mpfr_srcptr right, ErrorBound er)
+{
+    if (el == ERROR_EXACT && er == ERROR_EXACT)
+        return ERROR_EXACT;
+
+    int inexact = mpfr_sub(scratch, left, right, MPFR_RNDN);
+    ErrorBound difference = error_rounded(error_sum(el, er), scratch, inexact);
+    return error_below(difference, scratch, 1) ? ERROR_EXACT : ERROR_UNBOUNDED;
+}
+
+static ErrorBound adaptive_eval_binop(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                      int depth)
+{
+    ScratchLevel *level = scratch_get(ctx, depth);
+    if (!level)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+        mpfr_set_d(result, 0.0, MPFR_RNDN);
+        return ERROR_UNBOUNDED;
+    }
+    mpfr_ptr left = level->operands[0];
+    mpfr_ptr right = level->operands[1];
+
+    ErrorBound el = adaptive_eval_node(ctx, left, node->binop.left, depth + 1);
+    ErrorBound er = adaptive_eval_node(ctx, right, node->binop.right, depth + 1);
+
+    int inexact;
+    ErrorBound error;
+    switch (node->binop.op)
+    {
+    case TOKEN_PLUS:
+        inexact = mpfr_add(result, left, right, MPFR_RNDN);
+        return error_rounded(error_sum(el, er), result, inexact);
+    case TOKEN_MINUS:
+        inexact = mpfr_sub(result, left, right, MPFR_RNDN);
+        return error_rounded(error_sum(el, er), result, inexact);
+    case TOKEN_STAR:
+        // |xy - XY| <= |y| ex + |x| ey + ex ey
+        inexact = functions_mul(result, left, right, MPFR_RNDN);
+        error = error_sum(error_sum(error_times(el, right), error_times(er, left)),
+                          error_product(el, er));
+        return error_rounded(error, result, inexact);
+    case TOKEN_SLASH:
+        if (mpfr_zero_p(right))
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Division by zero");
+            mpfr_set_d(result, 0.0, MPFR_RNDN);
+            return ERROR_EXACT;
+        }
+        inexact = functions_div(result, left, right, MPFR_RNDN);
+        if (!error_below(er, right, 2))
+        {
+            return ERROR_UNBOUNDED;
+        }
+        // |x/y - X/Y| <= ex / |y| + 2 (|x| + ex) ey / y^2
+        error = error_sum(error_scale(el, 1 - mpfr_get_exp(right)),
+                          error_scale(error_sum(error_times(er, left), error_product(el, er)),
+                                      3 - 2 * mpfr_get_exp(right)));
+        return error_rounded(error, result, inexact);
+    case TOKEN_CARET:
+        inexact = functions_pow(result, left, right, MPFR_RNDN);
+        return error_rounded(adaptive_pow_error(result, left, el, right, er), result, inexact);
+    case TOKEN_EQ:
+        mpfr_set_ui(result, mpfr_equal_p(left, right), MPFR_RNDN);
+        break;
+    case TOKEN_NEQ:
+        mpfr_set_ui(result, !mpfr_equal_p(left, right), MPFR_RNDN);
+        break;
+    case TOKEN_LT:
+        mpfr_set_ui(result, mpfr_less_p(left, right), MPFR_RNDN);
+        break;
+    case TOKEN_LTE:
+        mpfr_set_ui(result, mpfr_lessequal_p(left, right), MPFR_RNDN);
+        break;
+    case TOKEN_GT:
+        mpfr_set_ui(result, mpfr_greater_p(left, right), MPFR_RNDN);
+        break;
+    case TOKEN_GTE:
+        mpfr_set_ui(result, mpfr_greaterequal_p(left, right), MPFR_RNDN);
+        break;
+    default:
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown binary operator");
+        mpfr_set_d(result, 0.0, MPFR_RNDN);
+        return ERROR_EXACT;
+    }
+
+    return adaptive_compare_error(level->result, left, el, right, er);
+}
+
+static ErrorBound adaptive_eval_unary(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                      int depth)
+{
+    ScratchLevel *level = scratch_get(ctx, depth);
+    if (!level)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+        mpfr_set_d(result, 0.0, MPFR_RNDN);
+        return ERROR_UNBOUNDED;
+    }
+    mpfr_ptr operand = level->operands[0];
+
+    ErrorBound error = adaptive_eval_node(ctx, operand, node->unary.operand, depth + 1);
+
+    switch (node->unary.op)
+    {
+    case TOKEN_PLUS:
+        mpfr_set(result, operand, MPFR_RNDN);
+        return error;
+    case TOKEN_MINUS:
+        mpfr_neg(result, operand, MPFR_RNDN);
+        return error;
+    default:
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown unary operator");
+        mpfr_set_d(result, 0.0, MPFR_RNDN);
+        return ERROR_EXACT;
+    }
+}
+
+static ErrorBound adaptive_eval_nary(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                     int depth)
+{
+    int count = node->nary.count;
+    int base = terms_push(ctx, count);
+    if (base < 0)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+        mpfr_set_d(result, 0.0, MPFR_RNDN);
+        return ERROR_UNBOUNDED;
+    }
+
+    ErrorBound error = ERROR_EXACT;
+    int inexact;
+    if (node->nary.op == TOKEN_PLUS)
+    {
+        // The terms' errors add up to at most count times the largest
+        for (int i = 0; i < count; i++)
+        {
+            ErrorBound term = adaptive_eval_node(ctx, ctx->terms[base + i],
+                                                 node->nary.operands[i], depth + 1);
+            if (term == ERROR_UNBOUNDED || (error != ERROR_UNBOUNDED && term > error))
+                error = term;
+        }
+        mpfr_exp_t spread = 0;
+        while ((1L << spread) < count)
+            spread++;
+        inexact = mpfr_sum(result, ctx->terms + base, count, MPFR_RNDN);
+        ctx->term_top = base;
+        return error_rounded(error_scale(error, spread), result, inexact);
+    }
+
+    // Products are taken in order so each step's error is bounded like a
+    // binary product's: |xy - XY| <= |y| ex + |x| ey + ex ey
+    error = adaptive_eval_node(ctx, result, node->nary.operands[0], depth + 1);
+    for (int i = 1; i < count; i++)
+    {
+        mpfr_ptr factor = ctx->terms[base + i];
+        ErrorBound ef = adaptive_eval_node(ctx, factor, node->nary.operands[i], depth + 1);
+        error = error_sum(error_sum(error_times(error, factor), error_times(ef, result)),
+                          error_product(error, ef));
+        inexact = functions_mul(result, result, factor, MPFR_RNDN);
+        error = error_rounded(error, result, inexact);
+    }
+    ctx->term_top = base;
+    return error;
+}
+
+// Check that floor() or ceil() of x is the same over the error interval:
+// frac is the distance from x to the integer below or above it
+static ErrorBound adaptive_step_error(mpfr_ptr frac, ErrorBound error)
+{
+    if (mpfr_zero_p(frac) || !error_below(error_scale(error, 1), frac, 1))
+    {
+        return ERROR_UNBOUNDED;
+    }
+    mpfr_ui_sub(frac, 1, frac, MPFR_RNDD);
+    return error_below(error_scale(error, 1), frac, 1) ? ERROR_EXACT : ERROR_UNBOUNDED;
+}
+
+// Error of a one-argument function from the error of its argument, using a
+// bound on |f'| over the error interval. scratch is free for temporaries.
+static ErrorBound adaptive_function_error(TokenType func_type, mpfr_srcptr result, mpfr_srcptr x,
+                                          ErrorBound error, mpfr_ptr scratch)
+{
+    mpfr_exp_t result_exp = mpfr_regular_p(result) ? mpfr_get_exp(result) : 0;
+
+    switch (func_type)
+    {
+    // |f'| <= 1
+    case TOKEN_SIN:
+    case TOKEN_COS:
+    case TOKEN_ATAN:
+    case TOKEN_TANH:
+    case TOKEN_ASINH:
+    case TOKEN_ABS:
+        return error;
+
+    // f' = 1 + tan^2, kept finite by staying well away from the poles
+    case TOKEN_TAN:
+    {
+        mpfr_exp_t t = result_exp > 0 ? result_exp : 0;
+        return error != ERROR_UNBOUNDED && error <= -(t + 3) ? error + 2 * t + 3
+                                                              : ERROR_UNBOUNDED;
+    }
+
+    // f' <= 2 |f| for an argument error of at most 1/4
+    case TOKEN_EXP:
+        if (!mpfr_regular_p(result) || !(error <= -2))
+            return ERROR_UNBOUNDED;
+        return error_scale(error, result_exp + 1);
+
+    // f' <= 4 max(|f|, 1) for an argument error of at most 1/4
+    case TOKEN_SINH:
+    case TOKEN_COSH:
+        if (!(error <= -2))
+            return ERROR_UNBOUNDED;
+        return error_scale(error, (result_exp > 1 ? result_exp : 1) + 2);
+
+    // f' <= 1 / (2 sqrt(x / 2))
+    case TOKEN_SQRT:
+        if (mpfr_sgn(x) <= 0 || !error_below(error, x, 2))
+            return ERROR_UNBOUNDED;
+        return error_scale(error, exp_half_up(1 - mpfr_get_exp(x)));
+
+    // f' <= 2 / x
+    case TOKEN_LOG:
+    case TOKEN_LOG10:
+        if (mpfr_sgn(x) <= 0 || !error_below(error, x, 2))
+            return ERROR_UNBOUNDED;
+        return error_scale(error, 2 - mpfr_get_exp(x));
+
+    // Bounded by the distance d from x to the singularity at 1 (or -1)
+    case TOKEN_ASIN:
+    case TOKEN_ACOS:
+    case TOKEN_ATANH:
+    case TOKEN_ACOSH:
+    {
+        if (func_type == TOKEN_ACOSH)
+            mpfr_sub_ui(scratch, x, 1, MPFR_RNDD);
+        else if (mpfr_sgn(x) < 0)
+            mpfr_add_ui(scratch, x, 1, MPFR_RNDD);
+        else
+            mpfr_ui_sub(scratch, 1, x, MPFR_RNDD);
+        if (mpfr_sgn(scratch) <= 0 || !error_below(error, scratch, 3))
+            return ERROR_UNBOUNDED;
+
+        // f' <= 2 / d for atanh, f' <= sqrt(2 / d) for the others
+        mpfr_exp_t distance_exp = mpfr_get_exp(scratch);
+        if (func_type == TOKEN_ATANH)
+            return error_scale(error, 2 - distance_exp);
+        return error_scale(error, exp_half_up(2 - distance_exp));
+    }
+
+    // Exact unless an integer lies within the error interval
+    case TOKEN_FLOOR:
+    case TOKEN_CEIL:
+        if (func_type == TOKEN_FLOOR)
+            mpfr_sub(scratch, x, result, MPFR_RNDD);
+        else
+            mpfr_sub(scratch, result, x, MPFR_RNDD);
+        return adaptive_step_error(scratch, error);
+
+    default:
+        return ERROR_UNBOUNDED;
+    }
+}
+
+// Error of atan2(y, x): both partial derivatives are at most 1 / |(x, y)|,
+// and the result jumps across the branch cut on the negative x axis
+static ErrorBound adaptive_atan2_error(mpfr_srcptr y, ErrorBound ey, mpfr_srcptr x, ErrorBound ex)
+{
+    int y_nonzero = !mpfr_zero_p(y) && error_below(ey, y, 2);
+    int x_positive = mpfr_sgn(x) > 0 && error_below(ex, x, 2);
+    if (!y_nonzero && !x_positive)
+        return ERROR_UNBOUNDED;
+
+    mpfr_exp_t magnitude = mpfr_regular_p(y) ? mpfr_get_exp(y) : mpfr_get_exp(x);
+    if (mpfr_regular_p(x) && mpfr_get_exp(x) > magnitude)
+        magnitude = mpfr_get_exp(x);
+
+    ErrorBound error = error_sum(ey, ex);
+    if (error != ERROR_EXACT && error > magnitude - 3)
+        return ERROR_UNBOUNDED;
+    return error_scale(error, 2 - magnitude);
+}
+
+static ErrorBound adaptive_eval_function(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                         int depth)
+{
+    ScratchLevel *level = scratch_get(ctx, depth);
+    if (!level || node->function.arg_count > SCRATCH_OPERANDS)
+    {
+        snprintf(ctx->error, sizeof(ctx->error),
+                 level ? "Too many function arguments" : "Out of memory");
+        mpfr_set_d(result, 0.0, MPFR_RNDN);
+        return ERROR_UNBOUNDED;
+    }
+
+    ErrorBound errors[SCRATCH_OPERANDS] = {ERROR_EXACT, ERROR_EXACT};
+    int exact_args = 1;
+    for (int i = 0; i < node->function.arg_count; i++)
+    {
+        errors[i] = adaptive_eval_node(ctx, level->operands[i], node->function.args[i], depth + 1);
+        exact_args = exact_args && errors[i] == ERROR_EXACT;
+    }
+
+    // The functions module does not return a ternary value; MPFR's inexact
+    // flag tells whether its result was rounded
+    mpfr_clear_inexflag();
+    int success = functions_call(ctx, result, node->function.def, level->operands);
+    int inexact = mpfr_inexflag_p();
+
+    if (!success && ctx->strict_mode)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Function evaluation failed: %.200s",
+                 ctx->function_error);
+    }
+    if (!success || exact_args)
+    {
+        return error_rounded(ERROR_EXACT, result, inexact);
+    }
+
+    ErrorBound error;
+    switch (node->function.func_type)
+    {
+    case TOKEN_POW:
+        error = adaptive_pow_error(result, level->operands[0], errors[0], level->operands[1],
+                                   errors[1]);
+        break;
+    case TOKEN_ATAN2:
+        error = adaptive_atan2_error(level->operands[0], errors[0], level->operands[1], errors[1]);
+        break;
+    default:
+        error = adaptive_function_error(node->function.func_type, result, level->operands[0],
+                                        errors[0], level->operands[1]);
+    }
+    return error_rounded(error, result, inexact);
+}
 
-void evaluator_eval(mpfr_t result, const ASTNode *node)
+static ErrorBound adaptive_eval_node(EvalContext *ctx, mpfr_t result, const ASTNode *node,
+                                     int depth)
 {
-    evaluator_clear_error();
-
+    if (ctx->budget_exceeded)
+    {
+        mpfr_set_nan(result);
+        return ERROR_UNBOUNDED;
+    }
     if (!node)
     {
-        mpfr_set_d(result, 0.0, global_rounding);
-        return;
+        mpfr_set_zero(result, 0);
+        return ERROR_EXACT;
+    }
+
+    if (node->share >= 0)
+    {
+        const SharedValue *shared = shared_lookup(ctx, node, result);
+        if (shared)
+        {
+            mpfr_set(result, shared->value, MPFR_RNDN);
+            return shared->error;
+        }
+    }
+
+    ErrorBound error;
+    long operations = ctx->progress_done;
+
+    // An exact subtree only carries the error of its final rounding
+    int declined = 0;
+    if (exact_candidate(ctx, node))
+    {
+        int inexact;
+        if (evaluator_eval_exact_node(ctx, result, node, MPFR_RNDN, &inexact))
+        {
+            error = error_rounded(ERROR_EXACT, result, inexact);
+            EVALUATOR_STEP(ctx, result);
+            if (node->share >= 0)
+            {
+                shared_store(ctx, node, result, error, ctx->progress_done - operations);
+            }
+            return error;
+        }
+        ctx->exact_declined = declined = 1;
     }
 
     switch (node->type)
     {
     case NODE_NUMBER:
-        mpfr_set(result, node->number.value, global_rounding);
-        break;
+        if (node->number.literal->folded_from)
+        {
+            // A folded value has unknown error: evaluate what it replaced
+            return adaptive_eval_node(ctx, result, node->number.literal->folded_from, depth);
+        }
+        return error_rounded(ERROR_EXACT, result,
+                             mpfr_set(result, node->number.literal->value, MPFR_RNDN));
 
     case NODE_CONSTANT:
-        evaluator_eval_constant(result, node->constant.name);
-        break;
+        if (!constants_get_by_type_ctx(ctx, result, node->constant.id) &&
+            !constants_get_by_name_ctx(ctx, result, node->constant.name))
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Unknown constant: %s",
+                     node->constant.name);
+            mpfr_set_d(result, 0.0, MPFR_RNDN);
+            return ERROR_EXACT;
+        }
+        return error_rounded(ERROR_EXACT, result, 1);
+
+    case NODE_VARIABLE:
+    {
+        // The points sum() and integrate() bind count as exact; the
+        // reduction bounds its own error
+        mpfr_srcptr bound = ctx->binding_count
+                                ? eval_context_find_binding(ctx, node->variable.name)
+                                : NULL;
+        if (bound)
+        {
+            return error_rounded(ERROR_EXACT, result, mpfr_set(result, bound, MPFR_RNDN));
+        }
+
+        // Cached values have no error bound, so definitions are evaluated
+        // again at the pass's precision
+        const Variable *var = evaluator_find_variable(ctx, node);
+        if (!var)
+        {
+            mpfr_set_d(result, 0.0, MPFR_RNDN);
+            return ERROR_EXACT;
+        }
+        int binding_count = ctx->binding_count;
+        ctx->binding_count = 0;
+        error = adaptive_eval_node(ctx, result, var->definition, depth);
+        ctx->binding_count = binding_count;
+        return error;
+    }
 
     case NODE_BINOP:
-        evaluator_eval_binop(result, node);
+        error = adaptive_eval_binop(ctx, result, node, depth);
         break;
 
     case NODE_UNARY:
-        evaluator_eval_unary(result, node);
+        error = adaptive_eval_unary(ctx, result, node, depth);
+        break;
+
+    case NODE_NARY:
+        error = adaptive_eval_nary(ctx, result, node, depth);
         break;
 
     case NODE_FUNCTION:
-        evaluator_eval_function(result, node);
+        if (token_binds_variable(node->function.func_type))
+        {
+            error = evaluator_eval_reduction(ctx, result, node, depth);
+        }
+        else
+        {
+            error = adaptive_eval_function(ctx, result, node, depth);
+        }
         break;
 
     default:
-        snprintf(last_error, sizeof(last_error), "Unknown node type");
-        mpfr_set_d(result, 0.0, global_rounding);
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown node type");
+        mpfr_set_d(result, 0.0, MPFR_RNDN);
+        return ERROR_EXACT;
+    }
+
+    if (declined)
+    {
+        ctx->exact_declined = 0;
+    }
+    EVALUATOR_STEPS(ctx, result, node_steps(node));
+    if (node->share >= 0)
+    {
+        shared_store(ctx, node, result, error, ctx->progress_done - operations);
     }
+    return error;
+}
+
+// Check whether a pass's value rounds correctly to the target precision
+static int adaptive_can_round(mpfr_srcptr value, ErrorBound error, mpfr_prec_t precision,
+                              mpfr_rnd_t rounding)
+{
+    if (error == ERROR_EXACT || !mpfr_number_p(value))
+        return 1; // Exact, or NaN or infinite whatever the precision
+    if (error == ERROR_UNBOUNDED || mpfr_zero_p(value))
+        return 0;
+
+    mpfr_exp_t correct_bits = mpfr_get_exp(value) - error;
+    return correct_bits > 0 &&
+           mpfr_can_round(value, correct_bits, MPFR_RNDN, rounding,
+                          precision + (rounding == MPFR_RNDN));
 }
 
-static void evaluator_eval_constant(mpfr_t result, const char *const_name)
+static void evaluator_eval_adaptive(EvalContext *ctx, mpfr_t result, const ASTNode *node)
 {
-    // Use the metadata-driven lookup!
-    if (!constants_get_by_name(result, const_name))
+    mpfr_prec_t target = mpfr_get_prec(result);
+    mpfr_prec_t guard = EVALUATOR_ADAPTIVE_GUARD;
+    mpfr_prec_t max_guard = 4 * target > EVALUATOR_ADAPTIVE_MAX_GUARD ? 4 * target
+                                                                      : EVALUATOR_ADAPTIVE_MAX_GUARD;
+
+    // Every step rounds to nearest so errors are symmetric; the context's
+    // rounding mode only applies to the final result
+    mpfr_rnd_t rounding = ctx->rounding;
+    ctx->rounding = MPFR_RNDN;
+    ctx->adaptive_passes = 0;
+
+    ScratchLevel *root = NULL;
+    int settled = 0;
+    for (;;)
+    {
+        mpfr_prec_t working = target + guard;
+        scratch_sync_precision(ctx, working);
+        root = scratch_get(ctx, 0);
+        if (!root)
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+            break;
+        }
+
+        eval_context_clear_error(ctx);
+        ctx->function_error[0] = '\0';
+        ctx->progress_done = 0;
+        ctx->shared_pass++;
+        ErrorBound error = adaptive_eval_node(ctx, root->result, node, 1);
+        ctx->adaptive_passes++;
+
+        // Errors and function failures don't go away with more precision
+        if (ctx->budget_exceeded || eval_context_get_error(ctx) || ctx->function_error[0] ||
+            adaptive_can_round(root->result, error, target, rounding))
+        {
+            settled = 1;
+            break;
+        }
+        if (guard >= max_guard)
+        {
+            break;
+        }
+
+        // Double the guard, or skip straight past the bits known to be lost
+        mpfr_prec_t next = 2 * guard;
+        if (error != ERROR_UNBOUNDED && mpfr_regular_p(root->result))
+        {
+            mpfr_exp_t lost = working - (mpfr_get_exp(root->result) - error);
+            if (lost + EVALUATOR_ADAPTIVE_GUARD > next)
+                next = lost + EVALUATOR_ADAPTIVE_GUARD;
+        }
+        guard = next < max_guard ? next : max_guard;
+    }
+    ctx->rounding = rounding;
+
+    if (!root)
+    {
+        mpfr_set_d(result, 0.0, rounding);
+        return;
+    }
+    mpfr_set(result, root->result, rounding);
+
+    // A result that could not be settled (an exact zero such as sin(pi),
+    // or a discontinuity) gets the fixed evaluator's treatment of tiny values
+    if (!settled)
     {
-        snprintf(last_error, sizeof(last_error), "Unknown constant: %s", const_name);
-        mpfr_set_d(result, 0.0, global_rounding);
+        evaluator_flush_tiny(result, ctx->precision);
     }
 }
 
-// Extra precision for binary operations to minimize rounding errors
-#define BINOP_PRECISION_BOOST 128
+// Interval evaluation encloses every node's value in bounds rounded
+// outward, so the root's bounds hold the exact value after one pass.
+// Temporaries are made per node: a pass runs once, and the pool's levels
+// hold points, not intervals.
+static void interval_eval_node(EvalContext *ctx, Interval *result, const ASTNode *node);
 
-static void evaluator_eval_binop(mpfr_t result, const ASTNode *node)
+// Comparisons are 1 or 0 where the bounds decide them, [0, 1] where not
+static void interval_eval_compare(Interval *result, TokenType op, const Interval *left,
+                                  const Interval *right)
 {
-    // Use higher precision for intermediate calculations
-    mpfr_prec_t high_prec = global_precision + BINOP_PRECISION_BOOST;
-
-    mpfr_t left, right, high_prec_result;
-    mpfr_init2(left, high_prec);
-    mpfr_init2(right, high_prec);
-    mpfr_init2(high_prec_result, high_prec);
+    int certain = 0;   // Holds for every pair of values
+    int impossible = 0; // Holds for none
+    switch (op)
+    {
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+        certain = interval_is_point(left) && interval_is_point(right) &&
+                  mpfr_equal_p(left->lo, right->lo);
+        impossible = mpfr_less_p(left->hi, right->lo) || mpfr_less_p(right->hi, left->lo);
+        if (op == TOKEN_NEQ)
+        {
+            int swap = certain;
+            certain = impossible;
+            impossible = swap;
+        }
+        break;
+    case TOKEN_LT:
+        certain = mpfr_less_p(left->hi, right->lo);
+        impossible = mpfr_greaterequal_p(left->lo, right->hi);
+        break;
+    case TOKEN_LTE:
+        certain = mpfr_lessequal_p(left->hi, right->lo);
+        impossible = mpfr_greater_p(left->lo, right->hi);
+        break;
+    case TOKEN_GT:
+        certain = mpfr_greater_p(left->lo, right->hi);
+        impossible = mpfr_lessequal_p(left->hi, right->lo);
+        break;
+    default:
+        certain = mpfr_greaterequal_p(left->lo, right->hi);
+        impossible = mpfr_less_p(left->hi, right->lo);
+        break;
+    }
+    mpfr_set_ui(result->lo, certain, MPFR_RNDN);
+    mpfr_set_ui(result->hi, !impossible, MPFR_RNDN);
+}
 
-    evaluator_eval(left, node->binop.left);
-    evaluator_eval(right, node->binop.right);
+static void interval_eval_binop(EvalContext *ctx, Interval *result, const ASTNode *node)
+{
+    Interval left, right;
+    interval_init2(&left, mpfr_get_prec(result->lo));
+    interval_init2(&right, mpfr_get_prec(result->lo));
+    interval_eval_node(ctx, &left, node->binop.left);
+    interval_eval_node(ctx, &right, node->binop.right);
 
     switch (node->binop.op)
     {
     case TOKEN_PLUS:
-        mpfr_add(high_prec_result, left, right, global_rounding);
+        interval_add(result, &left, &right);
         break;
     case TOKEN_MINUS:
-        mpfr_sub(high_prec_result, left, right, global_rounding);
+        interval_sub(result, &left, &right);
         break;
     case TOKEN_STAR:
-        mpfr_mul(high_prec_result, left, right, global_rounding);
+        interval_mul(result, &left, &right);
         break;
     case TOKEN_SLASH:
-        if (mpfr_zero_p(right))
+        if (interval_is_point(&right) && mpfr_zero_p(right.lo))
         {
-            snprintf(last_error, sizeof(last_error), "Division by zero");
-            mpfr_set_d(high_prec_result, 0.0, global_rounding);
+            snprintf(ctx->error, sizeof(ctx->error), "Division by zero");
+            mpfr_set_zero(result->lo, 1);
+            mpfr_set_zero(result->hi, 1);
         }
         else
         {
-            mpfr_div(high_prec_result, left, right, global_rounding);
+            interval_div(result, &left, &right);
         }
         break;
     case TOKEN_CARET:
-        mpfr_pow(high_prec_result, left, right, global_rounding);
+        interval_pow(result, &left, &right);
         break;
     case TOKEN_EQ:
-        mpfr_set_d(high_prec_result, mpfr_equal_p(left, right) ? 1.0 : 0.0, global_rounding);
-        break;
     case TOKEN_NEQ:
-        mpfr_set_d(high_prec_result, !mpfr_equal_p(left, right) ? 1.0 : 0.0, global_rounding);
-        break;
     case TOKEN_LT:
-        mpfr_set_d(high_prec_result, mpfr_less_p(left, right) ? 1.0 : 0.0, global_rounding);
-        break;
     case TOKEN_LTE:
-        mpfr_set_d(high_prec_result, mpfr_lessequal_p(left, right) ? 1.0 : 0.0, global_rounding);
-        break;
     case TOKEN_GT:
-        mpfr_set_d(high_prec_result, mpfr_greater_p(left, right) ? 1.0 : 0.0, global_rounding);
-        break;
     case TOKEN_GTE:
-        mpfr_set_d(high_prec_result, mpfr_greaterequal_p(left, right) ? 1.0 : 0.0, global_rounding);
+        interval_eval_compare(result, node->binop.op, &left, &right);
         break;
     default:
-        snprintf(last_error, sizeof(last_error), "Unknown binary operator");
-        mpfr_set_d(high_prec_result, 0.0, global_rounding);
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown binary operator");
+        mpfr_set_zero(result->lo, 1);
+        mpfr_set_zero(result->hi, 1);
     }
 
-    // Round result back to user's precision
-    mpfr_set(result, high_prec_result, global_rounding);
+    interval_clear(&right);
+    interval_clear(&left);
+}
+
+// Sums and products fold their operands in from the left
+static void interval_eval_nary(EvalContext *ctx, Interval *result, const ASTNode *node)
+{
+    Interval operand;
+    interval_init2(&operand, mpfr_get_prec(result->lo));
+
+    interval_eval_node(ctx, result, node->nary.operands[0]);
+    for (int i = 1; i < node->nary.count; i++)
+    {
+        interval_eval_node(ctx, &operand, node->nary.operands[i]);
+        if (node->nary.op == TOKEN_PLUS)
+        {
+            interval_add(result, result, &operand);
+        }
+        else
+        {
+            interval_mul(result, result, &operand);
+        }
+    }
 
-    mpfr_clear(high_prec_result);
-    mpfr_clear(left);
-    mpfr_clear(right);
+    interval_clear(&operand);
 }
 
-// Extra precision for unary operations
-#define UNARY_PRECISION_BOOST 128
+static void interval_eval_function(EvalContext *ctx, Interval *result, const ASTNode *node)
+{
+    // The quadrature and the long sums give estimates, not bounds, and
+    // registered functions have no interval version
+    if (!node->function.def || !node->function.def->interval)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "%s cannot be evaluated in interval mode",
+                 function_table_get_name(node->function.func_type));
+        mpfr_set_nan(result->lo);
+        mpfr_set_nan(result->hi);
+        return;
+    }
+    if (node->function.arg_count > SCRATCH_OPERANDS)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Too many function arguments");
+        mpfr_set_zero(result->lo, 1);
+        mpfr_set_zero(result->hi, 1);
+        return;
+    }
+
+    Interval args[SCRATCH_OPERANDS];
+    for (int i = 0; i < node->function.arg_count; i++)
+    {
+        interval_init2(&args[i], mpfr_get_prec(result->lo));
+        interval_eval_node(ctx, &args[i], node->function.args[i]);
+    }
+
+    int success = functions_eval_interval(ctx, result, node->function.func_type, args,
+                                          node->function.arg_count);
+    if (!success && ctx->strict_mode)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Function evaluation failed: %.200s",
+                 ctx->function_error);
+    }
+
+    for (int i = 0; i < node->function.arg_count; i++)
+    {
+        interval_clear(&args[i]);
+    }
+}
 
-static void evaluator_eval_unary(mpfr_t result, const ASTNode *node)
+static void interval_eval_node(EvalContext *ctx, Interval *result, const ASTNode *node)
 {
-    // Use higher precision for intermediate calculations
-    mpfr_prec_t high_prec = global_precision + UNARY_PRECISION_BOOST;
+    if (ctx->budget_exceeded)
+    {
+        interval_set_nan(result);
+        return;
+    }
+    if (!node)
+    {
+        mpfr_set_zero(result->lo, 1);
+        mpfr_set_zero(result->hi, 1);
+        return;
+    }
 
-    mpfr_t operand, high_prec_result;
-    mpfr_init2(operand, high_prec);
-    mpfr_init2(high_prec_result, high_prec);
-    evaluator_eval(operand, node->unary.operand);
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (node->number.literal->folded_from)
+        {
+            // A folded value was rounded: evaluate what it replaced
+            interval_eval_node(ctx, result, node->number.literal->folded_from);
+            return;
+        }
+        // Integer literals are exact; decimals were rounded to nearest at
+        // the literal's precision, often coarser than the interval's
+        if (node->exact)
+        {
+            interval_set_fr(result, node->number.literal->value);
+        }
+        else
+        {
+            interval_set_rounded(result, node->number.literal->value);
+        }
+        return;
 
-    switch (node->unary.op)
+    case NODE_CONSTANT:
+        if (!interval_set_constant(result, node->constant.id))
+        {
+            // Constants only known by name are rounded points, within an
+            // ulp of the bound they were rounded into
+            if (!constants_get_by_name_ctx(ctx, result->lo, node->constant.name))
+            {
+                snprintf(ctx->error, sizeof(ctx->error), "Unknown constant: %s",
+                         node->constant.name);
+                mpfr_set_zero(result->lo, 1);
+                mpfr_set_zero(result->hi, 1);
+                return;
+            }
+            interval_set_rounded(result, result->lo);
+        }
+        return;
+
+    case NODE_VARIABLE:
     {
-    case TOKEN_PLUS:
-        mpfr_set(high_prec_result, operand, global_rounding);
+        // Cached values are points, so definitions are evaluated again
+        const Variable *var = evaluator_find_variable(ctx, node);
+        if (!var)
+        {
+            mpfr_set_zero(result->lo, 1);
+            mpfr_set_zero(result->hi, 1);
+            return;
+        }
+        interval_eval_node(ctx, result, var->definition);
+        return;
+    }
+
+    case NODE_BINOP:
+        interval_eval_binop(ctx, result, node);
         break;
-    case TOKEN_MINUS:
-        mpfr_neg(high_prec_result, operand, global_rounding);
+
+    case NODE_UNARY:
+        interval_eval_node(ctx, result, node->unary.operand);
+        if (node->unary.op == TOKEN_MINUS)
+        {
+            interval_neg(result, result);
+        }
+        else if (node->unary.op != TOKEN_PLUS)
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Unknown unary operator");
+        }
         break;
+
+    case NODE_NARY:
+        interval_eval_nary(ctx, result, node);
+        break;
+
+    case NODE_FUNCTION:
+        interval_eval_function(ctx, result, node);
+        break;
+
     default:
-        snprintf(last_error, sizeof(last_error), "Unknown unary operator");
-        mpfr_set_d(high_prec_result, 0.0, global_rounding);
+        snprintf(ctx->error, sizeof(ctx->error), "Unknown node type");
+        mpfr_set_zero(result->lo, 1);
+        mpfr_set_zero(result->hi, 1);
+        return;
     }
+    EVALUATOR_STEPS(ctx, result->hi, node_steps(node));
+}
 
-    // Round result back to user's precision
-    mpfr_set(result, high_prec_result, global_rounding);
+static void evaluator_eval_interval(EvalContext *ctx, mpfr_t result, const ASTNode *node)
+{
+    ctx->adaptive_passes = 0;
+    eval_context_clear_error(ctx);
+    ctx->function_error[0] = '\0';
 
-    mpfr_clear(high_prec_result);
-    mpfr_clear(operand);
-}
+    Interval root;
+    interval_init2(&root, mpfr_get_prec(result) + EVALUATOR_INTERVAL_GUARD);
+    interval_eval_node(ctx, &root, node);
+    interval_mid(result, &root, ctx->rounding);
 
-// Extra precision for function arguments to minimize rounding errors
-#define FUNCTION_ARG_PRECISION_BOOST 128
+    if (!ctx->interval_ready)
+    {
+        mpfr_init2(ctx->interval_lo, mpfr_get_prec(root.lo));
+        mpfr_init2(ctx->interval_hi, mpfr_get_prec(root.hi));
+        ctx->interval_ready = 1;
+    }
+    mpfr_swap(ctx->interval_lo, root.lo);
+    mpfr_swap(ctx->interval_hi, root.hi);
+    ctx->interval_valid = !ctx->budget_exceeded;
+    interval_clear(&root);
+}
 
-static void evaluator_eval_function(mpfr_t result, const ASTNode *node)
+void evaluator_flush_tiny(mpfr_t value, mpfr_prec_t precision)
 {
-    // Use higher precision for function arguments to reduce cumulative error
-    mpfr_prec_t high_prec = global_precision + FUNCTION_ARG_PRECISION_BOOST;
+    // |value| < 2^(-precision - 10) exactly when its exponent is at most
+    // -(precision + 10), so no comparison constant is needed
+    if (mpfr_zero_p(value) ||
+        (mpfr_regular_p(value) && mpfr_get_exp(value) <= -(mpfr_exp_t)(precision + 10)))
+    {
+        mpfr_set_zero(value, 0);
+    }
+}
 
-    mpfr_t args[2]; // Max 2 args for current functions
-    for (int i = 0; i < node->function.arg_count; i++)
+void evaluator_release_scratch(EvalContext *ctx)
+{
+    for (int i = 0; i < ctx->scratch_count; i++)
     {
-        mpfr_init2(args[i], high_prec);
-        evaluator_eval(args[i], node->function.args[i]);
+        for (int j = 0; j < SCRATCH_OPERANDS; j++)
+        {
+            mpfr_clear(ctx->scratch_levels[i]->operands[j]);
+        }
+        mpfr_clear(ctx->scratch_levels[i]->result);
+        free(ctx->scratch_levels[i]);
     }
+    free(ctx->scratch_levels);
+    ctx->scratch_levels = NULL;
+    ctx->scratch_count = 0;
+    ctx->scratch_capacity = 0;
+    ctx->scratch_precision = 0;
 
-    // Compute function at high precision then round to user's precision
-    mpfr_t high_prec_result;
-    mpfr_init2(high_prec_result, high_prec);
+    for (int i = 0; i < ctx->term_count; i++)
+    {
+        mpfr_clear(ctx->terms[i]);
+        free(ctx->terms[i]);
+    }
+    free(ctx->terms);
+    ctx->terms = NULL;
+    ctx->term_top = 0;
+    ctx->term_count = 0;
+    ctx->term_capacity = 0;
 
-    // Delegate to functions module
-    int success = functions_eval(high_prec_result, node->function.func_type, args, node->function.arg_count);
+    for (int i = 0; i < ctx->shared_capacity; i++)
+    {
+        mpfr_clear(ctx->shared[i].value);
+    }
+    free(ctx->shared);
+    ctx->shared = NULL;
+    ctx->shared_capacity = 0;
 
-    if (!success && strict_mode)
+    if (ctx->exact_ready)
+    {
+        mpq_clear(ctx->exact_value);
+        ctx->exact_ready = 0;
+    }
+    ctx->exact_integer = 0;
+    if (ctx->interval_ready)
     {
-        snprintf(last_error, sizeof(last_error), "Function evaluation failed: %s",
-                 functions_get_last_error());
+        mpfr_clear(ctx->interval_lo);
+        mpfr_clear(ctx->interval_hi);
+        ctx->interval_ready = 0;
     }
+    ctx->interval_valid = 0;
+}
 
-    // Round result to user's precision
-    mpfr_set(result, high_prec_result, global_rounding);
+void evaluator_cleanup(void)
+{
+    eval_context_cleanup(eval_context_default());
+}
 
-    // Round very small values to zero to handle floating-point artifacts
-    // If |result| < 2^(-global_precision - 10), treat as zero
-    mpfr_t epsilon;
-    mpfr_init2(epsilon, global_precision);
-    mpfr_set_ui_2exp(epsilon, 1, -(long)(global_precision + 10), global_rounding);
+size_t evaluator_estimate_memory(const EvalContext *ctx, const ASTNode *node)
+{
+    long operations = 0;
+    int max_depth = 0;
+    int slots = 0;
+    int terms = 0;
+    evaluator_measure(node, 0, &operations, &max_depth, &slots, &terms);
 
-    if (mpfr_cmpabs(result, epsilon) < 0)
+    // The adaptive mode may go up to its largest guard
+    mpfr_prec_t working = ctx->precision + BINOP_PRECISION_BOOST;
+    if (ctx->adaptive)
     {
-        mpfr_set_zero(result, 0);
+        mpfr_prec_t max_guard = 4 * ctx->precision > EVALUATOR_ADAPTIVE_MAX_GUARD
+                                    ? 4 * ctx->precision
+                                    : EVALUATOR_ADAPTIVE_MAX_GUARD;
+        working = ctx->precision + max_guard;
     }
 
-    mpfr_clear(epsilon);
-    mpfr_clear(high_prec_result);
-    for (int i = 0; i < node->function.arg_count; i++)
+    size_t values = (size_t)(max_depth + 2) * (SCRATCH_OPERANDS + 1) + EVALUATOR_FUNCTION_TEMPS +
+                    (size_t)slots + (size_t)terms;
+    size_t bytes = values * precision_value_bytes(working);
+
+    // Per-context and shared constant caches
+    bytes += 2 * CONST_COUNT * precision_value_bytes(working);
+
+    // The result's digits and the formatted text
+    bytes += 2 * (size_t)(ctx->precision * 0.30103 + 64);
+    return bytes;
+}
+
+void evaluator_set_budget(const EvalBudget *budget)
+{
+    eval_context_default()->budget = *budget;
+}
+
+EvalBudget evaluator_get_budget(void)
+{
+    return eval_context_default()->budget;
+}
+
+void evaluator_cancel(void)
+{
+    atomic_store(&evaluator_cancelled, 1);
+}
+
+void evaluator_clear_cancel(void)
+{
+    atomic_store(&evaluator_cancelled, 0);
+}
+
+int evaluator_cancel_requested(const EvalContext *ctx)
+{
+    return atomic_load_explicit(&evaluator_cancelled, memory_order_relaxed) ||
+           (ctx->cancel && atomic_load_explicit(ctx->cancel, memory_order_relaxed));
+}
+
+void evaluator_set_progress(EvalProgress progress, void *data)
+{
+    EvalContext *ctx = eval_context_default();
+    ctx->progress = progress;
+    ctx->progress_data = data;
+    ctx->progress_interval = EVALUATOR_PROGRESS_INTERVAL_NS;
+}
+
+int evaluator_check_domain(const ASTNode *node)
+{
+    Analysis analysis;
+    analysis_run(eval_context_default(), node, &analysis);
+    return analysis.domain_error || analysis.division_by_zero;
+}
+
+void evaluator_set_adaptive(int adaptive)
+{
+    eval_context_default()->adaptive = adaptive;
+}
+
+int evaluator_get_adaptive(void)
+{
+    return eval_context_default()->adaptive;
+}
+
+void evaluator_set_interval(int interval)
+{
+    eval_context_default()->interval = interval;
+}
+
+int evaluator_get_interval(void)
+{
+    return eval_context_default()->interval;
+}
+
+int evaluator_interval_bounds(const EvalContext *ctx, mpfr_srcptr *lo, mpfr_srcptr *hi)
+{
+    if (!ctx->interval_valid)
     {
-        mpfr_clear(args[i]);
+        return 0;
     }
+    *lo = ctx->interval_lo;
+    *hi = ctx->interval_hi;
+    return 1;
 }
 
-// TODO
-int evaluator_check_domain(const ASTNode *node)
+void evaluator_set_exact(int exact)
+{
+    eval_context_default()->exact = exact;
+}
+
+int evaluator_get_exact(void)
+{
+    return eval_context_default()->exact;
+}
+
+mpz_srcptr evaluator_exact_integer(const EvalContext *ctx)
+{
+    return ctx->exact_integer ? mpq_numref(ctx->exact_value) : NULL;
+}
+
+void evaluator_set_native(int native)
+{
+    eval_context_default()->native = native;
+}
+
+int evaluator_get_native(void)
 {
-    // This would recursively check if evaluation would cause domain errors
-    // Implementation depends on specific domain checking requirements
-    (void)node; // Suppress unused warning for now
-    return 0;
+    return eval_context_default()->native;
+}
+
+const char *evaluator_backend_name(const EvalContext *ctx)
+{
+    if (ctx->native && !ctx->interval)
+    {
+        if (ctx->precision <= NATIVE_MAX_PRECISION)
+            return "long double";
+        if (ctx->precision <= MULTIDOUBLE_DD_MAX_PRECISION)
+            return "double-double";
+        if (ctx->precision <= MULTIDOUBLE_QD_MAX_PRECISION)
+            return "quad-double";
+    }
+    return "MPFR";
 }
 
 void evaluator_set_strict_mode(int strict)
 {
-    strict_mode = strict;
+    eval_context_default()->strict_mode = strict;
+}
+
+int evaluator_get_strict_mode(void)
+{
+    return eval_context_default()->strict_mode;
 }
 
 const char *evaluator_get_last_error(void)
 {
-    return strlen(last_error) > 0 ? last_error : NULL;
+    return eval_context_get_error(eval_context_default());
 }
 
 void evaluator_clear_error(void)
 {
-    last_error[0] = '\0';
+    eval_context_clear_error(eval_context_default());
 }
\ No newline at end of file
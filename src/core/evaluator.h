@@ -3,6 +3,57 @@
 
 #include "ast.h"
 #include <mpfr.h>
+#include <stddef.h>
+
+typedef struct EvalContext EvalContext;
+
+/**
+ * Progress report of a long evaluation
+ * @param data Pointer given with the callback
+ * @param done Operations finished in the current pass
+ * @param total Operations in the expression
+ * @param seconds Time since the evaluation started
+ */
+typedef void (*EvalProgress)(void *data, long done, long total, double seconds);
+
+// Extra precision for binary operations to minimize rounding errors
+#define BINOP_PRECISION_BOOST 128
+
+// Extra precision for unary operations
+#define UNARY_PRECISION_BOOST 128
+
+// Extra precision for function arguments to minimize rounding errors
+#define FUNCTION_ARG_PRECISION_BOOST 128
+
+// Guard bits of the first adaptive pass (see evaluator_set_adaptive())
+#define EVALUATOR_ADAPTIVE_GUARD 16
+
+// Guard bits after which adaptive evaluation gives up (at least 4x the
+// result precision)
+#define EVALUATOR_ADAPTIVE_MAX_GUARD 1024
+
+// Guard bits interval evaluation works with beyond the result's precision
+#define EVALUATOR_INTERVAL_GUARD 64
+
+// Time between progress reports of one evaluation
+#define EVALUATOR_PROGRESS_INTERVAL_NS 1000000000u
+
+// Factor by which the estimated time must exceed a time limit for an
+// evaluation to be refused before it starts (see analysis_estimate_cost())
+#define EVALUATOR_ESTIMATE_MARGIN 8.0
+
+/**
+ * Limits on one evaluation, checked after every operation; 0 means no limit
+ */
+typedef struct
+{
+    double seconds;      // Wall time
+    long max_operations; // Operations, counting every adaptive pass
+    long max_exponent;   // Binary exponent of any intermediate value, either sign
+} EvalBudget;
+
+// No limits, the default
+#define EVAL_BUDGET_NONE {0.0, 0, 0}
 
 /**
  * Evaluate an AST and store result in MPFR variable
@@ -11,19 +62,238 @@
  */
 void evaluator_eval(mpfr_t result, const ASTNode *node);
 
+/**
+ * Evaluate an AST in an explicit context
+ * Uses the context's precision, rounding, strict mode, scratch pool and
+ * constant cache; errors are stored in the context. Literals keep the
+ * precision they were parsed at (see parser_set_precision()). When the
+ * result cache is enabled, repeated evaluations are served from it.
+ * @param ctx Context to evaluate in
+ * @param result Output variable for result
+ * @param node AST node to evaluate
+ */
+void evaluator_eval_ctx(EvalContext *ctx, mpfr_t result, const ASTNode *node);
+
+/**
+ * Evaluate part of a tree inside an evaluation under way
+ * For calls such as sum() that evaluate their body for many values of a
+ * variable (see reduce.h): shared subexpressions are computed afresh, and
+ * the scratch pool is used from depth on at the context's current working
+ * precision. Errors are stored in the context.
+ * @param ctx Context of the evaluation under way
+ * @param result Output variable for result
+ * @param node Subtree to evaluate
+ * @param depth First scratch level the subtree may use
+ */
+void evaluator_eval_subtree(EvalContext *ctx, mpfr_t result, const ASTNode *node, int depth);
+
+/**
+ * Round a very small function result to +0 to hide floating-point artifacts
+ * Values with |value| < 2^(-precision - 10) and negative zero become +0.
+ * @param value Value to flush in place
+ * @param precision User precision the threshold is derived from
+ */
+void evaluator_flush_tiny(mpfr_t value, mpfr_prec_t precision);
+
+/**
+ * Release the scratch pool and constant cache of the calling thread's
+ * default context
+ */
+void evaluator_cleanup(void);
+
+/**
+ * Release a context's pool of scratch temporaries
+ * The values kept for shared subexpressions go with it.
+ * @param ctx Context whose pool is freed
+ */
+void evaluator_release_scratch(EvalContext *ctx);
+
+/**
+ * Estimate the memory an evaluation needs at a context's precision
+ * Counts the scratch levels for the tree's depth, the functions' own
+ * temporaries, the constant caches and the digit strings of the result.
+ * @param ctx Context whose precision and mode apply
+ * @param node AST node to evaluate
+ * @return Estimated peak in bytes
+ */
+size_t evaluator_estimate_memory(const EvalContext *ctx, const ASTNode *node);
+
+/**
+ * Report the progress of the calling thread's MPFR evaluations
+ * The callback runs between operations, at most once per
+ * EVALUATOR_PROGRESS_INTERVAL_NS; an adaptive pass starts counting again.
+ * @param progress Callback, or NULL to stop reporting
+ * @param data Pointer passed to the callback
+ */
+void evaluator_set_progress(EvalProgress progress, void *data);
+
+/**
+ * Limit the calling thread's evaluations
+ * An evaluation that runs over any limit stops at the next operation and
+ * gives NaN with a "Budget exceeded" error. A single MPFR call is not
+ * interrupted, so the time limit can be overrun by the slowest one.
+ * Evaluations certain to run over the operation or exponent limit, or
+ * estimated to take EVALUATOR_ESTIMATE_MARGIN times the time limit, are
+ * refused before they start; so, in strict mode, are those certain to
+ * fail in a function (see analysis_run()).
+ * @param budget Limits to apply from the next evaluation on
+ */
+void evaluator_set_budget(const EvalBudget *budget);
+
+/**
+ * Get the limits of the calling thread's evaluations
+ * @return Current limits
+ */
+EvalBudget evaluator_get_budget(void);
+
+/**
+ * Ask running evaluations on every thread to stop
+ * They stop at their next operation with an "Evaluation interrupted"
+ * error, and so does every evaluation until evaluator_clear_cancel().
+ * Async-signal-safe, so a SIGINT handler may call it.
+ */
+void evaluator_cancel(void);
+
+/**
+ * Let evaluations run again after evaluator_cancel()
+ */
+void evaluator_clear_cancel(void);
+
+/**
+ * Check whether a context's evaluations were asked to stop, by
+ * evaluator_cancel() or through the context's own flag
+ * @param ctx Context to check
+ * @return 1 if they were, 0 otherwise
+ */
+int evaluator_cancel_requested(const EvalContext *ctx);
+
 /**
  * Check if evaluation would cause domain error without actually evaluating
+ * Value ranges are propagated through the tree in the calling thread's
+ * context, so only certain failures are found: a function argument wholly
+ * outside the domain or a divisor that is exactly zero.
  * @param node AST node to check
  * @return 1 if domain error would occur, 0 otherwise
  */
 int evaluator_check_domain(const ASTNode *node);
 
 /**
- * Set evaluation options
+ * Enable adaptive precision for the calling thread
+ * Instead of the fixed precision boosts, each evaluation starts
+ * EVALUATOR_ADAPTIVE_GUARD bits above the result's precision, tracks an
+ * error bound for every node and is repeated with more guard bits until
+ * the result can be correctly rounded in the context's rounding mode.
+ * Literals count as the exact values they were parsed to. Results that
+ * never settle (exact zeros such as sin(pi), comparisons of equal values)
+ * are returned after EVALUATOR_ADAPTIVE_MAX_GUARD bits with tiny values
+ * flushed to zero, as in the fixed mode.
+ * @param adaptive 1 to enable, 0 for the fixed precision boosts
+ */
+void evaluator_set_adaptive(int adaptive);
+
+/**
+ * Get the adaptive precision setting of the calling thread
+ * @return 1 if adaptive evaluation is enabled, 0 otherwise
+ */
+int evaluator_get_adaptive(void);
+
+/**
+ * Enable interval evaluation for the calling thread
+ * Every node is evaluated to an interval (see interval.h) with its lower
+ * bound rounded down and its upper bound rounded up, EVALUATOR_INTERVAL_GUARD
+ * bits above the result's precision, so one pass gives bounds certain to
+ * contain the exact value instead of an estimate checked by evaluating
+ * again. Decimal literals count as the interval of one unit in the last
+ * place around the value they were parsed to; integers as themselves. The
+ * result is the midpoint of the bounds, which evaluator_interval_bounds()
+ * returns and the formatter shows as certified digits. Functions only
+ * count the part of an argument inside their domain, and division by an
+ * interval containing zero gives [-inf, inf]. Replaces the exact tier,
+ * the hardware backends, adaptive precision and the result cache while on.
+ * @param interval 1 to enable, 0 for point evaluation
+ */
+void evaluator_set_interval(int interval);
+
+/**
+ * Get the interval evaluation setting of the calling thread
+ * @return 1 if interval evaluation is enabled, 0 otherwise
+ */
+int evaluator_get_interval(void);
+
+/**
+ * Get the bounds of a context's last evaluation if it was an interval one
+ * @param ctx Context that evaluated
+ * @param lo Output: lower bound, valid until the context's next evaluation
+ * @param hi Output: upper bound, likewise
+ * @return 1 if the bounds are set, 0 otherwise
+ */
+int evaluator_interval_bounds(const EvalContext *ctx, mpfr_srcptr *lo, mpfr_srcptr *hi);
+
+/**
+ * Enable the exact tier for the calling thread
+ * Subtrees built only from integer literals, + - * / ^, comparisons and
+ * abs, floor, ceil, pow and sqrt are computed exactly with GMP rationals
+ * (see rational.h) and rounded once, so the MPFR path only starts where a
+ * constant, variable, decimal literal or transcendental function does.
+ * Subtrees the tier declines, such as 2^(1/2) or a division by zero, are
+ * evaluated by the other paths as before. Enabled by default.
+ * @param exact 1 to enable, 0 to always use floating point
+ */
+void evaluator_set_exact(int exact);
+
+/**
+ * Get the exact tier setting of the calling thread
+ * @return 1 if the exact tier is enabled, 0 otherwise
+ */
+int evaluator_get_exact(void);
+
+/**
+ * Get the exact value of a context's last evaluation if it is an integer
+ * Only set when the exact tier computed the whole tree. The integer may
+ * have more digits than the result's precision holds.
+ * @param ctx Context that evaluated
+ * @return The integer, valid until the context's next evaluation, or NULL
+ */
+mpz_srcptr evaluator_exact_integer(const EvalContext *ctx);
+
+/**
+ * Enable the hardware backends for the calling thread
+ * When the precision is at most NATIVE_MAX_PRECISION, evaluations first
+ * run in long double arithmetic, and up to MULTIDOUBLE_QD_MAX_PRECISION in
+ * double-double or quad-double arithmetic. They fall back to MPFR whenever
+ * the result cannot be trusted (see native_eval() and multidouble_eval()).
+ * Enabled by default.
+ * @param native 1 to enable, 0 to always use MPFR
+ */
+void evaluator_set_native(int native);
+
+/**
+ * Get the hardware backend setting of the calling thread
+ * @return 1 if the hardware backends are enabled, 0 otherwise
+ */
+int evaluator_get_native(void);
+
+/**
+ * Name the backend a context's evaluations try first
+ * @param ctx Context to describe
+ * @return "long double", "double-double", "quad-double" or "MPFR"
+ */
+const char *evaluator_backend_name(const EvalContext *ctx);
+
+/**
+ * Set evaluation options for the calling thread
+ * These calls act on the thread's default context (eval_context_default());
+ * worker threads must copy the setting they should run with.
  * @param strict_mode If 1, domain errors abort evaluation; if 0, return NaN
  */
 void evaluator_set_strict_mode(int strict_mode);
 
+/**
+ * Get current strict mode setting
+ * @return 1 if strict mode is enabled, 0 otherwise
+ */
+int evaluator_get_strict_mode(void);
+
 /**
  * Get last evaluation error message
  * @return Error message or NULL if no error
@@ -0,0 +1,288 @@
+#include "function_registry.h"
+#include "function_table.h"
+#include "functions.h"
+#include "lexer.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Kernels of the one-argument functions MPFR computes directly
+#define UNARY_KERNEL(name, mpfr_function)                                           \
+    static int kernel_##name(mpfr_ptr result, mpfr_t args[], mpfr_rnd_t rounding, \
+                             void *data)                                            \
+    {                                                                               \
+        (void)data;                                                                 \
+        return mpfr_function(result, args[0], rounding);                            \
+    }
+
+UNARY_KERNEL(sin, mpfr_sin)
+UNARY_KERNEL(cos, mpfr_cos)
+UNARY_KERNEL(tan, mpfr_tan)
+UNARY_KERNEL(asin, mpfr_asin)
+UNARY_KERNEL(acos, mpfr_acos)
+UNARY_KERNEL(atan, mpfr_atan)
+UNARY_KERNEL(sinh, mpfr_sinh)
+UNARY_KERNEL(cosh, mpfr_cosh)
+UNARY_KERNEL(tanh, mpfr_tanh)
+UNARY_KERNEL(asinh, mpfr_asinh)
+UNARY_KERNEL(acosh, mpfr_acosh)
+UNARY_KERNEL(atanh, mpfr_atanh)
+UNARY_KERNEL(sqrt, mpfr_sqrt)
+UNARY_KERNEL(log, mpfr_log)
+UNARY_KERNEL(log10, mpfr_log10)
+UNARY_KERNEL(exp, mpfr_exp)
+UNARY_KERNEL(abs, mpfr_abs)
+
+static int kernel_floor(mpfr_ptr result, mpfr_t args[], mpfr_rnd_t rounding, void *data)
+{
+    (void)rounding;
+    (void)data;
+    return mpfr_floor(result, args[0]);
+}
+
+static int kernel_ceil(mpfr_ptr result, mpfr_t args[], mpfr_rnd_t rounding, void *data)
+{
+    (void)rounding;
+    (void)data;
+    return mpfr_ceil(result, args[0]);
+}
+
+static int kernel_atan2(mpfr_ptr result, mpfr_t args[], mpfr_rnd_t rounding, void *data)
+{
+    (void)data;
+    return mpfr_atan2(result, args[0], args[1], rounding);
+}
+
+static int kernel_pow(mpfr_ptr result, mpfr_t args[], mpfr_rnd_t rounding, void *data)
+{
+    (void)data;
+    return functions_pow(result, args[0], args[1], rounding);
+}
+
+// Domains. Comparisons with NaN fail, so a NaN argument is inside the
+// closed domains, where MPFR returns NaN for it, and outside the open ones.
+static int domain_unit_closed(mpfr_t args[], void *data)
+{
+    (void)data;
+    return !(mpfr_cmp_si(args[0], -1) < 0 || mpfr_cmp_si(args[0], 1) > 0);
+}
+
+static int domain_unit_open(mpfr_t args[], void *data)
+{
+    (void)data;
+    return mpfr_cmp_si(args[0], -1) > 0 && mpfr_cmp_si(args[0], 1) < 0;
+}
+
+static int domain_at_least_one(mpfr_t args[], void *data)
+{
+    (void)data;
+    return !(mpfr_cmp_si(args[0], 1) < 0);
+}
+
+static int domain_non_negative(mpfr_t args[], void *data)
+{
+    (void)data;
+    return !(mpfr_cmp_si(args[0], 0) < 0);
+}
+
+static int domain_positive(mpfr_t args[], void *data)
+{
+    (void)data;
+    return mpfr_cmp_si(args[0], 0) > 0;
+}
+
+// Interval versions of the two-argument functions
+static void interval_kernel_atan2(Interval *result, const Interval args[])
+{
+    interval_atan2(result, &args[0], &args[1]);
+}
+
+static void interval_kernel_pow(Interval *result, const Interval args[])
+{
+    interval_pow(result, &args[0], &args[1]);
+}
+
+// Arguments wholly outside a domain
+static int outside_unit_closed(const Interval args[])
+{
+    return mpfr_cmp_si(args[0].lo, 1) > 0 || mpfr_cmp_si(args[0].hi, -1) < 0;
+}
+
+static int outside_unit_open(const Interval args[])
+{
+    return mpfr_cmp_si(args[0].lo, 1) >= 0 || mpfr_cmp_si(args[0].hi, -1) <= 0;
+}
+
+static int outside_at_least_one(const Interval args[])
+{
+    return mpfr_cmp_si(args[0].hi, 1) < 0;
+}
+
+static int outside_non_negative(const Interval args[])
+{
+    return mpfr_sgn(args[0].hi) < 0;
+}
+
+static int outside_positive(const Interval args[])
+{
+    return mpfr_sgn(args[0].hi) <= 0;
+}
+
+// Built-in functions, indexed by token
+static const FunctionDef builtin_functions[TOKEN_INTEGRATE + 1] = {
+    // Trigonometric functions
+    [TOKEN_SIN] = {"sin", TOKEN_SIN, 1, NULL, NULL, kernel_sin, interval_sin, NULL, NULL},
+    [TOKEN_COS] = {"cos", TOKEN_COS, 1, NULL, NULL, kernel_cos, interval_cos, NULL, NULL},
+    [TOKEN_TAN] = {"tan", TOKEN_TAN, 1, NULL, NULL, kernel_tan, interval_tan, NULL, NULL},
+
+    // Inverse trigonometric functions
+    [TOKEN_ASIN] = {"asin", TOKEN_ASIN, 1, domain_unit_closed, "argument must be in [-1,1]",
+                    kernel_asin, interval_asin, outside_unit_closed, NULL},
+    [TOKEN_ACOS] = {"acos", TOKEN_ACOS, 1, domain_unit_closed, "argument must be in [-1,1]",
+                    kernel_acos, interval_acos, outside_unit_closed, NULL},
+    [TOKEN_ATAN] = {"atan", TOKEN_ATAN, 1, NULL, NULL, kernel_atan, interval_atan, NULL, NULL},
+    [TOKEN_ATAN2] = {"atan2", TOKEN_ATAN2, 2, NULL, NULL, kernel_atan2, interval_kernel_atan2,
+                     NULL, NULL},
+
+    // Hyperbolic functions
+    [TOKEN_SINH] = {"sinh", TOKEN_SINH, 1, NULL, NULL, kernel_sinh, interval_sinh, NULL, NULL},
+    [TOKEN_COSH] = {"cosh", TOKEN_COSH, 1, NULL, NULL, kernel_cosh, interval_cosh, NULL, NULL},
+    [TOKEN_TANH] = {"tanh", TOKEN_TANH, 1, NULL, NULL, kernel_tanh, interval_tanh, NULL, NULL},
+
+    // Inverse hyperbolic functions
+    [TOKEN_ASINH] = {"asinh", TOKEN_ASINH, 1, NULL, NULL, kernel_asinh, interval_asinh, NULL,
+                     NULL},
+    [TOKEN_ACOSH] = {"acosh", TOKEN_ACOSH, 1, domain_at_least_one, "argument must be >= 1",
+                     kernel_acosh, interval_acosh, outside_at_least_one, NULL},
+    [TOKEN_ATANH] = {"atanh", TOKEN_ATANH, 1, domain_unit_open, "argument must be in (-1,1)",
+                     kernel_atanh, interval_atanh, outside_unit_open, NULL},
+
+    // Other mathematical functions
+    [TOKEN_SQRT] = {"sqrt", TOKEN_SQRT, 1, domain_non_negative, "argument must be >= 0",
+                    kernel_sqrt, interval_sqrt, outside_non_negative, NULL},
+    [TOKEN_LOG] = {"log", TOKEN_LOG, 1, domain_positive, "argument must be > 0", kernel_log,
+                   interval_log, outside_positive, NULL},
+    [TOKEN_LOG10] = {"log10", TOKEN_LOG10, 1, domain_positive, "argument must be > 0",
+                     kernel_log10, interval_log10, outside_positive, NULL},
+    [TOKEN_EXP] = {"exp", TOKEN_EXP, 1, NULL, NULL, kernel_exp, interval_exp, NULL, NULL},
+    [TOKEN_ABS] = {"abs", TOKEN_ABS, 1, NULL, NULL, kernel_abs, interval_abs, NULL, NULL},
+    [TOKEN_FLOOR] = {"floor", TOKEN_FLOOR, 1, NULL, NULL, kernel_floor, interval_floor, NULL,
+                     NULL},
+    [TOKEN_CEIL] = {"ceil", TOKEN_CEIL, 1, NULL, NULL, kernel_ceil, interval_ceil, NULL, NULL},
+    [TOKEN_POW] = {"pow", TOKEN_POW, 2, NULL, NULL, kernel_pow, interval_kernel_pow, NULL, NULL},
+
+    // Reductions evaluate their body for many points (see reduce.h), so
+    // the evaluator calls them with the tree rather than with values
+    [TOKEN_SUM] = {"sum", TOKEN_SUM, 4, NULL, NULL, NULL, NULL, NULL, NULL},
+    [TOKEN_INTEGRATE] = {"integrate", TOKEN_INTEGRATE, 4, NULL, NULL, NULL, NULL, NULL, NULL},
+};
+
+static FunctionDef custom_functions[FUNCTION_REGISTRY_MAX_CUSTOM];
+static int custom_count = 0;
+static char registry_error[256] = "";
+
+const FunctionDef *function_registry_get(TokenType token)
+{
+    if (token >= TOKEN_SIN && token <= TOKEN_INTEGRATE)
+    {
+        return &builtin_functions[token];
+    }
+    int custom = (int)token - TOKEN_CUSTOM_FIRST;
+    if (custom >= 0 && custom < custom_count)
+    {
+        return &custom_functions[custom];
+    }
+    return NULL;
+}
+
+const FunctionDef *function_registry_find(const char *name, size_t length)
+{
+    for (int i = 0; i < custom_count; i++)
+    {
+        const char *custom = custom_functions[i].name;
+        if (strncmp(custom, name, length) == 0 && custom[length] == '\0')
+        {
+            return &custom_functions[i];
+        }
+    }
+    return NULL;
+}
+
+// Check that the lexer reads a name as one identifier
+static int registry_valid_name(const char *name)
+{
+    size_t length = strlen(name);
+    if (length == 0 || length > LEXER_MAX_IDENTIFIER_LENGTH ||
+        !(isalpha((unsigned char)name[0]) || name[0] == '_'))
+    {
+        return 0;
+    }
+    for (size_t i = 1; i < length; i++)
+    {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_')
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+TokenType function_registry_add(const char *name, int arg_count, FunctionKernel kernel,
+                                FunctionDomain in_domain, void *data)
+{
+    if (!name || !registry_valid_name(name))
+    {
+        snprintf(registry_error, sizeof(registry_error), "Invalid function name '%.64s'",
+                 name ? name : "");
+        return TOKEN_INVALID;
+    }
+    if (function_table_lookup(name) || function_registry_find(name, strlen(name)))
+    {
+        snprintf(registry_error, sizeof(registry_error), "Name '%s' is already taken", name);
+        return TOKEN_INVALID;
+    }
+    if (arg_count < 1 || arg_count > FUNCTION_REGISTRY_MAX_ARGS || !kernel)
+    {
+        snprintf(registry_error, sizeof(registry_error),
+                 "Function '%s' needs a kernel and 1 to %d arguments", name,
+                 FUNCTION_REGISTRY_MAX_ARGS);
+        return TOKEN_INVALID;
+    }
+    if (custom_count == FUNCTION_REGISTRY_MAX_CUSTOM)
+    {
+        snprintf(registry_error, sizeof(registry_error),
+                 "No room for function '%s': at most %d can be registered", name,
+                 FUNCTION_REGISTRY_MAX_CUSTOM);
+        return TOKEN_INVALID;
+    }
+
+    char *copy = malloc(strlen(name) + 1);
+    if (!copy)
+    {
+        snprintf(registry_error, sizeof(registry_error), "Out of memory");
+        return TOKEN_INVALID;
+    }
+    strcpy(copy, name);
+
+    TokenType token = (TokenType)(TOKEN_CUSTOM_FIRST + custom_count);
+    custom_functions[custom_count++] =
+        (FunctionDef){copy, token, arg_count, in_domain, NULL, kernel, NULL, NULL, data};
+    return token;
+}
+
+const char *function_registry_get_error(void)
+{
+    return registry_error;
+}
+
+void function_registry_cleanup(void)
+{
+    for (int i = 0; i < custom_count; i++)
+    {
+        free((char *)custom_functions[i].name);
+    }
+    memset(custom_functions, 0, sizeof(custom_functions));
+    custom_count = 0;
+    registry_error[0] = '\0';
+}
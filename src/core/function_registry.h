@@ -0,0 +1,122 @@
+#ifndef FUNCTION_REGISTRY_H
+#define FUNCTION_REGISTRY_H
+
+#include "interval.h"
+#include "tokens.h"
+#include <mpfr.h>
+#include <stddef.h>
+
+// Functions that can be registered at run time, one per custom token
+#define FUNCTION_REGISTRY_MAX_CUSTOM (TOKEN_CUSTOM_LAST - TOKEN_CUSTOM_FIRST + 1)
+
+// Most arguments a registered function can take, as for the built-ins
+#define FUNCTION_REGISTRY_MAX_ARGS 2
+
+/**
+ * Registry of the functions expressions can call
+ *
+ * Every function, built in or registered at run time, has one entry that
+ * says everything the evaluators need: its name, its arity, its domain and
+ * the kernels computing it. Nodes are resolved to their entry when they are
+ * created, so a call is one domain check and one indirect call; the arity
+ * was checked by the parser.
+ *
+ * Built-in functions keep the tokens the lexer gives them (their aliases
+ * are names in the lexer's function table). Registered functions get
+ * tokens from TOKEN_CUSTOM_FIRST on; only the MPFR evaluator and the
+ * compiled programs call them, the faster backends leave them alone.
+ * Registration is not locked: register functions before starting threads
+ * that parse or evaluate.
+ */
+
+/**
+ * Compute a function in MPFR
+ * @param result Output variable, at the precision to round to
+ * @param args Argument values, as many as the function's arity
+ * @param rounding Rounding mode
+ * @param data Data given at registration, NULL for built-ins
+ * @return Ternary value, as for MPFR functions
+ */
+typedef int (*FunctionKernel)(mpfr_ptr result, mpfr_t args[], mpfr_rnd_t rounding, void *data);
+
+/**
+ * Check arguments against a function's domain
+ * @param args Argument values
+ * @param data Data given at registration, NULL for built-ins
+ * @return 1 if the function is defined there, 0 otherwise
+ */
+typedef int (*FunctionDomain)(mpfr_t args[], void *data);
+
+/**
+ * Compute a function on intervals (see interval.h)
+ * @param result Output interval
+ * @param args Argument intervals
+ */
+typedef void (*FunctionIntervalKernel)(Interval *result, const Interval args[]);
+
+/**
+ * Check whether argument intervals lie wholly outside a function's domain
+ * @param args Argument intervals
+ * @return 1 if no point of them is in the domain, 0 otherwise
+ */
+typedef int (*FunctionIntervalOutside)(const Interval args[]);
+
+typedef struct FunctionDef
+{
+    const char *name;
+    TokenType token;
+    int arg_count;
+    FunctionDomain in_domain;         // NULL if defined for every argument
+    const char *domain_error;         // Why arguments outside the domain fail
+    FunctionKernel kernel;            // NULL for sum() and integrate(), which take the tree
+    FunctionIntervalKernel interval;  // NULL if there is no interval version
+    FunctionIntervalOutside outside;  // NULL if the interval version takes any argument
+    void *data;                       // Passed to kernel and in_domain
+} FunctionDef;
+
+/**
+ * Get the entry of a function token
+ * @param token Token type
+ * @return Entry, or NULL if the token is not a function
+ */
+const FunctionDef *function_registry_get(TokenType token);
+
+/**
+ * Look up a registered function by a name that need not be NUL-terminated
+ * Built-in names are found by the lexer's function table.
+ * @param name Start of the name
+ * @param length Number of characters in the name
+ * @return Entry, or NULL if no function was registered under the name
+ */
+const FunctionDef *function_registry_find(const char *name, size_t length);
+
+/**
+ * Register a function computed by a native kernel
+ * The name must be an identifier that no built-in function, constant or
+ * registered function uses. The kernel must round correctly, as MPFR's
+ * functions do, for results to be as accurate as with built-ins.
+ * @param name Function name (copied)
+ * @param arg_count Number of arguments, 1 to FUNCTION_REGISTRY_MAX_ARGS
+ * @param kernel Kernel computing the function
+ * @param in_domain Domain check, or NULL if defined for every argument
+ * @param data Passed to kernel and in_domain
+ * @return Token of the new function, or TOKEN_INVALID on error (see
+ *         function_registry_get_error())
+ */
+TokenType function_registry_add(const char *name, int arg_count, FunctionKernel kernel,
+                                FunctionDomain in_domain, void *data);
+
+/**
+ * Get the message of the last failed registration
+ * @return Error message
+ */
+const char *function_registry_get_error(void);
+
+/**
+ * Forget every registered function
+ * Trees calling them must have been freed first, since their tokens are
+ * handed out again.
+ */
+void function_registry_cleanup(void);
+
+#endif // FUNCTION_REGISTRY_H
@@ -1,285 +1,310 @@
 #include "functions.h"
-#include "precision.h"
+#include "context.h"
+#include "function_registry.h"
+#include "profile.h"
+#include "reduce.h"
 #include <stdio.h>
 #include <string.h>
 
-// Function evaluation state
-static int strict_domain_mode = 0;
-static char last_error[256] = {0};
-
 void functions_init(void)
 {
-    strict_domain_mode = 0;
-    last_error[0] = '\0';
+    EvalContext *ctx = eval_context_default();
+    ctx->strict_domain = 0;
+    ctx->function_error[0] = '\0';
 }
 
 int functions_eval(mpfr_t result, TokenType func_type, mpfr_t args[], int arg_count)
 {
-    functions_clear_error();
+    return functions_eval_ctx(eval_context_default(), result, func_type, args, arg_count);
+}
+
+// Evaluate one function; functions_call() times the call when profiling
+static int functions_eval_dispatch(EvalContext *ctx, mpfr_t result, const FunctionDef *def,
+                                   mpfr_t args[])
+{
+    ctx->function_error[0] = '\0';
+
+    if (def->in_domain && !def->in_domain(args, def->data))
+    {
+        // Strict mode makes the value NaN; otherwise it is 0 with an error
+        if (ctx->strict_domain)
+        {
+            mpfr_set_nan(result);
+            return 0;
+        }
+        snprintf(ctx->function_error, sizeof(ctx->function_error), "%s domain error: %s",
+                 def->name, def->domain_error ? def->domain_error : "argument out of domain");
+        mpfr_set_zero(result, 1);
+        return 0;
+    }
 
-    // Check domain first if in strict mode
-    if (strict_domain_mode && functions_check_domain(func_type, args, arg_count))
+    if (!def->kernel)
     {
+        snprintf(ctx->function_error, sizeof(ctx->function_error),
+                 "%s needs an expression, not a value", def->name);
         mpfr_set_nan(result);
         return 0;
     }
 
-    switch (func_type)
+    def->kernel(result, args, ctx->rounding, def->data);
+    return 1;
+}
+
+int functions_call(EvalContext *ctx, mpfr_t result, const FunctionDef *def, mpfr_t args[])
+{
+    if (!def)
     {
-    // Trigonometric functions
-    case TOKEN_SIN:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_sin(result, args[0], global_rounding);
-        return 1;
+        snprintf(ctx->function_error, sizeof(ctx->function_error), "Unknown function");
+        mpfr_set_zero(result, 1);
+        return 0;
+    }
 
-    case TOKEN_COS:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_cos(result, args[0], global_rounding);
-        return 1;
+    PROFILE_START(start);
+    int ok = functions_eval_dispatch(ctx, result, def, args);
+    PROFILE_FUNCTION(def->token, start);
+    return ok;
+}
 
-    case TOKEN_TAN:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_tan(result, args[0], global_rounding);
-        return 1;
+int functions_eval_ctx(EvalContext *ctx, mpfr_t result, TokenType func_type, mpfr_t args[],
+                       int arg_count)
+{
+    const FunctionDef *def = function_registry_get(func_type);
+    if (def && arg_count != def->arg_count)
+    {
+        snprintf(ctx->function_error, sizeof(ctx->function_error),
+                 "Wrong number of arguments for function");
+        mpfr_set_zero(result, 1);
+        return 0;
+    }
+    return functions_call(ctx, result, def, args);
+}
 
-    // Inverse trigonometric functions
-    case TOKEN_ASIN:
-        if (arg_count != 1)
-            goto arg_error;
-        if (mpfr_cmp_d(args[0], -1.0) < 0 || mpfr_cmp_d(args[0], 1.0) > 0)
+// Evaluate one function on intervals; functions_eval_interval() times it
+static int functions_eval_interval_dispatch(EvalContext *ctx, Interval *result,
+                                            const FunctionDef *def, const Interval args[],
+                                            int arg_count)
+{
+    ctx->function_error[0] = '\0';
+
+    if (!def->interval)
+    {
+        snprintf(ctx->function_error, sizeof(ctx->function_error), "%s has no interval version",
+                 def->name);
+        mpfr_set_nan(result->lo);
+        mpfr_set_nan(result->hi);
+        return 0;
+    }
+    if (arg_count != def->arg_count)
+    {
+        snprintf(ctx->function_error, sizeof(ctx->function_error),
+                 "Wrong number of arguments for function");
+        mpfr_set_zero(result->lo, 1);
+        mpfr_set_zero(result->hi, 1);
+        return 0;
+    }
+    if (def->outside && def->outside(args))
+    {
+        // Report the error the point evaluation reports
+        mpfr_t point[FUNCTION_REGISTRY_MAX_ARGS];
+        for (int i = 0; i < arg_count; i++)
         {
-            snprintf(last_error, sizeof(last_error), "asin domain error: argument must be in [-1,1]");
-            mpfr_set_d(result, 0.0, global_rounding);
-            return 0;
+            mpfr_init2(point[i], mpfr_get_prec(result->lo));
+            mpfr_set(point[i], args[i].lo, MPFR_RNDN);
         }
-        mpfr_asin(result, args[0], global_rounding);
-        return 1;
-
-    case TOKEN_ACOS:
-        if (arg_count != 1)
-            goto arg_error;
-        if (mpfr_cmp_d(args[0], -1.0) < 0 || mpfr_cmp_d(args[0], 1.0) > 0)
+        int ok = functions_eval_dispatch(ctx, result->lo, def, point);
+        mpfr_set(result->hi, result->lo, MPFR_RNDN);
+        for (int i = 0; i < arg_count; i++)
         {
-            snprintf(last_error, sizeof(last_error), "acos domain error: argument must be in [-1,1]");
-            mpfr_set_d(result, 0.0, global_rounding);
-            return 0;
+            mpfr_clear(point[i]);
         }
-        mpfr_acos(result, args[0], global_rounding);
-        return 1;
-
-    case TOKEN_ATAN:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_atan(result, args[0], global_rounding);
-        return 1;
-
-    case TOKEN_ATAN2:
-        if (arg_count != 2)
-            goto arg_error;
-        mpfr_atan2(result, args[0], args[1], global_rounding);
-        return 1;
+        return ok;
+    }
 
-    // Hyperbolic functions
-    case TOKEN_SINH:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_sinh(result, args[0], global_rounding);
-        return 1;
+    def->interval(result, args);
+    return 1;
+}
 
-    case TOKEN_COSH:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_cosh(result, args[0], global_rounding);
-        return 1;
+int functions_eval_interval(EvalContext *ctx, Interval *result, TokenType func_type,
+                            const Interval args[], int arg_count)
+{
+    const FunctionDef *def = function_registry_get(func_type);
+    if (!def)
+    {
+        snprintf(ctx->function_error, sizeof(ctx->function_error), "Unknown function");
+        mpfr_set_zero(result->lo, 1);
+        mpfr_set_zero(result->hi, 1);
+        return 0;
+    }
 
-    case TOKEN_TANH:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_tanh(result, args[0], global_rounding);
-        return 1;
+    PROFILE_START(start);
+    int ok = functions_eval_interval_dispatch(ctx, result, def, args, arg_count);
+    PROFILE_FUNCTION(func_type, start);
+    return ok;
+}
 
-    // Inverse hyperbolic functions
-    case TOKEN_ASINH:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_asinh(result, args[0], global_rounding);
-        return 1;
+// Check whether a value is 2^shift for some shift
+static int power_of_two(mpfr_srcptr value, mpfr_exp_t *shift)
+{
+    if (!mpfr_regular_p(value) || mpfr_sgn(value) < 0)
+    {
+        return 0;
+    }
+    *shift = mpfr_get_exp(value) - 1;
+    return mpfr_cmp_ui_2exp(value, 1, *shift) == 0;
+}
 
-    case TOKEN_ACOSH:
-        if (arg_count != 1)
-            goto arg_error;
-        if (mpfr_cmp_d(args[0], 1.0) < 0)
-        {
-            snprintf(last_error, sizeof(last_error), "acosh domain error: argument must be >= 1");
-            mpfr_set_d(result, 0.0, global_rounding);
-            return 0;
-        }
-        mpfr_acosh(result, args[0], global_rounding);
-        return 1;
+// A nonzero integer that fits a long; zeros keep their sign through mpfr_mul()
+static int small_integer(mpfr_srcptr value)
+{
+    return mpfr_regular_p(value) && mpfr_integer_p(value) && mpfr_fits_slong_p(value, MPFR_RNDN);
+}
 
-    case TOKEN_ATANH:
-        if (arg_count != 1)
-            goto arg_error;
-        if (mpfr_cmp_d(args[0], -1.0) <= 0 || mpfr_cmp_d(args[0], 1.0) >= 0)
-        {
-            snprintf(last_error, sizeof(last_error), "atanh domain error: argument must be in (-1,1)");
-            mpfr_set_d(result, 0.0, global_rounding);
-            return 0;
-        }
-        mpfr_atanh(result, args[0], global_rounding);
-        return 1;
+int functions_pow(mpfr_t result, mpfr_srcptr base, mpfr_srcptr exponent, mpfr_rnd_t rounding)
+{
+    if (mpfr_zero_p(exponent))
+    {
+        return mpfr_set_ui(result, 1, rounding);
+    }
+    if (!mpfr_regular_p(exponent))
+    {
+        return mpfr_pow(result, base, exponent, rounding);
+    }
 
-    // Other mathematical functions
-    case TOKEN_SQRT:
-        if (arg_count != 1)
-            goto arg_error;
-        if (mpfr_cmp_d(args[0], 0.0) < 0)
+    // sqrt(-0) is -0 and sqrt(-inf) NaN, but powers of them are +0 and +inf
+    int negative_special = mpfr_signbit(base) && (mpfr_zero_p(base) || mpfr_inf_p(base));
+    if (mpfr_get_exp(exponent) == 0 && !negative_special)
+    {
+        if (mpfr_cmp_ui_2exp(exponent, 1, -1) == 0)
         {
-            snprintf(last_error, sizeof(last_error), "sqrt domain error: argument must be >= 0");
-            mpfr_set_d(result, 0.0, global_rounding);
-            return 0;
+            return mpfr_sqrt(result, base, rounding);
         }
-        mpfr_sqrt(result, args[0], global_rounding);
-        return 1;
-
-    case TOKEN_LOG:
-        if (arg_count != 1)
-            goto arg_error;
-        if (mpfr_cmp_d(args[0], 0.0) <= 0)
+        if (mpfr_cmp_si_2exp(exponent, -1, -1) == 0)
         {
-            snprintf(last_error, sizeof(last_error), "log domain error: argument must be > 0");
-            mpfr_set_d(result, 0.0, global_rounding);
-            return 0;
+            return mpfr_rec_sqrt(result, base, rounding);
         }
-        mpfr_log(result, args[0], global_rounding);
-        return 1;
+    }
 
-    case TOKEN_LOG10:
-        if (arg_count != 1)
-            goto arg_error;
-        if (mpfr_cmp_d(args[0], 0.0) <= 0)
+    if (!mpfr_integer_p(exponent) || !mpfr_fits_slong_p(exponent, MPFR_RNDN))
+    {
+        return mpfr_pow(result, base, exponent, rounding);
+    }
+    long n = mpfr_get_si(exponent, MPFR_RNDN);
+    switch (n)
+    {
+    case 1:
+        return mpfr_set(result, base, rounding);
+    case 2:
+        return mpfr_sqr(result, base, rounding);
+    case -1:
+        return mpfr_ui_div(result, 1, base, rounding);
+    default:
+        if (mpfr_get_prec(result) <= FUNCTIONS_POW_SI_MAX_PRECISION)
         {
-            snprintf(last_error, sizeof(last_error), "log10 domain error: argument must be > 0");
-            mpfr_set_d(result, 0.0, global_rounding);
-            return 0;
+            return mpfr_pow_si(result, base, n, rounding);
         }
-        mpfr_log10(result, args[0], global_rounding);
-        return 1;
-
-    case TOKEN_EXP:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_exp(result, args[0], global_rounding);
-        return 1;
-
-    case TOKEN_ABS:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_abs(result, args[0], global_rounding);
-        return 1;
+        return mpfr_pow(result, base, exponent, rounding);
+    }
+}
 
-    case TOKEN_FLOOR:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_floor(result, args[0]);
-        return 1;
+int functions_mul(mpfr_t result, mpfr_srcptr left, mpfr_srcptr right, mpfr_rnd_t rounding)
+{
+    if (mpfr_get_prec(result) < FUNCTIONS_LOWER_MIN_PRECISION)
+    {
+        return mpfr_mul(result, left, right, rounding);
+    }
 
-    case TOKEN_CEIL:
-        if (arg_count != 1)
-            goto arg_error;
-        mpfr_ceil(result, args[0]);
-        return 1;
+    mpfr_exp_t shift;
+    if (power_of_two(right, &shift))
+    {
+        return mpfr_mul_2si(result, left, shift, rounding);
+    }
+    if (power_of_two(left, &shift))
+    {
+        return mpfr_mul_2si(result, right, shift, rounding);
+    }
+    // Equal zeros may differ in sign
+    if (mpfr_regular_p(left) && mpfr_equal_p(left, right))
+    {
+        return mpfr_sqr(result, left, rounding);
+    }
+    if (small_integer(right))
+    {
+        return mpfr_mul_si(result, left, mpfr_get_si(right, MPFR_RNDN), rounding);
+    }
+    if (small_integer(left))
+    {
+        return mpfr_mul_si(result, right, mpfr_get_si(left, MPFR_RNDN), rounding);
+    }
+    return mpfr_mul(result, left, right, rounding);
+}
 
-    case TOKEN_POW:
-        if (arg_count != 2)
-            goto arg_error;
-        mpfr_pow(result, args[0], args[1], global_rounding);
-        return 1;
+int functions_div(mpfr_t result, mpfr_srcptr dividend, mpfr_srcptr divisor,
+                  mpfr_rnd_t rounding)
+{
+    if (mpfr_get_prec(result) < FUNCTIONS_LOWER_MIN_PRECISION)
+    {
+        return mpfr_div(result, dividend, divisor, rounding);
+    }
 
-    default:
-        snprintf(last_error, sizeof(last_error), "Unknown function");
-        mpfr_set_d(result, 0.0, global_rounding);
-        return 0;
+    mpfr_exp_t shift;
+    if (power_of_two(divisor, &shift))
+    {
+        return mpfr_div_2si(result, dividend, shift, rounding);
+    }
+    if (small_integer(divisor))
+    {
+        return mpfr_div_si(result, dividend, mpfr_get_si(divisor, MPFR_RNDN), rounding);
     }
+    return mpfr_div(result, dividend, divisor, rounding);
+}
 
-arg_error:
-    snprintf(last_error, sizeof(last_error), "Wrong number of arguments for function");
-    mpfr_set_d(result, 0.0, global_rounding);
-    return 0;
+int functions_product(mpfr_t result, mpfr_ptr terms[], int count, mpfr_rnd_t rounding)
+{
+    // Each round multiplies pairs a step apart into the left one, so the
+    // rounding errors add up over log2(count) levels instead of count
+    for (int step = 1; step < count; step *= 2)
+    {
+        for (int i = 0; i + step < count; i += 2 * step)
+        {
+            functions_mul(terms[i], terms[i], terms[i + step], rounding);
+        }
+    }
+    return mpfr_set(result, terms[0], rounding);
 }
 
 int functions_check_domain(TokenType func_type, mpfr_t args[], int arg_count)
 {
-    switch (func_type)
+    const FunctionDef *def = function_registry_get(func_type);
+    if (!def || !def->kernel || arg_count != def->arg_count)
     {
-    case TOKEN_ASIN:
-    case TOKEN_ACOS:
-        if (arg_count != 1)
-            return 1;
-        return (mpfr_cmp_d(args[0], -1.0) < 0 || mpfr_cmp_d(args[0], 1.0) > 0);
-
-    case TOKEN_ACOSH:
-        if (arg_count != 1)
-            return 1;
-        return (mpfr_cmp_d(args[0], 1.0) < 0);
-
-    case TOKEN_ATANH:
-        if (arg_count != 1)
-            return 1;
-        return (mpfr_cmp_d(args[0], -1.0) <= 0 || mpfr_cmp_d(args[0], 1.0) >= 0);
-
-    case TOKEN_SQRT:
-        if (arg_count != 1)
-            return 1;
-        return (mpfr_cmp_d(args[0], 0.0) < 0);
-
-    case TOKEN_LOG:
-    case TOKEN_LOG10:
-        if (arg_count != 1)
-            return 1;
-        return (mpfr_cmp_d(args[0], 0.0) <= 0);
-
-    // Functions with no domain restrictions
-    case TOKEN_SIN:
-    case TOKEN_COS:
-    case TOKEN_TAN:
-    case TOKEN_ATAN:
-    case TOKEN_ATAN2:
-    case TOKEN_SINH:
-    case TOKEN_COSH:
-    case TOKEN_TANH:
-    case TOKEN_ASINH:
-    case TOKEN_EXP:
-    case TOKEN_ABS:
-    case TOKEN_FLOOR:
-    case TOKEN_CEIL:
-    case TOKEN_POW:
-        return 0;
-
-    default:
-        return 1; // Unknown function
+        return 1;
     }
+    return def->in_domain && !def->in_domain(args, def->data);
 }
 
 const char *functions_get_last_error(void)
 {
+    const char *last_error = eval_context_default()->function_error;
     return strlen(last_error) > 0 ? last_error : NULL;
 }
 
 void functions_clear_error(void)
 {
-    last_error[0] = '\0';
+    eval_context_default()->function_error[0] = '\0';
 }
 
 void functions_set_strict_domain(int strict_domain)
 {
-    strict_domain_mode = strict_domain;
+    eval_context_default()->strict_domain = strict_domain;
+}
+
+int functions_get_strict_domain(void)
+{
+    return eval_context_default()->strict_domain;
 }
 
 void functions_cleanup(void)
 {
     functions_clear_error();
+    reduce_cleanup();
 }
\ No newline at end of file
@@ -1,9 +1,21 @@
 #ifndef FUNCTIONS_H
 #define FUNCTIONS_H
 
+#include "function_registry.h"
+#include "interval.h"
 #include "tokens.h"
 #include <mpfr.h>
 
+typedef struct EvalContext EvalContext;
+
+// Up to this result precision mpfr_pow_si() beats mpfr_pow() for integer
+// exponents; above it mpfr_pow() is faster
+#define FUNCTIONS_POW_SI_MAX_PRECISION 1024
+
+// From this result precision on, integer and power-of-two operands pay for
+// being recognized; single-limb products and quotients are cheaper as they are
+#define FUNCTIONS_LOWER_MIN_PRECISION 65
+
 /**
  * Initialize functions system
  */
@@ -19,6 +31,103 @@ void functions_init(void);
  */
 int functions_eval(mpfr_t result, TokenType func_type, mpfr_t args[], int arg_count);
 
+/**
+ * Evaluate a mathematical function with a context's rounding and strict
+ * domain setting; errors are reported in the context's function_error
+ * @param ctx Context to evaluate in
+ * @param result Output variable for result
+ * @param func_type Function token type
+ * @param args Array of argument values
+ * @param arg_count Number of arguments
+ * @return 1 on success, 0 on error
+ */
+int functions_eval_ctx(EvalContext *ctx, mpfr_t result, TokenType func_type, mpfr_t args[],
+                       int arg_count);
+
+/**
+ * Call a function through its registry entry (see function_registry.h)
+ * This is the evaluators' path: the entry was resolved when the call's node
+ * was created and the parser checked the arity, so the call is a domain
+ * check and one indirect call. Errors are reported as by functions_eval_ctx().
+ * @param ctx Context to evaluate in
+ * @param result Output variable for result
+ * @param def Function's entry; NULL fails as an unknown function
+ * @param args Argument values, as many as def->arg_count
+ * @return 1 on success, 0 on error
+ */
+int functions_call(EvalContext *ctx, mpfr_t result, const FunctionDef *def, mpfr_t args[]);
+
+/**
+ * Evaluate a mathematical function on intervals (see interval.h)
+ * The result contains the function's value at every point of the
+ * arguments where it is defined. An argument wholly outside the domain
+ * fails as functions_eval_ctx() fails on it, with the same error, and the
+ * result holds the value that call gives.
+ * @param ctx Context to evaluate in
+ * @param result Output interval
+ * @param func_type Function token type
+ * @param args Array of argument intervals
+ * @param arg_count Number of arguments
+ * @return 1 on success, 0 on error
+ */
+int functions_eval_interval(EvalContext *ctx, Interval *result, TokenType func_type,
+                            const Interval args[], int arg_count);
+
+/**
+ * Raise a value to a power with the cheapest MPFR primitive that fits
+ * Exponents 0, 1, 2, -1, 0.5 and -0.5 use a copy, mpfr_sqr(),
+ * mpfr_ui_div(), mpfr_sqrt() or mpfr_rec_sqrt(). Other integer exponents
+ * use mpfr_pow_si() at precisions where it is faster. Everything else goes
+ * to mpfr_pow(). Every primitive rounds correctly and special values are
+ * routed to mpfr_pow() where they differ, so the result and ternary value
+ * always equal mpfr_pow()'s.
+ * @param result Output variable for result
+ * @param base Value to raise
+ * @param exponent Power to raise it to
+ * @param rounding Rounding mode
+ * @return Ternary value, as for mpfr_pow()
+ */
+int functions_pow(mpfr_t result, mpfr_srcptr base, mpfr_srcptr exponent, mpfr_rnd_t rounding);
+
+/**
+ * Multiply two values with the cheapest MPFR primitive that fits
+ * Equal operands are squared, positive powers of two become a shift, and
+ * integer operands use mpfr_mul_si(). Same result and ternary value as
+ * mpfr_mul().
+ * @param result Output variable for result
+ * @param left First factor
+ * @param right Second factor
+ * @param rounding Rounding mode
+ * @return Ternary value, as for mpfr_mul()
+ */
+int functions_mul(mpfr_t result, mpfr_srcptr left, mpfr_srcptr right, mpfr_rnd_t rounding);
+
+/**
+ * Divide two values with the cheapest MPFR primitive that fits
+ * Positive powers of two become a shift and integer divisors use
+ * mpfr_div_si(). Same result and ternary value as mpfr_div(), which
+ * includes division by zero; callers that report it check first.
+ * @param result Output variable for result
+ * @param dividend Value to divide
+ * @param divisor Value to divide by
+ * @param rounding Rounding mode
+ * @return Ternary value, as for mpfr_div()
+ */
+int functions_div(mpfr_t result, mpfr_srcptr dividend, mpfr_srcptr divisor,
+                  mpfr_rnd_t rounding);
+
+/**
+ * Multiply a list of factors, pairing neighbours so that long products
+ * round through a balanced tree rather than a chain
+ * The factors are overwritten with partial products.
+ * @param result Output variable for result
+ * @param terms Factors, at least one
+ * @param count Number of factors
+ * @param rounding Rounding mode
+ * @return Ternary value of the final rounding into result
+ */
+int functions_product(mpfr_t result, mpfr_ptr terms[], int count, mpfr_rnd_t rounding);
+
 /**
  * Check if function evaluation would cause domain error
  * @param func_type Function token type
@@ -40,11 +149,17 @@ const char *functions_get_last_error(void);
 void functions_clear_error(void);
 
 /**
- * Set function evaluation mode
+ * Set function evaluation mode for the calling thread
  * @param strict_domain If 1, domain errors return NaN; if 0, return 0 with error
  */
 void functions_set_strict_domain(int strict_domain);
 
+/**
+ * Get function evaluation mode for the calling thread
+ * @return 1 if strict domain checking is enabled, 0 otherwise
+ */
+int functions_get_strict_domain(void);
+
 /**
  * Cleanup functions system
  */
@@ -0,0 +1,681 @@
+#include "interval.h"
+#include <math.h>
+#include <stddef.h>
+
+// Largest exponent of a sin, cos or tan argument whose distance to the
+// nearest multiple of pi is worked out; beyond it the whole range is used
+#define INTERVAL_TRIG_MAX_EXPONENT 65536
+
+// Operation on bounds with a rounding mode, as MPFR's functions are
+typedef int (*BoundFunction)(mpfr_ptr, mpfr_srcptr, mpfr_rnd_t);
+typedef int (*BoundOperation)(mpfr_ptr, mpfr_srcptr, mpfr_srcptr, mpfr_rnd_t);
+
+void interval_init2(Interval *x, mpfr_prec_t precision)
+{
+    mpfr_init2(x->lo, precision);
+    mpfr_init2(x->hi, precision);
+    mpfr_set_zero(x->lo, 1);
+    mpfr_set_zero(x->hi, 1);
+}
+
+void interval_clear(Interval *x)
+{
+    mpfr_clear(x->lo);
+    mpfr_clear(x->hi);
+}
+
+void interval_set(Interval *result, const Interval *x)
+{
+    mpfr_set(result->lo, x->lo, MPFR_RNDD);
+    mpfr_set(result->hi, x->hi, MPFR_RNDU);
+}
+
+void interval_set_fr(Interval *result, mpfr_srcptr value)
+{
+    mpfr_set(result->lo, value, MPFR_RNDD);
+    mpfr_set(result->hi, value, MPFR_RNDU);
+}
+
+int interval_set_constant(Interval *result, ConstantType type)
+{
+    switch (type)
+    {
+    case CONST_PI:
+        mpfr_const_pi(result->lo, MPFR_RNDD);
+        mpfr_const_pi(result->hi, MPFR_RNDU);
+        return 1;
+    case CONST_E:
+        mpfr_set_ui(result->lo, 1, MPFR_RNDN);
+        mpfr_exp(result->lo, result->lo, MPFR_RNDD);
+        mpfr_set_ui(result->hi, 1, MPFR_RNDN);
+        mpfr_exp(result->hi, result->hi, MPFR_RNDU);
+        return 1;
+    case CONST_LN2:
+        mpfr_const_log2(result->lo, MPFR_RNDD);
+        mpfr_const_log2(result->hi, MPFR_RNDU);
+        return 1;
+    case CONST_LN10:
+        mpfr_log_ui(result->lo, 10, MPFR_RNDD);
+        mpfr_log_ui(result->hi, 10, MPFR_RNDU);
+        return 1;
+    case CONST_GAMMA:
+        mpfr_const_euler(result->lo, MPFR_RNDD);
+        mpfr_const_euler(result->hi, MPFR_RNDU);
+        return 1;
+    case CONST_SQRT2:
+        mpfr_sqrt_ui(result->lo, 2, MPFR_RNDD);
+        mpfr_sqrt_ui(result->hi, 2, MPFR_RNDU);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+void interval_set_rounded(Interval *result, mpfr_srcptr value)
+{
+    // The copy keeps value's precision, and value may be overwritten
+    mpfr_t bound;
+    mpfr_init2(bound, mpfr_get_prec(value));
+    mpfr_set(bound, value, MPFR_RNDN);
+    mpfr_nextbelow(bound);
+    mpfr_set(result->lo, bound, MPFR_RNDD);
+    mpfr_nextabove(bound);
+    mpfr_nextabove(bound);
+    mpfr_set(result->hi, bound, MPFR_RNDU);
+    mpfr_clear(bound);
+}
+
+void interval_widen(Interval *x)
+{
+    mpfr_nextbelow(x->lo);
+    mpfr_nextabove(x->hi);
+}
+
+int interval_is_point(const Interval *x)
+{
+    return mpfr_equal_p(x->lo, x->hi);
+}
+
+int interval_contains_zero(const Interval *x)
+{
+    return !mpfr_nan_p(x->lo) && !mpfr_nan_p(x->hi) && mpfr_sgn(x->lo) <= 0 &&
+           mpfr_sgn(x->hi) >= 0;
+}
+
+void interval_mid(mpfr_t mid, const Interval *x, mpfr_rnd_t rounding)
+{
+    // Halving is exact, so the sum of the halves rounds once and cannot
+    // overflow; [-inf, inf] has no middle and gives NaN
+    mpfr_t lo, hi;
+    mpfr_init2(lo, mpfr_get_prec(x->lo));
+    mpfr_init2(hi, mpfr_get_prec(x->hi));
+    mpfr_div_2ui(lo, x->lo, 1, MPFR_RNDN);
+    mpfr_div_2ui(hi, x->hi, 1, MPFR_RNDN);
+    mpfr_add(mid, lo, hi, rounding);
+    mpfr_clear(hi);
+    mpfr_clear(lo);
+}
+
+void interval_set_nan(Interval *x)
+{
+    mpfr_set_nan(x->lo);
+    mpfr_set_nan(x->hi);
+}
+
+static int interval_is_nan(const Interval *x)
+{
+    return mpfr_nan_p(x->lo) || mpfr_nan_p(x->hi);
+}
+
+static void interval_set_entire(Interval *x)
+{
+    mpfr_set_inf(x->lo, -1);
+    mpfr_set_inf(x->hi, 1);
+}
+
+// Apply an increasing function to both bounds
+static void interval_increasing(Interval *result, const Interval *x, BoundFunction function)
+{
+    function(result->lo, x->lo, MPFR_RNDD);
+    function(result->hi, x->hi, MPFR_RNDU);
+}
+
+// Apply a decreasing function to both bounds, which swaps them
+static void interval_decreasing(Interval *result, const Interval *x, BoundFunction function)
+{
+    mpfr_t lo;
+    mpfr_init2(lo, mpfr_get_prec(result->lo));
+    function(lo, x->hi, MPFR_RNDD);
+    function(result->hi, x->lo, MPFR_RNDU);
+    mpfr_swap(result->lo, lo);
+    mpfr_clear(lo);
+}
+
+// Combine the four corners of x and y with an operation that takes its
+// extremes over the box at the corners. Any NaN corner makes the result
+// NaN.
+static void interval_corners(Interval *result, const Interval *x, const Interval *y,
+                             BoundOperation operation)
+{
+    mpfr_srcptr xs[2] = {x->lo, x->hi};
+    mpfr_srcptr ys[2] = {y->lo, y->hi};
+    mpfr_t lo, hi, corner;
+    mpfr_init2(lo, mpfr_get_prec(result->lo));
+    mpfr_init2(hi, mpfr_get_prec(result->hi));
+    mpfr_init2(corner, mpfr_get_prec(result->hi));
+
+    int nan = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        operation(corner, xs[i / 2], ys[i % 2], MPFR_RNDD);
+        nan |= mpfr_nan_p(corner);
+        if (i == 0 || mpfr_less_p(corner, lo))
+        {
+            mpfr_set(lo, corner, MPFR_RNDD);
+        }
+        operation(corner, xs[i / 2], ys[i % 2], MPFR_RNDU);
+        if (i == 0 || mpfr_greater_p(corner, hi))
+        {
+            mpfr_set(hi, corner, MPFR_RNDU);
+        }
+    }
+
+    mpfr_swap(result->lo, lo);
+    mpfr_swap(result->hi, hi);
+    if (nan)
+    {
+        interval_set_nan(result);
+    }
+    mpfr_clear(corner);
+    mpfr_clear(hi);
+    mpfr_clear(lo);
+}
+
+// Product of two bounds, where zero times an infinite bound is zero: the
+// infinity only stands for values growing without limit
+static int interval_mul_bound(mpfr_ptr result, mpfr_srcptr x, mpfr_srcptr y, mpfr_rnd_t rounding)
+{
+    if (mpfr_zero_p(x) || mpfr_zero_p(y))
+    {
+        mpfr_set_zero(result, 1);
+        return 0;
+    }
+    return mpfr_mul(result, x, y, rounding);
+}
+
+// Quotient of two bounds, where infinity over infinity can be anything of
+// its sign
+static int interval_div_bound(mpfr_ptr result, mpfr_srcptr x, mpfr_srcptr y, mpfr_rnd_t rounding)
+{
+    if (mpfr_inf_p(x) && mpfr_inf_p(y))
+    {
+        int sign = mpfr_sgn(x) * mpfr_sgn(y);
+        if ((sign > 0) == (rounding == MPFR_RNDU))
+        {
+            mpfr_set_inf(result, sign);
+        }
+        else
+        {
+            mpfr_set_zero(result, sign);
+        }
+        return 0;
+    }
+    return mpfr_div(result, x, y, rounding);
+}
+
+void interval_neg(Interval *result, const Interval *x)
+{
+    interval_decreasing(result, x, mpfr_neg);
+}
+
+void interval_add(Interval *result, const Interval *x, const Interval *y)
+{
+    mpfr_add(result->lo, x->lo, y->lo, MPFR_RNDD);
+    mpfr_add(result->hi, x->hi, y->hi, MPFR_RNDU);
+}
+
+void interval_sub(Interval *result, const Interval *x, const Interval *y)
+{
+    mpfr_t lo;
+    mpfr_init2(lo, mpfr_get_prec(result->lo));
+    mpfr_sub(lo, x->lo, y->hi, MPFR_RNDD);
+    mpfr_sub(result->hi, x->hi, y->lo, MPFR_RNDU);
+    mpfr_swap(result->lo, lo);
+    mpfr_clear(lo);
+}
+
+void interval_mul(Interval *result, const Interval *x, const Interval *y)
+{
+    interval_corners(result, x, y, interval_mul_bound);
+}
+
+void interval_div(Interval *result, const Interval *x, const Interval *y)
+{
+    if (interval_is_nan(x) || interval_is_nan(y))
+    {
+        interval_set_nan(result);
+    }
+    else if (interval_contains_zero(y))
+    {
+        interval_set_entire(result);
+    }
+    else
+    {
+        interval_corners(result, x, y, interval_div_bound);
+    }
+}
+
+void interval_pow(Interval *result, const Interval *x, const Interval *y)
+{
+    if (interval_is_nan(x) || interval_is_nan(y))
+    {
+        interval_set_nan(result);
+        return;
+    }
+
+    // An integer power is monotone on each side of zero
+    if (interval_is_point(y) && mpfr_integer_p(y->lo) && mpfr_fits_slong_p(y->lo, MPFR_RNDN))
+    {
+        long n = mpfr_get_si(y->lo, MPFR_RNDN);
+        unsigned long m = n < 0 ? -(unsigned long)n : (unsigned long)n;
+        if (n == 0)
+        {
+            mpfr_set_ui(result->lo, 1, MPFR_RNDN);
+            mpfr_set_ui(result->hi, 1, MPFR_RNDN);
+            return;
+        }
+
+        Interval power;
+        interval_init2(&power, mpfr_get_prec(result->lo));
+        if (m % 2 == 1 || mpfr_sgn(x->lo) >= 0)
+        {
+            mpfr_pow_ui(power.lo, x->lo, m, MPFR_RNDD);
+            mpfr_pow_ui(power.hi, x->hi, m, MPFR_RNDU);
+        }
+        else if (mpfr_sgn(x->hi) <= 0)
+        {
+            mpfr_pow_ui(power.lo, x->hi, m, MPFR_RNDD);
+            mpfr_pow_ui(power.hi, x->lo, m, MPFR_RNDU);
+        }
+        else
+        {
+            mpfr_set_zero(power.lo, 1);
+            mpfr_srcptr far = mpfr_cmpabs(x->lo, x->hi) > 0 ? x->lo : x->hi;
+            mpfr_pow_ui(power.hi, far, m, MPFR_RNDU);
+        }
+
+        if (n < 0)
+        {
+            Interval one;
+            interval_init2(&one, mpfr_get_prec(result->lo));
+            mpfr_set_ui(one.lo, 1, MPFR_RNDN);
+            mpfr_set_ui(one.hi, 1, MPFR_RNDN);
+            interval_div(result, &one, &power);
+            interval_clear(&one);
+        }
+        else
+        {
+            interval_set(result, &power);
+        }
+        interval_clear(&power);
+        return;
+    }
+
+    // Otherwise only a base >= 0 has a power, and x^y is monotone in x and
+    // in y there, so its extremes over the box are at the corners
+    if (mpfr_sgn(x->hi) < 0)
+    {
+        interval_set_nan(result);
+        return;
+    }
+    Interval base;
+    interval_init2(&base, mpfr_get_prec(x->lo));
+    interval_set(&base, x);
+    if (mpfr_sgn(base.lo) <= 0)
+    {
+        mpfr_set_zero(base.lo, 1);
+    }
+    interval_corners(result, &base, y, mpfr_pow);
+    interval_clear(&base);
+}
+
+// Find the integers k with (k + offset) * pi in [lo, hi], allowing for pi
+// being known only to the bounds' precision. Sets k_min and k_max; there
+// are none when k_min > k_max. Integers are counted conservatively: one
+// just outside the interval may be included, never one inside left out.
+static void interval_pi_multiples(mpfr_t k_min, mpfr_t k_max, const Interval *x, int half)
+{
+    mpfr_prec_t precision = mpfr_get_prec(x->lo) + 2;
+    mpfr_t pi_lo, pi_hi;
+    mpfr_init2(pi_lo, precision);
+    mpfr_init2(pi_hi, precision);
+    mpfr_const_pi(pi_lo, MPFR_RNDD);
+    mpfr_const_pi(pi_hi, MPFR_RNDU);
+
+    // Smallest possible lo / pi and largest possible hi / pi
+    mpfr_div(k_min, x->lo, mpfr_sgn(x->lo) >= 0 ? pi_hi : pi_lo, MPFR_RNDD);
+    mpfr_div(k_max, x->hi, mpfr_sgn(x->hi) >= 0 ? pi_lo : pi_hi, MPFR_RNDU);
+    if (half)
+    {
+        mpfr_sub_d(k_min, k_min, 0.5, MPFR_RNDD);
+        mpfr_sub_d(k_max, k_max, 0.5, MPFR_RNDU);
+    }
+    mpfr_ceil(k_min, k_min);
+    mpfr_floor(k_max, k_max);
+
+    mpfr_clear(pi_hi);
+    mpfr_clear(pi_lo);
+}
+
+// Exponent of a bound, with zero counted as 0 (it has none)
+static mpfr_exp_t interval_bound_exponent(mpfr_srcptr bound)
+{
+    return mpfr_regular_p(bound) ? mpfr_get_exp(bound) : 0;
+}
+
+// Precision at which (k + offset) * pi can be told apart from the bounds
+// of x, or 0 if they are too large for that
+static mpfr_prec_t interval_trig_precision(const Interval *x)
+{
+    mpfr_exp_t lo_exponent = interval_bound_exponent(x->lo);
+    mpfr_exp_t hi_exponent = interval_bound_exponent(x->hi);
+    mpfr_exp_t exponent = hi_exponent > lo_exponent ? hi_exponent : lo_exponent;
+    if (exponent > INTERVAL_TRIG_MAX_EXPONENT)
+    {
+        return 0;
+    }
+    return mpfr_get_prec(x->lo) + (exponent > 0 ? (mpfr_prec_t)exponent : 0);
+}
+
+// sin and cos: monotone between their extremes at (k + 1/2) * pi for sin
+// and k * pi for cos, which are 1 for even k and -1 for odd k
+static void interval_sin_cos(Interval *result, const Interval *x, int sine)
+{
+    if (interval_is_nan(x))
+    {
+        interval_set_nan(result);
+        return;
+    }
+    mpfr_prec_t precision = mpfr_inf_p(x->lo) || mpfr_inf_p(x->hi) ? 0
+                                                                    : interval_trig_precision(x);
+    if (!precision)
+    {
+        mpfr_set_si(result->lo, -1, MPFR_RNDN);
+        mpfr_set_si(result->hi, 1, MPFR_RNDN);
+        return;
+    }
+
+    BoundFunction function = sine ? mpfr_sin : mpfr_cos;
+    mpfr_t k_min, k_max, lo, hi, other;
+    mpfr_init2(k_min, precision);
+    mpfr_init2(k_max, precision);
+    mpfr_init2(lo, mpfr_get_prec(result->lo));
+    mpfr_init2(hi, mpfr_get_prec(result->hi));
+    mpfr_init2(other, mpfr_get_prec(result->hi));
+    interval_pi_multiples(k_min, k_max, x, sine);
+
+    // Both extremes inside: the whole range
+    mpfr_sub(other, k_max, k_min, MPFR_RNDU);
+    if (mpfr_cmp_ui(other, 1) >= 0)
+    {
+        mpfr_set_si(lo, -1, MPFR_RNDN);
+        mpfr_set_si(hi, 1, MPFR_RNDN);
+    }
+    else
+    {
+        function(lo, x->lo, MPFR_RNDD);
+        function(other, x->hi, MPFR_RNDD);
+        mpfr_min(lo, lo, other, MPFR_RNDD);
+        function(hi, x->lo, MPFR_RNDU);
+        function(other, x->hi, MPFR_RNDU);
+        mpfr_max(hi, hi, other, MPFR_RNDU);
+
+        // One extreme inside
+        if (mpfr_equal_p(k_min, k_max))
+        {
+            mpfr_div_2ui(k_min, k_min, 1, MPFR_RNDN);
+            if (mpfr_integer_p(k_min))
+            {
+                mpfr_set_ui(hi, 1, MPFR_RNDN);
+            }
+            else
+            {
+                mpfr_set_si(lo, -1, MPFR_RNDN);
+            }
+        }
+    }
+
+    mpfr_swap(result->lo, lo);
+    mpfr_swap(result->hi, hi);
+    mpfr_clear(other);
+    mpfr_clear(hi);
+    mpfr_clear(lo);
+    mpfr_clear(k_max);
+    mpfr_clear(k_min);
+}
+
+void interval_sin(Interval *result, const Interval *x)
+{
+    interval_sin_cos(result, x, 1);
+}
+
+void interval_cos(Interval *result, const Interval *x)
+{
+    interval_sin_cos(result, x, 0);
+}
+
+void interval_tan(Interval *result, const Interval *x)
+{
+    if (interval_is_nan(x))
+    {
+        interval_set_nan(result);
+        return;
+    }
+    mpfr_prec_t precision = mpfr_inf_p(x->lo) || mpfr_inf_p(x->hi) ? 0
+                                                                    : interval_trig_precision(x);
+    if (!precision)
+    {
+        interval_set_entire(result);
+        return;
+    }
+
+    // Increasing between its poles at (k + 1/2) * pi
+    mpfr_t k_min, k_max;
+    mpfr_init2(k_min, precision);
+    mpfr_init2(k_max, precision);
+    interval_pi_multiples(k_min, k_max, x, 1);
+    if (mpfr_lessequal_p(k_min, k_max))
+    {
+        interval_set_entire(result);
+    }
+    else
+    {
+        interval_increasing(result, x, mpfr_tan);
+    }
+    mpfr_clear(k_max);
+    mpfr_clear(k_min);
+}
+
+// Copy the part of x inside [min, max]; 0 if there is none
+static int interval_clip(Interval *result, const Interval *x, double min, double max)
+{
+    if (interval_is_nan(x) || mpfr_cmp_d(x->hi, min) < 0 || mpfr_cmp_d(x->lo, max) > 0)
+    {
+        return 0;
+    }
+    interval_set(result, x);
+    if (mpfr_cmp_d(result->lo, min) < 0)
+    {
+        mpfr_set_d(result->lo, min, MPFR_RNDN);
+    }
+    if (mpfr_cmp_d(result->hi, max) > 0)
+    {
+        mpfr_set_d(result->hi, max, MPFR_RNDN);
+    }
+    return 1;
+}
+
+// Apply a monotone function to the part of x in [min, max]; NaN if none
+static void interval_restricted(Interval *result, const Interval *x, double min, double max,
+                                BoundFunction function, int increasing)
+{
+    Interval domain;
+    interval_init2(&domain, mpfr_get_prec(x->lo));
+    if (!interval_clip(&domain, x, min, max))
+    {
+        interval_set_nan(result);
+    }
+    else if (increasing)
+    {
+        interval_increasing(result, &domain, function);
+    }
+    else
+    {
+        interval_decreasing(result, &domain, function);
+    }
+    interval_clear(&domain);
+}
+
+void interval_asin(Interval *result, const Interval *x)
+{
+    interval_restricted(result, x, -1, 1, mpfr_asin, 1);
+}
+
+void interval_acos(Interval *result, const Interval *x)
+{
+    interval_restricted(result, x, -1, 1, mpfr_acos, 0);
+}
+
+void interval_atan(Interval *result, const Interval *x)
+{
+    interval_increasing(result, x, mpfr_atan);
+}
+
+void interval_atan2(Interval *result, const Interval *y, const Interval *x)
+{
+    if (interval_is_nan(x) || interval_is_nan(y))
+    {
+        interval_set_nan(result);
+        return;
+    }
+
+    // Away from the origin and the cut along the negative x axis the angle
+    // is continuous, and its extremes over the box are at the corners
+    if (mpfr_sgn(x->lo) > 0 || mpfr_sgn(y->lo) > 0 || mpfr_sgn(y->hi) < 0)
+    {
+        interval_corners(result, y, x, mpfr_atan2);
+        return;
+    }
+    mpfr_const_pi(result->lo, MPFR_RNDU);
+    mpfr_neg(result->lo, result->lo, MPFR_RNDD);
+    mpfr_const_pi(result->hi, MPFR_RNDU);
+}
+
+void interval_sinh(Interval *result, const Interval *x)
+{
+    interval_increasing(result, x, mpfr_sinh);
+}
+
+// Functions decreasing below zero and increasing above it
+static void interval_even(Interval *result, const Interval *x, BoundFunction function)
+{
+    if (interval_is_nan(x))
+    {
+        interval_set_nan(result);
+    }
+    else if (mpfr_sgn(x->lo) >= 0)
+    {
+        interval_increasing(result, x, function);
+    }
+    else if (mpfr_sgn(x->hi) <= 0)
+    {
+        interval_decreasing(result, x, function);
+    }
+    else
+    {
+        mpfr_srcptr far = mpfr_cmpabs(x->lo, x->hi) > 0 ? x->lo : x->hi;
+        function(result->hi, far, MPFR_RNDU);
+        mpfr_set_zero(result->lo, 1);
+        function(result->lo, result->lo, MPFR_RNDD);
+    }
+}
+
+void interval_cosh(Interval *result, const Interval *x)
+{
+    interval_even(result, x, mpfr_cosh);
+}
+
+void interval_tanh(Interval *result, const Interval *x)
+{
+    interval_increasing(result, x, mpfr_tanh);
+}
+
+void interval_asinh(Interval *result, const Interval *x)
+{
+    interval_increasing(result, x, mpfr_asinh);
+}
+
+void interval_acosh(Interval *result, const Interval *x)
+{
+    interval_restricted(result, x, 1, INFINITY, mpfr_acosh, 1);
+}
+
+void interval_atanh(Interval *result, const Interval *x)
+{
+    interval_restricted(result, x, -1, 1, mpfr_atanh, 1);
+}
+
+// Functions of x >= 0 (or x > 0, where they go to -inf at zero)
+static void interval_nonnegative(Interval *result, const Interval *x, BoundFunction function)
+{
+    if (interval_is_nan(x) || mpfr_sgn(x->hi) < 0)
+    {
+        interval_set_nan(result);
+        return;
+    }
+    mpfr_t lo;
+    mpfr_init2(lo, mpfr_get_prec(x->lo));
+    mpfr_set(lo, x->lo, MPFR_RNDD);
+    if (mpfr_sgn(lo) <= 0)
+    {
+        mpfr_set_zero(lo, 1);
+    }
+    function(result->hi, x->hi, MPFR_RNDU);
+    function(result->lo, lo, MPFR_RNDD);
+    mpfr_clear(lo);
+}
+
+void interval_sqrt(Interval *result, const Interval *x)
+{
+    interval_nonnegative(result, x, mpfr_sqrt);
+}
+
+void interval_log(Interval *result, const Interval *x)
+{
+    interval_nonnegative(result, x, mpfr_log);
+}
+
+void interval_log10(Interval *result, const Interval *x)
+{
+    interval_nonnegative(result, x, mpfr_log10);
+}
+
+void interval_exp(Interval *result, const Interval *x)
+{
+    interval_increasing(result, x, mpfr_exp);
+}
+
+void interval_abs(Interval *result, const Interval *x)
+{
+    interval_even(result, x, mpfr_abs);
+}
+
+void interval_floor(Interval *result, const Interval *x)
+{
+    interval_increasing(result, x, mpfr_rint_floor);
+}
+
+void interval_ceil(Interval *result, const Interval *x)
+{
+    interval_increasing(result, x, mpfr_rint_ceil);
+}
@@ -0,0 +1,150 @@
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include "constants.h"
+#include <mpfr.h>
+
+/**
+ * Closed interval [lo, hi] of real numbers
+ *
+ * Every operation rounds its lower bound down and its upper bound up, so
+ * the result contains every value the operation can take on its operands'
+ * intervals. A bound may be infinite; NaN bounds mean the result is not a
+ * real number at all. Functions restricted to a domain only count the
+ * part of the argument inside it, as MPFI does: sqrt([-1, 4]) is [0, 2].
+ */
+typedef struct
+{
+    mpfr_t lo;
+    mpfr_t hi;
+} Interval;
+
+/**
+ * Initialize an interval to [0, 0]
+ * @param x Interval to initialize
+ * @param precision Precision of both bounds in bits
+ */
+void interval_init2(Interval *x, mpfr_prec_t precision);
+
+/**
+ * Release the bounds of an interval
+ * @param x Interval to clear
+ */
+void interval_clear(Interval *x);
+
+/**
+ * Copy an interval, rounding outward to the result's precision
+ * @param result Output interval
+ * @param x Interval to copy
+ */
+void interval_set(Interval *result, const Interval *x);
+
+/**
+ * Set an interval to the smallest one holding a value
+ * @param result Output interval
+ * @param value Value to enclose
+ */
+void interval_set_fr(Interval *result, mpfr_srcptr value);
+
+/**
+ * Set an interval to a mathematical constant
+ * @param result Output interval
+ * @param type Constant to enclose
+ * @return 1 on success, 0 if the constant is unknown
+ */
+int interval_set_constant(Interval *result, ConstantType type);
+
+/**
+ * Enclose a value that is only known to within one unit in the last place
+ * of its own precision, such as a decimal literal the parser rounded to
+ * nearest. The interval's bounds are usually finer, so widening them by
+ * their own ulp would not be enough.
+ * @param result Output interval
+ * @param value Rounded value; may be one of result's bounds
+ */
+void interval_set_rounded(Interval *result, mpfr_srcptr value);
+
+/**
+ * Move both bounds one unit in the last place outward
+ * Used for values known only to be within that of the truth, such as
+ * decimal literals rounded to nearest by the parser.
+ * @param x Interval to widen in place
+ */
+void interval_widen(Interval *x);
+
+/**
+ * Check whether an interval holds a single value
+ * @param x Interval to inspect
+ * @return 1 if lo == hi, 0 otherwise (including NaN bounds)
+ */
+int interval_is_point(const Interval *x);
+
+/**
+ * Check whether an interval contains zero
+ * @param x Interval to inspect
+ * @return 1 if lo <= 0 <= hi, 0 otherwise
+ */
+int interval_contains_zero(const Interval *x);
+
+/**
+ * Get the midpoint of an interval
+ * @param mid Output value, rounded to its precision
+ * @param x Interval to inspect
+ * @param rounding Rounding mode
+ */
+void interval_mid(mpfr_t mid, const Interval *x, mpfr_rnd_t rounding);
+
+/**
+ * Set both bounds to NaN
+ * @param x Interval to change
+ */
+void interval_set_nan(Interval *x);
+
+/**
+ * Arithmetic on intervals
+ * Division by an interval that contains zero gives [-inf, inf].
+ * result may be the same interval as an operand.
+ */
+void interval_neg(Interval *result, const Interval *x);
+void interval_add(Interval *result, const Interval *x, const Interval *y);
+void interval_sub(Interval *result, const Interval *x, const Interval *y);
+void interval_mul(Interval *result, const Interval *x, const Interval *y);
+void interval_div(Interval *result, const Interval *x, const Interval *y);
+
+/**
+ * Raise an interval to an interval power
+ * A single integer exponent also allows negative bases; otherwise only
+ * the positive part of the base counts, and a base with no positive part
+ * gives NaN, as mpfr_pow() does for a negative base.
+ * @param result Output interval
+ * @param x Base
+ * @param y Exponent
+ */
+void interval_pow(Interval *result, const Interval *x, const Interval *y);
+
+/**
+ * Elementary functions on intervals, one per calculator function
+ * result may be the same interval as the argument.
+ */
+void interval_sin(Interval *result, const Interval *x);
+void interval_cos(Interval *result, const Interval *x);
+void interval_tan(Interval *result, const Interval *x);
+void interval_asin(Interval *result, const Interval *x);
+void interval_acos(Interval *result, const Interval *x);
+void interval_atan(Interval *result, const Interval *x);
+void interval_atan2(Interval *result, const Interval *y, const Interval *x);
+void interval_sinh(Interval *result, const Interval *x);
+void interval_cosh(Interval *result, const Interval *x);
+void interval_tanh(Interval *result, const Interval *x);
+void interval_asinh(Interval *result, const Interval *x);
+void interval_acosh(Interval *result, const Interval *x);
+void interval_atanh(Interval *result, const Interval *x);
+void interval_sqrt(Interval *result, const Interval *x);
+void interval_log(Interval *result, const Interval *x);
+void interval_log10(Interval *result, const Interval *x);
+void interval_exp(Interval *result, const Interval *x);
+void interval_abs(Interval *result, const Interval *x);
+void interval_floor(Interval *result, const Interval *x);
+void interval_ceil(Interval *result, const Interval *x);
+
+#endif // INTERVAL_H
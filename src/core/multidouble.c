@@ -0,0 +1,1645 @@
+#include "multidouble.h"
+#include "context.h"
+#include "constants.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MD_MAX_TERMS 4
+
+_Static_assert(CONSTANT_DOUBLE_TERMS >= MD_MAX_TERMS, "constants must supply every term");
+
+// An unevaluated sum of doubles and a bound on its absolute error
+typedef struct
+{
+    double term[MD_MAX_TERMS]; // Nonoverlapping, largest first; unused terms are 0
+    double error;              // 0 when the value is exact
+} MdValue;
+
+typedef struct
+{
+    const EvalContext *ctx;
+    int terms;      // 2 for double-double, 4 for quad-double
+    double epsilon; // Error of one kernel operation, relative to its operands
+} MdState;
+
+// The double-double and quad-double kernels stay within about 2^-103 and
+// 2^-207 on normalized operands (square roots, the worst case, get their
+// own bound); these leave a margin on top
+#define MD_DD_EPSILON 0x1p-102
+#define MD_QD_EPSILON 0x1p-204
+
+// Absolute error added to every inexact operation, which covers low-order
+// terms falling into the subnormal range
+#define MD_UNDERFLOW 0x1p-1000
+
+// Node values stay within these magnitudes, so that products and quotients
+// of two of them neither overflow nor lose their low-order terms
+#define MD_MAX_MAGNITUDE 0x1p500
+#define MD_MIN_MAGNITUDE 0x1p-500
+
+// Relative slack between a value and its leading term
+#define MD_SLACK 0x1p-50
+
+// Argument reductions by halving before the Taylor series of exp and sin
+#define MD_EXP_HALVINGS 8
+#define MD_SINCOS_HALVINGS 6
+
+// Series are cut off after this many terms; their coefficients are
+// tabulated so that no term needs a division
+#define MD_SERIES_TERMS 128
+
+// Largest literal precision split into doubles; keeps every split term in
+// the normal range
+#define MD_LITERAL_BITS 512
+#define MD_LIMBS(bits) (((bits) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS)
+
+// Significands are read and written limb by limb where limbs are plain
+// 64-bit words, which is much cheaper than going through mpfr_set_d()
+#if GMP_NUMB_BITS == 64 && GMP_NAIL_BITS == 0
+#define MD_DIRECT_LIMBS 1
+#else
+#define MD_DIRECT_LIMBS 0
+#endif
+
+static int md_node(const MdState *st, const ASTNode *node, MdValue *out);
+
+// Error-free transformations
+
+static double two_sum(double a, double b, double *error)
+{
+    double s = a + b;
+    double bb = s - a;
+    *error = (a - (s - bb)) + (b - bb);
+    return s;
+}
+
+// Requires |a| >= |b|
+static double quick_two_sum(double a, double b, double *error)
+{
+    double s = a + b;
+    *error = b - (s - a);
+    return s;
+}
+
+static double two_prod(double a, double b, double *error)
+{
+    double p = a * b;
+    *error = fma(a, b, -p);
+    return p;
+}
+
+static void three_sum(double *a, double *b, double *c)
+{
+    double t1, t2, t3;
+    t1 = two_sum(*a, *b, &t2);
+    *a = two_sum(*c, t1, &t3);
+    *b = two_sum(t2, t3, c);
+}
+
+static void three_sum2(double *a, double *b, double *c)
+{
+    double t1, t2, t3;
+    t1 = two_sum(*a, *b, &t2);
+    *a = two_sum(*c, t1, &t3);
+    *b = t2 + t3;
+}
+
+// Double-double kernels (after Hida, Li and Bailey's QD library)
+
+static void dd_add(const double *a, const double *b, double *r)
+{
+    double s2, t2;
+    double s1 = two_sum(a[0], b[0], &s2);
+    double t1 = two_sum(a[1], b[1], &t2);
+    s2 += t1;
+    s1 = quick_two_sum(s1, s2, &s2);
+    s2 += t2;
+    r[0] = quick_two_sum(s1, s2, &r[1]);
+}
+
+static void dd_mul(const double *a, const double *b, double *r)
+{
+    double p2;
+    double p1 = two_prod(a[0], b[0], &p2);
+    p2 += a[0] * b[1] + a[1] * b[0];
+    r[0] = quick_two_sum(p1, p2, &r[1]);
+}
+
+static void dd_mul_d(const double *a, double b, double *r)
+{
+    double p2;
+    double p1 = two_prod(a[0], b, &p2);
+    p2 += a[1] * b;
+    r[0] = quick_two_sum(p1, p2, &r[1]);
+}
+
+static void dd_div(const double *a, const double *b, double *r)
+{
+    double product[2], rest[2];
+    double q0 = a[0] / b[0];
+    dd_mul_d(b, -q0, product);
+    dd_add(a, product, rest);
+    double q1 = rest[0] / b[0];
+    dd_mul_d(b, -q1, product);
+    dd_add(rest, product, rest);
+    double q2 = rest[0] / b[0];
+
+    double head[2], tail[2] = {q2, 0.0};
+    head[0] = quick_two_sum(q0, q1, &head[1]);
+    dd_add(head, tail, r);
+}
+
+static void dd_sqrt(const double *a, double *r)
+{
+    // One Newton step from the double square root
+    double x = 1.0 / sqrt(a[0]);
+    double ax = a[0] * x;
+    double square[2], rest[2];
+    square[0] = -two_prod(ax, ax, &square[1]);
+    square[1] = -square[1];
+    dd_add(a, square, rest);
+    r[0] = two_sum(ax, rest[0] * (x * 0.5), &r[1]);
+}
+
+// Quad-double kernels
+
+// Normalize five overlapping terms into four; unlike the QD library this
+// uses two_sum() throughout, so it does not rely on the terms' order
+static void qd_renorm(double *c, double *r)
+{
+    double s0, s1, s2 = 0.0, s3 = 0.0;
+
+    s0 = two_sum(c[3], c[4], &c[4]);
+    s0 = two_sum(c[2], s0, &c[3]);
+    s0 = two_sum(c[1], s0, &c[2]);
+    c[0] = two_sum(c[0], s0, &c[1]);
+
+    s0 = two_sum(c[0], c[1], &s1);
+    if (s1 != 0.0)
+    {
+        s1 = two_sum(s1, c[2], &s2);
+        if (s2 != 0.0)
+        {
+            s2 = two_sum(s2, c[3], &s3);
+            if (s3 != 0.0)
+                s3 += c[4];
+            else
+                s2 = two_sum(s2, c[4], &s3);
+        }
+        else
+        {
+            s1 = two_sum(s1, c[3], &s2);
+            if (s2 != 0.0)
+                s2 = two_sum(s2, c[4], &s3);
+            else
+                s1 = two_sum(s1, c[4], &s2);
+        }
+    }
+    else
+    {
+        s0 = two_sum(s0, c[2], &s1);
+        if (s1 != 0.0)
+        {
+            s1 = two_sum(s1, c[3], &s2);
+            if (s2 != 0.0)
+                s2 = two_sum(s2, c[4], &s3);
+            else
+                s1 = two_sum(s1, c[4], &s2);
+        }
+        else
+        {
+            s0 = two_sum(s0, c[3], &s1);
+            if (s1 != 0.0)
+                s1 = two_sum(s1, c[4], &s2);
+            else
+                s0 = two_sum(s0, c[4], &s1);
+        }
+    }
+
+    r[0] = s0;
+    r[1] = s1;
+    r[2] = s2;
+    r[3] = s3;
+}
+
+static void qd_add(const double *a, const double *b, double *r)
+{
+    double s[5], t0, t1, t2, t3;
+    s[0] = two_sum(a[0], b[0], &t0);
+    s[1] = two_sum(a[1], b[1], &t1);
+    s[2] = two_sum(a[2], b[2], &t2);
+    s[3] = two_sum(a[3], b[3], &t3);
+
+    s[1] = two_sum(s[1], t0, &t0);
+    three_sum(&s[2], &t0, &t1);
+    three_sum2(&s[3], &t0, &t2);
+    s[4] = t0 + t1 + t3;
+    qd_renorm(s, r);
+}
+
+static void qd_mul(const double *a, const double *b, double *r)
+{
+    double p[6], q[6], s[5], t0, t1;
+    p[0] = two_prod(a[0], b[0], &q[0]);
+    p[1] = two_prod(a[0], b[1], &q[1]);
+    p[2] = two_prod(a[1], b[0], &q[2]);
+    p[3] = two_prod(a[0], b[2], &q[3]);
+    p[4] = two_prod(a[1], b[1], &q[4]);
+    p[5] = two_prod(a[2], b[0], &q[5]);
+
+    three_sum(&p[1], &p[2], &q[0]);
+
+    // Six-three sum of p2, q1, q2, p3, p4 and p5
+    three_sum(&p[2], &q[1], &q[2]);
+    three_sum(&p[3], &p[4], &p[5]);
+    s[2] = two_sum(p[2], p[3], &t0);
+    s[3] = two_sum(q[1], p[4], &t1);
+    s[4] = q[2] + p[5];
+    s[3] = two_sum(s[3], t0, &t0);
+    s[4] += t0 + t1;
+
+    // Terms of the order of the fourth word
+    s[3] += a[0] * b[3] + a[1] * b[2] + a[2] * b[1] + a[3] * b[0] + q[0] + q[3] + q[4] + q[5];
+
+    s[0] = p[0];
+    s[1] = p[1];
+    qd_renorm(s, r);
+}
+
+static void qd_mul_d(const double *a, double b, double *r)
+{
+    double s[5], q0, q1, q2, p1, p2, p3;
+    s[0] = two_prod(a[0], b, &q0);
+    p1 = two_prod(a[1], b, &q1);
+    p2 = two_prod(a[2], b, &q2);
+    p3 = a[3] * b;
+
+    s[1] = two_sum(q0, p1, &s[2]);
+    three_sum(&s[2], &q1, &p2);
+    three_sum2(&q1, &q2, &p3);
+    s[3] = q1;
+    s[4] = q2 + p2;
+    qd_renorm(s, r);
+}
+
+static void qd_div(const double *a, const double *b, double *r)
+{
+    // Long division, one double of the quotient at a time
+    double q[5], rest[4], product[4];
+    memcpy(rest, a, sizeof(rest));
+    for (int i = 0; i < 5; i++)
+    {
+        q[i] = rest[0] / b[0];
+        if (i < 4)
+        {
+            qd_mul_d(b, -q[i], product);
+            qd_add(rest, product, rest);
+        }
+    }
+    qd_renorm(q, r);
+}
+
+static void qd_sqrt(const double *a, double *r)
+{
+    // Newton's step s + (a - s^2) / (2s), from the double-double root; the
+    // correction only needs double-double accuracy
+    double root[4] = {0.0, 0.0, 0.0, 0.0};
+    double square[4], rest[4], correction[4] = {0.0, 0.0, 0.0, 0.0};
+    dd_sqrt(a, root);
+    qd_mul(root, root, square);
+    for (int i = 0; i < 4; i++)
+    {
+        square[i] = -square[i];
+    }
+    qd_add(a, square, rest);
+    double twice[2] = {2 * root[0], 2 * root[1]};
+    dd_div(rest, twice, correction);
+    qd_add(root, correction, r);
+}
+
+// Kernels by number of terms
+
+static void md_raw_add(const MdState *st, const double *a, const double *b, double *r)
+{
+    if (st->terms == 2)
+        dd_add(a, b, r);
+    else
+        qd_add(a, b, r);
+}
+
+static void md_raw_mul(const MdState *st, const double *a, const double *b, double *r)
+{
+    if (st->terms == 2)
+        dd_mul(a, b, r);
+    else
+        qd_mul(a, b, r);
+}
+
+static void md_raw_mul_d(const MdState *st, const double *a, double b, double *r)
+{
+    if (st->terms == 2)
+        dd_mul_d(a, b, r);
+    else
+        qd_mul_d(a, b, r);
+}
+
+static void md_raw_div(const MdState *st, const double *a, const double *b, double *r)
+{
+    if (st->terms == 2)
+        dd_div(a, b, r);
+    else
+        qd_div(a, b, r);
+}
+
+static void md_raw_sqrt(const MdState *st, const double *a, double *r)
+{
+    if (st->terms == 2)
+        dd_sqrt(a, r);
+    else
+        qd_sqrt(a, r);
+}
+
+// Operations with error bounds. Each takes the errors of its operands
+// into account and adds its own rounding error; out may alias an operand.
+
+static void md_from_double(double value, MdValue *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->term[0] = value;
+}
+
+// Upper bound on |x| without its error
+static double md_magnitude(const MdValue *x)
+{
+    return fabs(x->term[0]) * (1 + MD_SLACK);
+}
+
+// An exact value held in a single double
+static int md_single(const MdValue *x)
+{
+    return x->error == 0.0 && x->term[1] == 0.0;
+}
+
+// Reject values the error model does not cover
+static int md_usable(const MdValue *x)
+{
+    double m = fabs(x->term[0]);
+    if (!isfinite(m) || !isfinite(x->error))
+    {
+        return 0;
+    }
+    return m == 0.0 || (m >= MD_MIN_MAGNITUDE && m <= MD_MAX_MAGNITUDE);
+}
+
+static void md_neg(const MdValue *x, MdValue *out)
+{
+    *out = *x;
+    for (int i = 0; i < MD_MAX_TERMS; i++)
+    {
+        out->term[i] = -out->term[i];
+    }
+}
+
+// Multiply by 2^exponent, which is exact
+static void md_scale(MdValue *x, int exponent)
+{
+    for (int i = 0; i < MD_MAX_TERMS; i++)
+    {
+        x->term[i] = ldexp(x->term[i], exponent);
+    }
+    x->error = ldexp(x->error, exponent);
+}
+
+static void md_add(const MdState *st, const MdValue *a, const MdValue *b, MdValue *out)
+{
+    MdValue r = {{0.0}, 0.0};
+    md_raw_add(st, a->term, b->term, r.term);
+    r.error = a->error + b->error;
+    // The sum of two doubles always fits
+    if (!md_single(a) || !md_single(b))
+    {
+        r.error += st->epsilon * (md_magnitude(a) + md_magnitude(b)) + MD_UNDERFLOW;
+    }
+    *out = r;
+}
+
+static void md_sub(const MdState *st, const MdValue *a, const MdValue *b, MdValue *out)
+{
+    MdValue negated;
+    md_neg(b, &negated);
+    md_add(st, a, &negated, out);
+}
+
+static void md_mul(const MdState *st, const MdValue *a, const MdValue *b, MdValue *out)
+{
+    double ma = md_magnitude(a);
+    double mb = md_magnitude(b);
+    MdValue r = {{0.0}, 0.0};
+    md_raw_mul(st, a->term, b->term, r.term);
+    r.error = ma * b->error + mb * a->error + a->error * b->error;
+    // So does the product of two doubles, unless it is near underflow
+    if (!md_single(a) || !md_single(b) || (ma * mb != 0.0 && ma * mb < 0x1p-900))
+    {
+        r.error += st->epsilon * ma * mb + MD_UNDERFLOW;
+    }
+    *out = r;
+}
+
+// Multiply by an exact double
+static void md_mul_d(const MdState *st, const MdValue *a, double b, MdValue *out)
+{
+    double ma = md_magnitude(a);
+    MdValue r = {{0.0}, 0.0};
+    md_raw_mul_d(st, a->term, b, r.term);
+    r.error = fabs(b) * a->error;
+    if (!md_single(a) || (ma * b != 0.0 && ma * fabs(b) < 0x1p-900))
+    {
+        r.error += st->epsilon * ma * fabs(b) + MD_UNDERFLOW;
+    }
+    *out = r;
+}
+
+// Fails when the divisor may be zero or is too uncertain
+static int md_div(const MdState *st, const MdValue *a, const MdValue *b, MdValue *out)
+{
+    double low = fabs(b->term[0]) * (1 - MD_SLACK) - b->error;
+    if (!(low > fabs(b->term[0]) / 2))
+    {
+        return 0;
+    }
+
+    MdValue r = {{0.0}, 0.0};
+    md_raw_div(st, a->term, b->term, r.term);
+    double mq = md_magnitude(&r);
+    r.error = (a->error + mq * b->error) / low;
+
+    // A quotient of doubles is exact when it is a double and its product
+    // with the divisor gives back the dividend
+    double product_error = 1.0;
+    if (!md_single(a) || !md_single(b) || r.term[1] != 0.0 ||
+        two_prod(r.term[0], b->term[0], &product_error) != a->term[0] || product_error != 0.0 ||
+        (mq != 0.0 && mq < 0x1p-900))
+    {
+        r.error += 2 * st->epsilon * mq + MD_UNDERFLOW;
+    }
+    *out = r;
+    return 1;
+}
+
+// Make a 53-bit MPFR number on the given limbs holding a double exactly
+static void md_set_double(mpfr_ptr rop, mp_limb_t *limbs, double value)
+{
+#if MD_DIRECT_LIMBS
+    if (value == 0.0)
+    {
+        mpfr_custom_init_set(rop, MPFR_ZERO_KIND, 0, DBL_MANT_DIG, limbs);
+        return;
+    }
+    int exponent;
+    double fraction = frexp(fabs(value), &exponent);
+    limbs[0] = (mp_limb_t)ldexp(fraction, 64);
+    mpfr_custom_init_set(rop, value < 0.0 ? -MPFR_REGULAR_KIND : MPFR_REGULAR_KIND, exponent,
+                         DBL_MANT_DIG, limbs);
+#else
+    mpfr_custom_init(limbs, DBL_MANT_DIG);
+    mpfr_custom_init_set(rop, MPFR_ZERO_KIND, 0, DBL_MANT_DIG, limbs);
+    mpfr_set_d(rop, value, MPFR_RNDN);
+#endif
+}
+
+// Peel count doubles off an MPFR number, largest first; each subtraction
+// is exact. Returns a bound on what is left, which rest then holds.
+static double md_split(mpfr_ptr rest, int count, double *terms)
+{
+    for (int i = 0; i < count; i++)
+    {
+        terms[i] = mpfr_zero_p(rest) ? 0.0 : mpfr_get_d(rest, MPFR_RNDN);
+        mpfr_sub_d(rest, rest, terms[i], MPFR_RNDN);
+    }
+    if (mpfr_zero_p(rest))
+    {
+        return 0.0;
+    }
+    mpfr_abs(rest, rest, MPFR_RNDN);
+    return mpfr_get_d(rest, MPFR_RNDU);
+}
+
+// Series coefficients, 1/k and 1/k! for k from 1 to MD_SERIES_TERMS + 1
+typedef struct
+{
+    double term[MD_SERIES_TERMS + 2][MD_MAX_TERMS];
+    double error[MD_SERIES_TERMS + 2];
+} MdTable;
+
+static MdTable md_reciprocals;
+static MdTable md_inverse_factorials;
+static pthread_once_t md_tables_once = PTHREAD_ONCE_INIT;
+
+static void md_tables_init(void)
+{
+    const mpfr_prec_t prec = MD_MAX_TERMS * DBL_MANT_DIG + 64;
+    mpfr_t rest, factorial;
+    mpfr_inits2(prec, rest, factorial, (mpfr_ptr)0);
+    mpfr_set_ui(factorial, 1, MPFR_RNDN);
+    for (int k = 1; k <= MD_SERIES_TERMS + 1; k++)
+    {
+        mpfr_set_ui(rest, 1, MPFR_RNDN);
+        mpfr_div_ui(rest, rest, (unsigned long)k, MPFR_RNDN);
+        double ulp = mpfr_get_d(rest, MPFR_RNDU) * ldexp(1.0, 1 - (int)prec);
+        md_reciprocals.error[k] = md_split(rest, MD_MAX_TERMS, md_reciprocals.term[k]) + ulp;
+
+        // Each division adds a relative error of at most one ulp
+        mpfr_div_ui(factorial, factorial, (unsigned long)k, MPFR_RNDN);
+        mpfr_set(rest, factorial, MPFR_RNDN);
+        ulp = mpfr_get_d(rest, MPFR_RNDU) * ldexp((double)k, 1 - (int)prec);
+        md_inverse_factorials.error[k] =
+            md_split(rest, MD_MAX_TERMS, md_inverse_factorials.term[k]) + ulp;
+    }
+    mpfr_clears(rest, factorial, (mpfr_ptr)0);
+}
+
+// Drop a value to double-double, moving its lower terms into the error
+static void md_narrow(MdValue *x)
+{
+    for (int i = 2; i < MD_MAX_TERMS; i++)
+    {
+        x->error += fabs(x->term[i]);
+        x->term[i] = 0.0;
+    }
+}
+
+// Evaluate the polynomial sum of c_j x^j for j < count by Horner's rule,
+// where c_j is the table entry first + j step, negated for odd j when
+// alternate is set; the coefficients are all at most 1. With quad-double,
+// the steps that reach the result scaled by x^j < 2^-102 only need
+// double-double accuracy.
+static void md_series(const MdState *st, const MdValue *x, const MdTable *table, int first,
+                      int step, int count, int alternate, MdValue *out)
+{
+    pthread_once(&md_tables_once, md_tables_init);
+
+    MdState narrow = *st;
+    MdValue narrow_x = *x;
+    int wide_steps = count;
+    if (st->terms > 2)
+    {
+        narrow.terms = 2;
+        narrow.epsilon = MD_DD_EPSILON;
+        md_narrow(&narrow_x);
+        double rho = md_magnitude(x) + x->error;
+        double weight = 1.0;
+        for (wide_steps = 0; wide_steps < count && weight >= 0x1p-102; wide_steps++)
+        {
+            weight *= rho;
+        }
+    }
+
+    MdValue sum = {{0.0}, 0.0};
+    for (int j = count - 1; j >= 0; j--)
+    {
+        const MdState *at = j < wide_steps ? st : &narrow;
+        int k = first + j * step;
+        int negate = alternate && (j % 2);
+        MdValue coefficient = {{0.0}, table->error[k]};
+        for (int i = 0; i < MD_MAX_TERMS; i++)
+        {
+            if (i < at->terms)
+                coefficient.term[i] = negate ? -table->term[k][i] : table->term[k][i];
+            else
+                coefficient.error += fabs(table->term[k][i]);
+        }
+        if (j == count - 1)
+        {
+            sum = coefficient;
+        }
+        else
+        {
+            md_mul(at, &sum, at == st ? x : &narrow_x, &sum);
+            md_add(at, &sum, &coefficient, &sum);
+        }
+    }
+    *out = sum;
+}
+
+static int md_sqrt(const MdState *st, const MdValue *a, MdValue *out)
+{
+    double a0 = a->term[0];
+    if (!(a0 > 0.0) || a->error > a0 / 2)
+    {
+        return 0;
+    }
+
+    MdValue root = {{0.0}, 0.0};
+    md_raw_sqrt(st, a->term, root.term);
+    if (!(root.term[0] > 0.0))
+    {
+        return 0;
+    }
+
+    // |sqrt(a) - s| = |a - s^2| / (sqrt(a) + s) <= |a - s^2| / s, with the
+    // residual itself computed with error bounds
+    MdValue exact = *a, square, residual;
+    exact.error = 0.0;
+    md_mul(st, &root, &root, &square);
+    md_sub(st, &exact, &square, &residual);
+    double s_low = root.term[0] * (1 - MD_SLACK);
+    root.error = (fabs(residual.term[0]) * (1 + MD_SLACK) + residual.error) / s_low +
+                 a->error / (sqrt(a0) * (1 - MD_SLACK));
+    *out = root;
+    return 1;
+}
+
+// Read a constant's leading terms; the rest goes into the error
+static int md_constant(const MdState *st, const char *name, MdValue *out)
+{
+    double terms[CONSTANT_DOUBLE_TERMS];
+    double error;
+    memset(out, 0, sizeof(*out));
+    if (!constants_get_double_terms(name, terms, &error))
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < CONSTANT_DOUBLE_TERMS; i++)
+    {
+        if (i < st->terms)
+            out->term[i] = terms[i];
+        else
+            error += fabs(terms[i]);
+    }
+    out->error = error;
+    return 1;
+}
+
+// Split a parsed literal into doubles
+static int md_literal(const MdState *st, mpfr_srcptr value, MdValue *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (mpfr_zero_p(value))
+    {
+        out->term[0] = mpfr_get_d(value, MPFR_RNDN);
+        return 1;
+    }
+    if (!mpfr_regular_p(value) || mpfr_get_exp(value) > 500 || mpfr_get_exp(value) < -498)
+    {
+        return 0;
+    }
+
+    mpfr_prec_t precision = mpfr_get_prec(value);
+    if (precision <= DBL_MANT_DIG)
+    {
+        out->term[0] = mpfr_get_d(value, MPFR_RNDN);
+        return 1;
+    }
+
+#if MD_DIRECT_LIMBS
+    // Cut the significand into 53-bit pieces, which are exact doubles; what
+    // is left over is below the last piece's ulp
+    const mp_limb_t *limbs = mpfr_custom_get_significand(value);
+    int count = (int)MD_LIMBS(precision);
+    int exponent = (int)mpfr_get_exp(value);
+    double sign = mpfr_signbit(value) ? -1.0 : 1.0;
+    double pieces[MD_MAX_TERMS + 1] = {0.0};
+    for (int i = 0; i < st->terms; i++)
+    {
+        int start = i * DBL_MANT_DIG;
+        int limb = count - 1 - start / 64;
+        int shift = start % 64;
+        if (limb < 0)
+        {
+            break;
+        }
+        uint64_t word = limbs[limb] << shift;
+        if (shift != 0 && limb > 0)
+        {
+            word |= limbs[limb - 1] >> (64 - shift);
+        }
+        pieces[i] = sign * ldexp((double)(word >> (64 - DBL_MANT_DIG)), exponent - start - DBL_MANT_DIG);
+    }
+    if (precision > st->terms * DBL_MANT_DIG)
+    {
+        out->error = ldexp(1.0, exponent - st->terms * DBL_MANT_DIG);
+    }
+
+    // Renormalizing pieces this far apart is exact
+    if (st->terms == 2)
+        out->term[0] = quick_two_sum(pieces[0], pieces[1], &out->term[1]);
+    else
+        qd_renorm(pieces, out->term);
+#else
+    if (precision > MD_LITERAL_BITS)
+    {
+        return 0;
+    }
+    mp_limb_t limbs[MD_LIMBS(MD_LITERAL_BITS)];
+    mpfr_t rest;
+    mpfr_custom_init(limbs, precision);
+    mpfr_custom_init_set(rest, MPFR_ZERO_KIND, 0, precision, limbs);
+    mpfr_set(rest, value, MPFR_RNDN);
+    out->error = md_split(rest, st->terms, out->term);
+#endif
+    return 1;
+}
+
+// Elementary functions. Each one reduces its argument, sums a Taylor series
+// with the operations above and adds a bound on the truncated rest; the
+// reductions are identities, so their accuracy only affects how tight the
+// final bound is.
+
+// Split e^x into 2^k (1 + s)
+static int md_exp_parts(const MdState *st, const MdValue *x, MdValue *s, int *k)
+{
+    if (!(fabs(x->term[0]) <= 350.0))
+    {
+        return 0;
+    }
+
+    MdValue ln2, r;
+    md_constant(st, "ln2", &ln2);
+    double kd = nearbyint(x->term[0] / ln2.term[0]);
+    md_mul_d(st, &ln2, -kd, &r);
+    md_add(st, x, &r, &r);
+    md_scale(&r, -MD_EXP_HALVINGS);
+
+    // e^r - 1 = r (1 + r/2! + r^2/3! + ...)
+    double rho = md_magnitude(&r) + r.error;
+    double tail = rho; // Bounds the last term included
+    int count = 1;
+    while (tail > st->epsilon * rho * 0x1p-10 && count < MD_SERIES_TERMS)
+    {
+        count++;
+        tail *= rho / count;
+    }
+    md_series(st, &r, &md_inverse_factorials, 1, 1, count, 0, s);
+    md_mul(st, s, &r, s);
+    s->error += 2 * tail * rho / (count + 1);
+
+    // e^(2a) - 1 = 2 (e^a - 1) + (e^a - 1)^2
+    for (int j = 0; j < MD_EXP_HALVINGS; j++)
+    {
+        MdValue square;
+        md_mul(st, s, s, &square);
+        md_scale(s, 1);
+        md_add(st, s, &square, s);
+    }
+
+    *k = (int)kd;
+    return 1;
+}
+
+static int md_exp(const MdState *st, const MdValue *x, MdValue *out)
+{
+    MdValue s, one;
+    int k;
+    if (!md_exp_parts(st, x, &s, &k))
+    {
+        return 0;
+    }
+    md_from_double(1.0, &one);
+    md_add(st, &one, &s, out);
+    md_scale(out, k);
+    return 1;
+}
+
+static int md_expm1(const MdState *st, const MdValue *x, MdValue *out)
+{
+    MdValue s, one;
+    int k;
+    if (!md_exp_parts(st, x, &s, &k))
+    {
+        return 0;
+    }
+    if (k == 0)
+    {
+        // Keeps its relative accuracy near zero
+        *out = s;
+        return 1;
+    }
+    md_from_double(1.0, &one);
+    md_add(st, &one, &s, out);
+    md_scale(out, k);
+    md_neg(&one, &one);
+    md_add(st, out, &one, out);
+    return 1;
+}
+
+// y + log(1 + d) for an exact double y and a small d
+static int md_log_correct(const MdState *st, double y, const MdValue *d, MdValue *out)
+{
+    double rho = md_magnitude(d) + d->error;
+    if (!(rho < 0x1p-20))
+    {
+        return 0;
+    }
+
+    // log(1 + d) = d (1 - d/2 + d^2/3 - ...)
+    MdValue sum, start;
+    double tail = rho; // rho^count bounds the last term included
+    int count = 1;
+    while (tail > st->epsilon * rho * 0x1p-10 && count < MD_SERIES_TERMS)
+    {
+        count++;
+        tail *= rho;
+    }
+    md_series(st, d, &md_reciprocals, 1, 1, count, 1, &sum);
+    md_mul(st, &sum, d, &sum);
+    // Alternating, so the rest is below the next term
+    sum.error += 2 * tail * rho;
+
+    md_from_double(y, &start);
+    md_add(st, &start, &sum, out);
+    return 1;
+}
+
+static int md_log(const MdState *st, const MdValue *x, MdValue *out)
+{
+    if (!(x->term[0] > 0.0))
+    {
+        return 0;
+    }
+
+    // log(x) = y + log(x e^-y) for y = log(x) in double precision
+    double y = log(x->term[0]);
+    MdValue scale, d, minus_one;
+    md_from_double(-y, &scale);
+    if (!md_exp(st, &scale, &scale))
+    {
+        return 0;
+    }
+    md_mul(st, x, &scale, &d);
+    md_from_double(-1.0, &minus_one);
+    md_add(st, &d, &minus_one, &d);
+    return md_log_correct(st, y, &d, out);
+}
+
+static int md_log1p(const MdState *st, const MdValue *u, MdValue *out)
+{
+    if (!(fabs(u->term[0]) <= 0.5))
+    {
+        MdValue one;
+        md_from_double(1.0, &one);
+        md_add(st, &one, u, out);
+        return md_log(st, out, out);
+    }
+
+    // (1 + u) e^-y - 1 = u + m + u m with m = e^-y - 1
+    double y = log1p(u->term[0]);
+    MdValue m, product, d;
+    md_from_double(-y, &m);
+    if (!md_expm1(st, &m, &m))
+    {
+        return 0;
+    }
+    md_mul(st, u, &m, &product);
+    md_add(st, u, &m, &d);
+    md_add(st, &d, &product, &d);
+    return md_log_correct(st, y, &d, out);
+}
+
+static int md_sincos(const MdState *st, const MdValue *x, MdValue *sin_out, MdValue *cos_out)
+{
+    if (!(fabs(x->term[0]) <= 0x1p20))
+    {
+        return 0;
+    }
+
+    // x = k pi/2 + r
+    MdValue half_pi, r;
+    md_constant(st, "pi", &half_pi);
+    md_scale(&half_pi, -1);
+    double kd = nearbyint(x->term[0] / half_pi.term[0]);
+    md_mul_d(st, &half_pi, -kd, &r);
+    md_add(st, x, &r, &r);
+    md_scale(&r, -MD_SINCOS_HALVINGS);
+
+    // sin(a) = a (1 - a^2/3! + a^4/5! - ...)
+    MdValue square, s;
+    md_mul(st, &r, &r, &square);
+    double rho = md_magnitude(&r) + r.error;
+    double tail = rho; // Bounds the last term included
+    int i = 1;
+    while (tail > st->epsilon * rho * 0x1p-10 && i < MD_SERIES_TERMS)
+    {
+        tail *= rho * rho / ((double)(i + 1) * (i + 2));
+        i += 2;
+    }
+    md_series(st, &square, &md_inverse_factorials, 1, 2, (i + 1) / 2, 1, &s);
+    md_mul(st, &s, &r, &s);
+    // Alternating, so the rest is below the next term
+    s.error += 2 * tail * rho * rho / ((double)(i + 1) * (i + 2));
+
+    // cos(a) - 1 = -a^2 (1/2! - a^2/4! + a^4/6! - ...), with the same
+    // number of terms
+    MdValue one, sin_square, c, cm1;
+    md_series(st, &square, &md_inverse_factorials, 2, 2, (i + 1) / 2, 1, &cm1);
+    md_mul(st, &cm1, &square, &cm1);
+    md_neg(&cm1, &cm1);
+    cm1.error += 2 * tail * rho * rho / ((double)(i + 1) * (i + 2));
+    md_from_double(1.0, &one);
+
+    // Undo the halvings: sin(2a) = 2 sin(a) cos(a), cos(2a) - 1 = -2 sin(a)^2
+    for (int j = 0; j < MD_SINCOS_HALVINGS; j++)
+    {
+        md_mul(st, &s, &s, &sin_square);
+        md_add(st, &one, &cm1, &c);
+        md_mul(st, &s, &c, &s);
+        md_scale(&s, 1);
+        md_scale(&sin_square, 1);
+        md_neg(&sin_square, &cm1);
+    }
+    md_add(st, &one, &cm1, &c);
+
+    switch ((((long)kd % 4) + 4) % 4)
+    {
+    case 0:
+        *sin_out = s;
+        *cos_out = c;
+        break;
+    case 1:
+        *sin_out = c;
+        md_neg(&s, cos_out);
+        break;
+    case 2:
+        md_neg(&s, sin_out);
+        md_neg(&c, cos_out);
+        break;
+    default:
+        md_neg(&c, sin_out);
+        *cos_out = s;
+        break;
+    }
+    return 1;
+}
+
+static int md_atan(const MdState *st, const MdValue *x, MdValue *out)
+{
+    // atan(x) = y + atan(d) for y = atan(x) in double precision and
+    // d = tan(atan(x) - y) = (x cos(y) - sin(y)) / (cos(y) + x sin(y))
+    double y = atan(x->term[0]);
+    MdValue start, s, c, numerator, denominator, d;
+    md_from_double(y, &start);
+    if (!md_sincos(st, &start, &s, &c))
+    {
+        return 0;
+    }
+    md_mul(st, x, &c, &numerator);
+    md_sub(st, &numerator, &s, &numerator);
+    md_mul(st, x, &s, &denominator);
+    md_add(st, &c, &denominator, &denominator);
+    if (!md_div(st, &numerator, &denominator, &d))
+    {
+        return 0;
+    }
+
+    double rho = md_magnitude(&d) + d.error;
+    if (!(rho < 0x1p-20))
+    {
+        return 0;
+    }
+
+    // atan(d) = d (1 - d^2/3 + d^4/5 - ...)
+    MdValue square, sum;
+    md_mul(st, &d, &d, &square);
+    double tail = rho; // Bounds the last term included
+    int k = 1;
+    while (tail > st->epsilon * rho * 0x1p-10 && k < MD_SERIES_TERMS)
+    {
+        k += 2;
+        tail *= rho * rho;
+    }
+    md_series(st, &square, &md_reciprocals, 1, 2, (k + 1) / 2, 1, &sum);
+    md_mul(st, &sum, &d, &sum);
+    // Alternating, so the rest is below the next term
+    sum.error += 2 * tail * rho * rho;
+
+    md_add(st, &start, &sum, out);
+    return 1;
+}
+
+static int md_asin(const MdState *st, const MdValue *x, MdValue *out)
+{
+    if (!(fabs(x->term[0]) < 1.0))
+    {
+        return 0;
+    }
+
+    // asin(x) = atan(x / sqrt((1 - x)(1 + x)))
+    MdValue one, below, above, root;
+    md_from_double(1.0, &one);
+    md_sub(st, &one, x, &below);
+    md_add(st, &one, x, &above);
+    md_mul(st, &below, &above, &root);
+    if (!md_sqrt(st, &root, &root) || !md_div(st, x, &root, out))
+    {
+        return 0;
+    }
+    return md_atan(st, out, out);
+}
+
+static int md_pow(const MdState *st, const MdValue *x, const MdValue *y, MdValue *out)
+{
+    double n = y->term[0];
+    if (md_single(y) && n == nearbyint(n) && fabs(n) <= 1024.0)
+    {
+        // Small integer exponents by repeated squaring, for any sign of x
+        if (n == 0.0 || x->term[0] == 0.0)
+        {
+            return 0;
+        }
+        MdValue base = *x, power;
+        md_from_double(1.0, &power);
+        for (long bits = (long)fabs(n); bits; bits >>= 1)
+        {
+            if (bits & 1)
+            {
+                md_mul(st, &power, &base, &power);
+            }
+            if (bits > 1)
+            {
+                md_mul(st, &base, &base, &base);
+                if (!md_usable(&base))
+                {
+                    return 0;
+                }
+            }
+        }
+        if (n < 0)
+        {
+            MdValue one;
+            md_from_double(1.0, &one);
+            return md_div(st, &one, &power, out);
+        }
+        *out = power;
+        return 1;
+    }
+
+    // x^y = e^(y log x); negative bases need an exact integer exponent
+    MdValue logarithm;
+    if (!md_log(st, x, &logarithm))
+    {
+        return 0;
+    }
+    md_mul(st, y, &logarithm, &logarithm);
+    return md_usable(&logarithm) && md_exp(st, &logarithm, out);
+}
+
+static int md_floor(const MdState *st, const MdValue *x, MdValue *out)
+{
+    // Integral leading terms are kept and the first fractional one is
+    // floored; beyond 2^53 in magnitude that takes more than two doubles
+    int j = 0;
+    while (j < st->terms && x->term[j] == floor(x->term[j]))
+    {
+        j++;
+    }
+    if (j >= 2 && j < st->terms)
+    {
+        return 0;
+    }
+
+    MdValue r = {{0.0}, 0.0};
+    double fraction = 0.0;
+    if (j == 0)
+    {
+        r.term[0] = floor(x->term[0]);
+        fraction = (x->term[0] - r.term[0]) + x->term[1];
+    }
+    else if (j == 1)
+    {
+        double below = floor(x->term[1]);
+        r.term[0] = two_sum(x->term[0], below, &r.term[1]);
+        fraction = (x->term[1] - below) + (st->terms > 2 ? x->term[2] : 0.0);
+    }
+    else
+    {
+        r = *x;
+    }
+
+    // Exact unless an integer lies within the error interval
+    if (x->error != 0.0 && !(fraction - 0x1p-40 > 2 * x->error &&
+                             1.0 - fraction - 0x1p-40 > 2 * x->error))
+    {
+        return 0;
+    }
+    r.error = 0.0;
+    *out = r;
+    return 1;
+}
+
+// Arguments outside a function's domain are left to MPFR, which reports them
+static int md_call(const MdState *st, TokenType func_type, const MdValue *x, MdValue *out)
+{
+    MdValue one, a, b;
+    md_from_double(1.0, &one);
+
+    switch (func_type)
+    {
+    case TOKEN_SIN:
+        return md_sincos(st, x, out, &a);
+    case TOKEN_COS:
+        return md_sincos(st, x, &a, out);
+    case TOKEN_TAN:
+        return md_sincos(st, x, &a, &b) && md_div(st, &a, &b, out);
+    case TOKEN_ASIN:
+        return md_asin(st, x, out);
+    case TOKEN_ACOS:
+        // acos(x) = pi/2 - asin(x)
+        if (!md_asin(st, x, &a))
+            return 0;
+        md_constant(st, "pi", &b);
+        md_scale(&b, -1);
+        md_sub(st, &b, &a, out);
+        return 1;
+    case TOKEN_ATAN:
+        return md_atan(st, x, out);
+    case TOKEN_SINH:
+        // sinh(x) = m (m + 2) / (2 (m + 1)) with m = e^x - 1
+        if (!md_expm1(st, x, &a))
+            return 0;
+        md_from_double(2.0, &b);
+        md_add(st, &a, &b, &b);
+        md_mul(st, &a, &b, &b);
+        md_add(st, &a, &one, &a);
+        md_scale(&a, 1);
+        return md_div(st, &b, &a, out);
+    case TOKEN_COSH:
+        if (!md_exp(st, x, &a) || !md_div(st, &one, &a, &b))
+            return 0;
+        md_add(st, &a, &b, out);
+        md_scale(out, -1);
+        return 1;
+    case TOKEN_TANH:
+        // tanh(x) = m / (m + 2) with m = e^(2x) - 1
+        a = *x;
+        md_scale(&a, 1);
+        if (!md_expm1(st, &a, &a))
+            return 0;
+        md_from_double(2.0, &b);
+        md_add(st, &a, &b, &b);
+        return md_div(st, &a, &b, out);
+    case TOKEN_ASINH:
+        // asinh(|x|) = log1p(|x| + x^2 / (1 + sqrt(1 + x^2)))
+        a = *x;
+        if (a.term[0] < 0)
+            md_neg(&a, &a);
+        md_mul(st, &a, &a, &b);
+        md_add(st, &one, &b, out);
+        if (!md_sqrt(st, out, out))
+            return 0;
+        md_add(st, &one, out, out);
+        if (!md_div(st, &b, out, &b))
+            return 0;
+        md_add(st, &a, &b, &a);
+        if (!md_log1p(st, &a, out))
+            return 0;
+        if (x->term[0] < 0)
+            md_neg(out, out);
+        return 1;
+    case TOKEN_ACOSH:
+        // acosh(x) = log1p((x - 1) + sqrt((x - 1)(x + 1)))
+        if (!(x->term[0] > 1.0))
+            return 0;
+        md_sub(st, x, &one, &a);
+        md_add(st, x, &one, &b);
+        md_mul(st, &a, &b, &b);
+        if (!md_sqrt(st, &b, &b))
+            return 0;
+        md_add(st, &a, &b, &a);
+        return md_log1p(st, &a, out);
+    case TOKEN_ATANH:
+        // atanh(x) = log1p(2x / (1 - x)) / 2
+        if (!(fabs(x->term[0]) < 1.0))
+            return 0;
+        md_sub(st, &one, x, &b);
+        a = *x;
+        md_scale(&a, 1);
+        if (!md_div(st, &a, &b, &a) || !md_log1p(st, &a, out))
+            return 0;
+        md_scale(out, -1);
+        return 1;
+    case TOKEN_SQRT:
+        return md_sqrt(st, x, out);
+    case TOKEN_LOG:
+        return md_log(st, x, out);
+    case TOKEN_LOG10:
+        if (!md_log(st, x, &a))
+            return 0;
+        md_constant(st, "ln10", &b);
+        return md_div(st, &a, &b, out);
+    case TOKEN_EXP:
+        return md_exp(st, x, out);
+    case TOKEN_ABS:
+        if (x->term[0] < 0)
+            md_neg(x, out);
+        else
+            *out = *x;
+        return 1;
+    case TOKEN_FLOOR:
+        return md_floor(st, x, out);
+    case TOKEN_CEIL:
+        // ceil(x) = -floor(-x)
+        md_neg(x, &a);
+        if (!md_floor(st, &a, out))
+            return 0;
+        md_neg(out, out);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int md_atan2(const MdState *st, const MdValue *y, const MdValue *x, MdValue *out)
+{
+    // atan(y / x), moved by pi across the negative x axis, which needs y
+    // clearly away from the branch cut
+    double x_low = fabs(x->term[0]) * (1 - MD_SLACK) - x->error;
+    double y_low = fabs(y->term[0]) * (1 - MD_SLACK) - y->error;
+    if (!(x_low > 0.0) || (x->term[0] < 0 && !(y_low > 0.0)))
+    {
+        return 0;
+    }
+
+    MdValue q;
+    if (!md_div(st, y, x, &q) || !md_usable(&q) || !md_atan(st, &q, out))
+    {
+        return 0;
+    }
+    if (x->term[0] < 0)
+    {
+        MdValue pi;
+        md_constant(st, "pi", &pi);
+        if (y->term[0] < 0)
+            md_sub(st, out, &pi, out);
+        else
+            md_add(st, out, &pi, out);
+    }
+    return 1;
+}
+
+static int md_function(const MdState *st, const ASTNode *node, MdValue *out)
+{
+    TokenType func_type = node->function.func_type;
+    int binary = func_type == TOKEN_POW || func_type == TOKEN_ATAN2;
+    if (node->function.arg_count != (binary ? 2 : 1))
+    {
+        return 0;
+    }
+
+    MdValue x, y;
+    if (!md_node(st, node->function.args[0], &x) ||
+        (binary && !md_node(st, node->function.args[1], &y)))
+    {
+        return 0;
+    }
+
+    int ok;
+    if (func_type == TOKEN_POW)
+        ok = md_pow(st, &x, &y, out);
+    else if (func_type == TOKEN_ATAN2)
+        ok = md_atan2(st, &x, &y, out);
+    else
+        ok = md_call(st, func_type, &x, out);
+    if (!ok || !md_usable(out))
+    {
+        return 0;
+    }
+
+    // The MPFR path flushes tiny function results to zero; leave anything
+    // that could be flushed to it
+    double flush = ldexp(1.0, -(int)st->ctx->precision - 8);
+    return fabs(out->term[0]) * (1 - MD_SLACK) - out->error > flush;
+}
+
+// Exact sign of a - b, for exact operands
+static int md_exact_sign(const MdState *st, const MdValue *a, const MdValue *b)
+{
+    mp_limb_t limbs[2 * MD_MAX_TERMS][MD_LIMBS(DBL_MANT_DIG)];
+    mp_limb_t sign_limbs[MD_LIMBS(2)];
+    mpfr_t parts[2 * MD_MAX_TERMS], sign;
+    mpfr_ptr pointers[2 * MD_MAX_TERMS];
+
+    for (int i = 0; i < 2 * st->terms; i++)
+    {
+        md_set_double(parts[i], limbs[i], i < st->terms ? a->term[i] : -b->term[i - st->terms]);
+        pointers[i] = parts[i];
+    }
+    mpfr_custom_init(sign_limbs, 2);
+    mpfr_custom_init_set(sign, MPFR_ZERO_KIND, 0, 2, sign_limbs);
+    mpfr_sum(sign, pointers, (unsigned long)(2 * st->terms), MPFR_RNDN);
+    return mpfr_sgn(sign);
+}
+
+static int md_binop(const MdState *st, const ASTNode *node, MdValue *out)
+{
+    MdValue a, b;
+    if (!md_node(st, node->binop.left, &a) || !md_node(st, node->binop.right, &b))
+    {
+        return 0;
+    }
+
+    switch (node->binop.op)
+    {
+    case TOKEN_PLUS:
+        md_add(st, &a, &b, out);
+        break;
+    case TOKEN_MINUS:
+        md_sub(st, &a, &b, out);
+        break;
+    case TOKEN_STAR:
+        md_mul(st, &a, &b, out);
+        break;
+    case TOKEN_SLASH:
+        // Division by zero, or a divisor that may be zero, is left to MPFR
+        if (!md_div(st, &a, &b, out))
+            return 0;
+        break;
+    case TOKEN_CARET:
+        if (!md_pow(st, &a, &b, out))
+            return 0;
+        break;
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+    case TOKEN_LT:
+    case TOKEN_LTE:
+    case TOKEN_GT:
+    case TOKEN_GTE:
+    {
+        // Decided when the operands are clearly apart or both exact
+        MdValue diff;
+        md_sub(st, &a, &b, &diff);
+        int sign;
+        if (fabs(diff.term[0]) * (1 - MD_SLACK) > 2 * diff.error)
+            sign = diff.term[0] > 0 ? 1 : -1;
+        else if (a.error == 0.0 && b.error == 0.0)
+            sign = md_exact_sign(st, &a, &b);
+        else
+            return 0;
+
+        int truth;
+        switch (node->binop.op)
+        {
+        case TOKEN_EQ:
+            truth = sign == 0;
+            break;
+        case TOKEN_NEQ:
+            truth = sign != 0;
+            break;
+        case TOKEN_LT:
+            truth = sign < 0;
+            break;
+        case TOKEN_LTE:
+            truth = sign <= 0;
+            break;
+        case TOKEN_GT:
+            truth = sign > 0;
+            break;
+        default:
+            truth = sign >= 0;
+            break;
+        }
+        md_from_double(truth ? 1.0 : 0.0, out);
+        break;
+    }
+    default:
+        return 0;
+    }
+
+    return md_usable(out);
+}
+
+// Sums and products accumulate from the left; md_add() and md_mul() may
+// write over an operand
+static int md_nary(const MdState *st, const ASTNode *node, MdValue *out)
+{
+    if (!md_node(st, node->nary.operands[0], out))
+    {
+        return 0;
+    }
+    for (int i = 1; i < node->nary.count; i++)
+    {
+        MdValue b;
+        if (!md_node(st, node->nary.operands[i], &b))
+        {
+            return 0;
+        }
+        if (node->nary.op == TOKEN_PLUS)
+            md_add(st, out, &b, out);
+        else
+            md_mul(st, out, &b, out);
+        if (!md_usable(out))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int md_node(const MdState *st, const ASTNode *node, MdValue *out)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (node->number.literal->folded_from &&
+            node->number.literal->folded_precision != st->ctx->precision)
+        {
+            // Folded for another precision: use the original subtree
+            return md_node(st, node->number.literal->folded_from, out);
+        }
+        return md_literal(st, node->number.literal->value, out);
+
+    case NODE_CONSTANT:
+        return md_constant(st, node->constant.name, out);
+
+    case NODE_BINOP:
+        return md_binop(st, node, out);
+
+    case NODE_NARY:
+        return md_nary(st, node, out);
+
+    case NODE_UNARY:
+        if (!md_node(st, node->unary.operand, out))
+        {
+            return 0;
+        }
+        if (node->unary.op == TOKEN_MINUS)
+        {
+            md_neg(out, out);
+        }
+        return node->unary.op == TOKEN_MINUS || node->unary.op == TOKEN_PLUS;
+
+    case NODE_FUNCTION:
+        return md_function(st, node, out);
+
+    default:
+        return 0;
+    }
+}
+
+// Check that no rounding boundary at the given precision lies within
+// distance of a value. The boundaries are the multiples of an ulp of the
+// value's binade, offset by half an ulp when rounding to nearest.
+static int md_clear_of_boundaries(const MdState *st, const MdValue *x, mpfr_prec_t precision,
+                                  double distance)
+{
+    // When term[0] is a power of two the value may lie in the binade below;
+    // its grid is finer, and the coarser one's boundaries are further away
+    int exponent = ilogb(x->term[0]);
+    double mantissa = fabs(ldexp(x->term[0], -exponent));
+    int shift = exponent + 1 - (int)precision - (mantissa == 1.0 ? 1 : 0);
+    double ulp = ldexp(1.0, shift);
+    double inverse = ldexp(1.0, -shift);
+
+    // Remainders modulo a power of two are exact; only their sum rounds.
+    // Scaling by the ulp's inverse stays in range, as it is about 2^p.
+    double remainder = st->ctx->rounding == MPFR_RNDN ? -ulp / 2 : 0.0;
+    for (int i = 0; i < st->terms; i++)
+    {
+        remainder += x->term[i] - floor(x->term[i] * inverse) * ulp;
+    }
+    remainder -= floor(remainder * inverse) * ulp;
+    double clearance = fmin(remainder, ulp - remainder) - ulp * 0x1p-48;
+    return clearance > distance;
+}
+
+// Round the sum of a value's terms to a variable's precision
+static void md_round(const MdState *st, const MdValue *x, mpfr_t rop)
+{
+    mp_limb_t limbs[MD_MAX_TERMS][MD_LIMBS(DBL_MANT_DIG)];
+    mpfr_t parts[MD_MAX_TERMS];
+    mpfr_ptr pointers[MD_MAX_TERMS];
+    for (int i = 0; i < st->terms; i++)
+    {
+        md_set_double(parts[i], limbs[i], x->term[i]);
+        pointers[i] = parts[i];
+    }
+    mpfr_sum(rop, pointers, (unsigned long)st->terms, st->ctx->rounding);
+}
+
+int multidouble_terms(const EvalContext *ctx, mpfr_srcptr result)
+{
+    mpfr_prec_t precision = mpfr_get_prec(result);
+    if (ctx->precision > precision)
+    {
+        precision = ctx->precision;
+    }
+
+    if (precision <= MULTIDOUBLE_DD_MAX_PRECISION)
+        return 2;
+    if (precision <= MULTIDOUBLE_QD_MAX_PRECISION)
+        return 4;
+    return 0;
+}
+
+// Walk a tree for calls the expansions speed up
+static int md_pays_off(const MdState *st, const ASTNode *node)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        return node->number.literal->folded_from &&
+               node->number.literal->folded_precision != st->ctx->precision &&
+               md_pays_off(st, node->number.literal->folded_from);
+
+    case NODE_BINOP:
+        if (node->binop.op == TOKEN_CARET && st->terms == 2)
+        {
+            return 1;
+        }
+        return md_pays_off(st, node->binop.left) || md_pays_off(st, node->binop.right);
+
+    case NODE_UNARY:
+        return md_pays_off(st, node->unary.operand);
+
+    case NODE_NARY:
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            if (md_pays_off(st, node->nary.operands[i]))
+            {
+                return 1;
+            }
+        }
+        return 0;
+
+    case NODE_FUNCTION:
+        switch (node->function.func_type)
+        {
+        case TOKEN_SQRT:
+        case TOKEN_ABS:
+        case TOKEN_FLOOR:
+        case TOKEN_CEIL:
+            break;
+        case TOKEN_SIN:
+        case TOKEN_COS:
+        case TOKEN_TAN:
+        case TOKEN_POW:
+            if (st->terms == 2)
+            {
+                return 1;
+            }
+            break;
+        default:
+            return 1;
+        }
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            if (md_pays_off(st, node->function.args[i]))
+            {
+                return 1;
+            }
+        }
+        return 0;
+
+    default:
+        return 0;
+    }
+}
+
+int multidouble_pays_off(const EvalContext *ctx, mpfr_srcptr result, const ASTNode *node)
+{
+    MdState st;
+    st.ctx = ctx;
+    st.terms = multidouble_terms(ctx, result);
+    st.epsilon = 0.0;
+    return st.terms && md_pays_off(&st, node);
+}
+
+int multidouble_eval(const EvalContext *ctx, mpfr_t result, const ASTNode *node)
+{
+    MdState st;
+    st.ctx = ctx;
+    st.terms = multidouble_terms(ctx, result);
+    if (!st.terms)
+    {
+        return 0;
+    }
+    st.epsilon = st.terms == 2 ? MD_DD_EPSILON : MD_QD_EPSILON;
+
+    MdValue value;
+    if (!md_node(&st, node, &value) || value.term[0] == 0.0)
+    {
+        // Zeros are left to MPFR, which knows their sign
+        return 0;
+    }
+
+    // Accept when the (doubled) error interval holds no rounding boundary,
+    // so that every value in it rounds alike
+    if (value.error != 0.0 &&
+        !md_clear_of_boundaries(&st, &value, mpfr_get_prec(result), 2 * value.error))
+    {
+        return 0;
+    }
+    md_round(&st, &value, result);
+    return 1;
+}
@@ -0,0 +1,59 @@
+#ifndef MULTIDOUBLE_H
+#define MULTIDOUBLE_H
+
+#include "ast.h"
+#include <float.h>
+#include <mpfr.h>
+
+typedef struct EvalContext EvalContext;
+
+// Bits kept between a backend's own accuracy and the precisions it serves,
+// so that its error check usually succeeds
+#define MULTIDOUBLE_GUARD_BITS 12
+
+// Largest precisions served with double-double and quad-double arithmetic
+#define MULTIDOUBLE_DD_MAX_PRECISION (2 * DBL_MANT_DIG - MULTIDOUBLE_GUARD_BITS)
+#define MULTIDOUBLE_QD_MAX_PRECISION (4 * DBL_MANT_DIG - MULTIDOUBLE_GUARD_BITS)
+
+/**
+ * Get the number of doubles an evaluation would be carried out with
+ * @param ctx Context the tree would be evaluated in
+ * @param result Output variable the result would be stored in
+ * @return 2 (double-double), 4 (quad-double), or 0 if the context or result
+ *         precision is above MULTIDOUBLE_QD_MAX_PRECISION
+ */
+int multidouble_terms(const EvalContext *ctx, mpfr_srcptr result);
+
+/**
+ * Check whether a tree is worth trying with multidouble_eval()
+ *
+ * MPFR's own arithmetic is about as fast as the expansions' at these
+ * precisions once conversions are counted, so only trees calling elementary
+ * functions gain; with quad-double, sines, cosines and general powers do
+ * not either.
+ *
+ * @param ctx Context the tree would be evaluated in
+ * @param result Output variable the result would be stored in
+ * @param node AST node to check
+ * @return 1 if the tree calls a function the backend evaluates faster
+ */
+int multidouble_pays_off(const EvalContext *ctx, mpfr_srcptr result, const ASTNode *node);
+
+/**
+ * Evaluate an AST with double-double or quad-double arithmetic
+ *
+ * Values are unevaluated sums of 2 or 4 doubles, and every node keeps a
+ * bound on its absolute error, as in native_eval(). The result is stored
+ * only when the whole error interval rounds to the same value at the
+ * result's precision in the context's rounding mode; errors, domain
+ * failures, tiny function results the MPFR path flushes to zero and values
+ * outside about 2^±500 make the backend decline.
+ *
+ * @param ctx Context supplying precision and rounding mode (not modified)
+ * @param result Output variable, untouched when the backend declines
+ * @param node AST node to evaluate
+ * @return 1 if result holds the trusted value, 0 to fall back to MPFR
+ */
+int multidouble_eval(const EvalContext *ctx, mpfr_t result, const ASTNode *node);
+
+#endif // MULTIDOUBLE_H
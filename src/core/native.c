@@ -0,0 +1,980 @@
+#include "native.h"
+#include "context.h"
+#include "constants.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A long double approximation and a bound on its absolute error
+typedef struct
+{
+    long double value;
+    long double error; // 0 when the value is exact
+} NativeValue;
+
+// Relative rounding error bound of one long double operation (2u, so the
+// bound also covers directed rounding should the FPU be in such a mode)
+#define NATIVE_EPSILON LDBL_EPSILON
+
+static int native_node(const EvalContext *ctx, const ASTNode *node, NativeValue *out);
+
+// Reject values the error model does not cover: infinities, NaN and
+// anything near the subnormal range
+static int native_usable(const NativeValue *x)
+{
+    if (!isfinite(x->value) || !isfinite(x->error))
+    {
+        return 0;
+    }
+    return x->value == 0.0L || fabsl(x->value) >= LDBL_MIN / LDBL_EPSILON;
+}
+
+// Error of an operation's rounding, if it rounded at all
+static long double native_rounding(long double value, int exact)
+{
+    return exact ? 0.0L : fabsl(value) * NATIVE_EPSILON;
+}
+
+// Veltkamp splitting constant, 2^ceil(p/2) + 1
+#define NATIVE_SPLIT ((long double)(1UL << ((LDBL_MANT_DIG + 1) / 2)) + 1.0L)
+
+// Check whether product == a * b exactly, using Dekker's product rather
+// than fmal(), which is emulated in software for long double
+static int native_product_exact(long double a, long double b, long double product)
+{
+    if (fabsl(a) > 0x1p16000L || fabsl(b) > 0x1p16000L)
+    {
+        return 0; // The split would overflow
+    }
+    long double t = NATIVE_SPLIT * a;
+    long double a_high = t - (t - a);
+    long double a_low = a - a_high;
+    t = NATIVE_SPLIT * b;
+    long double b_high = t - (t - b);
+    long double b_low = b - b_high;
+    return ((a_high * b_high - product) + a_high * b_low + a_low * b_high) + a_low * b_low == 0.0L;
+}
+
+// Round to a precision of at most LDBL_MANT_DIG bits in an MPFR rounding mode
+static long double native_round_to(long double x, mpfr_prec_t precision, mpfr_rnd_t rounding)
+{
+    if (x == 0.0L)
+    {
+        return x;
+    }
+
+    int exponent;
+    long double scaled = ldexpl(frexpl(x, &exponent), (int)precision);
+    switch (rounding)
+    {
+    case MPFR_RNDZ:
+        scaled = truncl(scaled);
+        break;
+    case MPFR_RNDU:
+        scaled = ceill(scaled);
+        break;
+    case MPFR_RNDD:
+        scaled = floorl(scaled);
+        break;
+    case MPFR_RNDA:
+        scaled = scaled < 0 ? floorl(scaled) : ceill(scaled);
+        break;
+    default:
+    {
+        // Ties to even, without nearbyintl()'s floating-point environment calls
+        long double below = floorl(scaled);
+        long double fraction = scaled - below;
+        if (fraction > 0.5L || (fraction == 0.5L && floorl(below / 2) != below / 2))
+            below += 1;
+        scaled = below;
+        break;
+    }
+    }
+    return ldexpl(scaled, exponent - (int)precision);
+}
+
+static int native_pow(const NativeValue *x, const NativeValue *y, NativeValue *out)
+{
+    out->value = powl(x->value, y->value);
+    if (!isfinite(out->value) || out->value == 0.0L)
+    {
+        return 0;
+    }
+    long double library = fabsl(out->value) * NATIVE_LIBM_ULPS * NATIVE_EPSILON;
+    if (x->error == 0.0L && y->error == 0.0L)
+    {
+        out->error = library;
+        return 1;
+    }
+
+    // |d(x^y)| <= |x^y| (|y| |dx| / |x| + |ln x| |dy|), with x kept within a
+    // factor of 2 and a negative base only for an exact integer exponent
+    if (x->value == 0.0L || x->error > fabsl(x->value) / 2)
+        return 0;
+    if (x->value < 0 && y->error != 0.0L)
+        return 0;
+    long double relative = (fabsl(y->value) + y->error) * x->error * 2 / fabsl(x->value) +
+                           (fabsl(logl(fabsl(x->value))) + 1) * y->error;
+    if (!(relative <= 0.25L))
+        return 0;
+    out->error = 2 * fabsl(out->value) * relative + library;
+    return 1;
+}
+
+// Decide a comparison, only when the operands are exact or clearly apart
+static int native_compare(TokenType op, const NativeValue *a, const NativeValue *b,
+                          NativeValue *out)
+{
+    long double gap = fabsl(a->value - b->value);
+    if ((a->error != 0.0L || b->error != 0.0L) &&
+        !(gap > 2 * (a->error + b->error) + gap * NATIVE_EPSILON))
+    {
+        return 0;
+    }
+    int truth;
+    switch (op)
+    {
+    case TOKEN_EQ:
+        truth = a->value == b->value;
+        break;
+    case TOKEN_NEQ:
+        truth = a->value != b->value;
+        break;
+    case TOKEN_LT:
+        truth = a->value < b->value;
+        break;
+    case TOKEN_LTE:
+        truth = a->value <= b->value;
+        break;
+    case TOKEN_GT:
+        truth = a->value > b->value;
+        break;
+    default:
+        truth = a->value >= b->value;
+        break;
+    }
+    out->value = truth ? 1.0L : 0.0L;
+    out->error = 0.0L;
+    return 1;
+}
+
+// a + b; out may be one of the operands
+static void native_add(NativeValue a, NativeValue b, NativeValue *out)
+{
+    long double r = a.value + b.value;
+    out->value = r;
+    if (a.error == 0.0L && b.error == 0.0L)
+    {
+        // Two-sum: the addition was exact iff its rounding error is zero
+        long double t = r - a.value;
+        t = (a.value - (r - t)) + (b.value - t);
+        out->error = native_rounding(r, t == 0.0L);
+    }
+    else
+    {
+        // Exactness only matters for exact operands
+        out->error = a.error + b.error + native_rounding(r, 0);
+    }
+}
+
+// a * b; out may be one of the operands
+static void native_mul(NativeValue a, NativeValue b, NativeValue *out)
+{
+    long double r = a.value * b.value;
+    out->value = r;
+    out->error = fabsl(b.value) * a.error + fabsl(a.value) * b.error + a.error * b.error +
+                 native_rounding(r, a.error == 0.0L && b.error == 0.0L &&
+                                        native_product_exact(a.value, b.value, r));
+}
+
+static int native_binop(const EvalContext *ctx, const ASTNode *node, NativeValue *out)
+{
+    NativeValue a, b;
+    if (!native_node(ctx, node->binop.left, &a) || !native_node(ctx, node->binop.right, &b))
+    {
+        return 0;
+    }
+
+    long double r;
+    switch (node->binop.op)
+    {
+    case TOKEN_PLUS:
+        native_add(a, b, out);
+        break;
+    case TOKEN_MINUS:
+        b.value = -b.value;
+        native_add(a, b, out);
+        break;
+    case TOKEN_STAR:
+        native_mul(a, b, out);
+        break;
+    case TOKEN_SLASH:
+        // Division by zero, or a divisor that may be zero, is left to MPFR
+        if (b.value == 0.0L || b.error > fabsl(b.value) / 2)
+            return 0;
+        r = a.value / b.value;
+        out->value = r;
+        out->error = (a.error + fabsl(r) * b.error) / (fabsl(b.value) - b.error) +
+                     native_rounding(r, a.error == 0.0L && b.error == 0.0L &&
+                                            r * b.value == a.value &&
+                                            native_product_exact(r, b.value, a.value));
+        break;
+    case TOKEN_CARET:
+        if (!native_pow(&a, &b, out))
+            return 0;
+        break;
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+    case TOKEN_LT:
+    case TOKEN_LTE:
+    case TOKEN_GT:
+    case TOKEN_GTE:
+        if (!native_compare(node->binop.op, &a, &b, out))
+            return 0;
+        break;
+    default:
+        return 0;
+    }
+
+    return native_usable(out);
+}
+
+// Sums and products accumulate from the left, each step checked as its
+// binary operation would be
+static int native_nary(const EvalContext *ctx, const ASTNode *node, NativeValue *out)
+{
+    if (!native_node(ctx, node->nary.operands[0], out))
+    {
+        return 0;
+    }
+    for (int i = 1; i < node->nary.count; i++)
+    {
+        NativeValue b;
+        if (!native_node(ctx, node->nary.operands[i], &b))
+        {
+            return 0;
+        }
+        if (node->nary.op == TOKEN_PLUS)
+            native_add(*out, b, out);
+        else
+            native_mul(*out, b, out);
+        if (!native_usable(out))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Propagate the argument error of a one-argument function through a bound
+// on |f'| over the error interval; 0 near singularities and discontinuities
+static int native_propagate(TokenType func_type, const NativeValue *x, long double r,
+                            long double *propagated)
+{
+    long double e = x->error;
+    long double v = x->value;
+    long double d;
+
+    switch (func_type)
+    {
+    case TOKEN_SIN:
+    case TOKEN_COS:
+    case TOKEN_ATAN:
+    case TOKEN_TANH:
+    case TOKEN_ASINH:
+    case TOKEN_ABS:
+        *propagated = e;
+        return 1;
+    case TOKEN_TAN:
+        *propagated = 2 * e * (1 + r * r);
+        return e * (1 + r * r) <= 0.01L;
+    case TOKEN_EXP:
+        *propagated = 2 * e * fabsl(r);
+        return e <= 0.25L;
+    case TOKEN_SINH:
+    case TOKEN_COSH:
+        *propagated = 4 * e * (fabsl(r) + 1);
+        return e <= 0.25L;
+    case TOKEN_SQRT:
+        *propagated = e / sqrtl(2 * v);
+        return v > 0 && e <= v / 2;
+    case TOKEN_LOG:
+    case TOKEN_LOG10:
+        *propagated = 2 * e / v;
+        return v > 0 && e <= v / 2;
+    case TOKEN_ASIN:
+    case TOKEN_ACOS:
+    case TOKEN_ACOSH:
+    case TOKEN_ATANH:
+        d = func_type == TOKEN_ACOSH ? v - 1 : 1 - fabsl(v);
+        *propagated = func_type == TOKEN_ATANH ? 2 * e / d : e * sqrtl(2 / d);
+        return d > 0 && e <= d / 4;
+    case TOKEN_FLOOR:
+    case TOKEN_CEIL:
+        // Exact unless an integer lies within the error interval
+        d = v - floorl(v);
+        *propagated = 0.0L;
+        return d > 2 * e && 1 - d > 2 * e;
+    default:
+        return 0;
+    }
+}
+
+static long double native_call(TokenType func_type, long double x)
+{
+    switch (func_type)
+    {
+    case TOKEN_SIN:
+        return sinl(x);
+    case TOKEN_COS:
+        return cosl(x);
+    case TOKEN_TAN:
+        return tanl(x);
+    case TOKEN_ASIN:
+        return asinl(x);
+    case TOKEN_ACOS:
+        return acosl(x);
+    case TOKEN_ATAN:
+        return atanl(x);
+    case TOKEN_SINH:
+        return sinhl(x);
+    case TOKEN_COSH:
+        return coshl(x);
+    case TOKEN_TANH:
+        return tanhl(x);
+    case TOKEN_ASINH:
+        return asinhl(x);
+    case TOKEN_ACOSH:
+        return acoshl(x);
+    case TOKEN_ATANH:
+        return atanhl(x);
+    case TOKEN_SQRT:
+        return sqrtl(x);
+    case TOKEN_LOG:
+        return logl(x);
+    case TOKEN_LOG10:
+        return log10l(x);
+    case TOKEN_EXP:
+        return expl(x);
+    case TOKEN_ABS:
+        return fabsl(x);
+    case TOKEN_FLOOR:
+        return floorl(x);
+    case TOKEN_CEIL:
+        return ceill(x);
+    default:
+        return NAN;
+    }
+}
+
+// Arguments outside a function's domain are left to MPFR, which reports them
+static int native_in_domain(TokenType func_type, long double x)
+{
+    switch (func_type)
+    {
+    case TOKEN_ASIN:
+    case TOKEN_ACOS:
+        return x >= -1 && x <= 1;
+    case TOKEN_ACOSH:
+        return x >= 1;
+    case TOKEN_ATANH:
+        return x > -1 && x < 1;
+    case TOKEN_SQRT:
+        return x >= 0;
+    case TOKEN_LOG:
+    case TOKEN_LOG10:
+        return x > 0;
+    default:
+        return 1;
+    }
+}
+
+// Apply a function to evaluated arguments (y is only read for two-argument
+// functions)
+static int native_apply(const EvalContext *ctx, TokenType func_type, const NativeValue *x,
+                        const NativeValue *y, NativeValue *out)
+{
+    if (func_type == TOKEN_POW)
+    {
+        if (!native_pow(x, y, out))
+            return 0;
+    }
+    else if (func_type == TOKEN_ATAN2)
+    {
+        // Both partial derivatives are at most 1 / |(x, y)|; the result
+        // jumps across the branch cut on the negative x axis
+        long double magnitude = fmaxl(fabsl(x->value), fabsl(y->value));
+        long double error = x->error + y->error;
+        int y_nonzero = x->value != 0.0L && fabsl(x->value) > 2 * x->error;
+        int x_positive = y->value > 2 * y->error;
+        if (magnitude == 0.0L || error > magnitude / 8 || (!y_nonzero && !x_positive))
+            return 0;
+        out->value = atan2l(x->value, y->value);
+        out->error = 2 * error / magnitude +
+                     fabsl(out->value) * NATIVE_LIBM_ULPS * NATIVE_EPSILON;
+    }
+    else
+    {
+        if (!native_in_domain(func_type, x->value))
+            return 0;
+        long double r = native_call(func_type, x->value);
+        long double propagated = 0.0L;
+        if (x->error != 0.0L && !native_propagate(func_type, x, r, &propagated))
+            return 0;
+
+        int exact_op = func_type == TOKEN_ABS || func_type == TOKEN_FLOOR ||
+                       func_type == TOKEN_CEIL;
+        out->value = r;
+        out->error = propagated +
+                     (exact_op ? 0.0L : fabsl(r) * NATIVE_LIBM_ULPS * NATIVE_EPSILON);
+    }
+
+    // The MPFR path flushes tiny function results to zero; leave anything
+    // that could be flushed to it
+    long double flush = ldexpl(1.0L, -(int)ctx->precision - 8);
+    if (!(fabsl(out->value) - out->error > flush))
+    {
+        return 0;
+    }
+    return native_usable(out);
+}
+
+// Number of arguments a function takes; 0 for registered functions, whose
+// kernels only take MPFR values, so that no call matches
+static int native_arity(TokenType func_type)
+{
+    if (token_is_custom_function(func_type))
+        return 0;
+    return func_type == TOKEN_POW || func_type == TOKEN_ATAN2 ? 2 : 1;
+}
+
+static int native_function(const EvalContext *ctx, const ASTNode *node, NativeValue *out)
+{
+    TokenType func_type = node->function.func_type;
+    int arity = native_arity(func_type);
+    if (node->function.arg_count != arity)
+    {
+        return 0;
+    }
+
+    NativeValue x, y;
+    if (!native_node(ctx, node->function.args[0], &x) ||
+        (arity == 2 && !native_node(ctx, node->function.args[1], &y)))
+    {
+        return 0;
+    }
+    return native_apply(ctx, func_type, &x, &y, out);
+}
+
+static int native_node(const EvalContext *ctx, const ASTNode *node, NativeValue *out)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (node->number.literal->folded_from &&
+            node->number.literal->folded_precision != ctx->precision)
+        {
+            // Folded for another precision: use the original subtree
+            return native_node(ctx, node->number.literal->folded_from, out);
+        }
+    {
+        // mpfr_get_d() is much cheaper and exact for values that fit a double
+        mpfr_srcptr value = node->number.literal->value;
+        mpfr_prec_t precision = mpfr_get_prec(value);
+        if (precision <= DBL_MANT_DIG && (!mpfr_regular_p(value) || (mpfr_get_exp(value) < 1000 &&
+                                                                     mpfr_get_exp(value) > -1000)))
+            out->value = mpfr_get_d(value, MPFR_RNDN);
+        else
+            out->value = mpfr_get_ld(value, MPFR_RNDN);
+        out->error = native_rounding(out->value, precision <= LDBL_MANT_DIG);
+        return native_usable(out);
+    }
+
+    case NODE_CONSTANT:
+        if (!constants_get_long_double(node->constant.name, &out->value))
+        {
+            return 0;
+        }
+        out->error = native_rounding(out->value, 0);
+        return 1;
+
+    case NODE_BINOP:
+        return native_binop(ctx, node, out);
+
+    case NODE_NARY:
+        return native_nary(ctx, node, out);
+
+    case NODE_UNARY:
+        if (!native_node(ctx, node->unary.operand, out))
+        {
+            return 0;
+        }
+        if (node->unary.op == TOKEN_MINUS)
+        {
+            out->value = -out->value;
+        }
+        return node->unary.op == TOKEN_MINUS || node->unary.op == TOKEN_PLUS;
+
+    case NODE_FUNCTION:
+        return native_function(ctx, node, out);
+
+    default:
+        return 0;
+    }
+}
+
+int native_eval_supported(const EvalContext *ctx, mpfr_srcptr result)
+{
+    return ctx->precision <= NATIVE_MAX_PRECISION && mpfr_get_prec(result) <= NATIVE_MAX_PRECISION;
+}
+
+int native_eval(const EvalContext *ctx, mpfr_t result, const ASTNode *node)
+{
+    if (!native_eval_supported(ctx, result))
+    {
+        return 0;
+    }
+
+    NativeValue value;
+    if (!native_node(ctx, node, &value))
+    {
+        return 0;
+    }
+
+    if (value.error == 0.0L)
+    {
+        mpfr_set_ld(result, value.value, ctx->rounding);
+        return 1;
+    }
+
+    // Accept when both ends of the (doubled) error interval round alike
+    mpfr_prec_t precision = mpfr_get_prec(result);
+    long double low = native_round_to(value.value - 2 * value.error, precision, ctx->rounding);
+    long double high = native_round_to(value.value + 2 * value.error, precision, ctx->rounding);
+    if (low != high || low == 0.0L)
+    {
+        return 0;
+    }
+
+    // low has at most precision bits, so either conversion is exact
+    if ((long double)(double)low == low)
+        mpfr_set_d(result, (double)low, ctx->rounding);
+    else
+        mpfr_set_ld(result, low, ctx->rounding);
+    return 1;
+}
+
+// One value per lane of a batch, with its error bound and whether the lane
+// is still on the fast path
+typedef struct
+{
+    double value[NATIVE_BATCH_SIZE];
+    double error[NATIVE_BATCH_SIZE];
+    unsigned char ok[NATIVE_BATCH_SIZE];
+} NativeColumn;
+
+typedef struct
+{
+    const EvalContext *ctx;
+    const char *name;
+    const NativeColumn *input; // The variable's values
+    NativeColumn *levels;      // Two operand columns per tree level
+    int count;
+} NativeBatch;
+
+// Relative rounding error bound of one double operation
+#define NATIVE_BATCH_EPSILON DBL_EPSILON
+
+// Check that a tree only reads the batch variable and measure its depth;
+// returns 0 for trees the batch path does not cover
+static int native_batch_depth(const ASTNode *node, const char *name, int *depth)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    int left = 0, right = 0;
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (node->number.literal->folded_from)
+        {
+            // Stale folds are evaluated through the subtree they replaced
+            if (!native_batch_depth(node->number.literal->folded_from, name, &left))
+                return 0;
+        }
+        break;
+    case NODE_CONSTANT:
+        break;
+    case NODE_VARIABLE:
+        if (strcmp(node->variable.name, name) != 0)
+            return 0;
+        break;
+    case NODE_BINOP:
+        if (!native_batch_depth(node->binop.left, name, &left) ||
+            !native_batch_depth(node->binop.right, name, &right))
+            return 0;
+        break;
+    case NODE_UNARY:
+        if (!native_batch_depth(node->unary.operand, name, &left))
+            return 0;
+        break;
+    case NODE_NARY:
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            if (!native_batch_depth(node->nary.operands[i], name, &right))
+                return 0;
+            if (right > left)
+                left = right;
+        }
+        break;
+    case NODE_FUNCTION:
+        if (node->function.arg_count != native_arity(node->function.func_type) ||
+            !native_batch_depth(node->function.args[0], name, &left) ||
+            (node->function.arg_count == 2 &&
+             !native_batch_depth(node->function.args[1], name, &right)))
+            return 0;
+        break;
+    default:
+        return 0;
+    }
+
+    *depth = 1 + (left > right ? left : right);
+    return 1;
+}
+
+// The same range check as native_usable(), for doubles
+static int native_batch_usable(double value, double error)
+{
+    return isfinite(value) && isfinite(error) &&
+           (value == 0.0 || fabs(value) >= DBL_MIN / DBL_EPSILON);
+}
+
+static void native_batch_fill(NativeBatch *batch, NativeColumn *out, double value, double error,
+                              int ok)
+{
+    for (int i = 0; i < batch->count; i++)
+    {
+        out->value[i] = value;
+        out->error[i] = error;
+        out->ok[i] = (unsigned char)ok;
+    }
+}
+
+// Hand a lane to the long double code, rounding its result back to double
+static void native_batch_lane(NativeColumn *out, int i, const NativeValue *value, int ok)
+{
+    double rounded = (double)value->value;
+    out->value[i] = rounded;
+    out->error[i] = (double)value->error + fabs(rounded) * NATIVE_BATCH_EPSILON;
+    out->ok[i] = ok && native_batch_usable(out->value[i], out->error[i]);
+}
+
+static NativeValue native_batch_get(const NativeColumn *column, int i)
+{
+    NativeValue value = {column->value[i], column->error[i]};
+    return value;
+}
+
+static void native_batch_node(NativeBatch *batch, const ASTNode *node, int depth,
+                              NativeColumn *out);
+
+static void native_batch_binop(NativeBatch *batch, const ASTNode *node, int depth,
+                               NativeColumn *out)
+{
+    NativeColumn *a = &batch->levels[2 * depth];
+    NativeColumn *b = &batch->levels[2 * depth + 1];
+    native_batch_node(batch, node->binop.left, depth + 1, a);
+    native_batch_node(batch, node->binop.right, depth + 1, b);
+
+    int n = batch->count;
+    double *restrict r = out->value;
+    double *restrict e = out->error;
+    unsigned char *restrict ok = out->ok;
+    const double *restrict av = a->value;
+    const double *restrict ae = a->error;
+    const double *restrict bv = b->value;
+    const double *restrict be = b->error;
+
+    // Branch-free loops over whole columns; lanes that leave the error
+    // model are only marked, never skipped
+    switch (node->binop.op)
+    {
+    case TOKEN_PLUS:
+        for (int i = 0; i < n; i++)
+        {
+            r[i] = av[i] + bv[i];
+            e[i] = ae[i] + be[i] + fabs(r[i]) * NATIVE_BATCH_EPSILON;
+        }
+        break;
+    case TOKEN_MINUS:
+        for (int i = 0; i < n; i++)
+        {
+            r[i] = av[i] - bv[i];
+            e[i] = ae[i] + be[i] + fabs(r[i]) * NATIVE_BATCH_EPSILON;
+        }
+        break;
+    case TOKEN_STAR:
+        for (int i = 0; i < n; i++)
+        {
+            r[i] = av[i] * bv[i];
+            e[i] = fabs(bv[i]) * ae[i] + fabs(av[i]) * be[i] + ae[i] * be[i] +
+                   fabs(r[i]) * NATIVE_BATCH_EPSILON;
+        }
+        break;
+    case TOKEN_SLASH:
+        for (int i = 0; i < n; i++)
+        {
+            // Divisors that may be zero are left to MPFR
+            ok[i] = be[i] <= fabs(bv[i]) / 2 && bv[i] != 0.0;
+            double divisor = ok[i] ? bv[i] : 1.0;
+            r[i] = av[i] / divisor;
+            e[i] = (ae[i] + fabs(r[i]) * be[i]) / (fabs(divisor) - be[i]) +
+                   fabs(r[i]) * NATIVE_BATCH_EPSILON;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            ok[i] &= a->ok[i] & b->ok[i];
+        }
+        goto check;
+    default:
+        // Powers and comparisons reuse the long double code lane by lane
+        for (int i = 0; i < n; i++)
+        {
+            NativeValue x = native_batch_get(a, i);
+            NativeValue y = native_batch_get(b, i);
+            NativeValue value = {0.0L, 0.0L};
+            int lane_ok = a->ok[i] && b->ok[i];
+            if (lane_ok)
+            {
+                lane_ok = node->binop.op == TOKEN_CARET ? native_pow(&x, &y, &value)
+                                                        : native_compare(node->binop.op, &x,
+                                                                         &y, &value);
+            }
+            native_batch_lane(out, i, &value, lane_ok);
+        }
+        return;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        ok[i] = a->ok[i] & b->ok[i];
+    }
+check:
+    for (int i = 0; i < n; i++)
+    {
+        ok[i] = ok[i] && native_batch_usable(r[i], e[i]);
+    }
+}
+
+// Sums and products accumulate into out, one operand column at a time
+static void native_batch_nary(NativeBatch *batch, const ASTNode *node, int depth,
+                              NativeColumn *out)
+{
+    NativeColumn *a = &batch->levels[2 * depth];
+    native_batch_node(batch, node->nary.operands[0], depth + 1, out);
+
+    int n = batch->count;
+    double *restrict r = out->value;
+    double *restrict e = out->error;
+    unsigned char *restrict ok = out->ok;
+    const double *restrict av = a->value;
+    const double *restrict ae = a->error;
+    for (int k = 1; k < node->nary.count; k++)
+    {
+        native_batch_node(batch, node->nary.operands[k], depth + 1, a);
+        if (node->nary.op == TOKEN_PLUS)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                r[i] = r[i] + av[i];
+                e[i] = e[i] + ae[i] + fabs(r[i]) * NATIVE_BATCH_EPSILON;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < n; i++)
+            {
+                double x = r[i];
+                r[i] = x * av[i];
+                e[i] = fabs(av[i]) * e[i] + fabs(x) * ae[i] + e[i] * ae[i] +
+                       fabs(r[i]) * NATIVE_BATCH_EPSILON;
+            }
+        }
+        for (int i = 0; i < n; i++)
+        {
+            ok[i] = ok[i] & a->ok[i];
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        ok[i] = ok[i] && native_batch_usable(r[i], e[i]);
+    }
+}
+
+static void native_batch_function(NativeBatch *batch, const ASTNode *node, int depth,
+                                  NativeColumn *out)
+{
+    NativeColumn *a = &batch->levels[2 * depth];
+    NativeColumn *b = &batch->levels[2 * depth + 1];
+    int binary = node->function.arg_count == 2;
+    native_batch_node(batch, node->function.args[0], depth + 1, a);
+    if (binary)
+    {
+        native_batch_node(batch, node->function.args[1], depth + 1, b);
+    }
+
+    for (int i = 0; i < batch->count; i++)
+    {
+        NativeValue x = native_batch_get(a, i);
+        NativeValue y = binary ? native_batch_get(b, i) : x;
+        NativeValue value = {0.0L, 0.0L};
+        int lane_ok = a->ok[i] && (!binary || b->ok[i]) &&
+                      native_apply(batch->ctx, node->function.func_type, &x, &y, &value);
+        native_batch_lane(out, i, &value, lane_ok);
+    }
+}
+
+static void native_batch_node(NativeBatch *batch, const ASTNode *node, int depth,
+                              NativeColumn *out)
+{
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (node->number.literal->folded_from &&
+            node->number.literal->folded_precision != batch->ctx->precision)
+        {
+            native_batch_node(batch, node->number.literal->folded_from, depth, out);
+            return;
+        }
+    {
+        NativeValue value;
+        int ok = native_node(batch->ctx, node, &value);
+        native_batch_fill(batch, out, 0.0, 0.0, 0);
+        for (int i = 0; ok && i < batch->count; i++)
+        {
+            native_batch_lane(out, i, &value, 1);
+        }
+        return;
+    }
+
+    case NODE_CONSTANT:
+    {
+        long double value;
+        int ok = constants_get_long_double(node->constant.name, &value);
+        double rounded = ok ? (double)value : 0.0;
+        native_batch_fill(batch, out, rounded, 2 * fabs(rounded) * NATIVE_BATCH_EPSILON, ok);
+        return;
+    }
+
+    case NODE_VARIABLE:
+        memcpy(out, batch->input, sizeof(*out));
+        return;
+
+    case NODE_BINOP:
+        native_batch_binop(batch, node, depth, out);
+        return;
+
+    case NODE_UNARY:
+        native_batch_node(batch, node->unary.operand, depth, out);
+        if (node->unary.op == TOKEN_MINUS)
+        {
+            for (int i = 0; i < batch->count; i++)
+            {
+                out->value[i] = -out->value[i];
+            }
+        }
+        else if (node->unary.op != TOKEN_PLUS)
+        {
+            native_batch_fill(batch, out, 0.0, 0.0, 0);
+        }
+        return;
+
+    case NODE_NARY:
+        native_batch_nary(batch, node, depth, out);
+        return;
+
+    case NODE_FUNCTION:
+        native_batch_function(batch, node, depth, out);
+        return;
+
+    default:
+        native_batch_fill(batch, out, 0.0, 0.0, 0);
+        return;
+    }
+}
+
+int native_eval_batch(const EvalContext *ctx, const ASTNode *node, const char *name,
+                      mpfr_t *inputs, int count, mpfr_t *results, unsigned char *accepted)
+{
+    memset(accepted, 0, (size_t)(count > 0 ? count : 0));
+    int depth;
+    if (count <= 0 || count > NATIVE_BATCH_SIZE || ctx->precision > NATIVE_BATCH_MAX_PRECISION ||
+        !native_batch_depth(node, name, &depth))
+    {
+        return 0;
+    }
+
+    // Columns for the input, the result and two operands per level
+    NativeColumn *columns = malloc((size_t)(2 * depth + 2) * sizeof(NativeColumn));
+    if (!columns)
+    {
+        return 0;
+    }
+    NativeColumn *input = &columns[0];
+    NativeColumn *root = &columns[1];
+    NativeBatch batch = {ctx, name, input, columns + 2, count};
+
+    for (int i = 0; i < count; i++)
+    {
+        input->value[i] = mpfr_get_d(inputs[i], MPFR_RNDN);
+        input->error[i] = mpfr_cmp_d(inputs[i], input->value[i]) == 0
+                              ? 0.0
+                              : fabs(input->value[i]) * NATIVE_BATCH_EPSILON;
+        input->ok[i] = !mpfr_nan_p(inputs[i]) &&
+                       native_batch_usable(input->value[i], input->error[i]);
+    }
+
+    native_batch_node(&batch, node, 0, root);
+
+    int accepted_count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!root->ok[i])
+        {
+            continue;
+        }
+
+        // Exact values are rounded by MPFR; otherwise accept when both ends
+        // of the (doubled) error interval round alike
+        double value = root->value[i];
+        double error = root->error[i];
+        mpfr_prec_t precision = mpfr_get_prec(results[i]);
+        if (error != 0.0)
+        {
+            if (precision > NATIVE_BATCH_MAX_PRECISION)
+                continue;
+            long double low = native_round_to((long double)value - 2.0L * error, precision,
+                                              ctx->rounding);
+            long double high = native_round_to((long double)value + 2.0L * error, precision,
+                                               ctx->rounding);
+            if (low != high || low == 0.0L)
+                continue;
+            value = (double)low; // At most precision bits, so exact
+        }
+
+        mpfr_set_d(results[i], value, ctx->rounding);
+        accepted[i] = 1;
+        accepted_count++;
+    }
+
+    free(columns);
+    return accepted_count;
+}
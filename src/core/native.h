@@ -0,0 +1,71 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "ast.h"
+#include <float.h>
+#include <mpfr.h>
+
+typedef struct EvalContext EvalContext;
+
+// Largest precision the native backend serves. The hardware type needs
+// guard bits beyond the result for its error check to ever succeed.
+#define NATIVE_MAX_PRECISION (LDBL_MANT_DIG - 8)
+
+// Error assumed for libm's long double functions, in ulps (about twice
+// the worst case glibc documents for them)
+#define NATIVE_LIBM_ULPS 8
+
+// Inputs native_eval_batch() evaluates together
+#define NATIVE_BATCH_SIZE 256
+
+// Largest precision native_eval_batch() serves; its lanes are doubles
+#define NATIVE_BATCH_MAX_PRECISION (DBL_MANT_DIG - 8)
+
+/**
+ * Check whether an evaluation can use the native backend
+ * @param ctx Context the tree would be evaluated in
+ * @param result Output variable the result would be stored in
+ * @return 1 if the context and result precisions fit the hardware type
+ */
+int native_eval_supported(const EvalContext *ctx, mpfr_srcptr result);
+
+/**
+ * Evaluate an AST with long double arithmetic and libm
+ *
+ * A running error bound is kept for every node. The result is stored only
+ * when the whole error interval rounds to the same value at the result's
+ * precision in the context's rounding mode, so it is the correctly rounded
+ * value of the tree (literals taken as parsed). Anything the MPFR path
+ * would report or treat specially — errors, domain failures, tiny function
+ * results it flushes to zero, non-finite values — makes the backend decline.
+ *
+ * @param ctx Context supplying precision and rounding mode (not modified)
+ * @param result Output variable, untouched when the backend declines
+ * @param node AST node to evaluate
+ * @return 1 if result holds the trusted value, 0 to fall back to MPFR
+ */
+int native_eval(const EvalContext *ctx, mpfr_t result, const ASTNode *node);
+
+/**
+ * Evaluate an AST for many values of one variable with double arithmetic
+ *
+ * The tree is walked once per batch, and every node works on a whole column
+ * of inputs: arithmetic runs as plain loops over arrays of doubles that the
+ * compiler turns into SIMD code, and functions go through libm lane by lane.
+ * Each lane keeps an error bound and is accepted under the same rules as
+ * native_eval(); lanes that are not are left for the caller to evaluate
+ * with MPFR. Trees reading any other variable are declined as a whole.
+ *
+ * @param ctx Context supplying precision and rounding mode (not modified)
+ * @param node AST node to evaluate
+ * @param name Variable the inputs are values of
+ * @param inputs Values of the variable
+ * @param count Number of inputs, at most NATIVE_BATCH_SIZE
+ * @param results Output variables, set only for accepted lanes
+ * @param accepted Set to 1 for each lane whose result is trusted, 0 otherwise
+ * @return Number of accepted lanes
+ */
+int native_eval_batch(const EvalContext *ctx, const ASTNode *node, const char *name,
+                      mpfr_t *inputs, int count, mpfr_t *results, unsigned char *accepted);
+
+#endif // NATIVE_H
@@ -1,10 +1,20 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "precision.h"
+#include "result_cache.h"
 #include <stdio.h>
+#include <unistd.h>
 
 // Global precision settings
 mpfr_prec_t global_precision = DEFAULT_PRECISION;
 mpfr_rnd_t global_rounding = MPFR_RNDN; // Round to nearest
 
+// Huge precision mode and its memory limit (0 for the default)
+static int huge_precision = 0;
+static size_t memory_limit = 0;
+
 void precision_init(void)
 {
     mpfr_set_default_prec(DEFAULT_PRECISION);
@@ -16,13 +26,65 @@ void set_precision(mpfr_prec_t prec)
 {
     if (prec < MIN_PRECISION)
         prec = MIN_PRECISION;
-    if (prec > MAX_PRECISION)
-        prec = MAX_PRECISION;
+    if (prec > precision_max())
+        prec = precision_max();
+
+    if (prec != global_precision)
+    {
+        // Cached results are keyed by precision; drop the ones now unreachable
+        result_cache_clear();
+    }
 
     global_precision = prec;
     mpfr_set_default_prec(prec);
 }
 
+void precision_set_huge(int huge)
+{
+    huge_precision = huge ? 1 : 0;
+    if (!huge_precision && global_precision > MAX_PRECISION)
+    {
+        set_precision(MAX_PRECISION);
+    }
+}
+
+int precision_get_huge(void)
+{
+    return huge_precision;
+}
+
+mpfr_prec_t precision_max(void)
+{
+    return huge_precision ? HUGE_MAX_PRECISION : MAX_PRECISION;
+}
+
+size_t precision_value_bytes(mpfr_prec_t prec)
+{
+    return mpfr_custom_get_size(prec) + sizeof(__mpfr_struct);
+}
+
+void precision_set_memory_limit(size_t bytes)
+{
+    memory_limit = bytes;
+}
+
+size_t precision_get_memory_limit(void)
+{
+    if (memory_limit)
+    {
+        return memory_limit;
+    }
+
+    // Half the physical memory, so one evaluation cannot push the machine into swap
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || page_size <= 0)
+    {
+        return 0;
+    }
+    return (size_t)pages / 2 * (size_t)page_size;
+}
+
 mpfr_prec_t get_precision(void)
 {
     return global_precision;
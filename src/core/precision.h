@@ -2,10 +2,12 @@
 #define PRECISION_H
 
 #include <mpfr.h>
+#include <stddef.h>
 
 #define DEFAULT_PRECISION 256 // bits of precision (roughly 77 decimal digits)
 #define MIN_PRECISION 2      // double precision is 53
 #define MAX_PRECISION 8192    // reasonable upper limit
+#define HUGE_MAX_PRECISION (1L << 28) // upper limit in huge precision mode (~80M digits)
 
 // Global precision settings
 extern mpfr_prec_t global_precision;
@@ -18,10 +20,48 @@ void precision_init(void);
 
 /**
  * Set calculation precision
- * @param prec Precision in bits (clamped to valid range)
+ * @param prec Precision in bits (clamped to valid range, see precision_max())
  */
 void set_precision(mpfr_prec_t prec);
 
+/**
+ * Allow precisions above MAX_PRECISION, up to HUGE_MAX_PRECISION
+ * Turning the mode off clamps the current precision back to MAX_PRECISION.
+ * @param huge 1 to enable, 0 to disable
+ */
+void precision_set_huge(int huge);
+
+/**
+ * Check whether huge precision mode is on
+ * @return 1 if on, 0 otherwise
+ */
+int precision_get_huge(void);
+
+/**
+ * Get the highest precision that can be set
+ * @return HUGE_MAX_PRECISION in huge precision mode, MAX_PRECISION otherwise
+ */
+mpfr_prec_t precision_max(void);
+
+/**
+ * Get the memory one MPFR value of a precision occupies
+ * @param prec Precision in bits
+ * @return Bytes of the value's significand and header
+ */
+size_t precision_value_bytes(mpfr_prec_t prec);
+
+/**
+ * Limit the memory one huge precision evaluation may need
+ * @param bytes Limit in bytes, 0 for the default (half the physical memory)
+ */
+void precision_set_memory_limit(size_t bytes);
+
+/**
+ * Get the memory limit for huge precision evaluations
+ * @return Limit in bytes, 0 if the physical memory is unknown and no limit set
+ */
+size_t precision_get_memory_limit(void);
+
 /**
  * Get current precision
  * @return Current precision in bits
@@ -0,0 +1,174 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "profile.h"
+#include "function_table.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef NO_PROFILE
+atomic_int profile_active = 0;
+#endif
+
+// Counts of the calling thread, merged into the totals on exit
+static _Thread_local ProfileStats profile_local;
+
+static ProfileStats profile_total;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *const profile_phase_names[PROFILE_PHASE_COUNT] = {"parse", "eval", "format",
+                                                                    "simplify"};
+
+int profile_available(void)
+{
+#ifdef NO_PROFILE
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+void profile_set_enabled(int enabled)
+{
+#ifndef NO_PROFILE
+    atomic_store(&profile_active, enabled ? 1 : 0);
+#else
+    (void)enabled;
+#endif
+}
+
+int profile_is_enabled(void)
+{
+#ifndef NO_PROFILE
+    return atomic_load(&profile_active);
+#else
+    return 0;
+#endif
+}
+
+uint64_t profile_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+void profile_add_phase(ProfilePhase phase, uint64_t start)
+{
+    profile_local.phase_ns[phase] += profile_now() - start;
+}
+
+void profile_add_count(ProfileCounter counter, unsigned long count)
+{
+    profile_local.counters[counter] += count;
+}
+
+void profile_add_function(TokenType function, uint64_t start)
+{
+    profile_local.function_calls[function]++;
+    profile_local.function_ns[function] += profile_now() - start;
+}
+
+// Add src into dst
+static void profile_accumulate(ProfileStats *dst, const ProfileStats *src)
+{
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
+    {
+        dst->phase_ns[i] += src->phase_ns[i];
+    }
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+    {
+        dst->counters[i] += src->counters[i];
+    }
+    for (int i = 0; i < PROFILE_TOKEN_COUNT; i++)
+    {
+        dst->function_calls[i] += src->function_calls[i];
+        dst->function_ns[i] += src->function_ns[i];
+    }
+}
+
+void profile_merge_thread(void)
+{
+    pthread_mutex_lock(&profile_lock);
+    profile_accumulate(&profile_total, &profile_local);
+    pthread_mutex_unlock(&profile_lock);
+    memset(&profile_local, 0, sizeof(profile_local));
+}
+
+void profile_get_stats(ProfileStats *stats)
+{
+    profile_merge_thread();
+    pthread_mutex_lock(&profile_lock);
+    *stats = profile_total;
+    pthread_mutex_unlock(&profile_lock);
+}
+
+void profile_reset(void)
+{
+    pthread_mutex_lock(&profile_lock);
+    memset(&profile_total, 0, sizeof(profile_total));
+    pthread_mutex_unlock(&profile_lock);
+    memset(&profile_local, 0, sizeof(profile_local));
+}
+
+void profile_print(FILE *out)
+{
+    if (!profile_available())
+    {
+        fprintf(out, "Profiling: not available (built with NO_PROFILE)\n");
+        return;
+    }
+
+    ProfileStats stats;
+    profile_get_stats(&stats);
+    unsigned long lines = stats.counters[PROFILE_LINES];
+
+    fprintf(out, "Profiling: %s\n", profile_is_enabled() ? "on" : "off");
+    fprintf(out, "Lines: %lu  Tokens: %lu  AST nodes: %lu  MPFR temporaries: %lu\n", lines,
+            stats.counters[PROFILE_TOKENS], stats.counters[PROFILE_AST_NODES],
+            stats.counters[PROFILE_MPFR_TEMPS]);
+    unsigned long hits = stats.counters[PROFILE_CONSTANT_HITS];
+    unsigned long misses = stats.counters[PROFILE_CONSTANT_MISSES];
+    fprintf(out, "Constant cache: %lu hits, %lu misses", hits, misses);
+    if (hits + misses > 0)
+    {
+        fprintf(out, "  (hit rate %.1f%%)", 100.0 * hits / (hits + misses));
+    }
+    fprintf(out, "\n");
+    if (stats.counters[PROFILE_SHARED_HITS])
+    {
+        fprintf(out, "Shared subexpressions reused: %lu\n", stats.counters[PROFILE_SHARED_HITS]);
+    }
+    if (stats.counters[PROFILE_EXACT])
+    {
+        fprintf(out, "Exact evaluations: %lu\n", stats.counters[PROFILE_EXACT]);
+    }
+
+    fprintf(out, "%-10s %12s %12s\n", "Phase", "Total ms", "Per line us");
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
+    {
+        double ns = (double)stats.phase_ns[i];
+        fprintf(out, "%-10s %12.3f %12.3f\n", profile_phase_names[i], ns * 1e-6,
+                lines ? ns * 1e-3 / lines : 0.0);
+    }
+
+    int header = 0;
+    for (int i = 0; i < PROFILE_TOKEN_COUNT; i++)
+    {
+        unsigned long calls = stats.function_calls[i];
+        if (!calls)
+        {
+            continue;
+        }
+        if (!header)
+        {
+            fprintf(out, "%-10s %12s %12s %12s\n", "Function", "Calls", "Total ms", "Mean us");
+            header = 1;
+        }
+        double ns = (double)stats.function_ns[i];
+        fprintf(out, "%-10s %12lu %12.3f %12.3f\n", function_table_get_name((TokenType)i), calls,
+                ns * 1e-6, ns * 1e-3 / calls);
+    }
+}
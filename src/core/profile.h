@@ -0,0 +1,175 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "tokens.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Per-phase timers and counters for finding where a line's time goes.
+ *
+ * Profiling is off until profile_set_enabled(1); while off every hook costs
+ * one relaxed load. Building with -DNO_PROFILE (make noprofile) compiles the
+ * hooks out entirely, and profile_available() then returns 0.
+ *
+ * Counts are kept per thread and merged into the totals when a worker thread
+ * calls profile_merge_thread() on exit, so hooks never take a lock.
+ */
+
+/**
+ * Timed phases of a line. The lexer runs on demand inside the parser, so
+ * lexing is timed as part of parsing.
+ */
+typedef enum
+{
+    PROFILE_PARSE,
+    PROFILE_EVAL,
+    PROFILE_FORMAT,
+    PROFILE_SIMPLIFY, // Symbolic simplification (see symbolic.h)
+    PROFILE_PHASE_COUNT
+} ProfilePhase;
+
+/**
+ * Event counters
+ */
+typedef enum
+{
+    PROFILE_LINES,            // Expression lines processed
+    PROFILE_TOKENS,           // Tokens read by the parser
+    PROFILE_AST_NODES,        // Nodes allocated by ast_create_*()
+    PROFILE_MPFR_TEMPS,       // MPFR temporaries initialized for evaluation
+    PROFILE_CONSTANT_HITS,    // Constants rounded from a cached value
+    PROFILE_CONSTANT_MISSES,  // Constants that had to be computed
+    PROFILE_SHARED_HITS,      // Shared subexpressions reused instead of evaluated
+    PROFILE_EXACT,            // Evaluations computed entirely by the exact tier
+    PROFILE_COUNTER_COUNT
+} ProfileCounter;
+
+// Function calls are counted per token
+#define PROFILE_TOKEN_COUNT (TOKEN_INVALID + 1)
+
+/**
+ * Profile totals
+ */
+typedef struct
+{
+    uint64_t phase_ns[PROFILE_PHASE_COUNT];
+    unsigned long counters[PROFILE_COUNTER_COUNT];
+    unsigned long function_calls[PROFILE_TOKEN_COUNT];
+    uint64_t function_ns[PROFILE_TOKEN_COUNT];
+} ProfileStats;
+
+#ifndef NO_PROFILE
+
+#include <stdatomic.h>
+
+// Read by the hooks; use profile_set_enabled() to change it
+extern atomic_int profile_active;
+
+#define PROFILE_ACTIVE() atomic_load_explicit(&profile_active, memory_order_relaxed)
+
+// Declare a start time, 0 while profiling is off
+#define PROFILE_START(start) uint64_t start = PROFILE_ACTIVE() ? profile_now() : 0
+
+// Charge the time since start to a phase
+#define PROFILE_PHASE(phase, start)          \
+    do                                       \
+    {                                        \
+        if (start)                           \
+            profile_add_phase(phase, start); \
+    } while (0)
+
+// Charge a call and the time since start to a function
+#define PROFILE_FUNCTION(token, start)          \
+    do                                          \
+    {                                           \
+        if (start)                              \
+            profile_add_function(token, start); \
+    } while (0)
+
+#define PROFILE_COUNT(counter, n)              \
+    do                                         \
+    {                                          \
+        if (PROFILE_ACTIVE())                  \
+            profile_add_count(counter, n);     \
+    } while (0)
+
+#else
+
+#define PROFILE_START(start) ((void)0)
+#define PROFILE_PHASE(phase, start) ((void)0)
+#define PROFILE_FUNCTION(token, start) ((void)0)
+#define PROFILE_COUNT(counter, n) ((void)0)
+
+#endif
+
+/**
+ * Check whether profiling was compiled in
+ * @return 0 when built with NO_PROFILE, 1 otherwise
+ */
+int profile_available(void);
+
+/**
+ * Turn profiling on or off for every thread
+ * Ignored when profiling is not available.
+ * @param enabled 1 to start counting, 0 to stop
+ */
+void profile_set_enabled(int enabled);
+
+/**
+ * Check whether profiling is on
+ * @return 1 if on, 0 otherwise
+ */
+int profile_is_enabled(void);
+
+/**
+ * Get the monotonic clock
+ * @return Nanoseconds since an arbitrary start
+ */
+uint64_t profile_now(void);
+
+/**
+ * Charge the time since start to a phase on the calling thread
+ * @param phase Phase
+ * @param start Time from profile_now()
+ */
+void profile_add_phase(ProfilePhase phase, uint64_t start);
+
+/**
+ * Add to a counter on the calling thread
+ * @param counter Counter
+ * @param count Amount to add
+ */
+void profile_add_count(ProfileCounter counter, unsigned long count);
+
+/**
+ * Charge one call and the time since start to a function on the calling thread
+ * @param function Function token
+ * @param start Time from profile_now()
+ */
+void profile_add_function(TokenType function, uint64_t start);
+
+/**
+ * Move the calling thread's counts into the totals
+ * Worker threads call this before they exit.
+ */
+void profile_merge_thread(void);
+
+/**
+ * Get the totals, including the calling thread's counts
+ * @param stats Output totals
+ */
+void profile_get_stats(ProfileStats *stats);
+
+/**
+ * Zero the totals and the calling thread's counts
+ */
+void profile_reset(void);
+
+/**
+ * Print the totals: phases, counters and the functions called
+ * @param out Stream to print to
+ */
+void profile_print(FILE *out);
+
+#endif // PROFILE_H
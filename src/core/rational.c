@@ -0,0 +1,395 @@
+#include "rational.h"
+#include "profile.h"
+#include <limits.h>
+
+int rational_supports_function(TokenType func_type)
+{
+    switch (func_type)
+    {
+    case TOKEN_ABS:
+    case TOKEN_FLOOR:
+    case TOKEN_CEIL:
+    case TOKEN_POW:
+    case TOKEN_SQRT:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int rational_node_exact(const ASTNode *node)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        // Lexed integers past int range arrive as float literals
+        return mpfr_integer_p(node->number.literal->value) && !node->number.literal->folded_from;
+    case NODE_BINOP:
+        return node->binop.left && node->binop.left->exact && node->binop.right &&
+               node->binop.right->exact;
+    case NODE_UNARY:
+        return node->unary.operand && node->unary.operand->exact;
+    case NODE_FUNCTION:
+        if (!rational_supports_function(node->function.func_type) ||
+            node->function.arg_count == 0)
+        {
+            return 0;
+        }
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            if (!node->function.args[i] || !node->function.args[i]->exact)
+            {
+                return 0;
+            }
+        }
+        return 1;
+    case NODE_NARY:
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            if (!node->nary.operands[i] || !node->nary.operands[i]->exact)
+            {
+                return 0;
+            }
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Check that neither part of a value has outgrown the tier
+static int rational_fits(const mpq_t value)
+{
+    return mpz_sizeinbase(mpq_numref(value), 2) <= RATIONAL_MAX_BITS &&
+           mpz_sizeinbase(mpq_denref(value), 2) <= RATIONAL_MAX_BITS;
+}
+
+static int rational_is_integer(const mpq_t value)
+{
+    return mpz_cmp_ui(mpq_denref(value), 1) == 0;
+}
+
+// Sign bit MPFR would give a value: that of a nonzero value, or the one
+// tracked for a zero
+static int rational_signbit(const mpq_t value, int negative_zero)
+{
+    return mpq_sgn(value) ? mpq_sgn(value) < 0 : negative_zero;
+}
+
+// Sign of a zero sum as IEEE 754 rounds it: like signs are kept, anything
+// else (including exact cancellation) gives +0, or -0 rounding down
+static int rational_sum_zero(int left_negative, int right_negative, mpfr_rnd_t rounding)
+{
+    return left_negative == right_negative ? left_negative : rounding == MPFR_RNDD;
+}
+
+// base^exponent for an integer exponent; result may be base
+static int rational_pow(mpq_t result, const mpq_t base, const mpq_t exponent)
+{
+    if (!rational_is_integer(exponent) || !mpz_fits_slong_p(mpq_numref(exponent)))
+    {
+        return 0;
+    }
+    long n = mpz_get_si(mpq_numref(exponent));
+    if (n == LONG_MIN)
+    {
+        return 0;
+    }
+
+    if (n < 0)
+    {
+        // 0^-n is an infinity the MPFR path produces
+        if (mpq_sgn(base) == 0)
+        {
+            return 0;
+        }
+        mpq_inv(result, base);
+        n = -n;
+    }
+    else if (result != base)
+    {
+        mpq_set(result, base);
+    }
+
+    // +-1 stays small whatever the exponent
+    size_t bits = mpz_sizeinbase(mpq_numref(result), 2) + mpz_sizeinbase(mpq_denref(result), 2);
+    int unit = mpz_cmpabs_ui(mpq_numref(result), 1) == 0 && rational_is_integer(result);
+    if (!unit && mpq_sgn(result) != 0 && (unsigned long)n > RATIONAL_MAX_BITS / bits)
+    {
+        return 0;
+    }
+    if (unit)
+    {
+        n &= 1;
+        if (n == 0)
+        {
+            mpq_set_ui(result, 1, 1);
+        }
+        return 1;
+    }
+
+    // Powers of coprime parts stay coprime, so the result is canonical
+    mpz_pow_ui(mpq_numref(result), mpq_numref(result), (unsigned long)n);
+    mpz_pow_ui(mpq_denref(result), mpq_denref(result), (unsigned long)n);
+    return 1;
+}
+
+// Sign of a zero base^exponent: only odd powers of -0 are negative
+static int rational_pow_negative(const mpq_t base, int negative_zero, const mpq_t exponent)
+{
+    return mpq_sgn(base) == 0 && negative_zero && mpz_odd_p(mpq_numref(exponent));
+}
+
+static int rational_eval_binop(mpq_t result, int *negative_zero, const ASTNode *node,
+                               mpfr_rnd_t rounding)
+{
+    int left_negative;
+    if (!rational_eval_signed(result, &left_negative, node->binop.left, rounding))
+    {
+        return 0;
+    }
+    left_negative = rational_signbit(result, left_negative);
+    mpq_t right;
+    mpq_init(right);
+    int right_negative;
+    int ok = rational_eval_signed(right, &right_negative, node->binop.right, rounding);
+    right_negative = rational_signbit(right, right_negative);
+    *negative_zero = 0;
+
+    if (ok)
+    {
+        switch (node->binop.op)
+        {
+        case TOKEN_PLUS:
+            mpq_add(result, result, right);
+            *negative_zero = rational_sum_zero(left_negative, right_negative, rounding);
+            break;
+        case TOKEN_MINUS:
+            mpq_sub(result, result, right);
+            *negative_zero = rational_sum_zero(left_negative, !right_negative, rounding);
+            break;
+        case TOKEN_STAR:
+            mpq_mul(result, result, right);
+            *negative_zero = left_negative != right_negative;
+            break;
+        case TOKEN_SLASH:
+            // Division by zero is reported by the MPFR path
+            ok = mpq_sgn(right) != 0;
+            if (ok)
+            {
+                mpq_div(result, result, right);
+                *negative_zero = left_negative != right_negative;
+            }
+            break;
+        case TOKEN_CARET:
+            *negative_zero = rational_pow_negative(result, left_negative, right);
+            ok = rational_pow(result, result, right);
+            break;
+        case TOKEN_EQ:
+            mpq_set_ui(result, mpq_equal(result, right) ? 1 : 0, 1);
+            break;
+        case TOKEN_NEQ:
+            mpq_set_ui(result, mpq_equal(result, right) ? 0 : 1, 1);
+            break;
+        case TOKEN_LT:
+            mpq_set_ui(result, mpq_cmp(result, right) < 0, 1);
+            break;
+        case TOKEN_LTE:
+            mpq_set_ui(result, mpq_cmp(result, right) <= 0, 1);
+            break;
+        case TOKEN_GT:
+            mpq_set_ui(result, mpq_cmp(result, right) > 0, 1);
+            break;
+        case TOKEN_GTE:
+            mpq_set_ui(result, mpq_cmp(result, right) >= 0, 1);
+            break;
+        default:
+            ok = 0;
+        }
+    }
+
+    mpq_clear(right);
+    return ok && rational_fits(result);
+}
+
+// Sum or multiply every operand of an n-ary node, left to right
+static int rational_eval_nary(mpq_t result, int *negative_zero, const ASTNode *node,
+                              mpfr_rnd_t rounding)
+{
+    if (!rational_eval_signed(result, negative_zero, node->nary.operands[0], rounding))
+    {
+        return 0;
+    }
+    mpq_t operand;
+    mpq_init(operand);
+    int ok = 1;
+    for (int i = 1; ok && i < node->nary.count; i++)
+    {
+        int negative = rational_signbit(result, *negative_zero);
+        int operand_negative;
+        ok = rational_eval_signed(operand, &operand_negative, node->nary.operands[i], rounding);
+        operand_negative = rational_signbit(operand, operand_negative);
+        if (ok && node->nary.op == TOKEN_PLUS)
+        {
+            mpq_add(result, result, operand);
+            *negative_zero = rational_sum_zero(negative, operand_negative, rounding);
+        }
+        else if (ok)
+        {
+            mpq_mul(result, result, operand);
+            *negative_zero = negative != operand_negative;
+        }
+        ok = ok && rational_fits(result);
+    }
+    mpq_clear(operand);
+    return ok;
+}
+
+// Apply a function to its first argument, already in result
+static int rational_call(mpq_t result, const ASTNode *node, mpfr_rnd_t rounding)
+{
+    int arg_count = node->function.arg_count;
+    switch (node->function.func_type)
+    {
+    case TOKEN_ABS:
+        if (arg_count != 1)
+            return 0;
+        mpq_abs(result, result);
+        return 1;
+
+    case TOKEN_FLOOR:
+        if (arg_count != 1)
+            return 0;
+        mpz_fdiv_q(mpq_numref(result), mpq_numref(result), mpq_denref(result));
+        mpz_set_ui(mpq_denref(result), 1);
+        return 1;
+
+    case TOKEN_CEIL:
+        if (arg_count != 1)
+            return 0;
+        mpz_cdiv_q(mpq_numref(result), mpq_numref(result), mpq_denref(result));
+        mpz_set_ui(mpq_denref(result), 1);
+        return 1;
+
+    case TOKEN_SQRT:
+        // Negative arguments are domain errors the MPFR path reports;
+        // a canonical fraction is a square exactly when both parts are
+        if (arg_count != 1 || mpq_sgn(result) < 0 ||
+            !mpz_perfect_square_p(mpq_numref(result)) || !mpz_perfect_square_p(mpq_denref(result)))
+        {
+            return 0;
+        }
+        mpz_sqrt(mpq_numref(result), mpq_numref(result));
+        mpz_sqrt(mpq_denref(result), mpq_denref(result));
+        return 1;
+
+    case TOKEN_POW:
+    {
+        if (arg_count != 2)
+            return 0;
+        mpq_t exponent;
+        mpq_init(exponent);
+        int exponent_negative;
+        int ok = rational_eval_signed(exponent, &exponent_negative, node->function.args[1],
+                                      rounding) &&
+                 rational_pow(result, result, exponent);
+        mpq_clear(exponent);
+        return ok;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+static int rational_eval_function(mpq_t result, int *negative_zero, const ASTNode *node,
+                                  mpfr_rnd_t rounding)
+{
+    int arg_count = node->function.arg_count;
+    if (arg_count < 1 ||
+        !rational_eval_signed(result, negative_zero, node->function.args[0], rounding))
+    {
+        return 0;
+    }
+
+    // Calls answered here count like the ones MPFR answers. Like its
+    // results, theirs have no negative zero.
+    PROFILE_START(start);
+    int ok = rational_call(result, node, rounding);
+    *negative_zero = 0;
+    if (ok)
+    {
+        PROFILE_FUNCTION(node->function.func_type, start);
+    }
+    return ok;
+}
+
+int rational_eval_signed(mpq_t result, int *negative_zero, const ASTNode *node,
+                         mpfr_rnd_t rounding)
+{
+    *negative_zero = 0;
+    if (!node || !node->exact)
+    {
+        // A fold standing in for an exact subtree is computed again exactly
+        if (node && node->type == NODE_NUMBER && node->number.literal->folded_from)
+        {
+            return rational_eval_signed(result, negative_zero, node->number.literal->folded_from,
+                                        rounding);
+        }
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (!mpfr_integer_p(node->number.literal->value))
+        {
+            return 0;
+        }
+        mpfr_get_z(mpq_numref(result), node->number.literal->value, MPFR_RNDN);
+        mpz_set_ui(mpq_denref(result), 1);
+        *negative_zero = mpfr_zero_p(node->number.literal->value) &&
+                         mpfr_signbit(node->number.literal->value);
+        return rational_fits(result);
+
+    case NODE_BINOP:
+        return rational_eval_binop(result, negative_zero, node, rounding);
+
+    case NODE_UNARY:
+        if (!rational_eval_signed(result, negative_zero, node->unary.operand, rounding))
+        {
+            return 0;
+        }
+        switch (node->unary.op)
+        {
+        case TOKEN_PLUS:
+            return 1;
+        case TOKEN_MINUS:
+            mpq_neg(result, result);
+            *negative_zero = !*negative_zero;
+            return 1;
+        default:
+            return 0;
+        }
+
+    case NODE_FUNCTION:
+        return rational_eval_function(result, negative_zero, node, rounding);
+
+    case NODE_NARY:
+        return rational_eval_nary(result, negative_zero, node, rounding);
+
+    default:
+        return 0;
+    }
+}
+
+int rational_eval(mpq_t result, const ASTNode *node)
+{
+    int negative_zero;
+    return rational_eval_signed(result, &negative_zero, node, MPFR_RNDN);
+}
@@ -0,0 +1,63 @@
+#ifndef RATIONAL_H
+#define RATIONAL_H
+
+#include "ast.h"
+#include <gmp.h>
+#include <mpfr.h>
+
+// Bits the numerator or denominator of an exact value may take. Past this
+// the value is left to MPFR, whose cost does not grow with the magnitude.
+#define RATIONAL_MAX_BITS (1L << 20)
+
+/**
+ * Check whether a function keeps integer and rational arguments exact
+ * These are abs, floor, ceil, pow and sqrt (of perfect squares only).
+ * @param func_type Function token type
+ * @return 1 if rational_eval() can evaluate calls to it
+ */
+int rational_supports_function(TokenType func_type);
+
+/**
+ * Check whether a node can be part of an exact subtree
+ * Integer-valued literals can; operators and supported functions can when
+ * all their operands can. Constants, variables, fractional literals and
+ * folded values cannot. ast.c keeps the answer in ASTNode.exact as nodes
+ * are created, and also drops it for literals MPFR had to round.
+ * @param node Node whose children are already flagged
+ * @return 1 if the subtree may have an exact value
+ */
+int rational_node_exact(const ASTNode *node);
+
+/**
+ * Evaluate an integer/rational subtree exactly with GMP
+ *
+ * Integer literals are taken as the values they were parsed to. +, -, *, /
+ * and comparisons are exact; ^ and pow() need an integer exponent; sqrt()
+ * a perfect square. The tier declines whenever a value would not be
+ * rational, a division by zero or other error has to be reported by the
+ * MPFR path, or a numerator or denominator outgrows RATIONAL_MAX_BITS.
+ *
+ * @param result Output value, canonical; unspecified when declined
+ * @param node Subtree to evaluate
+ * @return 1 if result holds the exact value, 0 to fall back to MPFR
+ */
+int rational_eval(mpq_t result, const ASTNode *node);
+
+/**
+ * Evaluate an integer/rational subtree exactly, as rational_eval() does,
+ * also giving the sign MPFR would give a zero result
+ * GMP has no negative zero, so its sign is tracked alongside the value by
+ * IEEE 754 rules: negation and odd powers keep it, products and quotients
+ * combine signs, and a sum cancelling to zero is +0 except when rounding
+ * down. Function results are +0, as the MPFR path flushes them.
+ * atan2() tells -0 from +0.
+ * @param result Output value, canonical; unspecified when declined
+ * @param negative_zero Set to 1 if a zero result is -0, 0 otherwise
+ * @param node Subtree to evaluate
+ * @param rounding Rounding mode the MPFR path would use
+ * @return 1 if result holds the exact value, 0 to fall back to MPFR
+ */
+int rational_eval_signed(mpq_t result, int *negative_zero, const ASTNode *node,
+                         mpfr_rnd_t rounding);
+
+#endif // RATIONAL_H
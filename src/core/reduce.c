@@ -0,0 +1,799 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "reduce.h"
+#include "context.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include "function_table.h"
+#include "profile.h"
+#include "variables.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Quadrature tables are computed at a multiple of this many bits, so that
+// nearby precisions share one
+#define REDUCE_TABLE_STEP 64
+
+// Precision of the sums of absolute values, which only bound errors
+#define REDUCE_MAGNITUDE_PRECISION 32
+
+// Thread setting, 0 for one per online processor
+static atomic_int reduce_threads = 0;
+
+// Set on worker threads, whose own reductions run where they are
+static _Thread_local int reduce_on_worker = 0;
+
+// Nodes of one quadrature level. With t = k h, y = (pi/2) sinh t, each
+// node stands for the points to - half u and from + half u of a range,
+// where u = 1 - tanh y is kept rather than tanh y so that points near the
+// ends keep their precision, with the weight (pi/2) cosh t / cosh^2 y.
+// Level 0 has every k >= 0, its k = 0 weight halved as both ends use
+// it; level l > 0 has the odd k with h = 2^-l.
+typedef struct
+{
+    long count;
+    mpfr_t *u;
+    mpfr_t *weight;
+} QuadratureLevel;
+
+// Levels computed at one precision. A level is published once complete
+// and never changes afterwards, so readers need no lock.
+typedef struct QuadratureTable
+{
+    mpfr_prec_t precision;
+    QuadratureLevel levels[REDUCE_MAX_LEVEL + 1];
+    struct QuadratureTable *next;
+} QuadratureTable;
+
+static pthread_mutex_t reduce_tables_lock = PTHREAD_MUTEX_INITIALIZER;
+static QuadratureTable *reduce_tables = NULL;
+
+// One sum, or one level of a quadrature, split into blocks
+typedef struct
+{
+    EvalContext *ctx;     // Caller's context; workers only read it
+    const ASTNode *body;  // Expression evaluated at every point
+    const char *name;     // Variable bound to the point
+    mpfr_prec_t working;  // Precision of the points and block sums
+    long blocks;          // Number of blocks
+    mpfr_t *sums;         // Per block: sum of the weighted values
+    mpfr_t *magnitudes;   // Per block: sum of their absolute values, rounded up
+
+    // Sums: block b binds first + b * REDUCE_SUM_BLOCK up to last
+    long first;
+    long last;
+
+    // Integrals: block b takes REDUCE_QUADRATURE_BLOCK nodes of the level
+    const QuadratureLevel *level;
+    mpfr_srcptr from;
+    mpfr_srcptr to;
+    mpfr_srcptr half; // (to - from) / 2
+
+    // Worker threads take blocks in order; the error reported is that of
+    // the first block that failed, so it does not depend on timing
+    atomic_long next;
+    pthread_mutex_t lock;
+    long failed; // First block that failed, blocks if none
+    char error[EVAL_CONTEXT_ERROR_SIZE];
+    int budget_exceeded;
+} ReduceJob;
+
+// Worker thread of a job, with a context of its own
+typedef struct
+{
+    ReduceJob *job;
+    pthread_t thread;
+    EvalContext ctx;
+    VariableTable *variables;
+} ReduceWorker;
+
+// Compute the nodes of a quadrature level; returns 0 if out of memory
+static int quadrature_level_init(QuadratureLevel *level, int index, mpfr_prec_t precision)
+{
+    mpfr_t t, y, scratch, half_pi;
+    mpfr_inits2(precision, t, y, scratch, half_pi, (mpfr_ptr)0);
+    mpfr_const_pi(half_pi, MPFR_RNDN);
+    mpfr_div_2ui(half_pi, half_pi, 1, MPFR_RNDN);
+
+    // Weights fall double exponentially; past 2^(-2 precision) they are
+    // negligible even against an integrand singular at the end as 1/sqrt
+    mpfr_exp_t cutoff = -2 * (mpfr_exp_t)precision;
+    long capacity = 0;
+    int ok = 1;
+    level->count = 0;
+    level->u = NULL;
+    level->weight = NULL;
+    for (unsigned long k = index ? 1 : 0;; k += index ? 2 : 1)
+    {
+        if (level->count == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 64;
+            mpfr_t *u = realloc(level->u, capacity * sizeof(mpfr_t));
+            if (u)
+                level->u = u;
+            mpfr_t *weight = realloc(level->weight, capacity * sizeof(mpfr_t));
+            if (weight)
+                level->weight = weight;
+            if (!u || !weight)
+            {
+                ok = 0;
+                break;
+            }
+        }
+
+        mpfr_ptr u = level->u[level->count];
+        mpfr_ptr weight = level->weight[level->count];
+        mpfr_init2(u, precision);
+        mpfr_init2(weight, precision);
+        level->count++;
+
+        mpfr_set_ui(t, k, MPFR_RNDN);
+        mpfr_div_2ui(t, t, (unsigned long)index, MPFR_RNDN);
+        mpfr_sinh(y, t, MPFR_RNDN);
+        mpfr_mul(y, y, half_pi, MPFR_RNDN);
+
+        // u = 2 / (exp(2y) + 1), and 1 / cosh^2 y = u (2 - u)
+        mpfr_mul_2ui(scratch, y, 1, MPFR_RNDN);
+        mpfr_exp(scratch, scratch, MPFR_RNDN);
+        mpfr_add_ui(scratch, scratch, 1, MPFR_RNDN);
+        mpfr_ui_div(u, 2, scratch, MPFR_RNDN);
+        mpfr_ui_sub(scratch, 2, u, MPFR_RNDN);
+        mpfr_mul(weight, u, scratch, MPFR_RNDN);
+        mpfr_cosh(scratch, t, MPFR_RNDN);
+        mpfr_mul(weight, weight, scratch, MPFR_RNDN);
+        mpfr_mul(weight, weight, half_pi, MPFR_RNDN);
+        if (k == 0)
+        {
+            mpfr_div_2ui(weight, weight, 1, MPFR_RNDN);
+        }
+
+        if (mpfr_zero_p(weight) || mpfr_get_exp(weight) < cutoff)
+        {
+            break;
+        }
+    }
+
+    mpfr_clears(t, y, scratch, half_pi, (mpfr_ptr)0);
+    return ok;
+}
+
+static void quadrature_level_clear(QuadratureLevel *level)
+{
+    for (long i = 0; i < level->count; i++)
+    {
+        mpfr_clear(level->u[i]);
+        mpfr_clear(level->weight[i]);
+    }
+    free(level->u);
+    free(level->weight);
+    level->u = NULL;
+    level->weight = NULL;
+    level->count = 0;
+}
+
+// Get a quadrature level for a working precision, computing it on first
+// use. Returns NULL if out of memory.
+static const QuadratureLevel *quadrature_level(mpfr_prec_t working, int index)
+{
+    mpfr_prec_t precision = (working + REDUCE_TABLE_STEP - 1) / REDUCE_TABLE_STEP *
+                            REDUCE_TABLE_STEP;
+    const QuadratureLevel *found = NULL;
+
+    // Threads wanting a level being computed wait for it rather than
+    // computing it again
+    pthread_mutex_lock(&reduce_tables_lock);
+    QuadratureTable *table = reduce_tables;
+    while (table && table->precision != precision)
+    {
+        table = table->next;
+    }
+    if (!table)
+    {
+        table = calloc(1, sizeof(QuadratureTable));
+        if (table)
+        {
+            table->precision = precision;
+            table->next = reduce_tables;
+            reduce_tables = table;
+        }
+    }
+    if (table)
+    {
+        QuadratureLevel *level = &table->levels[index];
+        if (level->count == 0 && !quadrature_level_init(level, index, precision))
+        {
+            quadrature_level_clear(level);
+        }
+        found = level->count ? level : NULL;
+    }
+    pthread_mutex_unlock(&reduce_tables_lock);
+    return found;
+}
+
+void reduce_cleanup(void)
+{
+    pthread_mutex_lock(&reduce_tables_lock);
+    while (reduce_tables)
+    {
+        QuadratureTable *table = reduce_tables;
+        reduce_tables = table->next;
+        for (int i = 0; i <= REDUCE_MAX_LEVEL; i++)
+        {
+            quadrature_level_clear(&table->levels[i]);
+        }
+        free(table);
+    }
+    pthread_mutex_unlock(&reduce_tables_lock);
+}
+
+void reduce_set_threads(int threads)
+{
+    atomic_store(&reduce_threads, threads < 0 ? 0 : threads);
+}
+
+int reduce_get_threads(void)
+{
+    return atomic_load(&reduce_threads);
+}
+
+// Threads to run a job on: one for short jobs and inside workers
+static int reduce_job_threads(long blocks, long points)
+{
+    if (reduce_on_worker || blocks < 2 || points < REDUCE_PARALLEL_MIN)
+    {
+        return 1;
+    }
+    int threads = atomic_load(&reduce_threads);
+    if (threads <= 0)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = processors < 1 ? 1 : processors > REDUCE_MAX_THREADS ? REDUCE_MAX_THREADS
+                                                                        : (int)processors;
+    }
+    return threads > blocks ? (int)blocks : threads;
+}
+
+// Allocate the block sums of a job; returns 0 if out of memory
+static int reduce_job_blocks(ReduceJob *job, long blocks)
+{
+    job->sums = malloc(blocks * sizeof(mpfr_t));
+    job->magnitudes = malloc(blocks * sizeof(mpfr_t));
+    if (!job->sums || !job->magnitudes)
+    {
+        free(job->sums);
+        free(job->magnitudes);
+        job->sums = job->magnitudes = NULL;
+        return 0;
+    }
+    for (long i = 0; i < blocks; i++)
+    {
+        mpfr_init2(job->sums[i], job->working);
+        mpfr_init2(job->magnitudes[i], REDUCE_MAGNITUDE_PRECISION);
+    }
+    job->blocks = blocks;
+    return 1;
+}
+
+static void reduce_job_free_blocks(ReduceJob *job)
+{
+    for (long i = 0; i < job->blocks; i++)
+    {
+        mpfr_clear(job->sums[i]);
+        mpfr_clear(job->magnitudes[i]);
+    }
+    free(job->sums);
+    free(job->magnitudes);
+    job->sums = job->magnitudes = NULL;
+    job->blocks = 0;
+}
+
+// Evaluate the body at the bound point and add weight times its value to
+// a block; returns 0 when the evaluation failed or was stopped
+static int reduce_term(EvalContext *ctx, const ReduceJob *job, long block, mpfr_ptr term,
+                       mpfr_srcptr weight, int depth)
+{
+    evaluator_eval_subtree(ctx, term, job->body, depth);
+    if (ctx->error[0] || ctx->budget_exceeded)
+    {
+        return 0;
+    }
+    if (weight)
+    {
+        mpfr_mul(term, term, weight, MPFR_RNDN);
+    }
+    mpfr_add(job->sums[block], job->sums[block], term, MPFR_RNDN);
+    mpfr_abs(term, term, MPFR_RNDN);
+    mpfr_add(job->magnitudes[block], job->magnitudes[block], term, MPFR_RNDU);
+    return 1;
+}
+
+// Add up the terms of a sum block, in order
+static int reduce_sum_block(EvalContext *ctx, const ReduceJob *job, long block, mpfr_ptr point,
+                            mpfr_ptr term, int depth)
+{
+    long start = job->first + block * REDUCE_SUM_BLOCK;
+    long end = job->last - start < REDUCE_SUM_BLOCK ? job->last : start + REDUCE_SUM_BLOCK - 1;
+    for (long k = start;; k++)
+    {
+        mpfr_set_si(point, k, MPFR_RNDN);
+        if (!reduce_term(ctx, job, block, term, NULL, depth))
+        {
+            return 0;
+        }
+        if (k == end)
+        {
+            return 1;
+        }
+    }
+}
+
+// Add up the weighted values at the nodes of a quadrature block, in order
+static int reduce_quadrature_block(EvalContext *ctx, const ReduceJob *job, long block,
+                                   mpfr_ptr point, mpfr_ptr term, int depth)
+{
+    const QuadratureLevel *level = job->level;
+    long start = block * REDUCE_QUADRATURE_BLOCK;
+    long end = start + REDUCE_QUADRATURE_BLOCK < level->count ? start + REDUCE_QUADRATURE_BLOCK
+                                                               : level->count;
+    mpfr_t offset;
+    mpfr_init2(offset, job->working);
+    int ok = 1;
+    for (long i = start; ok && i < end; i++)
+    {
+        mpfr_mul(offset, job->half, level->u[i], MPFR_RNDN);
+
+        // The evaluator flushes values below 2^(-precision - 10) to zero,
+        // so closer to an end than the square of that even sqrt(x - a)
+        // vanishes and 1/sqrt(x - a) fails; what lies beyond is below the
+        // precision for such integrands, and the later nodes are closer
+        if (mpfr_get_exp(offset) <= -2 * (mpfr_exp_t)(ctx->precision + 10))
+        {
+            break;
+        }
+
+        // A point that rounds onto an end, where the integrand may be
+        // singular, weighs nothing at this precision and is left out
+        mpfr_sub(point, job->to, offset, MPFR_RNDN);
+        if (!mpfr_equal_p(point, job->to) && !mpfr_equal_p(point, job->from))
+        {
+            ok = reduce_term(ctx, job, block, term, level->weight[i], depth);
+        }
+        mpfr_add(point, job->from, offset, MPFR_RNDN);
+        if (ok && !mpfr_equal_p(point, job->to) && !mpfr_equal_p(point, job->from))
+        {
+            ok = reduce_term(ctx, job, block, term, level->weight[i], depth);
+        }
+    }
+    mpfr_clear(offset);
+    return ok;
+}
+
+// Compute one block of a job in a context; returns 0 with the context's
+// error (or budget) set on failure
+static int reduce_block(EvalContext *ctx, const ReduceJob *job, long block, int depth)
+{
+    mpfr_set_zero(job->sums[block], 1);
+    mpfr_set_zero(job->magnitudes[block], 1);
+
+    // Sums bind integers, which a long always holds exactly
+    mpfr_t point;
+    mpfr_t term;
+    mpfr_init2(point, job->level ? job->working : (mpfr_prec_t)(sizeof(long) * CHAR_BIT));
+    mpfr_init2(term, job->working);
+
+    int ok = eval_context_bind(ctx, job->name, point);
+    if (!ok)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+    }
+    else
+    {
+        ok = job->level ? reduce_quadrature_block(ctx, job, block, point, term, depth)
+                        : reduce_sum_block(ctx, job, block, point, term, depth);
+        eval_context_unbind(ctx);
+    }
+
+    mpfr_clear(point);
+    mpfr_clear(term);
+    return ok;
+}
+
+// Record a failed block, keeping the first one's error
+static void reduce_fail(ReduceJob *job, long block, const char *error, int budget_exceeded)
+{
+    pthread_mutex_lock(&job->lock);
+    if (block < job->failed)
+    {
+        job->failed = block;
+        snprintf(job->error, sizeof(job->error), "%s", error);
+        job->budget_exceeded = budget_exceeded;
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+// Set up a worker's context like the caller's: the same settings and
+// working precision, the bindings of the enclosing reductions and its own
+// copy of the variables, since evaluating a definition stores its value
+static int reduce_worker_init(ReduceWorker *worker, const EvalContext *settings)
+{
+    EvalContext *ctx = &worker->ctx;
+    eval_context_init(ctx, settings->precision);
+    ctx->rounding = settings->rounding;
+    ctx->strict_mode = settings->strict_mode;
+    ctx->strict_domain = settings->strict_domain;
+    ctx->native = settings->native;
+    ctx->exact = settings->exact;
+    ctx->budget = settings->budget;
+    ctx->budget_active = settings->budget_active;
+    ctx->budget_operations = settings->budget_operations;
+    ctx->budget_deadline = settings->budget_deadline;
+    ctx->cancel = settings->cancel;
+
+    // The pool is empty, so its levels are made at this precision
+    ctx->scratch_precision = settings->scratch_precision;
+
+    worker->variables =
+        settings->variables ? variables_copy(settings->variables) : variables_create();
+    ctx->variables = worker->variables;
+    if (!worker->variables)
+    {
+        return 0;
+    }
+    for (int i = 0; i < settings->binding_count; i++)
+    {
+        if (!eval_context_bind(ctx, settings->bindings[i].name, settings->bindings[i].value))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void *reduce_thread(void *arg)
+{
+    ReduceWorker *worker = arg;
+    ReduceJob *job = worker->job;
+    reduce_on_worker = 1;
+    int ready = reduce_worker_init(worker, job->ctx);
+
+    for (;;)
+    {
+        long block = atomic_fetch_add(&job->next, 1);
+        pthread_mutex_lock(&job->lock);
+        int wanted = block < job->failed;
+        pthread_mutex_unlock(&job->lock);
+        if (!wanted)
+        {
+            break;
+        }
+        if (!ready)
+        {
+            reduce_fail(job, block, "Out of memory", 0);
+            break;
+        }
+        if (!reduce_block(&worker->ctx, job, block, 0))
+        {
+            reduce_fail(job, block, worker->ctx.error, worker->ctx.budget_exceeded);
+            break;
+        }
+    }
+
+    variables_destroy(worker->variables);
+    eval_context_cleanup(&worker->ctx);
+    formatter_cleanup();
+    evaluator_cleanup();
+    profile_merge_thread();
+    mpfr_free_cache();
+    return NULL;
+}
+
+// Run a job's blocks on worker threads; returns 0 if none could start
+static int reduce_run_parallel(ReduceJob *job, int threads)
+{
+    ReduceWorker *workers = calloc((size_t)threads, sizeof(ReduceWorker));
+    if (!workers)
+    {
+        return 0;
+    }
+    atomic_init(&job->next, 0);
+    pthread_mutex_init(&job->lock, NULL);
+    job->failed = job->blocks;
+
+    int started = 0;
+    while (started < threads)
+    {
+        workers[started].job = job;
+        if (pthread_create(&workers[started].thread, NULL, reduce_thread, &workers[started]) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    pthread_mutex_destroy(&job->lock);
+    free(workers);
+    return started > 0;
+}
+
+// Compute every block of a job, on worker threads when it is long enough;
+// returns 0 with the caller's error (or budget) set on failure
+static int reduce_run(ReduceJob *job, long points, int depth)
+{
+    EvalContext *ctx = job->ctx;
+    int threads = reduce_job_threads(job->blocks, points);
+    if (threads > 1 && reduce_run_parallel(job, threads))
+    {
+        if (job->failed == job->blocks)
+        {
+            return 1;
+        }
+        snprintf(ctx->error, sizeof(ctx->error), "%s", job->error);
+        ctx->budget_exceeded = job->budget_exceeded;
+        return 0;
+    }
+
+    for (long block = 0; block < job->blocks; block++)
+    {
+        if (!reduce_block(ctx, job, block, depth))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Add up the block sums and extra with one rounding, and their magnitudes
+// onto magnitude; returns 0 if out of memory
+static int reduce_total(mpfr_ptr total, const ReduceJob *job, mpfr_srcptr extra,
+                        mpfr_ptr magnitude, mpfr_rnd_t rounding)
+{
+    mpfr_ptr *terms = malloc((size_t)(job->blocks + 1) * sizeof(mpfr_ptr));
+    if (!terms)
+    {
+        return 0;
+    }
+    unsigned long count = 0;
+    for (long i = 0; i < job->blocks; i++)
+    {
+        terms[count++] = job->sums[i];
+        mpfr_add(magnitude, magnitude, job->magnitudes[i], MPFR_RNDU);
+    }
+    if (extra)
+    {
+        terms[count++] = (mpfr_ptr)extra;
+    }
+    mpfr_sum(total, terms, count, rounding);
+    free(terms);
+    return 1;
+}
+
+// Bits needed to write a positive count
+static mpfr_prec_t reduce_bits(long count)
+{
+    mpfr_prec_t bits = 0;
+    while (count > 0)
+    {
+        bits++;
+        count >>= 1;
+    }
+    return bits;
+}
+
+static int reduce_sum(ReduceJob *job, mpfr_t result, mpfr_srcptr from, mpfr_srcptr to,
+                      mpfr_prec_t precision, int depth, mpfr_exp_t *error)
+{
+    EvalContext *ctx = job->ctx;
+    if (!mpfr_integer_p(from) || !mpfr_integer_p(to))
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "sum bounds must be integers");
+        return 0;
+    }
+    if (!mpfr_fits_slong_p(from, MPFR_RNDN) || !mpfr_fits_slong_p(to, MPFR_RNDN))
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "sum bounds are out of range");
+        return 0;
+    }
+
+    job->first = mpfr_get_si(from, MPFR_RNDN);
+    job->last = mpfr_get_si(to, MPFR_RNDN);
+    if (job->last < job->first)
+    {
+        // An empty sum
+        mpfr_set_zero(result, 1);
+        *error = LONG_MIN;
+        return 1;
+    }
+    unsigned long span = (unsigned long)job->last - (unsigned long)job->first;
+    if (span >= LONG_MAX)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "sum has too many terms");
+        return 0;
+    }
+
+    // Every term is rounded once and added once, which the bits for the
+    // number of terms absorb
+    long count = (long)span + 1;
+    job->working = precision + REDUCE_GUARD_BITS + reduce_bits(count);
+    if (!reduce_job_blocks(job, (count - 1) / REDUCE_SUM_BLOCK + 1))
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+        return 0;
+    }
+
+    mpfr_t magnitude;
+    mpfr_init2(magnitude, REDUCE_MAGNITUDE_PRECISION);
+    mpfr_set_zero(magnitude, 1);
+    int ok = reduce_run(job, count, depth);
+    if (ok && !reduce_total(result, job, NULL, magnitude, ctx->rounding))
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+        ok = 0;
+    }
+    if (ok)
+    {
+        *error = mpfr_zero_p(magnitude) ? LONG_MIN : mpfr_get_exp(magnitude) - precision;
+    }
+    mpfr_clear(magnitude);
+    reduce_job_free_blocks(job);
+    return ok;
+}
+
+// Last quadrature level an integral may use. The error of level l falls
+// about as exp(-c 2^l), with c set by how close the integrand's
+// singularities come to the range, so each doubling of the precision
+// takes one more level for the same integrand.
+static int reduce_level_limit(mpfr_prec_t precision)
+{
+    int limit = REDUCE_BASE_LEVEL;
+    for (mpfr_prec_t bits = REDUCE_LEVEL_PRECISION; bits < precision && limit < REDUCE_MAX_LEVEL;
+         bits *= 2)
+    {
+        limit++;
+    }
+    return limit;
+}
+
+static int reduce_integrate(ReduceJob *job, mpfr_t result, mpfr_srcptr from, mpfr_srcptr to,
+                            mpfr_prec_t precision, int depth, mpfr_exp_t *error)
+{
+    EvalContext *ctx = job->ctx;
+    if (!mpfr_number_p(from) || !mpfr_number_p(to))
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "integrate bounds must be finite");
+        return 0;
+    }
+    if (mpfr_equal_p(from, to))
+    {
+        mpfr_set_zero(result, 1);
+        *error = LONG_MIN;
+        return 1;
+    }
+
+    // A level adds up thousands of values at most
+    job->working = precision + 2 * REDUCE_GUARD_BITS;
+    mpfr_t half, sum, next, estimate, previous, magnitude, scale;
+    mpfr_inits2(job->working, half, sum, next, estimate, previous, (mpfr_ptr)0);
+    mpfr_inits2(REDUCE_MAGNITUDE_PRECISION, magnitude, scale, (mpfr_ptr)0);
+    mpfr_sub(half, to, from, MPFR_RNDN);
+    mpfr_div_2ui(half, half, 1, MPFR_RNDN);
+    mpfr_set_zero(sum, 1);
+    mpfr_set_zero(magnitude, 1);
+    job->from = from;
+    job->to = to;
+    job->half = half;
+
+    // Each level halves the step, which for a well-behaved integrand about
+    // doubles the correct bits. Bits are counted against the integral of
+    // |f|, so that integrals that cancel out to zero converge too.
+    int ok = 1;
+    int converged = 0;
+    mpfr_exp_t last_gap = 0;
+    int last_level = reduce_level_limit(precision);
+    for (int index = 0; ok && !converged && index <= last_level; index++)
+    {
+        job->level = quadrature_level(job->working, index);
+        if (!job->level || !reduce_job_blocks(job, (job->level->count - 1) /
+                                                           REDUCE_QUADRATURE_BLOCK + 1))
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+            ok = 0;
+            break;
+        }
+        ok = reduce_run(job, 2 * job->level->count, depth);
+        if (ok && !reduce_total(next, job, sum, magnitude, MPFR_RNDN))
+        {
+            snprintf(ctx->error, sizeof(ctx->error), "Out of memory");
+            ok = 0;
+        }
+        reduce_job_free_blocks(job);
+        if (!ok)
+        {
+            break;
+        }
+        mpfr_swap(sum, next);
+
+        // The estimate is half h times the weighted sum so far
+        mpfr_mul(estimate, sum, half, MPFR_RNDN);
+        mpfr_div_2ui(estimate, estimate, (unsigned long)index, MPFR_RNDN);
+        mpfr_mul(scale, magnitude, half, MPFR_RNDU);
+        mpfr_abs(scale, scale, MPFR_RNDN);
+        mpfr_div_2ui(scale, scale, (unsigned long)index, MPFR_RNDU);
+        if (index > 0)
+        {
+            // Bits below the scale the last two estimates agree to
+            mpfr_sub(next, estimate, previous, MPFR_RNDN);
+            if (mpfr_zero_p(next) || mpfr_zero_p(scale))
+            {
+                converged = index >= 2;
+            }
+            else
+            {
+                mpfr_exp_t gap = mpfr_get_exp(next) - mpfr_get_exp(scale);
+                // Converged when the difference is already below the
+                // precision, or when the bits gained per level say the
+                // next difference (this estimate's error) will be
+                converged = index >= 2 &&
+                            (gap <= -(mpfr_exp_t)precision ||
+                             (index >= 3 && gap < last_gap &&
+                              2 * gap - last_gap <= -(mpfr_exp_t)precision));
+                last_gap = gap;
+            }
+        }
+        mpfr_swap(previous, estimate);
+    }
+
+    if (ok && !converged)
+    {
+        snprintf(ctx->error, sizeof(ctx->error),
+                 "integrate did not converge: split the range where the integrand has a "
+                 "kink, jump or singularity");
+        ok = 0;
+    }
+    if (ok)
+    {
+        mpfr_set(result, previous, ctx->rounding);
+        *error = mpfr_zero_p(scale) ? LONG_MIN : mpfr_get_exp(scale) - precision;
+    }
+
+    mpfr_clears(half, sum, next, estimate, previous, magnitude, scale, (mpfr_ptr)0);
+    return ok;
+}
+
+int reduce_eval(EvalContext *ctx, mpfr_t result, const ASTNode *call, mpfr_srcptr from,
+                mpfr_srcptr to, mpfr_prec_t precision, int depth, mpfr_exp_t *error)
+{
+    TokenType func_type = call->function.func_type;
+    if (call->function.arg_count != 4 || call->function.args[1]->type != NODE_VARIABLE)
+    {
+        snprintf(ctx->error, sizeof(ctx->error), "%s expects a variable as its second argument",
+                 function_table_get_name(func_type));
+        mpfr_set_nan(result);
+        return 0;
+    }
+
+    ReduceJob job;
+    memset(&job, 0, sizeof(job));
+    job.ctx = ctx;
+    job.body = call->function.args[0];
+    job.name = call->function.args[1]->variable.name;
+
+    int ok = func_type == TOKEN_SUM
+                 ? reduce_sum(&job, result, from, to, precision, depth, error)
+                 : reduce_integrate(&job, result, from, to, precision, depth, error);
+    if (!ok)
+    {
+        mpfr_set_nan(result);
+    }
+    return ok;
+}
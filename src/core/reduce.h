@@ -0,0 +1,89 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include "ast.h"
+#include <mpfr.h>
+
+typedef struct EvalContext EvalContext;
+
+/**
+ * Reductions over a bound variable: sum(expr, k, a, b) and
+ * integrate(expr, x, a, b)
+ *
+ * Both evaluate their body for many values of the variable they bind and
+ * add up the results. The points are split into fixed blocks, each summed
+ * in order, and the block sums are combined with one correctly rounded
+ * mpfr_sum(), so the result does not depend on how many threads computed
+ * the blocks or in what order they finished. Long reductions spread the
+ * blocks over worker threads; reductions inside a worker run on it.
+ *
+ * Integrals use tanh-sinh quadrature, which converges quickly for
+ * integrands analytic inside the range, including ones singular at the
+ * ends. Points near a nonzero end are only as close to it as the working
+ * precision allows, so a singularity there is best shifted to zero, as in
+ * integrate(1/sqrt(t), t, 0, 1) for integrate(1/sqrt(1 - x), x, 0, 1). The step is halved until two successive estimates agree to the
+ * requested precision. Nodes and weights are computed once per precision
+ * class and reused by every later integral.
+ */
+
+// Terms of a sum, or quadrature nodes, summed as one block
+#define REDUCE_SUM_BLOCK 256
+#define REDUCE_QUADRATURE_BLOCK 64
+
+// Bits a reduction computes beyond the user's precision; sums also carry
+// enough bits to absorb the rounding of every term
+#define REDUCE_GUARD_BITS 16
+
+// Quadrature levels, each halving the step of the one before. Integrals
+// at up to REDUCE_LEVEL_PRECISION bits stop after level REDUCE_BASE_LEVEL;
+// every doubling of the precision above it allows one more level, up to
+// REDUCE_MAX_LEVEL.
+#define REDUCE_BASE_LEVEL 12
+#define REDUCE_LEVEL_PRECISION 128
+#define REDUCE_MAX_LEVEL 16
+
+// Points below which a reduction stays on the calling thread
+#define REDUCE_PARALLEL_MIN 512
+
+// Worker threads at most
+#define REDUCE_MAX_THREADS 64
+
+/**
+ * Evaluate a sum() or integrate() call
+ * The bound variable is visible to the body only: the definitions of
+ * table variables the body reads do not see it.
+ * @param ctx Context of the evaluation under way; errors are stored in it
+ * @param result Output variable, rounded in the context's rounding mode
+ * @param call Function node whose first argument is the body and second
+ *             the bound variable
+ * @param from Lower bound (an integer for sums)
+ * @param to Upper bound (an integer for sums)
+ * @param precision Bits the value should be accurate to
+ * @param depth First scratch level the body may use
+ * @param error Output: e such that the result is within 2^e of the exact
+ *              value, LONG_MIN if it is exact (valid on success)
+ * @return 1 on success, 0 on error
+ */
+int reduce_eval(EvalContext *ctx, mpfr_t result, const ASTNode *call, mpfr_srcptr from,
+                mpfr_srcptr to, mpfr_prec_t precision, int depth, mpfr_exp_t *error);
+
+/**
+ * Set the number of threads long reductions use
+ * @param threads Thread count, or 0 for one per online processor
+ *                (capped at REDUCE_MAX_THREADS)
+ */
+void reduce_set_threads(int threads);
+
+/**
+ * Get the thread setting of reductions
+ * @return Thread count, 0 for one per online processor
+ */
+int reduce_get_threads(void);
+
+/**
+ * Release the cached quadrature nodes
+ * No reduction may be running.
+ */
+void reduce_cleanup(void);
+
+#endif // REDUCE_H
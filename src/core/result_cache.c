@@ -0,0 +1,534 @@
+#include "result_cache.h"
+#include "context.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Tags separating the parts of a key
+enum
+{
+    KEY_NUMBER = 1,
+    KEY_CONSTANT,
+    KEY_BINOP,
+    KEY_UNARY,
+    KEY_FUNCTION,
+    KEY_NULL,
+    KEY_NARY
+};
+
+// Classes of a literal value
+enum
+{
+    KEY_VALUE_NAN,
+    KEY_VALUE_INF,
+    KEY_VALUE_ZERO,
+    KEY_VALUE_REGULAR
+};
+
+typedef struct CacheEntry CacheEntry;
+
+struct CacheEntry
+{
+    uint64_t hash;
+    unsigned char *key;
+    size_t key_length;
+    mpfr_t value;
+    size_t bytes;            // Memory charged to this entry
+    CacheEntry *bucket_next; // Next entry in the same hash bucket
+    CacheEntry *newer;       // LRU neighbours; the list runs oldest to newest
+    CacheEntry *older;
+};
+
+// Process-wide cache shared by all threads and contexts
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static CacheEntry **buckets = NULL;
+static size_t bucket_count = 0;
+static size_t entry_count = 0;
+static CacheEntry *oldest = NULL;
+static CacheEntry *newest = NULL;
+static size_t used_bytes = 0;
+static size_t capacity = 0;
+static unsigned long hits = 0;
+static unsigned long misses = 0;
+static unsigned long evictions = 0;
+
+// Lock-free fast path for the disabled cache
+static atomic_int cache_enabled = 0;
+
+static void key_put(ResultCacheKey *key, const void *data, size_t length)
+{
+    if (!key->valid)
+    {
+        return;
+    }
+
+    if (key->length + length > key->capacity)
+    {
+        size_t new_capacity = key->capacity * 2;
+        while (new_capacity < key->length + length)
+        {
+            new_capacity *= 2;
+        }
+
+        unsigned char *new_bytes = key->bytes == key->inline_bytes
+                                       ? malloc(new_capacity)
+                                       : realloc(key->bytes, new_capacity);
+        if (!new_bytes)
+        {
+            key->valid = 0;
+            return;
+        }
+        if (key->bytes == key->inline_bytes)
+        {
+            memcpy(new_bytes, key->inline_bytes, key->length);
+        }
+        key->bytes = new_bytes;
+        key->capacity = new_capacity;
+    }
+
+    memcpy(key->bytes + key->length, data, length);
+    key->length += length;
+}
+
+static void key_put_tag(ResultCacheKey *key, unsigned char tag)
+{
+    key_put(key, &tag, 1);
+}
+
+static void key_put_long(ResultCacheKey *key, long value)
+{
+    key_put(key, &value, sizeof(value));
+}
+
+static void key_put_value(ResultCacheKey *key, mpfr_srcptr value)
+{
+    mpfr_prec_t precision = mpfr_get_prec(value);
+    key_put_long(key, (long)precision);
+
+    if (mpfr_nan_p(value))
+    {
+        key_put_tag(key, KEY_VALUE_NAN);
+        return;
+    }
+
+    key_put_tag(key, mpfr_inf_p(value) ? KEY_VALUE_INF
+                                       : mpfr_zero_p(value) ? KEY_VALUE_ZERO : KEY_VALUE_REGULAR);
+    key_put_tag(key, (unsigned char)mpfr_signbit(value));
+
+    if (mpfr_regular_p(value))
+    {
+        // Bits below the precision are always zero, so whole limbs compare
+        key_put_long(key, (long)mpfr_get_exp(value));
+        key_put(key, mpfr_custom_get_significand(value), mpfr_custom_get_size(precision));
+    }
+}
+
+static void key_put_node(ResultCacheKey *key, const EvalContext *ctx, const ASTNode *node)
+{
+    if (!node)
+    {
+        key_put_tag(key, KEY_NULL);
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        if (node->number.literal->folded_from &&
+            node->number.literal->folded_precision != ctx->precision)
+        {
+            // The evaluator ignores stale folds, and so does the key
+            key_put_node(key, ctx, node->number.literal->folded_from);
+            return;
+        }
+        key_put_tag(key, KEY_NUMBER);
+        key_put_value(key, node->number.literal->value);
+        break;
+
+    case NODE_CONSTANT:
+    {
+        size_t length = node->constant.name ? strlen(node->constant.name) : 0;
+        key_put_tag(key, KEY_CONSTANT);
+        key_put_long(key, (long)length);
+        key_put(key, node->constant.name, length);
+        break;
+    }
+
+    case NODE_BINOP:
+        key_put_tag(key, KEY_BINOP);
+        key_put_long(key, node->binop.op);
+        key_put_node(key, ctx, node->binop.left);
+        key_put_node(key, ctx, node->binop.right);
+        break;
+
+    case NODE_UNARY:
+        key_put_tag(key, KEY_UNARY);
+        key_put_long(key, node->unary.op);
+        key_put_node(key, ctx, node->unary.operand);
+        break;
+
+    case NODE_FUNCTION:
+        key_put_tag(key, KEY_FUNCTION);
+        key_put_long(key, node->function.func_type);
+        key_put_long(key, node->function.arg_count);
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            key_put_node(key, ctx, node->function.args[i]);
+        }
+        break;
+
+    case NODE_NARY:
+        key_put_tag(key, KEY_NARY);
+        key_put_long(key, node->nary.op);
+        key_put_long(key, node->nary.count);
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            key_put_node(key, ctx, node->nary.operands[i]);
+        }
+        break;
+
+    case NODE_VARIABLE:
+        // Definitions can change between evaluations
+        key->valid = 0;
+        break;
+
+    default:
+        // Unknown nodes produce errors, which are never cached
+        key->valid = 0;
+        break;
+    }
+}
+
+// 64-bit FNV-1a
+static uint64_t key_hash(const unsigned char *bytes, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void result_cache_key_build(ResultCacheKey *key, const EvalContext *ctx, const ASTNode *node,
+                            mpfr_prec_t result_precision)
+{
+    key->bytes = key->inline_bytes;
+    key->length = 0;
+    key->capacity = sizeof(key->inline_bytes);
+    key->hash = 0;
+    key->valid = 1;
+
+    key_put_long(key, (long)ctx->precision);
+    key_put_long(key, (long)ctx->rounding);
+    key_put_long(key, (long)result_precision);
+    key_put_tag(key, (unsigned char)(ctx->strict_mode ? 1 : 0));
+    key_put_tag(key, (unsigned char)(ctx->strict_domain ? 1 : 0));
+    key_put_tag(key, (unsigned char)(ctx->adaptive ? 1 : 0));
+    key_put_tag(key, (unsigned char)(ctx->native ? 1 : 0));
+    key_put_tag(key, (unsigned char)(ctx->exact ? 1 : 0));
+    key_put_node(key, ctx, node);
+
+    if (key->valid)
+    {
+        key->hash = key_hash(key->bytes, key->length);
+    }
+}
+
+void result_cache_key_free(ResultCacheKey *key)
+{
+    if (key->bytes != key->inline_bytes)
+    {
+        free(key->bytes);
+    }
+    key->bytes = key->inline_bytes;
+    key->length = 0;
+}
+
+// Everything below runs with cache_lock held
+
+static void lru_unlink(CacheEntry *entry)
+{
+    if (entry->older)
+        entry->older->newer = entry->newer;
+    else
+        oldest = entry->newer;
+    if (entry->newer)
+        entry->newer->older = entry->older;
+    else
+        newest = entry->older;
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+static void lru_push_newest(CacheEntry *entry)
+{
+    entry->older = newest;
+    entry->newer = NULL;
+    if (newest)
+        newest->newer = entry;
+    else
+        oldest = entry;
+    newest = entry;
+}
+
+static void entry_free(CacheEntry *entry)
+{
+    mpfr_clear(entry->value);
+    free(entry->key);
+    free(entry);
+}
+
+static void entry_remove(CacheEntry *entry)
+{
+    CacheEntry **link = &buckets[entry->hash & (bucket_count - 1)];
+    while (*link != entry)
+    {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+
+    lru_unlink(entry);
+    used_bytes -= entry->bytes;
+    entry_count--;
+    entry_free(entry);
+}
+
+static void evict_to(size_t limit)
+{
+    while (oldest && used_bytes > limit)
+    {
+        entry_remove(oldest);
+        evictions++;
+    }
+}
+
+static CacheEntry *find_entry(const ResultCacheKey *key)
+{
+    if (!buckets)
+    {
+        return NULL;
+    }
+
+    for (CacheEntry *entry = buckets[key->hash & (bucket_count - 1)]; entry;
+         entry = entry->bucket_next)
+    {
+        if (entry->hash == key->hash && entry->key_length == key->length &&
+            memcmp(entry->key, key->bytes, key->length) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Keep at most one entry per bucket on average
+static int grow_buckets(void)
+{
+    if (buckets && entry_count < bucket_count)
+    {
+        return 1;
+    }
+
+    size_t new_count = bucket_count ? bucket_count * 2 : 256;
+    CacheEntry **new_buckets = calloc(new_count, sizeof(CacheEntry *));
+    if (!new_buckets)
+    {
+        return buckets != NULL;
+    }
+
+    for (size_t i = 0; i < bucket_count; i++)
+    {
+        CacheEntry *entry = buckets[i];
+        while (entry)
+        {
+            CacheEntry *next = entry->bucket_next;
+            CacheEntry **head = &new_buckets[entry->hash & (new_count - 1)];
+            entry->bucket_next = *head;
+            *head = entry;
+            entry = next;
+        }
+    }
+
+    free(buckets);
+    buckets = new_buckets;
+    bucket_count = new_count;
+    return 1;
+}
+
+static void clear_locked(void)
+{
+    CacheEntry *entry = oldest;
+    while (entry)
+    {
+        CacheEntry *next = entry->newer;
+        entry_free(entry);
+        entry = next;
+    }
+    oldest = NULL;
+    newest = NULL;
+    entry_count = 0;
+    used_bytes = 0;
+    if (buckets)
+    {
+        memset(buckets, 0, bucket_count * sizeof(CacheEntry *));
+    }
+}
+
+void result_cache_set_capacity(size_t bytes)
+{
+    pthread_mutex_lock(&cache_lock);
+    capacity = bytes;
+    if (capacity == 0)
+    {
+        clear_locked();
+        free(buckets);
+        buckets = NULL;
+        bucket_count = 0;
+    }
+    else
+    {
+        evict_to(capacity);
+    }
+    cache_enabled = capacity > 0;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+int result_cache_enabled(void)
+{
+    return cache_enabled;
+}
+
+int result_cache_lookup(const ResultCacheKey *key, mpfr_t result)
+{
+    if (!key->valid)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    CacheEntry *entry = find_entry(key);
+    if (entry)
+    {
+        lru_unlink(entry);
+        lru_push_newest(entry);
+        // The key fixes the result precision, so this copy is exact
+        mpfr_set(result, entry->value, MPFR_RNDN);
+        hits++;
+    }
+    else
+    {
+        misses++;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return entry != NULL;
+}
+
+void result_cache_store(const ResultCacheKey *key, const mpfr_t value)
+{
+    if (!key->valid)
+    {
+        return;
+    }
+
+    mpfr_prec_t precision = mpfr_get_prec(value);
+    size_t bytes = sizeof(CacheEntry) + key->length + mpfr_custom_get_size(precision);
+
+    pthread_mutex_lock(&cache_lock);
+    if (bytes > capacity || find_entry(key) || !grow_buckets())
+    {
+        pthread_mutex_unlock(&cache_lock);
+        return;
+    }
+
+    CacheEntry *entry = malloc(sizeof(CacheEntry));
+    unsigned char *key_copy = malloc(key->length);
+    if (!entry || !key_copy)
+    {
+        free(entry);
+        free(key_copy);
+        pthread_mutex_unlock(&cache_lock);
+        return;
+    }
+
+    memcpy(key_copy, key->bytes, key->length);
+    entry->hash = key->hash;
+    entry->key = key_copy;
+    entry->key_length = key->length;
+    entry->bytes = bytes;
+    mpfr_init2(entry->value, precision);
+    mpfr_set(entry->value, value, MPFR_RNDN);
+
+    evict_to(capacity - bytes);
+
+    CacheEntry **head = &buckets[entry->hash & (bucket_count - 1)];
+    entry->bucket_next = *head;
+    *head = entry;
+    lru_push_newest(entry);
+    used_bytes += bytes;
+    entry_count++;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void result_cache_clear(void)
+{
+    pthread_mutex_lock(&cache_lock);
+    clear_locked();
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void result_cache_get_stats(ResultCacheStats *stats)
+{
+    pthread_mutex_lock(&cache_lock);
+    stats->hits = hits;
+    stats->misses = misses;
+    stats->evictions = evictions;
+    stats->entries = entry_count;
+    stats->bytes = used_bytes;
+    stats->capacity = capacity;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void result_cache_reset_stats(void)
+{
+    pthread_mutex_lock(&cache_lock);
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void result_cache_print_stats(void)
+{
+    ResultCacheStats stats;
+    result_cache_get_stats(&stats);
+
+    if (stats.capacity == 0)
+    {
+        printf("Result cache: off\n");
+    }
+    else
+    {
+        // Rounded up, so a cache holding anything never reads as empty
+        printf("Result cache: %zu entries, %zu of %zu KiB used\n", stats.entries,
+               (stats.bytes + 1023) / 1024, stats.capacity / 1024);
+        printf("Exact integer and rational results are not cached: the exact tier "
+               "recomputes them\n");
+    }
+
+    unsigned long lookups = stats.hits + stats.misses;
+    printf("Hits: %lu  Misses: %lu  Evictions: %lu", stats.hits, stats.misses, stats.evictions);
+    if (lookups > 0)
+    {
+        printf("  (hit rate %.1f%%)", 100.0 * stats.hits / lookups);
+    }
+    printf("\n");
+}
+
+void result_cache_cleanup(void)
+{
+    result_cache_set_capacity(0);
+}
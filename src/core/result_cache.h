@@ -0,0 +1,115 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "ast.h"
+#include <mpfr.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct EvalContext EvalContext;
+
+// Bytes of key kept inline before a key spills to the heap
+#define RESULT_CACHE_INLINE_KEY 256
+
+/**
+ * Canonical form of one evaluation: the tree's structure, literal limbs and
+ * constant names plus every setting that can change the result (context
+ * precision, rounding, strict, adaptive and native flags and result precision).
+ */
+typedef struct
+{
+    unsigned char *bytes;
+    size_t length;
+    size_t capacity;
+    uint64_t hash;
+    int valid; // 0 if the key could not be built
+    unsigned char inline_bytes[RESULT_CACHE_INLINE_KEY];
+} ResultCacheKey;
+
+/**
+ * Cache usage counters
+ */
+typedef struct
+{
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    size_t entries;
+    size_t bytes;    // Memory charged to cached entries
+    size_t capacity; // Memory cap, 0 when the cache is off
+} ResultCacheStats;
+
+/**
+ * Set the memory cap of the result cache
+ * The cache starts disabled. Shrinking the cap evicts least recently used
+ * entries; a cap of 0 disables the cache and frees it.
+ * @param bytes Maximum memory for cached results, 0 to disable
+ */
+void result_cache_set_capacity(size_t bytes);
+
+/**
+ * Check whether the result cache is enabled
+ * @return 1 if enabled, 0 otherwise
+ */
+int result_cache_enabled(void);
+
+/**
+ * Build the cache key for evaluating a tree
+ * @param key Key to fill in (release with result_cache_key_free())
+ * @param ctx Context the tree is evaluated in
+ * @param node Tree to evaluate
+ * @param result_precision Precision of the caller's result variable
+ */
+void result_cache_key_build(ResultCacheKey *key, const EvalContext *ctx, const ASTNode *node,
+                            mpfr_prec_t result_precision);
+
+/**
+ * Free any heap memory held by a key
+ * @param key Key to release
+ */
+void result_cache_key_free(ResultCacheKey *key);
+
+/**
+ * Look up a result and mark it most recently used
+ * @param key Key built by result_cache_key_build()
+ * @param result Output variable, set only on a hit
+ * @return 1 on a hit, 0 on a miss
+ */
+int result_cache_lookup(const ResultCacheKey *key, mpfr_t result);
+
+/**
+ * Store a result, evicting least recently used entries to stay under the cap
+ * @param key Key built by result_cache_key_build()
+ * @param value Result to store
+ */
+void result_cache_store(const ResultCacheKey *key, const mpfr_t value);
+
+/**
+ * Drop every cached result (counters are kept)
+ */
+void result_cache_clear(void);
+
+/**
+ * Get the cache counters
+ * @param stats Output counters
+ */
+void result_cache_get_stats(ResultCacheStats *stats);
+
+/**
+ * Reset the hit, miss and eviction counters
+ */
+void result_cache_reset_stats(void);
+
+/**
+ * Print cache counters
+ * Memory is shown in KiB, rounded up. Results of the exact tier never
+ * reach the cache (see evaluator_eval_ctx()), which the status says.
+ */
+void result_cache_print_stats(void);
+
+/**
+ * Free the cache and disable it
+ */
+void result_cache_cleanup(void);
+
+#endif // RESULT_CACHE_H
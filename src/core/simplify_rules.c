@@ -0,0 +1,1002 @@
+#include "simplify_rules.h"
+#include "rational.h"
+#include "precision.h"
+#include "constants.h"
+#include <gmp.h>
+#include <pthread.h>
+#include <stddef.h>
+
+// Radicands up to this are searched for square factors by trial division
+#define RULE_SQRT_MAX_RADICAND 1000000000000UL
+
+// Rules see their node as const; results may share its children
+static ASTNode *rule_ref(const ASTNode *node)
+{
+    ASTNode *shared = (ASTNode *)node;
+    shared->refs++;
+    return shared;
+}
+
+static ASTNode *rule_binop(Simplifier *simplifier, TokenType op, ASTNode *left, ASTNode *right)
+{
+    return symbolic_intern(simplifier, ast_create_binop(op, left, right));
+}
+
+static ASTNode *rule_unary(Simplifier *simplifier, TokenType op, ASTNode *operand)
+{
+    return symbolic_intern(simplifier, ast_create_unary(op, operand));
+}
+
+static ASTNode *rule_call(Simplifier *simplifier, TokenType func_type, ASTNode *arg)
+{
+    ASTNode **args = arg ? ast_create_args(NULL, 1) : NULL;
+    if (!args)
+    {
+        ast_free(arg);
+        return symbolic_intern(simplifier, NULL);
+    }
+    args[0] = arg;
+    return symbolic_intern(simplifier, ast_create_function(func_type, args, 1));
+}
+
+// Exact numbers
+
+// An integer literal, exactly as parsed
+static int rule_integer(const ASTNode *node, mpz_t value)
+{
+    if (node->type != NODE_NUMBER || !node->exact || node->number.literal->folded_from ||
+        !mpfr_integer_p(node->number.literal->value))
+    {
+        return 0;
+    }
+    mpfr_get_z(value, node->number.literal->value, MPFR_RNDN);
+    return 1;
+}
+
+// A rational in the form rules build: an integer, or n/d in lowest terms
+// with d > 1
+static int rule_rational(const ASTNode *node, mpq_t value)
+{
+    if (rule_integer(node, mpq_numref(value)))
+    {
+        mpz_set_ui(mpq_denref(value), 1);
+        return 1;
+    }
+    if (node->type != NODE_BINOP || node->binop.op != TOKEN_SLASH ||
+        !rule_integer(node->binop.left, mpq_numref(value)) ||
+        !rule_integer(node->binop.right, mpq_denref(value)) ||
+        mpz_cmp_ui(mpq_denref(value), 1) <= 0)
+    {
+        return 0;
+    }
+
+    mpz_t gcd;
+    mpz_init(gcd);
+    mpz_gcd(gcd, mpq_numref(value), mpq_denref(value));
+    int lowest = mpz_cmp_ui(gcd, 1) == 0;
+    mpz_clear(gcd);
+    return lowest;
+}
+
+static int rule_is_rational(const ASTNode *node)
+{
+    mpq_t value;
+    mpq_init(value);
+    int rational = rule_rational(node, value);
+    mpq_clear(value);
+    return rational;
+}
+
+static int rule_is_integer_value(const ASTNode *node, long expected)
+{
+    mpz_t value;
+    mpz_init(value);
+    int match = rule_integer(node, value) && mpz_cmp_si(value, expected) == 0;
+    mpz_clear(value);
+    return match;
+}
+
+static int rule_is_zero(const ASTNode *node)
+{
+    return rule_is_integer_value(node, 0);
+}
+
+static int rule_is_one(const ASTNode *node)
+{
+    return rule_is_integer_value(node, 1);
+}
+
+static ASTNode *rule_make_integer(Simplifier *simplifier, const mpz_t value)
+{
+    // Wide enough that the literal holds the integer exactly
+    size_t bits = mpz_sizeinbase(value, 2);
+    mpfr_prec_t precision = bits > (size_t)global_precision ? (mpfr_prec_t)bits : global_precision;
+    ASTNode *node = ast_create_number_at(NULL, "0", 1, precision);
+    if (node)
+    {
+        mpfr_set_z(node->number.literal->value, value, MPFR_RNDN);
+    }
+    return symbolic_intern(simplifier, node);
+}
+
+static ASTNode *rule_make_rational(Simplifier *simplifier, const mpq_t value)
+{
+    if (mpz_cmp_ui(mpq_denref(value), 1) == 0)
+    {
+        return rule_make_integer(simplifier, mpq_numref(value));
+    }
+    return rule_binop(simplifier, TOKEN_SLASH, rule_make_integer(simplifier, mpq_numref(value)),
+                      rule_make_integer(simplifier, mpq_denref(value)));
+}
+
+static ASTNode *rule_make_small(Simplifier *simplifier, long value)
+{
+    mpz_t integer;
+    mpz_init_set_si(integer, value);
+    ASTNode *node = rule_make_integer(simplifier, integer);
+    mpz_clear(integer);
+    return node;
+}
+
+// Split a term into its rational coefficient and the rest: q*x gives q
+// and x, -x gives -1 and x, anything else 1 and itself. A rational alone
+// has no rest and gives NULL.
+static const ASTNode *rule_term(const ASTNode *node, mpq_t coefficient)
+{
+    if (rule_rational(node, coefficient))
+    {
+        return NULL;
+    }
+    if (node->type == NODE_BINOP && node->binop.op == TOKEN_STAR &&
+        rule_rational(node->binop.left, coefficient))
+    {
+        return node->binop.right;
+    }
+    if (node->type == NODE_UNARY && node->unary.op == TOKEN_MINUS)
+    {
+        mpq_set_si(coefficient, -1, 1);
+        return node->unary.operand;
+    }
+    mpq_set_ui(coefficient, 1, 1);
+    return node;
+}
+
+// coefficient * term, with the trivial cases folded and -1 written as a
+// negation (takes term)
+static ASTNode *rule_scale(Simplifier *simplifier, const mpq_t coefficient, ASTNode *term)
+{
+    if (mpq_sgn(coefficient) == 0)
+    {
+        ast_free(term);
+        return rule_make_small(simplifier, 0);
+    }
+    if (mpq_cmp_ui(coefficient, 1, 1) == 0)
+    {
+        return term;
+    }
+    if (mpq_cmp_si(coefficient, -1, 1) == 0)
+    {
+        return rule_unary(simplifier, TOKEN_MINUS, term);
+    }
+    return rule_binop(simplifier, TOKEN_STAR, rule_make_rational(simplifier, coefficient), term);
+}
+
+// Integer and rational arithmetic
+
+// Compute an exact subtree; its parts are rationals already, so this is
+// one operation
+static ASTNode *rule_fold(Simplifier *simplifier, const ASTNode *node)
+{
+    if (!node->exact)
+    {
+        return NULL;
+    }
+    mpq_t value;
+    mpq_init(value);
+    ASTNode *result = NULL;
+    if (!rule_rational(node, value) && rational_eval(value, node))
+    {
+        result = rule_make_rational(simplifier, value);
+    }
+    mpq_clear(value);
+    return result;
+}
+
+// Sums and differences
+
+// x + 0 -> x, 0 + x -> x
+static ASTNode *rule_add_zero(Simplifier *simplifier, const ASTNode *node)
+{
+    (void)simplifier;
+    if (rule_is_zero(node->binop.right))
+    {
+        return rule_ref(node->binop.left);
+    }
+    if (rule_is_zero(node->binop.left))
+    {
+        return rule_ref(node->binop.right);
+    }
+    return NULL;
+}
+
+// x - 0 -> x, 0 - x -> -x
+static ASTNode *rule_sub_zero(Simplifier *simplifier, const ASTNode *node)
+{
+    if (rule_is_zero(node->binop.right))
+    {
+        return rule_ref(node->binop.left);
+    }
+    if (rule_is_zero(node->binop.left))
+    {
+        return rule_unary(simplifier, TOKEN_MINUS, rule_ref(node->binop.right));
+    }
+    return NULL;
+}
+
+// a*x + b*x -> (a+b)*x, a*x - b*x -> (a-b)*x; covers x + x and x - x
+static ASTNode *rule_like_terms(Simplifier *simplifier, const ASTNode *node)
+{
+    mpq_t a, b;
+    mpq_init(a);
+    mpq_init(b);
+    const ASTNode *x = rule_term(node->binop.left, a);
+    const ASTNode *y = rule_term(node->binop.right, b);
+
+    ASTNode *result = NULL;
+    if (x && x == y)
+    {
+        if (node->binop.op == TOKEN_PLUS)
+        {
+            mpq_add(a, a, b);
+        }
+        else
+        {
+            mpq_sub(a, a, b);
+        }
+        result = rule_scale(simplifier, a, rule_ref(x));
+    }
+    mpq_clear(a);
+    mpq_clear(b);
+    return result;
+}
+
+// x + (-q)*y -> x - q*y, x - (-q)*y -> x + q*y, and the same for -q alone
+static ASTNode *rule_sum_sign(Simplifier *simplifier, const ASTNode *node)
+{
+    mpq_t q;
+    mpq_init(q);
+    const ASTNode *y = rule_term(node->binop.right, q);
+    ASTNode *result = NULL;
+    if (mpq_sgn(q) < 0)
+    {
+        mpq_neg(q, q);
+        TokenType op = node->binop.op == TOKEN_PLUS ? TOKEN_MINUS : TOKEN_PLUS;
+        ASTNode *right = y ? rule_scale(simplifier, q, rule_ref(y)) : rule_make_rational(simplifier, q);
+        result = rule_binop(simplifier, op, rule_ref(node->binop.left), right);
+    }
+    mpq_clear(q);
+    return result;
+}
+
+// (x + p) + q -> x + (p+q), and likewise with minus signs
+static ASTNode *rule_sum_constants(Simplifier *simplifier, const ASTNode *node)
+{
+    const ASTNode *inner = node->binop.left;
+    if (inner->type != NODE_BINOP ||
+        (inner->binop.op != TOKEN_PLUS && inner->binop.op != TOKEN_MINUS))
+    {
+        return NULL;
+    }
+
+    mpq_t p, q;
+    mpq_init(p);
+    mpq_init(q);
+    ASTNode *result = NULL;
+    if (rule_rational(inner->binop.right, p) && rule_rational(node->binop.right, q))
+    {
+        if (inner->binop.op == TOKEN_MINUS)
+        {
+            mpq_neg(p, p);
+        }
+        if (node->binop.op == TOKEN_MINUS)
+        {
+            mpq_neg(q, q);
+        }
+        mpq_add(p, p, q);
+        result = rule_binop(simplifier, TOKEN_PLUS, rule_ref(inner->binop.left),
+                            rule_make_rational(simplifier, p));
+    }
+    mpq_clear(p);
+    mpq_clear(q);
+    return result;
+}
+
+// Products
+
+// x * 0 -> 0, 0 * x -> 0
+static ASTNode *rule_mul_zero(Simplifier *simplifier, const ASTNode *node)
+{
+    if (rule_is_zero(node->binop.left) || rule_is_zero(node->binop.right))
+    {
+        return rule_make_small(simplifier, 0);
+    }
+    return NULL;
+}
+
+// x * 1 -> x, 1 * x -> x
+static ASTNode *rule_mul_one(Simplifier *simplifier, const ASTNode *node)
+{
+    (void)simplifier;
+    if (rule_is_one(node->binop.right))
+    {
+        return rule_ref(node->binop.left);
+    }
+    if (rule_is_one(node->binop.left))
+    {
+        return rule_ref(node->binop.right);
+    }
+    return NULL;
+}
+
+// x * q -> q * x: coefficients go first
+static ASTNode *rule_mul_order(Simplifier *simplifier, const ASTNode *node)
+{
+    if (!rule_is_rational(node->binop.right) || rule_is_rational(node->binop.left))
+    {
+        return NULL;
+    }
+    return rule_binop(simplifier, TOKEN_STAR, rule_ref(node->binop.right),
+                      rule_ref(node->binop.left));
+}
+
+// p * (q*x) -> (pq)*x, (p*x) * (q*y) -> (pq)*(x*y)
+static ASTNode *rule_mul_coefficients(Simplifier *simplifier, const ASTNode *node)
+{
+    mpq_t a, b;
+    mpq_init(a);
+    mpq_init(b);
+    ASTNode *result = NULL;
+
+    if (rule_rational(node->binop.left, a))
+    {
+        const ASTNode *y = rule_term(node->binop.right, b);
+        if (y && mpq_cmp_ui(b, 1, 1) != 0)
+        {
+            mpq_mul(a, a, b);
+            result = rule_scale(simplifier, a, rule_ref(y));
+        }
+    }
+    else
+    {
+        const ASTNode *x = rule_term(node->binop.left, a);
+        const ASTNode *y = rule_term(node->binop.right, b);
+        if (x && y && (mpq_cmp_ui(a, 1, 1) != 0 || mpq_cmp_ui(b, 1, 1) != 0))
+        {
+            mpq_mul(a, a, b);
+            result = rule_scale(simplifier, a,
+                                rule_binop(simplifier, TOKEN_STAR, rule_ref(x), rule_ref(y)));
+        }
+    }
+
+    mpq_clear(a);
+    mpq_clear(b);
+    return result;
+}
+
+// A power's base and rational exponent: x^q gives x and q, x gives x and 1
+static const ASTNode *rule_power(const ASTNode *node, mpq_t exponent)
+{
+    if (node->type == NODE_BINOP && node->binop.op == TOKEN_CARET &&
+        rule_rational(node->binop.right, exponent))
+    {
+        return node->binop.left;
+    }
+    mpq_set_ui(exponent, 1, 1);
+    return node;
+}
+
+// x^a * x^b -> x^(a+b); covers x * x -> x^2
+static ASTNode *rule_mul_powers(Simplifier *simplifier, const ASTNode *node)
+{
+    mpq_t a, b;
+    mpq_init(a);
+    mpq_init(b);
+    const ASTNode *x = rule_power(node->binop.left, a);
+    const ASTNode *y = rule_power(node->binop.right, b);
+
+    ASTNode *result = NULL;
+    if (x == y && !rule_is_rational(x))
+    {
+        mpq_add(a, a, b);
+        result = rule_binop(simplifier, TOKEN_CARET, rule_ref(x), rule_make_rational(simplifier, a));
+    }
+    mpq_clear(a);
+    mpq_clear(b);
+    return result;
+}
+
+// Quotients. n/d is how rationals are written, so none of these touch it.
+
+static int rule_is_sqrt_of_integer(const ASTNode *node)
+{
+    if (node->type != NODE_FUNCTION || node->function.func_type != TOKEN_SQRT ||
+        node->function.arg_count != 1)
+    {
+        return 0;
+    }
+    mpz_t radicand;
+    mpz_init(radicand);
+    int match = rule_integer(node->function.args[0], radicand) && mpz_sgn(radicand) > 0;
+    mpz_clear(radicand);
+    return match;
+}
+
+// x / 1 -> x
+static ASTNode *rule_div_one(Simplifier *simplifier, const ASTNode *node)
+{
+    (void)simplifier;
+    return rule_is_one(node->binop.right) ? rule_ref(node->binop.left) : NULL;
+}
+
+// 0 / x -> 0 for x not 0
+static ASTNode *rule_div_zero(Simplifier *simplifier, const ASTNode *node)
+{
+    if (rule_is_zero(node->binop.left) && !rule_is_zero(node->binop.right))
+    {
+        return rule_make_small(simplifier, 0);
+    }
+    return NULL;
+}
+
+// x / x -> 1 for x not 0
+static ASTNode *rule_div_self(Simplifier *simplifier, const ASTNode *node)
+{
+    if (node->binop.left == node->binop.right && !rule_is_zero(node->binop.left))
+    {
+        return rule_make_small(simplifier, 1);
+    }
+    return NULL;
+}
+
+// x / q -> (1/q)*x
+static ASTNode *rule_div_rational(Simplifier *simplifier, const ASTNode *node)
+{
+    mpq_t q;
+    mpq_init(q);
+    ASTNode *result = NULL;
+    if (rule_rational(node->binop.right, q) && mpq_sgn(q) != 0 &&
+        !rule_is_rational(node->binop.left))
+    {
+        mpq_inv(q, q);
+        result = rule_scale(simplifier, q, rule_ref(node->binop.left));
+    }
+    mpq_clear(q);
+    return result;
+}
+
+// (a + b) / sqrt(n) -> a/sqrt(n) + b/sqrt(n), so each part is rationalized
+static ASTNode *rule_div_sum(Simplifier *simplifier, const ASTNode *node)
+{
+    const ASTNode *sum = node->binop.left;
+    if (sum->type != NODE_BINOP || (sum->binop.op != TOKEN_PLUS && sum->binop.op != TOKEN_MINUS) ||
+        !rule_is_sqrt_of_integer(node->binop.right))
+    {
+        return NULL;
+    }
+    ASTNode *a = rule_binop(simplifier, TOKEN_SLASH, rule_ref(sum->binop.left),
+                            rule_ref(node->binop.right));
+    ASTNode *b = rule_binop(simplifier, TOKEN_SLASH, rule_ref(sum->binop.right),
+                            rule_ref(node->binop.right));
+    return rule_binop(simplifier, sum->binop.op, a, b);
+}
+
+// x / sqrt(n) -> (1/n) * (x * sqrt(n))
+static ASTNode *rule_div_sqrt(Simplifier *simplifier, const ASTNode *node)
+{
+    if (!rule_is_sqrt_of_integer(node->binop.right))
+    {
+        return NULL;
+    }
+
+    mpq_t q;
+    mpq_init(q);
+    rule_integer(node->binop.right->function.args[0], mpq_denref(q));
+    mpz_set_ui(mpq_numref(q), 1);
+    ASTNode *product =
+        rule_binop(simplifier, TOKEN_STAR, rule_ref(node->binop.left), rule_ref(node->binop.right));
+    ASTNode *result = rule_scale(simplifier, q, product);
+    mpq_clear(q);
+    return result;
+}
+
+// (a*x) / (b*y) -> (a/b) * (x/y)
+static ASTNode *rule_div_coefficients(Simplifier *simplifier, const ASTNode *node)
+{
+    mpq_t a, b;
+    mpq_init(a);
+    mpq_init(b);
+    const ASTNode *x = rule_term(node->binop.left, a);
+    const ASTNode *y = rule_term(node->binop.right, b);
+
+    ASTNode *result = NULL;
+    if (x && y && mpq_sgn(b) != 0 && (mpq_cmp_ui(a, 1, 1) != 0 || mpq_cmp_ui(b, 1, 1) != 0))
+    {
+        mpq_div(a, a, b);
+        result = rule_scale(simplifier, a,
+                            rule_binop(simplifier, TOKEN_SLASH, rule_ref(x), rule_ref(y)));
+    }
+    mpq_clear(a);
+    mpq_clear(b);
+    return result;
+}
+
+// Powers
+
+// x^0 -> 1
+static ASTNode *rule_pow_zero(Simplifier *simplifier, const ASTNode *node)
+{
+    return rule_is_zero(node->binop.right) ? rule_make_small(simplifier, 1) : NULL;
+}
+
+// x^1 -> x, 1^x -> 1
+static ASTNode *rule_pow_one(Simplifier *simplifier, const ASTNode *node)
+{
+    if (rule_is_one(node->binop.right))
+    {
+        return rule_ref(node->binop.left);
+    }
+    if (rule_is_one(node->binop.left))
+    {
+        return rule_make_small(simplifier, 1);
+    }
+    return NULL;
+}
+
+// (x^a)^b -> x^(ab) for integers a and b
+static ASTNode *rule_pow_of_pow(Simplifier *simplifier, const ASTNode *node)
+{
+    const ASTNode *inner = node->binop.left;
+    if (inner->type != NODE_BINOP || inner->binop.op != TOKEN_CARET)
+    {
+        return NULL;
+    }
+
+    mpz_t a, b;
+    mpz_init(a);
+    mpz_init(b);
+    ASTNode *result = NULL;
+    if (rule_integer(inner->binop.right, a) && rule_integer(node->binop.right, b))
+    {
+        mpz_mul(a, a, b);
+        result = rule_binop(simplifier, TOKEN_CARET, rule_ref(inner->binop.left),
+                            rule_make_integer(simplifier, a));
+    }
+    mpz_clear(a);
+    mpz_clear(b);
+    return result;
+}
+
+// pow(x, y) -> x^y
+static ASTNode *rule_pow_call(Simplifier *simplifier, const ASTNode *node)
+{
+    if (node->function.arg_count != 2)
+    {
+        return NULL;
+    }
+    return rule_binop(simplifier, TOKEN_CARET, rule_ref(node->function.args[0]),
+                      rule_ref(node->function.args[1]));
+}
+
+// Signs
+
+// -(-x) -> x, -(q*x) -> (-q)*x
+static ASTNode *rule_negate(Simplifier *simplifier, const ASTNode *node)
+{
+    const ASTNode *operand = node->unary.operand;
+    if (operand->type == NODE_UNARY && operand->unary.op == TOKEN_MINUS)
+    {
+        return rule_ref(operand->unary.operand);
+    }
+
+    mpq_t q;
+    mpq_init(q);
+    const ASTNode *x = rule_term(operand, q);
+    ASTNode *result = NULL;
+    if (x && mpq_cmp_ui(q, 1, 1) != 0)
+    {
+        mpq_neg(q, q);
+        result = rule_scale(simplifier, q, rule_ref(x));
+    }
+    mpq_clear(q);
+    return result;
+}
+
+// +x -> x
+static ASTNode *rule_plus(Simplifier *simplifier, const ASTNode *node)
+{
+    (void)simplifier;
+    return rule_ref(node->unary.operand);
+}
+
+// Trigonometric functions at multiples of pi/12
+
+// sin(k*pi/12) for k = 0..12 as (a/b)*sqrt(r); 0 in b where there is none
+static const struct
+{
+    int a;
+    int b;
+    int r;
+} rule_sin_table[13] = {{0, 1, 1}, {0, 0, 0}, {1, 2, 1}, {1, 2, 2}, {1, 2, 3},
+                        {0, 0, 0}, {1, 1, 1}, {0, 0, 0}, {1, 2, 3}, {1, 2, 2},
+                        {1, 2, 1}, {0, 0, 0}, {0, 1, 1}};
+
+// tan(k*pi/12) for k = 0..11; b is 0 at k = 6, where there is a pole
+static const struct
+{
+    int a;
+    int b;
+    int r;
+} rule_tan_table[12] = {{0, 1, 1}, {0, 0, 0}, {1, 3, 3},  {1, 1, 1}, {1, 1, 3},  {0, 0, 0},
+                        {0, 0, 0}, {0, 0, 0}, {-1, 1, 3}, {-1, 1, 1}, {-1, 3, 3}, {0, 0, 0}};
+
+// Write a node as q*pi and find k = 12q mod 24, if q is a multiple of 1/12
+static int rule_pi_twelfths(const ASTNode *node, long *twelfths)
+{
+    mpq_t q;
+    mpq_init(q);
+    int match = 0;
+    if (rule_is_zero(node))
+    {
+        mpq_set_ui(q, 0, 1);
+        match = 1;
+    }
+    else
+    {
+        const ASTNode *rest = rule_term(node, q);
+        match = rest && rest->type == NODE_CONSTANT && rest->constant.id == CONST_PI;
+    }
+
+    if (match)
+    {
+        mpz_t k;
+        mpz_init(k);
+        mpz_mul_ui(k, mpq_numref(q), 12);
+        match = mpz_divisible_p(k, mpq_denref(q));
+        if (match)
+        {
+            mpz_divexact(k, k, mpq_denref(q));
+            *twelfths = (long)mpz_fdiv_ui(k, 24);
+        }
+        mpz_clear(k);
+    }
+    mpq_clear(q);
+    return match;
+}
+
+static ASTNode *rule_make_surd(Simplifier *simplifier, int sign, int a, int b, int r)
+{
+    mpq_t q;
+    mpq_init(q);
+    mpq_set_si(q, sign * a, (unsigned long)b);
+    mpq_canonicalize(q);
+    ASTNode *result;
+    if (r == 1)
+    {
+        result = rule_make_rational(simplifier, q);
+    }
+    else
+    {
+        result = rule_scale(simplifier, q,
+                            rule_call(simplifier, TOKEN_SQRT, rule_make_small(simplifier, r)));
+    }
+    mpq_clear(q);
+    return result;
+}
+
+// sin, cos and tan of 0, pi/6, pi/4, pi/3, pi/2 and their multiples
+static ASTNode *rule_trig_exact(Simplifier *simplifier, const ASTNode *node)
+{
+    long k;
+    if (node->function.arg_count != 1 || !rule_pi_twelfths(node->function.args[0], &k))
+    {
+        return NULL;
+    }
+
+    switch (node->function.func_type)
+    {
+    case TOKEN_COS:
+        // cos(x) = sin(x + pi/2)
+        k = (k + 6) % 24;
+        // Fall through
+    case TOKEN_SIN:
+    {
+        int sign = k >= 12 ? -1 : 1;
+        k %= 12;
+        if (!rule_sin_table[k].b)
+        {
+            return NULL;
+        }
+        return rule_make_surd(simplifier, sign, rule_sin_table[k].a, rule_sin_table[k].b,
+                              rule_sin_table[k].r);
+    }
+    case TOKEN_TAN:
+        k %= 12;
+        if (!rule_tan_table[k].b)
+        {
+            return NULL;
+        }
+        return rule_make_surd(simplifier, 1, rule_tan_table[k].a, rule_tan_table[k].b,
+                              rule_tan_table[k].r);
+    default:
+        return NULL;
+    }
+}
+
+// Roots, absolute values, exponentials and logarithms
+
+// sqrt(x^2) -> abs(x)
+static ASTNode *rule_sqrt_square(Simplifier *simplifier, const ASTNode *node)
+{
+    const ASTNode *arg = node->function.args[0];
+    if (node->function.arg_count != 1 || arg->type != NODE_BINOP || arg->binop.op != TOKEN_CARET ||
+        !rule_is_integer_value(arg->binop.right, 2))
+    {
+        return NULL;
+    }
+    return rule_call(simplifier, TOKEN_ABS, rule_ref(arg->binop.left));
+}
+
+// sqrt(k^2 * m / d) -> (k/d) * sqrt(m * d): pull square factors out of a
+// positive rational radicand
+static ASTNode *rule_sqrt_radicand(Simplifier *simplifier, const ASTNode *node)
+{
+    mpq_t q;
+    mpq_init(q);
+    ASTNode *result = NULL;
+    if (node->function.arg_count == 1 && rule_rational(node->function.args[0], q) &&
+        mpq_sgn(q) > 0)
+    {
+        mpz_t n;
+        mpz_init(n);
+        mpz_mul(n, mpq_numref(q), mpq_denref(q));
+        if (mpz_fits_ulong_p(n) && mpz_get_ui(n) <= RULE_SQRT_MAX_RADICAND)
+        {
+            unsigned long m = mpz_get_ui(n);
+            unsigned long k = 1;
+            for (unsigned long p = 2; p * p <= m; p++)
+            {
+                while (m % (p * p) == 0)
+                {
+                    m /= p * p;
+                    k *= p;
+                }
+            }
+
+            // sqrt(m) alone, as it came, is already as simple as it gets
+            if (k > 1 || mpz_cmp_ui(mpq_denref(q), 1) != 0)
+            {
+                mpq_t coefficient;
+                mpq_init(coefficient);
+                mpz_set_ui(mpq_numref(coefficient), k);
+                mpz_set(mpq_denref(coefficient), mpq_denref(q));
+                mpq_canonicalize(coefficient);
+
+                mpz_t radicand;
+                mpz_init_set_ui(radicand, m);
+                ASTNode *root = m == 1 ? rule_make_small(simplifier, 1)
+                                       : rule_call(simplifier, TOKEN_SQRT,
+                                                   rule_make_integer(simplifier, radicand));
+                result = rule_scale(simplifier, coefficient, root);
+                mpz_clear(radicand);
+                mpq_clear(coefficient);
+            }
+        }
+        mpz_clear(n);
+    }
+    mpq_clear(q);
+    return result;
+}
+
+// abs(abs(x)) -> abs(x), abs(-x) -> abs(x)
+static ASTNode *rule_abs_abs(Simplifier *simplifier, const ASTNode *node)
+{
+    const ASTNode *arg = node->function.args[0];
+    if (node->function.arg_count != 1)
+    {
+        return NULL;
+    }
+    if (arg->type == NODE_FUNCTION && arg->function.func_type == TOKEN_ABS)
+    {
+        return rule_ref(arg);
+    }
+    if (arg->type == NODE_UNARY && arg->unary.op == TOKEN_MINUS)
+    {
+        return rule_call(simplifier, TOKEN_ABS, rule_ref(arg->unary.operand));
+    }
+    return NULL;
+}
+
+// exp(0) -> 1
+static ASTNode *rule_exp(Simplifier *simplifier, const ASTNode *node)
+{
+    if (node->function.arg_count == 1 && rule_is_zero(node->function.args[0]))
+    {
+        return rule_make_small(simplifier, 1);
+    }
+    return NULL;
+}
+
+// log(1) -> 0, log(e) -> 1, log(exp(x)) -> x
+static ASTNode *rule_log(Simplifier *simplifier, const ASTNode *node)
+{
+    const ASTNode *arg = node->function.args[0];
+    if (node->function.arg_count != 1)
+    {
+        return NULL;
+    }
+    if (rule_is_one(arg))
+    {
+        return rule_make_small(simplifier, 0);
+    }
+    if (arg->type == NODE_CONSTANT && arg->constant.id == CONST_E)
+    {
+        return rule_make_small(simplifier, 1);
+    }
+    if (arg->type == NODE_FUNCTION && arg->function.func_type == TOKEN_EXP &&
+        arg->function.arg_count == 1)
+    {
+        return rule_ref(arg->function.args[0]);
+    }
+    return NULL;
+}
+
+// log10(10^n) -> n for integers n >= 0
+static ASTNode *rule_log10(Simplifier *simplifier, const ASTNode *node)
+{
+    mpz_t value;
+    mpz_init(value);
+    ASTNode *result = NULL;
+    if (node->function.arg_count == 1 && rule_integer(node->function.args[0], value) &&
+        mpz_sgn(value) > 0)
+    {
+        long n = 0;
+        while (mpz_divisible_ui_p(value, 10))
+        {
+            mpz_divexact_ui(value, value, 10);
+            n++;
+        }
+        if (mpz_cmp_ui(value, 1) == 0)
+        {
+            result = rule_make_small(simplifier, n);
+        }
+    }
+    mpz_clear(value);
+    return result;
+}
+
+// Rule index
+
+static const struct
+{
+    NodeType type;
+    TokenType op; // Operator, or function token for calls
+    SimplifyRule rule;
+} rule_table[] = {
+    {NODE_BINOP, TOKEN_PLUS, rule_fold},
+    {NODE_BINOP, TOKEN_PLUS, rule_add_zero},
+    {NODE_BINOP, TOKEN_PLUS, rule_like_terms},
+    {NODE_BINOP, TOKEN_PLUS, rule_sum_sign},
+    {NODE_BINOP, TOKEN_PLUS, rule_sum_constants},
+    {NODE_BINOP, TOKEN_MINUS, rule_fold},
+    {NODE_BINOP, TOKEN_MINUS, rule_sub_zero},
+    {NODE_BINOP, TOKEN_MINUS, rule_like_terms},
+    {NODE_BINOP, TOKEN_MINUS, rule_sum_sign},
+    {NODE_BINOP, TOKEN_MINUS, rule_sum_constants},
+    {NODE_BINOP, TOKEN_STAR, rule_fold},
+    {NODE_BINOP, TOKEN_STAR, rule_mul_zero},
+    {NODE_BINOP, TOKEN_STAR, rule_mul_one},
+    {NODE_BINOP, TOKEN_STAR, rule_mul_order},
+    {NODE_BINOP, TOKEN_STAR, rule_mul_coefficients},
+    {NODE_BINOP, TOKEN_STAR, rule_mul_powers},
+    {NODE_BINOP, TOKEN_SLASH, rule_fold},
+    {NODE_BINOP, TOKEN_SLASH, rule_div_one},
+    {NODE_BINOP, TOKEN_SLASH, rule_div_zero},
+    {NODE_BINOP, TOKEN_SLASH, rule_div_self},
+    {NODE_BINOP, TOKEN_SLASH, rule_div_rational},
+    {NODE_BINOP, TOKEN_SLASH, rule_div_sum},
+    {NODE_BINOP, TOKEN_SLASH, rule_div_sqrt},
+    {NODE_BINOP, TOKEN_SLASH, rule_div_coefficients},
+    {NODE_BINOP, TOKEN_CARET, rule_fold},
+    {NODE_BINOP, TOKEN_CARET, rule_pow_zero},
+    {NODE_BINOP, TOKEN_CARET, rule_pow_one},
+    {NODE_BINOP, TOKEN_CARET, rule_pow_of_pow},
+    {NODE_BINOP, TOKEN_EQ, rule_fold},
+    {NODE_BINOP, TOKEN_NEQ, rule_fold},
+    {NODE_BINOP, TOKEN_LT, rule_fold},
+    {NODE_BINOP, TOKEN_LTE, rule_fold},
+    {NODE_BINOP, TOKEN_GT, rule_fold},
+    {NODE_BINOP, TOKEN_GTE, rule_fold},
+    {NODE_UNARY, TOKEN_MINUS, rule_fold},
+    {NODE_UNARY, TOKEN_MINUS, rule_negate},
+    {NODE_UNARY, TOKEN_PLUS, rule_plus},
+    {NODE_FUNCTION, TOKEN_SIN, rule_trig_exact},
+    {NODE_FUNCTION, TOKEN_COS, rule_trig_exact},
+    {NODE_FUNCTION, TOKEN_TAN, rule_trig_exact},
+    {NODE_FUNCTION, TOKEN_SQRT, rule_fold},
+    {NODE_FUNCTION, TOKEN_SQRT, rule_sqrt_square},
+    {NODE_FUNCTION, TOKEN_SQRT, rule_sqrt_radicand},
+    {NODE_FUNCTION, TOKEN_ABS, rule_fold},
+    {NODE_FUNCTION, TOKEN_ABS, rule_abs_abs},
+    {NODE_FUNCTION, TOKEN_FLOOR, rule_fold},
+    {NODE_FUNCTION, TOKEN_CEIL, rule_fold},
+    {NODE_FUNCTION, TOKEN_POW, rule_pow_call},
+    {NODE_FUNCTION, TOKEN_EXP, rule_exp},
+    {NODE_FUNCTION, TOKEN_LOG, rule_log},
+    {NODE_FUNCTION, TOKEN_LOG10, rule_log10},
+};
+
+#define RULE_COUNT ((int)(sizeof(rule_table) / sizeof(rule_table[0])))
+#define RULE_NODE_TYPES (NODE_VARIABLE + 1)
+#define RULE_TOKENS (TOKEN_INVALID + 1)
+
+// Rules grouped by (node type, token) in table order; a group is
+// rule_index[start, start + count)
+static SimplifyRule rule_index[RULE_COUNT];
+static unsigned short rule_start[RULE_NODE_TYPES][RULE_TOKENS];
+static unsigned short rule_group_count[RULE_NODE_TYPES][RULE_TOKENS];
+static pthread_once_t rule_index_once = PTHREAD_ONCE_INIT;
+
+static void rule_index_init(void)
+{
+    for (int i = 0; i < RULE_COUNT; i++)
+    {
+        rule_group_count[rule_table[i].type][rule_table[i].op]++;
+    }
+
+    int start = 0;
+    for (int type = 0; type < RULE_NODE_TYPES; type++)
+    {
+        for (int op = 0; op < RULE_TOKENS; op++)
+        {
+            rule_start[type][op] = (unsigned short)start;
+            start += rule_group_count[type][op];
+        }
+    }
+
+    int filled[RULE_NODE_TYPES][RULE_TOKENS] = {{0}};
+    for (int i = 0; i < RULE_COUNT; i++)
+    {
+        NodeType type = rule_table[i].type;
+        TokenType op = rule_table[i].op;
+        rule_index[rule_start[type][op] + filled[type][op]++] = rule_table[i].rule;
+    }
+}
+
+const SimplifyRule *simplify_rules_for(const ASTNode *node, int *count)
+{
+    TokenType op;
+    switch (node->type)
+    {
+    case NODE_BINOP:
+        op = node->binop.op;
+        break;
+    case NODE_UNARY:
+        op = node->unary.op;
+        break;
+    case NODE_FUNCTION:
+        op = node->function.func_type;
+        break;
+    default:
+        *count = 0;
+        return NULL;
+    }
+
+    pthread_once(&rule_index_once, rule_index_init);
+    *count = rule_group_count[node->type][op];
+    return *count ? &rule_index[rule_start[node->type][op]] : NULL;
+}
+
+int simplify_rules_count(void)
+{
+    return RULE_COUNT;
+}
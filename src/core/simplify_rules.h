@@ -0,0 +1,34 @@
+#ifndef SIMPLIFY_RULES_H
+#define SIMPLIFY_RULES_H
+
+#include "ast.h"
+#include "symbolic.h"
+
+/**
+ * Rewrite rule
+ * Gets a node whose children are simplified and returns a reference to an
+ * equal, simpler expression built with symbolic_intern(), or NULL when
+ * the rule does not apply. The node itself is never changed.
+ */
+typedef ASTNode *(*SimplifyRule)(Simplifier *simplifier, const ASTNode *node);
+
+/**
+ * Get the rules that can apply to a node
+ *
+ * Rules are indexed by node type and operator (binary and unary nodes) or
+ * function token (function calls), so a node is only shown the few rules
+ * written for it. Numbers, constants and variables have none.
+ *
+ * @param node Node to simplify
+ * @param count Output: number of rules
+ * @return Rules to try in order, NULL when count is 0
+ */
+const SimplifyRule *simplify_rules_for(const ASTNode *node, int *count);
+
+/**
+ * Get the number of rules there are in all
+ * @return Size of the rule table
+ */
+int simplify_rules_count(void);
+
+#endif // SIMPLIFY_RULES_H
@@ -0,0 +1,465 @@
+#include "sweep.h"
+#include "compiler.h"
+#include "context.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include "profile.h"
+#include "variables.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Batches in flight per worker; bounds memory while keeping workers busy
+#define SWEEP_BATCHES_PER_JOB 4
+
+// Last error, per thread like the contexts
+static _Thread_local char sweep_error[256];
+
+// Evaluation state of one thread
+typedef struct
+{
+    EvalContext ctx;
+    VariableTable *variables;
+    const SweepSpec *spec;
+    CompiledProgram *program; // Body compiled for points MPFR evaluates, or NULL
+    mpfr_t points[SWEEP_BATCH_SIZE];
+    mpfr_t results[SWEEP_BATCH_SIZE];
+    unsigned char accepted[SWEEP_BATCH_SIZE];
+    mpfr_t offset;    // Scratch for i * step
+    FormatBuffer row; // Text of the row being written
+} SweepWorker;
+
+typedef enum
+{
+    SLOT_FREE,    // Batch not taken yet
+    SLOT_RUNNING, // Being evaluated
+    SLOT_DONE     // Rows ready to be written in order
+} SlotState;
+
+// Rows of one batch, written by a worker and read by the caller's thread
+typedef struct
+{
+    SlotState state;
+    char *text;
+    size_t length;
+    SweepStats stats;
+    int failed; // Rows could not be buffered
+} SweepSlot;
+
+// Batches are numbered in point order: workers take batch take_seq into
+// slot take_seq % slot_count once batch take_seq - slot_count is written,
+// and the caller writes batch write_seq once it is done.
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    const EvalContext *settings;
+    const SweepSpec *spec;
+    SweepSlot *slots;
+    unsigned long slot_count;
+    unsigned long batch_count;
+    unsigned long take_seq;
+    unsigned long write_seq;
+    int stop;   // Writing failed: take no more batches
+    int failed; // A worker could not be set up
+} SweepPool;
+
+const char *sweep_get_error(void)
+{
+    return sweep_error[0] ? sweep_error : NULL;
+}
+
+int sweep_count(mpfr_srcptr from, mpfr_srcptr to, mpfr_srcptr step, unsigned long *count)
+{
+    sweep_error[0] = '\0';
+
+    if (!mpfr_number_p(from) || !mpfr_number_p(to))
+    {
+        snprintf(sweep_error, sizeof(sweep_error), "Sweep bounds must be finite");
+        return 0;
+    }
+    if (!mpfr_regular_p(step))
+    {
+        snprintf(sweep_error, sizeof(sweep_error), "Sweep step must be finite and nonzero");
+        return 0;
+    }
+
+    mpfr_prec_t precision = mpfr_get_prec(from);
+    if (mpfr_get_prec(to) < precision)
+        precision = mpfr_get_prec(to);
+    if (mpfr_get_prec(step) < precision)
+        precision = mpfr_get_prec(step);
+
+    mpfr_t steps, nearest, slack;
+    mpfr_inits2(precision + 64, steps, nearest, slack, (mpfr_ptr)0);
+    mpfr_sub(steps, to, from, MPFR_RNDN);
+    mpfr_div(steps, steps, step, MPFR_RNDN);
+
+    // Bounds and step are rounded to their precision, so a number of steps
+    // that is an integer but for the last few of those bits counts as one
+    mpfr_rint(nearest, steps, MPFR_RNDN);
+    mpfr_sub(slack, steps, nearest, MPFR_RNDN);
+    mpfr_abs(slack, slack, MPFR_RNDN);
+    mpfr_mul_2si(slack, slack, (long)precision - 8, MPFR_RNDN);
+    int ok = 1;
+    if (mpfr_cmpabs(slack, steps) <= 0 || mpfr_zero_p(nearest))
+    {
+        mpfr_set(steps, nearest, MPFR_RNDN);
+    }
+    else
+    {
+        mpfr_floor(steps, steps);
+    }
+
+    if (mpfr_sgn(steps) < 0)
+    {
+        snprintf(sweep_error, sizeof(sweep_error), "Sweep step leads away from the end");
+        ok = 0;
+    }
+    else if (mpfr_cmp_ui(steps, SWEEP_MAX_POINTS - 1) > 0)
+    {
+        snprintf(sweep_error, sizeof(sweep_error), "Sweep of more than %lu points",
+                 SWEEP_MAX_POINTS);
+        ok = 0;
+    }
+    else
+    {
+        *count = mpfr_get_ui(steps, MPFR_RNDN) + 1;
+    }
+
+    mpfr_clears(steps, nearest, slack, (mpfr_ptr)0);
+    return ok;
+}
+
+static int sweep_worker_init(SweepWorker *worker, const EvalContext *settings,
+                             const SweepSpec *spec)
+{
+    eval_context_init(&worker->ctx, settings->precision);
+    worker->ctx.rounding = settings->rounding;
+    worker->ctx.strict_mode = settings->strict_mode;
+    worker->ctx.strict_domain = settings->strict_domain;
+    worker->ctx.adaptive = settings->adaptive;
+    worker->ctx.interval = settings->interval;
+    worker->ctx.native = settings->native;
+    worker->ctx.exact = settings->exact;
+    worker->ctx.budget = settings->budget;
+    worker->ctx.format = settings->format;
+    worker->spec = spec;
+
+    // Points carry the evaluator's guard bits, like any literal would
+    mpfr_prec_t point_precision = settings->precision + BINOP_PRECISION_BOOST;
+    for (int i = 0; i < SWEEP_BATCH_SIZE; i++)
+    {
+        mpfr_init2(worker->points[i], point_precision);
+        mpfr_init2(worker->results[i], settings->precision);
+    }
+    mpfr_init2(worker->offset, point_precision);
+    format_buffer_init(&worker->row);
+
+    worker->variables = spec->variables ? variables_copy(spec->variables) : variables_create();
+    worker->ctx.variables = worker->variables;
+
+    // Bodies that read no other variable are compiled once and replayed per
+    // point; the rest, and settings a program cannot replay, go through the
+    // evaluator
+    worker->program = compiler_compile(&worker->ctx, spec->body, spec->variable);
+    return worker->variables != NULL;
+}
+
+static void sweep_worker_cleanup(SweepWorker *worker)
+{
+    for (int i = 0; i < SWEEP_BATCH_SIZE; i++)
+    {
+        mpfr_clear(worker->points[i]);
+        mpfr_clear(worker->results[i]);
+    }
+    mpfr_clear(worker->offset);
+    format_buffer_free(&worker->row);
+    compiler_free(worker->program);
+    variables_destroy(worker->variables);
+    eval_context_cleanup(&worker->ctx);
+}
+
+// Evaluate one batch and write its rows
+// Returns 1 on success, 0 if a row could not be formatted or written
+static int sweep_worker_batch(SweepWorker *worker, unsigned long batch, FILE *out,
+                               SweepStats *stats)
+{
+    const SweepSpec *spec = worker->spec;
+    EvalContext *ctx = &worker->ctx;
+    unsigned long first = batch * SWEEP_BATCH_SIZE;
+    int count = spec->count - first < SWEEP_BATCH_SIZE ? (int)(spec->count - first)
+                                                       : SWEEP_BATCH_SIZE;
+
+    for (int i = 0; i < count; i++)
+    {
+        mpfr_mul_ui(worker->offset, spec->step, first + (unsigned long)i, MPFR_RNDN);
+        mpfr_add(worker->points[i], spec->from, worker->offset, MPFR_RNDN);
+    }
+
+    int served = 0;
+    if (ctx->native)
+    {
+        served = native_eval_batch(ctx, spec->body, spec->variable, worker->points, count,
+                                   worker->results, worker->accepted);
+    }
+    else
+    {
+        memset(worker->accepted, 0, sizeof(worker->accepted));
+    }
+    stats->native_points += (unsigned long)served;
+
+    for (int i = 0; i < count; i++)
+    {
+        const char *error = NULL;
+        if (!worker->accepted[i] && worker->program)
+        {
+            compiler_run(ctx, worker->results[i], worker->program, worker->points[i]);
+            error = eval_context_get_error(ctx);
+        }
+        else if (!worker->accepted[i])
+        {
+            if (variables_set_value(worker->variables, spec->variable, worker->points[i]) < 0)
+            {
+                error = variables_get_error(worker->variables);
+            }
+            else
+            {
+                evaluator_eval_ctx(ctx, worker->results[i], spec->body);
+                error = eval_context_get_error(ctx);
+            }
+        }
+
+        FormatBuffer *row = &worker->row;
+        format_buffer_reset(row);
+        formatter_format_value_ctx(ctx, row, worker->points[i], 0);
+        format_buffer_append_char(row, '\t');
+        if (error)
+        {
+            format_buffer_append(row, "error: ", 7);
+            format_buffer_append(row, error, strlen(error));
+            stats->errors++;
+        }
+        else
+        {
+            formatter_format_value_ctx(ctx, row, worker->results[i], 0);
+        }
+        format_buffer_append_char(row, '\n');
+        if (!format_buffer_write(row, out))
+        {
+            return 0;
+        }
+        stats->points++;
+    }
+    return 1;
+}
+
+static unsigned long sweep_batch_count(const SweepSpec *spec)
+{
+    return (spec->count + SWEEP_BATCH_SIZE - 1) / SWEEP_BATCH_SIZE;
+}
+
+static int sweep_run_serial(const EvalContext *settings, const SweepSpec *spec, FILE *out,
+                            SweepStats *stats)
+{
+    SweepWorker *worker = malloc(sizeof(SweepWorker));
+    if (!worker)
+    {
+        snprintf(sweep_error, sizeof(sweep_error), "Out of memory");
+        return 0;
+    }
+
+    int ok = sweep_worker_init(worker, settings, spec);
+    if (!ok)
+    {
+        snprintf(sweep_error, sizeof(sweep_error), "Out of memory");
+    }
+
+    unsigned long batches = sweep_batch_count(spec);
+    for (unsigned long batch = 0; ok && batch < batches; batch++)
+    {
+        if (!sweep_worker_batch(worker, batch, out, stats))
+        {
+            snprintf(sweep_error, sizeof(sweep_error), "Output error");
+            ok = 0;
+        }
+    }
+
+    sweep_worker_cleanup(worker);
+    free(worker);
+    return ok;
+}
+
+static void *sweep_thread(void *arg)
+{
+    SweepPool *pool = arg;
+    SweepWorker *worker = malloc(sizeof(SweepWorker));
+    int ready = worker && sweep_worker_init(worker, pool->settings, pool->spec);
+
+    pthread_mutex_lock(&pool->lock);
+    if (!ready)
+    {
+        // The caller stops once it sees the flag; the other workers finish
+        pool->failed = 1;
+        pool->stop = 1;
+        pthread_cond_broadcast(&pool->changed);
+    }
+    while (ready)
+    {
+        while (!pool->stop && pool->take_seq < pool->batch_count &&
+               pool->take_seq >= pool->write_seq + pool->slot_count)
+        {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+        if (pool->stop || pool->take_seq >= pool->batch_count)
+        {
+            break;
+        }
+
+        unsigned long batch = pool->take_seq++;
+        SweepSlot *slot = &pool->slots[batch % pool->slot_count];
+        slot->state = SLOT_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+
+        memset(&slot->stats, 0, sizeof(slot->stats));
+        FILE *out = open_memstream(&slot->text, &slot->length);
+        slot->failed = !out;
+        if (out)
+        {
+            int written = sweep_worker_batch(worker, batch, out, &slot->stats);
+            slot->failed = (fclose(out) != 0) || !written;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        slot->state = SLOT_DONE;
+        pthread_cond_broadcast(&pool->changed);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (worker)
+    {
+        if (ready)
+            sweep_worker_cleanup(worker);
+        free(worker);
+    }
+    formatter_cleanup();
+    evaluator_cleanup();
+    profile_merge_thread();
+    mpfr_free_cache();
+    return NULL;
+}
+
+static int sweep_run_parallel(const EvalContext *settings, const SweepSpec *spec, int jobs,
+                              FILE *out, SweepStats *stats)
+{
+    SweepPool pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.settings = settings;
+    pool.spec = spec;
+    pool.batch_count = sweep_batch_count(spec);
+    pool.slot_count = (unsigned long)jobs * SWEEP_BATCHES_PER_JOB;
+    pool.slots = calloc(pool.slot_count, sizeof(SweepSlot));
+    pthread_t *threads = malloc((size_t)jobs * sizeof(pthread_t));
+    if (!pool.slots || !threads)
+    {
+        free(pool.slots);
+        free(threads);
+        snprintf(sweep_error, sizeof(sweep_error), "Out of memory");
+        return 0;
+    }
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.changed, NULL);
+
+    int started = 0;
+    while (started < jobs && pthread_create(&threads[started], NULL, sweep_thread, &pool) == 0)
+    {
+        started++;
+    }
+
+    int ok = started > 0;
+    if (!ok)
+    {
+        snprintf(sweep_error, sizeof(sweep_error), "Could not start worker threads");
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    while (ok && pool.write_seq < pool.batch_count)
+    {
+        SweepSlot *slot = &pool.slots[pool.write_seq % pool.slot_count];
+        while (slot->state != SLOT_DONE && !pool.failed)
+        {
+            pthread_cond_wait(&pool.changed, &pool.lock);
+        }
+        if (slot->state != SLOT_DONE)
+        {
+            snprintf(sweep_error, sizeof(sweep_error), "Out of memory");
+            ok = 0;
+            break;
+        }
+        pthread_mutex_unlock(&pool.lock);
+
+        // Write outside the lock so workers keep going
+        if (slot->failed || fwrite(slot->text, 1, slot->length, out) != slot->length)
+        {
+            snprintf(sweep_error, sizeof(sweep_error),
+                     slot->failed ? "Out of memory" : "Output error");
+            ok = 0;
+        }
+        stats->points += slot->stats.points;
+        stats->native_points += slot->stats.native_points;
+        stats->errors += slot->stats.errors;
+        free(slot->text);
+        slot->text = NULL;
+
+        pthread_mutex_lock(&pool.lock);
+        slot->state = SLOT_FREE;
+        pool.write_seq++;
+        pthread_cond_broadcast(&pool.changed);
+    }
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.changed);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Batches finished after a failure are never written
+    for (unsigned long i = 0; i < pool.slot_count; i++)
+    {
+        free(pool.slots[i].text);
+    }
+    pthread_cond_destroy(&pool.changed);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.slots);
+    free(threads);
+    return ok;
+}
+
+int sweep_run(const EvalContext *settings, const SweepSpec *spec, FILE *out, SweepStats *stats)
+{
+    sweep_error[0] = '\0';
+
+    SweepStats counted = {0, 0, 0};
+    unsigned long batches = sweep_batch_count(spec);
+    int jobs = spec->jobs < 1 ? 1 : spec->jobs > SWEEP_MAX_JOBS ? SWEEP_MAX_JOBS : spec->jobs;
+    if ((unsigned long)jobs > batches)
+    {
+        jobs = (int)batches;
+    }
+
+    int ok = jobs > 1 ? sweep_run_parallel(settings, spec, jobs, out, &counted)
+                      : sweep_run_serial(settings, spec, out, &counted);
+    if (ok && fflush(out) != 0)
+    {
+        snprintf(sweep_error, sizeof(sweep_error), "Output error");
+        ok = 0;
+    }
+
+    if (stats)
+    {
+        *stats = counted;
+    }
+    return ok;
+}
@@ -0,0 +1,92 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "ast.h"
+#include "native.h"
+#include <mpfr.h>
+#include <stdio.h>
+
+typedef struct EvalContext EvalContext;
+typedef struct VariableTable VariableTable;
+
+// Points evaluated together; also the unit of work handed to a thread
+#define SWEEP_BATCH_SIZE NATIVE_BATCH_SIZE
+
+// Most points one sweep may have
+#define SWEEP_MAX_POINTS 100000000UL
+
+// Most worker threads one sweep uses
+#define SWEEP_MAX_JOBS 256
+
+/**
+ * One expression tabulated over evenly spaced values of a variable
+ */
+typedef struct
+{
+    const ASTNode *body;             // Expression to evaluate at every point
+    const char *variable;            // Name the points are bound to
+    mpfr_srcptr from;                // First point
+    mpfr_srcptr step;                // Distance between points
+    unsigned long count;             // Number of points
+    const VariableTable *variables;  // Other definitions the body may read, or NULL
+    int jobs;                        // Worker threads; 1 evaluates on the caller's thread
+} SweepSpec;
+
+/**
+ * What a sweep did
+ */
+typedef struct
+{
+    unsigned long points;        // Points written
+    unsigned long native_points; // Points served by the hardware batch path
+    unsigned long errors;        // Points that produced an error
+} SweepStats;
+
+/**
+ * Count the points of a range from one bound to the other
+ *
+ * A last point within rounding error of the end of the range is included,
+ * so "0 to 1 step 0.1" has 11 points.
+ *
+ * @param from First point
+ * @param to Last point at most
+ * @param step Distance between points; its sign must lead from from to to
+ * @param count Output number of points
+ * @return 1 on success, 0 on error (see sweep_get_error())
+ */
+int sweep_count(mpfr_srcptr from, mpfr_srcptr to, mpfr_srcptr step, unsigned long *count);
+
+/**
+ * Evaluate a sweep and write one row per point
+ *
+ * Rows are "<point>\t<value>" or "<point>\terror: <message>", in point
+ * order. The body is evaluated in batches of SWEEP_BATCH_SIZE points; with
+ * the native backend enabled and a precision the hardware batch path
+ * serves, each batch first goes through native_eval_batch() and only the
+ * points it declines are evaluated with MPFR. For those, each worker
+ * compiles the body once (see compiler_compile()) and replays the program
+ * per point; bodies and settings the compiler declines go through
+ * evaluator_eval_ctx(), which gives the same rows. With several jobs,
+ * batches are spread over worker threads, each with its own context and
+ * copy of the definitions, and written out in order as they complete.
+ *
+ * Point i is from + i * step, computed with the working precision's guard
+ * bits rather than by repeated addition.
+ *
+ * @param settings Context supplying precision, rounding, evaluator flags and
+ *                 display settings (not modified)
+ * @param spec Sweep to evaluate
+ * @param out Stream for the rows
+ * @param stats Output counters (can be NULL)
+ * @return 1 if every row was written, 0 on allocation, thread or output
+ *         failure (see sweep_get_error())
+ */
+int sweep_run(const EvalContext *settings, const SweepSpec *spec, FILE *out, SweepStats *stats);
+
+/**
+ * Get the last sweep error of the calling thread
+ * @return Error message or NULL if no error
+ */
+const char *sweep_get_error(void);
+
+#endif // SWEEP_H
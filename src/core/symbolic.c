@@ -0,0 +1,462 @@
+#include "symbolic.h"
+#include "simplify_rules.h"
+#include "profile.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// First size of the node table; it doubles whenever it gets half full
+#define SYMBOLIC_TABLE_SLOTS 256
+
+typedef struct
+{
+    ASTNode *key;   // Node as built, its children already simplified; NULL if free
+    ASTNode *value; // What it simplified to (may be key itself)
+    uint64_t hash;
+} SymbolicEntry;
+
+struct Simplifier
+{
+    SymbolicEntry *entries;
+    size_t mask;
+    size_t used;
+    unsigned long max_steps;
+    int depth;  // Rewrites under way
+    int failed; // An allocation failed; the result is dropped
+    SymbolicStats stats;
+};
+
+static uint64_t symbolic_hash_mix(uint64_t hash, uint64_t value)
+{
+    hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static uint64_t symbolic_hash_string(uint64_t hash, const char *text)
+{
+    while (*text)
+    {
+        hash = (hash ^ (unsigned char)*text++) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Hash a node by its own fields. Children count by identity: they come
+// from the table, where equal subtrees are the same node.
+static uint64_t symbolic_hash(const ASTNode *node)
+{
+    uint64_t hash = symbolic_hash_mix((uint64_t)node->type, 0);
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    {
+        double approx = mpfr_get_d(node->number.literal->value, MPFR_RNDZ);
+        uint64_t bits;
+        memcpy(&bits, &approx, sizeof(bits));
+        return symbolic_hash_mix(symbolic_hash_mix(hash, bits), (uint64_t)node->number.is_int);
+    }
+    case NODE_CONSTANT:
+        return symbolic_hash_string(hash, node->constant.name);
+    case NODE_VARIABLE:
+        return symbolic_hash_string(hash ^ 0x84222325cbf29ce4ULL, node->variable.name);
+    case NODE_BINOP:
+        hash = symbolic_hash_mix(hash, (uint64_t)node->binop.op);
+        hash = symbolic_hash_mix(hash, (uint64_t)(uintptr_t)node->binop.left);
+        return symbolic_hash_mix(hash, (uint64_t)(uintptr_t)node->binop.right);
+    case NODE_UNARY:
+        hash = symbolic_hash_mix(hash, (uint64_t)node->unary.op);
+        return symbolic_hash_mix(hash, (uint64_t)(uintptr_t)node->unary.operand);
+    case NODE_FUNCTION:
+        hash = symbolic_hash_mix(hash, (uint64_t)node->function.func_type);
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            hash = symbolic_hash_mix(hash, (uint64_t)(uintptr_t)node->function.args[i]);
+        }
+        return hash;
+    case NODE_NARY:
+        hash = symbolic_hash_mix(hash, (uint64_t)node->nary.op);
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            hash = symbolic_hash_mix(hash, (uint64_t)(uintptr_t)node->nary.operands[i]);
+        }
+        return hash;
+    }
+    return hash;
+}
+
+// Compare the fields symbolic_hash() covers
+static int symbolic_same(const ASTNode *a, const ASTNode *b)
+{
+    if (a->type != b->type)
+    {
+        return 0;
+    }
+
+    switch (a->type)
+    {
+    case NODE_NUMBER:
+        return a->number.is_int == b->number.is_int &&
+               mpfr_equal_p(a->number.literal->value, b->number.literal->value) &&
+               mpfr_signbit(a->number.literal->value) == mpfr_signbit(b->number.literal->value);
+    case NODE_CONSTANT:
+        return strcmp(a->constant.name, b->constant.name) == 0;
+    case NODE_VARIABLE:
+        return strcmp(a->variable.name, b->variable.name) == 0;
+    case NODE_BINOP:
+        return a->binop.op == b->binop.op && a->binop.left == b->binop.left &&
+               a->binop.right == b->binop.right;
+    case NODE_UNARY:
+        return a->unary.op == b->unary.op && a->unary.operand == b->unary.operand;
+    case NODE_FUNCTION:
+        if (a->function.func_type != b->function.func_type ||
+            a->function.arg_count != b->function.arg_count)
+        {
+            return 0;
+        }
+        for (int i = 0; i < a->function.arg_count; i++)
+        {
+            if (a->function.args[i] != b->function.args[i])
+            {
+                return 0;
+            }
+        }
+        return 1;
+    case NODE_NARY:
+        if (a->nary.op != b->nary.op || a->nary.count != b->nary.count)
+        {
+            return 0;
+        }
+        for (int i = 0; i < a->nary.count; i++)
+        {
+            if (a->nary.operands[i] != b->nary.operands[i])
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// Find a node's entry, or the free slot it would take
+static SymbolicEntry *symbolic_find(Simplifier *simplifier, const ASTNode *node, uint64_t hash)
+{
+    size_t index = (size_t)hash & simplifier->mask;
+    for (;;)
+    {
+        SymbolicEntry *entry = &simplifier->entries[index];
+        if (!entry->key || (entry->hash == hash && symbolic_same(entry->key, node)))
+        {
+            return entry;
+        }
+        index = (index + 1) & simplifier->mask;
+    }
+}
+
+static int symbolic_grow(Simplifier *simplifier)
+{
+    size_t capacity = (simplifier->mask + 1) * 2;
+    SymbolicEntry *entries = calloc(capacity, sizeof(*entries));
+    if (!entries)
+    {
+        return 0;
+    }
+
+    SymbolicEntry *old = simplifier->entries;
+    size_t old_capacity = simplifier->mask + 1;
+    simplifier->entries = entries;
+    simplifier->mask = capacity - 1;
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        if (old[i].key)
+        {
+            size_t index = (size_t)old[i].hash & simplifier->mask;
+            while (entries[index].key)
+            {
+                index = (index + 1) & simplifier->mask;
+            }
+            entries[index] = old[i];
+        }
+    }
+    free(old);
+    return 1;
+}
+
+// Try the node's rules in order until one rewrites it
+static ASTNode *symbolic_rewrite(Simplifier *simplifier, const ASTNode *node)
+{
+    int count;
+    const SimplifyRule *rules = simplify_rules_for(node, &count);
+    if (count == 0)
+    {
+        return NULL;
+    }
+    if (simplifier->stats.steps >= simplifier->max_steps ||
+        simplifier->depth >= SYMBOLIC_MAX_REWRITE_DEPTH)
+    {
+        simplifier->stats.truncated = 1;
+        return NULL;
+    }
+
+    simplifier->depth++;
+    ASTNode *result = NULL;
+    for (int i = 0; i < count && !result && !simplifier->failed; i++)
+    {
+        simplifier->stats.rules_tried++;
+        result = rules[i](simplifier, node);
+    }
+    simplifier->depth--;
+
+    if (result)
+    {
+        simplifier->stats.steps++;
+    }
+    return result;
+}
+
+ASTNode *symbolic_intern(Simplifier *simplifier, ASTNode *node)
+{
+    if (!node)
+    {
+        simplifier->failed = 1;
+        return NULL;
+    }
+
+    uint64_t hash = symbolic_hash(node);
+    SymbolicEntry *entry = symbolic_find(simplifier, node, hash);
+    if (entry->key)
+    {
+        simplifier->stats.memo_hits++;
+        ASTNode *value = entry->value;
+        value->refs++;
+        ast_free(node);
+        return value;
+    }
+
+    // The table keeps one reference to the value, the caller another
+    ASTNode *result = symbolic_rewrite(simplifier, node);
+    if (!result)
+    {
+        node->refs++;
+        result = node;
+    }
+
+    // Rewriting may have grown the table, or met the node again
+    if (simplifier->used + 1 > (simplifier->mask + 1) / 2 && !symbolic_grow(simplifier))
+    {
+        simplifier->failed = 1;
+        ast_free(node);
+        return result;
+    }
+    entry = symbolic_find(simplifier, node, hash);
+    if (entry->key)
+    {
+        ast_free(node);
+        return result;
+    }
+    entry->key = node;
+    entry->value = result;
+    entry->hash = hash;
+    simplifier->used++;
+
+    result->refs++;
+    return result;
+}
+
+// Rebuild a tree bottom up from simplified nodes
+static ASTNode *symbolic_simplify_node(Simplifier *simplifier, const ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        // A fold stands for the expression it was computed from
+        if (node->number.literal->folded_from)
+        {
+            return symbolic_simplify_node(simplifier, node->number.literal->folded_from);
+        }
+        // Fall through
+    case NODE_CONSTANT:
+    case NODE_VARIABLE:
+    {
+        // Leaves seen before need not be copied again
+        SymbolicEntry *entry = symbolic_find(simplifier, node, symbolic_hash(node));
+        if (entry->key)
+        {
+            simplifier->stats.memo_hits++;
+            entry->value->refs++;
+            return entry->value;
+        }
+        return symbolic_intern(simplifier, ast_clone(node));
+    }
+
+    case NODE_BINOP:
+    {
+        ASTNode *left = symbolic_simplify_node(simplifier, node->binop.left);
+        ASTNode *right = left ? symbolic_simplify_node(simplifier, node->binop.right) : NULL;
+        return symbolic_intern(simplifier, ast_create_binop(node->binop.op, left, right));
+    }
+
+    case NODE_UNARY:
+        return symbolic_intern(simplifier,
+                               ast_create_unary(node->unary.op,
+                                                symbolic_simplify_node(simplifier,
+                                                                       node->unary.operand)));
+
+    case NODE_FUNCTION:
+    {
+        int arg_count = node->function.arg_count;
+        ASTNode **args = NULL;
+        if (arg_count && !(args = ast_create_args(NULL, arg_count)))
+        {
+            return symbolic_intern(simplifier, NULL);
+        }
+        for (int i = 0; i < arg_count; i++)
+        {
+            args[i] = symbolic_simplify_node(simplifier, node->function.args[i]);
+            if (!args[i])
+            {
+                ast_free_args(NULL, args, arg_count);
+                return symbolic_intern(simplifier, NULL);
+            }
+        }
+        return symbolic_intern(simplifier,
+                               ast_create_function(node->function.func_type, args, arg_count));
+    }
+
+    case NODE_NARY:
+    {
+        // The rules work on binary operations, so the chain is rebuilt as
+        // the left-leaning tree it was parsed from
+        ASTNode *result = symbolic_simplify_node(simplifier, node->nary.operands[0]);
+        for (int i = 1; result && i < node->nary.count; i++)
+        {
+            const ASTNode *operand = node->nary.operands[i];
+            TokenType op = node->nary.op;
+            if (op == TOKEN_PLUS && operand->type == NODE_UNARY && operand->unary.op == TOKEN_MINUS)
+            {
+                op = TOKEN_MINUS;
+                operand = operand->unary.operand;
+            }
+            ASTNode *right = symbolic_simplify_node(simplifier, operand);
+            if (!right)
+            {
+                ast_free(result);
+                return NULL;
+            }
+            result = symbolic_intern(simplifier, ast_create_binop(op, result, right));
+        }
+        return result;
+    }
+    }
+    return symbolic_intern(simplifier, NULL);
+}
+
+ASTNode *symbolic_simplify(const ASTNode *node, unsigned long max_steps, SymbolicStats *stats)
+{
+    if (stats)
+    {
+        memset(stats, 0, sizeof(*stats));
+    }
+    if (!node)
+    {
+        return NULL;
+    }
+
+    Simplifier simplifier;
+    memset(&simplifier, 0, sizeof(simplifier));
+    simplifier.entries = calloc(SYMBOLIC_TABLE_SLOTS, sizeof(*simplifier.entries));
+    if (!simplifier.entries)
+    {
+        return NULL;
+    }
+    simplifier.mask = SYMBOLIC_TABLE_SLOTS - 1;
+    simplifier.max_steps = max_steps;
+
+    PROFILE_START(start);
+    ASTNode *result = symbolic_simplify_node(&simplifier, node);
+    PROFILE_PHASE(PROFILE_SIMPLIFY, start);
+
+    if (simplifier.failed)
+    {
+        ast_free(result);
+        result = NULL;
+    }
+
+    // The result keeps its own references to the nodes it uses
+    for (size_t i = 0; i <= simplifier.mask; i++)
+    {
+        if (simplifier.entries[i].key)
+        {
+            ast_free(simplifier.entries[i].key);
+            ast_free(simplifier.entries[i].value);
+        }
+    }
+    free(simplifier.entries);
+
+    simplifier.stats.nodes = simplifier.used;
+    if (stats)
+    {
+        *stats = simplifier.stats;
+    }
+    return result;
+}
+
+ASTNode *symbolic_eval(const ASTNode *node)
+{
+    return symbolic_simplify(node, SYMBOLIC_DEFAULT_MAX_STEPS, NULL);
+}
+
+int symbolic_equals(const ASTNode *a, const ASTNode *b)
+{
+    if (a == b)
+    {
+        return 1;
+    }
+    if (!a || !b || a->type != b->type)
+    {
+        return 0;
+    }
+
+    switch (a->type)
+    {
+    case NODE_NUMBER:
+        return mpfr_equal_p(a->number.literal->value, b->number.literal->value);
+    case NODE_CONSTANT:
+        return strcmp(a->constant.name, b->constant.name) == 0;
+    case NODE_VARIABLE:
+        return strcmp(a->variable.name, b->variable.name) == 0;
+    case NODE_BINOP:
+        return a->binop.op == b->binop.op && symbolic_equals(a->binop.left, b->binop.left) &&
+               symbolic_equals(a->binop.right, b->binop.right);
+    case NODE_UNARY:
+        return a->unary.op == b->unary.op && symbolic_equals(a->unary.operand, b->unary.operand);
+    case NODE_FUNCTION:
+        if (a->function.func_type != b->function.func_type ||
+            a->function.arg_count != b->function.arg_count)
+        {
+            return 0;
+        }
+        for (int i = 0; i < a->function.arg_count; i++)
+        {
+            if (!symbolic_equals(a->function.args[i], b->function.args[i]))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    case NODE_NARY:
+        if (a->nary.op != b->nary.op || a->nary.count != b->nary.count)
+        {
+            return 0;
+        }
+        for (int i = 0; i < a->nary.count; i++)
+        {
+            if (!symbolic_equals(a->nary.operands[i], b->nary.operands[i]))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
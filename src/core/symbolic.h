@@ -0,0 +1,79 @@
+#ifndef SYMBOLIC_H
+#define SYMBOLIC_H
+
+#include "ast.h"
+
+// Rewrite steps one simplification may take before it stops where it is
+#define SYMBOLIC_DEFAULT_MAX_STEPS 100000
+
+// Rewrites of rewrites nested deeper than this are left as they are
+#define SYMBOLIC_MAX_REWRITE_DEPTH 256
+
+/**
+ * Counts from one simplification, for tests and the benchmarks
+ */
+typedef struct
+{
+    unsigned long steps;       // Rules that rewrote a node
+    unsigned long rules_tried; // Rules called, whether they matched or not
+    unsigned long memo_hits;   // Nodes answered from the table instead of simplified again
+    unsigned long nodes;       // Distinct nodes in the table at the end
+    int truncated;             // The step cap or depth limit stopped rewriting
+} SymbolicStats;
+
+/**
+ * Simplifier state for one simplification (see symbolic.c)
+ */
+typedef struct Simplifier Simplifier;
+
+/**
+ * Simplify an expression algebraically
+ * Same as symbolic_simplify() with SYMBOLIC_DEFAULT_MAX_STEPS.
+ * @param node Expression to simplify (not modified)
+ * @return New heap tree, or NULL on allocation failure
+ */
+ASTNode *symbolic_eval(const ASTNode *node);
+
+/**
+ * Simplify an expression algebraically
+ *
+ * The tree is rebuilt bottom up. Every node is looked up by its structure
+ * in a table of the nodes seen so far, so a subexpression that occurs many
+ * times is simplified once and the result is a DAG whose equal parts are
+ * the same node (ast_free() counts the references). A node not in the
+ * table is handed to the rules for its node type and operator or
+ * function (see simplify_rules.h) until none applies; what they return is
+ * simplified the same way, so the result is a fixpoint of the rules.
+ *
+ * Integer and rational parts are computed exactly (see rational.h);
+ * decimal literals, constants and variables stay as they are.
+ *
+ * @param node Expression to simplify (not modified)
+ * @param max_steps Rewrites to allow; past them nodes are kept as they are
+ * @param stats Counts to fill in, or NULL
+ * @return New heap tree, or NULL on allocation failure
+ */
+ASTNode *symbolic_simplify(const ASTNode *node, unsigned long max_steps, SymbolicStats *stats);
+
+/**
+ * Find the simplified form of a node built by a rule
+ * The node's children must be simplified already, as everything rules
+ * get and return is. Rules build their results through this, so what
+ * they return is simplified too.
+ * @param simplifier Simplification under way
+ * @param node New node (takes ownership), or NULL
+ * @return Reference to the simplified node, or NULL on allocation failure
+ */
+ASTNode *symbolic_intern(Simplifier *simplifier, ASTNode *node);
+
+/**
+ * Compare two expressions structurally
+ * Numbers compare by value; constants, variables, operators and functions
+ * by name or token.
+ * @param a First expression
+ * @param b Second expression
+ * @return 1 if they are the same expression, 0 otherwise
+ */
+int symbolic_equals(const ASTNode *a, const ASTNode *b);
+
+#endif // SYMBOLIC_H
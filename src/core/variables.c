@@ -0,0 +1,538 @@
+#include "variables.h"
+#include "context.h"
+#include "lexer.h"
+#include "parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Growable list of variable indices
+typedef struct
+{
+    int *items;
+    int count;
+    int capacity;
+} IndexList;
+
+static int index_list_push(IndexList *list, int index)
+{
+    if (list->count == list->capacity)
+    {
+        int capacity = list->capacity ? 2 * list->capacity : 8;
+        int *items = realloc(list->items, (size_t)capacity * sizeof(int));
+        if (!items)
+        {
+            return 0;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = index;
+    return 1;
+}
+
+static int index_list_contains(const IndexList *list, int index)
+{
+    for (int i = 0; i < list->count; i++)
+    {
+        if (list->items[i] == index)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+VariableTable *variables_create(void)
+{
+    return calloc(1, sizeof(VariableTable));
+}
+
+void variables_destroy(VariableTable *table)
+{
+    if (!table)
+    {
+        return;
+    }
+
+    for (int i = 0; i < table->count; i++)
+    {
+        Variable *var = &table->variables[i];
+        free(var->name);
+        ast_free(var->definition);
+        free(var->source);
+        free(var->dependencies);
+        free(var->dependents);
+        mpfr_clear(var->value);
+    }
+    free(table->variables);
+    free(table);
+}
+
+static int variables_index(const VariableTable *table, const char *name)
+{
+    for (int i = 0; i < table->count; i++)
+    {
+        if (strcmp(table->variables[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+Variable *variables_find(VariableTable *table, const char *name)
+{
+    int index = variables_index(table, name);
+    return index >= 0 ? &table->variables[index] : NULL;
+}
+
+// Find a name, adding an undefined entry for it if needed
+static int variables_intern(VariableTable *table, const char *name)
+{
+    int index = variables_index(table, name);
+    if (index >= 0)
+    {
+        return index;
+    }
+
+    if (table->count == table->capacity)
+    {
+        int capacity = table->capacity ? 2 * table->capacity : 16;
+        Variable *variables = realloc(table->variables, (size_t)capacity * sizeof(Variable));
+        if (!variables)
+        {
+            return -1;
+        }
+        table->variables = variables;
+        table->capacity = capacity;
+    }
+
+    Variable *var = &table->variables[table->count];
+    memset(var, 0, sizeof(*var));
+    var->name = strdup(name);
+    if (!var->name)
+    {
+        return -1;
+    }
+    mpfr_init2(var->value, MPFR_PREC_MIN);
+    return table->count++;
+}
+
+// Collect the variables a tree reads, interning names not seen before
+static int collect_dependencies(VariableTable *table, const ASTNode *node, IndexList *deps)
+{
+    if (!node)
+    {
+        return 1;
+    }
+
+    switch (node->type)
+    {
+    case NODE_VARIABLE:
+    {
+        int index = variables_intern(table, node->variable.name);
+        if (index < 0)
+        {
+            return 0;
+        }
+        return index_list_contains(deps, index) || index_list_push(deps, index);
+    }
+    case NODE_NUMBER:
+        return collect_dependencies(table, node->number.literal->folded_from, deps);
+    case NODE_BINOP:
+        return collect_dependencies(table, node->binop.left, deps) &&
+               collect_dependencies(table, node->binop.right, deps);
+    case NODE_UNARY:
+        return collect_dependencies(table, node->unary.operand, deps);
+    case NODE_FUNCTION:
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            if (!collect_dependencies(table, node->function.args[i], deps))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    case NODE_NARY:
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            if (!collect_dependencies(table, node->nary.operands[i], deps))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    default:
+        return 1;
+    }
+}
+
+// Check whether target is reachable from any of deps through dependency
+// edges; returns -1 if the walk ran out of memory
+static int reaches(VariableTable *table, const IndexList *deps, int target)
+{
+    unsigned stamp = ++table->visit_stamp;
+    IndexList stack = {0};
+    int found = 0;
+
+    for (int i = 0; i < deps->count && !found; i++)
+    {
+        if (!index_list_push(&stack, deps->items[i]))
+        {
+            found = -1;
+            break;
+        }
+    }
+
+    while (!found && stack.count > 0)
+    {
+        int index = stack.items[--stack.count];
+        if (index == target)
+        {
+            found = 1;
+            break;
+        }
+
+        Variable *var = &table->variables[index];
+        if (var->visit == stamp)
+        {
+            continue;
+        }
+        var->visit = stamp;
+        for (int i = 0; i < var->dependency_count; i++)
+        {
+            if (!index_list_push(&stack, var->dependencies[i]))
+            {
+                found = -1;
+                break;
+            }
+        }
+    }
+
+    free(stack.items);
+    return found;
+}
+
+static void remove_dependent(Variable *var, int dependent)
+{
+    for (int i = 0; i < var->dependent_count; i++)
+    {
+        if (var->dependents[i] == dependent)
+        {
+            var->dependents[i] = var->dependents[--var->dependent_count];
+            return;
+        }
+    }
+}
+
+// Make room for one more dependent so that adding it cannot fail
+static int reserve_dependent(Variable *var)
+{
+    if (var->dependent_count < var->dependent_capacity)
+    {
+        return 1;
+    }
+
+    int capacity = var->dependent_capacity ? 2 * var->dependent_capacity : 4;
+    int *dependents = realloc(var->dependents, (size_t)capacity * sizeof(int));
+    if (!dependents)
+    {
+        return 0;
+    }
+    var->dependents = dependents;
+    var->dependent_capacity = capacity;
+    return 1;
+}
+
+// Mark a variable and everything depending on it as needing recomputation
+static void mark_dirty(VariableTable *table, int index)
+{
+    unsigned stamp = ++table->visit_stamp;
+    IndexList queue = {0};
+
+    table->variables[index].current = 0;
+    table->variables[index].visit = stamp;
+    if (!index_list_push(&queue, index))
+    {
+        // Without a queue, forget every value instead
+        for (int i = 0; i < table->count; i++)
+        {
+            table->variables[i].current = 0;
+        }
+        return;
+    }
+
+    for (int head = 0; head < queue.count; head++)
+    {
+        Variable *var = &table->variables[queue.items[head]];
+        for (int i = 0; i < var->dependent_count; i++)
+        {
+            Variable *dependent = &table->variables[var->dependents[i]];
+            if (dependent->visit == stamp)
+            {
+                continue;
+            }
+            dependent->visit = stamp;
+            dependent->current = 0;
+            if (!index_list_push(&queue, var->dependents[i]))
+            {
+                for (int j = 0; j < table->count; j++)
+                {
+                    table->variables[j].current = 0;
+                }
+                free(queue.items);
+                return;
+            }
+        }
+    }
+
+    free(queue.items);
+}
+
+int variables_define(VariableTable *table, const char *name, ASTNode *definition)
+{
+    table->error[0] = '\0';
+
+    IndexList deps = {0};
+    int index = variables_intern(table, name);
+    if (index < 0 || !collect_dependencies(table, definition, &deps))
+    {
+        snprintf(table->error, sizeof(table->error), "Out of memory");
+        free(deps.items);
+        ast_free(definition);
+        return -1;
+    }
+
+    int cycle = index_list_contains(&deps, index) ? 1 : reaches(table, &deps, index);
+    if (cycle)
+    {
+        if (cycle > 0)
+        {
+            snprintf(table->error, sizeof(table->error), "Circular definition of %.200s", name);
+        }
+        else
+        {
+            snprintf(table->error, sizeof(table->error), "Out of memory");
+        }
+        free(deps.items);
+        ast_free(definition);
+        return -1;
+    }
+
+    // Reserve the reverse edges first so a failure leaves the graph intact
+    for (int i = 0; i < deps.count; i++)
+    {
+        if (!reserve_dependent(&table->variables[deps.items[i]]))
+        {
+            snprintf(table->error, sizeof(table->error), "Out of memory");
+            free(deps.items);
+            ast_free(definition);
+            return -1;
+        }
+    }
+
+    Variable *var = &table->variables[index];
+    for (int i = 0; i < var->dependency_count; i++)
+    {
+        remove_dependent(&table->variables[var->dependencies[i]], index);
+    }
+    for (int i = 0; i < deps.count; i++)
+    {
+        Variable *dep = &table->variables[deps.items[i]];
+        dep->dependents[dep->dependent_count++] = index;
+    }
+
+    free(var->dependencies);
+    var->dependencies = deps.items;
+    var->dependency_count = deps.count;
+    ast_free(var->definition);
+    var->definition = definition;
+    free(var->source);
+    var->source = NULL;
+
+    mark_dirty(table, index);
+    return index;
+}
+
+int variables_set_value(VariableTable *table, const char *name, mpfr_srcptr value)
+{
+    int index = variables_index(table, name);
+    ASTNode *definition = index >= 0 ? table->variables[index].definition : NULL;
+    if (!definition || definition->type != NODE_NUMBER || definition->arena ||
+        definition->number.literal->folded_from)
+    {
+        definition = ast_create_number_at(NULL, "0", 0, mpfr_get_prec(value));
+        if (!definition)
+        {
+            snprintf(table->error, sizeof(table->error), "Out of memory");
+            return -1;
+        }
+        mpfr_set(definition->number.literal->value, value, MPFR_RNDN);
+        return variables_define(table, name, definition);
+    }
+
+    // A literal reads nothing, so only the dependents change
+    table->error[0] = '\0';
+    free(table->variables[index].source);
+    table->variables[index].source = NULL;
+    mpfr_set_prec(definition->number.literal->value, mpfr_get_prec(value));
+    mpfr_set(definition->number.literal->value, value, MPFR_RNDN);
+    mark_dirty(table, index);
+    return index;
+}
+
+VariableTable *variables_copy(const VariableTable *table)
+{
+    VariableTable *copy = variables_create();
+    if (!copy)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < table->count; i++)
+    {
+        const Variable *var = &table->variables[i];
+        if (variables_intern(copy, var->name) != i)
+        {
+            variables_destroy(copy);
+            return NULL;
+        }
+    }
+
+    // Same names at the same indices, so the edges carry over as they are
+    for (int i = 0; i < table->count; i++)
+    {
+        const Variable *var = &table->variables[i];
+        Variable *dst = &copy->variables[i];
+        size_t dependencies = (size_t)var->dependency_count * sizeof(int);
+        size_t dependents = (size_t)var->dependent_count * sizeof(int);
+        dst->definition = ast_clone(var->definition);
+        dst->source = var->source ? strdup(var->source) : NULL;
+        dst->source_precision = var->source_precision;
+        dst->dependencies = dependencies ? malloc(dependencies) : NULL;
+        dst->dependents = dependents ? malloc(dependents) : NULL;
+        if ((var->definition && !dst->definition) || (var->source && !dst->source) ||
+            (dependencies && !dst->dependencies) || (dependents && !dst->dependents))
+        {
+            variables_destroy(copy);
+            return NULL;
+        }
+        if (dependencies)
+            memcpy(dst->dependencies, var->dependencies, dependencies);
+        if (dependents)
+            memcpy(dst->dependents, var->dependents, dependents);
+        dst->dependency_count = var->dependency_count;
+        dst->dependent_count = var->dependent_count;
+        dst->dependent_capacity = var->dependent_count;
+    }
+
+    return copy;
+}
+
+int variables_set_source(VariableTable *table, int index, const char *source,
+                         mpfr_prec_t precision)
+{
+    Variable *var = &table->variables[index];
+    char *copy = strdup(source);
+    if (!copy)
+    {
+        snprintf(table->error, sizeof(table->error), "Out of memory");
+        return -1;
+    }
+    free(var->source);
+    var->source = copy;
+    var->source_precision = precision;
+    return 0;
+}
+
+void variables_refresh(VariableTable *table, Variable *var, mpfr_prec_t precision)
+{
+    if (!var->source || var->source_precision == precision)
+    {
+        return;
+    }
+
+    // The same text reads the same names, so the dependency edges stand
+    Lexer lexer;
+    lexer_init(&lexer, var->source);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_quiet(&parser, 1);
+    parser_set_precision(&parser, precision);
+    ASTNode *definition = parser_parse_expression(&parser);
+    int parsed = definition && !parser_has_error(&parser) &&
+                 parser.current_token.type == TOKEN_EOF;
+    token_free(&parser.previous_token);
+    token_free(&parser.current_token);
+    if (!parsed)
+    {
+        ast_free(definition);
+        return;
+    }
+
+    ast_free(var->definition);
+    var->definition = definition;
+    var->source_precision = precision;
+    mark_dirty(table, (int)(var - table->variables));
+}
+
+const char *variables_pending(VariableTable *table, int index)
+{
+    unsigned stamp = ++table->visit_stamp;
+    IndexList stack = {0};
+    const char *pending = NULL;
+    if (!index_list_push(&stack, index))
+    {
+        return NULL;
+    }
+    table->variables[index].visit = stamp;
+
+    while (!pending && stack.count > 0)
+    {
+        Variable *var = &table->variables[stack.items[--stack.count]];
+        if (!var->definition)
+        {
+            pending = var->name;
+            break;
+        }
+        for (int i = 0; i < var->dependency_count; i++)
+        {
+            Variable *dep = &table->variables[var->dependencies[i]];
+            if (dep->visit == stamp)
+            {
+                continue;
+            }
+            dep->visit = stamp;
+            if (!index_list_push(&stack, var->dependencies[i]))
+            {
+                break;
+            }
+        }
+    }
+
+    free(stack.items);
+    return pending;
+}
+
+int variables_is_current(const Variable *var, const EvalContext *ctx)
+{
+    return var->current && var->value_precision == ctx->scratch_precision &&
+           var->value_rounding == ctx->rounding && var->value_strict_mode == ctx->strict_mode &&
+           var->value_strict_domain == ctx->strict_domain;
+}
+
+void variables_set_current(Variable *var, const EvalContext *ctx)
+{
+    var->current = 1;
+    var->value_precision = ctx->scratch_precision;
+    var->value_rounding = ctx->rounding;
+    var->value_strict_mode = ctx->strict_mode;
+    var->value_strict_domain = ctx->strict_domain;
+    var->evaluations++;
+}
+
+const char *variables_get_error(const VariableTable *table)
+{
+    return table->error[0] ? table->error : NULL;
+}
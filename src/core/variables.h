@@ -0,0 +1,177 @@
+#ifndef VARIABLES_H
+#define VARIABLES_H
+
+#include "ast.h"
+#include <mpfr.h>
+
+typedef struct EvalContext EvalContext;
+
+// Size of a variable table's error message
+#define VARIABLES_ERROR_SIZE 256
+
+/**
+ * One name in a variable table.
+ *
+ * A name referenced by a definition before it is defined itself gets an
+ * entry without a definition, so that defining it later finds its
+ * dependents. Values are computed lazily: reading a variable whose value is
+ * not current evaluates its definition and keeps the result.
+ *
+ * A definition with literals that are not exact integers, such as 0.1,
+ * can keep the text it was parsed from; it is parsed again when read at
+ * another precision, so its literals are as precise as the reader's.
+ */
+typedef struct
+{
+    char *name;
+    ASTNode *definition; // Owned heap tree, NULL if not defined yet
+    char *source;        // Text the definition was parsed from, NULL if not kept
+    mpfr_prec_t source_precision; // Precision the definition's literals were read at
+
+    int *dependencies; // Variables the definition reads (indices, no duplicates)
+    int dependency_count;
+    int *dependents; // Variables whose definitions read this one
+    int dependent_count;
+    int dependent_capacity;
+
+    // Value of the definition, valid while current is set and the settings
+    // below match the context's
+    mpfr_t value;
+    int current;
+    mpfr_prec_t value_precision;
+    mpfr_rnd_t value_rounding;
+    int value_strict_mode;
+    int value_strict_domain;
+
+    unsigned long evaluations; // Times the definition was evaluated and kept
+    unsigned visit;            // Graph walk marker
+} Variable;
+
+/**
+ * Named definitions and the dependency edges between them.
+ *
+ * A table is attached to a context through its variables field; a table
+ * should be used by one thread at a time.
+ */
+typedef struct VariableTable
+{
+    Variable *variables;
+    int count;
+    int capacity;
+    unsigned visit_stamp;
+    char error[VARIABLES_ERROR_SIZE];
+} VariableTable;
+
+/**
+ * Create an empty variable table
+ * @return New table or NULL on allocation failure
+ */
+VariableTable *variables_create(void);
+
+/**
+ * Free a variable table with every definition and value
+ * @param table Table to free (can be NULL)
+ */
+void variables_destroy(VariableTable *table);
+
+/**
+ * Define or redefine a variable
+ *
+ * The variable and everything depending on it, directly or not, are marked
+ * dirty and recomputed the next time they are read. A definition reading
+ * itself, directly or through other variables, is rejected and the old
+ * definition kept.
+ *
+ * @param table Table to change
+ * @param name Variable name
+ * @param definition Heap-allocated tree (not in an arena); the table takes
+ *                   ownership and frees it on failure
+ * @return Variable index, or -1 on error (see variables_get_error())
+ */
+int variables_define(VariableTable *table, const char *name, ASTNode *definition);
+
+/**
+ * Define or redefine a variable as a number
+ * The same as defining it as a literal, but a variable that already holds a
+ * number keeps its node, so repeated assignments do not allocate.
+ * @param table Table to change
+ * @param name Variable name
+ * @param value New value (copied with its precision)
+ * @return Variable index, or -1 on error (see variables_get_error())
+ */
+int variables_set_value(VariableTable *table, const char *name, mpfr_srcptr value);
+
+/**
+ * Copy a table's definitions into a new table
+ * Values are not copied; the copy computes them again when they are read.
+ * @param table Table to copy
+ * @return New table or NULL on allocation failure
+ */
+VariableTable *variables_copy(const VariableTable *table);
+
+/**
+ * Keep the text a variable's definition was parsed from
+ * Only worth it for definitions with inexact literals (see
+ * Parser.inexact_literals); others read the same at every precision.
+ * Redefining the variable drops the text.
+ * @param table Table holding the variable
+ * @param index Variable index returned by variables_define()
+ * @param source Text of the definition's expression (copied)
+ * @param precision Precision its literals were read at
+ * @return 0 on success, -1 if out of memory (the text is then not kept)
+ */
+int variables_set_source(VariableTable *table, int index, const char *source,
+                         mpfr_prec_t precision);
+
+/**
+ * Read a variable's definition again with its literals at a precision
+ * Does nothing for a definition without kept text or already read at that
+ * precision. The variable and its dependents are recomputed when next read.
+ * If the text no longer parses (out of memory), the old definition stays.
+ * @param table Table holding the variable
+ * @param var Variable to refresh
+ * @param precision Precision of the context about to read it
+ */
+void variables_refresh(VariableTable *table, Variable *var, mpfr_prec_t precision);
+
+/**
+ * Find a variable a definition cannot be evaluated without
+ * @param table Table holding the variable
+ * @param index Variable index
+ * @return Name of a variable read by the definition, directly or through
+ *         other definitions, that is not defined yet, or NULL if none
+ */
+const char *variables_pending(VariableTable *table, int index);
+
+/**
+ * Look up a variable by name
+ * @param table Table to search
+ * @param name Variable name
+ * @return Variable, or NULL if the name was never defined or referenced
+ */
+Variable *variables_find(VariableTable *table, const char *name);
+
+/**
+ * Check whether a variable's value can be used in a context
+ * @param var Variable to check
+ * @param ctx Context the value would be used in
+ * @return 1 if the value is current and was computed with the context's
+ *         working precision, rounding and strict flags
+ */
+int variables_is_current(const Variable *var, const EvalContext *ctx);
+
+/**
+ * Mark a variable's value as computed in a context
+ * @param var Variable whose value was just computed
+ * @param ctx Context it was computed in
+ */
+void variables_set_current(Variable *var, const EvalContext *ctx);
+
+/**
+ * Get the last error of a variable table
+ * @param table Table to inspect
+ * @return Error message or NULL if no error
+ */
+const char *variables_get_error(const VariableTable *table);
+
+#endif // VARIABLES_H
@@ -1,64 +1,99 @@
 #include "function_table.h"
+#include "function_registry.h"
 #include <string.h>
 #include <stddef.h>
 
 // Function and constant lookup table
 static const FunctionInfo function_table[] = {
     // Trigonometric functions
-    {"sin", TOKEN_SIN, 1},
-    {"cos", TOKEN_COS, 1},
-    {"tan", TOKEN_TAN, 1},
+    {"sin", TOKEN_SIN, 1, CONST_COUNT},
+    {"cos", TOKEN_COS, 1, CONST_COUNT},
+    {"tan", TOKEN_TAN, 1, CONST_COUNT},
 
     // Inverse trigonometric functions
-    {"asin", TOKEN_ASIN, 1},
-    {"arcsin", TOKEN_ASIN, 1},
-    {"acos", TOKEN_ACOS, 1},
-    {"arccos", TOKEN_ACOS, 1},
-    {"atan", TOKEN_ATAN, 1},
-    {"arctan", TOKEN_ATAN, 1},
-    {"atan2", TOKEN_ATAN2, 2},
-    {"arctan2", TOKEN_ATAN2, 2},
+    {"asin", TOKEN_ASIN, 1, CONST_COUNT},
+    {"arcsin", TOKEN_ASIN, 1, CONST_COUNT},
+    {"acos", TOKEN_ACOS, 1, CONST_COUNT},
+    {"arccos", TOKEN_ACOS, 1, CONST_COUNT},
+    {"atan", TOKEN_ATAN, 1, CONST_COUNT},
+    {"arctan", TOKEN_ATAN, 1, CONST_COUNT},
+    {"atan2", TOKEN_ATAN2, 2, CONST_COUNT},
+    {"arctan2", TOKEN_ATAN2, 2, CONST_COUNT},
 
     // Hyperbolic functions
-    {"sinh", TOKEN_SINH, 1},
-    {"cosh", TOKEN_COSH, 1},
-    {"tanh", TOKEN_TANH, 1},
+    {"sinh", TOKEN_SINH, 1, CONST_COUNT},
+    {"cosh", TOKEN_COSH, 1, CONST_COUNT},
+    {"tanh", TOKEN_TANH, 1, CONST_COUNT},
 
     // Inverse hyperbolic functions
-    {"asinh", TOKEN_ASINH, 1},
-    {"arcsinh", TOKEN_ASINH, 1},
-    {"acosh", TOKEN_ACOSH, 1},
-    {"arccosh", TOKEN_ACOSH, 1},
-    {"atanh", TOKEN_ATANH, 1},
-    {"arctanh", TOKEN_ATANH, 1},
+    {"asinh", TOKEN_ASINH, 1, CONST_COUNT},
+    {"arcsinh", TOKEN_ASINH, 1, CONST_COUNT},
+    {"acosh", TOKEN_ACOSH, 1, CONST_COUNT},
+    {"arccosh", TOKEN_ACOSH, 1, CONST_COUNT},
+    {"atanh", TOKEN_ATANH, 1, CONST_COUNT},
+    {"arctanh", TOKEN_ATANH, 1, CONST_COUNT},
 
     // Other mathematical functions
-    {"sqrt", TOKEN_SQRT, 1},
-    {"log", TOKEN_LOG, 1},     // Natural logarithm
-    {"ln", TOKEN_LOG, 1},      // Natural logarithm (alias)
-    {"log10", TOKEN_LOG10, 1}, // Base-10 logarithm
-    {"exp", TOKEN_EXP, 1},
-    {"abs", TOKEN_ABS, 1},
-    {"floor", TOKEN_FLOOR, 1},
-    {"ceil", TOKEN_CEIL, 1},
-    {"pow", TOKEN_POW, 2},
+    {"sqrt", TOKEN_SQRT, 1, CONST_COUNT},
+    {"log", TOKEN_LOG, 1, CONST_COUNT},     // Natural logarithm
+    {"ln", TOKEN_LOG, 1, CONST_COUNT},      // Natural logarithm (alias)
+    {"log10", TOKEN_LOG10, 1, CONST_COUNT}, // Base-10 logarithm
+    {"exp", TOKEN_EXP, 1, CONST_COUNT},
+    {"abs", TOKEN_ABS, 1, CONST_COUNT},
+    {"floor", TOKEN_FLOOR, 1, CONST_COUNT},
+    {"ceil", TOKEN_CEIL, 1, CONST_COUNT},
+    {"pow", TOKEN_POW, 2, CONST_COUNT},
+
+    // Reductions over a variable the call binds
+    {"sum", TOKEN_SUM, 4, CONST_COUNT},
+    {"integrate", TOKEN_INTEGRATE, 4, CONST_COUNT},
 
     // Mathematical constants (all use TOKEN_CONSTANT now)
-    {"pi", TOKEN_CONSTANT, -1},
-    {"PI", TOKEN_CONSTANT, -1},
-    {"e", TOKEN_CONSTANT, -1},
-    {"E", TOKEN_CONSTANT, -1},
-    {"ln2", TOKEN_CONSTANT, -1},
-    {"LN2", TOKEN_CONSTANT, -1},
-    {"ln10", TOKEN_CONSTANT, -1},
-    {"LN10", TOKEN_CONSTANT, -1},
-    {"gamma", TOKEN_CONSTANT, -1},
-    {"GAMMA", TOKEN_CONSTANT, -1},
-    {"sqrt2", TOKEN_CONSTANT, -1},
-    {"SQRT2", TOKEN_CONSTANT, -1},
-
-    {NULL, TOKEN_INVALID, 0} // Sentinel
+    {"pi", TOKEN_CONSTANT, -1, CONST_PI},
+    {"PI", TOKEN_CONSTANT, -1, CONST_PI},
+    {"e", TOKEN_CONSTANT, -1, CONST_E},
+    {"E", TOKEN_CONSTANT, -1, CONST_E},
+    {"ln2", TOKEN_CONSTANT, -1, CONST_LN2},
+    {"LN2", TOKEN_CONSTANT, -1, CONST_LN2},
+    {"ln10", TOKEN_CONSTANT, -1, CONST_LN10},
+    {"LN10", TOKEN_CONSTANT, -1, CONST_LN10},
+    {"gamma", TOKEN_CONSTANT, -1, CONST_GAMMA},
+    {"GAMMA", TOKEN_CONSTANT, -1, CONST_GAMMA},
+    {"sqrt2", TOKEN_CONSTANT, -1, CONST_SQRT2},
+    {"SQRT2", TOKEN_CONSTANT, -1, CONST_SQRT2},
+
+    {NULL, TOKEN_INVALID, 0, CONST_COUNT} // Sentinel
+};
+
+// Perfect hash over function_table: every name above lands in its own slot,
+// which holds the name's index in the table (-1 for unused slots). The
+// size and multipliers are the smallest without collisions; after changing
+// the names, run make function-hash to search again (make test checks the
+// table is current).
+// BEGIN function hash, generated by make function-hash
+#define FUNCTION_HASH_SIZE 128
+#define FUNCTION_HASH_LENGTH_FACTOR 21
+#define FUNCTION_HASH_LAST_FACTOR 11
+
+static const signed char function_slots[FUNCTION_HASH_SIZE] = {
+    -1, 37, 1, -1, -1, -1, 31, 21, -1, -1, -1, -1, 4, 8, 10, -1,
+    -1, -1, -1, -1, -1, 5, 34, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, 12, 18, 26, -1, -1, -1, -1, -1, -1, 14, -1, 11, 13, -1,
+    -1, 16, -1, 6, 42, 20, 33, -1, -1, -1, -1, 28, -1, -1, 22, 35,
+    -1, -1, -1, -1, 27, -1, -1, -1, 40, -1, -1, -1, 23, -1, 2, 17,
+    7, 9, -1, -1, -1, 0, 29, -1, 3, -1, -1, -1, -1, -1, -1, 15,
+    19, 38, -1, -1, 30, -1, 32, -1, 39, -1, -1, -1, 24, -1, -1, -1,
+    -1, -1, -1, 25, 41, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 36,
 };
+// END function hash
+
+static size_t function_hash(const char *name, size_t length)
+{
+    const unsigned char *text = (const unsigned char *)name;
+    return (length * FUNCTION_HASH_LENGTH_FACTOR + text[0] +
+            text[length - 1] * FUNCTION_HASH_LAST_FACTOR + text[length / 2]) &
+           (FUNCTION_HASH_SIZE - 1);
+}
 
 void function_table_init(void)
 {
@@ -71,31 +106,53 @@ const FunctionInfo *function_table_lookup(const char *name)
     {
         return NULL;
     }
+    return function_table_lookup_length(name, strlen(name));
+}
 
-    for (int i = 0; function_table[i].name != NULL; i++)
+const FunctionInfo *function_table_lookup_length(const char *name, size_t length)
+{
+    if (!name || length == 0)
     {
-        if (strcmp(function_table[i].name, name) == 0)
-        {
-            return &function_table[i];
-        }
+        return NULL;
+    }
+
+    int index = function_slots[function_hash(name, length)];
+    if (index < 0)
+    {
+        return NULL;
     }
-    return NULL;
+
+    const FunctionInfo *info = &function_table[index];
+    if (strncmp(info->name, name, length) != 0 || info->name[length] != '\0')
+    {
+        return NULL;
+    }
+    return info;
 }
 
-int function_table_get_arg_count(TokenType type)
+const FunctionInfo *function_table_entry(int index)
 {
-    for (int i = 0; function_table[i].name != NULL; i++)
+    int count = (int)(sizeof(function_table) / sizeof(function_table[0])) - 1;
+    if (index < 0 || index >= count)
     {
-        if (function_table[i].token == type)
-        {
-            return function_table[i].arg_count;
-        }
+        return NULL;
     }
-    return 0;
+    return &function_table[index];
+}
+
+int function_table_get_arg_count(TokenType type)
+{
+    const FunctionDef *def = function_registry_get(type);
+    return def ? def->arg_count : 0;
 }
 
 const char *function_table_get_name(TokenType type)
 {
+    const FunctionDef *def = function_registry_get(type);
+    if (def)
+    {
+        return def->name;
+    }
     for (int i = 0; function_table[i].name != NULL; i++)
     {
         if (function_table[i].token == type)
@@ -109,21 +166,5 @@ const char *function_table_get_name(TokenType type)
 int function_table_needs_parentheses(TokenType type)
 {
     // Constants don't need parentheses, functions do
-    const FunctionInfo *info = NULL;
-    for (int i = 0; function_table[i].name != NULL; i++)
-    {
-        if (function_table[i].token == type)
-        {
-            info = &function_table[i];
-            break;
-        }
-    }
-
-    if (!info)
-    {
-        return 0;
-    }
-
-    // If arg_count is -1, it's a constant
-    return info->arg_count >= 0;
-}
\ No newline at end of file
+    return function_registry_get(type) != NULL;
+}
@@ -2,12 +2,15 @@
 #define FUNCTION_TABLE_H
 
 #include "tokens.h"
+#include "constants.h"
+#include <stddef.h>
 
 typedef struct
 {
     const char *name;
     TokenType token;
-    int arg_count; // Number of arguments (-1 for constants)
+    int arg_count;         // Number of arguments (-1 for constants)
+    ConstantType constant; // Constant named, or CONST_COUNT for functions
 } FunctionInfo;
 
 /**
@@ -23,7 +26,23 @@ void function_table_init(void);
 const FunctionInfo *function_table_lookup(const char *name);
 
 /**
- * Get argument count for a function token
+ * Look up function or constant by a name that need not be NUL-terminated
+ * Uses a perfect hash, so no more than one entry is compared.
+ * @param name Start of the name
+ * @param length Number of characters in the name
+ * @return Function info or NULL if not found
+ */
+const FunctionInfo *function_table_lookup_length(const char *name, size_t length);
+
+/**
+ * Get an entry of the table by position, for walking every name
+ * @param index Position in the table
+ * @return Function info, or NULL past the last entry
+ */
+const FunctionInfo *function_table_entry(int index);
+
+/**
+ * Get argument count for a function token, from its registry entry
  * @param type Function token type
  * @return Number of arguments, or 0 if not a function
  */
@@ -31,6 +50,7 @@ int function_table_get_arg_count(TokenType type);
 
 /**
  * Get function name from token type
+ * Registered functions are named too (see function_registry.h).
  * @param type Function token type
  * @return Function name or "unknown"
  */
@@ -1,5 +1,6 @@
 #include "lexer.h"
 #include "function_table.h"
+#include "function_registry.h"
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,31 +11,34 @@
 // Maximum input length to prevent DoS attacks
 #define MAX_INPUT_LENGTH 1024
 
+// Longest number lexed as one token
+#define LEXER_MAX_NUMBER_LENGTH 255
+
 static void lexer_advance(Lexer *lexer);
 static void lexer_skip_whitespace(Lexer *lexer);
 static Token lexer_lex_number(Lexer *lexer);
 static Token lexer_lex_identifier(Lexer *lexer);
+static Token lexer_token(TokenType type, size_t start, size_t end);
 
 void lexer_init(Lexer *lexer, const char *input)
 {
-    if (!lexer || !input)
+    lexer_init_length(lexer, input, input ? strlen(input) : 0);
+
+    // Reject overly long input
+    if (lexer && lexer->input_length > MAX_INPUT_LENGTH)
     {
-        if (lexer)
-        {
-            lexer->text = "";
-            lexer->pos = 0;
-            lexer->current_char = '\0';
-            lexer->input_length = 0;
-        }
-        return;
+        lexer_init_length(lexer, NULL, 0);
     }
+}
 
-    lexer->text = input;
-    lexer->pos = 0;
-    lexer->input_length = strlen(input);
+void lexer_init_length(Lexer *lexer, const char *input, size_t length)
+{
+    if (!lexer)
+    {
+        return;
+    }
 
-    // Reject overly long input
-    if (lexer->input_length > MAX_INPUT_LENGTH)
+    if (!input)
     {
         lexer->text = "";
         lexer->pos = 0;
@@ -43,7 +47,10 @@ void lexer_init(Lexer *lexer, const char *input)
         return;
     }
 
-    lexer->current_char = lexer->input_length > 0 ? input[0] : '\0';
+    lexer->text = input;
+    lexer->pos = 0;
+    lexer->input_length = length;
+    lexer->current_char = length > 0 ? input[0] : '\0';
 }
 
 static void lexer_advance(Lexer *lexer)
@@ -93,15 +100,19 @@ static void lexer_skip_whitespace(Lexer *lexer)
     }
 }
 
+static Token lexer_token(TokenType type, size_t start, size_t end)
+{
+    return (Token){.type = type, .int_value = 0, .offset = start, .length = end - start};
+}
+
 static Token lexer_lex_number(Lexer *lexer)
 {
     if (!lexer)
     {
-        return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+        return lexer_token(TOKEN_INVALID, 0, 0);
     }
 
-    char buffer[256];
-    size_t buf_idx = 0;
+    size_t start = lexer->pos;
     int has_dot = 0;
     int has_exponent = 0;
     int digit_count = 0;
@@ -109,12 +120,12 @@ static Token lexer_lex_number(Lexer *lexer)
     // Handle edge case: single dot without digits
     if (lexer->current_char == '.' && !isdigit(lexer_peek(lexer)))
     {
-        return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+        return lexer_token(TOKEN_INVALID, start, start);
     }
 
     // Parse the integer/fractional part
     while ((isdigit(lexer->current_char) || lexer->current_char == '.') &&
-           lexer->current_char != '\0' && buf_idx < sizeof(buffer) - 1)
+           lexer->current_char != '\0' && lexer->pos - start < LEXER_MAX_NUMBER_LENGTH)
     {
 
         if (lexer->current_char == '.')
@@ -122,14 +133,14 @@ static Token lexer_lex_number(Lexer *lexer)
             if (has_dot)
             {
                 // Multiple dots: invalid
-                return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+                return lexer_token(TOKEN_INVALID, start, lexer->pos);
             }
 
             // Check for '.' not followed by digit (unless we already have digits)
             char next = lexer_peek(lexer);
             if (!isdigit(next) && digit_count == 0)
             {
-                return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+                return lexer_token(TOKEN_INVALID, start, lexer->pos);
             }
 
             has_dot = 1;
@@ -139,14 +150,13 @@ static Token lexer_lex_number(Lexer *lexer)
             digit_count++;
         }
 
-        buffer[buf_idx++] = lexer->current_char;
         lexer_advance(lexer);
     }
 
     // Must have at least one digit
     if (digit_count == 0)
     {
-        return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+        return lexer_token(TOKEN_INVALID, start, lexer->pos);
     }
 
     // Check for scientific notation
@@ -159,64 +169,59 @@ static Token lexer_lex_number(Lexer *lexer)
         {
             has_exponent = 1;
 
-            if (buf_idx >= sizeof(buffer) - 1)
+            if (lexer->pos - start >= LEXER_MAX_NUMBER_LENGTH)
             {
-                return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+                return lexer_token(TOKEN_INVALID, start, lexer->pos);
             }
 
-            // Add the 'e' or 'E'
-            buffer[buf_idx++] = lexer->current_char;
+            // Consume the 'e' or 'E'
             lexer_advance(lexer);
 
             // Handle optional sign
             if (lexer->current_char == '+' || lexer->current_char == '-')
             {
-                if (buf_idx >= sizeof(buffer) - 1)
+                if (lexer->pos - start >= LEXER_MAX_NUMBER_LENGTH)
                 {
-                    return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+                    return lexer_token(TOKEN_INVALID, start, lexer->pos);
                 }
-                buffer[buf_idx++] = lexer->current_char;
                 lexer_advance(lexer);
             }
 
             // Parse exponent digits
             int exp_digit_count = 0;
             while (isdigit(lexer->current_char) && lexer->current_char != '\0' &&
-                   buf_idx < sizeof(buffer) - 1)
+                   lexer->pos - start < LEXER_MAX_NUMBER_LENGTH)
             {
-                buffer[buf_idx++] = lexer->current_char;
                 exp_digit_count++;
                 lexer_advance(lexer);
             }
 
             if (exp_digit_count == 0)
             {
-                return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+                return lexer_token(TOKEN_INVALID, start, lexer->pos);
             }
         }
     }
 
-    buffer[buf_idx] = '\0';
-
-    // Create a copy of the number string
-    char *number_str = malloc(strlen(buffer) + 1);
-    if (!number_str)
-    {
-        return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
-    }
-    strcpy(number_str, buffer);
+    // strtod() and strtol() need terminated text; the copy stays on the stack
+    char buffer[LEXER_MAX_NUMBER_LENGTH + 1];
+    size_t length = lexer->pos - start;
+    memcpy(buffer, lexer->text + start, length);
+    buffer[length] = '\0';
 
     // Determine token type
+    Token token = lexer_token(TOKEN_FLOAT, start, lexer->pos);
     if (has_dot || has_exponent)
     {
         errno = 0;
         double val = strtod(buffer, NULL);
         if (errno == ERANGE || isinf(val) || isnan(val))
         {
-            free(number_str);
-            return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+            token.type = TOKEN_INVALID;
+            return token;
         }
-        return (Token){.type = TOKEN_FLOAT, .float_value = val, .number_string = number_str};
+        token.float_value = val;
+        return token;
     }
     else
     {
@@ -225,13 +230,17 @@ static Token lexer_lex_number(Lexer *lexer)
         if (errno == ERANGE)
         {
             // Treat as float for MPFR processing
-            return (Token){.type = TOKEN_FLOAT, .float_value = 0.0, .number_string = number_str};
+            token.float_value = 0.0;
+            return token;
         }
         if (val > INT_MAX || val < INT_MIN)
         {
-            return (Token){.type = TOKEN_FLOAT, .float_value = (double)val, .number_string = number_str};
+            token.float_value = (double)val;
+            return token;
         }
-        return (Token){.type = TOKEN_INT, .int_value = (int)val, .number_string = number_str};
+        token.type = TOKEN_INT;
+        token.int_value = (int)val;
+        return token;
     }
 }
 
@@ -239,60 +248,49 @@ static Token lexer_lex_identifier(Lexer *lexer)
 {
     if (!lexer)
     {
-        return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+        return lexer_token(TOKEN_INVALID, 0, 0);
     }
 
-    char buffer[64];
-    size_t buf_idx = 0;
+    size_t start = lexer->pos;
 
     // Read alphanumeric characters and underscores
     while ((isalnum(lexer->current_char) || lexer->current_char == '_') &&
-           lexer->current_char != '\0' && buf_idx < sizeof(buffer) - 1)
+           lexer->current_char != '\0' && lexer->pos - start < LEXER_MAX_IDENTIFIER_LENGTH)
     {
-        buffer[buf_idx++] = lexer->current_char;
         lexer_advance(lexer);
     }
 
-    buffer[buf_idx] = '\0';
+    Token token = lexer_token(TOKEN_IDENTIFIER, start, lexer->pos);
 
-    // Look up in function table
-    const FunctionInfo *func_info = function_table_lookup(buffer);
+    // Look up in function table, then among registered functions
+    const FunctionInfo *func_info = function_table_lookup_length(lexer->text + start, token.length);
     if (func_info)
     {
-        // For constants, we need to store the name in string_value
+        token.type = func_info->token;
         if (func_info->token == TOKEN_CONSTANT)
         {
-            char *str_copy = malloc(strlen(buffer) + 1);
-            if (!str_copy)
-            {
-                return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
-            }
-            strcpy(str_copy, buffer);
-            return (Token){.type = func_info->token, .string_value = str_copy, .number_string = NULL};
+            token.constant = func_info->constant;
         }
-        return (Token){.type = func_info->token, .int_value = 0, .number_string = NULL};
+        return token;
     }
-
-    // Unknown identifier - create a copy of the string
-    char *str_copy = malloc(strlen(buffer) + 1);
-    if (!str_copy)
+    const FunctionDef *custom = function_registry_find(lexer->text + start, token.length);
+    if (custom)
     {
-        return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+        token.type = custom->token;
     }
-    strcpy(str_copy, buffer);
-
-    return (Token){.type = TOKEN_IDENTIFIER, .string_value = str_copy, .number_string = NULL};
+    return token;
 }
 
 Token lexer_get_next_token(Lexer *lexer)
 {
     if (!lexer)
     {
-        return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+        return lexer_token(TOKEN_INVALID, 0, 0);
     }
 
     while (lexer->current_char != '\0')
     {
+        size_t start = lexer->pos;
         if (isspace(lexer->current_char))
         {
             lexer_skip_whitespace(lexer);
@@ -316,7 +314,7 @@ Token lexer_get_next_token(Lexer *lexer)
             {
                 // Standalone dot is invalid
                 lexer_advance(lexer);
-                return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+                return lexer_token(TOKEN_INVALID, start, lexer->pos);
             }
         }
 
@@ -331,74 +329,73 @@ Token lexer_get_next_token(Lexer *lexer)
         {
         case '+':
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_PLUS, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_PLUS, start, lexer->pos);
         case '-':
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_MINUS, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_MINUS, start, lexer->pos);
         case '*':
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_STAR, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_STAR, start, lexer->pos);
         case '/':
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_SLASH, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_SLASH, start, lexer->pos);
         case '^':
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_CARET, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_CARET, start, lexer->pos);
         case '(':
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_LPAREN, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_LPAREN, start, lexer->pos);
         case ')':
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_RPAREN, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_RPAREN, start, lexer->pos);
         case ',':
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_COMMA, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_COMMA, start, lexer->pos);
         case '=':
             if (lexer_peek(lexer) == '=')
             {
                 lexer_advance(lexer);
                 lexer_advance(lexer);
-                return (Token){.type = TOKEN_EQ, .int_value = 0, .number_string = NULL};
+                return lexer_token(TOKEN_EQ, start, lexer->pos);
             }
-            // Single '=' is invalid
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_ASSIGN, start, lexer->pos);
         case '!':
             if (lexer_peek(lexer) == '=')
             {
                 lexer_advance(lexer);
                 lexer_advance(lexer);
-                return (Token){.type = TOKEN_NEQ, .int_value = 0, .number_string = NULL};
+                return lexer_token(TOKEN_NEQ, start, lexer->pos);
             }
             // Single '!' is invalid
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_INVALID, start, lexer->pos);
         case '<':
             if (lexer_peek(lexer) == '=')
             {
                 lexer_advance(lexer);
                 lexer_advance(lexer);
-                return (Token){.type = TOKEN_LTE, .int_value = 0, .number_string = NULL};
+                return lexer_token(TOKEN_LTE, start, lexer->pos);
             }
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_LT, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_LT, start, lexer->pos);
         case '>':
             if (lexer_peek(lexer) == '=')
             {
                 lexer_advance(lexer);
                 lexer_advance(lexer);
-                return (Token){.type = TOKEN_GTE, .int_value = 0, .number_string = NULL};
+                return lexer_token(TOKEN_GTE, start, lexer->pos);
             }
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_GT, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_GT, start, lexer->pos);
         default:
             // Unknown character
             lexer_advance(lexer);
-            return (Token){.type = TOKEN_INVALID, .int_value = 0, .number_string = NULL};
+            return lexer_token(TOKEN_INVALID, start, lexer->pos);
         }
     }
 
-    return (Token){.type = TOKEN_EOF, .int_value = 0, .number_string = NULL};
+    return lexer_token(TOKEN_EOF, lexer->pos, lexer->pos);
 }
 
 int lexer_at_end(Lexer *lexer)
@@ -411,6 +408,26 @@ size_t lexer_get_position(Lexer *lexer)
     return lexer ? lexer->pos : 0;
 }
 
+void lexer_seek(Lexer *lexer, size_t pos)
+{
+    if (!lexer)
+    {
+        return;
+    }
+
+    lexer->pos = pos < lexer->input_length ? pos : lexer->input_length;
+    lexer->current_char = lexer->pos < lexer->input_length ? lexer->text[lexer->pos] : '\0';
+}
+
+const char *lexer_token_text(const Lexer *lexer, const Token *token)
+{
+    if (!lexer || !token || token->offset > lexer->input_length)
+    {
+        return "";
+    }
+    return lexer->text + token->offset;
+}
+
 size_t lexer_remaining_length(Lexer *lexer)
 {
     if (!lexer || lexer->pos >= lexer->input_length)
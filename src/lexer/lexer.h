@@ -4,6 +4,13 @@
 #include "tokens.h"
 #include <stddef.h>
 
+// Longest identifier lexed as one token
+#define LEXER_MAX_IDENTIFIER_LENGTH 63
+
+// Characters past the end of a token the lexer may read to decide it (as
+// in "2e+5"): an edit at least this far past a token's end leaves it alone
+#define LEXER_LOOKAHEAD 3
+
 typedef struct
 {
     const char *text;
@@ -19,6 +26,16 @@ typedef struct
  */
 void lexer_init(Lexer *lexer, const char *input);
 
+/**
+ * Initialize lexer with an input buffer of known length
+ * Unlike lexer_init(), no maximum input length is enforced; callers that
+ * read untrusted input in bulk are expected to bound it themselves.
+ * @param lexer Lexer instance
+ * @param input Input buffer to tokenize (need not be NUL-terminated)
+ * @param length Number of characters in input
+ */
+void lexer_init_length(Lexer *lexer, const char *input, size_t length);
+
 /**
  * Get the next token from the input
  * @param lexer Lexer instance
@@ -55,6 +72,24 @@ int lexer_at_end(Lexer *lexer);
  */
 size_t lexer_get_position(Lexer *lexer);
 
+/**
+ * Move to a position in the input
+ * Tokens only depend on the text from where they start, so lexing from the
+ * end of a token gives the tokens that followed it.
+ * @param lexer Lexer instance
+ * @param pos Position to lex from (clamped to the end of the input)
+ */
+void lexer_seek(Lexer *lexer, size_t pos);
+
+/**
+ * Get the text of a token produced by this lexer
+ * @param lexer Lexer the token came from
+ * @param token Token to look at
+ * @return Start of the token's text in the input; it is token->length
+ *         characters long and not NUL-terminated
+ */
+const char *lexer_token_text(const Lexer *lexer, const Token *token);
+
 /**
  * Get remaining input length
  * @param lexer Lexer instance
@@ -1,5 +1,4 @@
 #include "tokens.h"
-#include <stdlib.h>
 
 const char *token_type_str(TokenType type)
 {
@@ -37,6 +36,8 @@ const char *token_type_str(TokenType type)
         return "GTE";
     case TOKEN_COMMA:
         return "COMMA";
+    case TOKEN_ASSIGN:
+        return "ASSIGN";
     case TOKEN_SIN:
         return "SIN";
     case TOKEN_COS:
@@ -79,6 +80,10 @@ const char *token_type_str(TokenType type)
         return "CEIL";
     case TOKEN_POW:
         return "POW";
+    case TOKEN_SUM:
+        return "SUM";
+    case TOKEN_INTEGRATE:
+        return "INTEGRATE";
     case TOKEN_CONSTANT:
         return "CONSTANT";
     case TOKEN_IDENTIFIER:
@@ -88,13 +93,23 @@ const char *token_type_str(TokenType type)
     case TOKEN_INVALID:
         return "INVALID";
     default:
-        return "UNKNOWN";
+        return token_is_custom_function(type) ? "CUSTOM" : "UNKNOWN";
     }
 }
 
 int token_is_function(TokenType type)
 {
-    return (type >= TOKEN_SIN && type <= TOKEN_POW);
+    return (type >= TOKEN_SIN && type <= TOKEN_CUSTOM_LAST);
+}
+
+int token_binds_variable(TokenType type)
+{
+    return type == TOKEN_SUM || type == TOKEN_INTEGRATE;
+}
+
+int token_is_custom_function(TokenType type)
+{
+    return type >= TOKEN_CUSTOM_FIRST && type <= TOKEN_CUSTOM_LAST;
 }
 
 int token_is_constant(TokenType type)
@@ -169,14 +184,6 @@ int token_is_right_associative(TokenType type)
 
 void token_free(Token *token)
 {
-    if (token && (token->type == TOKEN_IDENTIFIER || token->type == TOKEN_CONSTANT) && token->string_value)
-    {
-        free(token->string_value);
-        token->string_value = NULL;
-    }
-    if (token && token->number_string)
-    {
-        free(token->number_string);
-        token->number_string = NULL;
-    }
-}
\ No newline at end of file
+    // Tokens are slices of the input and own nothing
+    (void)token;
+}
@@ -1,6 +1,9 @@
 #ifndef TOKENS_H
 #define TOKENS_H
 
+#include "constants.h"
+#include <stddef.h>
+
 typedef enum
 {
     TOKEN_INT,
@@ -19,6 +22,7 @@ typedef enum
     TOKEN_GT,    // >
     TOKEN_GTE,   // >=
     TOKEN_COMMA, // , for multi-argument functions
+    TOKEN_ASSIGN, // = in variable definitions
 
     // Mathematical functions
     TOKEN_SIN,
@@ -42,15 +46,23 @@ typedef enum
     TOKEN_FLOOR,
     TOKEN_CEIL,
     TOKEN_POW,
+    TOKEN_SUM,       // sum(expr, k, a, b): binds k in expr
+    TOKEN_INTEGRATE, // integrate(expr, x, a, b): binds x in expr
+
+    // Functions registered at run time (see function_registry.h)
+    TOKEN_CUSTOM_FIRST,
+    TOKEN_CUSTOM_LAST = TOKEN_CUSTOM_FIRST + 31,
 
     // Mathematical constants (unified token type)
     TOKEN_CONSTANT,
 
-    TOKEN_IDENTIFIER, // For unrecognized function names
+    TOKEN_IDENTIFIER, // Any other name: a variable
     TOKEN_EOF,
     TOKEN_INVALID
 } TokenType;
 
+// Tokens own no memory: their text is the slice [offset, offset + length)
+// of the lexer's input, which must outlive them
 typedef struct
 {
     TokenType type;
@@ -58,9 +70,10 @@ typedef struct
     {
         int int_value;
         double float_value;
-        char *string_value; // For identifiers
+        ConstantType constant; // For TOKEN_CONSTANT
     };
-    char *number_string; // Store original number string for MPFR parsing
+    size_t offset; // Start of the token's text in the input
+    size_t length; // Number of characters in the token's text
 } Token;
 
 /**
@@ -77,6 +90,22 @@ const char *token_type_str(TokenType type);
  */
 int token_is_function(TokenType type);
 
+/**
+ * Check if a function binds a variable in its first argument
+ * Such a call's second argument is the variable's name, and the first is
+ * evaluated for many values of it rather than once.
+ * @param type Token type
+ * @return 1 for sum and integrate, 0 otherwise
+ */
+int token_binds_variable(TokenType type);
+
+/**
+ * Check if a function was registered at run time rather than built in
+ * @param type Token type
+ * @return 1 for tokens TOKEN_CUSTOM_FIRST to TOKEN_CUSTOM_LAST, 0 otherwise
+ */
+int token_is_custom_function(TokenType type);
+
 /**
  * Check if token represents a constant
  * @param type Token type
@@ -120,8 +149,10 @@ int token_get_precedence(TokenType type);
 int token_is_right_associative(TokenType type);
 
 /**
- * Free token memory (for tokens with allocated strings)
- * @param token Token to free
+ * Release a token
+ * Tokens own no memory, so this does nothing; it is kept so callers need
+ * not depend on that.
+ * @param token Token to release
  */
 void token_free(Token *token);
 
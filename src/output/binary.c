@@ -0,0 +1,99 @@
+#include "binary.h"
+#include <stdint.h>
+#include <string.h>
+
+// Bytes of a limb
+#define BINARY_LIMB_BYTES (GMP_NUMB_BITS / 8)
+
+static void binary_put_u64(unsigned char *out, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static void binary_put_u32(unsigned char *out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+// Append the length prefix and type byte of a record
+static int binary_append_header(FormatBuffer *buffer, int type, size_t payload_length)
+{
+    unsigned char header[BINARY_LENGTH_SIZE + 1];
+    if (payload_length > UINT32_MAX)
+    {
+        buffer->failed = 1;
+        return 0;
+    }
+    binary_put_u32(header, (uint32_t)payload_length);
+    header[BINARY_LENGTH_SIZE] = (unsigned char)type;
+    return format_buffer_append(buffer, (const char *)header, sizeof(header));
+}
+
+int binary_append_value(FormatBuffer *buffer, mpfr_srcptr value)
+{
+    mpfr_prec_t precision = mpfr_get_prec(value);
+    int regular = mpfr_regular_p(value);
+    size_t significand_bytes = regular ? ((size_t)precision + 7) / 8 : 0;
+    size_t payload_length = 3 + 8 + (regular ? 8 + significand_bytes : 0);
+    if (!binary_append_header(buffer, BINARY_RECORD_VALUE, payload_length))
+    {
+        return 0;
+    }
+
+    unsigned char fields[2 + 8 + 8];
+    fields[0] = regular              ? BINARY_CLASS_REGULAR
+                : mpfr_zero_p(value) ? BINARY_CLASS_ZERO
+                : mpfr_inf_p(value)  ? BINARY_CLASS_INF
+                                     : BINARY_CLASS_NAN;
+    fields[1] = mpfr_signbit(value) ? 1 : 0;
+    binary_put_u64(fields + 2, (uint64_t)precision);
+    if (!regular)
+    {
+        return format_buffer_append(buffer, (const char *)fields, 2 + 8);
+    }
+    binary_put_u64(fields + 10, (uint64_t)(int64_t)mpfr_get_exp(value));
+    if (!format_buffer_append(buffer, (const char *)fields, sizeof(fields)))
+    {
+        return 0;
+    }
+
+    // The significand fills the limbs from the top; the bits below the
+    // precision in the lowest limb are zero
+    const mp_limb_t *limbs = mpfr_custom_get_significand(value);
+    size_t top = ((size_t)precision + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS - 1;
+    unsigned char block[256];
+    size_t filled = 0;
+    for (size_t i = 0; i < significand_bytes; i++)
+    {
+        mp_limb_t limb = limbs[top - i / BINARY_LIMB_BYTES];
+        int shift = GMP_NUMB_BITS - 8 * (int)(i % BINARY_LIMB_BYTES + 1);
+        block[filled++] = (unsigned char)(limb >> shift);
+        if (filled == sizeof(block) || i + 1 == significand_bytes)
+        {
+            if (!format_buffer_append(buffer, (const char *)block, filled))
+            {
+                return 0;
+            }
+            filled = 0;
+        }
+    }
+    return 1;
+}
+
+int binary_append_error(FormatBuffer *buffer, const char *message)
+{
+    size_t length = strlen(message);
+    return binary_append_header(buffer, BINARY_RECORD_ERROR, 1 + length) &&
+           format_buffer_append(buffer, message, length);
+}
+
+int binary_append_empty(FormatBuffer *buffer)
+{
+    return binary_append_header(buffer, BINARY_RECORD_EMPTY, 1);
+}
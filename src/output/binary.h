@@ -0,0 +1,65 @@
+#ifndef BINARY_H
+#define BINARY_H
+
+#include "formatter.h"
+#include <mpfr.h>
+
+/*
+ * Binary result records, for consumers that load results back into MPFR
+ * without a decimal round trip.
+ *
+ * Every record is a 4-byte little-endian payload length followed by the
+ * payload. The payload starts with a type byte:
+ *
+ *   BINARY_RECORD_VALUE  class byte (BINARY_CLASS_*), sign byte (1 for
+ *                        negative, including -0), precision in bits as
+ *                        8-byte little-endian unsigned; for regular numbers
+ *                        also the exponent as 8-byte little-endian signed
+ *                        and the significand in (precision + 7) / 8 bytes,
+ *                        most significant first. The value is
+ *                        0.<significand bits> * 2^exponent, so it is exact.
+ *   BINARY_RECORD_ERROR  the error message, not NUL-terminated
+ *   BINARY_RECORD_EMPTY  nothing; stands for a blank input line
+ *
+ * Integers are little-endian and the significand is byte-ordered, so the
+ * format does not depend on the host's limb size or byte order.
+ */
+
+// Record types
+#define BINARY_RECORD_VALUE 0
+#define BINARY_RECORD_ERROR 1
+#define BINARY_RECORD_EMPTY 2
+
+// Value classes
+#define BINARY_CLASS_ZERO 0
+#define BINARY_CLASS_REGULAR 1
+#define BINARY_CLASS_INF 2
+#define BINARY_CLASS_NAN 3
+
+// Bytes of the length prefix
+#define BINARY_LENGTH_SIZE 4
+
+/**
+ * Append a value record
+ * @param buffer Buffer to append to
+ * @param value Value to encode exactly, with its precision
+ * @return 1 on success, 0 on allocation failure
+ */
+int binary_append_value(FormatBuffer *buffer, mpfr_srcptr value);
+
+/**
+ * Append an error record
+ * @param buffer Buffer to append to
+ * @param message Error message
+ * @return 1 on success, 0 on allocation failure
+ */
+int binary_append_error(FormatBuffer *buffer, const char *message);
+
+/**
+ * Append an empty record
+ * @param buffer Buffer to append to
+ * @return 1 on success, 0 on allocation failure
+ */
+int binary_append_empty(FormatBuffer *buffer);
+
+#endif // BINARY_H
@@ -1,18 +1,229 @@
 #include "formatter.h"
+#include "context.h"
 #include "precision.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // Forward declarations for static functions
-static void formatter_print_scientific(const mpfr_t value);
-static void formatter_print_fixed(const mpfr_t value);
-static void formatter_print_smart_impl(const mpfr_t value);
+static int formatter_format_scientific(FormatBuffer *buffer, const mpfr_t value,
+                                       const EvalContext *ctx, const FormatSettings *config);
+static int formatter_format_fixed(FormatBuffer *buffer, const mpfr_t value, const EvalContext *ctx,
+                                  const FormatSettings *config);
+static int formatter_format_smart(FormatBuffer *buffer, const mpfr_t value, const EvalContext *ctx,
+                                  const FormatSettings *config);
+static int formatter_format_number_with(FormatBuffer *buffer, const mpfr_t value,
+                                        NumberFormat format, const EvalContext *ctx,
+                                        const FormatSettings *config);
+static int formatter_format_value_with(FormatBuffer *buffer, const mpfr_t value,
+                                       int original_is_int, mpz_srcptr exact,
+                                       const EvalContext *ctx, const FormatSettings *config);
+
+// Smart mode writes numbers out in full up to this many digits before or
+// after the point, and switches to scientific notation past it
+#define FORMAT_SMART_MAX_ZERO_RUN 500
+
+// Process-wide formatting configuration used by the global API
+static FormatSettings settings = FORMAT_SETTINGS_DEFAULT;
+
+// Text of the stream functions, built whole and written with one fwrite()
+// unless it runs past FORMAT_STREAM_CHUNK
+static _Thread_local FormatBuffer print_buffer;
+
+// Digits to print for a context's precision, capped by the settings
+static long formatter_digits(const EvalContext *ctx, const FormatSettings *config)
+{
+    long decimal_digits = eval_context_decimal_digits(ctx);
+    if (config->max_decimal_places > 0 && config->max_decimal_places < decimal_digits)
+        decimal_digits = config->max_decimal_places;
+    return decimal_digits;
+}
+
+void format_buffer_init(FormatBuffer *buffer)
+{
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+void format_buffer_free(FormatBuffer *buffer)
+{
+    free(buffer->data);
+    free(buffer->digits);
+    format_buffer_init(buffer);
+}
+
+void format_buffer_reset(FormatBuffer *buffer)
+{
+    buffer->length = 0;
+    buffer->failed = 0;
+    buffer->stream = NULL;
+    if (buffer->data)
+    {
+        buffer->data[0] = '\0';
+    }
+}
+
+// Reset a buffer to collect text for a stream
+static void format_buffer_start(FormatBuffer *buffer, FILE *out)
+{
+    format_buffer_reset(buffer);
+    buffer->stream = out;
+}
+
+// Pass a streaming buffer's text on when extra more bytes would take it
+// past a chunk
+static int format_buffer_flush(FormatBuffer *buffer, size_t extra)
+{
+    if (!buffer->stream || buffer->failed || buffer->length + extra < FORMAT_STREAM_CHUNK)
+    {
+        return !buffer->failed;
+    }
+    if (fwrite(buffer->data, 1, buffer->length, buffer->stream) != buffer->length)
+    {
+        buffer->failed = 1;
+        return 0;
+    }
+    buffer->length = 0;
+    buffer->data[0] = '\0';
+    return 1;
+}
+
+// Make room for extra more bytes plus the terminator
+static int format_buffer_reserve(FormatBuffer *buffer, size_t extra)
+{
+    if (buffer->failed)
+    {
+        return 0;
+    }
+    if (buffer->length + extra < buffer->capacity)
+    {
+        return 1;
+    }
+
+    size_t capacity = buffer->capacity ? buffer->capacity : 64;
+    while (buffer->length + extra >= capacity)
+    {
+        capacity *= 2;
+    }
+    char *data = realloc(buffer->data, capacity);
+    if (!data)
+    {
+        buffer->failed = 1;
+        return 0;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 1;
+}
+
+int format_buffer_append(FormatBuffer *buffer, const char *text, size_t length)
+{
+    if (buffer->stream && buffer->length + length >= FORMAT_STREAM_CHUNK)
+    {
+        if (!format_buffer_flush(buffer, length))
+        {
+            return 0;
+        }
+        if (length >= FORMAT_STREAM_CHUNK)
+        {
+            if (fwrite(text, 1, length, buffer->stream) != length)
+            {
+                buffer->failed = 1;
+                return 0;
+            }
+            return 1;
+        }
+    }
+    if (!format_buffer_reserve(buffer, length))
+    {
+        return 0;
+    }
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+    return 1;
+}
 
-// Formatting configuration
-static int max_decimal_places = -1; // -1 means auto
-static double small_threshold = 1e-6;
-static double large_threshold = 1e15;
+int format_buffer_append_char(FormatBuffer *buffer, char c)
+{
+    return format_buffer_append(buffer, &c, 1);
+}
+
+// Append count copies of a character, a chunk at a time when streaming
+static int format_buffer_fill(FormatBuffer *buffer, char c, size_t count)
+{
+    while (count > 0)
+    {
+        size_t step = buffer->stream && count > FORMAT_STREAM_CHUNK ? FORMAT_STREAM_CHUNK : count;
+        if (!format_buffer_flush(buffer, step) || !format_buffer_reserve(buffer, step))
+        {
+            return 0;
+        }
+        memset(buffer->data + buffer->length, c, step);
+        buffer->length += step;
+        buffer->data[buffer->length] = '\0';
+        count -= step;
+    }
+    return 1;
+}
+
+static int format_buffer_append_long(FormatBuffer *buffer, long value)
+{
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%ld", value);
+    return format_buffer_append(buffer, text, (size_t)length);
+}
+
+// Append every digit of an integer
+static int format_buffer_append_integer(FormatBuffer *buffer, mpz_srcptr value)
+{
+    // mpz_sizeinbase() may count one digit too many, and the sign takes one
+    size_t size = mpz_sizeinbase(value, 10) + 2;
+    if (!format_buffer_flush(buffer, size) || !format_buffer_reserve(buffer, size))
+    {
+        return 0;
+    }
+    mpz_get_str(buffer->data + buffer->length, 10, value);
+    buffer->length += strlen(buffer->data + buffer->length);
+    return 1;
+}
+
+int format_buffer_write(const FormatBuffer *buffer, FILE *out)
+{
+    return !buffer->failed && fwrite(buffer->data, 1, buffer->length, out) == buffer->length;
+}
+
+// Decimal digits of a value in the buffer's scratch space, or NULL if it
+// could not grow. The digits stay valid until the next call.
+static char *formatter_get_digits(FormatBuffer *buffer, mpfr_exp_t *exp, long decimal_digits,
+                                  const mpfr_t value, mpfr_rnd_t rounding)
+{
+    // mpfr_get_str() needs room for the sign and terminator, and at least 7
+    // bytes for NaN and infinities
+    size_t needed = (size_t)decimal_digits + 2 < 7 ? 7 : (size_t)decimal_digits + 2;
+    if (buffer->digits_capacity < needed)
+    {
+        char *digits = realloc(buffer->digits, needed);
+        if (!digits)
+        {
+            buffer->failed = 1;
+            return NULL;
+        }
+        buffer->digits = digits;
+        buffer->digits_capacity = needed;
+    }
+    return mpfr_get_str(buffer->digits, exp, 10, (size_t)decimal_digits, value, rounding);
+}
+
+// Index of the last digit that is not a trailing zero
+static size_t formatter_last_significant(const char *digits)
+{
+    size_t last_significant = strlen(digits) - 1;
+    while (last_significant > 0 && digits[last_significant] == '0')
+    {
+        last_significant--;
+    }
+    return last_significant;
+}
 
 void formatter_print_smart(const mpfr_t value)
 {
@@ -33,32 +244,87 @@ void formatter_print_result(const mpfr_t value, int original_is_int)
         }
     }
 
-    printf("= ");
-    formatter_print_smart(value);
-    printf("\n");
+    format_buffer_start(&print_buffer, stdout);
+    format_buffer_append(&print_buffer, "= ", 2);
+    formatter_format_number(&print_buffer, value, FORMAT_SMART);
+    format_buffer_append_char(&print_buffer, '\n');
+    format_buffer_write(&print_buffer, stdout);
 }
 
 void formatter_print_number(const mpfr_t value, NumberFormat format)
 {
-    if (mpfr_zero_p(value))
+    formatter_fprint_number(stdout, value, format);
+}
+
+void formatter_fprint_number(FILE *out, const mpfr_t value, NumberFormat format)
+{
+    format_buffer_start(&print_buffer, out);
+    formatter_format_number(&print_buffer, value, format);
+    format_buffer_write(&print_buffer, out);
+}
+
+void formatter_fprint_number_ctx(const EvalContext *ctx, FILE *out, const mpfr_t value,
+                                 NumberFormat format)
+{
+    format_buffer_start(&print_buffer, out);
+    formatter_format_number_ctx(ctx, &print_buffer, value, format);
+    format_buffer_write(&print_buffer, out);
+}
+
+int formatter_format_number(FormatBuffer *buffer, const mpfr_t value, NumberFormat format)
+{
+    return formatter_format_number_with(buffer, value, format, eval_context_default(), &settings);
+}
+
+int formatter_format_number_ctx(const EvalContext *ctx, FormatBuffer *buffer, const mpfr_t value,
+                                NumberFormat format)
+{
+    return formatter_format_number_with(buffer, value, format, ctx, &ctx->format);
+}
+
+// Check |value| < threshold without computing |value|
+static int formatter_below(const mpfr_t value, double threshold)
+{
+    return mpfr_cmp_d(value, threshold) < 0 && mpfr_cmp_d(value, -threshold) > 0;
+}
+
+// Check |value| > threshold without computing |value|
+static int formatter_above(const mpfr_t value, double threshold)
+{
+    return mpfr_cmp_d(value, threshold) > 0 || mpfr_cmp_d(value, -threshold) < 0;
+}
+
+// Write NaN or an infinity, which have no digits for any mode to lay out
+static int formatter_format_special(FormatBuffer *buffer, const mpfr_t value)
+{
+    if (mpfr_nan_p(value))
     {
-        printf("0");
-        return;
+        return format_buffer_append(buffer, "nan", 3);
     }
+    return mpfr_sgn(value) < 0 ? format_buffer_append(buffer, "-inf", 4)
+                               : format_buffer_append(buffer, "inf", 3);
+}
 
-    // Get absolute value for threshold checks
-    mpfr_t abs_val;
-    mpfr_init2(abs_val, global_precision);
-    mpfr_abs(abs_val, value, global_rounding);
+static int formatter_format_number_with(FormatBuffer *buffer, const mpfr_t value,
+                                        NumberFormat format, const EvalContext *ctx,
+                                        const FormatSettings *config)
+{
+    if (!mpfr_number_p(value))
+    {
+        return formatter_format_special(buffer, value);
+    }
+    if (mpfr_zero_p(value))
+    {
+        return format_buffer_append_char(buffer, '0');
+    }
 
     NumberFormat chosen_format = format;
 
     // Auto-select format if needed
     if (format == FORMAT_AUTO)
     {
-        if (!mpfr_zero_p(value) &&
-            (mpfr_cmp_d(abs_val, small_threshold) < 0 ||
-             mpfr_cmp_d(abs_val, large_threshold) > 0))
+        if (formatter_below(value, config->small_threshold) ||
+            formatter_above(value, config->large_threshold))
         {
             chosen_format = FORMAT_SCIENTIFIC;
         }
@@ -71,199 +337,202 @@ void formatter_print_number(const mpfr_t value, NumberFormat format)
     switch (chosen_format)
     {
     case FORMAT_SCIENTIFIC:
-        formatter_print_scientific(value);
-        break;
+        return formatter_format_scientific(buffer, value, ctx, config);
     case FORMAT_FIXED:
-        formatter_print_fixed(value);
-        break;
+        return formatter_format_fixed(buffer, value, ctx, config);
     case FORMAT_SMART:
     default:
-        formatter_print_smart_impl(value);
-        break;
+        return formatter_format_smart(buffer, value, ctx, config);
     }
-
-    mpfr_clear(abs_val);
 }
 
-static void formatter_print_scientific(const mpfr_t value)
+static int formatter_format_scientific(FormatBuffer *buffer, const mpfr_t value,
+                                       const EvalContext *ctx, const FormatSettings *config)
 {
-    long decimal_digits = get_decimal_digits();
-    if (max_decimal_places > 0 && max_decimal_places < decimal_digits)
-        decimal_digits = max_decimal_places;
-
-    char *str = NULL;
+    long decimal_digits = formatter_digits(ctx, config);
     mpfr_exp_t exp;
+    char *str = formatter_get_digits(buffer, &exp, decimal_digits, value, ctx->rounding);
+    if (!str)
+    {
+        return 0;
+    }
 
-    str = mpfr_get_str(NULL, &exp, 10, decimal_digits, value, global_rounding);
-    if (str)
+    // Remove leading minus for separate handling
+    int is_negative = (str[0] == '-');
+    char *digits = is_negative ? str + 1 : str;
+    if (digits[0] == '\0')
     {
-        // Remove leading minus for separate handling
-        int is_negative = (str[0] == '-');
-        char *digits = is_negative ? str + 1 : str;
+        return !buffer->failed;
+    }
 
-        if (strlen(digits) > 0)
-        {
-            long exponent = (long)(exp - 1);
-            
-            // For small exponents (-3 to 3), consider using normal notation
-            if (exponent >= -3 && exponent <= 3)
-            {
-                // Fall back to smart formatting for readability
-                formatter_print_smart_impl(value);
-                mpfr_free_str(str);
-                return;
-            }
-            
-            // Find last significant digit (remove trailing zeros)
-            size_t len = strlen(digits);
-            size_t last_significant = len - 1;
-            
-            while (last_significant > 0 && digits[last_significant] == '0')
-            {
-                last_significant--;
-            }
-            
-            // Print the result
-            printf("%s%c", is_negative ? "-" : "", digits[0]);
-            
-            if (last_significant > 0)
-            {
-                printf(".");
-                for (size_t i = 1; i <= last_significant; i++)
-                {
-                    printf("%c", digits[i]);
-                }
-            }
-            
-            printf("e%ld", exponent);
-        }
-        mpfr_free_str(str);
+    long exponent = (long)(exp - 1);
+
+    // For small exponents (-3 to 3), fall back to smart formatting for
+    // readability
+    if (exponent >= -3 && exponent <= 3)
+    {
+        return formatter_format_smart(buffer, value, ctx, config);
     }
+
+    // Print the mantissa without trailing zeros
+    size_t last_significant = formatter_last_significant(digits);
+    if (is_negative)
+    {
+        format_buffer_append_char(buffer, '-');
+    }
+    format_buffer_append_char(buffer, digits[0]);
+    if (last_significant > 0)
+    {
+        format_buffer_append_char(buffer, '.');
+        format_buffer_append(buffer, digits + 1, last_significant);
+    }
+    format_buffer_append_char(buffer, 'e');
+    return format_buffer_append_long(buffer, exponent);
 }
 
-static void formatter_print_fixed(const mpfr_t value)
+static int formatter_format_fixed(FormatBuffer *buffer, const mpfr_t value, const EvalContext *ctx,
+                                  const FormatSettings *config)
 {
-    long decimal_digits = get_decimal_digits();
-    if (max_decimal_places > 0 && max_decimal_places < decimal_digits)
+    long decimal_digits = formatter_digits(ctx, config);
+
+    // A streaming buffer lets MPFR write the digits itself
+    if (buffer->stream && decimal_digits >= FORMAT_STREAM_CHUNK)
     {
-        decimal_digits = max_decimal_places;
+        if (!format_buffer_flush(buffer, FORMAT_STREAM_CHUNK))
+        {
+            return 0;
+        }
+        if (mpfr_fprintf(buffer->stream, "%.*Rf", (int)decimal_digits, value) < 0)
+        {
+            buffer->failed = 1;
+            return 0;
+        }
+        return 1;
     }
 
-    mpfr_printf("%.*Rf", (int)decimal_digits, value);
+    // One try with whatever room is left; the second knows the length
+    size_t room = buffer->capacity > buffer->length ? buffer->capacity - buffer->length : 0;
+    int length = mpfr_snprintf(room ? buffer->data + buffer->length : NULL, room, "%.*Rf",
+                               (int)decimal_digits, value);
+    if (length < 0)
+    {
+        return 0;
+    }
+    if ((size_t)length >= room)
+    {
+        if (!format_buffer_reserve(buffer, (size_t)length))
+        {
+            return 0;
+        }
+        mpfr_snprintf(buffer->data + buffer->length, (size_t)length + 1, "%.*Rf",
+                      (int)decimal_digits, value);
+    }
+    buffer->length += (size_t)length;
+    return 1;
 }
 
-static void formatter_print_smart_impl(const mpfr_t value)
+static int formatter_format_smart(FormatBuffer *buffer, const mpfr_t value, const EvalContext *ctx,
+                                  const FormatSettings *config)
 {
-    long decimal_digits = get_decimal_digits();
-    if (max_decimal_places > 0 && max_decimal_places < decimal_digits)
-        decimal_digits = max_decimal_places;
-    const long MAX_ZERO_RUN = 500;
+    long decimal_digits = formatter_digits(ctx, config);
     mpfr_exp_t exp;
-    char *str = mpfr_get_str(NULL, &exp, 10, decimal_digits, value, global_rounding);
+    char *str = formatter_get_digits(buffer, &exp, decimal_digits, value, ctx->rounding);
 
     if (!str)
     {
-        printf("[error formatting number]");
-        return;
+        return format_buffer_append(buffer, "[error formatting number]", 25);
     }
 
     // If exponent is too big/small, bail to scientific
-    if (exp > MAX_ZERO_RUN || exp < -MAX_ZERO_RUN)
+    if (exp > FORMAT_SMART_MAX_ZERO_RUN || exp < -FORMAT_SMART_MAX_ZERO_RUN)
     {
-        mpfr_free_str(str);
-        formatter_print_scientific(value);
-        return;
+        return formatter_format_scientific(buffer, value, ctx, config);
     }
     int is_negative = (str[0] == '-');
     char *digits = is_negative ? str + 1 : str;
+    size_t last_significant = formatter_last_significant(digits);
 
-    size_t len = strlen(digits);
-    size_t last_significant = len - 1;
-    while (last_significant > 0 && digits[last_significant] == '0')
+    if (is_negative)
     {
-        last_significant--;
+        format_buffer_append_char(buffer, '-');
     }
 
-    printf("%s", is_negative ? "-" : "");
-
     if (exp <= 0)
     {
-        printf("0.");
-        for (mpfr_exp_t i = 0; i < -exp; i++)
-        {
-            printf("0");
-        }
-        for (size_t i = 0; i <= last_significant; i++)
-        {
-            printf("%c", digits[i]);
-        }
+        format_buffer_append(buffer, "0.", 2);
+        format_buffer_fill(buffer, '0', (size_t)-exp);
+        format_buffer_append(buffer, digits, last_significant + 1);
     }
     else if ((size_t)exp >= last_significant + 1)
     {
         // All digits are in the integer part
-        for (size_t i = 0; i <= last_significant; i++)
-        {
-            printf("%c", digits[i]);
-        }
-        for (mpfr_exp_t i = last_significant + 1; i < (mpfr_exp_t)exp; i++)
-        {
-            printf("0");
-        }
+        format_buffer_append(buffer, digits, last_significant + 1);
+        format_buffer_fill(buffer, '0', (size_t)exp - (last_significant + 1));
     }
     else
     {
         // Mixed integer and fractional
-        for (mpfr_exp_t i = 0; i < exp; i++)
-        {
-            printf("%c", digits[i]);
-        }
-        printf(".");
-        for (size_t i = exp; i <= last_significant; i++)
-        {
-            printf("%c", digits[i]);
-        }
+        format_buffer_append(buffer, digits, (size_t)exp);
+        format_buffer_append_char(buffer, '.');
+        format_buffer_append(buffer, digits + exp, last_significant + 1 - (size_t)exp);
     }
 
-    mpfr_free_str(str);
+    return !buffer->failed;
 }
 
 char *formatter_to_string(const mpfr_t value, NumberFormat format)
 {
-    // Implementation would capture printf output to string
-    // For now, return NULL as placeholder
-    (void)value;
-    (void)format;
-    return NULL;
+    FormatBuffer buffer;
+    format_buffer_init(&buffer);
+
+    // An empty result still needs its terminator
+    if (!format_buffer_reserve(&buffer, 0) || !formatter_format_number(&buffer, value, format))
+    {
+        format_buffer_free(&buffer);
+        return NULL;
+    }
+
+    // Hand the text over; only the digit scratch is freed
+    char *text = buffer.data;
+    free(buffer.digits);
+    return text;
+}
+
+void formatter_cleanup(void)
+{
+    format_buffer_free(&print_buffer);
 }
 
 void formatter_set_max_decimals(int max_decimals)
 {
-    max_decimal_places = max_decimals;
+    settings.max_decimal_places = max_decimals;
 }
 
 void formatter_set_scientific_thresholds(double small, double large)
 {
-    small_threshold = small;
-    large_threshold = large;
+    settings.small_threshold = small;
+    settings.large_threshold = large;
 }
 
-// Add static variable for default mode
-static NumberFormat default_mode = FORMAT_SMART;
-
 void formatter_set_default_mode(NumberFormat format)
 {
-    default_mode = format;
+    settings.mode = format;
 }
 
 NumberFormat formatter_get_default_mode(void)
 {
-    return default_mode;
+    return settings.mode;
+}
+
+FormatSettings formatter_get_settings(void)
+{
+    return settings;
 }
 
 void formatter_print_current_mode(void)
 {
     const char *mode_name;
-    switch (default_mode)
+    switch (settings.mode)
     {
     case FORMAT_SCIENTIFIC:
         mode_name = "scientific";
@@ -284,7 +553,7 @@ void formatter_print_current_mode(void)
 
     printf("Current display mode: %s\n", mode_name);
 
-    if (default_mode == FORMAT_SCIENTIFIC)
+    if (settings.mode == FORMAT_SCIENTIFIC)
     {
         printf("All results will be displayed in scientific notation (e.g., 1.23e+05)\n");
     }
@@ -297,7 +566,7 @@ void formatter_print_current_mode(void)
 void formatter_print_result_with_mode(const mpfr_t value, int original_is_int)
 {
     // For integers in normal mode, still try to show as integer if reasonable
-    if (default_mode == FORMAT_SMART && original_is_int && mpfr_integer_p(value))
+    if (settings.mode == FORMAT_SMART && original_is_int && mpfr_integer_p(value))
     {
         if (mpfr_fits_slong_p(value, global_rounding))
         {
@@ -307,6 +576,154 @@ void formatter_print_result_with_mode(const mpfr_t value, int original_is_int)
         }
     }
 
-    formatter_print_number(value, default_mode);
-    printf("\n");
-}
\ No newline at end of file
+    format_buffer_start(&print_buffer, stdout);
+    formatter_format_number(&print_buffer, value, settings.mode);
+    format_buffer_append_char(&print_buffer, '\n');
+    format_buffer_write(&print_buffer, stdout);
+}
+
+void formatter_fprint_result(FILE *out, const mpfr_t value, int original_is_int)
+{
+    format_buffer_start(&print_buffer, out);
+    formatter_format_result(&print_buffer, value, original_is_int);
+    format_buffer_write(&print_buffer, out);
+}
+
+void formatter_fprint_value(FILE *out, const mpfr_t value, int original_is_int)
+{
+    format_buffer_start(&print_buffer, out);
+    formatter_format_value(&print_buffer, value, original_is_int);
+    format_buffer_write(&print_buffer, out);
+}
+
+void formatter_fprint_value_ctx(const EvalContext *ctx, FILE *out, const mpfr_t value,
+                                int original_is_int)
+{
+    format_buffer_start(&print_buffer, out);
+    formatter_format_value_ctx(ctx, &print_buffer, value, original_is_int);
+    format_buffer_write(&print_buffer, out);
+}
+
+int formatter_format_value(FormatBuffer *buffer, const mpfr_t value, int original_is_int)
+{
+    return formatter_format_value_with(buffer, value, original_is_int, NULL,
+                                       eval_context_default(), &settings);
+}
+
+int formatter_format_value_ctx(const EvalContext *ctx, FormatBuffer *buffer, const mpfr_t value,
+                               int original_is_int)
+{
+    return formatter_format_value_with(buffer, value, original_is_int, NULL, ctx, &ctx->format);
+}
+
+
+// Write interval bounds as their midpoint to the digits the bounds
+// certify and a radius, rounded up, that covers the bounds and the digits
+// dropped from the midpoint, so the exact value lies within "mid ± radius"
+static int formatter_format_interval(FormatBuffer *buffer, mpfr_srcptr lo, mpfr_srcptr hi,
+                                     const EvalContext *ctx, const FormatSettings *config)
+{
+    // Without finite bounds there is no midpoint to speak of
+    if (!mpfr_number_p(lo) || !mpfr_number_p(hi))
+    {
+        format_buffer_append_char(buffer, '[');
+        formatter_format_number_with(buffer, lo, config->mode, ctx, config);
+        format_buffer_append(buffer, ", ", 2);
+        formatter_format_number_with(buffer, hi, config->mode, ctx, config);
+        return format_buffer_append_char(buffer, ']');
+    }
+
+    mpfr_prec_t precision = mpfr_get_prec(lo) > mpfr_get_prec(hi) ? mpfr_get_prec(lo)
+                                                                   : mpfr_get_prec(hi);
+    mpfr_t mid, radius, below;
+    mpfr_init2(mid, precision + 1);
+    mpfr_init2(radius, 64);
+    mpfr_init2(below, 64);
+    mpfr_add(mid, lo, hi, MPFR_RNDN);
+    mpfr_div_2ui(mid, mid, 1, MPFR_RNDN);
+    mpfr_sub(radius, hi, mid, MPFR_RNDU);
+    mpfr_sub(below, mid, lo, MPFR_RNDU);
+    mpfr_max(radius, radius, below, MPFR_RNDU);
+
+    // Digits of the midpoint above the radius, at least one
+    FormatSettings shown = *config;
+    long digits = formatter_digits(ctx, config);
+    if (config->mode != FORMAT_FIXED && mpfr_regular_p(mid) && mpfr_regular_p(radius))
+    {
+        long certified = (long)((double)(mpfr_get_exp(mid) - mpfr_get_exp(radius)) * 0.30103);
+        if (certified < 1)
+            certified = 1;
+        if (certified < digits)
+            digits = shown.max_decimal_places = (int)certified;
+    }
+
+    // The last digit shown is off by up to one unit; fixed notation counts
+    // its digits from the point
+    mpfr_exp_t exp = 0;
+    if (config->mode != FORMAT_FIXED && !mpfr_zero_p(mid) &&
+        !formatter_get_digits(buffer, &exp, digits, mid, ctx->rounding))
+    {
+        mpfr_clears(mid, radius, below, (mpfr_ptr)0);
+        return 0;
+    }
+    mpfr_set_ui(below, 10, MPFR_RNDN);
+    mpfr_pow_si(below, below, (long)exp - digits, MPFR_RNDU);
+    mpfr_add(radius, radius, below, MPFR_RNDU);
+
+    char text[64];
+    int ok = formatter_format_number_with(buffer, mid, shown.mode, ctx, &shown);
+    int length = mpfr_snprintf(text, sizeof(text), " ± %.1RUe", radius);
+    ok = ok && length > 0 && format_buffer_append(buffer, text, (size_t)length);
+    mpfr_clears(mid, radius, below, (mpfr_ptr)0);
+    return ok;
+}
+
+// Format the result of a context's last evaluation, with its interval
+// bounds when it has some that differ
+static int formatter_format_result_with(FormatBuffer *buffer, const mpfr_t value,
+                                        int original_is_int, const EvalContext *ctx,
+                                        const FormatSettings *config)
+{
+    mpfr_srcptr lo, hi;
+    if (evaluator_interval_bounds(ctx, &lo, &hi) && !mpfr_nan_p(lo) && !mpfr_nan_p(hi) &&
+        !mpfr_equal_p(lo, hi))
+    {
+        return formatter_format_interval(buffer, lo, hi, ctx, config);
+    }
+    return formatter_format_value_with(buffer, value, original_is_int,
+                                       evaluator_exact_integer(ctx), ctx, config);
+}
+
+int formatter_format_result(FormatBuffer *buffer, const mpfr_t value, int original_is_int)
+{
+    return formatter_format_result_with(buffer, value, original_is_int, eval_context_default(),
+                                        &settings);
+}
+
+int formatter_format_result_ctx(const EvalContext *ctx, FormatBuffer *buffer, const mpfr_t value,
+                                int original_is_int)
+{
+    return formatter_format_result_with(buffer, value, original_is_int, ctx, &ctx->format);
+}
+
+static int formatter_format_value_with(FormatBuffer *buffer, const mpfr_t value,
+                                       int original_is_int, mpz_srcptr exact,
+                                       const EvalContext *ctx, const FormatSettings *config)
+{
+    // An exact integer keeps the digits the rounded value lost, as far as
+    // smart mode would write the value out in full
+    if (config->mode == FORMAT_SMART && exact &&
+        mpz_sizeinbase(exact, 10) <= FORMAT_SMART_MAX_ZERO_RUN)
+    {
+        return format_buffer_append_integer(buffer, exact);
+    }
+
+    // Same integer rule as formatter_print_result_with_mode()
+    if (config->mode == FORMAT_SMART && original_is_int && mpfr_integer_p(value) &&
+        mpfr_fits_slong_p(value, ctx->rounding))
+    {
+        return format_buffer_append_long(buffer, mpfr_get_si(value, ctx->rounding));
+    }
+
+    return formatter_format_number_with(buffer, value, config->mode, ctx, config);
+}
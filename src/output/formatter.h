@@ -1,6 +1,7 @@
 #ifndef FORMATTER_H
 #define FORMATTER_H
 
+#include <stdio.h>
 #include <mpfr.h>
 
 typedef enum
@@ -11,6 +12,93 @@ typedef enum
     FORMAT_SMART       // Smart formatting with trailing zero removal
 } NumberFormat;
 
+/**
+ * Display settings used when formatting numbers
+ */
+typedef struct
+{
+    int max_decimal_places; // Maximum decimal places, -1 means auto
+    double small_threshold; // FORMAT_AUTO uses scientific notation below this
+    double large_threshold; // FORMAT_AUTO uses scientific notation above this
+    NumberFormat mode;      // Default format for results
+} FormatSettings;
+
+// Settings a new context starts with
+#define FORMAT_SETTINGS_DEFAULT {-1, 1e-6, 1e15, FORMAT_SMART}
+
+typedef struct EvalContext EvalContext;
+
+// Bytes a streaming buffer holds before passing its text on
+#define FORMAT_STREAM_CHUNK 65536
+
+/**
+ * Growable text buffer the formatter writes into
+ *
+ * A buffer is reused across numbers: reset it between them and the memory
+ * it already holds, including the scratch space for MPFR's digits, serves
+ * the next one. A zeroed buffer is a valid empty buffer.
+ *
+ * With a stream set, the buffer only keeps the last FORMAT_STREAM_CHUNK
+ * bytes or so: older text is written out as it comes, and long runs such
+ * as the digits of a huge precision value go straight from MPFR's scratch
+ * to the stream. format_buffer_write() then writes the rest.
+ */
+typedef struct
+{
+    char *data;      // Text, always NUL-terminated once anything is written
+    size_t length;   // Bytes of text, not counting the terminator
+    size_t capacity; // Bytes allocated for data
+    char *digits;    // Scratch for mpfr_get_str()
+    size_t digits_capacity;
+    int failed;   // An allocation or write failed; the text is incomplete
+    FILE *stream; // Stream text is passed on to, NULL to keep it whole
+} FormatBuffer;
+
+/**
+ * Initialize an empty buffer
+ * @param buffer Buffer to initialize
+ */
+void format_buffer_init(FormatBuffer *buffer);
+
+/**
+ * Free a buffer's memory and leave it empty
+ * @param buffer Buffer to free
+ */
+void format_buffer_free(FormatBuffer *buffer);
+
+/**
+ * Empty a buffer, keeping its memory for the next text
+ * @param buffer Buffer to reset
+ */
+void format_buffer_reset(FormatBuffer *buffer);
+
+/**
+ * Append bytes to a buffer
+ * @param buffer Buffer to append to
+ * @param text Bytes to append
+ * @param length Number of bytes
+ * @return 1 on success, 0 if the buffer could not grow
+ */
+int format_buffer_append(FormatBuffer *buffer, const char *text, size_t length);
+
+/**
+ * Append one character to a buffer
+ * @param buffer Buffer to append to
+ * @param c Character to append
+ * @return 1 on success, 0 if the buffer could not grow
+ */
+int format_buffer_append_char(FormatBuffer *buffer, char c);
+
+/**
+ * Write a buffer's text to a stream with a single fwrite()
+ * For a streaming buffer, this is the text not passed on yet.
+ * @param buffer Buffer to write
+ * @param out Output stream
+ * @return 1 if everything was written, 0 on output error or if the buffer
+ *         failed to grow earlier
+ */
+int format_buffer_write(const FormatBuffer *buffer, FILE *out);
+
 /**
  * Format and print an MPFR number with smart formatting
  * @param value The number to format
@@ -24,6 +112,99 @@ void formatter_print_smart(const mpfr_t value);
  */
 void formatter_print_number(const mpfr_t value, NumberFormat format);
 
+/**
+ * Format and write an MPFR number to a stream
+ * @param out Output stream
+ * @param value The number to format
+ * @param format Output format style
+ */
+void formatter_fprint_number(FILE *out, const mpfr_t value, NumberFormat format);
+
+/**
+ * Format and write an MPFR number using a context's precision and settings
+ * @param ctx Context supplying precision, rounding and display settings
+ * @param out Output stream
+ * @param value The number to format
+ * @param format Output format style
+ */
+void formatter_fprint_number_ctx(const EvalContext *ctx, FILE *out, const mpfr_t value,
+                                 NumberFormat format);
+
+/**
+ * Append an MPFR number to a buffer using the global settings
+ * @param buffer Buffer to append to
+ * @param value The number to format
+ * @param format Output format style
+ * @return 1 on success, 0 on allocation failure
+ */
+int formatter_format_number(FormatBuffer *buffer, const mpfr_t value, NumberFormat format);
+
+/**
+ * Append an MPFR number to a buffer using a context's precision and settings
+ * @param ctx Context supplying precision, rounding and display settings
+ * @param buffer Buffer to append to
+ * @param value The number to format
+ * @param format Output format style
+ * @return 1 on success, 0 on allocation failure
+ */
+int formatter_format_number_ctx(const EvalContext *ctx, FormatBuffer *buffer, const mpfr_t value,
+                                NumberFormat format);
+
+/**
+ * Append a bare result (no "= " prefix or newline) using the default mode
+ * @param buffer Buffer to append to
+ * @param value The result to format
+ * @param original_is_int Whether input was originally an integer
+ * @return 1 on success, 0 on allocation failure
+ */
+int formatter_format_value(FormatBuffer *buffer, const mpfr_t value, int original_is_int);
+
+/**
+ * Append a bare result using a context's precision and settings
+ * @param ctx Context supplying precision, rounding and display settings
+ * @param buffer Buffer to append to
+ * @param value The result to format
+ * @param original_is_int Whether input was originally an integer
+ * @return 1 on success, 0 on allocation failure
+ */
+int formatter_format_value_ctx(const EvalContext *ctx, FormatBuffer *buffer, const mpfr_t value,
+                               int original_is_int);
+
+/**
+ * Append the result of the default context's last evaluation
+ * Like formatter_format_value(), except that in smart mode an integer the
+ * exact tier computed (see evaluator_exact_integer()) is written with all
+ * its digits, even those the value's precision cannot hold, as long as
+ * smart mode would write it out in full at all. After an interval
+ * evaluation (see evaluator_set_interval()) whose bounds differ, the
+ * midpoint is written to the digits the bounds certify, followed by
+ * " ± radius" with the radius rounded up; unbounded results are written
+ * as "[lo, hi]".
+ * @param buffer Buffer to append to
+ * @param value The result of the last evaluation
+ * @param original_is_int Whether input was originally an integer
+ * @return 1 on success, 0 on allocation failure
+ */
+int formatter_format_result(FormatBuffer *buffer, const mpfr_t value, int original_is_int);
+
+/**
+ * Append the result of a context's last evaluation using its settings
+ * @param ctx Context the value was evaluated in
+ * @param buffer Buffer to append to
+ * @param value The result of the last evaluation
+ * @param original_is_int Whether input was originally an integer
+ * @return 1 on success, 0 on allocation failure
+ */
+int formatter_format_result_ctx(const EvalContext *ctx, FormatBuffer *buffer, const mpfr_t value,
+                                int original_is_int);
+
+/**
+ * Free the scratch buffer the stream functions use on the calling thread
+ * Threads that printed through formatter_fprint_*() or formatter_print_*()
+ * call this before exiting.
+ */
+void formatter_cleanup(void);
+
 /**
  * Format and print a calculation result
  * @param value The result to format
@@ -32,10 +213,10 @@ void formatter_print_number(const mpfr_t value, NumberFormat format);
 void formatter_print_result(const mpfr_t value, int original_is_int);
 
 /**
- * Get string representation of number (caller must free)
+ * Get string representation of number using the global settings
  * @param value The number to format
  * @param format Output format style
- * @return Allocated string or NULL on failure
+ * @return Allocated string (caller must free) or NULL on failure
  */
 char *formatter_to_string(const mpfr_t value, NumberFormat format);
 
@@ -63,6 +244,14 @@ void formatter_set_default_mode(NumberFormat format);
  */
 NumberFormat formatter_get_default_mode(void);
 
+/**
+ * Get the display settings of the global API
+ * Copying them into a context's format makes the formatter_*_ctx() API
+ * print the way the global one does.
+ * @return Current settings
+ */
+FormatSettings formatter_get_settings(void);
+
 /**
  * Print current display mode information
  */
@@ -74,4 +263,31 @@ void formatter_print_current_mode(void);
  * @param original_is_int Whether input was originally an integer
  */
 void formatter_print_result_with_mode(const mpfr_t value, int original_is_int);
+
+/**
+ * Write the result of the default context's last evaluation (no newline)
+ * See formatter_format_result().
+ * @param out Output stream
+ * @param value The result of the last evaluation
+ * @param original_is_int Whether input was originally an integer
+ */
+void formatter_fprint_result(FILE *out, const mpfr_t value, int original_is_int);
+
+/**
+ * Write a bare result (no "= " prefix or newline) using the default mode
+ * @param out Output stream
+ * @param value The result to format
+ * @param original_is_int Whether input was originally an integer
+ */
+void formatter_fprint_value(FILE *out, const mpfr_t value, int original_is_int);
+
+/**
+ * Write a bare result using a context's precision and settings
+ * @param ctx Context supplying precision, rounding and display settings
+ * @param out Output stream
+ * @param value The result to format
+ * @param original_is_int Whether input was originally an integer
+ */
+void formatter_fprint_value_ctx(const EvalContext *ctx, FILE *out, const mpfr_t value,
+                                int original_is_int);
 #endif // FORMATTER_H
\ No newline at end of file
@@ -2,10 +2,26 @@
 #include "precision.h"
 #include "function_table.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static int debug_level = 0;
 
+// Precedence of the operator at the top of a node, 0 for operands that
+// never need parentheses
+static int printer_precedence(const ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_BINOP:
+        return token_get_precedence(node->binop.op);
+    case NODE_NARY:
+        return token_get_precedence(node->nary.op);
+    default:
+        return 0;
+    }
+}
+
 void printer_print_ast(const ASTNode *node, int depth)
 {
     if (!node)
@@ -24,14 +40,14 @@ void printer_print_ast(const ASTNode *node, int depth)
     switch (node->type)
     {
     case NODE_NUMBER:
-        if (node->number.is_int && mpfr_fits_slong_p(node->number.value, global_rounding))
+        if (node->number.is_int && mpfr_fits_slong_p(node->number.literal->value, global_rounding))
         {
-            long val = mpfr_get_si(node->number.value, global_rounding);
+            long val = mpfr_get_si(node->number.literal->value, global_rounding);
             printf("NUMBER: %ld\n", val);
         }
         else
         {
-            mpfr_printf("NUMBER: %.6Rf\n", node->number.value);
+            mpfr_printf("NUMBER: %.6Rf\n", node->number.literal->value);
         }
         break;
 
@@ -39,6 +55,10 @@ void printer_print_ast(const ASTNode *node, int depth)
         printf("CONSTANT: %s\n", node->constant.name);
         break;
 
+    case NODE_VARIABLE:
+        printf("VARIABLE: %s\n", node->variable.name);
+        break;
+
     case NODE_BINOP:
         printf("BINOP: %s\n", token_type_str(node->binop.op));
         printer_print_ast(node->binop.left, depth + 1);
@@ -59,6 +79,14 @@ void printer_print_ast(const ASTNode *node, int depth)
             printer_print_ast(node->function.args[i], depth + 1);
         }
         break;
+
+    case NODE_NARY:
+        printf("NARY: %s (%d operands)\n", token_type_str(node->nary.op), node->nary.count);
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            printer_print_ast(node->nary.operands[i], depth + 1);
+        }
+        break;
     }
 }
 
@@ -73,14 +101,14 @@ void printer_print_ast_compact(const ASTNode *node)
     switch (node->type)
     {
     case NODE_NUMBER:
-        if (node->number.is_int && mpfr_fits_slong_p(node->number.value, global_rounding))
+        if (node->number.is_int && mpfr_fits_slong_p(node->number.literal->value, global_rounding))
         {
-            long val = mpfr_get_si(node->number.value, global_rounding);
+            long val = mpfr_get_si(node->number.literal->value, global_rounding);
             printf("%ld", val);
         }
         else
         {
-            mpfr_printf("%.6Rf", node->number.value);
+            mpfr_printf("%.6Rf", node->number.literal->value);
         }
         break;
 
@@ -88,6 +116,10 @@ void printer_print_ast_compact(const ASTNode *node)
         printf("%s", node->constant.name);
         break;
 
+    case NODE_VARIABLE:
+        printf("%s", node->variable.name);
+        break;
+
     case NODE_BINOP:
         printf("(");
         printer_print_ast_compact(node->binop.left);
@@ -112,6 +144,17 @@ void printer_print_ast_compact(const ASTNode *node)
         }
         printf(")");
         break;
+
+    case NODE_NARY:
+        printf("(");
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            if (i > 0)
+                printf(" %s ", token_type_str(node->nary.op));
+            printer_print_ast_compact(node->nary.operands[i]);
+        }
+        printf(")");
+        break;
     }
 }
 
@@ -126,14 +169,18 @@ void printer_print_ast_infix(const ASTNode *node)
     switch (node->type)
     {
     case NODE_NUMBER:
-        if (node->number.is_int && mpfr_fits_slong_p(node->number.value, global_rounding))
+        if (node->number.is_int && mpfr_fits_slong_p(node->number.literal->value, global_rounding))
         {
-            long val = mpfr_get_si(node->number.value, global_rounding);
+            long val = mpfr_get_si(node->number.literal->value, global_rounding);
             printf("%ld", val);
         }
+        else if (node->number.is_int && mpfr_integer_p(node->number.literal->value))
+        {
+            mpfr_printf("%.0Rf", node->number.literal->value);
+        }
         else
         {
-            mpfr_printf("%.6Rf", node->number.value);
+            mpfr_printf("%.6Rf", node->number.literal->value);
         }
         break;
 
@@ -149,22 +196,28 @@ void printer_print_ast_infix(const ASTNode *node)
         }
         break;
 
+    case NODE_VARIABLE:
+        printf("%s", node->variable.name);
+        break;
+
     case NODE_BINOP:
         // Add parentheses based on operator precedence
         {
             int need_left_parens = 0;
             int need_right_parens = 0;
 
-            if (node->binop.left->type == NODE_BINOP)
+            int left_prec = printer_precedence(node->binop.left);
+            if (left_prec)
             {
-                int left_prec = token_get_precedence(node->binop.left->binop.op);
                 int curr_prec = token_get_precedence(node->binop.op);
-                need_left_parens = (left_prec < curr_prec);
+                int right_assoc = token_is_right_associative(node->binop.op);
+                need_left_parens = (left_prec < curr_prec) ||
+                                   (left_prec == curr_prec && right_assoc);
             }
 
-            if (node->binop.right->type == NODE_BINOP)
+            int right_prec = printer_precedence(node->binop.right);
+            if (right_prec)
             {
-                int right_prec = token_get_precedence(node->binop.right->binop.op);
                 int curr_prec = token_get_precedence(node->binop.op);
                 need_right_parens = (right_prec < curr_prec) ||
                                     (right_prec == curr_prec && !token_is_right_associative(node->binop.op));
@@ -235,7 +288,7 @@ void printer_print_ast_infix(const ASTNode *node)
         }
 
         // Add parentheses if operand is a binary operation
-        if (node->unary.operand->type == NODE_BINOP)
+        if (printer_precedence(node->unary.operand))
         {
             printf("(");
             printer_print_ast_infix(node->unary.operand);
@@ -257,9 +310,328 @@ void printer_print_ast_infix(const ASTNode *node)
         }
         printf(")");
         break;
+
+    case NODE_NARY:
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            // Negated terms of a sum print as subtractions
+            const ASTNode *operand = node->nary.operands[i];
+            if (node->nary.op == TOKEN_PLUS && i > 0 && operand->type == NODE_UNARY &&
+                operand->unary.op == TOKEN_MINUS)
+            {
+                printf(" - ");
+                operand = operand->unary.operand;
+            }
+            else if (i > 0)
+            {
+                printf(node->nary.op == TOKEN_PLUS ? " + " : " × ");
+            }
+
+            int parens = printer_precedence(operand) &&
+                         printer_precedence(operand) <= token_get_precedence(node->nary.op);
+            if (parens)
+                printf("(");
+            printer_print_ast_infix(operand);
+            if (parens)
+                printf(")");
+        }
+        break;
     }
 }
 
+// Binding level of a sign, tighter than any binary operator as in the parser
+#define PRINTER_PREFIX_PRECEDENCE 5
+
+static int printer_append(FormatBuffer *buffer, const char *text)
+{
+    return format_buffer_append(buffer, text, strlen(text));
+}
+
+// Whether a node prints with a leading sign
+static int printer_is_signed(const ASTNode *node)
+{
+    return (node->type == NODE_UNARY) ||
+           (node->type == NODE_NUMBER && mpfr_signbit(node->number.literal->value) &&
+            !mpfr_nan_p(node->number.literal->value));
+}
+
+// Precedence of the operator at the top of a node as input syntax, with
+// signs at PRINTER_PREFIX_PRECEDENCE; 0 for operands that are never split
+static int printer_syntax_precedence(const ASTNode *node)
+{
+    return printer_is_signed(node) ? PRINTER_PREFIX_PRECEDENCE : printer_precedence(node);
+}
+
+// Fewest decimal digits that read back as the value at its precision, as
+// from mpfr_get_str(); NULL on allocation failure
+static char *printer_shortest_digits(mpfr_srcptr value, mpfr_exp_t *exponent)
+{
+    // MPFR's own count always reads back, but often ends in noise
+    char *digits = mpfr_get_str(NULL, exponent, 10, 0, value, MPFR_RNDN);
+    if (!digits)
+    {
+        return NULL;
+    }
+    size_t most = strlen(digits) - (digits[0] == '-');
+
+    mpfr_t back;
+    mpfr_init2(back, mpfr_get_prec(value));
+    char *text = malloc(most + 32);
+    for (size_t count = 2; text && count < most; count++)
+    {
+        mpfr_exp_t shorter_exponent;
+        char *shorter = mpfr_get_str(NULL, &shorter_exponent, 10, count, value, MPFR_RNDN);
+        if (!shorter)
+        {
+            break;
+        }
+        int negative = shorter[0] == '-';
+        snprintf(text, most + 32, "%s0.%se%ld", negative ? "-" : "", shorter + negative,
+                 (long)shorter_exponent);
+        if (mpfr_set_str(back, text, 10, MPFR_RNDN) == 0 && mpfr_equal_p(back, value))
+        {
+            mpfr_free_str(digits);
+            digits = shorter;
+            *exponent = shorter_exponent;
+            break;
+        }
+        mpfr_free_str(shorter);
+    }
+    free(text);
+    mpfr_clear(back);
+    return digits;
+}
+
+// Write a literal with the fewest digits that read back as the same value
+// at its precision
+static int printer_format_literal(FormatBuffer *buffer, mpfr_srcptr value)
+{
+    if (!mpfr_number_p(value))
+    {
+        return printer_append(buffer, mpfr_nan_p(value)      ? "nan"
+                                      : mpfr_signbit(value) ? "-inf"
+                                                            : "inf");
+    }
+    if (mpfr_zero_p(value))
+    {
+        return printer_append(buffer, mpfr_signbit(value) ? "-0" : "0");
+    }
+    // Integers the precision holds exactly are written out in full
+    if (mpfr_integer_p(value) && mpfr_get_exp(value) <= mpfr_get_prec(value))
+    {
+        char *text = NULL;
+        int length = mpfr_asprintf(&text, "%.0Rf", value);
+        int ok = length >= 0 && format_buffer_append(buffer, text, (size_t)length);
+        mpfr_free_str(text);
+        return ok;
+    }
+
+    // value = 0.DIGITS * 10^exponent
+    mpfr_exp_t exponent;
+    char *digits = printer_shortest_digits(value, &exponent);
+    if (!digits)
+    {
+        buffer->failed = 1;
+        return 0;
+    }
+    const char *mantissa = digits;
+    int ok = 1;
+    if (*mantissa == '-')
+    {
+        ok = format_buffer_append_char(buffer, '-');
+        mantissa++;
+    }
+    size_t count = strlen(mantissa);
+    while (count > 1 && mantissa[count - 1] == '0')
+    {
+        count--;
+    }
+
+    // Positional notation for moderate magnitudes, scientific otherwise
+    if (exponent > 0 && exponent <= 21)
+    {
+        size_t whole = (size_t)exponent;
+        ok = ok && format_buffer_append(buffer, mantissa, whole < count ? whole : count);
+        for (size_t i = count; i < whole; i++)
+        {
+            ok = ok && format_buffer_append_char(buffer, '0');
+        }
+        if (whole < count)
+        {
+            ok = ok && format_buffer_append_char(buffer, '.') &&
+                 format_buffer_append(buffer, mantissa + whole, count - whole);
+        }
+    }
+    else if (exponent <= 0 && exponent > -6)
+    {
+        ok = ok && printer_append(buffer, "0.");
+        for (mpfr_exp_t i = exponent; i < 0; i++)
+        {
+            ok = ok && format_buffer_append_char(buffer, '0');
+        }
+        ok = ok && format_buffer_append(buffer, mantissa, count);
+    }
+    else
+    {
+        char scale[32];
+        snprintf(scale, sizeof(scale), "e%ld", (long)(exponent - 1));
+        ok = ok && format_buffer_append(buffer, mantissa, 1);
+        if (count > 1)
+        {
+            ok = ok && format_buffer_append_char(buffer, '.') &&
+                 format_buffer_append(buffer, mantissa + 1, count - 1);
+        }
+        ok = ok && printer_append(buffer, scale);
+    }
+    mpfr_free_str(digits);
+    return ok;
+}
+
+// Write an operand, in parentheses if needed
+static int printer_format_operand(FormatBuffer *buffer, const ASTNode *node, int parens)
+{
+    if (!parens)
+    {
+        return printer_format_expression(buffer, node);
+    }
+    return format_buffer_append_char(buffer, '(') && printer_format_expression(buffer, node) &&
+           format_buffer_append_char(buffer, ')');
+}
+
+static const char *printer_syntax_operator(TokenType op)
+{
+    switch (op)
+    {
+    case TOKEN_PLUS:
+        return " + ";
+    case TOKEN_MINUS:
+        return " - ";
+    case TOKEN_STAR:
+        return "*";
+    case TOKEN_SLASH:
+        return "/";
+    case TOKEN_CARET:
+        return "^";
+    case TOKEN_EQ:
+        return " == ";
+    case TOKEN_NEQ:
+        return " != ";
+    case TOKEN_LT:
+        return " < ";
+    case TOKEN_LTE:
+        return " <= ";
+    case TOKEN_GT:
+        return " > ";
+    case TOKEN_GTE:
+        return " >= ";
+    default:
+        return NULL;
+    }
+}
+
+int printer_format_expression(FormatBuffer *buffer, const ASTNode *node)
+{
+    if (!node)
+    {
+        buffer->failed = 1;
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        return printer_format_literal(buffer, node->number.literal->value);
+
+    case NODE_CONSTANT:
+        return printer_append(buffer, node->constant.name);
+
+    case NODE_VARIABLE:
+        return printer_append(buffer, node->variable.name);
+
+    case NODE_BINOP:
+    {
+        const char *symbol = printer_syntax_operator(node->binop.op);
+        if (!symbol)
+        {
+            buffer->failed = 1;
+            return 0;
+        }
+        // A signed operand is only left bare where the parser reads it the
+        // same and a reader cannot misread it: first, and not as a base
+        int precedence = token_get_precedence(node->binop.op);
+        int right_associative = token_is_right_associative(node->binop.op);
+        int left = printer_syntax_precedence(node->binop.left);
+        int right = printer_syntax_precedence(node->binop.right);
+        int left_parens = printer_is_signed(node->binop.left)
+                              ? node->binop.op == TOKEN_CARET
+                              : left && (left < precedence ||
+                                         (left == precedence && right_associative));
+        int right_parens = printer_is_signed(node->binop.right) ||
+                           (right && (right < precedence ||
+                                      (right == precedence && !right_associative)));
+        return printer_format_operand(buffer, node->binop.left, left_parens) &&
+               printer_append(buffer, symbol) &&
+               printer_format_operand(buffer, node->binop.right, right_parens);
+    }
+
+    case NODE_UNARY:
+    {
+        int ok = format_buffer_append_char(buffer, node->unary.op == TOKEN_MINUS ? '-' : '+');
+        return ok && printer_format_operand(buffer, node->unary.operand,
+                                            printer_syntax_precedence(node->unary.operand) != 0);
+    }
+
+    case NODE_FUNCTION:
+    {
+        int ok = printer_append(buffer, function_table_get_name(node->function.func_type)) &&
+                 format_buffer_append_char(buffer, '(');
+        for (int i = 0; ok && i < node->function.arg_count; i++)
+        {
+            ok = (i == 0 || printer_append(buffer, ", ")) &&
+                 printer_format_expression(buffer, node->function.args[i]);
+        }
+        return ok && format_buffer_append_char(buffer, ')');
+    }
+
+    case NODE_NARY:
+    {
+        int precedence = token_get_precedence(node->nary.op);
+        int ok = 1;
+        for (int i = 0; ok && i < node->nary.count; i++)
+        {
+            // Negated terms of a sum print as subtractions
+            const ASTNode *operand = node->nary.operands[i];
+            if (node->nary.op == TOKEN_PLUS && i > 0 && operand->type == NODE_UNARY &&
+                operand->unary.op == TOKEN_MINUS)
+            {
+                ok = printer_append(buffer, " - ");
+                operand = operand->unary.operand;
+            }
+            else if (node->nary.op == TOKEN_PLUS && i > 0 && operand->type == NODE_NUMBER &&
+                     printer_is_signed(operand) && !mpfr_inf_p(operand->number.literal->value))
+            {
+                mpfr_t magnitude;
+                mpfr_init2(magnitude, mpfr_get_prec(operand->number.literal->value));
+                mpfr_neg(magnitude, operand->number.literal->value, MPFR_RNDN);
+                ok = printer_append(buffer, " - ") && printer_format_literal(buffer, magnitude);
+                mpfr_clear(magnitude);
+                continue;
+            }
+            else if (i > 0)
+            {
+                ok = printer_append(buffer, node->nary.op == TOKEN_PLUS ? " + " : "*");
+            }
+
+            int inner = printer_syntax_precedence(operand);
+            int parens = printer_is_signed(operand) ? i > 0 : inner && inner <= precedence;
+            ok = ok && printer_format_operand(buffer, operand, parens);
+        }
+        return ok;
+    }
+    }
+    return 1;
+}
+
 void printer_print_token(const Token *token)
 {
     if (!token)
@@ -278,17 +650,15 @@ void printer_print_token(const Token *token)
     case TOKEN_FLOAT:
         printf(" (value: %g)", token->float_value);
         break;
-    case TOKEN_IDENTIFIER:
-        printf(" (string: \"%s\")", token->string_value ? token->string_value : "(null)");
+    case TOKEN_CONSTANT:
+        printf(" (constant: %d)", (int)token->constant);
         break;
     default:
         break;
     }
 
-    if (token->number_string)
-    {
-        printf(" (number_string: \"%s\")", token->number_string);
-    }
+    // Tokens do not keep the input, only where their text is in it
+    printf(" (text: %zu+%zu)", token->offset, token->length);
 
     printf("\n");
 }
@@ -2,6 +2,7 @@
 #define PRINTER_H
 
 #include "ast.h"
+#include "formatter.h"
 #include "tokens.h"
 
 /**
@@ -23,6 +24,17 @@ void printer_print_ast_compact(const ASTNode *node);
  */
 void printer_print_ast_infix(const ASTNode *node);
 
+/**
+ * Append an expression in input syntax
+ * The text parses back to the same expression: ASCII operators only,
+ * literals with every digit their precision needs, and parentheses
+ * wherever associativity or a sign would otherwise regroup the operands.
+ * @param buffer Buffer to append to
+ * @param node Expression to write
+ * @return 1 on success, 0 on allocation failure or a node with no syntax
+ */
+int printer_format_expression(FormatBuffer *buffer, const ASTNode *node);
+
 /**
  * Print token information for debugging
  * @param token Token to print
@@ -1,43 +1,152 @@
 #include "ast.h"
 #include "precision.h"
+#include "function_registry.h"
+#include "function_table.h"
+#include "profile.h"
+#include "rational.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-ASTNode *ast_create_number(const char *str, int is_int)
+// Allocate an uninitialized node from the arena, or the heap without one;
+// heap nodes get extra bytes after the node
+static ASTNode *ast_alloc_node_with(ASTArena *arena, size_t extra)
 {
-    if (!str)
+    ASTNode *node =
+        arena ? ast_arena_alloc(arena, sizeof(ASTNode)) : malloc(sizeof(ASTNode) + extra);
+    if (!node)
     {
+        fprintf(stderr, "Memory allocation failed\n");
         return NULL;
     }
+    node->arena = arena;
+    node->refs = 1;
+    node->share = -1;
+    node->exact = 0;
+    PROFILE_COUNT(PROFILE_AST_NODES, 1);
+    return node;
+}
+
+static ASTNode *ast_alloc_node(ASTArena *arena)
+{
+    return ast_alloc_node_with(arena, 0);
+}
 
-    ASTNode *node = malloc(sizeof(ASTNode));
+// Allocate a number node set to zero, its literal from the arena's literal
+// pool or right after a heap node
+static ASTNode *ast_alloc_number(ASTArena *arena, mpfr_prec_t precision)
+{
+    ASTNode *node = ast_alloc_node_with(arena, sizeof(ASTLiteral));
     if (!node)
     {
-        fprintf(stderr, "Memory allocation failed\n");
         return NULL;
     }
 
+    ASTLiteral *literal;
+    if (arena)
+    {
+        literal = ast_arena_alloc_literal(arena, sizeof(ASTLiteral), precision);
+        if (!literal)
+        {
+            fprintf(stderr, "Memory allocation failed\n");
+            return NULL;
+        }
+    }
+    else
+    {
+        literal = (ASTLiteral *)(node + 1);
+        mpfr_init2(literal->value, precision);
+        mpfr_set_zero(literal->value, 1);
+    }
+    literal->folded_precision = 0;
+    literal->folded_from = NULL;
+
     node->type = NODE_NUMBER;
-    node->number.is_int = is_int;
+    node->number.literal = literal;
+    node->number.is_int = 0;
+    return node;
+}
 
-    // Initialize MPFR number with current precision
-    mpfr_init2(node->number.value, global_precision);
+static void ast_release_node(ASTNode *node)
+{
+    if (!node->arena)
+    {
+        free(node);
+    }
+}
+
+ASTNode *ast_create_number(const char *str, int is_int)
+{
+    return ast_create_number_in(NULL, str, is_int);
+}
+
+ASTNode *ast_create_number_in(ASTArena *arena, const char *str, int is_int)
+{
+    return ast_create_number_at(arena, str, is_int, global_precision);
+}
+
+ASTNode *ast_create_number_at(ASTArena *arena, const char *str, int is_int, mpfr_prec_t precision)
+{
+    if (!str)
+    {
+        return NULL;
+    }
+
+    ASTNode *node = ast_alloc_number(arena, precision);
+    if (!node)
+    {
+        return NULL;
+    }
+    node->number.is_int = is_int;
 
     // Parse the string with MPFR
-    int ret = mpfr_set_str(node->number.value, str, 10, global_rounding);
-    if (ret != 0)
+    char *end;
+    int inexact = mpfr_strtofr(node->number.literal->value, str, &end, 10, global_rounding);
+    if (end == str || *end != '\0')
     {
         fprintf(stderr, "Failed to parse number: %s\n", str);
-        mpfr_clear(node->number.value);
-        free(node);
+        if (!arena)
+        {
+            mpfr_clear(node->number.literal->value);
+            free(node);
+        }
         return NULL;
     }
 
+    // An integer too wide for the precision was rounded and is not exact
+    node->exact = rational_node_exact(node) && inexact == 0;
     return node;
 }
 
+ASTNode *ast_create_folded_in(ASTArena *arena, ASTNode *original, mpfr_prec_t precision)
+{
+    if (!original)
+    {
+        return NULL;
+    }
+
+    ASTNode *node = ast_alloc_number(arena, precision);
+    if (!node)
+    {
+        return NULL;
+    }
+    node->number.literal->folded_precision = global_precision;
+    node->number.literal->folded_from = original;
+    return node;
+}
+
+int ast_is_stale_fold(const ASTNode *node)
+{
+    return node && node->type == NODE_NUMBER && node->number.literal->folded_from &&
+           node->number.literal->folded_precision != global_precision;
+}
+
 ASTNode *ast_create_binop(TokenType op, ASTNode *left, ASTNode *right)
+{
+    return ast_create_binop_in(NULL, op, left, right);
+}
+
+ASTNode *ast_create_binop_in(ASTArena *arena, TokenType op, ASTNode *left, ASTNode *right)
 {
     if (!left || !right)
     {
@@ -46,10 +155,9 @@ ASTNode *ast_create_binop(TokenType op, ASTNode *left, ASTNode *right)
         return NULL;
     }
 
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node(arena);
     if (!node)
     {
-        fprintf(stderr, "Memory allocation failed\n");
         ast_free(left);
         ast_free(right);
         return NULL;
@@ -59,20 +167,25 @@ ASTNode *ast_create_binop(TokenType op, ASTNode *left, ASTNode *right)
     node->binop.op = op;
     node->binop.left = left;
     node->binop.right = right;
+    node->exact = rational_node_exact(node);
     return node;
 }
 
 ASTNode *ast_create_unary(TokenType op, ASTNode *operand)
+{
+    return ast_create_unary_in(NULL, op, operand);
+}
+
+ASTNode *ast_create_unary_in(ASTArena *arena, TokenType op, ASTNode *operand)
 {
     if (!operand)
     {
         return NULL;
     }
 
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = ast_alloc_node(arena);
     if (!node)
     {
-        fprintf(stderr, "Memory allocation failed\n");
         ast_free(operand);
         return NULL;
     }
@@ -80,68 +193,361 @@ ASTNode *ast_create_unary(TokenType op, ASTNode *operand)
     node->type = NODE_UNARY;
     node->unary.op = op;
     node->unary.operand = operand;
+    node->exact = rational_node_exact(node);
     return node;
 }
 
 ASTNode *ast_create_function(TokenType func_type, ASTNode **args, int arg_count)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    return ast_create_function_in(NULL, func_type, args, arg_count);
+}
+
+ASTNode *ast_create_function_in(ASTArena *arena, TokenType func_type, ASTNode **args, int arg_count)
+{
+    ASTNode *node = ast_alloc_node(arena);
     if (!node)
     {
-        fprintf(stderr, "Memory allocation failed\n");
-        if (args)
-        {
-            for (int i = 0; i < arg_count; i++)
-            {
-                ast_free(args[i]);
-            }
-            free(args);
-        }
+        ast_free_args(arena, args, arg_count);
         return NULL;
     }
 
     node->type = NODE_FUNCTION;
     node->function.func_type = func_type;
+    node->function.def = function_registry_get(func_type);
     node->function.args = args;
     node->function.arg_count = arg_count;
+    node->exact = rational_node_exact(node);
     return node;
 }
 
+ASTNode *ast_create_nary(TokenType op, ASTNode **operands, int count)
+{
+    return ast_create_nary_in(NULL, op, operands, count);
+}
+
+ASTNode *ast_create_nary_in(ASTArena *arena, TokenType op, ASTNode **operands, int count)
+{
+    ASTNode *node = ast_alloc_node(arena);
+    if (!node)
+    {
+        ast_free_args(arena, operands, count);
+        return NULL;
+    }
+
+    node->type = NODE_NARY;
+    node->nary.op = op;
+    node->nary.operands = operands;
+    node->nary.count = count;
+    node->nary.capacity = count;
+    node->exact = rational_node_exact(node);
+    return node;
+}
+
+// The n-ary operation a binary operator chains into, or TOKEN_INVALID
+static TokenType ast_chain_op(TokenType op)
+{
+    switch (op)
+    {
+    case TOKEN_PLUS:
+    case TOKEN_MINUS:
+        return TOKEN_PLUS;
+    case TOKEN_STAR:
+        return TOKEN_STAR;
+    default:
+        return TOKEN_INVALID;
+    }
+}
+
+// Append an operand to an n-ary node, doubling its array when full
+static int ast_nary_append(ASTNode *node, ASTNode *operand)
+{
+    if (node->nary.count == node->nary.capacity)
+    {
+        int capacity = node->nary.capacity * 2;
+        ASTNode **operands;
+        if (node->arena)
+        {
+            // The old array stays in the arena until it is reset
+            operands = ast_create_args(node->arena, capacity);
+            if (operands)
+            {
+                memcpy(operands, node->nary.operands, node->nary.count * sizeof(ASTNode *));
+            }
+        }
+        else
+        {
+            operands = realloc(node->nary.operands, capacity * sizeof(ASTNode *));
+        }
+        if (!operands)
+        {
+            ast_free(operand);
+            return 0;
+        }
+        node->nary.operands = operands;
+        node->nary.capacity = capacity;
+    }
+
+    node->nary.operands[node->nary.count++] = operand;
+    node->exact = node->exact && operand->exact;
+    return 1;
+}
+
+// Turn a binary sum or product into an n-ary node with room for more
+static ASTNode *ast_nary_from_binop(ASTArena *arena, TokenType op, ASTNode *binop)
+{
+    ASTNode **operands = ast_create_args(arena, 4);
+    ASTNode *right = binop->binop.right;
+    if (operands && binop->binop.op == TOKEN_MINUS)
+    {
+        right = ast_create_unary_in(arena, TOKEN_MINUS, right);
+    }
+    if (!operands || !right)
+    {
+        ast_free_args(arena, operands, 0);
+        binop->binop.right = right;
+        ast_free(binop);
+        return NULL;
+    }
+    operands[0] = binop->binop.left;
+    operands[1] = right;
+
+    // The operands now belong to the new node
+    binop->binop.left = NULL;
+    binop->binop.right = NULL;
+    ast_free(binop);
+
+    ASTNode *node = ast_create_nary_in(arena, op, operands, 2);
+    if (node)
+    {
+        node->nary.capacity = 4;
+    }
+    return node;
+}
+
+ASTNode *ast_create_operation_in(ASTArena *arena, TokenType op, ASTNode *left, ASTNode *right)
+{
+    // Only a chain no one else refers to can grow
+    TokenType chain = ast_chain_op(op);
+    int extends = chain != TOKEN_INVALID && left && right && left->refs == 1 &&
+                  left->share < 0 && left->arena == arena &&
+                  ((left->type == NODE_NARY && left->nary.op == chain) ||
+                   (left->type == NODE_BINOP && ast_chain_op(left->binop.op) == chain));
+    if (!extends)
+    {
+        return ast_create_binop_in(arena, op, left, right);
+    }
+
+    if (op == TOKEN_MINUS && !(right = ast_create_unary_in(arena, TOKEN_MINUS, right)))
+    {
+        ast_free(left);
+        return NULL;
+    }
+    if (left->type == NODE_BINOP && !(left = ast_nary_from_binop(arena, chain, left)))
+    {
+        ast_free(right);
+        return NULL;
+    }
+    if (!ast_nary_append(left, right))
+    {
+        ast_free(left);
+        return NULL;
+    }
+    return left;
+}
+
 ASTNode *ast_create_constant(const char *name)
 {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    return ast_create_constant_in(NULL, name);
+}
+
+ASTNode *ast_create_constant_in(ASTArena *arena, const char *name)
+{
+    ASTNode *node = ast_alloc_node(arena);
     if (!node)
     {
-        fprintf(stderr, "Memory allocation failed\n");
         return NULL;
     }
 
     node->type = NODE_CONSTANT;
-    node->constant.name = strdup(name);
+    node->constant.name = arena ? ast_arena_strdup(arena, name) : strdup(name);
     if (!node->constant.name)
     {
         fprintf(stderr, "Memory allocation failed for constant name\n");
-        free(node);
+        ast_release_node(node);
         return NULL;
     }
+
+    // Resolve the name once so evaluation need not look it up again
+    const FunctionInfo *info = function_table_lookup(name);
+    node->constant.id = info && info->token == TOKEN_CONSTANT ? info->constant : CONST_COUNT;
     return node;
 }
 
-void ast_free(ASTNode *node)
+ASTNode *ast_create_variable(const char *name)
 {
+    return ast_create_variable_in(NULL, name);
+}
+
+ASTNode *ast_create_variable_in(ASTArena *arena, const char *name)
+{
+    ASTNode *node = ast_alloc_node(arena);
     if (!node)
+    {
+        return NULL;
+    }
+
+    node->type = NODE_VARIABLE;
+    node->variable.name = arena ? ast_arena_strdup(arena, name) : strdup(name);
+    if (!node->variable.name)
+    {
+        fprintf(stderr, "Memory allocation failed for variable name\n");
+        ast_release_node(node);
+        return NULL;
+    }
+    return node;
+}
+
+ASTNode **ast_create_args(ASTArena *arena, int count)
+{
+    size_t size = count * sizeof(ASTNode *);
+    ASTNode **args = arena ? ast_arena_alloc(arena, size) : malloc(size);
+    if (!args)
+    {
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    // Initialize to NULL for safe cleanup
+    for (int i = 0; i < count; i++)
+    {
+        args[i] = NULL;
+    }
+    return args;
+}
+
+void ast_free_args(ASTArena *arena, ASTNode **args, int count)
+{
+    if (!args)
     {
         return;
     }
 
+    for (int i = 0; i < count; i++)
+    {
+        ast_free(args[i]);
+    }
+    if (!arena)
+    {
+        free(args);
+    }
+}
+
+ASTNode *ast_clone(const ASTNode *node)
+{
+    if (!node)
+    {
+        return NULL;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    {
+        ASTNode *copy =
+            ast_create_number_at(NULL, "0", node->number.is_int,
+                                 mpfr_get_prec(node->number.literal->value));
+        if (!copy)
+        {
+            return NULL;
+        }
+        mpfr_set(copy->number.literal->value, node->number.literal->value, MPFR_RNDN);
+        copy->exact = node->exact;
+        if (node->number.literal->folded_from)
+        {
+            copy->number.literal->folded_from = ast_clone(node->number.literal->folded_from);
+            if (!copy->number.literal->folded_from)
+            {
+                ast_free(copy);
+                return NULL;
+            }
+            copy->number.literal->folded_precision = node->number.literal->folded_precision;
+        }
+        return copy;
+    }
+    case NODE_CONSTANT:
+        return ast_create_constant(node->constant.name);
+    case NODE_VARIABLE:
+        return ast_create_variable(node->variable.name);
+    case NODE_BINOP:
+        return ast_create_binop(node->binop.op, ast_clone(node->binop.left),
+                                ast_clone(node->binop.right));
+    case NODE_UNARY:
+        return ast_create_unary(node->unary.op, ast_clone(node->unary.operand));
+    case NODE_FUNCTION:
+    {
+        ASTNode **args = NULL;
+        if (node->function.arg_count && !(args = ast_create_args(NULL, node->function.arg_count)))
+        {
+            return NULL;
+        }
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            args[i] = ast_clone(node->function.args[i]);
+            if (!args[i])
+            {
+                ast_free_args(NULL, args, node->function.arg_count);
+                return NULL;
+            }
+        }
+        return ast_create_function(node->function.func_type, args, node->function.arg_count);
+    }
+    case NODE_NARY:
+    {
+        ASTNode **operands = ast_create_args(NULL, node->nary.count);
+        if (!operands)
+        {
+            return NULL;
+        }
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            operands[i] = ast_clone(node->nary.operands[i]);
+            if (!operands[i])
+            {
+                ast_free_args(NULL, operands, node->nary.count);
+                return NULL;
+            }
+        }
+        return ast_create_nary(node->nary.op, operands, node->nary.count);
+    }
+    }
+    return NULL;
+}
+
+void ast_free(ASTNode *node)
+{
+    // Arena nodes are released in bulk by ast_arena_reset()
+    if (!node || node->arena)
+    {
+        return;
+    }
+    if (node->refs > 1)
+    {
+        node->refs--;
+        return;
+    }
+
     switch (node->type)
     {
     case NODE_NUMBER:
-        mpfr_clear(node->number.value);
+        mpfr_clear(node->number.literal->value);
+        ast_free(node->number.literal->folded_from);
         break;
     case NODE_CONSTANT:
         free(node->constant.name);
         break;
+    case NODE_VARIABLE:
+        free(node->variable.name);
+        break;
     case NODE_BINOP:
         ast_free(node->binop.left);
         ast_free(node->binop.right);
@@ -150,14 +556,10 @@ void ast_free(ASTNode *node)
         ast_free(node->unary.operand);
         break;
     case NODE_FUNCTION:
-        if (node->function.args)
-        {
-            for (int i = 0; i < node->function.arg_count; i++)
-            {
-                ast_free(node->function.args[i]);
-            }
-            free(node->function.args);
-        }
+        ast_free_args(NULL, node->function.args, node->function.arg_count);
+        break;
+    case NODE_NARY:
+        ast_free_args(NULL, node->nary.operands, node->nary.count);
         break;
     }
     free(node);
@@ -178,14 +580,19 @@ void ast_print(const ASTNode *node, int depth)
     switch (node->type)
     {
     case NODE_NUMBER:
-        if (node->number.is_int && mpfr_fits_slong_p(node->number.value, global_rounding))
+        if (node->number.is_int && mpfr_fits_slong_p(node->number.literal->value, global_rounding))
         {
-            long val = mpfr_get_si(node->number.value, global_rounding);
+            long val = mpfr_get_si(node->number.literal->value, global_rounding);
             printf("NUMBER: %ld\n", val);
         }
+        else if (node->number.literal->folded_from)
+        {
+            mpfr_printf("NUMBER: %.6Rf (folded at %ld bits)\n", node->number.literal->value,
+                        (long)node->number.literal->folded_precision);
+        }
         else
         {
-            mpfr_printf("NUMBER: %.6Rf\n", node->number.value);
+            mpfr_printf("NUMBER: %.6Rf\n", node->number.literal->value);
         }
         break;
 
@@ -193,6 +600,10 @@ void ast_print(const ASTNode *node, int depth)
         printf("CONSTANT: %s\n", node->constant.name);
         break;
 
+    case NODE_VARIABLE:
+        printf("VARIABLE: %s\n", node->variable.name);
+        break;
+
     case NODE_BINOP:
         printf("BINOP: %s\n", token_type_str(node->binop.op));
         ast_print(node->binop.left, depth + 1);
@@ -213,5 +624,13 @@ void ast_print(const ASTNode *node, int depth)
             ast_print(node->function.args[i], depth + 1);
         }
         break;
+
+    case NODE_NARY:
+        printf("NARY: %s (%d operands)\n", token_type_str(node->nary.op), node->nary.count);
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            ast_print(node->nary.operands[i], depth + 1);
+        }
+        break;
     }
 }
\ No newline at end of file
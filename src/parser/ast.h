@@ -2,6 +2,7 @@
 #define AST_H
 
 #include "tokens.h"
+#include "ast_arena.h"
 #include <mpfr.h>
 
 typedef enum
@@ -10,18 +11,39 @@ typedef enum
     NODE_BINOP,
     NODE_UNARY,
     NODE_FUNCTION,
-    NODE_CONSTANT
+    NODE_CONSTANT,
+    NODE_VARIABLE,
+    NODE_NARY
 } NodeType;
 
+/**
+ * Numeric literal, kept apart from the node referring to it
+ *
+ * An mpfr_t alone is larger than every other node payload, so literals live
+ * in a side pool: the arena's literal region for arena nodes (limbs
+ * included), or the tail of the node's own allocation for heap nodes.
+ * Nodes stay small and packed together, which keeps tree walks in cache.
+ */
+typedef struct ASTLiteral
+{
+    mpfr_t value;                 // High precision number
+    mpfr_prec_t folded_precision; // Precision a folded value was computed for
+    struct ASTNode *folded_from;  // Original subtree of a folded value, NULL for literals
+} ASTLiteral;
+
 typedef struct ASTNode
 {
     NodeType type;
+    int refs;        // Parents referring to the node; more than one once it is shared
+    int share;       // Slot the evaluator keeps a shared node's value in, or -1
+    int exact;       // Subtree may have an exact rational value (see rational.h)
+    ASTArena *arena; // Owning arena, or NULL for heap-allocated nodes
     union
     {
         struct
         {
-            mpfr_t value; // High precision number
-            int is_int;   // Track if originally an integer
+            ASTLiteral *literal; // Value in the literal pool
+            int is_int;          // Track if originally an integer
         } number;
         struct
         {
@@ -37,13 +59,26 @@ typedef struct ASTNode
         struct
         {
             TokenType func_type;
+            const struct FunctionDef *def; // Registry entry, resolved on creation
             struct ASTNode **args;
             int arg_count;
         } function;
         struct
         {
-            char *name;  // Constant name (e.g., "pi", "e", "sqrt2")
+            char *name;      // Constant name (e.g., "pi", "e", "sqrt2")
+            ConstantType id; // Constant named, or CONST_COUNT if unknown
         } constant;
+        struct
+        {
+            char *name; // Variable name, looked up in the context's table
+        } variable;
+        struct
+        {
+            TokenType op;               // TOKEN_PLUS for a sum, TOKEN_STAR for a product
+            struct ASTNode **operands;  // Terms or factors; subtracted terms are negated
+            int count;                  // Operands in use
+            int capacity;               // Operands allocated
+        } nary;
     };
 } ASTNode;
 
@@ -81,6 +116,30 @@ ASTNode *ast_create_unary(TokenType op, ASTNode *operand);
  */
 ASTNode *ast_create_function(TokenType func_type, ASTNode **args, int arg_count);
 
+/**
+ * Create an n-ary sum or product node
+ * @param op TOKEN_PLUS for a sum of the operands, TOKEN_STAR for a product
+ * @param operands Array from ast_create_args() (takes ownership)
+ * @param count Number of operands, at least two
+ * @return New AST node or NULL on failure
+ */
+ASTNode *ast_create_nary(TokenType op, ASTNode **operands, int count);
+
+/**
+ * Create a binary operation, flattening chains of sums and products
+ * Adding a term to a sum of two or more terms (or a factor to a product)
+ * gives one NODE_NARY node holding all of them, so a long chain is one
+ * node rather than a left-leaning tree as deep as it is long. A
+ * subtracted term is stored negated. Shared operands, and every other
+ * operator, give a plain NODE_BINOP.
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param op Operation token type
+ * @param left Left operand (takes ownership)
+ * @param right Right operand (takes ownership)
+ * @return New or extended AST node, or NULL on failure
+ */
+ASTNode *ast_create_operation_in(ASTArena *arena, TokenType op, ASTNode *left, ASTNode *right);
+
 /**
  * Create a constant node
  * @param name Constant name (e.g., "pi", "e", "sqrt2")
@@ -88,8 +147,87 @@ ASTNode *ast_create_function(TokenType func_type, ASTNode **args, int arg_count)
  */
 ASTNode *ast_create_constant(const char *name);
 
+/**
+ * Create a variable reference node
+ * @param name Variable name
+ * @return New AST node or NULL on failure
+ */
+ASTNode *ast_create_variable(const char *name);
+
+/**
+ * Arena variants of the constructors above.
+ * With a NULL arena they behave exactly like the heap constructors. With an
+ * arena, the node (and any name it copies) lives until ast_arena_reset();
+ * args for ast_create_function_in() and operands for ast_create_nary_in()
+ * must come from ast_create_args().
+ */
+ASTNode *ast_create_number_in(ASTArena *arena, const char *str, int is_int);
+ASTNode *ast_create_binop_in(ASTArena *arena, TokenType op, ASTNode *left, ASTNode *right);
+ASTNode *ast_create_unary_in(ASTArena *arena, TokenType op, ASTNode *operand);
+ASTNode *ast_create_function_in(ASTArena *arena, TokenType func_type, ASTNode **args, int arg_count);
+ASTNode *ast_create_nary_in(ASTArena *arena, TokenType op, ASTNode **operands, int count);
+ASTNode *ast_create_constant_in(ASTArena *arena, const char *name);
+ASTNode *ast_create_variable_in(ASTArena *arena, const char *name);
+
+/**
+ * Create a number node parsed at an explicit precision
+ * ast_create_number_in() is this with the global precision.
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param str String representation of the number
+ * @param is_int Whether the original input was an integer
+ * @param precision Precision of the stored value
+ * @return New AST node or NULL on failure
+ */
+ASTNode *ast_create_number_at(ASTArena *arena, const char *str, int is_int, mpfr_prec_t precision);
+
+/**
+ * Create a number node holding the folded value of a constant subtree
+ * The value is initialized to NaN at the given precision for the caller to
+ * fill in, and tagged with the current global precision.
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param original Subtree the value replaces (takes ownership)
+ * @param precision Precision of the folded value
+ * @return New AST node or NULL on failure (original is left untouched)
+ */
+ASTNode *ast_create_folded_in(ASTArena *arena, ASTNode *original, mpfr_prec_t precision);
+
+/**
+ * Check whether a node is a folded value computed for another precision
+ * Stale folds must be evaluated through their original subtree.
+ * @param node Node to check
+ * @return 1 if the node is a stale fold, 0 otherwise
+ */
+int ast_is_stale_fold(const ASTNode *node);
+
+/**
+ * Allocate a NULL-initialized argument array for a function node
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param count Number of arguments
+ * @return New array or NULL on failure
+ */
+ASTNode **ast_create_args(ASTArena *arena, int count);
+
+/**
+ * Free an argument array that was not handed to a function node
+ * @param arena Arena the array came from, or NULL for the heap
+ * @param args Argument array
+ * @param count Number of arguments to free
+ */
+void ast_free_args(ASTArena *arena, ASTNode **args, int count);
+
+/**
+ * Copy a tree onto the heap
+ * Folded values keep their original subtree and precision tag. Shared
+ * subexpressions are copied once per parent, so the copy is a plain tree.
+ * @param node Root node to copy (arena or heap)
+ * @return New heap-allocated tree or NULL on failure
+ */
+ASTNode *ast_clone(const ASTNode *node);
+
 /**
  * Free an AST and all its children
+ * Arena-owned trees are left alone; they are released by ast_arena_reset().
+ * A shared node is only freed along with the last of its parents.
  * @param node Root node to free
  */
 void ast_free(ASTNode *node);
@@ -0,0 +1,202 @@
+#include "ast_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t size;
+    size_t used;
+    max_align_t data[]; // Block memory follows the header
+};
+
+static size_t align_up(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaBlock *block_create(size_t size)
+{
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (!block)
+    {
+        return NULL;
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static int region_init(ArenaRegion *region, size_t size)
+{
+    region->blocks = block_create(size);
+    region->current = region->blocks;
+    return region->blocks != NULL;
+}
+
+ASTArena *ast_arena_create(size_t block_size)
+{
+    ASTArena *arena = malloc(sizeof(ASTArena));
+    if (!arena)
+    {
+        return NULL;
+    }
+
+    arena->block_size = align_up(block_size ? block_size : AST_ARENA_DEFAULT_BLOCK_SIZE);
+    if (!region_init(&arena->nodes, arena->block_size))
+    {
+        free(arena);
+        return NULL;
+    }
+    // Literals are rarer than nodes, so their region starts smaller
+    if (!region_init(&arena->literals, align_up(arena->block_size / 4)))
+    {
+        free(arena->nodes.blocks);
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+static void *region_alloc(ArenaRegion *region, size_t size, size_t block_size)
+{
+    size = align_up(size ? size : 1);
+
+    // Move on to the next block with room, reusing blocks kept from earlier
+    // parses before allocating new ones
+    ArenaBlock *block = region->current;
+    while (block->size - block->used < size)
+    {
+        if (block->next && block->next->used == 0 && block->next->size >= size)
+        {
+            block = block->next;
+            continue;
+        }
+
+        ArenaBlock *fresh = block_create(size > block_size ? size : block_size);
+        if (!fresh)
+        {
+            return NULL;
+        }
+        fresh->next = block->next;
+        block->next = fresh;
+        block = fresh;
+    }
+
+    region->current = block;
+    void *ptr = (char *)block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void *ast_arena_alloc(ASTArena *arena, size_t size)
+{
+    if (!arena)
+    {
+        return NULL;
+    }
+    return region_alloc(&arena->nodes, size, arena->block_size);
+}
+
+void *ast_arena_alloc_literal(ASTArena *arena, size_t size, mpfr_prec_t precision)
+{
+    if (!arena || size < sizeof(__mpfr_struct))
+    {
+        return NULL;
+    }
+
+    // Literal and limbs in one piece of the literal region
+    size_t offset = align_up(size);
+    char *memory = region_alloc(&arena->literals, offset + mpfr_custom_get_size(precision),
+                                arena->block_size);
+    if (!memory)
+    {
+        return NULL;
+    }
+
+    mpfr_custom_init(memory + offset, precision);
+    mpfr_custom_init_set((mpfr_ptr)memory, MPFR_ZERO_KIND, 0, precision, memory + offset);
+    return memory;
+}
+
+char *ast_arena_strdup(ASTArena *arena, const char *str)
+{
+    if (!str)
+    {
+        return NULL;
+    }
+
+    size_t length = strlen(str) + 1;
+    char *copy = ast_arena_alloc(arena, length);
+    if (copy)
+    {
+        memcpy(copy, str, length);
+    }
+    return copy;
+}
+
+static size_t region_used(const ArenaRegion *region)
+{
+    size_t used = 0;
+    for (const ArenaBlock *block = region->blocks; block; block = block->next)
+    {
+        used += block->used;
+    }
+    return used;
+}
+
+size_t ast_arena_used(const ASTArena *arena, size_t *literals)
+{
+    if (literals)
+    {
+        *literals = arena ? region_used(&arena->literals) : 0;
+    }
+    return arena ? region_used(&arena->nodes) : 0;
+}
+
+static void region_reset(ArenaRegion *region)
+{
+    for (ArenaBlock *block = region->blocks; block; block = block->next)
+    {
+        block->used = 0;
+    }
+    region->current = region->blocks;
+}
+
+void ast_arena_reset(ASTArena *arena)
+{
+    if (!arena)
+    {
+        return;
+    }
+
+    // Literal limbs live in the pool, so there is nothing to clear
+    region_reset(&arena->nodes);
+    region_reset(&arena->literals);
+}
+
+static void region_free(ArenaRegion *region)
+{
+    ArenaBlock *block = region->blocks;
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void ast_arena_destroy(ASTArena *arena)
+{
+    if (!arena)
+    {
+        return;
+    }
+
+    region_free(&arena->nodes);
+    region_free(&arena->literals);
+    free(arena);
+}
@@ -0,0 +1,96 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <stddef.h>
+#include <mpfr.h>
+
+// Default block size for AST arenas (enough for a few hundred nodes)
+#define AST_ARENA_DEFAULT_BLOCK_SIZE 16384
+
+typedef struct ArenaBlock ArenaBlock;
+
+/**
+ * Chain of blocks filled one after another
+ */
+typedef struct
+{
+    ArenaBlock *blocks;  // All blocks, in allocation order
+    ArenaBlock *current; // Block currently being filled
+} ArenaRegion;
+
+/**
+ * Bump allocator for the nodes of one parse.
+ *
+ * Nodes, names and argument arrays are carved out of large blocks and are
+ * released all at once by ast_arena_reset(). Blocks are kept across resets,
+ * so parsing line after line reaches a steady state with no block
+ * allocations. Numeric literals and their limbs come from a region of
+ * their own, so the nodes of a tree sit next to each other instead of
+ * being spread out between literals.
+ */
+typedef struct ASTArena
+{
+    ArenaRegion nodes;    // Nodes, names and argument arrays
+    ArenaRegion literals; // Literal pool: MPFR values and their limbs
+    size_t block_size;    // Size of regular blocks
+} ASTArena;
+
+/**
+ * Create an empty arena
+ * @param block_size Size of each block, or 0 for AST_ARENA_DEFAULT_BLOCK_SIZE
+ * @return New arena or NULL on failure
+ */
+ASTArena *ast_arena_create(size_t block_size);
+
+/**
+ * Allocate memory from the arena
+ * The memory is suitably aligned for any type and lives until the next reset.
+ * @param arena Arena to allocate from
+ * @param size Number of bytes
+ * @return Pointer to memory or NULL on failure
+ */
+void *ast_arena_alloc(ASTArena *arena, size_t size);
+
+/**
+ * Copy a string into the arena
+ * @param arena Arena to allocate from
+ * @param str String to copy
+ * @return Arena copy of the string or NULL on failure
+ */
+char *ast_arena_strdup(ASTArena *arena, const char *str);
+
+/**
+ * Allocate a literal and its limbs from the literal pool
+ * The memory starts with an mpfr_t, initialized to zero with MPFR's custom
+ * interface and followed by its limbs. The value must not be cleared or
+ * have its precision changed; it lives until the next reset like any other
+ * arena memory.
+ * @param arena Arena to allocate from
+ * @param size Size of the caller's literal structure, whose first member is the mpfr_t
+ * @param precision Precision of the value
+ * @return Pointer to the literal or NULL on failure
+ */
+void *ast_arena_alloc_literal(ASTArena *arena, size_t size, mpfr_prec_t precision);
+
+/**
+ * Count the bytes handed out since the last reset
+ * @param arena Arena to measure
+ * @param literals Receives the bytes used by the literal pool, may be NULL
+ * @return Bytes used by nodes, names and argument arrays
+ */
+size_t ast_arena_used(const ASTArena *arena, size_t *literals);
+
+/**
+ * Release everything allocated since the last reset
+ * Rewinds all blocks for reuse.
+ * @param arena Arena to reset
+ */
+void ast_arena_reset(ASTArena *arena);
+
+/**
+ * Reset the arena and free all of its blocks
+ * @param arena Arena to destroy
+ */
+void ast_arena_destroy(ASTArena *arena);
+
+#endif // AST_ARENA_H
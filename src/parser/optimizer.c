@@ -0,0 +1,558 @@
+#include "optimizer.h"
+#include "evaluator.h"
+#include "precision.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Interior nodes a tree needs before sharing can save anything: two equal
+// subexpressions and an operation combining them
+#define SHARE_MIN_OPERATIONS 3
+
+// Tables up to this many slots live on the stack
+#define SHARE_LOCAL_SLOTS 64
+
+// Check whether a subtree depends only on literals and constants
+static int is_constant_subtree(const ASTNode *node)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    case NODE_CONSTANT:
+        return 1;
+    case NODE_BINOP:
+        return is_constant_subtree(node->binop.left) && is_constant_subtree(node->binop.right);
+    case NODE_UNARY:
+        return is_constant_subtree(node->unary.operand);
+    case NODE_FUNCTION:
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            if (!is_constant_subtree(node->function.args[i]))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    case NODE_NARY:
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            if (!is_constant_subtree(node->nary.operands[i]))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Drop a folded node and hand back the subtree it replaced
+static ASTNode *unfold(ASTNode *folded)
+{
+    ASTNode *original = folded->number.literal->folded_from;
+    if (!folded->arena)
+    {
+        folded->number.literal->folded_from = NULL;
+        ast_free(folded);
+    }
+    return original;
+}
+
+// Evaluate a subtree once and wrap the value in a folded number node.
+// Returns the original node when the value is not safe to cache.
+static ASTNode *try_fold(ASTNode *node)
+{
+    // Parents read their operands at the working precision, so that is
+    // the precision the folded value has to be exact at
+    ASTNode *folded = ast_create_folded_in(node->arena, node,
+                                           global_precision + BINOP_PRECISION_BOOST);
+    if (!folded)
+    {
+        return node;
+    }
+
+    // Strict mode turns domain failures into errors, so a value that only
+    // stands in for a failed call is never cached
+    int strict = evaluator_get_strict_mode();
+    evaluator_set_strict_mode(1);
+    evaluator_eval(folded->number.literal->value, node);
+    evaluator_set_strict_mode(strict);
+
+    if (evaluator_get_last_error() || mpfr_nan_p(folded->number.literal->value))
+    {
+        evaluator_clear_error();
+        unfold(folded);
+        return node;
+    }
+
+    return folded;
+}
+
+static ASTNode *fold_node(ASTNode *node, int is_root)
+{
+    if (!node)
+    {
+        return NULL;
+    }
+
+    if (ast_is_stale_fold(node))
+    {
+        node = unfold(node);
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        // A literal, or a fold that is still current
+        return node;
+
+    case NODE_CONSTANT:
+        // A lone constant is already rounded once, straight into the result
+        return is_root ? node : try_fold(node);
+
+    case NODE_FUNCTION:
+        // The root call flushes tiny values after the final rounding
+        if (!is_root && is_constant_subtree(node))
+        {
+            ASTNode *folded = try_fold(node);
+            if (folded != node)
+            {
+                return folded;
+            }
+        }
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            node->function.args[i] = fold_node(node->function.args[i], 0);
+        }
+        return node;
+
+    case NODE_BINOP:
+    case NODE_UNARY:
+    case NODE_NARY:
+        if (is_constant_subtree(node))
+        {
+            ASTNode *folded = try_fold(node);
+            if (folded != node)
+            {
+                return folded;
+            }
+        }
+        if (node->type == NODE_BINOP)
+        {
+            node->binop.left = fold_node(node->binop.left, 0);
+            node->binop.right = fold_node(node->binop.right, 0);
+        }
+        else if (node->type == NODE_UNARY)
+        {
+            node->unary.operand = fold_node(node->unary.operand, 0);
+        }
+        else
+        {
+            for (int i = 0; i < node->nary.count; i++)
+            {
+                node->nary.operands[i] = fold_node(node->nary.operands[i], 0);
+            }
+        }
+        return node;
+
+    default:
+        return node;
+    }
+}
+
+ASTNode *optimizer_fold_constants(ASTNode *root)
+{
+    return fold_node(root, 1);
+}
+
+int optimizer_count_folds(const ASTNode *node)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+        return node->number.literal->folded_from && !ast_is_stale_fold(node) ? 1 : 0;
+    case NODE_BINOP:
+        return optimizer_count_folds(node->binop.left) + optimizer_count_folds(node->binop.right);
+    case NODE_UNARY:
+        return optimizer_count_folds(node->unary.operand);
+    case NODE_FUNCTION:
+    {
+        int count = 0;
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            count += optimizer_count_folds(node->function.args[i]);
+        }
+        return count;
+    }
+    case NODE_NARY:
+    {
+        int count = 0;
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            count += optimizer_count_folds(node->nary.operands[i]);
+        }
+        return count;
+    }
+    default:
+        return 0;
+    }
+}
+
+// Open addressing table of the distinct operations seen so far
+typedef struct
+{
+    ASTNode **slots;
+    size_t mask;
+    int shared; // Share slots handed out
+} ShareTable;
+
+static int is_operation(const ASTNode *node)
+{
+    return node && (node->type == NODE_BINOP || node->type == NODE_UNARY ||
+                    node->type == NODE_FUNCTION || node->type == NODE_NARY);
+}
+
+static int count_operations(const ASTNode *node)
+{
+    if (!is_operation(node))
+    {
+        return 0;
+    }
+    switch (node->type)
+    {
+    case NODE_BINOP:
+        return 1 + count_operations(node->binop.left) + count_operations(node->binop.right);
+    case NODE_UNARY:
+        return 1 + count_operations(node->unary.operand);
+    case NODE_NARY:
+    {
+        int count = 1;
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            count += count_operations(node->nary.operands[i]);
+        }
+        return count;
+    }
+    default:
+    {
+        int count = 1;
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            count += count_operations(node->function.args[i]);
+        }
+        return count;
+    }
+    }
+}
+
+static uint64_t hash_mix(uint64_t hash, uint64_t value)
+{
+    hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, const char *text)
+{
+    while (*text)
+    {
+        hash = (hash ^ (unsigned char)*text++) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Operands hash by value when they are leaves and by identity otherwise,
+// since equal operations have been merged into one node by then
+static uint64_t hash_operand(const ASTNode *node)
+{
+    if (!node)
+    {
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NODE_NUMBER:
+    {
+        if (node->number.literal->folded_from)
+        {
+            return (uint64_t)(uintptr_t)node;
+        }
+        double approx = mpfr_get_d(node->number.literal->value, MPFR_RNDZ);
+        uint64_t bits;
+        memcpy(&bits, &approx, sizeof(bits));
+        return hash_mix(hash_mix(bits, (uint64_t)mpfr_get_prec(node->number.literal->value)),
+                        (uint64_t)node->number.is_int);
+    }
+    case NODE_CONSTANT:
+        return hash_string(0xcbf29ce484222325ULL, node->constant.name);
+    case NODE_VARIABLE:
+        return hash_string(0x84222325cbf29ce4ULL, node->variable.name);
+    default:
+        return (uint64_t)(uintptr_t)node;
+    }
+}
+
+static int same_operand(const ASTNode *a, const ASTNode *b)
+{
+    if (a == b)
+    {
+        return 1;
+    }
+    if (!a || !b || a->type != b->type)
+    {
+        return 0;
+    }
+
+    switch (a->type)
+    {
+    case NODE_NUMBER:
+        // Folded values are only equal to themselves
+        return !a->number.literal->folded_from && !b->number.literal->folded_from &&
+               a->number.is_int == b->number.is_int &&
+               mpfr_get_prec(a->number.literal->value) == mpfr_get_prec(b->number.literal->value) &&
+               mpfr_equal_p(a->number.literal->value, b->number.literal->value) &&
+               mpfr_signbit(a->number.literal->value) == mpfr_signbit(b->number.literal->value);
+    case NODE_CONSTANT:
+        return a->constant.id == b->constant.id && strcmp(a->constant.name, b->constant.name) == 0;
+    case NODE_VARIABLE:
+        return strcmp(a->variable.name, b->variable.name) == 0;
+    default:
+        return 0;
+    }
+}
+
+static uint64_t hash_operation(const ASTNode *node)
+{
+    uint64_t hash = hash_mix((uint64_t)node->type, 0);
+    switch (node->type)
+    {
+    case NODE_BINOP:
+        hash = hash_mix(hash, (uint64_t)node->binop.op);
+        hash = hash_mix(hash, hash_operand(node->binop.left));
+        return hash_mix(hash, hash_operand(node->binop.right));
+    case NODE_UNARY:
+        hash = hash_mix(hash, (uint64_t)node->unary.op);
+        return hash_mix(hash, hash_operand(node->unary.operand));
+    case NODE_NARY:
+        hash = hash_mix(hash, (uint64_t)node->nary.op);
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            hash = hash_mix(hash, hash_operand(node->nary.operands[i]));
+        }
+        return hash;
+    default:
+        hash = hash_mix(hash, (uint64_t)node->function.func_type);
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            hash = hash_mix(hash, hash_operand(node->function.args[i]));
+        }
+        return hash;
+    }
+}
+
+static int same_operation(const ASTNode *a, const ASTNode *b)
+{
+    if (a->type != b->type)
+    {
+        return 0;
+    }
+
+    switch (a->type)
+    {
+    case NODE_BINOP:
+        return a->binop.op == b->binop.op && same_operand(a->binop.left, b->binop.left) &&
+               same_operand(a->binop.right, b->binop.right);
+    case NODE_UNARY:
+        return a->unary.op == b->unary.op && same_operand(a->unary.operand, b->unary.operand);
+    case NODE_NARY:
+        if (a->nary.op != b->nary.op || a->nary.count != b->nary.count)
+        {
+            return 0;
+        }
+        for (int i = 0; i < a->nary.count; i++)
+        {
+            if (!same_operand(a->nary.operands[i], b->nary.operands[i]))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    default:
+        if (a->function.func_type != b->function.func_type ||
+            a->function.arg_count != b->function.arg_count)
+        {
+            return 0;
+        }
+        for (int i = 0; i < a->function.arg_count; i++)
+        {
+            if (!same_operand(a->function.args[i], b->function.args[i]))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+}
+
+// Whether keeping a shared node's value beats computing it again. Its
+// operands are shared too, and were given their slots first.
+static int worth_keeping(const ASTNode *node)
+{
+    switch (node->type)
+    {
+    case NODE_BINOP:
+        return node->binop.op == TOKEN_STAR || node->binop.op == TOKEN_SLASH ||
+               node->binop.op == TOKEN_CARET || node->binop.left->share >= 0 ||
+               node->binop.right->share >= 0;
+    case NODE_UNARY:
+        return node->unary.operand->share >= 0;
+    case NODE_NARY:
+        if (node->nary.op == TOKEN_STAR)
+        {
+            return 1;
+        }
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            if (node->nary.operands[i]->share >= 0)
+            {
+                return 1;
+            }
+        }
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+// Drop a duplicate whose operations are all shared with its twin
+static void drop_duplicate(ASTNode *node)
+{
+    if (!node->arena)
+    {
+        ast_free(node);
+        return;
+    }
+
+    // Arena nodes stay allocated, but no longer count as parents
+    switch (node->type)
+    {
+    case NODE_BINOP:
+        node->binop.left->refs--;
+        node->binop.right->refs--;
+        break;
+    case NODE_UNARY:
+        node->unary.operand->refs--;
+        break;
+    case NODE_NARY:
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            node->nary.operands[i]->refs--;
+        }
+        break;
+    default:
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            node->function.args[i]->refs--;
+        }
+        break;
+    }
+}
+
+// Merge the operations under a node bottom up and return the node that
+// stands for it: the node itself, or an equal one found earlier
+static ASTNode *share_node(ShareTable *table, ASTNode *node)
+{
+    if (!is_operation(node))
+    {
+        return node;
+    }
+
+    switch (node->type)
+    {
+    case NODE_BINOP:
+        node->binop.left = share_node(table, node->binop.left);
+        node->binop.right = share_node(table, node->binop.right);
+        break;
+    case NODE_UNARY:
+        node->unary.operand = share_node(table, node->unary.operand);
+        break;
+    case NODE_NARY:
+        for (int i = 0; i < node->nary.count; i++)
+        {
+            node->nary.operands[i] = share_node(table, node->nary.operands[i]);
+        }
+        break;
+    default:
+        for (int i = 0; i < node->function.arg_count; i++)
+        {
+            node->function.args[i] = share_node(table, node->function.args[i]);
+        }
+        break;
+    }
+
+    size_t index = (size_t)hash_operation(node) & table->mask;
+    while (table->slots[index])
+    {
+        ASTNode *twin = table->slots[index];
+        if (twin == node)
+        {
+            return node;
+        }
+        if (same_operation(twin, node))
+        {
+            twin->refs++;
+            if (twin->share < 0 && worth_keeping(twin))
+            {
+                twin->share = table->shared++;
+            }
+            drop_duplicate(node);
+            return twin;
+        }
+        index = (index + 1) & table->mask;
+    }
+    table->slots[index] = node;
+    return node;
+}
+
+int optimizer_share_subexpressions(ASTNode *root)
+{
+    int operations = count_operations(root);
+    if (operations < SHARE_MIN_OPERATIONS)
+    {
+        return 0;
+    }
+
+    // At most half full
+    size_t capacity = SHARE_LOCAL_SLOTS;
+    while (capacity < 2 * (size_t)operations)
+    {
+        capacity *= 2;
+    }
+    ASTNode *local[SHARE_LOCAL_SLOTS];
+    ASTNode **slots = capacity == SHARE_LOCAL_SLOTS ? local : malloc(capacity * sizeof(*slots));
+    if (!slots)
+    {
+        return 0;
+    }
+    memset(slots, 0, capacity * sizeof(*slots));
+
+    ShareTable table = {slots, capacity - 1, 0};
+    share_node(&table, root);
+
+    if (slots != local)
+    {
+        free(slots);
+    }
+    return table.shared;
+}
@@ -0,0 +1,52 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.h"
+
+/**
+ * Fold constant subtrees of an AST into single number nodes.
+ *
+ * Every maximal subtree built only from literals, constants, operators and
+ * function calls is evaluated once at the evaluator's working precision and
+ * replaced by a NODE_NUMBER that keeps the original subtree. Folded values
+ * are tagged with the current precision; after set_precision() they are
+ * ignored by the evaluator until the tree is folded again, which refreshes
+ * them. Subtrees whose evaluation reports an error (including domain errors
+ * that only strict mode reports) or produces NaN are left alone, so errors
+ * still surface when the tree is evaluated.
+ *
+ * Evaluating the folded tree gives bit-identical results to the original.
+ * The root is folded only when that holds for its final rounding, so a
+ * lone constant or function call stays as it is.
+ *
+ * @param root Tree to optimize (takes ownership)
+ * @return Optimized tree, which may be a different node than root
+ */
+ASTNode *optimizer_fold_constants(ASTNode *root);
+
+/**
+ * Count the folded nodes that are current for the global precision
+ * @param node Tree to inspect
+ * @return Number of current folded values
+ */
+int optimizer_count_folds(const ASTNode *node);
+
+/**
+ * Merge structurally identical subexpressions into shared nodes.
+ *
+ * Operators and function calls repeated with the same operands become one
+ * node with several parents, so the tree turns into a DAG; duplicates are
+ * freed, or left to the arena for arena trees. Shared nodes worth keeping,
+ * those with a multiplication, division, power or function call in them,
+ * get a share slot, and the evaluator computes each of them once per
+ * evaluation. Literals, constants and variables are compared by value but
+ * not merged. ast_free() counts references, so the result is freed as
+ * before. Fold constants first: folding keeps working on a shared tree,
+ * but no longer shares the folded parts.
+ *
+ * @param root Tree to optimize, changed in place
+ * @return Number of shared nodes given a share slot
+ */
+int optimizer_share_subexpressions(ASTNode *root);
+
+#endif // OPTIMIZER_H
@@ -1,21 +1,56 @@
 #include "parser.h"
 #include "ast.h"
 #include "function_table.h"
+#include "optimizer.h"
+#include "precision.h"
+#include "profile.h"
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Maximum recursion depth to prevent stack overflow
-#define MAX_RECURSION_DEPTH 100
+// Default bound on nesting, well below the depth at which the recursive
+// tree walkers (evaluator, optimizer, ast_free) would exhaust the C stack
+#define PARSER_MAX_NESTING_DEPTH 10000
+
+// Room for the text of any number or name the lexer produces
+#define PARSER_MAX_TOKEN_TEXT 256
 
 // Forward declarations for static functions
-static ASTNode *parse_expression_impl(Parser *parser);
-static ASTNode *parse_comparison_impl(Parser *parser);
-static ASTNode *parse_term_impl(Parser *parser);
-static ASTNode *parse_factor_impl(Parser *parser);
-static ASTNode *parse_power_impl(Parser *parser);
-static ASTNode *parse_unary_impl(Parser *parser);
-static ASTNode *parse_primary_impl(Parser *parser);
+static ASTNode *parse_atom(Parser *parser);
+
+// Record a parse error. The first message is kept for
+// parser_get_error_message(); every message goes to stderr unless the
+// parser is quiet.
+static void parser_error(Parser *parser, const char *format, ...)
+{
+    char message[sizeof(parser->error_message)];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    if (parser->error_message[0] == '\0')
+    {
+        snprintf(parser->error_message, sizeof(parser->error_message), "%s", message);
+    }
+    parser->error_occurred = 1;
+
+    if (!parser->quiet)
+    {
+        fprintf(stderr, "%s\n", message);
+    }
+}
+
+// Copy a token's text out of the input as a terminated string, truncated to
+// the buffer
+static void parser_token_text(const Parser *parser, const Token *token, char *buffer,
+                              size_t size)
+{
+    size_t length = token->length < size - 1 ? token->length : size - 1;
+    memcpy(buffer, lexer_token_text(parser->lexer, token), length);
+    buffer[length] = '\0';
+}
 
 // Helper function for implicit multiplication detection
 static int should_insert_multiplication(Parser *parser)
@@ -28,6 +63,10 @@ static int should_insert_multiplication(Parser *parser)
     TokenType prev = parser->previous_token.type;
     TokenType curr = parser->current_token.type;
 
+    // Variables take part like constants do
+    int prev_name = token_is_constant(prev) || prev == TOKEN_IDENTIFIER;
+    int curr_name = token_is_constant(curr) || curr == TOKEN_IDENTIFIER;
+
     // Check for implicit multiplication patterns
     return (
         // Number followed by '('
@@ -43,12 +82,21 @@ static int should_insert_multiplication(Parser *parser)
         ((prev == TOKEN_INT || prev == TOKEN_FLOAT) && token_is_function(curr)) ||
         // ')' followed by function
         (prev == TOKEN_RPAREN && token_is_function(curr)) ||
-        // Number or ')' followed by constant
-        ((prev == TOKEN_INT || prev == TOKEN_FLOAT || prev == TOKEN_RPAREN) &&
-         token_is_constant(curr)) ||
-        // Constant followed by number or '('
-        (token_is_constant(prev) &&
-         (curr == TOKEN_INT || curr == TOKEN_FLOAT || curr == TOKEN_LPAREN)));
+        // Number or ')' followed by constant or variable
+        ((prev == TOKEN_INT || prev == TOKEN_FLOAT || prev == TOKEN_RPAREN) && curr_name) ||
+        // Constant or variable followed by number or '('
+        (prev_name && (curr == TOKEN_INT || curr == TOKEN_FLOAT || curr == TOKEN_LPAREN)));
+}
+
+// Token of a token array, reading past its end as the end of the input
+static Token parser_token_at(const Parser *parser, size_t index)
+{
+    if (index < parser->token_count)
+    {
+        return parser->tokens[index];
+    }
+    size_t end = parser->lexer ? parser->lexer->input_length : 0;
+    return (Token){.type = TOKEN_EOF, .offset = end, .length = 0};
 }
 
 void parser_init(Parser *parser, Lexer *lexer)
@@ -57,14 +105,24 @@ void parser_init(Parser *parser, Lexer *lexer)
         return;
 
     parser->lexer = lexer;
+    parser->arena = NULL;
     parser->previous_token = (Token){.type = TOKEN_INVALID};
     parser->recursion_depth = 0;
-    parser->max_depth = MAX_RECURSION_DEPTH;
+    parser->max_depth = PARSER_MAX_NESTING_DEPTH;
     parser->error_occurred = 0;
+    parser->error_message[0] = '\0';
+    parser->quiet = 0;
+    parser->precision = 0;
+    parser->share = 1;
+    parser->inexact_literals = 0;
+    parser->tokens = NULL;
+    parser->token_count = 0;
+    parser->token_next = 0;
 
     if (lexer)
     {
         parser->current_token = lexer_get_next_token(lexer);
+        PROFILE_COUNT(PROFILE_TOKENS, 1);
     }
     else
     {
@@ -81,231 +139,549 @@ void parser_advance(Parser *parser)
     token_free(&parser->previous_token);
 
     parser->previous_token = parser->current_token;
+    if (parser->tokens)
+    {
+        parser->current_token = parser_token_at(parser, parser->token_next);
+        if (parser->token_next < parser->token_count)
+        {
+            parser->token_next++;
+        }
+        return;
+    }
     parser->current_token = lexer_get_next_token(parser->lexer);
+    PROFILE_COUNT(PROFILE_TOKENS, 1);
 }
 
-// Wrapper functions with recursion depth checking
-#define CHECK_RECURSION_DEPTH(parser, func_name)                                    \
-    do                                                                              \
-    {                                                                               \
-        if (!parser)                                                                \
-            return NULL;                                                            \
-        if (parser->recursion_depth >= parser->max_depth)                           \
-        {                                                                           \
-            fprintf(stderr, "Maximum recursion depth exceeded in %s\n", func_name); \
-            parser->error_occurred = 1;                                             \
-            return NULL;                                                            \
-        }                                                                           \
-        parser->recursion_depth++;                                                  \
-    } while (0)
-
-#define RETURN_WITH_DEPTH_DECREMENT(parser, result) \
-    do                                              \
-    {                                               \
-        if (parser)                                 \
-            parser->recursion_depth--;              \
-        return result;                              \
-    } while (0)
+// The parser is an operator-precedence parser driven by an explicit stack,
+// so nesting depth costs heap memory rather than C stack. Operands wait on
+// one stack and unfinished constructs on another: a prefix operator still
+// missing its operand, a binary operator still missing its right side, an
+// open parenthesis or a function call collecting its arguments.
+typedef enum
+{
+    FRAME_UNARY,
+    FRAME_BINARY,
+    FRAME_GROUP,
+    FRAME_CALL
+} ParseFrameKind;
+
+typedef struct
+{
+    ParseFrameKind kind;
+    TokenType op;       // Operator, or the function called
+    ASTNode **args;     // Arguments of a call
+    int arg_count;      // Arguments of a call parsed so far
+    int expected_args;  // Arguments the function takes
+    int saved_implicit; // Implicit multiplications outside a group or call
+} ParseFrame;
+
+// Entries kept inline before the stacks move to the heap
+#define PARSE_STACK_INLINE 32
+
+typedef struct
+{
+    ParseFrame *frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    ASTNode **operands;
+    size_t operand_count;
+    size_t operand_capacity;
+    int open_count;     // Groups and calls among the frames
+    int nesting;        // Frames that will become nodes: all but groups
+    int max_nesting;    // Deepest nesting so far
+    int implicit_count; // Implicit multiplications in the current product
+    ParseFrame frame_storage[PARSE_STACK_INLINE];
+    ASTNode *operand_storage[PARSE_STACK_INLINE];
+} ParseStack;
+
+// Precedence of prefix operators, above every binary operator
+#define UNARY_PRECEDENCE 5
+
+// An implicit multiplication chain this long is treated as runaway input
+#define MAX_IMPLICIT_MULTIPLICATIONS 1000
+
+static void parse_stack_init(ParseStack *stack)
+{
+    stack->frames = stack->frame_storage;
+    stack->frame_count = 0;
+    stack->frame_capacity = PARSE_STACK_INLINE;
+    stack->operands = stack->operand_storage;
+    stack->operand_count = 0;
+    stack->operand_capacity = PARSE_STACK_INLINE;
+    stack->open_count = 0;
+    stack->nesting = 0;
+    stack->max_nesting = 0;
+    stack->implicit_count = 0;
+}
 
-ASTNode *parser_parse_expression(Parser *parser)
+// Grow one of the stacks, moving it off the inline storage the first time
+static int parse_stack_grow(void **items, size_t *capacity, void *storage, size_t item_size)
 {
-    CHECK_RECURSION_DEPTH(parser, "parse_expression");
-    ASTNode *result = parse_expression_impl(parser);
-    RETURN_WITH_DEPTH_DECREMENT(parser, result);
+    size_t new_capacity = *capacity * 2;
+    void *grown;
+    if (*items == storage)
+    {
+        grown = malloc(new_capacity * item_size);
+        if (grown)
+        {
+            memcpy(grown, storage, *capacity * item_size);
+        }
+    }
+    else
+    {
+        grown = realloc(*items, new_capacity * item_size);
+    }
+    if (!grown)
+    {
+        return 0;
+    }
+    *items = grown;
+    *capacity = new_capacity;
+    return 1;
 }
 
-static ASTNode *parse_expression_impl(Parser *parser)
+// Release the stacks and whatever a failed parse left on them
+static void parse_stack_cleanup(Parser *parser, ParseStack *stack)
 {
-    return parse_comparison_impl(parser);
+    parser->recursion_depth = stack->max_nesting;
+    for (size_t i = 0; i < stack->operand_count; i++)
+    {
+        ast_free(stack->operands[i]);
+    }
+    for (size_t i = 0; i < stack->frame_count; i++)
+    {
+        if (stack->frames[i].kind == FRAME_CALL)
+        {
+            ast_free_args(parser->arena, stack->frames[i].args, stack->frames[i].arg_count);
+        }
+    }
+    if (stack->frames != stack->frame_storage)
+    {
+        free(stack->frames);
+    }
+    if (stack->operands != stack->operand_storage)
+    {
+        free(stack->operands);
+    }
+    stack->operand_count = 0;
+    stack->frame_count = 0;
 }
 
-ASTNode *parser_parse_comparison(Parser *parser)
+static int parse_push_operand(Parser *parser, ParseStack *stack, ASTNode *node)
 {
-    CHECK_RECURSION_DEPTH(parser, "parse_comparison");
-    ASTNode *result = parse_comparison_impl(parser);
-    RETURN_WITH_DEPTH_DECREMENT(parser, result);
+    if (!node)
+    {
+        return 0;
+    }
+    if (stack->operand_count == stack->operand_capacity &&
+        !parse_stack_grow((void **)&stack->operands, &stack->operand_capacity,
+                          stack->operand_storage, sizeof(ASTNode *)))
+    {
+        parser_error(parser, "Out of memory while parsing");
+        ast_free(node);
+        return 0;
+    }
+    stack->operands[stack->operand_count++] = node;
+    return 1;
 }
 
-static ASTNode *parse_comparison_impl(Parser *parser)
+// Push a frame; returns it for the caller to fill in, or NULL on error
+static ParseFrame *parse_push_frame(Parser *parser, ParseStack *stack, ParseFrameKind kind,
+                                    TokenType op)
 {
-    ASTNode *left = parse_term_impl(parser);
-    if (!left || parser->error_occurred)
-        return left;
+    // Parentheses alone add no depth to the tree
+    int nests = kind != FRAME_GROUP;
+    if (nests && parser->max_depth > 0 && stack->nesting >= parser->max_depth)
+    {
+        parser_error(parser, "Maximum nesting depth of %d exceeded", parser->max_depth);
+        return NULL;
+    }
+    if (stack->frame_count == stack->frame_capacity &&
+        !parse_stack_grow((void **)&stack->frames, &stack->frame_capacity, stack->frame_storage,
+                          sizeof(ParseFrame)))
+    {
+        parser_error(parser, "Out of memory while parsing");
+        return NULL;
+    }
 
-    while (token_is_comparison_op(parser->current_token.type))
+    ParseFrame *frame = &stack->frames[stack->frame_count++];
+    frame->kind = kind;
+    frame->op = op;
+    if (kind == FRAME_GROUP || kind == FRAME_CALL)
     {
-        TokenType op = parser->current_token.type;
-        parser_advance(parser);
-        ASTNode *right = parse_term_impl(parser);
-        if (!right || parser->error_occurred)
+        frame->args = NULL;
+        frame->arg_count = 0;
+        frame->saved_implicit = stack->implicit_count;
+        stack->implicit_count = 0;
+        stack->open_count++;
+    }
+    stack->nesting += nests;
+    if (stack->nesting > stack->max_nesting)
+    {
+        stack->max_nesting = stack->nesting;
+    }
+    return frame;
+}
+
+// Pop the top frame; the result stays valid until the next push
+static ParseFrame *parse_pop_frame(ParseStack *stack)
+{
+    ParseFrame *frame = &stack->frames[--stack->frame_count];
+    stack->nesting -= frame->kind != FRAME_GROUP;
+    if (frame->kind == FRAME_GROUP || frame->kind == FRAME_CALL)
+    {
+        stack->implicit_count = frame->saved_implicit;
+        stack->open_count--;
+    }
+    return frame;
+}
+
+static ParseFrame *parse_top_frame(ParseStack *stack)
+{
+    return stack->frame_count ? &stack->frames[stack->frame_count - 1] : NULL;
+}
+
+// Apply the prefix operators waiting on the operand just completed; nothing
+// binds tighter, so they can be applied right away
+static int parse_apply_unary(Parser *parser, ParseStack *stack)
+{
+    ParseFrame *top;
+    while ((top = parse_top_frame(stack)) != NULL && top->kind == FRAME_UNARY)
+    {
+        TokenType op = parse_pop_frame(stack)->op;
+        ASTNode *operand = stack->operands[--stack->operand_count];
+        ASTNode *node = ast_create_unary_in(parser->arena, op, operand);
+        if (!parse_push_operand(parser, stack, node))
         {
-            ast_free(left);
-            ast_free(right);
-            return NULL;
+            return 0;
         }
-        left = ast_create_binop(op, left, right);
-        if (!left)
-            return NULL;
     }
-
-    return left;
+    return 1;
 }
 
-ASTNode *parser_parse_term(Parser *parser)
+// Combine binary operators on top of the stack that bind at least as tightly
+// as an operator of the given precedence (more tightly, for a right-associative
+// one); pass 0 to combine all of them
+static int parse_reduce(Parser *parser, ParseStack *stack, int precedence, int right_associative)
 {
-    CHECK_RECURSION_DEPTH(parser, "parse_term");
-    ASTNode *result = parse_term_impl(parser);
-    RETURN_WITH_DEPTH_DECREMENT(parser, result);
+    ParseFrame *top;
+    while ((top = parse_top_frame(stack)) != NULL && top->kind == FRAME_BINARY)
+    {
+        int top_precedence = token_get_precedence(top->op);
+        if (top_precedence < precedence || (top_precedence == precedence && right_associative))
+        {
+            break;
+        }
+        TokenType op = parse_pop_frame(stack)->op;
+        ASTNode *right = stack->operands[--stack->operand_count];
+        ASTNode *left = stack->operands[--stack->operand_count];
+        ASTNode *node = ast_create_operation_in(parser->arena, op, left, right);
+        if (!parse_push_operand(parser, stack, node))
+        {
+            return 0;
+        }
+    }
+    return 1;
 }
 
-static ASTNode *parse_term_impl(Parser *parser)
+// Open a call after its function token has been consumed
+static int parse_open_call(Parser *parser, ParseStack *stack, TokenType func_type)
 {
-    ASTNode *left = parse_factor_impl(parser);
-    if (!left || parser->error_occurred)
-        return left;
+    if (parser->current_token.type != TOKEN_LPAREN)
+    {
+        parser_error(parser, "Expected '(' after function %s", function_table_get_name(func_type));
+        return 0;
+    }
+    parser_advance(parser); // consume '('
 
-    while (parser->current_token.type == TOKEN_PLUS ||
-           parser->current_token.type == TOKEN_MINUS)
+    int expected_args = function_table_get_arg_count(func_type);
+    if (expected_args <= 0)
     {
-        TokenType op = parser->current_token.type;
-        parser_advance(parser);
-        ASTNode *right = parse_factor_impl(parser);
-        if (!right || parser->error_occurred)
+        // Nothing to collect: the call must close right away
+        if (parser->current_token.type != TOKEN_RPAREN)
         {
-            ast_free(left);
-            ast_free(right);
-            return NULL;
+            parser_error(parser, "Expected ')' after function arguments");
+            return 0;
         }
-        left = ast_create_binop(op, left, right);
-        if (!left)
-            return NULL;
+        parser_advance(parser); // consume ')'
+        return parse_push_operand(parser, stack,
+                                  ast_create_function_in(parser->arena, func_type, NULL, 0));
     }
 
-    return left;
+    ASTNode **args = ast_create_args(parser->arena, expected_args);
+    if (!args)
+    {
+        parser->error_occurred = 1;
+        return 0;
+    }
+    ParseFrame *frame = parse_push_frame(parser, stack, FRAME_CALL, func_type);
+    if (!frame)
+    {
+        ast_free_args(parser->arena, args, 0);
+        return 0;
+    }
+    frame->args = args;
+    frame->expected_args = expected_args;
+    return 1;
 }
 
-ASTNode *parser_parse_factor(Parser *parser)
+// Handle a token that can end an operand sequence: ',' or ')' in an open
+// call or group, or a token nothing can follow. Returns 1 to go on, 0 when
+// the expression is complete (done set) or on error.
+static int parse_close(Parser *parser, ParseStack *stack, int *done)
 {
-    CHECK_RECURSION_DEPTH(parser, "parse_factor");
-    ASTNode *result = parse_factor_impl(parser);
-    RETURN_WITH_DEPTH_DECREMENT(parser, result);
+    if (!parse_reduce(parser, stack, 0, 0))
+    {
+        return 0;
+    }
+
+    ParseFrame *top = parse_top_frame(stack);
+    if (!top)
+    {
+        *done = 1;
+        return 0;
+    }
+
+    TokenType type = parser->current_token.type;
+    if (top->kind == FRAME_GROUP)
+    {
+        if (type != TOKEN_RPAREN)
+        {
+            parser_error(parser, "Expected ')'");
+            return 0;
+        }
+        parse_pop_frame(stack);
+        parser_advance(parser);
+        return parse_apply_unary(parser, stack);
+    }
+
+    // The operand below the call frame is the argument just parsed
+    int expected_args = top->expected_args;
+    top->args[top->arg_count++] = stack->operands[--stack->operand_count];
+    if (type == TOKEN_COMMA && top->arg_count < expected_args)
+    {
+        parser_advance(parser); // consume ','
+        stack->implicit_count = 0;
+        return 2;
+    }
+    if (top->arg_count != expected_args)
+    {
+        parser_error(parser, "Function %s expects %d arguments, got %d",
+                     function_table_get_name(top->op), expected_args, top->arg_count);
+        return 0;
+    }
+    if (type != TOKEN_RPAREN)
+    {
+        parser_error(parser, "Expected ')' after function arguments");
+        return 0;
+    }
+    if (token_binds_variable(top->op) && top->args[1]->type != NODE_VARIABLE)
+    {
+        parser_error(parser, "Function %s expects a variable as its second argument",
+                     function_table_get_name(top->op));
+        return 0;
+    }
+    parser_advance(parser); // consume ')'
+
+    ParseFrame *frame = parse_pop_frame(stack);
+    ASTNode *node = ast_create_function_in(parser->arena, frame->op, frame->args, frame->arg_count);
+    if (!parse_push_operand(parser, stack, node))
+    {
+        return 0;
+    }
+    return parse_apply_unary(parser, stack);
 }
 
-static ASTNode *parse_factor_impl(Parser *parser)
+// Parse operands joined by operators binding at least min_precedence, the
+// grammar's levels being comparison (1), sum (2), product (3, including
+// implicit multiplication), right-associative power (4) and prefix sign (5).
+// Without allow_unary a leading sign is an error; with call set, parsing
+// starts inside that function's argument list.
+static ASTNode *parse_operators(Parser *parser, int min_precedence, int allow_unary,
+                                TokenType call)
 {
-    ASTNode *left = parse_power_impl(parser);
-    if (!left || parser->error_occurred)
-        return left;
+    if (!parser)
+    {
+        return NULL;
+    }
 
-    // Handle explicit and implicit multiplication
-    int implicit_mult_count = 0;
-    const int max_implicit_mult = 1000;
+    ParseStack stack;
+    parse_stack_init(&stack);
+    int expect_operand = 1;
+    int done = 0;
 
-    while ((parser->current_token.type == TOKEN_STAR ||
-            parser->current_token.type == TOKEN_SLASH ||
-            should_insert_multiplication(parser)) &&
-           implicit_mult_count < max_implicit_mult)
+    if (call != TOKEN_INVALID)
     {
+        if (!parse_open_call(parser, &stack, call))
+        {
+            goto fail;
+        }
+        // A call without arguments is complete already
+        expect_operand = stack.open_count > 0;
+    }
 
-        TokenType op = parser->current_token.type;
+    while (!done)
+    {
+        if (parser->error_occurred)
+        {
+            goto fail;
+        }
 
-        // Handle implicit multiplication
-        if (should_insert_multiplication(parser))
+        TokenType type = parser->current_token.type;
+        if (expect_operand)
+        {
+            if (token_is_unary_op(type) && (allow_unary || stack.frame_count > 0))
+            {
+                parser_advance(parser);
+                if (!parse_push_frame(parser, &stack, FRAME_UNARY, type))
+                {
+                    goto fail;
+                }
+                continue;
+            }
+            if (type == TOKEN_LPAREN)
+            {
+                parser_advance(parser);
+                if (!parse_push_frame(parser, &stack, FRAME_GROUP, TOKEN_LPAREN))
+                {
+                    goto fail;
+                }
+                continue;
+            }
+            if (token_is_function(type))
+            {
+                size_t open = stack.frame_count;
+                parser_advance(parser);
+                if (!parse_open_call(parser, &stack, type))
+                {
+                    goto fail;
+                }
+                // Calls without arguments yield their node at once
+                if (stack.frame_count == open && !parse_apply_unary(parser, &stack))
+                {
+                    goto fail;
+                }
+                expect_operand = stack.frame_count > open;
+                continue;
+            }
+            if (!parse_push_operand(parser, &stack, parse_atom(parser)) ||
+                !parse_apply_unary(parser, &stack))
+            {
+                goto fail;
+            }
+            expect_operand = 0;
+            continue;
+        }
+
+        // An operand is complete: look for an operator to continue with
+        // (only binary and comparison operators have a precedence)
+        TokenType op = type;
+        int precedence = token_get_precedence(type);
+        int implicit = 0;
+        if (precedence == 0 && should_insert_multiplication(parser))
         {
             op = TOKEN_STAR;
-            implicit_mult_count++;
-            // Don't advance - we're inserting a virtual token
+            precedence = token_get_precedence(TOKEN_STAR);
+            implicit = 1;
         }
-        else
+
+        int lowest = stack.open_count ? 1 : min_precedence;
+        if (precedence > 0 && precedence >= lowest)
         {
-            parser_advance(parser);
+            if (!parse_reduce(parser, &stack, precedence, token_is_right_associative(op)))
+            {
+                goto fail;
+            }
+            if (implicit)
+            {
+                // Leave the current token: the '*' is virtual
+                if (++stack.implicit_count >= MAX_IMPLICIT_MULTIPLICATIONS)
+                {
+                    parser_error(parser, "Too many implicit multiplications detected");
+                    goto fail;
+                }
+            }
+            else
+            {
+                if (precedence < token_get_precedence(TOKEN_STAR))
+                {
+                    stack.implicit_count = 0;
+                }
+                parser_advance(parser);
+            }
+            if (!parse_push_frame(parser, &stack, FRAME_BINARY, op))
+            {
+                goto fail;
+            }
+            expect_operand = 1;
+            continue;
         }
 
-        ASTNode *right = parse_power_impl(parser);
-        if (!right || parser->error_occurred)
+        int closed = parse_close(parser, &stack, &done);
+        if (!closed && !done)
         {
-            ast_free(left);
-            ast_free(right);
-            return NULL;
+            goto fail;
         }
-        left = ast_create_binop(op, left, right);
-        if (!left)
-            return NULL;
+        expect_operand = closed == 2;
     }
 
-    if (implicit_mult_count >= max_implicit_mult)
+    ASTNode *result = stack.operands[0];
+    stack.operand_count = 0;
+    parse_stack_cleanup(parser, &stack);
+    return result;
+
+fail:
+    parse_stack_cleanup(parser, &stack);
+    return NULL;
+}
+
+ASTNode *parser_parse_expression(Parser *parser)
+{
+    ASTNode *ast = parse_operators(parser, 1, 1, TOKEN_INVALID);
+    if (ast && parser->share && !parser->error_occurred)
     {
-        fprintf(stderr, "Too many implicit multiplications detected\n");
-        parser->error_occurred = 1;
-        ast_free(left);
-        return NULL;
+        optimizer_share_subexpressions(ast);
     }
-
-    return left;
+    return ast;
 }
 
-ASTNode *parser_parse_power(Parser *parser)
+ASTNode *parser_parse_comparison(Parser *parser)
 {
-    CHECK_RECURSION_DEPTH(parser, "parse_power");
-    ASTNode *result = parse_power_impl(parser);
-    RETURN_WITH_DEPTH_DECREMENT(parser, result);
+    return parse_operators(parser, 1, 1, TOKEN_INVALID);
 }
 
-static ASTNode *parse_power_impl(Parser *parser)
+ASTNode *parser_parse_term(Parser *parser)
 {
-    ASTNode *left = parse_unary_impl(parser);
-    if (!left || parser->error_occurred)
-        return left;
+    return parse_operators(parser, 2, 1, TOKEN_INVALID);
+}
 
-    // Right-associative
-    if (parser->current_token.type == TOKEN_CARET)
-    {
-        parser_advance(parser);
-        ASTNode *right = parse_power_impl(parser); // Recursive for right-associativity
-        if (!right || parser->error_occurred)
-        {
-            ast_free(left);
-            ast_free(right);
-            return NULL;
-        }
-        left = ast_create_binop(TOKEN_CARET, left, right);
-    }
+ASTNode *parser_parse_factor(Parser *parser)
+{
+    return parse_operators(parser, 3, 1, TOKEN_INVALID);
+}
 
-    return left;
+ASTNode *parser_parse_power(Parser *parser)
+{
+    return parse_operators(parser, 4, 1, TOKEN_INVALID);
 }
 
 ASTNode *parser_parse_unary(Parser *parser)
 {
-    CHECK_RECURSION_DEPTH(parser, "parse_unary");
-    ASTNode *result = parse_unary_impl(parser);
-    RETURN_WITH_DEPTH_DECREMENT(parser, result);
+    return parse_operators(parser, UNARY_PRECEDENCE, 1, TOKEN_INVALID);
 }
 
-static ASTNode *parse_unary_impl(Parser *parser)
+ASTNode *parser_parse_primary(Parser *parser)
 {
-    if (token_is_unary_op(parser->current_token.type))
-    {
-        TokenType op = parser->current_token.type;
-        parser_advance(parser);
-        ASTNode *operand = parse_unary_impl(parser); // Allow chaining: --5
-        if (!operand || parser->error_occurred)
-        {
-            return NULL;
-        }
-        return ast_create_unary(op, operand);
-    }
-
-    return parse_primary_impl(parser);
+    return parse_operators(parser, UNARY_PRECEDENCE, 0, TOKEN_INVALID);
 }
 
-ASTNode *parser_parse_primary(Parser *parser)
+ASTNode *parser_parse_function_call(Parser *parser, TokenType func_type)
 {
-    CHECK_RECURSION_DEPTH(parser, "parse_primary");
-    ASTNode *result = parse_primary_impl(parser);
-    RETURN_WITH_DEPTH_DECREMENT(parser, result);
+    return parse_operators(parser, UNARY_PRECEDENCE, 0, func_type);
 }
 
-static ASTNode *parse_primary_impl(Parser *parser)
+// Parse an operand that is a single token: a number, a constant or a variable
+static ASTNode *parse_atom(Parser *parser)
 {
     Token token = parser->current_token;
 
@@ -315,175 +691,103 @@ static ASTNode *parse_primary_impl(Parser *parser)
     case TOKEN_FLOAT:
     {
         parser_advance(parser);
-        // Use the stored number string for MPFR parsing
-        if (token.number_string)
-        {
-            return ast_create_number(token.number_string, token.type == TOKEN_INT);
-        }
-        else
-        {
-            // Fallback for backwards compatibility
-            char temp_str[64];
-            if (token.type == TOKEN_INT)
-            {
-                snprintf(temp_str, sizeof(temp_str), "%d", token.int_value);
-            }
-            else
-            {
-                snprintf(temp_str, sizeof(temp_str), "%.17g", token.float_value);
-            }
-            return ast_create_number(temp_str, token.type == TOKEN_INT);
-        }
-    }
-
-    case TOKEN_LPAREN:
-    {
-        parser_advance(parser);
-        ASTNode *expr = parse_expression_impl(parser);
-        if (!expr || parser->error_occurred)
-        {
-            return NULL;
-        }
-        if (parser->current_token.type != TOKEN_RPAREN)
+        mpfr_prec_t precision = parser->precision ? parser->precision : global_precision;
+        // Parse the token's text for MPFR
+        char text[PARSER_MAX_TOKEN_TEXT];
+        parser_token_text(parser, &token, text, sizeof(text));
+        ASTNode *node =
+            ast_create_number_at(parser->arena, text, token.type == TOKEN_INT, precision);
+        // Only exact integers read the same at every precision
+        if (node && !node->exact)
         {
-            fprintf(stderr, "Expected ')'\n");
-            parser->error_occurred = 1;
-            ast_free(expr);
-            return NULL;
+            parser->inexact_literals++;
         }
-        parser_advance(parser);
-        return expr;
+        return node;
     }
 
     case TOKEN_CONSTANT:
     {
-        // Store the constant name before advancing
-        char *const_name = strdup(token.string_value);
+        char name[PARSER_MAX_TOKEN_TEXT];
+        parser_token_text(parser, &token, name, sizeof(name));
         parser_advance(parser);
-        ASTNode *node = ast_create_constant(const_name);
-        free(const_name);
-        return node;
+        return ast_create_constant_in(parser->arena, name);
     }
 
     case TOKEN_INVALID:
-        fprintf(stderr, "Invalid token encountered\n");
-        parser->error_occurred = 1;
+        parser_error(parser, "Invalid token encountered");
         return NULL;
 
     case TOKEN_IDENTIFIER:
-        fprintf(stderr, "Unknown function or variable: %s\n", token.string_value);
-        parser->error_occurred = 1;
-        return NULL;
-
-    default:
-        // Check if it's a function
-        if (token_is_function(token.type))
+    {
+        char name[PARSER_MAX_TOKEN_TEXT];
+        parser_token_text(parser, &token, name, sizeof(name));
+        parser_advance(parser);
+        if (parser->current_token.type == TOKEN_LPAREN)
         {
-            parser_advance(parser);
-            return parser_parse_function_call(parser, token.type);
+            // Variables are never called
+            parser_error(parser, "Unknown function: %s", name);
+            return NULL;
         }
+        return ast_create_variable_in(parser->arena, name);
+    }
 
-        fprintf(stderr, "Unexpected token: %s\n", token_type_str(token.type));
-        parser->error_occurred = 1;
+    default:
+        parser_error(parser, "Unexpected token: %s", token_type_str(token.type));
         return NULL;
     }
 }
 
-ASTNode *parser_parse_function_call(Parser *parser, TokenType func_type)
-{
-    int expected_args = function_table_get_arg_count(func_type);
+// Additional parser utility functions from parser.h
 
-    // Expect opening parenthesis
-    if (parser->current_token.type != TOKEN_LPAREN)
+void parser_set_quiet(Parser *parser, int quiet)
+{
+    if (parser)
     {
-        fprintf(stderr, "Expected '(' after function %s\n", function_table_get_name(func_type));
-        parser->error_occurred = 1;
-        return NULL;
+        parser->quiet = quiet;
     }
-    parser_advance(parser); // consume '('
-
-    // Parse arguments
-    ASTNode **args = NULL;
-    int arg_count = 0;
+}
 
-    if (expected_args > 0)
+void parser_set_precision(Parser *parser, mpfr_prec_t precision)
+{
+    if (parser)
     {
-        args = malloc(expected_args * sizeof(ASTNode *));
-        if (!args)
-        {
-            fprintf(stderr, "Memory allocation failed\n");
-            parser->error_occurred = 1;
-            return NULL;
-        }
-
-        // Initialize to NULL for safe cleanup
-        for (int i = 0; i < expected_args; i++)
-        {
-            args[i] = NULL;
-        }
-
-        // Parse first argument
-        args[0] = parse_expression_impl(parser);
-        if (!args[0] || parser->error_occurred)
-        {
-            free(args);
-            return NULL;
-        }
-        arg_count = 1;
-
-        // Parse remaining arguments
-        while (arg_count < expected_args && parser->current_token.type == TOKEN_COMMA)
-        {
-            parser_advance(parser); // consume ','
-            args[arg_count] = parse_expression_impl(parser);
-            if (!args[arg_count] || parser->error_occurred)
-            {
-                for (int i = 0; i < arg_count; i++)
-                {
-                    ast_free(args[i]);
-                }
-                free(args);
-                return NULL;
-            }
-            arg_count++;
-        }
+        parser->precision = precision;
+    }
+}
 
-        // Check if we have the right number of arguments
-        if (arg_count != expected_args)
-        {
-            fprintf(stderr, "Function %s expects %d arguments, got %d\n",
-                    function_table_get_name(func_type), expected_args, arg_count);
-            parser->error_occurred = 1;
-            for (int i = 0; i < arg_count; i++)
-            {
-                ast_free(args[i]);
-            }
-            free(args);
-            return NULL;
-        }
+void parser_set_sharing(Parser *parser, int share)
+{
+    if (parser)
+    {
+        parser->share = share;
     }
+}
 
-    // Expect closing parenthesis
-    if (parser->current_token.type != TOKEN_RPAREN)
+void parser_set_tokens(Parser *parser, const Token *tokens, size_t count)
+{
+    if (!parser)
     {
-        fprintf(stderr, "Expected ')' after function arguments\n");
-        parser->error_occurred = 1;
-        if (args)
-        {
-            for (int i = 0; i < arg_count; i++)
-            {
-                ast_free(args[i]);
-            }
-            free(args);
-        }
-        return NULL;
+        return;
     }
-    parser_advance(parser); // consume ')'
 
-    return ast_create_function(func_type, args, arg_count);
+    parser->tokens = tokens;
+    parser->token_count = count;
+    parser->token_next = 0;
+    parser->previous_token = (Token){.type = TOKEN_INVALID};
+    if (tokens)
+    {
+        parser->current_token = parser_token_at(parser, 0);
+        parser->token_next = count > 0 ? 1 : 0;
+    }
 }
 
-// Additional parser utility functions from parser.h
+void parser_set_arena(Parser *parser, ASTArena *arena)
+{
+    if (parser)
+    {
+        parser->arena = arena;
+    }
+}
 
 int parser_has_error(Parser *parser)
 {
@@ -508,6 +812,7 @@ void parser_clear_error(Parser *parser)
     if (parser)
     {
         parser->error_occurred = 0;
+        parser->error_message[0] = '\0';
     }
 }
 
@@ -515,7 +820,7 @@ const char *parser_get_error_message(Parser *parser)
 {
     if (parser && parser->error_occurred)
     {
-        return "Parse error occurred";
+        return parser->error_message[0] ? parser->error_message : "Parse error occurred";
     }
     return NULL;
 }
@@ -545,6 +850,32 @@ int parser_match_token(Parser *parser, TokenType expected)
     return parser ? (parser->current_token.type == expected) : 0;
 }
 
+int parser_at_assignment(Parser *parser)
+{
+    if (!parser)
+    {
+        return 0;
+    }
+
+    TokenType type = parser->current_token.type;
+    if (type != TOKEN_IDENTIFIER && !token_is_constant(type) && !token_is_function(type))
+    {
+        return 0;
+    }
+
+    if (parser->tokens)
+    {
+        return parser_token_at(parser, parser->token_next).type == TOKEN_ASSIGN;
+    }
+
+    // The lexer holds no state beyond its position, so a copy peeks ahead
+    Lexer lookahead = *parser->lexer;
+    Token next = lexer_get_next_token(&lookahead);
+    int assignment = next.type == TOKEN_ASSIGN;
+    token_free(&next);
+    return assignment;
+}
+
 int parser_consume_token(Parser *parser, TokenType expected)
 {
     if (parser && parser->current_token.type == expected)
@@ -576,11 +907,11 @@ void parser_panic(Parser *parser, const char *error_msg)
 {
     if (parser)
     {
-        parser->error_occurred = 1;
         if (error_msg)
         {
-            fprintf(stderr, "Parser panic: %s\n", error_msg);
+            parser_error(parser, "Parser panic: %s", error_msg);
         }
+        parser->error_occurred = 1;
         parser_synchronize(parser);
     }
 }
@@ -8,11 +8,20 @@
 typedef struct Parser
 {
     Lexer *lexer;
+    ASTArena *arena; // Node allocator, or NULL to allocate nodes on the heap
     Token current_token;
     Token previous_token;
-    int recursion_depth;
-    int max_depth;
+    int recursion_depth; // Deepest nesting reached by the last parse
+    int max_depth;       // Nesting allowed, or 0 for no limit
     int error_occurred;
+    char error_message[256]; // First error reported during the parse
+    int quiet;               // If set, errors are recorded but not printed
+    mpfr_prec_t precision;   // Precision of literals, or 0 for the global precision
+    int share;               // Merge repeated subexpressions of parsed expressions
+    int inexact_literals;    // Literals read so far that are not exact integers
+    const Token *tokens;     // Tokens lexed beforehand, NULL to read from the lexer
+    size_t token_count;
+    size_t token_next; // Index of the token after the current one
 } Parser;
 
 /**
@@ -85,6 +94,50 @@ ASTNode *parser_parse_primary(Parser *parser);
  */
 ASTNode *parser_parse_function_call(Parser *parser, TokenType func_type);
 
+/**
+ * Allocate parsed nodes from an arena instead of the heap
+ * The caller owns the arena and resets it once the tree is no longer needed.
+ * @param parser Parser instance
+ * @param arena Arena to allocate from, or NULL for the heap
+ */
+void parser_set_arena(Parser *parser, ASTArena *arena);
+
+/**
+ * Stop printing parse errors to stderr
+ * Errors are still available through parser_get_error_message().
+ * @param parser Parser instance
+ * @param quiet 1 to suppress error output, 0 to print errors
+ */
+void parser_set_quiet(Parser *parser, int quiet);
+
+/**
+ * Parse literals at a fixed precision instead of the global one
+ * Use the precision of the EvalContext the tree will be evaluated in.
+ * @param parser Parser instance
+ * @param precision Literal precision in bits, or 0 for the global precision
+ */
+void parser_set_precision(Parser *parser, mpfr_prec_t precision);
+
+/**
+ * Merge repeated subexpressions of each parsed expression (on by default)
+ * parser_parse_expression() then returns a DAG in which each distinct
+ * subexpression worth it is evaluated once; see
+ * optimizer_share_subexpressions().
+ * @param parser Parser instance
+ * @param share 1 to share subexpressions, 0 to return plain trees
+ */
+void parser_set_sharing(Parser *parser, int share);
+
+/**
+ * Read tokens lexed beforehand instead of lexing as the parse goes
+ * The lexer still supplies the tokens' text, so it must be over the input
+ * they were lexed from. The parse starts again at the first token.
+ * @param parser Parser instance
+ * @param tokens Tokens ending with TOKEN_EOF (kept by reference)
+ * @param count Number of tokens
+ */
+void parser_set_tokens(Parser *parser, const Token *tokens, size_t count);
+
 /**
  * Check if parser has encountered an error
  * @param parser Parser instance
@@ -93,16 +146,21 @@ ASTNode *parser_parse_function_call(Parser *parser, TokenType func_type);
 int parser_has_error(Parser *parser);
 
 /**
- * Get current recursion depth
+ * Get the deepest nesting reached by the last parse
+ * Parsing uses an explicit stack, not recursion; nesting counts the
+ * operators and calls still open at once, which bounds how deeply the
+ * right-hand side of the tree nests. Parentheses alone do not count.
  * @param parser Parser instance
- * @return Current recursion depth
+ * @return Deepest nesting of the last parse
  */
 int parser_get_recursion_depth(Parser *parser);
 
 /**
- * Set maximum recursion depth
+ * Set the maximum nesting depth
+ * The default keeps trees shallow enough for the recursive evaluator;
+ * deeper input is rejected with a parse error.
  * @param parser Parser instance
- * @param max_depth Maximum allowed recursion depth
+ * @param max_depth Maximum allowed nesting, or 0 for no limit
  */
 void parser_set_max_recursion_depth(Parser *parser, int max_depth);
 
@@ -155,6 +213,15 @@ const Token *parser_peek_token(Parser *parser);
  */
 int parser_match_token(Parser *parser, TokenType expected);
 
+/**
+ * Check whether the input at the current token is an assignment
+ * Looks one token past the current one without consuming anything.
+ * @param parser Parser instance
+ * @return 1 if a name (a variable, or a built-in function or constant name)
+ *         is followed by '=', 0 otherwise
+ */
+int parser_at_assignment(Parser *parser);
+
 /**
  * Consume current token if it matches expected type
  * @param parser Parser instance
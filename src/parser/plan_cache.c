@@ -0,0 +1,361 @@
+#include "plan_cache.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bytes of normalized line kept on the stack during a lookup
+#define PLAN_CACHE_INLINE_KEY 256
+
+typedef struct PlanEntry PlanEntry;
+
+struct PlanEntry
+{
+    uint64_t hash;
+    char *key; // Normalized line
+    size_t key_length;
+    ASTArena *arena;
+    ASTNode *tree;
+    mpfr_prec_t precision; // Precision and rounding of the literals, unless
+    mpfr_rnd_t rounding;   // exact_literals makes them irrelevant
+    int exact_literals;
+    size_t bytes;           // Memory charged to this entry
+    PlanEntry *bucket_next; // Next entry in the same hash bucket
+    PlanEntry *newer;       // LRU neighbours; the list runs oldest to newest
+    PlanEntry *older;
+};
+
+static PlanEntry **buckets = NULL;
+static size_t bucket_count = 0;
+static size_t entry_count = 0;
+static PlanEntry *oldest = NULL;
+static PlanEntry *newest = NULL;
+static size_t used_bytes = 0;
+static size_t capacity = PLAN_CACHE_DEFAULT_CAPACITY;
+static unsigned long hits = 0;
+static unsigned long misses = 0;
+static unsigned long evictions = 0;
+
+// Copy a line with its whitespace normalized; out holds strlen(input) + 1
+// bytes. Returns the normalized length.
+static size_t plan_normalize(const char *input, char *out)
+{
+    size_t length = 0;
+    int space = 0;
+    for (const char *c = input; *c; c++)
+    {
+        if (isspace((unsigned char)*c))
+        {
+            space = length > 0;
+            continue;
+        }
+        if (space)
+        {
+            out[length++] = ' ';
+            space = 0;
+        }
+        out[length++] = *c;
+    }
+    out[length] = '\0';
+    return length;
+}
+
+// 64-bit FNV-1a
+static uint64_t plan_hash(const char *bytes, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void lru_unlink(PlanEntry *entry)
+{
+    if (entry->older)
+        entry->older->newer = entry->newer;
+    else
+        oldest = entry->newer;
+    if (entry->newer)
+        entry->newer->older = entry->older;
+    else
+        newest = entry->older;
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+static void lru_push_newest(PlanEntry *entry)
+{
+    entry->older = newest;
+    entry->newer = NULL;
+    if (newest)
+        newest->newer = entry;
+    else
+        oldest = entry;
+    newest = entry;
+}
+
+static void entry_free(PlanEntry *entry)
+{
+    ast_arena_destroy(entry->arena);
+    free(entry->key);
+    free(entry);
+}
+
+static void entry_remove(PlanEntry *entry)
+{
+    PlanEntry **link = &buckets[entry->hash & (bucket_count - 1)];
+    while (*link != entry)
+    {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+
+    lru_unlink(entry);
+    used_bytes -= entry->bytes;
+    entry_count--;
+    entry_free(entry);
+}
+
+static void evict_to(size_t limit)
+{
+    while (oldest && used_bytes > limit)
+    {
+        entry_remove(oldest);
+        evictions++;
+    }
+}
+
+static PlanEntry *find_entry(const char *key, size_t length, uint64_t hash)
+{
+    if (!buckets)
+    {
+        return NULL;
+    }
+
+    for (PlanEntry *entry = buckets[hash & (bucket_count - 1)]; entry; entry = entry->bucket_next)
+    {
+        if (entry->hash == hash && entry->key_length == length &&
+            memcmp(entry->key, key, length) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Keep at most one entry per bucket on average
+static int grow_buckets(void)
+{
+    if (buckets && entry_count < bucket_count)
+    {
+        return 1;
+    }
+
+    size_t new_count = bucket_count ? bucket_count * 2 : 256;
+    PlanEntry **new_buckets = calloc(new_count, sizeof(PlanEntry *));
+    if (!new_buckets)
+    {
+        return buckets != NULL;
+    }
+
+    for (size_t i = 0; i < bucket_count; i++)
+    {
+        PlanEntry *entry = buckets[i];
+        while (entry)
+        {
+            PlanEntry *next = entry->bucket_next;
+            PlanEntry **head = &new_buckets[entry->hash & (new_count - 1)];
+            entry->bucket_next = *head;
+            *head = entry;
+            entry = next;
+        }
+    }
+
+    free(buckets);
+    buckets = new_buckets;
+    bucket_count = new_count;
+    return 1;
+}
+
+void plan_cache_set_capacity(size_t bytes)
+{
+    capacity = bytes;
+    if (capacity == 0)
+    {
+        plan_cache_clear();
+        free(buckets);
+        buckets = NULL;
+        bucket_count = 0;
+    }
+    else
+    {
+        evict_to(capacity);
+    }
+}
+
+int plan_cache_enabled(void)
+{
+    return capacity > 0;
+}
+
+const ASTNode *plan_cache_lookup(const char *input, mpfr_prec_t precision, mpfr_rnd_t rounding)
+{
+    if (capacity == 0 || !input)
+    {
+        return NULL;
+    }
+
+    char inline_key[PLAN_CACHE_INLINE_KEY];
+    size_t input_length = strlen(input);
+    char *key = input_length < sizeof(inline_key) ? inline_key : malloc(input_length + 1);
+    if (!key)
+    {
+        return NULL;
+    }
+    size_t length = plan_normalize(input, key);
+
+    PlanEntry *entry = find_entry(key, length, plan_hash(key, length));
+    if (entry && !entry->exact_literals &&
+        (entry->precision != precision || entry->rounding != rounding))
+    {
+        // Its literals were read for other settings; the store replaces it
+        entry = NULL;
+    }
+
+    if (entry)
+    {
+        lru_unlink(entry);
+        lru_push_newest(entry);
+        hits++;
+    }
+    else
+    {
+        misses++;
+    }
+
+    if (key != inline_key)
+    {
+        free(key);
+    }
+    return entry ? entry->tree : NULL;
+}
+
+void plan_cache_store(const char *input, ASTArena *arena, ASTNode *tree, mpfr_prec_t precision,
+                      mpfr_rnd_t rounding, int exact_literals)
+{
+    size_t input_length = strlen(input);
+    char *key = malloc(input_length + 1);
+    PlanEntry *entry = malloc(sizeof(PlanEntry));
+    if (!key || !entry || capacity == 0)
+    {
+        free(key);
+        free(entry);
+        ast_arena_destroy(arena);
+        return;
+    }
+
+    size_t literals;
+    size_t length = plan_normalize(input, key);
+    entry->hash = plan_hash(key, length);
+    entry->key = key;
+    entry->key_length = length;
+    entry->arena = arena;
+    entry->tree = tree;
+    entry->precision = precision;
+    entry->rounding = rounding;
+    entry->exact_literals = exact_literals;
+    entry->bytes = sizeof(PlanEntry) + length + 1 + ast_arena_used(arena, &literals) + literals;
+
+    // A plan parsed for other settings is replaced
+    PlanEntry *stale = find_entry(key, length, entry->hash);
+    if (stale)
+    {
+        entry_remove(stale);
+    }
+
+    if (entry->bytes > capacity || !grow_buckets())
+    {
+        entry_free(entry);
+        return;
+    }
+
+    evict_to(capacity - entry->bytes);
+
+    PlanEntry **head = &buckets[entry->hash & (bucket_count - 1)];
+    entry->bucket_next = *head;
+    *head = entry;
+    lru_push_newest(entry);
+    used_bytes += entry->bytes;
+    entry_count++;
+}
+
+void plan_cache_clear(void)
+{
+    PlanEntry *entry = oldest;
+    while (entry)
+    {
+        PlanEntry *next = entry->newer;
+        entry_free(entry);
+        entry = next;
+    }
+    oldest = NULL;
+    newest = NULL;
+    entry_count = 0;
+    used_bytes = 0;
+    if (buckets)
+    {
+        memset(buckets, 0, bucket_count * sizeof(PlanEntry *));
+    }
+}
+
+void plan_cache_get_stats(PlanCacheStats *stats)
+{
+    stats->hits = hits;
+    stats->misses = misses;
+    stats->evictions = evictions;
+    stats->entries = entry_count;
+    stats->bytes = used_bytes;
+    stats->capacity = capacity;
+}
+
+void plan_cache_reset_stats(void)
+{
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
+
+void plan_cache_print_stats(void)
+{
+    PlanCacheStats stats;
+    plan_cache_get_stats(&stats);
+
+    if (stats.capacity == 0)
+    {
+        printf("Plan cache: off\n");
+    }
+    else
+    {
+        printf("Plan cache: %zu entries, %zu of %zu KiB used\n", stats.entries,
+               stats.bytes / 1024, stats.capacity / 1024);
+    }
+
+    unsigned long lookups = stats.hits + stats.misses;
+    printf("Hits: %lu  Misses: %lu  Evictions: %lu", stats.hits, stats.misses, stats.evictions);
+    if (lookups > 0)
+    {
+        printf("  (hit rate %.1f%%)", 100.0 * stats.hits / lookups);
+    }
+    printf("\n");
+}
+
+void plan_cache_cleanup(void)
+{
+    plan_cache_set_capacity(0);
+    capacity = PLAN_CACHE_DEFAULT_CAPACITY;
+    plan_cache_reset_stats();
+}
@@ -0,0 +1,108 @@
+#ifndef PLAN_CACHE_H
+#define PLAN_CACHE_H
+
+#include "ast.h"
+#include <mpfr.h>
+#include <stddef.h>
+
+// Memory cap the plan cache starts with
+#define PLAN_CACHE_DEFAULT_CAPACITY (1024 * 1024)
+
+// Arena block size of one cached plan; most lines fit in one block
+#define PLAN_CACHE_ARENA_BLOCK_SIZE 2048
+
+/**
+ * Parsed plans of input lines, keyed by their text
+ *
+ * A plan is the tree the parser built for a line, with repeated
+ * subexpressions already merged, in an arena of its own. Lines are
+ * normalized before lookup: leading and trailing whitespace is dropped and
+ * runs of whitespace count as one space, which the lexer cannot tell apart.
+ * Evaluation settings play no part, since they only matter once a tree is
+ * evaluated. Neither does the precision when every literal of the line is
+ * an exact integer; a line with a literal like 0.1, read at the precision
+ * and rounding of its parse, is parsed again when those change.
+ *
+ * The cache belongs to the thread reading input lines and is not locked.
+ */
+
+/**
+ * Cache usage counters
+ */
+typedef struct
+{
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    size_t entries;
+    size_t bytes;    // Memory charged to cached plans
+    size_t capacity; // Memory cap, 0 when the cache is off
+} PlanCacheStats;
+
+/**
+ * Set the memory cap of the plan cache
+ * Shrinking the cap evicts least recently used plans; a cap of 0 disables
+ * the cache and frees it.
+ * @param bytes Maximum memory for cached plans, 0 to disable
+ */
+void plan_cache_set_capacity(size_t bytes);
+
+/**
+ * Check whether the plan cache is enabled
+ * @return 1 if enabled, 0 otherwise
+ */
+int plan_cache_enabled(void);
+
+/**
+ * Look up the plan of a line and mark it most recently used
+ * The tree stays valid until the next store, clear or capacity change.
+ * @param input Line as typed
+ * @param precision Precision literals would be read at
+ * @param rounding Rounding literals would be read with
+ * @return Cached tree, or NULL on a miss
+ */
+const ASTNode *plan_cache_lookup(const char *input, mpfr_prec_t precision, mpfr_rnd_t rounding);
+
+/**
+ * Store the plan of a line, evicting least recently used plans to stay
+ * under the cap
+ * The cache takes the arena, and destroys it if the plan is not kept.
+ * @param input Line as typed
+ * @param arena Arena holding the tree and nothing else
+ * @param tree Tree parsed from the whole line
+ * @param precision Precision its literals were read at
+ * @param rounding Rounding its literals were read with
+ * @param exact_literals 1 if every literal was an exact integer (see
+ *                       Parser.inexact_literals), so the plan suits any
+ *                       precision
+ */
+void plan_cache_store(const char *input, ASTArena *arena, ASTNode *tree, mpfr_prec_t precision,
+                      mpfr_rnd_t rounding, int exact_literals);
+
+/**
+ * Drop every cached plan (counters are kept)
+ */
+void plan_cache_clear(void);
+
+/**
+ * Get the cache counters
+ * @param stats Output counters
+ */
+void plan_cache_get_stats(PlanCacheStats *stats);
+
+/**
+ * Reset the hit, miss and eviction counters
+ */
+void plan_cache_reset_stats(void);
+
+/**
+ * Print cache counters
+ */
+void plan_cache_print_stats(void);
+
+/**
+ * Free the cache and restore the default cap
+ */
+void plan_cache_cleanup(void);
+
+#endif // PLAN_CACHE_H
@@ -0,0 +1,914 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "batch.h"
+#include "analysis.h"
+#include "context.h"
+#include "lexer.h"
+#include "parser.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include "binary.h"
+#include "precision.h"
+#include "constants.h"
+#include "constants_table.h"
+#include "functions.h"
+#include "function_table.h"
+#include "profile.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Buffer size for batch input and output streams
+#define BATCH_BUFFER_SIZE (1 << 20)
+
+// Most lines handed to a worker at a time
+#define BATCH_CHUNK_LINES 64
+
+// Estimated evaluation time a chunk should hold, in ns. Chunks of slow
+// lines get fewer of them, so the last chunks do not leave one worker busy
+// long after the others ran out of work.
+#define BATCH_CHUNK_COST 2e6
+
+// Weight of the latest chunk in the running estimate of a line's cost
+#define BATCH_COST_SMOOTHING 0.25
+
+// Chunks in flight per worker; bounds memory while keeping workers busy
+#define BATCH_CHUNKS_PER_JOB 4
+
+// Node arena reused for every line, one per thread
+static _Thread_local ASTArena *batch_arena = NULL;
+
+// Output of a line, reused for every line, one per thread
+static _Thread_local FormatBuffer batch_line;
+
+// How results are written; set before a run and only read during it
+static BatchOutput batch_output = BATCH_OUTPUT_TEXT;
+
+// Shard of the input lines a run evaluates, and where it saves its progress
+static int batch_shard_index = 0;
+static int batch_shard_count = 1;
+static const char *batch_checkpoint_path = NULL;
+
+// Why the last run could not use its checkpoint, empty otherwise
+static char batch_error[512];
+
+// How far a run has got: input consumed and the output written for it
+typedef struct
+{
+    long long input;        // Bytes of input read
+    long long lines;        // Input lines read, in the shard or not
+    long long output;       // Output offset the results of those lines end at
+    double next_checkpoint; // Monotonic time of the next checkpoint, in seconds
+} BatchPosition;
+
+typedef enum
+{
+    CHUNK_FREE,    // Slot can be filled by the reader
+    CHUNK_READY,   // Lines read, waiting for a worker
+    CHUNK_RUNNING, // Being evaluated
+    CHUNK_DONE     // Output ready to be written in order
+} ChunkState;
+
+// A run of consecutive input lines and the output they produced
+typedef struct
+{
+    ChunkState state;
+    char *text; // Line contents, back to back
+    size_t text_length;
+    size_t text_capacity;
+    size_t starts[BATCH_CHUNK_LINES];
+    size_t lengths[BATCH_CHUNK_LINES];
+    int line_count;
+    double cost; // Estimated evaluation time of its lines in ns
+    char *output;
+    size_t output_length;
+    int failed;          // Some line produced an error
+    int io_error;        // Output could not be buffered
+    long long input_end; // Input offset and line number after its last line
+    long long lines_end;
+} BatchChunk;
+
+// Ring of chunks shared by the reader/writer thread and the workers.
+// Chunks are numbered in input order: the main thread fills chunk
+// read_seq, workers take chunk take_seq, and the main thread writes chunk
+// write_seq once it is done, which keeps the output in input order.
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    BatchChunk *chunks;
+    long chunk_count;
+    long read_seq;
+    long take_seq;
+    long write_seq;
+    int done_reading;
+    double line_cost;      // Running estimate of a line's evaluation time in ns, 0 if none yet
+    int strict_mode;       // Evaluator strict mode copied into each worker
+    int strict_domain;     // Function strict domain mode copied into each worker
+    int adaptive;          // Adaptive precision setting copied into each worker
+    int interval;          // Interval evaluation setting copied into each worker
+    int native;            // Native backend setting copied into each worker
+    int exact;             // Exact tier setting copied into each worker
+    EvalBudget budget;     // Evaluation limits copied into each worker
+    BatchPosition written; // Progress of the chunks written out
+} BatchPool;
+
+int batch_init(void)
+{
+    precision_init();
+    constants_init();
+    functions_init();
+    function_table_init();
+    return 0;
+}
+
+void batch_set_output(BatchOutput output)
+{
+    batch_output = output;
+}
+
+BatchOutput batch_get_output(void)
+{
+    return batch_output;
+}
+
+int batch_set_shard(int index, int count)
+{
+    if (count < 1 || index < 0 || index >= count)
+    {
+        return -1;
+    }
+    batch_shard_index = index;
+    batch_shard_count = count;
+    return 0;
+}
+
+void batch_set_checkpoint(const char *path)
+{
+    batch_checkpoint_path = path;
+}
+
+// Check whether an input line, counted from 0, belongs to the shard
+static int batch_in_shard(long long line)
+{
+    return line % batch_shard_count == batch_shard_index;
+}
+
+static double batch_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Save a position once the output before it is on disk; the file is
+// replaced in one rename, so a crash leaves the old checkpoint or the new
+// one. Returns 0 with batch_error set on failure.
+static int batch_checkpoint_write(FILE *output, BatchPosition *position)
+{
+    if (fflush(output) != 0 || fsync(fileno(output)) != 0)
+    {
+        return 0;
+    }
+    off_t offset = ftello(output);
+    if (offset < 0)
+    {
+        return 0;
+    }
+    position->output = (long long)offset;
+
+    size_t length = strlen(batch_checkpoint_path) + sizeof(".tmp");
+    char *temporary = malloc(length);
+    if (!temporary)
+    {
+        return 0;
+    }
+    snprintf(temporary, length, "%s.tmp", batch_checkpoint_path);
+
+    int ok = 0;
+    FILE *file = fopen(temporary, "w");
+    if (file)
+    {
+        fprintf(file, "calculator batch checkpoint 1\nshard %d/%d\n", batch_shard_index,
+                batch_shard_count);
+        fprintf(file, "input %lld\nlines %lld\noutput %lld\n", position->input, position->lines,
+                position->output);
+        ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+        ok = fclose(file) == 0 && ok;
+        ok = ok && rename(temporary, batch_checkpoint_path) == 0;
+    }
+    if (!ok)
+    {
+        snprintf(batch_error, sizeof(batch_error), "cannot write checkpoint %s: %s",
+                 batch_checkpoint_path, strerror(errno));
+        remove(temporary);
+    }
+    free(temporary);
+    position->next_checkpoint = batch_now() + BATCH_CHECKPOINT_SECONDS;
+    return ok;
+}
+
+// Save a position if a checkpoint is due, or in any case if final is set;
+// returns 0 on failure
+static int batch_checkpoint(FILE *output, BatchPosition *position, int final)
+{
+    if (!batch_checkpoint_path || (!final && batch_now() < position->next_checkpoint))
+    {
+        return 1;
+    }
+    return batch_checkpoint_write(output, position);
+}
+
+// Skip input lines already processed by reading them; returns the bytes read
+static long long batch_skip_lines(FILE *input, long long lines)
+{
+    char *line = NULL;
+    size_t capacity = 0;
+    long long bytes = 0;
+    for (long long i = 0; i < lines; i++)
+    {
+        ssize_t read = getline(&line, &capacity, input);
+        if (read == -1)
+        {
+            break;
+        }
+        bytes += read;
+    }
+    free(line);
+    return bytes;
+}
+
+// Start a run at the position its checkpoint records, or at the start of
+// the input without one. Returns 0 with batch_error set if the run cannot
+// go ahead.
+static int batch_resume(FILE *input, FILE *output, BatchPosition *position)
+{
+    memset(position, 0, sizeof(*position));
+    if (!batch_checkpoint_path)
+    {
+        return 1;
+    }
+    position->next_checkpoint = batch_now() + BATCH_CHECKPOINT_SECONDS;
+
+    // The output is cut back to the checkpoint, so it must be a file
+    if (fflush(output) != 0 || fseeko(output, 0, SEEK_END) != 0)
+    {
+        snprintf(batch_error, sizeof(batch_error), "checkpoints need the output in a regular file");
+        return 0;
+    }
+    off_t end = ftello(output);
+
+    FILE *file = fopen(batch_checkpoint_path, "r");
+    if (!file)
+    {
+        // Record the start at once: a run killed before its first timed
+        // checkpoint would otherwise leave results a rerun appends again
+        if (errno == ENOENT)
+        {
+            return batch_checkpoint_write(output, position);
+        }
+        snprintf(batch_error, sizeof(batch_error), "cannot open %s: %s", batch_checkpoint_path,
+                 strerror(errno));
+        return 0;
+    }
+
+    int index, count;
+    long long input_offset, lines, output_offset;
+    int fields = fscanf(file,
+                        "calculator batch checkpoint 1 shard %d/%d input %lld lines %lld "
+                        "output %lld",
+                        &index, &count, &input_offset, &lines, &output_offset);
+    fclose(file);
+    if (fields != 5 || input_offset < 0 || lines < 0 || output_offset < 0)
+    {
+        snprintf(batch_error, sizeof(batch_error), "invalid checkpoint file %s",
+                 batch_checkpoint_path);
+        return 0;
+    }
+    if (index != batch_shard_index || count != batch_shard_count)
+    {
+        snprintf(batch_error, sizeof(batch_error), "checkpoint %s is for shard %d/%d",
+                 batch_checkpoint_path, index, count);
+        return 0;
+    }
+    if (output_offset > (long long)end)
+    {
+        snprintf(batch_error, sizeof(batch_error),
+                 "output is shorter than checkpoint %s records (append to it with >>)",
+                 batch_checkpoint_path);
+        return 0;
+    }
+
+    // Results past the checkpoint are computed again
+    if (ftruncate(fileno(output), (off_t)output_offset) != 0 ||
+        fseeko(output, (off_t)output_offset, SEEK_SET) != 0)
+    {
+        snprintf(batch_error, sizeof(batch_error), "cannot truncate the output: %s",
+                 strerror(errno));
+        return 0;
+    }
+
+    if (fseeko(input, (off_t)input_offset, SEEK_SET) != 0 &&
+        batch_skip_lines(input, lines) != input_offset)
+    {
+        snprintf(batch_error, sizeof(batch_error), "input does not match checkpoint %s",
+                 batch_checkpoint_path);
+        return 0;
+    }
+
+    position->input = input_offset;
+    position->lines = lines;
+    position->output = output_offset;
+    return 1;
+}
+
+static void batch_write_error(FILE *output, const char *message)
+{
+    format_buffer_reset(&batch_line);
+    if (batch_output == BATCH_OUTPUT_BINARY)
+    {
+        binary_append_error(&batch_line, message);
+    }
+    else
+    {
+        format_buffer_append(&batch_line, "error: ", 7);
+        format_buffer_append(&batch_line, message, strlen(message));
+        format_buffer_append_char(&batch_line, '\n');
+    }
+    format_buffer_write(&batch_line, output);
+}
+
+// Evaluate one line and write its output line, adding the estimated time
+// of the evaluation to *cost unless cost is NULL
+// Returns 1 on success, 0 if the line produced an error
+static int batch_process_line(FILE *output, const char *line, size_t length, double *cost)
+{
+    if (length == 0)
+    {
+        if (batch_output == BATCH_OUTPUT_BINARY)
+        {
+            format_buffer_reset(&batch_line);
+            binary_append_empty(&batch_line);
+            format_buffer_write(&batch_line, output);
+        }
+        else
+        {
+            fputc('\n', output);
+        }
+        return 1;
+    }
+
+    if (memchr(line, '\0', length))
+    {
+        batch_write_error(output, "Input contains a NUL byte");
+        return 0;
+    }
+
+    if (!batch_arena)
+    {
+        batch_arena = ast_arena_create(0);
+    }
+
+    PROFILE_COUNT(PROFILE_LINES, 1);
+    PROFILE_START(parse_start);
+    Lexer lexer;
+    lexer_init_length(&lexer, line, length);
+
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_arena(&parser, batch_arena);
+    parser_set_quiet(&parser, 1);
+    ASTNode *ast = parser_parse_expression(&parser);
+    PROFILE_PHASE(PROFILE_PARSE, parse_start);
+
+    int ok = 0;
+    if (!ast || parser_has_error(&parser))
+    {
+        const char *message = parser_get_error_message(&parser);
+        batch_write_error(output, message ? message : "Parse error");
+    }
+    else if (parser.current_token.type == TOKEN_INVALID)
+    {
+        batch_write_error(output, "Invalid token encountered");
+    }
+    else if (parser.current_token.type != TOKEN_EOF)
+    {
+        char message[128];
+        snprintf(message, sizeof(message), "Unexpected token at end: %s",
+                 token_type_str(parser.current_token.type));
+        batch_write_error(output, message);
+    }
+    else
+    {
+        if (cost)
+        {
+            *cost += analysis_estimate_cost(eval_context_default(), ast);
+        }
+
+        mpfr_t result;
+        mpfr_init2(result, global_precision);
+        PROFILE_COUNT(PROFILE_MPFR_TEMPS, 1);
+        PROFILE_START(eval_start);
+        evaluator_eval(result, ast);
+        PROFILE_PHASE(PROFILE_EVAL, eval_start);
+
+        const char *eval_error = evaluator_get_last_error();
+        if (eval_error)
+        {
+            batch_write_error(output, eval_error);
+        }
+        else
+        {
+            PROFILE_START(format_start);
+            format_buffer_reset(&batch_line);
+            mpz_srcptr exact = evaluator_exact_integer(eval_context_default());
+            if (batch_output == BATCH_OUTPUT_BINARY && exact)
+            {
+                // Exact integers can be wider than the result; widen the
+                // record to keep every bit
+                size_t bits = mpz_sizeinbase(exact, 2);
+                mpfr_t whole;
+                mpfr_init2(whole, bits > (size_t)global_precision ? (mpfr_prec_t)bits
+                                                                  : global_precision);
+                mpfr_set_z(whole, exact, MPFR_RNDN);
+                binary_append_value(&batch_line, whole);
+                mpfr_clear(whole);
+            }
+            else if (batch_output == BATCH_OUTPUT_BINARY)
+            {
+                binary_append_value(&batch_line, result);
+            }
+            else
+            {
+                // Huge results go out as they are formatted
+                batch_line.stream = output;
+                formatter_format_result(&batch_line, result,
+                                       ast->type == NODE_NUMBER && ast->number.is_int);
+                format_buffer_append_char(&batch_line, '\n');
+            }
+            format_buffer_write(&batch_line, output);
+            PROFILE_PHASE(PROFILE_FORMAT, format_start);
+            ok = 1;
+        }
+        mpfr_clear(result);
+    }
+
+    // Tokens still held by the parser would leak once per line
+    token_free(&parser.previous_token);
+    token_free(&parser.current_token);
+    ast_free(ast);
+    ast_arena_reset(batch_arena);
+    return ok;
+}
+
+// Strip the line terminator ("\n" or "\r\n") from a line read by getline()
+static size_t batch_trim_line(const char *line, ssize_t read)
+{
+    size_t length = (size_t)read;
+    if (length > 0 && line[length - 1] == '\n')
+    {
+        length--;
+    }
+    if (length > 0 && line[length - 1] == '\r')
+    {
+        length--;
+    }
+    return length;
+}
+
+// Release the calling thread's evaluation resources
+static void batch_thread_cleanup(void)
+{
+    ast_arena_destroy(batch_arena);
+    batch_arena = NULL;
+    format_buffer_free(&batch_line);
+    formatter_cleanup();
+    evaluator_cleanup();
+    profile_merge_thread();
+}
+
+static int batch_process_serial(FILE *input, FILE *output, BatchPosition *position)
+{
+    int status = BATCH_EXIT_OK;
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t read;
+
+    while ((read = getline(&line, &capacity, input)) != -1)
+    {
+        position->input += read;
+        if (!batch_in_shard(position->lines++))
+        {
+            continue;
+        }
+
+        if (!batch_process_line(output, line, batch_trim_line(line, read), NULL))
+        {
+            status = BATCH_EXIT_LINE_ERROR;
+        }
+
+        if (ferror(output) || !batch_checkpoint(output, position, 0))
+        {
+            status = BATCH_EXIT_IO_ERROR;
+            break;
+        }
+    }
+
+    free(line);
+
+    if (status != BATCH_EXIT_IO_ERROR && !ferror(input) && !batch_checkpoint(output, position, 1))
+    {
+        status = BATCH_EXIT_IO_ERROR;
+    }
+    if (ferror(input) || fflush(output) != 0 || ferror(output))
+    {
+        return BATCH_EXIT_IO_ERROR;
+    }
+    return status;
+}
+
+// Append a line to a chunk; returns 0 if out of memory
+static int batch_chunk_append(BatchChunk *chunk, const char *line, size_t length)
+{
+    chunk->starts[chunk->line_count] = chunk->text_length;
+    chunk->lengths[chunk->line_count] = length;
+
+    // An empty line has no text to copy, and the buffer may not exist yet
+    if (length == 0)
+    {
+        chunk->line_count++;
+        return 1;
+    }
+
+    if (chunk->text_length + length > chunk->text_capacity)
+    {
+        size_t new_capacity = chunk->text_capacity ? chunk->text_capacity : 4096;
+        while (new_capacity < chunk->text_length + length)
+        {
+            new_capacity *= 2;
+        }
+        char *new_text = realloc(chunk->text, new_capacity);
+        if (!new_text)
+        {
+            return 0;
+        }
+        chunk->text = new_text;
+        chunk->text_capacity = new_capacity;
+    }
+
+    memcpy(chunk->text + chunk->text_length, line, length);
+    chunk->text_length += length;
+    chunk->line_count++;
+    return 1;
+}
+
+static void batch_process_chunk(BatchChunk *chunk)
+{
+    chunk->failed = 0;
+    chunk->io_error = 0;
+    chunk->cost = 0;
+
+    FILE *out = open_memstream(&chunk->output, &chunk->output_length);
+    if (!out)
+    {
+        chunk->io_error = 1;
+        return;
+    }
+
+    for (int i = 0; i < chunk->line_count; i++)
+    {
+        const char *line = chunk->lengths[i] ? chunk->text + chunk->starts[i] : "";
+        if (!batch_process_line(out, line, chunk->lengths[i], &chunk->cost))
+        {
+            chunk->failed = 1;
+        }
+    }
+
+    if (fclose(out) != 0)
+    {
+        chunk->io_error = 1;
+    }
+}
+
+static void *batch_worker(void *arg)
+{
+    BatchPool *pool = arg;
+
+    evaluator_set_strict_mode(pool->strict_mode);
+    functions_set_strict_domain(pool->strict_domain);
+    evaluator_set_adaptive(pool->adaptive);
+    evaluator_set_interval(pool->interval);
+    evaluator_set_native(pool->native);
+    evaluator_set_exact(pool->exact);
+    evaluator_set_budget(&pool->budget);
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (pool->take_seq == pool->read_seq && !pool->done_reading)
+        {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+        if (pool->take_seq == pool->read_seq)
+        {
+            break;
+        }
+
+        BatchChunk *chunk = &pool->chunks[pool->take_seq++ % pool->chunk_count];
+        chunk->state = CHUNK_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+
+        batch_process_chunk(chunk);
+
+        pthread_mutex_lock(&pool->lock);
+        // Each chunk moves the estimate part of the way to its own average
+        double line_cost = chunk->cost / chunk->line_count;
+        if (pool->line_cost > 0)
+        {
+            line_cost = pool->line_cost + BATCH_COST_SMOOTHING * (line_cost - pool->line_cost);
+        }
+        pool->line_cost = line_cost;
+        chunk->state = CHUNK_DONE;
+        pthread_cond_broadcast(&pool->changed);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    batch_thread_cleanup();
+    mpfr_free_cache();
+    return NULL;
+}
+
+// Lines the next chunk should hold for its estimated cost to come near
+// BATCH_CHUNK_COST, going by the lines evaluated so far
+static int batch_chunk_lines(BatchPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    double line_cost = pool->line_cost;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (line_cost * BATCH_CHUNK_LINES <= BATCH_CHUNK_COST)
+    {
+        return BATCH_CHUNK_LINES;
+    }
+    int lines = (int)(BATCH_CHUNK_COST / line_cost);
+    return lines > 1 ? lines : 1;
+}
+
+// Write the oldest outstanding chunk if it is done, optionally waiting for
+// it. Returns 1 if a chunk was written out, 0 otherwise.
+static int batch_write_next(BatchPool *pool, FILE *output, int wait, int *status)
+{
+    if (pool->write_seq == pool->read_seq)
+    {
+        return 0;
+    }
+
+    BatchChunk *chunk = &pool->chunks[pool->write_seq % pool->chunk_count];
+
+    pthread_mutex_lock(&pool->lock);
+    while (chunk->state != CHUNK_DONE)
+    {
+        if (!wait)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return 0;
+        }
+        pthread_cond_wait(&pool->changed, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (chunk->io_error)
+    {
+        *status = BATCH_EXIT_IO_ERROR;
+    }
+    else if (*status != BATCH_EXIT_IO_ERROR)
+    {
+        if (fwrite(chunk->output, 1, chunk->output_length, output) != chunk->output_length)
+        {
+            *status = BATCH_EXIT_IO_ERROR;
+        }
+        else
+        {
+            if (chunk->failed)
+            {
+                *status = BATCH_EXIT_LINE_ERROR;
+            }
+            pool->written.input = chunk->input_end;
+            pool->written.lines = chunk->lines_end;
+            if (!batch_checkpoint(output, &pool->written, 0))
+            {
+                *status = BATCH_EXIT_IO_ERROR;
+            }
+        }
+    }
+
+    free(chunk->output);
+    chunk->output = NULL;
+    chunk->output_length = 0;
+
+    // Only the main thread touches write_seq and free slots
+    chunk->state = CHUNK_FREE;
+    pool->write_seq++;
+    return 1;
+}
+
+static int batch_process_parallel(FILE *input, FILE *output, int jobs, BatchPosition *position)
+{
+    BatchPool pool = {0};
+    pool.chunk_count = (long)jobs * BATCH_CHUNKS_PER_JOB;
+    pool.chunks = calloc(pool.chunk_count, sizeof(BatchChunk));
+    pthread_t *threads = malloc(jobs * sizeof(pthread_t));
+    if (!pool.chunks || !threads)
+    {
+        free(pool.chunks);
+        free(threads);
+        return batch_process_serial(input, output, position);
+    }
+    pool.written = *position;
+
+    pool.strict_mode = evaluator_get_strict_mode();
+    pool.strict_domain = functions_get_strict_domain();
+    pool.adaptive = evaluator_get_adaptive();
+    pool.interval = evaluator_get_interval();
+    pool.native = evaluator_get_native();
+    pool.exact = evaluator_get_exact();
+    pool.budget = evaluator_get_budget();
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.changed, NULL);
+
+    int started = 0;
+    while (started < jobs && pthread_create(&threads[started], NULL, batch_worker, &pool) == 0)
+    {
+        started++;
+    }
+
+    int status = BATCH_EXIT_OK;
+    char *line = NULL;
+    size_t capacity = 0;
+    int at_eof = 0;
+
+    if (started == 0)
+    {
+        // No workers could be created: evaluate on this thread instead
+        status = batch_process_serial(input, output, position);
+        at_eof = 1;
+    }
+
+    while (!at_eof && status != BATCH_EXIT_IO_ERROR)
+    {
+        // Wait for the slot to be reused to be written out
+        while (pool.read_seq - pool.write_seq == pool.chunk_count)
+        {
+            batch_write_next(&pool, output, 1, &status);
+        }
+
+        BatchChunk *chunk = &pool.chunks[pool.read_seq % pool.chunk_count];
+        chunk->line_count = 0;
+        chunk->text_length = 0;
+
+        int chunk_lines = batch_chunk_lines(&pool);
+        while (chunk->line_count < chunk_lines)
+        {
+            ssize_t read = getline(&line, &capacity, input);
+            if (read == -1)
+            {
+                at_eof = 1;
+                break;
+            }
+            position->input += read;
+            if (!batch_in_shard(position->lines++))
+            {
+                continue;
+            }
+            if (!batch_chunk_append(chunk, line, batch_trim_line(line, read)))
+            {
+                status = BATCH_EXIT_IO_ERROR;
+                break;
+            }
+        }
+        chunk->input_end = position->input;
+        chunk->lines_end = position->lines;
+
+        if (chunk->line_count > 0)
+        {
+            pthread_mutex_lock(&pool.lock);
+            chunk->state = CHUNK_READY;
+            pool.read_seq++;
+            pthread_cond_broadcast(&pool.changed);
+            pthread_mutex_unlock(&pool.lock);
+        }
+
+        // Write out whatever has already finished, in order
+        while (batch_write_next(&pool, output, 0, &status))
+        {
+        }
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.done_reading = 1;
+    pthread_cond_broadcast(&pool.changed);
+    pthread_mutex_unlock(&pool.lock);
+
+    while (batch_write_next(&pool, output, 1, &status))
+    {
+    }
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // The lines after the last chunk were outside the shard
+    if (started > 0 && status != BATCH_EXIT_IO_ERROR && !ferror(input))
+    {
+        pool.written.input = position->input;
+        pool.written.lines = position->lines;
+        if (!batch_checkpoint(output, &pool.written, 1))
+        {
+            status = BATCH_EXIT_IO_ERROR;
+        }
+    }
+
+    free(line);
+    for (long i = 0; i < pool.chunk_count; i++)
+    {
+        free(pool.chunks[i].text);
+        free(pool.chunks[i].output);
+    }
+    free(pool.chunks);
+    free(threads);
+    pthread_cond_destroy(&pool.changed);
+    pthread_mutex_destroy(&pool.lock);
+
+    if (ferror(input) || fflush(output) != 0 || ferror(output))
+    {
+        return BATCH_EXIT_IO_ERROR;
+    }
+    return status;
+}
+
+int batch_process_stream(FILE *input, FILE *output, int jobs)
+{
+    if (!input || !output)
+    {
+        return BATCH_EXIT_IO_ERROR;
+    }
+
+    batch_error[0] = '\0';
+    BatchPosition position;
+    if (!batch_resume(input, output, &position))
+    {
+        return BATCH_EXIT_IO_ERROR;
+    }
+
+    if (jobs <= 1)
+    {
+        return batch_process_serial(input, output, &position);
+    }
+    return batch_process_parallel(input, output, jobs > BATCH_MAX_JOBS ? BATCH_MAX_JOBS : jobs,
+                                  &position);
+}
+
+int batch_run(const char *path, int jobs)
+{
+    FILE *input = stdin;
+    if (path && strcmp(path, "-") != 0)
+    {
+        input = fopen(path, "r");
+        if (!input)
+        {
+            fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+            return BATCH_EXIT_IO_ERROR;
+        }
+    }
+
+    // Must happen before any other use of the streams
+    setvbuf(input, NULL, _IOFBF, BATCH_BUFFER_SIZE);
+    setvbuf(stdout, NULL, _IOFBF, BATCH_BUFFER_SIZE);
+
+    int status = batch_process_stream(input, stdout, jobs);
+
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+    if (status == BATCH_EXIT_IO_ERROR)
+    {
+        fprintf(stderr, "Batch I/O error: %s\n", batch_error[0] ? batch_error : strerror(errno));
+    }
+    return status;
+}
+
+void batch_cleanup(void)
+{
+    batch_thread_cleanup();
+    constants_table_unload();
+    constants_cleanup();
+    functions_cleanup();
+    precision_cleanup();
+}
@@ -0,0 +1,108 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+// Exit statuses of batch mode
+#define BATCH_EXIT_OK 0         // Every line evaluated successfully
+#define BATCH_EXIT_LINE_ERROR 1 // At least one line produced an error
+#define BATCH_EXIT_IO_ERROR 2   // Input could not be read or output written
+
+// Upper bound on the number of worker threads
+#define BATCH_MAX_JOBS 256
+
+// Seconds between checkpoints (see batch_set_checkpoint())
+#define BATCH_CHECKPOINT_SECONDS 10
+
+// How batch mode writes its results
+typedef enum
+{
+    BATCH_OUTPUT_TEXT,  // One text line per input line
+    BATCH_OUTPUT_BINARY // One binary record per input line (see binary.h)
+} BatchOutput;
+
+/**
+ * Initialize the subsystems batch mode needs (no readline or history)
+ * @return 0 on success, non-zero on failure
+ */
+int batch_init(void);
+
+/**
+ * Set how batch mode writes results
+ * Takes effect for runs started afterwards.
+ * @param output Output mode
+ */
+void batch_set_output(BatchOutput output);
+
+/**
+ * Get how batch mode writes results
+ * @return Current output mode
+ */
+BatchOutput batch_get_output(void);
+
+/**
+ * Evaluate only one shard of the input lines
+ * Line n (counting from 0, blank lines included) belongs to shard
+ * n % count, so the shards of a file are disjoint and cover it whatever
+ * the line contents. Lines outside the shard produce no output.
+ * Takes effect for runs started afterwards.
+ * @param index Shard to evaluate, from 0 to count - 1
+ * @param count Number of shards, 1 to evaluate every line
+ * @return 0 on success, -1 if the shard is out of range
+ */
+int batch_set_shard(int index, int count);
+
+/**
+ * Record the progress of runs in a checkpoint file, and resume from it
+ * Every BATCH_CHECKPOINT_SECONDS, and when the input ends, the run saves
+ * the input offset and line number it has finished along with the output
+ * offset their results end at. A run started with an existing checkpoint
+ * cuts the output back to that offset and continues with the next input
+ * line, so a killed run restarted with the same arguments (and its output
+ * appended to, as with >>) produces the same output as one that was never
+ * interrupted. The output must be a regular file; the input is skipped by
+ * seeking when it can be, and by reading past the finished lines otherwise.
+ * Takes effect for runs started afterwards.
+ * @param path Checkpoint file, which must stay valid while runs use it,
+ *             or NULL to disable checkpoints
+ */
+void batch_set_checkpoint(const char *path);
+
+/**
+ * Evaluate newline-delimited expressions from a stream.
+ *
+ * Each input line produces exactly one output line: the result, an empty
+ * line for blank input, or "error: <message>". Lines have no length limit.
+ * In BATCH_OUTPUT_BINARY mode each input line produces one record instead:
+ * the exact value, an empty record or an error record.
+ *
+ * With more than one job, lines are handed out in chunks to a pool of
+ * worker threads and the results are written in input order, so the
+ * output is identical to a single-threaded run. Workers inherit the
+ * calling thread's strict modes.
+ *
+ * Only the lines of the shard set by batch_set_shard() are evaluated, and
+ * with a checkpoint file the run resumes where the last one stopped.
+ *
+ * @param input Stream to read expressions from
+ * @param output Stream to write results to
+ * @param jobs Number of worker threads (1 evaluates on the calling thread,
+ *             capped at BATCH_MAX_JOBS)
+ * @return One of the BATCH_EXIT_* statuses
+ */
+int batch_process_stream(FILE *input, FILE *output, int jobs);
+
+/**
+ * Run batch mode on a file or standard input with large buffered I/O
+ * @param path File to read, or NULL / "-" for standard input
+ * @param jobs Number of worker threads, as for batch_process_stream()
+ * @return One of the BATCH_EXIT_* statuses
+ */
+int batch_run(const char *path, int jobs);
+
+/**
+ * Clean up batch mode resources
+ */
+void batch_cleanup(void);
+
+#endif // BATCH_H
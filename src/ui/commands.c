@@ -1,12 +1,31 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "commands.h"
 #include "precision.h"
 #include "constants.h"
 #include "functions.h"
 #include "formatter.h"
+#include "evaluator.h"
+#include "context.h"
+#include "result_cache.h"
+#include "plan_cache.h"
+#include "profile.h"
+#include "constants_table.h"
+#include "variables.h"
+#include "sweep.h"
+#include "symbolic.h"
+#include "printer.h"
+#include "lexer.h"
+#include "parser.h"
+#include "replay.h"
+#include "input.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
 
 // Command definitions
 typedef struct
@@ -29,10 +48,35 @@ static const CommandDef command_table[] = {
     {"mode", CMD_MODE, "Show current display mode", "mode"},
     {"scientific", CMD_SET_MODE, "Set scientific notation mode", "scientific"},
     {"normal", CMD_SET_MODE, "Set normal notation mode", "normal"},
+    {"cache", CMD_CACHE, "Show result cache statistics", "cache [<KiB>|off|clear|reset]"},
+    {"plans", CMD_PLANS, "Show parsed line cache statistics", "plans [<KiB>|off|clear|reset]"},
+    {"adaptive", CMD_ADAPTIVE, "Show adaptive precision setting", "adaptive [on|off]"},
+    {"interval", CMD_INTERVAL, "Show interval evaluation setting", "interval [on|off]"},
+    {"preview", CMD_PREVIEW, "Show or switch result previews while typing", "preview [on|off]"},
+    {"vars", CMD_VARS, "List defined variables", "vars"},
+    {"sweep", CMD_SWEEP, "Tabulate an expression over a range",
+     "sweep <var> from <a> to <b> step <s> : <expr>"},
+    {"stats", CMD_STATS, "Show profiling timers and counters", "stats [on|off|reset]"},
+    {"huge", CMD_HUGE, "Show or switch huge precision mode", "huge [on|off]"},
+    {"budget", CMD_BUDGET, "Show or set limits on each evaluation",
+     "budget [time <seconds>|operations <n>|exponent <bits>|off]"},
+    {"simplify", CMD_SIMPLIFY, "Simplify an expression algebraically", "simplify <expr>"},
+    {"replay", CMD_REPLAY, "Time every line of a history file", "replay <file> [json]"},
+    {"constants", CMD_CONSTANTS, "Show or manage the precomputed constants table",
+     "constants [load <file>|export <file> [<bits>]|unload]"},
     {NULL, CMD_UNKNOWN, NULL, NULL}};
 
 static char *trim_whitespace(char *str);
 static CommandType find_command_type(const char *name);
+static void print_backend_info(void);
+static void print_variables(void);
+static void run_sweep(const char *argument);
+static void run_constants(const char *argument);
+static int huge_precision_fits(mpfr_prec_t precision);
+static void run_budget(const char *argument);
+static void run_simplify(const char *argument);
+static void run_replay(const char *argument);
+static void print_huge_info(void);
 
 Command commands_parse(const char *input)
 {
@@ -121,6 +165,7 @@ int commands_execute(const Command *cmd)
 
     case CMD_PRECISION:
         print_precision_info();
+        print_backend_info();
         return 0;
 
     case CMD_SET_PRECISION:
@@ -129,10 +174,19 @@ int commands_execute(const Command *cmd)
             long new_prec = strtol(cmd->argument, NULL, 10);
             if (new_prec > 0)
             {
+                if (new_prec > precision_max())
+                {
+                    printf("Precision is capped at %ld bits%s\n", (long)precision_max(),
+                           precision_get_huge() ? "" : " (use 'huge on' for more)");
+                    new_prec = precision_max();
+                }
+                if (new_prec > MAX_PRECISION && !huge_precision_fits(new_prec))
+                {
+                    return 0;
+                }
                 set_precision((mpfr_prec_t)new_prec);
                 print_precision_info();
-                // Clear cached constants when precision changes
-                constants_clear_cache();
+                print_backend_info();
             }
             else
             {
@@ -168,6 +222,210 @@ int commands_execute(const Command *cmd)
         }
         return 0;
 
+    case CMD_CACHE:
+        if (!cmd->argument)
+        {
+            result_cache_print_stats();
+        }
+        else if (strcmp(cmd->argument, "off") == 0)
+        {
+            result_cache_set_capacity(0);
+            printf("Result cache disabled\n");
+        }
+        else if (strcmp(cmd->argument, "clear") == 0)
+        {
+            result_cache_clear();
+            printf("Result cache cleared\n");
+        }
+        else if (strcmp(cmd->argument, "reset") == 0)
+        {
+            result_cache_reset_stats();
+            printf("Result cache statistics reset\n");
+        }
+        else
+        {
+            char *end;
+            long kib = strtol(cmd->argument, &end, 10);
+            if (kib > 0 && *end == '\0')
+            {
+                result_cache_set_capacity((size_t)kib * 1024);
+                printf("Result cache limited to %ld KiB\n", kib);
+            }
+            else
+            {
+                printf("Invalid cache size: %s (use a size in KiB, 'off', 'clear' or 'reset')\n",
+                       cmd->argument);
+            }
+        }
+        return 0;
+
+    case CMD_PLANS:
+        if (!cmd->argument)
+        {
+            plan_cache_print_stats();
+        }
+        else if (strcmp(cmd->argument, "off") == 0)
+        {
+            plan_cache_set_capacity(0);
+            printf("Plan cache disabled\n");
+        }
+        else if (strcmp(cmd->argument, "clear") == 0)
+        {
+            plan_cache_clear();
+            printf("Plan cache cleared\n");
+        }
+        else if (strcmp(cmd->argument, "reset") == 0)
+        {
+            plan_cache_reset_stats();
+            printf("Plan cache statistics reset\n");
+        }
+        else
+        {
+            char *end;
+            long kib = strtol(cmd->argument, &end, 10);
+            if (kib > 0 && *end == '\0')
+            {
+                plan_cache_set_capacity((size_t)kib * 1024);
+                printf("Plan cache limited to %ld KiB\n", kib);
+            }
+            else
+            {
+                printf("Invalid plan cache size: %s (use a size in KiB, 'off', 'clear' or "
+                       "'reset')\n",
+                       cmd->argument);
+            }
+        }
+        return 0;
+
+    case CMD_ADAPTIVE:
+        if (cmd->argument && strcmp(cmd->argument, "on") == 0)
+        {
+            evaluator_set_adaptive(1);
+        }
+        else if (cmd->argument && strcmp(cmd->argument, "off") == 0)
+        {
+            evaluator_set_adaptive(0);
+        }
+        else if (cmd->argument)
+        {
+            printf("Invalid adaptive setting: %s (use 'on' or 'off')\n", cmd->argument);
+            return 0;
+        }
+        printf("Adaptive precision: %s\n",
+               evaluator_get_adaptive() ? "on (results are correctly rounded)"
+                                         : "off (fixed 128 guard bits)");
+        return 0;
+
+    case CMD_INTERVAL:
+        if (cmd->argument && strcmp(cmd->argument, "on") == 0)
+        {
+            evaluator_set_interval(1);
+        }
+        else if (cmd->argument && strcmp(cmd->argument, "off") == 0)
+        {
+            evaluator_set_interval(0);
+        }
+        else if (cmd->argument)
+        {
+            printf("Invalid interval setting: %s (use 'on' or 'off')\n", cmd->argument);
+            return 0;
+        }
+        printf("Interval evaluation: %s\n",
+               evaluator_get_interval() ? "on (results show certified digits and an error bound)"
+                                         : "off");
+        return 0;
+
+    case CMD_PREVIEW:
+        if (cmd->argument &&
+            (strcmp(cmd->argument, "on") == 0 || strcmp(cmd->argument, "off") == 0))
+        {
+            if (input_set_preview(strcmp(cmd->argument, "on") == 0) != 0)
+            {
+                printf("Result previews need readline support\n");
+                return 0;
+            }
+        }
+        else if (cmd->argument)
+        {
+            printf("Invalid preview setting: %s (use 'on' or 'off')\n", cmd->argument);
+            return 0;
+        }
+        printf("Result preview: %s\n",
+               input_get_preview() ? "on (values appear dimmed after the line as you type)"
+                                   : "off");
+        return 0;
+
+    case CMD_VARS:
+        print_variables();
+        return 0;
+
+    case CMD_SWEEP:
+        run_sweep(cmd->argument);
+        return 0;
+
+    case CMD_STATS:
+        if (!profile_available())
+        {
+            printf("Profiling is not available in this build (built with NO_PROFILE)\n");
+        }
+        else if (!cmd->argument)
+        {
+            profile_print(stdout);
+        }
+        else if (strcmp(cmd->argument, "on") == 0)
+        {
+            profile_set_enabled(1);
+            printf("Profiling on\n");
+        }
+        else if (strcmp(cmd->argument, "off") == 0)
+        {
+            profile_set_enabled(0);
+            printf("Profiling off\n");
+        }
+        else if (strcmp(cmd->argument, "reset") == 0)
+        {
+            profile_reset();
+            printf("Profile counters reset\n");
+        }
+        else
+        {
+            printf("Invalid stats setting: %s (use 'on', 'off' or 'reset')\n", cmd->argument);
+        }
+        return 0;
+
+    case CMD_CONSTANTS:
+        run_constants(cmd->argument);
+        return 0;
+
+    case CMD_HUGE:
+        if (cmd->argument && strcmp(cmd->argument, "on") == 0)
+        {
+            commands_set_huge(1);
+        }
+        else if (cmd->argument && strcmp(cmd->argument, "off") == 0)
+        {
+            commands_set_huge(0);
+        }
+        else if (cmd->argument)
+        {
+            printf("Invalid huge setting: %s (use 'on' or 'off')\n", cmd->argument);
+            return 0;
+        }
+        print_huge_info();
+        return 0;
+
+    case CMD_BUDGET:
+        run_budget(cmd->argument);
+        return 0;
+
+    case CMD_SIMPLIFY:
+        run_simplify(cmd->argument);
+        return 0;
+
+    case CMD_REPLAY:
+        run_replay(cmd->argument);
+        return 0;
+
     case CMD_TEST:
         printf("Testing high precision arithmetic:\n");
 
@@ -273,6 +531,11 @@ void commands_print_help(void)
         printf("  %-10s - %s\n", command_table[i].name, command_table[i].description);
     }
     printf("  precision <bits> - Set precision (53-8192 bits)\n");
+    printf("  cache <KiB>      - Cache results of repeated expressions (cache off to disable)\n");
+    printf("  adaptive on      - Retry with more precision until results round correctly\n");
+    printf("  interval on      - Bound every result rigorously in one pass\n");
+    printf("  preview on       - Show the value of the line as you type it\n");
+    printf("  stats on         - Time each phase and count allocations (stats to show)\n");
     printf("\n");
 
     printf("Display mode commands:\n");
@@ -296,6 +559,12 @@ void commands_print_help(void)
     printf("  pi*e^100      -> Very large precise calculations\n");
     printf("  sqrt(2)       -> High precision square root\n\n");
 
+    printf("Variables:\n");
+    printf("  x = 1.5       -> Define x (dependents update when it changes)\n");
+    printf("  y = sin(x)^2  -> Definitions can use other variables, even undefined ones\n");
+    printf("  2x + y        -> Use them like constants\n");
+    printf("  sweep x from 0 to 1 step 0.1 : sin(x) -> One row per value of x\n\n");
+
     printf("Scientific notation:\n");
     printf("  1.5e10        -> 15000000000\n");
     printf("  2.3e-5        -> 2.3e-05\n");
@@ -371,7 +640,8 @@ void commands_print_command_help(const char *cmd_name)
         printf("  precision 128    - Set precision to 128 bits\n");
         printf("  precision 512    - Set precision to 512 bits\n");
         printf("  precision 1024   - Set precision to 1024 bits\n");
-        printf("\nValid range: %d to %d bits\n", MIN_PRECISION, MAX_PRECISION);
+        printf("\nValid range: %d to %ld bits", MIN_PRECISION, (long)precision_max());
+        printf("%s\n", precision_get_huge() ? "" : " (more with 'huge on')");
         printf("Note: Higher precision uses more memory and is slower\n");
         return;
     }
@@ -445,4 +715,436 @@ static CommandType find_command_type(const char *name)
     }
 
     return CMD_UNKNOWN;
-}
\ No newline at end of file
+}
+
+static void print_backend_info(void)
+{
+    const char *backend = evaluator_backend_name(eval_context_default());
+    if (strcmp(backend, "MPFR") == 0)
+    {
+        printf("Backend: MPFR\n");
+    }
+    else
+    {
+        printf("Backend: %s (falls back to MPFR when a result cannot be certified)\n", backend);
+    }
+}
+
+static void print_variables(void)
+{
+    VariableTable *table = eval_context_default()->variables;
+    int defined = 0;
+
+    mpfr_t value;
+    mpfr_init2(value, global_precision);
+    for (int i = 0; table && i < table->count; i++)
+    {
+        const Variable *var = &table->variables[i];
+        if (!var->definition)
+        {
+            continue;
+        }
+        defined++;
+
+        // Reading through a variable node reuses the value when it is current
+        ASTNode *reference = ast_create_variable(var->name);
+        if (!reference)
+        {
+            break;
+        }
+        evaluator_eval(value, reference);
+        ast_free(reference);
+
+        const char *error = evaluator_get_last_error();
+        const char *pending = variables_pending(table, i);
+        printf("%s = ", var->name);
+        if (pending)
+        {
+            printf("(pending: %s is not defined yet)\n", pending);
+        }
+        else if (error)
+        {
+            printf("(%s)\n", error);
+        }
+        else
+        {
+            formatter_print_result_with_mode(value, 0);
+        }
+    }
+    mpfr_clear(value);
+
+    if (!defined)
+    {
+        printf("No variables defined\n");
+    }
+}
+
+// Find a word standing on its own, with whitespace or the ends around it
+static const char *find_word(const char *text, const char *word)
+{
+    size_t length = strlen(word);
+    for (const char *at = strstr(text, word); at; at = strstr(at + 1, word))
+    {
+        int starts = at == text || isspace((unsigned char)at[-1]);
+        int ends = at[length] == '\0' || isspace((unsigned char)at[length]);
+        if (starts && ends)
+        {
+            return at;
+        }
+    }
+    return NULL;
+}
+
+// Parse one part of a sweep command into a heap tree, reporting failures
+static ASTNode *parse_sweep_part(const char *label, const char *start, const char *end)
+{
+    Lexer lexer;
+    lexer_init_length(&lexer, start, (size_t)(end - start));
+    Parser parser;
+    parser_init(&parser, &lexer);
+
+    ASTNode *ast = parser_parse_expression(&parser);
+    if (!ast || parser_has_error(&parser) || parser.current_token.type != TOKEN_EOF)
+    {
+        printf("Parse error in sweep %s: %.*s\n", label, (int)(end - start), start);
+        ast_free(ast);
+        return NULL;
+    }
+    return ast;
+}
+
+// Evaluate a sweep bound or step with the current settings
+static int eval_sweep_part(const char *label, const char *start, const char *end, mpfr_t value)
+{
+    ASTNode *ast = parse_sweep_part(label, start, end);
+    if (!ast)
+    {
+        return 0;
+    }
+
+    evaluator_eval(value, ast);
+    ast_free(ast);
+    const char *error = evaluator_get_last_error();
+    if (error)
+    {
+        printf("Evaluation error in sweep %s: %s\n", label, error);
+        return 0;
+    }
+    return 1;
+}
+
+static void run_sweep(const char *argument)
+{
+    const char *colon = argument ? strchr(argument, ':') : NULL;
+    const char *from = colon ? find_word(argument, "from") : NULL;
+    const char *to = from && from < colon ? find_word(from + 4, "to") : NULL;
+    const char *step = to && to < colon ? find_word(to + 2, "step") : NULL;
+    if (!step || step > colon)
+    {
+        printf("Usage: sweep <var> from <a> to <b> step <s> : <expr>\n");
+        return;
+    }
+
+    // The swept name must be a single identifier that is not built in
+    Lexer lexer;
+    lexer_init_length(&lexer, argument, (size_t)(from - argument));
+    Token name_token = lexer_get_next_token(&lexer);
+    Token after = lexer_get_next_token(&lexer);
+    if (name_token.type != TOKEN_IDENTIFIER || after.type != TOKEN_EOF)
+    {
+        printf("Invalid sweep variable: %.*s\n", (int)name_token.length,
+               lexer_token_text(&lexer, &name_token));
+        return;
+    }
+    char name[128];
+    snprintf(name, sizeof(name), "%.*s", (int)name_token.length,
+             lexer_token_text(&lexer, &name_token));
+
+    EvalContext *ctx = eval_context_default();
+    mpfr_t bounds[3];
+    for (int i = 0; i < 3; i++)
+    {
+        // Keep the guard bits literals get, or point i * step shows the rounding
+        mpfr_init2(bounds[i], ctx->precision + BINOP_PRECISION_BOOST);
+    }
+
+    ASTNode *body = NULL;
+    unsigned long count = 0;
+    if (eval_sweep_part("start", from + 4, to, bounds[0]) &&
+        eval_sweep_part("end", to + 2, step, bounds[1]) &&
+        eval_sweep_part("step", step + 4, colon, bounds[2]))
+    {
+        if (!sweep_count(bounds[0], bounds[1], bounds[2], &count))
+        {
+            printf("Sweep error: %s\n", sweep_get_error());
+        }
+        else
+        {
+            body = parse_sweep_part("expression", colon + 1, colon + strlen(colon));
+        }
+    }
+
+    if (body)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        SweepSpec spec = {body, name, bounds[0], bounds[2], count, ctx->variables, 1};
+        spec.jobs = processors < 1 ? 1 : processors > SWEEP_MAX_JOBS ? SWEEP_MAX_JOBS
+                                                                      : (int)processors;
+
+        // Workers take the display settings from their context, not the globals
+        EvalContext settings;
+        eval_context_init(&settings, ctx->precision);
+        settings.rounding = ctx->rounding;
+        settings.strict_mode = ctx->strict_mode;
+        settings.strict_domain = ctx->strict_domain;
+        settings.adaptive = ctx->adaptive;
+        settings.interval = ctx->interval;
+        settings.native = ctx->native;
+        settings.exact = ctx->exact;
+        settings.budget = ctx->budget;
+        settings.format = formatter_get_settings();
+
+        const char *expression = colon + 1;
+        while (isspace((unsigned char)*expression))
+        {
+            expression++;
+        }
+        printf("%s\t%s\n", name, expression);
+        if (!sweep_run(&settings, &spec, stdout, NULL))
+        {
+            printf("Sweep error: %s\n", sweep_get_error());
+        }
+
+        eval_context_cleanup(&settings);
+        ast_free(body);
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        mpfr_clear(bounds[i]);
+    }
+}
+
+static void run_constants(const char *argument)
+{
+    char action[16] = "";
+    char path[1024] = "";
+    long bits = CONSTANTS_TABLE_DEFAULT_PRECISION;
+    int fields = argument ? sscanf(argument, "%15s %1023s %ld", action, path, &bits) : 0;
+
+    if (fields <= 0)
+    {
+        mpfr_prec_t precision = constants_table_precision();
+        if (precision)
+        {
+            printf("Constants table: loaded (%ld bits)\n", (long)precision);
+        }
+        else
+        {
+            printf("Constants table: none (constants are computed on first use)\n");
+        }
+    }
+    else if (strcmp(action, "load") == 0 && fields == 2)
+    {
+        if (constants_table_load(path) == 0)
+        {
+            printf("Loaded constants table %s (%ld bits)\n", path,
+                   (long)constants_table_precision());
+        }
+        else
+        {
+            printf("Constants error: %s\n", constants_table_get_error());
+        }
+    }
+    else if (strcmp(action, "export") == 0 && fields >= 2)
+    {
+        if (constants_table_export(path, (mpfr_prec_t)bits) == 0)
+        {
+            printf("Wrote constants table %s (%ld bits)\n", path, bits);
+        }
+        else
+        {
+            printf("Constants error: %s\n", constants_table_get_error());
+        }
+    }
+    else if (strcmp(action, "unload") == 0 && fields == 1)
+    {
+        constants_table_unload();
+        printf("Constants table unloaded\n");
+    }
+    else
+    {
+        printf("Usage: constants [load <file>|export <file> [<bits>]|unload]\n");
+    }
+}
+
+// Progress of a huge precision evaluation, one line per report
+static void print_progress(void *data, long done, long total, double seconds)
+{
+    fprintf(data, "Evaluating: %ld of %ld operations, %.1f s\n", done, total, seconds);
+}
+
+void commands_set_huge(int huge)
+{
+    precision_set_huge(huge);
+    evaluator_set_progress(huge ? print_progress : NULL, huge ? stderr : NULL);
+}
+
+// Refuse a precision whose smallest evaluation would not fit in memory
+static int huge_precision_fits(mpfr_prec_t precision)
+{
+    EvalContext ctx;
+    eval_context_init(&ctx, precision);
+    ctx.adaptive = evaluator_get_adaptive();
+    size_t needed = evaluator_estimate_memory(&ctx, NULL);
+    eval_context_cleanup(&ctx);
+
+    size_t limit = precision_get_memory_limit();
+    if (limit && needed > limit)
+    {
+        printf("Not enough memory for %ld bits: needs about %zu MiB (limit %zu MiB)\n",
+               (long)precision, needed >> 20, limit >> 20);
+        return 0;
+    }
+    return 1;
+}
+
+static void print_huge_info(void)
+{
+    size_t limit = precision_get_memory_limit();
+    if (precision_get_huge())
+    {
+        printf("Huge precision: on (up to %ld bits, progress on stderr)\n",
+               (long)precision_max());
+    }
+    else
+    {
+        printf("Huge precision: off (up to %d bits)\n", MAX_PRECISION);
+    }
+    if (limit)
+    {
+        printf("Memory limit: %zu MiB per evaluation\n", limit >> 20);
+    }
+}
+
+static void run_budget(const char *argument)
+{
+    EvalBudget budget = evaluator_get_budget();
+    char limit[16] = "";
+    char value[64] = "";
+    int fields = argument ? sscanf(argument, "%15s %63s", limit, value) : 0;
+
+    if (fields > 0)
+    {
+        char *end = value;
+        double amount = fields == 2 ? strtod(value, &end) : 0.0;
+        if (fields == 2 && (*end != '\0' || amount < 0))
+        {
+            printf("Invalid budget value: %s\n", value);
+            return;
+        }
+
+        if (fields == 1 && strcmp(limit, "off") == 0)
+            budget = (EvalBudget)EVAL_BUDGET_NONE;
+        else if (fields == 2 && strcmp(limit, "time") == 0)
+            budget.seconds = amount;
+        else if (fields == 2 && strcmp(limit, "operations") == 0)
+            budget.max_operations = (long)amount;
+        else if (fields == 2 && strcmp(limit, "exponent") == 0)
+            budget.max_exponent = (long)amount;
+        else
+        {
+            printf("Usage: budget [time <seconds>|operations <n>|exponent <bits>|off]\n");
+            return;
+        }
+        evaluator_set_budget(&budget);
+    }
+
+    // Limits are listed with commas between them
+    const char *separator = " ";
+    printf("Evaluation budget:");
+    if (budget.seconds > 0)
+    {
+        printf("%s%g s", separator, budget.seconds);
+        separator = ", ";
+    }
+    if (budget.max_operations > 0)
+    {
+        printf("%s%ld operations", separator, budget.max_operations);
+        separator = ", ";
+    }
+    if (budget.max_exponent > 0)
+    {
+        printf("%sexponents up to 2^%ld", separator, budget.max_exponent);
+        separator = ", ";
+    }
+    if (budget.seconds <= 0 && budget.max_operations <= 0 && budget.max_exponent <= 0)
+        printf(" none");
+    printf(" (Ctrl-C stops an evaluation)\n");
+}
+
+static void run_simplify(const char *argument)
+{
+    if (!argument)
+    {
+        printf("Usage: simplify <expr>\n");
+        return;
+    }
+
+    Lexer lexer;
+    lexer_init(&lexer, argument);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    ASTNode *ast = parser_parse_expression(&parser);
+    if (!ast || parser_has_error(&parser) || parser.current_token.type != TOKEN_EOF)
+    {
+        printf("Parse error in expression: %s\n", argument);
+        ast_free(ast);
+        return;
+    }
+
+    SymbolicStats stats;
+    ASTNode *simplified = symbolic_simplify(ast, SYMBOLIC_DEFAULT_MAX_STEPS, &stats);
+    ast_free(ast);
+    if (!simplified)
+    {
+        printf("Memory allocation failed\n");
+        return;
+    }
+
+    // Written in input syntax, so the result can be pasted back in
+    FormatBuffer text;
+    format_buffer_init(&text);
+    if (printer_format_expression(&text, simplified))
+    {
+        printf("= %s\n", text.data);
+    }
+    else
+    {
+        printf("Cannot write the simplified expression\n");
+    }
+    format_buffer_free(&text);
+    if (stats.truncated)
+    {
+        printf("(stopped after %lu rewrite steps; the result may simplify further)\n",
+               stats.steps);
+    }
+    ast_free(simplified);
+}
+
+static void run_replay(const char *argument)
+{
+    char path[1024] = "";
+    char format[16] = "";
+    int fields = argument ? sscanf(argument, "%1023s %15s", path, format) : 0;
+    if (fields <= 0 || (fields == 2 && strcmp(format, "json") != 0))
+    {
+        printf("Usage: replay <file> [json]\n");
+        return;
+    }
+
+    if (replay_run(path, stdout, fields == 2 ? REPLAY_REPORT_JSON : REPLAY_REPORT_TEXT) != 0)
+    {
+        printf("Replay error: %s\n", replay_get_error());
+    }
+}
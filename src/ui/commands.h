@@ -14,7 +14,20 @@ typedef enum
     CMD_HISTORY,
     CMD_VERSION,
     CMD_MODE,
-    CMD_SET_MODE
+    CMD_SET_MODE,
+    CMD_CACHE,
+    CMD_ADAPTIVE,
+    CMD_INTERVAL,
+    CMD_VARS,
+    CMD_SWEEP,
+    CMD_STATS,
+    CMD_CONSTANTS,
+    CMD_HUGE,
+    CMD_BUDGET,
+    CMD_SIMPLIFY,
+    CMD_REPLAY,
+    CMD_PLANS,
+    CMD_PREVIEW
 } CommandType;
 
 typedef struct
@@ -55,6 +68,14 @@ void commands_print_help(void);
  */
 void commands_print_command_help(const char *cmd_name);
 
+/**
+ * Switch huge precision mode for the calculator
+ * Besides raising the precision cap (see precision_set_huge()), evaluations
+ * then report their progress on stderr.
+ * @param huge 1 to enable, 0 to disable
+ */
+void commands_set_huge(int huge);
+
 /**
  * Get list of available commands for tab completion
  * @param partial Partial command to match
@@ -5,9 +5,11 @@
 #include "input.h"
 #include "commands.h"
 #include "function_table.h"
+#include "preview.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #ifdef HAVE_READLINE
 #include <readline/readline.h>
@@ -15,12 +17,21 @@
 #endif
 
 static int completion_enabled = 1;
+static int preview_enabled = 0;
 
 #ifdef HAVE_READLINE
+// How often readline checks for a finished preview while waiting for
+// keys, in microseconds
+#define INPUT_PREVIEW_POLL_US 50000
+
 // Tab completion function for readline
 static char **input_completion(const char *text, int start, int end);
 static char *input_command_generator(const char *text, int state);
 static char *input_function_generator(const char *text, int state);
+
+// Result preview hooks
+static void input_preview_attach(void);
+static void input_preview_detach(void);
 #endif
 
 int input_init(void)
@@ -44,7 +55,16 @@ int input_init(void)
 char *input_read_line(const char *prompt)
 {
 #ifdef HAVE_READLINE
+    int preview = preview_enabled && isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+    if (preview)
+    {
+        input_preview_attach();
+    }
     char *line = readline(prompt ? prompt : "> ");
+    if (preview)
+    {
+        input_preview_detach();
+    }
 
     // Add non-empty lines to history
     if (line && *line)
@@ -151,6 +171,29 @@ void input_set_completion(int enable)
 #endif
 }
 
+int input_set_preview(int enable)
+{
+#ifdef HAVE_READLINE
+    if (enable && preview_start() != 0)
+    {
+        return -1;
+    }
+    if (!enable)
+    {
+        preview_stop();
+    }
+    preview_enabled = enable;
+    return 0;
+#else
+    return enable ? -1 : 0; // Previews hook into readline's redisplay
+#endif
+}
+
+int input_get_preview(void)
+{
+    return preview_enabled;
+}
+
 int input_has_readline_support(void)
 {
 #ifdef HAVE_READLINE
@@ -162,6 +205,9 @@ int input_has_readline_support(void)
 
 void input_cleanup(void)
 {
+    preview_stop();
+    preview_enabled = 0;
+
 #ifdef HAVE_READLINE
     // Save history before cleanup
     input_save_history(".calculator_history");
@@ -253,4 +299,170 @@ static char *input_function_generator(const char *text, int state)
 
     return NULL;
 }
-#endif
\ No newline at end of file
+
+// Identifies the preview on screen, 0 if none
+static unsigned long preview_shown = 0;
+
+// What Return and Ctrl-J did before previews hooked them
+static rl_command_func_t *saved_return = NULL;
+static rl_command_func_t *saved_newline = NULL;
+static int saved_timeout = 0;
+
+// Columns a text takes up, skipping the invisible parts of a prompt
+static int input_columns(const char *text)
+{
+    int columns = 0;
+    int hidden = 0;
+    for (const char *c = text; *c; c++)
+    {
+        if (*c == RL_PROMPT_START_IGNORE)
+            hidden = 1;
+        else if (*c == RL_PROMPT_END_IGNORE)
+            hidden = 0;
+        else if (!hidden && ((unsigned char)*c & 0xC0) != 0x80)
+            columns++;
+    }
+    return columns;
+}
+
+// Bytes of the first columns of a text
+static size_t input_column_bytes(const char *text, int columns)
+{
+    size_t bytes = 0;
+    while (text[bytes] && columns >= 0)
+    {
+        if (((unsigned char)text[bytes] & 0xC0) != 0x80 && columns-- == 0)
+        {
+            break;
+        }
+        bytes++;
+    }
+    return bytes;
+}
+
+// Write a preview after the end of the line, or erase the one there if
+// version is 0. The cursor is saved and restored around it and readline
+// is not told, so its own redisplay is unaffected.
+static void input_preview_show(unsigned long version, const char *text)
+{
+    int rows, columns;
+    rl_get_screen_size(&rows, &columns);
+    int used = input_columns(rl_display_prompt ? rl_display_prompt : "") +
+               input_columns(rl_line_buffer);
+
+    // A wrapped line would need cursor motions across rows; skip it
+    if (used >= columns)
+    {
+        preview_shown = 0;
+        return;
+    }
+
+    // "  = " before the value, and the last column left free so the
+    // terminal never wraps
+    int room = columns - used - 5;
+    if (room < 4)
+    {
+        version = 0;
+    }
+
+    FILE *out = rl_outstream ? rl_outstream : stdout;
+    fputs("\0337", out);
+    int tail = input_columns(rl_line_buffer + rl_point);
+    if (tail > 0)
+    {
+        fprintf(out, "\033[%dC", tail);
+    }
+    fputs("\033[K", out);
+    if (version)
+    {
+        if (input_columns(text) > room)
+        {
+            fprintf(out, "  \033[2m= %.*s...\033[0m", (int)input_column_bytes(text, room - 3),
+                    text);
+        }
+        else
+        {
+            fprintf(out, "  \033[2m= %s\033[0m", text);
+        }
+    }
+    fputs("\0338", out);
+    fflush(out);
+    preview_shown = version;
+}
+
+// Bring the preview on screen up to date; after readline redrew the line
+// it may have overwritten the preview, so that is drawn again too
+static void input_preview_draw(int redrawn)
+{
+    char text[PREVIEW_TEXT_SIZE];
+    unsigned long version = preview_get(text, sizeof(text));
+
+    // Searches show another line than the buffer
+    if (RL_ISSTATE(RL_STATE_ISEARCH | RL_STATE_NSEARCH))
+    {
+        version = 0;
+    }
+    if (version != preview_shown || (redrawn && version))
+    {
+        input_preview_show(version, text);
+    }
+}
+
+// Redisplay hook: called after every change, so handing the buffer over
+// must stay cheap (see preview_update())
+static void input_preview_redisplay(void)
+{
+    rl_redisplay();
+    if (!rl_done)
+    {
+        preview_update(rl_line_buffer);
+        input_preview_draw(1);
+    }
+}
+
+// Called by readline while it waits for keys
+static int input_preview_poll(void)
+{
+    input_preview_draw(0);
+    return 0;
+}
+
+// Accepting a line erases its preview first
+static int input_preview_accept(int count, int key)
+{
+    if (preview_shown)
+    {
+        input_preview_show(0, NULL);
+    }
+    rl_command_func_t *accept = key == '\n' ? saved_newline : saved_return;
+    return accept ? accept(count, key) : rl_newline(count, key);
+}
+
+static void input_preview_attach(void)
+{
+    preview_begin_line();
+    preview_shown = 0;
+    rl_redisplay_function = input_preview_redisplay;
+    rl_event_hook = input_preview_poll;
+    saved_timeout = rl_set_keyboard_input_timeout(INPUT_PREVIEW_POLL_US);
+
+    saved_return = rl_function_of_keyseq("\r", NULL, NULL);
+    saved_newline = rl_function_of_keyseq("\n", NULL, NULL);
+    if (saved_return == input_preview_accept)
+        saved_return = NULL;
+    if (saved_newline == input_preview_accept)
+        saved_newline = NULL;
+    rl_bind_key('\r', input_preview_accept);
+    rl_bind_key('\n', input_preview_accept);
+}
+
+static void input_preview_detach(void)
+{
+    preview_end_line();
+    rl_redisplay_function = rl_redisplay;
+    rl_event_hook = NULL;
+    rl_set_keyboard_input_timeout(saved_timeout);
+    rl_bind_key('\r', saved_return ? saved_return : rl_newline);
+    rl_bind_key('\n', saved_newline ? saved_newline : rl_newline);
+}
+#endif
@@ -45,6 +45,22 @@ int input_load_history(const char *filename);
  */
 void input_set_completion(int enable);
 
+/**
+ * Show the value of the line being typed after it, dimmed, as it is typed
+ * The value is computed on a background thread (see preview.h). Only lines
+ * read from a terminal get a preview; off by default.
+ * @param enable 1 to enable, 0 to disable
+ * @return 0 on success, -1 if previews are not available (no readline, or
+ *         the thread could not be started)
+ */
+int input_set_preview(int enable);
+
+/**
+ * Check whether result previews are on
+ * @return 1 if on, 0 otherwise
+ */
+int input_get_preview(void);
+
 /**
  * Check if readline support is available
  * @return 1 if available, 0 otherwise
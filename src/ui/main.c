@@ -1,16 +1,96 @@
 #include "repl.h"
+#include "commands.h"
+#include "batch.h"
 #include "input.h"
 #include "precision.h"
 #include "formatter.h"
+#include "evaluator.h"
+#include "multidouble.h"
+#include "result_cache.h"
+#include "plan_cache.h"
+#include "profile.h"
+#include "constants_table.h"
+#include "server.h"
+#include "replay.h"
+#include "context.h"
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+// A table that cannot be used only costs the time it would have saved
+static void load_constants_table(const char *path)
+{
+    if (path && constants_table_load(path) != 0)
+    {
+        fprintf(stderr, "Warning: %s; computing constants instead\n", constants_table_get_error());
+    }
+}
+
+// SIGINT and SIGTERM end server mode cleanly
+static void stop_server(int signal)
+{
+    (void)signal;
+    server_stop();
+}
+
+// Serve requests with the settings given on the command line
+static int run_server(const char *address, int jobs)
+{
+    if (!jobs)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = processors < 1 ? 1 : processors > BATCH_MAX_JOBS ? BATCH_MAX_JOBS : (int)processors;
+    }
+
+    EvalContext *ctx = eval_context_default();
+    EvalContext settings;
+    eval_context_init(&settings, ctx->precision);
+    settings.rounding = ctx->rounding;
+    settings.strict_mode = ctx->strict_mode;
+    settings.strict_domain = ctx->strict_domain;
+    settings.adaptive = ctx->adaptive;
+    settings.interval = ctx->interval;
+    settings.native = ctx->native;
+    settings.exact = ctx->exact;
+    settings.budget = ctx->budget;
+    settings.format = formatter_get_settings();
+
+    struct sigaction stop;
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = stop_server;
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    fprintf(stderr, "Serving on %s with %d worker%s\n", address, jobs, jobs == 1 ? "" : "s");
+    int status = server_run(&settings, address, jobs);
+    if (status != 0)
+    {
+        fprintf(stderr, "Server error: %s\n", server_get_error());
+    }
+    eval_context_cleanup(&settings);
+    return status == 0 ? 0 : 1;
+}
 
 int main(int argc, char *argv[])
 {
     // Parse command line arguments
     int show_help = 0;
     int set_precision_arg = 0;
+    int batch_mode = 0;
+    const char *batch_path = NULL;
+    int batch_jobs = 0;
+    int batch_sharded = 0;
+    const char *checkpoint_path = NULL;
+    int profile = 0;
+    const char *constants_path = NULL;
+    const char *export_path = NULL;
+    const char *serve_address = NULL;
+    const char *replay_path = NULL;
+    int replay_json = 0;
+    int preview = 0;
     mpfr_prec_t initial_precision = DEFAULT_PRECISION;
 
     for (int i = 1; i < argc; i++)
@@ -50,6 +130,252 @@ int main(int argc, char *argv[])
         {
             formatter_set_default_mode(FORMAT_SMART);
         }
+        else if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--batch") == 0)
+        {
+            batch_mode = 1;
+            // Optional input file; "-" or no argument reads standard input
+            if (i + 1 < argc && (argv[i + 1][0] != '-' || strcmp(argv[i + 1], "-") == 0))
+            {
+                batch_path = argv[++i];
+            }
+        }
+        else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                long jobs = strtol(argv[i + 1], NULL, 10);
+                if (jobs > 0)
+                {
+                    batch_jobs = jobs > BATCH_MAX_JOBS ? BATCH_MAX_JOBS : (int)jobs;
+                    i++; // Skip the next argument
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid job count: %s\n", argv[i + 1]);
+                    return 1;
+                }
+            }
+            else
+            {
+                fprintf(stderr, "Option %s requires an argument\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--cache") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                long kib = strtol(argv[i + 1], NULL, 10);
+                if (kib > 0)
+                {
+                    result_cache_set_capacity((size_t)kib * 1024);
+                    i++; // Skip the next argument
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid cache size: %s\n", argv[i + 1]);
+                    return 1;
+                }
+            }
+            else
+            {
+                fprintf(stderr, "Option %s requires an argument\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--plan-cache") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                char *end;
+                long kib = strtol(argv[i + 1], &end, 10);
+                if (kib >= 0 && *end == '\0' && end != argv[i + 1])
+                {
+                    plan_cache_set_capacity((size_t)kib * 1024);
+                    i++; // Skip the next argument
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid plan cache size: %s\n", argv[i + 1]);
+                    return 1;
+                }
+            }
+            else
+            {
+                fprintf(stderr, "Option %s requires an argument\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--timeout") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                double seconds = strtod(argv[i + 1], NULL);
+                if (seconds > 0)
+                {
+                    EvalBudget budget = evaluator_get_budget();
+                    budget.seconds = seconds;
+                    evaluator_set_budget(&budget);
+                    i++; // Skip the next argument
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid timeout: %s\n", argv[i + 1]);
+                    return 1;
+                }
+            }
+            else
+            {
+                fprintf(stderr, "Option %s requires an argument\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--serve") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                serve_address = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Option %s requires an argument\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--replay") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                replay_path = argv[++i];
+            }
+            else
+            {
+                fprintf(stderr, "Option %s requires an argument\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--shard") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                int index, count;
+                char extra;
+                if (sscanf(argv[i + 1], "%d/%d%c", &index, &count, &extra) == 2 &&
+                    batch_set_shard(index, count) == 0)
+                {
+                    batch_sharded = 1;
+                    i++; // Skip the next argument
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid shard: %s (use i/N with 0 <= i < N)\n", argv[i + 1]);
+                    return 1;
+                }
+            }
+            else
+            {
+                fprintf(stderr, "Option %s requires an argument\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--checkpoint") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                checkpoint_path = argv[++i];
+                batch_set_checkpoint(checkpoint_path);
+            }
+            else
+            {
+                fprintf(stderr, "Option %s requires an argument\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--json") == 0)
+        {
+            replay_json = 1;
+        }
+        else if (strcmp(argv[i], "--huge") == 0)
+        {
+            commands_set_huge(1);
+        }
+        else if (strcmp(argv[i], "--memory-limit") == 0)
+        {
+            if (i + 1 < argc)
+            {
+                long mib = strtol(argv[i + 1], NULL, 10);
+                if (mib > 0)
+                {
+                    precision_set_memory_limit((size_t)mib << 20);
+                    i++; // Skip the next argument
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid memory limit: %s\n", argv[i + 1]);
+                    return 1;
+                }
+            }
+            else
+            {
+                fprintf(stderr, "Option %s requires an argument\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--output=", 9) == 0)
+        {
+            const char *output = argv[i] + 9;
+            if (strcmp(output, "binary") == 0)
+            {
+                batch_set_output(BATCH_OUTPUT_BINARY);
+            }
+            else if (strcmp(output, "text") == 0)
+            {
+                batch_set_output(BATCH_OUTPUT_TEXT);
+            }
+            else
+            {
+                fprintf(stderr, "Invalid output format: %s (use 'text' or 'binary')\n", output);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--constants=", 12) == 0)
+        {
+            constants_path = argv[i] + 12;
+        }
+        else if (strncmp(argv[i], "--export-constants=", 19) == 0)
+        {
+            export_path = argv[i] + 19;
+        }
+        else if (strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--adaptive") == 0)
+        {
+            evaluator_set_adaptive(1);
+        }
+        else if (strcmp(argv[i], "--interval") == 0)
+        {
+            evaluator_set_interval(1);
+        }
+        else if (strcmp(argv[i], "--preview") == 0)
+        {
+            preview = 1;
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            if (!profile_available())
+            {
+                fprintf(stderr, "Option --profile is not available in this build\n");
+                return 1;
+            }
+            profile = 1;
+            profile_set_enabled(1);
+        }
+        else if (strcmp(argv[i], "--no-native") == 0)
+        {
+            evaluator_set_native(0);
+        }
+        else if (strcmp(argv[i], "--no-exact") == 0)
+        {
+            evaluator_set_exact(0);
+        }
         else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--version") == 0)
         {
             printf("High-Precision Calculator v1.0\n");
@@ -72,11 +398,46 @@ int main(int argc, char *argv[])
         printf("Options:\n");
         printf("  -h, --help              Show this help message\n");
         printf("  -v, --version           Show version information\n");
-        printf("  -p, --precision <bits>  Set initial precision (53-8192 bits)\n");
+        printf("  -p, --precision <bits>  Set initial precision (53-%d bits)\n", MAX_PRECISION);
+        printf("  -t, --timeout <seconds> Stop any evaluation that runs longer\n");
+        printf("      --huge              Allow up to %ld bits, reporting progress on stderr\n",
+               (long)HUGE_MAX_PRECISION);
+        printf("      --memory-limit <MiB>\n");
+        printf("                          Refuse huge evaluations needing more memory\n");
+        printf("  -b, --batch [file]      Evaluate one expression per line from file or stdin\n");
+        printf("  -j, --jobs <n>          Evaluate batch input or requests on n worker threads\n");
+        printf("      --serve <socket>    Answer requests on a Unix socket or [host]:port\n");
+        printf("      --output=binary     Write batch results as exact binary records\n");
+        printf("      --shard <i/N>       Evaluate only batch lines whose number is i modulo N\n");
+        printf("      --checkpoint <file> Save batch progress to file and resume from it;\n");
+        printf("                          the output must be a file (append with >>)\n");
+        printf("      --replay <file>     Replay a history file and report line latencies\n");
+        printf("      --json              Write the replay report as JSON\n");
+        printf("  -c, --cache <KiB>       Cache results of repeated expressions\n");
+        printf("      --plan-cache <KiB>  Cache parsed input lines (default %d, 0 to disable)\n",
+               PLAN_CACHE_DEFAULT_CAPACITY / 1024);
+        printf("      --constants=<file>  Read precomputed constants from a table file\n");
+        printf("      --export-constants=<file>\n");
+        printf("                          Write a constants table (%d bits) and exit\n",
+               CONSTANTS_TABLE_DEFAULT_PRECISION);
+        printf("  -a, --adaptive          Use adaptive precision for correctly rounded results\n");
+        printf("      --interval          Evaluate with interval arithmetic and certified digits\n");
+        printf("      --preview           Show the value of each line as you type it\n");
+        printf("      --no-native         Use MPFR even at hardware precision (<= %d bits)\n",
+               MULTIDOUBLE_QD_MAX_PRECISION);
+        printf("      --no-exact          Use floating point for integer and rational arithmetic\n");
+        printf("      --profile           Print phase timings and counters to stderr at exit\n");
         printf("\nExamples:\n");
         printf("  %s                      # Start with default precision\n", argv[0]);
         printf("  %s -p 256              # Start with 256-bit precision\n", argv[0]);
         printf("  %s --precision 512     # Start with 512-bit precision\n", argv[0]);
+        printf("  %s --batch exprs.txt   # Print one result per input line\n", argv[0]);
+        printf("  %s -b exprs.txt -j 8   # Same, using 8 threads\n", argv[0]);
+        printf("  %s -b exprs.txt --shard 2/16 --checkpoint s2.ckpt >> s2.out\n", argv[0]);
+        printf("                          # Shard 2 of 16, resuming after a restart\n");
+        printf("  %s --serve :7070       # Serve requests on localhost port 7070\n", argv[0]);
+        printf("  %s --replay .calculator_history --json\n", argv[0]);
+        printf("                          # Time a captured session against this build\n");
         printf("\nSupported Features:\n");
         printf("  • Arbitrary precision arithmetic using MPFR\n");
         printf("  • Mathematical functions (sin, cos, tan, sqrt, log, etc.)\n");
@@ -97,6 +458,108 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    if (batch_jobs && !batch_mode && !serve_address)
+    {
+        fprintf(stderr, "Option --jobs requires --batch or --serve\n");
+        return 1;
+    }
+    if (batch_mode && serve_address)
+    {
+        fprintf(stderr, "Options --batch and --serve cannot be combined\n");
+        return 1;
+    }
+    if (batch_get_output() != BATCH_OUTPUT_TEXT && !batch_mode)
+    {
+        fprintf(stderr, "Option --output requires --batch\n");
+        return 1;
+    }
+    if ((batch_sharded || checkpoint_path) && !batch_mode)
+    {
+        fprintf(stderr, "Options --shard and --checkpoint require --batch\n");
+        return 1;
+    }
+    if (replay_path && (batch_mode || serve_address))
+    {
+        fprintf(stderr, "Option --replay cannot be combined with --batch or --serve\n");
+        return 1;
+    }
+    if (replay_json && !replay_path)
+    {
+        fprintf(stderr, "Option --json requires --replay\n");
+        return 1;
+    }
+    if (preview && (batch_mode || serve_address || replay_path || export_path))
+    {
+        fprintf(stderr, "Option --preview is for interactive sessions only\n");
+        return 1;
+    }
+
+    if (export_path)
+    {
+        if (batch_init() != 0)
+        {
+            fprintf(stderr, "Failed to initialize calculator\n");
+            return 1;
+        }
+        int export_status = constants_table_export(export_path, CONSTANTS_TABLE_DEFAULT_PRECISION);
+        if (export_status == 0)
+        {
+            printf("Wrote constants table %s (%d bits)\n", export_path,
+                   CONSTANTS_TABLE_DEFAULT_PRECISION);
+        }
+        else
+        {
+            fprintf(stderr, "%s\n", constants_table_get_error());
+        }
+        batch_cleanup();
+        return export_status == 0 ? 0 : 1;
+    }
+
+    if (serve_address)
+    {
+        if (batch_init() != 0)
+        {
+            fprintf(stderr, "Failed to initialize calculator\n");
+            return 1;
+        }
+        if (set_precision_arg)
+        {
+            set_precision(initial_precision);
+        }
+        load_constants_table(constants_path);
+        int serve_status = run_server(serve_address, batch_jobs);
+        if (profile)
+        {
+            profile_print(stderr);
+        }
+        batch_cleanup();
+        result_cache_cleanup();
+        return serve_status;
+    }
+
+    if (batch_mode)
+    {
+        // Exit status: 0 all lines ok, 1 some line failed, 2 I/O error
+        if (batch_init() != 0)
+        {
+            fprintf(stderr, "Failed to initialize calculator\n");
+            return BATCH_EXIT_IO_ERROR;
+        }
+        if (set_precision_arg)
+        {
+            set_precision(initial_precision);
+        }
+        load_constants_table(constants_path);
+        int batch_status = batch_run(batch_path, batch_jobs ? batch_jobs : 1);
+        if (profile)
+        {
+            profile_print(stderr);
+        }
+        batch_cleanup();
+        result_cache_cleanup();
+        return batch_status;
+    }
+
     // Initialize the REPL system
     if (repl_init() != 0)
     {
@@ -110,8 +573,35 @@ int main(int argc, char *argv[])
         set_precision(initial_precision);
     }
 
+    load_constants_table(constants_path);
+
+    if (replay_path)
+    {
+        int replay_status = replay_run(replay_path, stdout,
+                                       replay_json ? REPLAY_REPORT_JSON : REPLAY_REPORT_TEXT);
+        if (replay_status != 0)
+        {
+            fprintf(stderr, "Replay error: %s\n", replay_get_error());
+        }
+        if (profile)
+        {
+            profile_print(stderr);
+        }
+        repl_cleanup();
+        return replay_status == 0 ? 0 : 1;
+    }
+
+    if (preview && input_set_preview(1) != 0)
+    {
+        fprintf(stderr, "Warning: result previews need readline support\n");
+    }
+
     // Run the main REPL loop
     int exit_code = repl_run();
+    if (profile)
+    {
+        profile_print(stderr);
+    }
 
     // Cleanup
     repl_cleanup();
@@ -0,0 +1,604 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "preview.h"
+#include "commands.h"
+#include "context.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include "lexer.h"
+#include "parser.h"
+#include "precision.h"
+#include "profile.h"
+#include "variables.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Set to stop the evaluation of a line that changed or ended
+static atomic_int preview_cancel = 0;
+
+static pthread_mutex_t preview_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t preview_wake = PTHREAD_COND_INITIALIZER; // Work for the worker
+static pthread_cond_t preview_done = PTHREAD_COND_INITIALIZER; // Worker let go of the variables
+static pthread_t preview_thread;
+
+// Shared with the worker, guarded by preview_lock
+static int running = 0;
+static int stopping = 0;
+static int line_active = 0;
+static unsigned long line_number = 0;         // Bumped for every line begun
+static EvalContext line_settings;             // Settings the line began with
+static VariableTable *line_variables = NULL;  // Table of the thread that began it
+static int reading_variables = 0;             // The worker is copying line_variables
+static char *line_text = NULL;                // Latest text of the line
+static size_t line_capacity = 0;
+static unsigned long line_version = 0;        // Bumped for every new text
+static uint64_t line_changed = 0;             // When the text last changed (profile_now() ns)
+static unsigned long handled_version = 0;     // Last version the worker finished with
+static unsigned long result_version = 0;      // Version result_text previews, 0 if none
+static char result_text[PREVIEW_TEXT_SIZE];
+
+// Owned by the worker
+static EvalContext worker_ctx;
+static unsigned long worker_line = 0;           // Line worker_ctx was set up for
+static unsigned long worker_variables_line = 0; // Line worker_variables was copied for
+static VariableTable *worker_variables = NULL;
+static char *worker_text = NULL; // Version being previewed
+static size_t worker_capacity = 0;
+static PreviewTokens worker_tokens;    // Tokens of the last version lexed
+static PreviewTokens evaluated_tokens; // Tokens of the last version evaluated
+static int evaluated_valid = 0;
+static int evaluated_shown = 0;
+static char evaluated_text[PREVIEW_TEXT_SIZE];
+static ASTArena *worker_arena = NULL;
+static FormatBuffer worker_format;
+
+// Copy text into a growing buffer
+static int preview_store(char **buffer, size_t *capacity, const char *text, size_t length)
+{
+    if (length + 1 > *capacity)
+    {
+        size_t new_capacity = *capacity ? *capacity : 64;
+        while (new_capacity < length + 1)
+        {
+            new_capacity *= 2;
+        }
+        char *grown = realloc(*buffer, new_capacity);
+        if (!grown)
+        {
+            return 0;
+        }
+        *buffer = grown;
+        *capacity = new_capacity;
+    }
+    memcpy(*buffer, text, length);
+    (*buffer)[length] = '\0';
+    return 1;
+}
+
+static int preview_reserve_tokens(PreviewTokens *tokens, size_t needed)
+{
+    if (needed <= tokens->capacity)
+    {
+        return 1;
+    }
+    size_t new_capacity = tokens->capacity ? tokens->capacity * 2 : 32;
+    while (new_capacity < needed)
+    {
+        new_capacity *= 2;
+    }
+    Token *grown = realloc(tokens->tokens, new_capacity * sizeof(Token));
+    if (!grown)
+    {
+        return 0;
+    }
+    tokens->tokens = grown;
+    tokens->capacity = new_capacity;
+    return 1;
+}
+
+long preview_relex(PreviewTokens *tokens, const char *text)
+{
+    size_t length = strlen(text);
+    size_t same = 0;
+    size_t shorter = tokens->length < length ? tokens->length : length;
+    while (same < shorter && tokens->text[same] == text[same])
+    {
+        same++;
+    }
+    if (tokens->count > 0 && same == length && same == tokens->length)
+    {
+        return (long)tokens->count;
+    }
+
+    // A token the lexer decided before reaching the edit stays as it was
+    size_t kept = 0;
+    while (kept < tokens->count && tokens->tokens[kept].type != TOKEN_EOF &&
+           tokens->tokens[kept].offset + tokens->tokens[kept].length + LEXER_LOOKAHEAD <= same)
+    {
+        kept++;
+    }
+
+    if (!preview_store(&tokens->text, &tokens->text_capacity, text, length))
+    {
+        preview_tokens_free(tokens);
+        return -1;
+    }
+    tokens->length = length;
+    tokens->count = kept;
+
+    Lexer lexer;
+    lexer_init_length(&lexer, tokens->text, length);
+    if (kept > 0)
+    {
+        const Token *last = &tokens->tokens[kept - 1];
+        lexer_seek(&lexer, last->offset + last->length);
+    }
+    for (;;)
+    {
+        Token token = lexer_get_next_token(&lexer);
+        if (!preview_reserve_tokens(tokens, tokens->count + 1))
+        {
+            preview_tokens_free(tokens);
+            return -1;
+        }
+        tokens->tokens[tokens->count++] = token;
+        if (token.type == TOKEN_EOF)
+        {
+            return (long)kept;
+        }
+    }
+}
+
+void preview_tokens_free(PreviewTokens *tokens)
+{
+    free(tokens->text);
+    free(tokens->tokens);
+    memset(tokens, 0, sizeof(*tokens));
+}
+
+// Whether two lines lex to the same tokens, whatever their spacing
+static int preview_same_tokens(const PreviewTokens *a, const PreviewTokens *b)
+{
+    if (a->count != b->count)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < a->count; i++)
+    {
+        const Token *x = &a->tokens[i];
+        const Token *y = &b->tokens[i];
+        if (x->type != y->type || x->length != y->length ||
+            memcmp(a->text + x->offset, b->text + y->offset, x->length) != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int preview_copy_tokens(PreviewTokens *to, const PreviewTokens *from)
+{
+    if (!preview_store(&to->text, &to->text_capacity, from->text, from->length) ||
+        !preview_reserve_tokens(to, from->count))
+    {
+        return 0;
+    }
+    memcpy(to->tokens, from->tokens, from->count * sizeof(Token));
+    to->length = from->length;
+    to->count = from->count;
+    return 1;
+}
+
+// Set the worker up for a new line: its settings, a fresh variable copy
+// and no tokens evaluated yet
+static void preview_configure(const EvalContext *settings)
+{
+    eval_context_cleanup(&worker_ctx);
+    eval_context_init(&worker_ctx, settings->precision);
+    worker_ctx.rounding = settings->rounding;
+    worker_ctx.strict_mode = settings->strict_mode;
+    worker_ctx.strict_domain = settings->strict_domain;
+    worker_ctx.adaptive = settings->adaptive;
+    worker_ctx.native = settings->native;
+    worker_ctx.exact = settings->exact;
+    worker_ctx.interval = settings->interval;
+    worker_ctx.format = settings->format;
+    worker_ctx.budget = settings->budget;
+    if (worker_ctx.budget.seconds <= 0 || worker_ctx.budget.seconds > PREVIEW_TIME_LIMIT)
+    {
+        worker_ctx.budget.seconds = PREVIEW_TIME_LIMIT;
+    }
+    worker_ctx.cancel = &preview_cancel;
+
+    variables_destroy(worker_variables);
+    worker_variables = NULL;
+    worker_variables_line = 0;
+    evaluated_valid = 0;
+}
+
+// Copy the line's variable table on first use. The thread that began the
+// line leaves the table alone until preview_end_line(), which waits for
+// the copy to finish.
+static int preview_load_variables(void)
+{
+    if (worker_variables_line == worker_line)
+    {
+        return 1;
+    }
+
+    pthread_mutex_lock(&preview_lock);
+    int current = line_active && line_number == worker_line;
+    VariableTable *source = current ? line_variables : NULL;
+    reading_variables = source != NULL;
+    pthread_mutex_unlock(&preview_lock);
+    if (!current)
+    {
+        return 0;
+    }
+
+    worker_variables = source ? variables_copy(source) : NULL;
+
+    pthread_mutex_lock(&preview_lock);
+    reading_variables = 0;
+    pthread_cond_broadcast(&preview_done);
+    pthread_mutex_unlock(&preview_lock);
+
+    if (source && !worker_variables)
+    {
+        return 0;
+    }
+    worker_ctx.variables = worker_variables;
+    worker_variables_line = worker_line;
+    return 1;
+}
+
+// Parse and evaluate the tokens of the line. Returns 1 with the value's
+// text, 0 if the line has no preview.
+static int preview_evaluate(char *text, size_t size)
+{
+    const Token *tokens = worker_tokens.tokens;
+    size_t count = worker_tokens.count;
+
+    // Blank lines and lone numbers have nothing to show; commands are not
+    // expressions
+    int number = tokens[0].type == TOKEN_INT || tokens[0].type == TOKEN_FLOAT;
+    if (count < 2 || (count == 2 && number) || commands_is_command(worker_tokens.text))
+    {
+        return 0;
+    }
+
+    // Lines the REPL would reject as too long get no preview either
+    Lexer lexer;
+    lexer_init(&lexer, worker_tokens.text);
+    if (lexer_remaining_length(&lexer) == 0)
+    {
+        return 0;
+    }
+
+    // The parser reads the tokens; the lexer only supplies their text
+    lexer_seek(&lexer, worker_tokens.length);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_tokens(&parser, tokens, count);
+    parser_set_quiet(&parser, 1);
+    parser_set_precision(&parser, worker_ctx.precision);
+    if (parser_at_assignment(&parser))
+    {
+        // As in the REPL, only variables can be defined
+        if (parser.current_token.type != TOKEN_IDENTIFIER)
+        {
+            return 0;
+        }
+        parser_advance(&parser); // Name
+        parser_advance(&parser); // '='
+    }
+
+    ast_arena_reset(worker_arena);
+    parser_set_arena(&parser, worker_arena);
+    ASTNode *ast = parser_parse_expression(&parser);
+    if (!ast || parser_has_error(&parser) || parser.current_token.type != TOKEN_EOF ||
+        !preview_load_variables())
+    {
+        return 0;
+    }
+
+    mpfr_t value;
+    mpfr_init2(value, worker_ctx.precision);
+    evaluator_eval_ctx(&worker_ctx, value, ast);
+    int shown = eval_context_get_error(&worker_ctx) == NULL;
+    if (shown)
+    {
+        format_buffer_reset(&worker_format);
+        int is_integer = ast->type == NODE_NUMBER && ast->number.is_int;
+        shown = formatter_format_result_ctx(&worker_ctx, &worker_format, value, is_integer) &&
+                worker_format.length > 0;
+    }
+    if (shown)
+    {
+        // Longer values are cut; the line editor cuts them further to fit
+        size_t length = worker_format.length;
+        if (length >= size)
+        {
+            length = size - 4;
+            memcpy(text + length, "...", 4);
+        }
+        else
+        {
+            text[length] = '\0';
+        }
+        memcpy(text, worker_format.data, length);
+    }
+    mpfr_clear(value);
+    return shown;
+}
+
+// Preview a version of the line, reusing the last verdict if its tokens
+// did not change
+static int preview_compute(char *text, size_t size)
+{
+    if (preview_relex(&worker_tokens, worker_text) < 0)
+    {
+        evaluated_valid = 0;
+        return 0;
+    }
+    if (evaluated_valid && preview_same_tokens(&worker_tokens, &evaluated_tokens))
+    {
+        memcpy(text, evaluated_text, size < sizeof(evaluated_text) ? size : sizeof(evaluated_text));
+        return evaluated_shown;
+    }
+
+    int shown = preview_evaluate(text, size);
+
+    // An interrupted evaluation says nothing about the tokens
+    evaluated_valid = !atomic_load(&preview_cancel) &&
+                      preview_copy_tokens(&evaluated_tokens, &worker_tokens);
+    evaluated_shown = shown;
+    if (shown)
+    {
+        memcpy(evaluated_text, text, size < sizeof(evaluated_text) ? size : sizeof(evaluated_text));
+    }
+    return shown;
+}
+
+// Wait for work for at most a number of nanoseconds; preview_lock is held
+static void preview_wait_for(uint64_t ns)
+{
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += (time_t)(ns / 1000000000u);
+    until.tv_nsec += (long)(ns % 1000000000u);
+    if (until.tv_nsec >= 1000000000L)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&preview_wake, &preview_lock, &until);
+}
+
+static void *preview_worker(void *arg)
+{
+    (void)arg;
+    eval_context_init(&worker_ctx, DEFAULT_PRECISION);
+    worker_arena = ast_arena_create(0);
+    format_buffer_init(&worker_format);
+
+    pthread_mutex_lock(&preview_lock);
+    while (!stopping)
+    {
+        if (!line_active || handled_version == line_version)
+        {
+            pthread_cond_wait(&preview_wake, &preview_lock);
+            continue;
+        }
+
+        // Let typing pause before spending anything on the text
+        uint64_t now = profile_now();
+        uint64_t due = line_changed + (uint64_t)PREVIEW_DEBOUNCE_MS * 1000000u;
+        if (now < due)
+        {
+            preview_wait_for(due - now);
+            continue;
+        }
+
+        unsigned long version = line_version;
+        int new_line = worker_line != line_number;
+        EvalContext settings = {0};
+        if (new_line)
+        {
+            settings = line_settings;
+            worker_line = line_number;
+        }
+        size_t length = strlen(line_text);
+        int copied =
+            worker_arena && preview_store(&worker_text, &worker_capacity, line_text, length);
+        atomic_store(&preview_cancel, 0);
+        pthread_mutex_unlock(&preview_lock);
+
+        if (new_line)
+        {
+            preview_configure(&settings);
+        }
+        char text[PREVIEW_TEXT_SIZE];
+        int shown = copied && preview_compute(text, sizeof(text));
+
+        pthread_mutex_lock(&preview_lock);
+        if (version == line_version)
+        {
+            handled_version = version;
+            result_version = shown ? version : 0;
+            if (shown)
+            {
+                memcpy(result_text, text, sizeof(result_text));
+            }
+        }
+    }
+    pthread_mutex_unlock(&preview_lock);
+
+    preview_tokens_free(&worker_tokens);
+    preview_tokens_free(&evaluated_tokens);
+    evaluated_valid = 0;
+    free(worker_text);
+    worker_text = NULL;
+    worker_capacity = 0;
+    format_buffer_free(&worker_format);
+    ast_arena_destroy(worker_arena);
+    worker_arena = NULL;
+    eval_context_cleanup(&worker_ctx);
+    variables_destroy(worker_variables);
+    worker_variables = NULL;
+    worker_variables_line = 0;
+    worker_line = 0;
+    return NULL;
+}
+
+int preview_start(void)
+{
+    pthread_mutex_lock(&preview_lock);
+    if (running)
+    {
+        pthread_mutex_unlock(&preview_lock);
+        return 0;
+    }
+
+    // Signals stay with the thread running the line editor, which handles
+    // them; the worker starts with all of them blocked
+    sigset_t all, saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    stopping = 0;
+    running = pthread_create(&preview_thread, NULL, preview_worker, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    int started = running;
+    pthread_mutex_unlock(&preview_lock);
+    return started ? 0 : -1;
+}
+
+void preview_stop(void)
+{
+    pthread_mutex_lock(&preview_lock);
+    if (!running)
+    {
+        pthread_mutex_unlock(&preview_lock);
+        return;
+    }
+    stopping = 1;
+    line_active = 0;
+    line_variables = NULL;
+    atomic_store(&preview_cancel, 1);
+    pthread_cond_broadcast(&preview_wake);
+    pthread_mutex_unlock(&preview_lock);
+
+    pthread_join(preview_thread, NULL);
+
+    pthread_mutex_lock(&preview_lock);
+    running = 0;
+    stopping = 0;
+    free(line_text);
+    line_text = NULL;
+    line_capacity = 0;
+    result_version = 0;
+    pthread_mutex_unlock(&preview_lock);
+}
+
+int preview_running(void)
+{
+    pthread_mutex_lock(&preview_lock);
+    int result = running;
+    pthread_mutex_unlock(&preview_lock);
+    return result;
+}
+
+void preview_begin_line(void)
+{
+    EvalContext *ctx = eval_context_default();
+    FormatSettings format = formatter_get_settings();
+
+    pthread_mutex_lock(&preview_lock);
+    if (!running || !preview_store(&line_text, &line_capacity, "", 0))
+    {
+        pthread_mutex_unlock(&preview_lock);
+        return;
+    }
+    eval_context_init(&line_settings, ctx->precision);
+    line_settings.rounding = ctx->rounding;
+    line_settings.strict_mode = ctx->strict_mode;
+    line_settings.strict_domain = ctx->strict_domain;
+    line_settings.adaptive = ctx->adaptive;
+    line_settings.native = ctx->native;
+    line_settings.exact = ctx->exact;
+    line_settings.interval = ctx->interval;
+    line_settings.budget = ctx->budget;
+    line_settings.format = format;
+    line_variables = ctx->variables;
+    line_number++;
+    line_version++;
+    handled_version = line_version;
+    result_version = 0;
+    line_active = 1;
+    pthread_mutex_unlock(&preview_lock);
+}
+
+void preview_update(const char *line)
+{
+    if (!line)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&preview_lock);
+    if (line_active && strcmp(line_text, line) != 0 &&
+        preview_store(&line_text, &line_capacity, line, strlen(line)))
+    {
+        line_version++;
+        line_changed = profile_now();
+        atomic_store(&preview_cancel, 1);
+        pthread_cond_signal(&preview_wake);
+    }
+    pthread_mutex_unlock(&preview_lock);
+}
+
+unsigned long preview_get(char *text, size_t size)
+{
+    pthread_mutex_lock(&preview_lock);
+    unsigned long version = line_active && result_version == line_version ? result_version : 0;
+    if (version && text && size > 0)
+    {
+        size_t length = strlen(result_text);
+        if (length >= size)
+        {
+            length = size - 1;
+        }
+        memcpy(text, result_text, length);
+        text[length] = '\0';
+    }
+    pthread_mutex_unlock(&preview_lock);
+    return version;
+}
+
+int preview_pending(void)
+{
+    pthread_mutex_lock(&preview_lock);
+    int pending = line_active && handled_version != line_version;
+    pthread_mutex_unlock(&preview_lock);
+    return pending;
+}
+
+void preview_end_line(void)
+{
+    pthread_mutex_lock(&preview_lock);
+    line_active = 0;
+    atomic_store(&preview_cancel, 1);
+    while (reading_variables)
+    {
+        pthread_cond_wait(&preview_done, &preview_lock);
+    }
+    line_variables = NULL;
+    pthread_mutex_unlock(&preview_lock);
+}
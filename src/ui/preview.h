@@ -0,0 +1,122 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "tokens.h"
+#include <stddef.h>
+
+// Quiet time after the last edit before the line is evaluated
+#define PREVIEW_DEBOUNCE_MS 120
+
+// Longest a preview may evaluate, in seconds; a tighter budget set by the
+// user is kept
+#define PREVIEW_TIME_LIMIT 0.5
+
+// Bytes of preview text kept, enough for any terminal line
+#define PREVIEW_TEXT_SIZE 256
+
+/**
+ * Result preview of the line being typed
+ *
+ * The line editor hands every version of its buffer to preview_update(),
+ * which only copies it and wakes a worker thread, so keystrokes never wait
+ * for lexing, parsing or evaluation. Once typing pauses for
+ * PREVIEW_DEBOUNCE_MS, the worker re-lexes the changed end of the line,
+ * parses the tokens and evaluates them with the settings and variables
+ * the line started with; an edit cancels an evaluation under way. Lines
+ * whose tokens did not change keep their preview without a new parse.
+ *
+ * Commands, incomplete expressions and failed evaluations show no preview.
+ * An assignment previews the value of its right-hand side. The module
+ * keeps one worker and one line, like the REPL it serves.
+ */
+
+/**
+ * Tokens of a line, kept so the next version of it is only lexed from
+ * where it changed
+ */
+typedef struct
+{
+    char *text; // Copy of the line the tokens were lexed from
+    size_t length;
+    size_t text_capacity;
+    Token *tokens; // Ends with TOKEN_EOF
+    size_t count;
+    size_t capacity;
+} PreviewTokens;
+
+/**
+ * Lex a new version of a line, keeping the tokens the edit cannot change
+ * Tokens ending at least LEXER_LOOKAHEAD characters before the first
+ * changed character are kept; lexing resumes at the end of the last one.
+ * The result is the same as lexing the whole line.
+ * @param tokens Tokens of the previous version, zero-initialized at first
+ * @param text New version of the line
+ * @return Number of tokens kept, or -1 if out of memory (tokens are then
+ *         emptied)
+ */
+long preview_relex(PreviewTokens *tokens, const char *text);
+
+/**
+ * Free the tokens and text of a line
+ * @param tokens Tokens to free; left empty and reusable
+ */
+void preview_tokens_free(PreviewTokens *tokens);
+
+/**
+ * Start the worker thread
+ * @return 0 on success (or if already started), -1 on failure
+ */
+int preview_start(void);
+
+/**
+ * Stop the worker thread, cancelling any evaluation under way
+ */
+void preview_stop(void);
+
+/**
+ * Check whether the worker thread is running
+ * @return 1 if running, 0 otherwise
+ */
+int preview_running(void);
+
+/**
+ * Start previewing a new line
+ * Takes the calling thread's evaluation settings, display settings and
+ * variable table, which the caller must leave alone until
+ * preview_end_line().
+ */
+void preview_begin_line(void);
+
+/**
+ * Hand over the current text of the line
+ * Cheap enough to call on every keystroke: an unchanged line costs one
+ * comparison, a changed one a copy.
+ * @param line Current text of the line
+ */
+void preview_update(const char *line);
+
+/**
+ * Get the preview of the current text of the line
+ * @param text Buffer for the preview text, or NULL
+ * @param size Size of the buffer
+ * @return Nonzero number identifying the preview, or 0 if the current
+ *         text has none (yet)
+ */
+unsigned long preview_get(char *text, size_t size);
+
+/**
+ * Check whether the worker still owes the current text of the line a
+ * preview (or the verdict that it has none)
+ * @return 1 if a preview is still to come, 0 otherwise
+ */
+int preview_pending(void);
+
+/**
+ * Stop previewing the line
+ * Cancels the evaluation under way. Returns once the worker no longer
+ * reads the variable table taken by preview_begin_line(), without waiting
+ * for the evaluation to stop.
+ */
+void preview_end_line(void);
+
+#endif // PREVIEW_H
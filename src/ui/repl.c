@@ -1,20 +1,173 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "repl.h"
 #include "input.h"
 #include "commands.h"
 #include "lexer.h"
 #include "parser.h"
+#include "plan_cache.h"
 #include "evaluator.h"
 #include "formatter.h"
 #include "precision.h"
 #include "constants.h"
+#include "constants_table.h"
 #include "functions.h"
 #include "function_table.h"
+#include "result_cache.h"
+#include "variables.h"
+#include "context.h"
+#include "profile.h"
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 static char *repl_prompt = "> ";
 static int repl_echo = 0;
+static int repl_history = 1;
+
+// Node arena shared by every line; reset once a line is done with its AST
+static ASTArena *repl_arena = NULL;
+
+// Variables defined at the prompt, resolved through the default context
+static VariableTable *repl_variables = NULL;
+
+static void repl_release_ast(ASTNode *ast)
+{
+    ast_free(ast);
+    ast_arena_reset(repl_arena);
+}
+
+// Check that a parse succeeded and used the whole line, reporting why not
+static int repl_check_parse(Parser *parser, const ASTNode *ast)
+{
+    if (!ast || parser_has_error(parser))
+    {
+        printf("Parse error\n");
+        return 0;
+    }
+
+    if (parser->current_token.type == TOKEN_INVALID)
+    {
+        printf("Invalid token encountered\n");
+        return 0;
+    }
+
+    if (parser->current_token.type != TOKEN_EOF)
+    {
+        printf("Unexpected token at end: %s\n", token_type_str(parser->current_token.type));
+        return 0;
+    }
+
+    return 1;
+}
+
+// Ctrl-C during an evaluation stops that expression, not the session
+static void repl_interrupt(int signal)
+{
+    (void)signal;
+    evaluator_cancel();
+}
+
+// Evaluate a tree and print its value after a label
+static void repl_print_value(const char *label, const ASTNode *ast, int is_integer)
+{
+    mpfr_t result;
+    mpfr_init2(result, global_precision);
+    PROFILE_COUNT(PROFILE_MPFR_TEMPS, 1);
+
+    // Only while evaluating: line editing keeps its own Ctrl-C handling
+    struct sigaction interrupt, saved;
+    memset(&interrupt, 0, sizeof(interrupt));
+    interrupt.sa_handler = repl_interrupt;
+    sigemptyset(&interrupt.sa_mask);
+    sigaction(SIGINT, &interrupt, &saved);
+
+    PROFILE_START(eval_start);
+    evaluator_eval(result, ast);
+    PROFILE_PHASE(PROFILE_EVAL, eval_start);
+
+    sigaction(SIGINT, &saved, NULL);
+    evaluator_clear_cancel();
+
+    const char *eval_error = evaluator_get_last_error();
+    if (eval_error)
+    {
+        printf("Evaluation error: %s\n", eval_error);
+    }
+    else
+    {
+        PROFILE_START(format_start);
+        printf("%s= ", label);
+        formatter_fprint_result(stdout, result, is_integer);
+        printf("\n\n");
+        PROFILE_PHASE(PROFILE_FORMAT, format_start);
+    }
+
+    mpfr_clear(result);
+}
+
+// Define the variable named by the current token from the rest of the line
+static void repl_process_assignment(Parser *parser)
+{
+    Token token = parser->current_token;
+    if (token.type != TOKEN_IDENTIFIER)
+    {
+        printf("Cannot assign to built-in name: %.*s\n", (int)token.length,
+               lexer_token_text(parser->lexer, &token));
+        return;
+    }
+
+    // Identifiers are short, so the name always fits
+    char name[128];
+    snprintf(name, sizeof(name), "%.*s", (int)token.length,
+             lexer_token_text(parser->lexer, &token));
+    parser_advance(parser); // Name
+    parser_advance(parser); // '='
+
+    // The table keeps the definition, so it cannot live in the line's arena
+    parser_set_arena(parser, NULL);
+    const char *source = lexer_token_text(parser->lexer, &parser->current_token);
+    PROFILE_START(parse_start);
+    ASTNode *definition = parser_parse_expression(parser);
+    PROFILE_PHASE(PROFILE_PARSE, parse_start);
+    if (!repl_check_parse(parser, definition))
+    {
+        ast_free(definition);
+        return;
+    }
+
+    int index = variables_define(repl_variables, name, definition);
+    if (index < 0 ||
+        (parser->inexact_literals &&
+         variables_set_source(repl_variables, index, source, global_precision) < 0))
+    {
+        printf("Definition error: %s\n", variables_get_error(repl_variables));
+        return;
+    }
+
+    // Names defined later complete the definition; until then it has no value
+    const char *pending = variables_pending(repl_variables, index);
+    if (pending)
+    {
+        printf("%s is pending: %s is not defined yet\n\n", name, pending);
+        return;
+    }
+
+    ASTNode *reference = ast_create_variable(name);
+    if (!reference)
+    {
+        printf("Out of memory\n");
+        return;
+    }
+
+    char label[sizeof(name) + 1];
+    snprintf(label, sizeof(label), "%s ", name);
+    repl_print_value(label, reference, 0);
+    ast_free(reference);
+}
 
 int repl_init(void)
 {
@@ -97,7 +250,10 @@ ReplResult repl_process_line(const char *input)
         return REPL_CONTINUE;
     }
 
-    input_add_to_history(input);
+    if (repl_history)
+    {
+        input_add_to_history(input);
+    }
 
     if (commands_is_command(input))
     {
@@ -125,51 +281,68 @@ ReplResult repl_process_line(const char *input)
         return REPL_CONTINUE;
     }
 
-    Parser parser;
-    parser_init(&parser, &lexer);
-    ASTNode *ast = parser_parse_expression(&parser);
+    // Without an arena the parser falls back to heap-allocated nodes
+    if (!repl_arena)
+    {
+        repl_arena = ast_arena_create(0);
+    }
+    if (!repl_variables)
+    {
+        repl_variables = variables_create();
+        if (!repl_variables)
+        {
+            printf("Out of memory\n");
+            return REPL_CONTINUE;
+        }
+    }
+    eval_context_default()->variables = repl_variables;
+    PROFILE_COUNT(PROFILE_LINES, 1);
 
-    if (!ast || parser_has_error(&parser))
+    // A line parsed before skips the lexer and parser
+    const ASTNode *plan = plan_cache_lookup(input, global_precision, global_rounding);
+    if (plan)
     {
-        printf("Parse error\n");
-        ast_free(ast);
+        repl_print_value("", plan, plan->type == NODE_NUMBER && plan->number.is_int);
         return REPL_CONTINUE;
     }
 
-    if (parser.current_token.type == TOKEN_INVALID)
+    Parser parser;
+    parser_init(&parser, &lexer);
+    if (parser_at_assignment(&parser))
     {
-        printf("Invalid token encountered\n");
-        ast_free(ast);
+        repl_process_assignment(&parser);
         return REPL_CONTINUE;
     }
 
-    if (parser.current_token.type != TOKEN_EOF)
+    // A line that may be cached is parsed into an arena the cache can keep
+    ASTArena *arena = plan_cache_enabled() ? ast_arena_create(PLAN_CACHE_ARENA_BLOCK_SIZE) : NULL;
+    parser_set_arena(&parser, arena ? arena : repl_arena);
+    PROFILE_START(parse_start);
+    ASTNode *ast = parser_parse_expression(&parser);
+    PROFILE_PHASE(PROFILE_PARSE, parse_start);
+    if (!repl_check_parse(&parser, ast))
     {
-        printf("Unexpected token at end: %s\n",
-               token_type_str(parser.current_token.type));
-        ast_free(ast);
+        if (arena)
+        {
+            ast_arena_destroy(arena);
+        }
+        else
+        {
+            repl_release_ast(ast);
+        }
         return REPL_CONTINUE;
     }
 
-    mpfr_t result;
-    mpfr_init2(result, global_precision);
-    evaluator_eval(result, ast);
-
-    const char *eval_error = evaluator_get_last_error();
-    if (eval_error)
+    repl_print_value("", ast, ast->type == NODE_NUMBER && ast->number.is_int);
+    if (arena)
     {
-        printf("Evaluation error: %s\n", eval_error);
+        plan_cache_store(input, arena, ast, global_precision, global_rounding,
+                         parser.inexact_literals == 0);
     }
     else
     {
-        printf("= ");
-        formatter_print_result_with_mode(result,
-                                         ast->type == NODE_NUMBER && ast->number.is_int);
-        printf("\n");
+        repl_release_ast(ast);
     }
-
-    mpfr_clear(result);
-    ast_free(ast);
     return REPL_CONTINUE;
 }
 
@@ -186,6 +359,11 @@ void repl_set_echo(int echo)
     repl_echo = echo;
 }
 
+void repl_set_history(int record)
+{
+    repl_history = record;
+}
+
 void repl_add_history(const char *line)
 {
     input_add_to_history(line);
@@ -194,6 +372,16 @@ void repl_add_history(const char *line)
 void repl_cleanup(void)
 {
     input_cleanup();
+    ast_arena_destroy(repl_arena);
+    repl_arena = NULL;
+    eval_context_default()->variables = NULL;
+    variables_destroy(repl_variables);
+    repl_variables = NULL;
+    evaluator_cleanup();
+    formatter_cleanup();
+    result_cache_cleanup();
+    plan_cache_cleanup();
+    constants_table_unload();
     constants_cleanup();
     functions_cleanup();
     precision_cleanup();
@@ -39,6 +39,12 @@ void repl_set_prompt(const char *prompt);
  */
 void repl_set_echo(int echo);
 
+/**
+ * Choose whether processed lines are added to the command history
+ * @param record 1 to add them (the default), 0 to leave the history alone
+ */
+void repl_set_history(int record);
+
 /**
  * Add a line to command history
  * @param line Line to add to history
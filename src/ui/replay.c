@@ -0,0 +1,270 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "replay.h"
+#include "repl.h"
+#include "profile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char replay_error[256];
+
+// Set while a replay runs, so a replayed "replay" line cannot recurse
+static int replay_running = 0;
+
+// One of the slowest lines so far
+typedef struct
+{
+    uint64_t ns;
+    char *line;
+} ReplaySlow;
+
+// Latencies of a replay and its slowest lines, slowest first
+typedef struct
+{
+    uint64_t *latencies;
+    size_t count;
+    size_t capacity;
+    ReplaySlow slowest[REPLAY_SLOWEST];
+    int slowest_count;
+    uint64_t total;
+} ReplayStats;
+
+static int replay_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+uint64_t replay_percentile(const uint64_t *sorted, size_t count, double percentile)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    // The smallest latency at least percentile% of the lines do not exceed
+    size_t rank = (size_t)ceil(percentile / 100.0 * (double)count);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    return sorted[(rank > count ? count : rank) - 1];
+}
+
+// Record a line's latency; returns 0 if out of memory
+static int replay_record(ReplayStats *stats, const char *line, uint64_t ns)
+{
+    if (stats->count == stats->capacity)
+    {
+        size_t capacity = stats->capacity ? 2 * stats->capacity : 1024;
+        uint64_t *latencies = realloc(stats->latencies, capacity * sizeof(uint64_t));
+        if (!latencies)
+        {
+            return 0;
+        }
+        stats->latencies = latencies;
+        stats->capacity = capacity;
+    }
+    stats->latencies[stats->count++] = ns;
+    stats->total += ns;
+
+    // Insert into the slowest lines, dropping the fastest of them if full
+    int at = stats->slowest_count;
+    while (at > 0 && stats->slowest[at - 1].ns < ns)
+    {
+        at--;
+    }
+    if (at == REPLAY_SLOWEST)
+    {
+        return 1;
+    }
+    char *copy = strdup(line);
+    if (!copy)
+    {
+        return 0;
+    }
+    if (stats->slowest_count == REPLAY_SLOWEST)
+    {
+        free(stats->slowest[REPLAY_SLOWEST - 1].line);
+        stats->slowest_count--;
+    }
+    memmove(&stats->slowest[at + 1], &stats->slowest[at],
+            (size_t)(stats->slowest_count - at) * sizeof(ReplaySlow));
+    stats->slowest[at].ns = ns;
+    stats->slowest[at].line = copy;
+    stats->slowest_count++;
+    return 1;
+}
+
+// Write a string as a JSON string literal
+static void replay_write_json_string(FILE *out, const char *text)
+{
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fprintf(out, "\\%c", *c);
+        }
+        else if (*c < 0x20)
+        {
+            fprintf(out, "\\u%04x", *c);
+        }
+        else
+        {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void replay_write_report(FILE *out, const char *path, ReplayStats *stats,
+                                ReplayReport format)
+{
+    qsort(stats->latencies, stats->count, sizeof(uint64_t), replay_compare);
+    uint64_t p50 = replay_percentile(stats->latencies, stats->count, 50);
+    uint64_t p95 = replay_percentile(stats->latencies, stats->count, 95);
+    uint64_t p99 = replay_percentile(stats->latencies, stats->count, 99);
+    uint64_t max = stats->count ? stats->latencies[stats->count - 1] : 0;
+
+    if (format == REPLAY_REPORT_JSON)
+    {
+        fprintf(out, "{\n  \"file\": ");
+        replay_write_json_string(out, path);
+        fprintf(out, ",\n  \"lines\": %zu,\n  \"total_ns\": %llu,\n", stats->count,
+                (unsigned long long)stats->total);
+        fprintf(out, "  \"p50_ns\": %llu,\n  \"p95_ns\": %llu,\n  \"p99_ns\": %llu,\n",
+                (unsigned long long)p50, (unsigned long long)p95, (unsigned long long)p99);
+        fprintf(out, "  \"max_ns\": %llu,\n  \"slowest\": [", (unsigned long long)max);
+        for (int i = 0; i < stats->slowest_count; i++)
+        {
+            fprintf(out, "%s\n    {\"ns\": %llu, \"line\": ", i ? "," : "",
+                    (unsigned long long)stats->slowest[i].ns);
+            replay_write_json_string(out, stats->slowest[i].line);
+            fputc('}', out);
+        }
+        fprintf(out, "%s]\n}\n", stats->slowest_count ? "\n  " : "");
+        return;
+    }
+
+    fprintf(out, "Replayed %zu line%s from %s in %.3f s\n", stats->count,
+            stats->count == 1 ? "" : "s", path, (double)stats->total * 1e-9);
+    fprintf(out, "Latency: p50 %.1f us, p95 %.1f us, p99 %.1f us, max %.1f us\n", p50 * 1e-3,
+            p95 * 1e-3, p99 * 1e-3, max * 1e-3);
+    if (stats->slowest_count)
+    {
+        fprintf(out, "Slowest lines:\n");
+    }
+    for (int i = 0; i < stats->slowest_count; i++)
+    {
+        fprintf(out, "  %12.1f us  %s\n", stats->slowest[i].ns * 1e-3, stats->slowest[i].line);
+    }
+}
+
+// Feed every line of a file through the REPL, timing each one
+static int replay_lines(FILE *input, ReplayStats *stats)
+{
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t read;
+    int ok = 1;
+
+    while (ok && (read = getline(&line, &capacity, input)) != -1)
+    {
+        size_t length = (size_t)read;
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+        {
+            line[--length] = '\0';
+        }
+        if (length == 0 || line[0] == '#')
+        {
+            continue;
+        }
+
+        uint64_t start = profile_now();
+        repl_process_line(line);
+        fflush(stdout);
+        ok = replay_record(stats, line, profile_now() - start);
+    }
+
+    free(line);
+    if (!ok)
+    {
+        snprintf(replay_error, sizeof(replay_error), "Out of memory");
+    }
+    else if (ferror(input))
+    {
+        snprintf(replay_error, sizeof(replay_error), "Cannot read replay file: %s",
+                 strerror(errno));
+        ok = 0;
+    }
+    return ok;
+}
+
+int replay_run(const char *path, FILE *report, ReplayReport format)
+{
+    replay_error[0] = '\0';
+    if (replay_running)
+    {
+        snprintf(replay_error, sizeof(replay_error), "A replay cannot start another");
+        return -1;
+    }
+
+    FILE *input = fopen(path, "r");
+    if (!input)
+    {
+        snprintf(replay_error, sizeof(replay_error), "Cannot open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    // Results and messages of the replayed lines go nowhere
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    if (saved < 0 || null < 0 || dup2(null, STDOUT_FILENO) < 0)
+    {
+        snprintf(replay_error, sizeof(replay_error), "Cannot suppress output: %s",
+                 strerror(errno));
+        if (saved >= 0)
+            close(saved);
+        if (null >= 0)
+            close(null);
+        fclose(input);
+        return -1;
+    }
+    close(null);
+
+    ReplayStats stats = {0};
+    replay_running = 1;
+    repl_set_history(0);
+    int ok = replay_lines(input, &stats);
+    repl_set_history(1);
+    replay_running = 0;
+
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    fclose(input);
+
+    if (ok)
+    {
+        replay_write_report(report, path, &stats, format);
+    }
+    for (int i = 0; i < stats.slowest_count; i++)
+    {
+        free(stats.slowest[i].line);
+    }
+    free(stats.latencies);
+    return ok ? 0 : -1;
+}
+
+const char *replay_get_error(void)
+{
+    return replay_error;
+}
@@ -0,0 +1,54 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Slowest lines a replay report lists
+#define REPLAY_SLOWEST 10
+
+// How a replay report is written
+typedef enum
+{
+    REPLAY_REPORT_TEXT, // Lines for a person to read
+    REPLAY_REPORT_JSON  // One JSON object
+} ReplayReport;
+
+/**
+ * Replay a captured session and report how long each line took
+ *
+ * Every line of the file, such as a history file written by
+ * input_save_history(), goes through repl_process_line() as if typed at
+ * the prompt, with standard output suppressed and without being added to
+ * the history. Commands run too, so precision and mode changes apply to
+ * the lines after them as they did in the session; quit and exit lines
+ * are timed but do not end the replay. Blank lines and history timestamp
+ * lines (starting with '#') are skipped.
+ *
+ * The report gives the number of lines, the total time, the 50th, 95th
+ * and 99th percentile and maximum latency, and the REPLAY_SLOWEST slowest
+ * lines.
+ *
+ * @param path File to replay
+ * @param report Stream the report is written to
+ * @param format How the report is written
+ * @return 0 on success, -1 on error (see replay_get_error())
+ */
+int replay_run(const char *path, FILE *report, ReplayReport format);
+
+/**
+ * Get the latency at a percentile, by the nearest-rank method
+ * @param sorted Latencies in ascending order
+ * @param count Number of latencies
+ * @param percentile Percentile, from 0 to 100
+ * @return Latency, or 0 if there are none
+ */
+uint64_t replay_percentile(const uint64_t *sorted, size_t count, double percentile);
+
+/**
+ * Get the message of the last replay error
+ * @return Error message, empty if none
+ */
+const char *replay_get_error(void);
+
+#endif // REPLAY_H
@@ -0,0 +1,600 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "server.h"
+#include "batch.h"
+#include "context.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include "lexer.h"
+#include "parser.h"
+#include "precision.h"
+#include "profile.h"
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Bytes read from a connection at a time
+#define SERVER_READ_SIZE 65536
+
+// Listening socket, kept where server_stop() can reach it from a handler
+static atomic_int server_listen_fd = -1;
+static atomic_int server_stopping = 0;
+
+static char server_error[256];
+
+// Connections accepted by the main thread and taken by the workers
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int pending[SERVER_BACKLOG];
+    int pending_head;
+    int pending_count;
+    int *active; // Connection each worker is serving, -1 if none
+    int done;    // No more connections will come
+    const EvalContext *settings;
+} ServerPool;
+
+// One worker's evaluation state, reused for every request it serves
+typedef struct
+{
+    EvalContext ctx;
+    ASTArena *arena;
+    FormatBuffer response;
+    mpfr_t result;
+    const EvalContext *settings;
+} ServerWorker;
+
+typedef struct
+{
+    ServerPool *pool;
+    int index;
+} ServerWorkerArg;
+
+// Back to the server's settings, so no request leaks into the next
+static void server_reset_context(ServerWorker *worker)
+{
+    const EvalContext *settings = worker->settings;
+    eval_context_set_precision(&worker->ctx, settings->precision);
+    worker->ctx.rounding = settings->rounding;
+    worker->ctx.strict_mode = settings->strict_mode;
+    worker->ctx.strict_domain = settings->strict_domain;
+    worker->ctx.adaptive = settings->adaptive;
+    worker->ctx.interval = settings->interval;
+    worker->ctx.native = settings->native;
+    worker->ctx.exact = settings->exact;
+    worker->ctx.budget = settings->budget;
+    worker->ctx.format = settings->format;
+}
+
+static void server_append_error(FormatBuffer *response, const char *message)
+{
+    format_buffer_append(response, "error: ", 7);
+    format_buffer_append(response, message, strlen(message));
+    format_buffer_append_char(response, '\n');
+}
+
+// Apply one "@name=value" option. Returns 0 with the reason in message
+// if it is not understood or its value is out of range.
+static int server_apply_option(EvalContext *ctx, const char *option, size_t length,
+                               char *message, size_t size)
+{
+    char text[64];
+    int shown = length > 64 ? 64 : (int)length;
+    snprintf(message, size, "Unknown option: %.*s", shown, option);
+    if (length >= sizeof(text))
+    {
+        return 0;
+    }
+    memcpy(text, option, length);
+    text[length] = '\0';
+
+    if (strncmp(text, "@precision=", 11) == 0)
+    {
+        char *end;
+        errno = 0;
+        long bits = strtol(text + 11, &end, 10);
+        if (end == text + 11 || *end != '\0')
+        {
+            return 0;
+        }
+        // Clamping would answer at a precision the client did not ask for
+        if (errno == ERANGE || bits < MIN_PRECISION || bits > (long)precision_max())
+        {
+            snprintf(message, size, "Precision must be between %d and %ld bits: %s",
+                     MIN_PRECISION, (long)precision_max(), text + 11);
+            return 0;
+        }
+        eval_context_set_precision(ctx, (mpfr_prec_t)bits);
+        return 1;
+    }
+    if (strcmp(text, "@format=smart") == 0)
+        ctx->format.mode = FORMAT_SMART;
+    else if (strcmp(text, "@format=scientific") == 0)
+        ctx->format.mode = FORMAT_SCIENTIFIC;
+    else if (strcmp(text, "@format=fixed") == 0)
+        ctx->format.mode = FORMAT_FIXED;
+    else
+        return 0;
+    return 1;
+}
+
+// Evaluate one request line and append its response line
+static void server_process_request(ServerWorker *worker, const char *line, size_t length)
+{
+    FormatBuffer *response = &worker->response;
+    EvalContext *ctx = &worker->ctx;
+    server_reset_context(worker);
+
+    // Leading options, each a word starting with '@'
+    size_t start = 0;
+    for (;;)
+    {
+        while (start < length && (line[start] == ' ' || line[start] == '\t'))
+        {
+            start++;
+        }
+        if (start == length || line[start] != '@')
+        {
+            break;
+        }
+        size_t end = start;
+        while (end < length && line[end] != ' ' && line[end] != '\t')
+        {
+            end++;
+        }
+        char message[128];
+        if (!server_apply_option(ctx, line + start, end - start, message, sizeof(message)))
+        {
+            server_append_error(response, message);
+            return;
+        }
+        start = end;
+    }
+
+    if (start == length)
+    {
+        format_buffer_append_char(response, '\n');
+        return;
+    }
+    if (memchr(line + start, '\0', length - start))
+    {
+        server_append_error(response, "Input contains a NUL byte");
+        return;
+    }
+
+    PROFILE_COUNT(PROFILE_LINES, 1);
+    PROFILE_START(parse_start);
+    Lexer lexer;
+    lexer_init_length(&lexer, line + start, length - start);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_arena(&parser, worker->arena);
+    parser_set_quiet(&parser, 1);
+    parser_set_precision(&parser, ctx->precision);
+    ASTNode *ast = parser_parse_expression(&parser);
+    PROFILE_PHASE(PROFILE_PARSE, parse_start);
+
+    if (!ast || parser_has_error(&parser))
+    {
+        const char *message = parser_get_error_message(&parser);
+        server_append_error(response, message ? message : "Parse error");
+    }
+    else if (parser.current_token.type == TOKEN_INVALID)
+    {
+        server_append_error(response, "Invalid token encountered");
+    }
+    else if (parser.current_token.type != TOKEN_EOF)
+    {
+        char message[128];
+        snprintf(message, sizeof(message), "Unexpected token at end: %s",
+                 token_type_str(parser.current_token.type));
+        server_append_error(response, message);
+    }
+    else
+    {
+        mpfr_set_prec(worker->result, ctx->precision);
+        PROFILE_START(eval_start);
+        evaluator_eval_ctx(ctx, worker->result, ast);
+        PROFILE_PHASE(PROFILE_EVAL, eval_start);
+
+        const char *error = eval_context_get_error(ctx);
+        if (error)
+        {
+            server_append_error(response, error);
+        }
+        else
+        {
+            PROFILE_START(format_start);
+            formatter_format_result_ctx(ctx, response, worker->result,
+                                       ast->type == NODE_NUMBER && ast->number.is_int);
+            format_buffer_append_char(response, '\n');
+            PROFILE_PHASE(PROFILE_FORMAT, format_start);
+        }
+    }
+
+    token_free(&parser.previous_token);
+    token_free(&parser.current_token);
+    ast_free(ast);
+    ast_arena_reset(worker->arena);
+}
+
+// Write all of a buffer to a socket. Returns 0 if the client went away.
+static int server_write_all(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return 0;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 1;
+}
+
+// Answer requests on a connection until the client hangs up. Every read
+// may bring many requests; their responses go back in a single write.
+static void server_serve_connection(ServerWorker *worker, int fd)
+{
+    char *input = malloc(SERVER_READ_SIZE);
+    size_t capacity = SERVER_READ_SIZE;
+    size_t length = 0;
+    int open = input != NULL;
+
+    while (open)
+    {
+        if (length == capacity)
+        {
+            char *grown = capacity < SERVER_MAX_REQUEST ? realloc(input, 2 * capacity) : NULL;
+            if (!grown)
+            {
+                break; // Request too long or out of memory
+            }
+            input = grown;
+            capacity *= 2;
+        }
+
+        ssize_t received = read(fd, input + length, capacity - length);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            break;
+        }
+        length += (size_t)received;
+
+        // Answer every complete line, keeping a partial one for the next read
+        format_buffer_reset(&worker->response);
+        size_t consumed = 0;
+        char *newline;
+        while ((newline = memchr(input + consumed, '\n', length - consumed)) != NULL)
+        {
+            size_t line_length = (size_t)(newline - (input + consumed));
+            if (line_length > 0 && input[consumed + line_length - 1] == '\r')
+            {
+                line_length--;
+            }
+            server_process_request(worker, input + consumed, line_length);
+            consumed = (size_t)(newline - input) + 1;
+        }
+        memmove(input, input + consumed, length - consumed);
+        length -= consumed;
+
+        if (worker->response.failed ||
+            !server_write_all(fd, worker->response.data ? worker->response.data : "",
+                              worker->response.length))
+        {
+            open = 0;
+        }
+    }
+
+    free(input);
+}
+
+static void *server_worker(void *arg)
+{
+    ServerWorkerArg *worker_arg = arg;
+    ServerPool *pool = worker_arg->pool;
+
+    ServerWorker worker;
+    worker.settings = pool->settings;
+    eval_context_init(&worker.ctx, pool->settings->precision);
+    worker.arena = ast_arena_create(0);
+    format_buffer_init(&worker.response);
+    mpfr_init2(worker.result, pool->settings->precision);
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (pool->pending_count == 0 && !pool->done)
+        {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+        if (pool->pending_count == 0)
+        {
+            break;
+        }
+        int fd = pool->pending[pool->pending_head];
+        pool->pending_head = (pool->pending_head + 1) % SERVER_BACKLOG;
+        pool->pending_count--;
+        pool->active[worker_arg->index] = fd;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (worker.arena)
+        {
+            server_serve_connection(&worker, fd);
+        }
+
+        // Closed under the lock, so the main thread never shuts down a
+        // descriptor that was reused
+        pthread_mutex_lock(&pool->lock);
+        pool->active[worker_arg->index] = -1;
+        close(fd);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    mpfr_clear(worker.result);
+    format_buffer_free(&worker.response);
+    ast_arena_destroy(worker.arena);
+    eval_context_cleanup(&worker.ctx);
+    formatter_cleanup();
+    evaluator_cleanup();
+    profile_merge_thread();
+    mpfr_free_cache();
+    return NULL;
+}
+
+// Create the listening socket for an address, or return -1
+static int server_listen(const char *address, int *is_unix)
+{
+    const char *colon = strrchr(address, ':');
+    *is_unix = !colon || strchr(address, '/') != NULL;
+
+    if (*is_unix)
+    {
+        struct sockaddr_un local;
+        if (strlen(address) >= sizeof(local.sun_path))
+        {
+            snprintf(server_error, sizeof(server_error), "Socket path too long: %s", address);
+            return -1;
+        }
+
+        // A socket left behind by an earlier run is replaced; other files are not
+        struct stat info;
+        if (stat(address, &info) == 0 && S_ISSOCK(info.st_mode))
+        {
+            unlink(address);
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        strcpy(local.sun_path, address);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0 ||
+            listen(fd, SERVER_BACKLOG) != 0)
+        {
+            snprintf(server_error, sizeof(server_error), "Cannot listen on %s: %s", address,
+                     strerror(errno));
+            if (fd >= 0)
+                close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    char host[256];
+    size_t host_length = (size_t)(colon - address);
+    if (host_length >= sizeof(host))
+    {
+        snprintf(server_error, sizeof(server_error), "Host name too long: %s", address);
+        return -1;
+    }
+    memcpy(host, address, host_length);
+    host[host_length] = '\0';
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *found = NULL;
+    int status = getaddrinfo(host_length ? host : "127.0.0.1", colon + 1, &hints, &found);
+    if (status != 0)
+    {
+        snprintf(server_error, sizeof(server_error), "Cannot resolve %s: %s", address,
+                 gai_strerror(status));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *candidate = found; candidate && fd < 0; candidate = candidate->ai_next)
+    {
+        fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(fd, candidate->ai_addr, candidate->ai_addrlen) != 0 ||
+            listen(fd, SERVER_BACKLOG) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0)
+    {
+        snprintf(server_error, sizeof(server_error), "Cannot listen on %s: %s", address,
+                 strerror(errno));
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+int server_run(const EvalContext *settings, const char *address, int jobs)
+{
+    server_error[0] = '\0';
+    if (jobs < 1 || jobs > BATCH_MAX_JOBS)
+    {
+        snprintf(server_error, sizeof(server_error), "Invalid number of workers: %d", jobs);
+        return -1;
+    }
+
+    int is_unix;
+    int listen_fd = server_listen(address, &is_unix);
+    if (listen_fd < 0)
+    {
+        return -1;
+    }
+
+    // A client hanging up must not take the server down
+    struct sigaction ignore, saved_pipe;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPIPE, &ignore, &saved_pipe);
+
+    ServerPool pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.settings = settings;
+    pool.active = malloc((size_t)jobs * sizeof(*pool.active));
+    pthread_t *threads = malloc((size_t)jobs * sizeof(*threads));
+    ServerWorkerArg *args = malloc((size_t)jobs * sizeof(*args));
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.changed, NULL);
+
+    int started = 0;
+    if (pool.active && threads && args)
+    {
+        for (int i = 0; i < jobs; i++)
+        {
+            pool.active[i] = -1;
+        }
+        while (started < jobs)
+        {
+            args[started].pool = &pool;
+            args[started].index = started;
+            if (pthread_create(&threads[started], NULL, server_worker, &args[started]) != 0)
+            {
+                break;
+            }
+            started++;
+        }
+    }
+
+    int status = 0;
+    if (started == 0)
+    {
+        snprintf(server_error, sizeof(server_error), "Cannot start worker threads");
+        status = -1;
+    }
+    else
+    {
+        atomic_store(&server_listen_fd, listen_fd);
+        while (!atomic_load(&server_stopping))
+        {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                if (!atomic_load(&server_stopping))
+                {
+                    snprintf(server_error, sizeof(server_error), "Cannot accept: %s",
+                             strerror(errno));
+                    status = -1;
+                }
+                break;
+            }
+
+            pthread_mutex_lock(&pool.lock);
+            if (pool.pending_count == SERVER_BACKLOG)
+            {
+                close(fd);
+            }
+            else
+            {
+                pool.pending[(pool.pending_head + pool.pending_count) % SERVER_BACKLOG] = fd;
+                pool.pending_count++;
+                pthread_cond_signal(&pool.changed);
+            }
+            pthread_mutex_unlock(&pool.lock);
+        }
+        atomic_store(&server_listen_fd, -1);
+    }
+
+    // Refuse what is still queued and wake the workers out of their reads
+    pthread_mutex_lock(&pool.lock);
+    pool.done = 1;
+    while (pool.pending_count > 0)
+    {
+        close(pool.pending[pool.pending_head]);
+        pool.pending_head = (pool.pending_head + 1) % SERVER_BACKLOG;
+        pool.pending_count--;
+    }
+    for (int i = 0; i < started; i++)
+    {
+        if (pool.active[i] >= 0)
+        {
+            shutdown(pool.active[i], SHUT_RDWR);
+        }
+    }
+    pthread_cond_broadcast(&pool.changed);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool.changed);
+    pthread_mutex_destroy(&pool.lock);
+    free(args);
+    free(threads);
+    free(pool.active);
+    close(listen_fd);
+    if (is_unix)
+    {
+        unlink(address);
+    }
+    sigaction(SIGPIPE, &saved_pipe, NULL);
+    atomic_store(&server_stopping, 0);
+    return status;
+}
+
+void server_stop(void)
+{
+    atomic_store(&server_stopping, 1);
+    int fd = atomic_load(&server_listen_fd);
+    if (fd >= 0)
+    {
+        shutdown(fd, SHUT_RDWR);
+    }
+}
+
+const char *server_get_error(void)
+{
+    return server_error[0] ? server_error : NULL;
+}
@@ -0,0 +1,60 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/*
+ * Long-running evaluation server
+ *
+ * Clients connect over a Unix socket or TCP and send one request per line;
+ * each request gets exactly one response line, in request order, so a
+ * client may pipeline any number of requests without waiting. A request is
+ * an expression, optionally preceded by options:
+ *
+ *     [@precision=<bits>] [@format=smart|scientific|fixed] <expression>
+ *
+ * Options apply to that request only; otherwise the settings the server
+ * was started with are used. A precision outside MIN_PRECISION to
+ * precision_max() is refused rather than clamped. The response is the value as batch mode
+ * prints it, "error: <message>" if the request failed, or an empty line for
+ * an empty request.
+ *
+ * Connections are served by a pool of worker threads, each with its own
+ * EvalContext, so constant caches and scratch pools stay warm across
+ * requests. Responses to the requests that arrived together are written
+ * back together.
+ */
+
+// Longest request line accepted; longer ones close the connection
+#define SERVER_MAX_REQUEST (1 << 20)
+
+// Connections waiting for a worker before new ones are refused
+#define SERVER_BACKLOG 64
+
+typedef struct EvalContext EvalContext;
+
+/**
+ * Serve requests until server_stop() is called
+ * An address containing a colon and no slash is TCP "host:port", with an
+ * empty host meaning the loopback interface; anything else is a Unix
+ * socket path, which is created (replacing a stale socket) and removed on
+ * return. SIGPIPE is ignored while serving.
+ * @param settings Context supplying precision, rounding, evaluator flags,
+ *                 budget and display settings (not modified)
+ * @param address Socket to listen on
+ * @param jobs Number of worker threads (1 to BATCH_MAX_JOBS)
+ * @return 0 after a clean stop, -1 on error (see server_get_error())
+ */
+int server_run(const EvalContext *settings, const char *address, int jobs);
+
+/**
+ * Make server_run() return once its workers have finished their current
+ * requests. Open connections are shut down. Async-signal-safe.
+ */
+void server_stop(void);
+
+/**
+ * Get the error message of the last failed server_run()
+ * @return Error message, or NULL if it succeeded
+ */
+const char *server_get_error(void);
+
+#endif // SERVER_H
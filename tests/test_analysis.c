@@ -0,0 +1,235 @@
+#include "analysis.h"
+#include "context.h"
+#include "evaluator.h"
+#include "variables.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Analyze an expression; 0 if it does not parse
+static int analysis_test_run(EvalContext *ctx, const char *input, Analysis *analysis)
+{
+    ASTNode *ast = test_parse(input);
+    if (!ast)
+    {
+        return 0;
+    }
+    analysis_run(ctx, ast, analysis);
+    ast_free(ast);
+    return 1;
+}
+
+static int test_analysis_domain(void)
+{
+    printf("Testing domain pre-checks...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    Analysis analysis;
+
+    TEST_ASSERT(analysis_test_run(&ctx, "asin(2)", &analysis), "asin(2) should parse");
+    TEST_ASSERT(analysis.domain_error, "asin(2) should be a certain domain error");
+    TEST_ASSERT(strstr(analysis.message, "asin domain error") != NULL,
+                "The message should be the one evaluation gives");
+
+    TEST_ASSERT(analysis_test_run(&ctx, "sqrt(1 - 3) + log(0.5)", &analysis), "Should parse");
+    TEST_ASSERT(analysis.domain_error && strstr(analysis.message, "sqrt") != NULL,
+                "A negative range should fail sqrt");
+
+    TEST_ASSERT(analysis_test_run(&ctx, "1/(2 - 2)", &analysis), "Should parse");
+    TEST_ASSERT(analysis.division_by_zero && !analysis.domain_error,
+                "An exact zero divisor should be found");
+
+    // Ranges that only may leave the domain prove nothing
+    TEST_ASSERT(analysis_test_run(&ctx, "asin(sin(1) + 0.1) + 1/(sin(pi))", &analysis),
+                "Should parse");
+    TEST_ASSERT(!analysis.domain_error && !analysis.division_by_zero && !analysis.message[0],
+                "Possible failures should not be flagged");
+    TEST_ASSERT(analysis_test_run(&ctx, "acos(cos(3)) + atanh(tanh(2))", &analysis),
+                "Should parse");
+    TEST_ASSERT(!analysis.domain_error, "Ranges inside the domain should pass");
+
+    // Variables are ranged by their definitions
+    VariableTable *table = variables_create();
+    ctx.variables = table;
+    TEST_ASSERT(variables_define(table, "x", test_parse("5")) >= 0, "x should be defined");
+    TEST_ASSERT(analysis_test_run(&ctx, "acosh(x - 10)", &analysis), "Should parse");
+    TEST_ASSERT(analysis.domain_error, "acosh below 1 should fail through a variable");
+    TEST_ASSERT(analysis_test_run(&ctx, "acosh(x) + log(y)", &analysis), "Should parse");
+    TEST_ASSERT(!analysis.domain_error, "Unknown variables prove nothing");
+
+    // The global check runs in the thread's default context
+    ASTNode *ast = test_parse("log10(-1)");
+    TEST_ASSERT(evaluator_check_domain(ast), "log10(-1) should fail the domain check");
+    ast_free(ast);
+    ast = test_parse("log10(2)");
+    TEST_ASSERT(!evaluator_check_domain(ast), "log10(2) should pass the domain check");
+    ast_free(ast);
+
+    ctx.variables = NULL;
+    variables_destroy(table);
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Domain pre-check tests passed\n");
+    return 1;
+}
+
+static int test_analysis_bounds(void)
+{
+    printf("Testing operation and exponent bounds...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    Analysis analysis;
+
+    TEST_ASSERT(analysis_test_run(&ctx, "1+2+3+4", &analysis), "Should parse");
+    TEST_ASSERT(analysis.operations == 3, "A sum of four terms takes three additions");
+
+    TEST_ASSERT(analysis_test_run(&ctx, "sin(1) * 2", &analysis), "Should parse");
+    TEST_ASSERT(analysis.operations == 2 && analysis.exponent == 0,
+                "Ordinary values reach no large exponent");
+
+    TEST_ASSERT(analysis_test_run(&ctx, "2^2000 - 2^2000", &analysis), "Should parse");
+    TEST_ASSERT(analysis.exponent >= 2000 && analysis.exponent <= 2001,
+                "2^2000 should be found before it is computed");
+
+    TEST_ASSERT(analysis_test_run(&ctx, "exp(-3000)", &analysis), "Should parse");
+    TEST_ASSERT(analysis.exponent >= 4300, "Tiny values count as well");
+
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Operation and exponent bound tests passed\n");
+    return 1;
+}
+
+static double analysis_test_cost(EvalContext *ctx, const char *input)
+{
+    ASTNode *ast = test_parse(input);
+    double cost = ast ? analysis_estimate_cost(ctx, ast) : -1;
+    ast_free(ast);
+    return cost;
+}
+
+static int test_analysis_cost(void)
+{
+    printf("Testing cost estimates...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+
+    double add = analysis_test_cost(&ctx, "1 + 2");
+    double mul = analysis_test_cost(&ctx, "3 * 7");
+    double sin = analysis_test_cost(&ctx, "sin(3)");
+    TEST_ASSERT(add > 0 && add < mul && mul < sin,
+                "Functions should cost more than products, products more than sums");
+    TEST_ASSERT(analysis_test_cost(&ctx, "sin(3) + sin(4)") > 2 * sin,
+                "Costs should add up over the tree");
+    TEST_ASSERT(analysis_test_cost(&ctx, "pi") == 0, "Cached constants should cost nothing");
+
+    eval_context_set_precision(&ctx, 8192);
+    double precise = analysis_test_cost(&ctx, "sin(3)");
+    TEST_ASSERT(precise > 32 * sin, "Cost should grow faster than the precision");
+
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Cost estimate tests passed\n");
+    return 1;
+}
+
+// Evaluate, copying the error into error; 0 if the input does not parse
+static int analysis_test_error(EvalContext *ctx, const char *input, char *error, size_t size)
+{
+    ASTNode *ast = test_parse(input);
+    if (!ast)
+    {
+        return 0;
+    }
+    mpfr_t result;
+    mpfr_init2(result, ctx->precision);
+    evaluator_eval_ctx(ctx, result, ast);
+    const char *message = eval_context_get_error(ctx);
+    snprintf(error, size, "%s", message ? message : "");
+    mpfr_clear(result);
+    ast_free(ast);
+    return 1;
+}
+
+static int test_analysis_precheck(void)
+{
+    printf("Testing evaluation pre-checks...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 256);
+    ctx.native = 0;
+    char error[EVAL_CONTEXT_ERROR_SIZE];
+
+    // Over the operation limit however it is evaluated
+    ctx.budget.max_operations = 5;
+    TEST_ASSERT(analysis_test_error(&ctx, "sin(1)+sin(2)+sin(3)+sin(4)", error, sizeof(error)),
+                "Should evaluate");
+    TEST_ASSERT(strstr(error, "more than 5 operations") != NULL,
+                "Too many operations should be refused");
+    TEST_ASSERT(analysis_test_error(&ctx, "sin(1)+sin(2)", error, sizeof(error)) && !error[0],
+                "Operations within the limit should run");
+    ctx.budget.max_operations = 0;
+
+    // A time limit far below the estimate
+    ctx.budget.seconds = 1e-12;
+    TEST_ASSERT(analysis_test_error(&ctx, "exp(sqrt(2))", error, sizeof(error)),
+                "Should evaluate");
+    TEST_ASSERT(strstr(error, "estimated") != NULL, "Hopeless time limits should be refused");
+    ctx.budget.seconds = 60;
+    TEST_ASSERT(analysis_test_error(&ctx, "exp(sqrt(2))", error, sizeof(error)) && !error[0],
+                "Generous time limits should let it run");
+
+    // Strict mode refuses certain failures with the error evaluation gives
+    ctx.strict_mode = 1;
+    TEST_ASSERT(analysis_test_error(&ctx, "sin(1) + acos(3)", error, sizeof(error)),
+                "Should evaluate");
+    char expected[EVAL_CONTEXT_ERROR_SIZE];
+    ctx.budget.seconds = 0;
+    TEST_ASSERT(analysis_test_error(&ctx, "sin(1) + acos(3)", expected, sizeof(expected)),
+                "Should evaluate");
+    TEST_ASSERT(expected[0] && strcmp(error, expected) == 0,
+                "Pre-check and evaluation should report the same error");
+
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Evaluation pre-check tests passed\n");
+    return 1;
+}
+
+int run_analysis_tests(void)
+{
+    printf("Running Static Analysis Test Suite\n");
+    printf("==================================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_analysis_domain())
+        passed++;
+    total++;
+    if (test_analysis_bounds())
+        passed++;
+    total++;
+    if (test_analysis_cost())
+        passed++;
+    total++;
+    if (test_analysis_precheck())
+        passed++;
+
+    printf("\n==================================\n");
+    printf("Static Analysis Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,397 @@
+#include "batch.h"
+#include "evaluator.h"
+#include "precision.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Run batch mode over an in-memory input and capture its output
+static int run_batch_text(const char *text, char *output, size_t output_size, int *status, int jobs)
+{
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    if (!in || !out)
+    {
+        if (in)
+            fclose(in);
+        if (out)
+            fclose(out);
+        return 0;
+    }
+
+    fwrite(text, 1, strlen(text), in);
+    rewind(in);
+
+    *status = batch_process_stream(in, out, jobs);
+
+    rewind(out);
+    size_t length = fread(output, 1, output_size - 1, out);
+    output[length] = '\0';
+
+    fclose(in);
+    fclose(out);
+    return 1;
+}
+
+int test_batch_results(void)
+{
+    printf("Testing batch results...\n");
+
+    char output[1024];
+    int status;
+    TEST_ASSERT(run_batch_text("2+3*4\n7\n\n1/4\r\nsqrt(16)", output, sizeof(output), &status, 1),
+                "Batch run should start");
+    TEST_ASSERT(status == BATCH_EXIT_OK, "All lines should succeed");
+    TEST_ASSERT(strcmp(output, "14\n7\n\n0.25\n4\n") == 0, "One result line per input line");
+
+    printf("  ✅ Batch result tests passed\n");
+    return 1;
+}
+
+int test_batch_errors(void)
+{
+    printf("Testing batch error lines...\n");
+
+    char output[1024];
+    int status;
+    TEST_ASSERT(run_batch_text("1/0\n2+\nfoo(1)\n(1+2\n3 4)\n5\n", output, sizeof(output), &status, 1),
+                "Batch run should start");
+    TEST_ASSERT(status == BATCH_EXIT_LINE_ERROR, "A failing line should set the exit status");
+
+    const char *expected =
+        "error: Division by zero\n"
+        "error: Unexpected token: EOF\n"
+        "error: Unknown function: foo\n"
+        "error: Expected ')'\n"
+        "error: Unexpected token at end: RPAREN\n"
+        "5\n";
+    TEST_ASSERT(strcmp(output, expected) == 0, "Errors should be reported per line");
+
+    printf("  ✅ Batch error tests passed\n");
+    return 1;
+}
+
+int test_batch_long_lines(void)
+{
+    printf("Testing batch lines beyond the interactive limit...\n");
+
+    // 2000 terms of "1+" is well past the REPL's 1024-character limit
+    size_t terms = 2000;
+    char *input = malloc(terms * 2 + 3);
+    TEST_ASSERT(input != NULL, "Allocation should succeed");
+    for (size_t i = 0; i < terms; i++)
+    {
+        memcpy(input + i * 2, "1+", 2);
+    }
+    strcpy(input + terms * 2, "0\n");
+
+    char output[64];
+    int status;
+    int ran = run_batch_text(input, output, sizeof(output), &status, 1);
+    free(input);
+
+    TEST_ASSERT(ran, "Batch run should start");
+    TEST_ASSERT(status == BATCH_EXIT_OK, "Long line should succeed");
+    TEST_ASSERT(strcmp(output, "2000\n") == 0, "Long line should evaluate");
+
+    TEST_ASSERT(batch_run("/nonexistent/batch/input", 1) == BATCH_EXIT_IO_ERROR,
+                "Missing file should be an I/O error");
+
+    printf("  ✅ Long line tests passed\n");
+    return 1;
+}
+
+int test_batch_jobs(void)
+{
+    printf("Testing parallel batch evaluation...\n");
+
+    // Enough lines for many chunks, with errors and blanks mixed in
+    static const char *lines[] = {"2^0.5", "1/0", "", "sin(pi/6)", "3 4)", "exp(1)*7", "sqrt(%d)"};
+    size_t count = 1000;
+    size_t input_size = count * 16 + 1;
+    char *input = malloc(input_size);
+    TEST_ASSERT(input != NULL, "Allocation should succeed");
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        char line[16];
+        snprintf(line, sizeof(line), lines[i % 7], (int)i);
+        offset += snprintf(input + offset, input_size - offset, "%s\n", line);
+    }
+
+    size_t output_size = count * 160;
+    char *serial = malloc(output_size);
+    char *parallel = malloc(output_size);
+    int serial_status = -1;
+    int parallel_status = -1;
+    int ok = serial && parallel &&
+             run_batch_text(input, serial, output_size, &serial_status, 1) &&
+             run_batch_text(input, parallel, output_size, &parallel_status, 4);
+    int same = ok && strcmp(serial, parallel) == 0;
+
+    // Workers pick up the caller's strict mode
+    char strict[256];
+    int strict_status = -1;
+    evaluator_set_strict_mode(1);
+    int strict_ok = run_batch_text("sqrt(-1)\n1+1\n", strict, sizeof(strict), &strict_status, 3);
+    evaluator_set_strict_mode(0);
+
+    // Chunks that start with empty lines have no text buffer yet
+    char blank[64];
+    int blank_status = -1;
+    int blank_ok = run_batch_text("\n\n1+1\n", blank, sizeof(blank), &blank_status, 2) &&
+                   strcmp(blank, "\n\n2\n") == 0 &&
+                   run_batch_text("\n\n", blank, sizeof(blank), &blank_status, 2) &&
+                   strcmp(blank, "\n\n") == 0 && blank_status == BATCH_EXIT_OK;
+
+    free(input);
+    free(serial);
+    free(parallel);
+
+    TEST_ASSERT(ok, "Batch runs should start");
+    TEST_ASSERT(serial_status == BATCH_EXIT_LINE_ERROR, "Error lines should set the exit status");
+    TEST_ASSERT(parallel_status == serial_status, "Parallel status should match serial");
+    TEST_ASSERT(same, "Parallel output should match serial output line for line");
+    TEST_ASSERT(strict_ok && strict_status == BATCH_EXIT_LINE_ERROR &&
+                    strncmp(strict, "error: ", 7) == 0 && strstr(strict, "\n2\n") != NULL,
+                "Workers should inherit strict mode");
+    TEST_ASSERT(blank_ok, "Leading empty lines should get empty results");
+
+    printf("  ✅ Parallel batch tests passed\n");
+    return 1;
+}
+
+int test_batch_shards(void)
+{
+    printf("Testing sharded batch runs...\n");
+
+    char output[256];
+    int status;
+    const char *input = "1\n2\n\n4\n5\n6\n7\n";
+    TEST_ASSERT(batch_set_shard(3, 3) != 0 && batch_set_shard(0, 0) != 0,
+                "Shards out of range should be refused");
+
+    TEST_ASSERT(batch_set_shard(0, 3) == 0, "Shard should be set");
+    int first = run_batch_text(input, output, sizeof(output), &status, 1) &&
+                strcmp(output, "1\n4\n7\n") == 0;
+    TEST_ASSERT(batch_set_shard(2, 3) == 0, "Shard should be set");
+    int last = run_batch_text(input, output, sizeof(output), &status, 3) &&
+               strcmp(output, "\n6\n") == 0;
+    batch_set_shard(0, 1);
+
+    TEST_ASSERT(first, "Shard 0/3 should take lines 0, 3 and 6");
+    TEST_ASSERT(last, "Shard 2/3 should take lines 2 and 5, blank ones included");
+
+    printf("  ✅ Sharded batch tests passed\n");
+    return 1;
+}
+
+// Run batch mode from text into an existing output file, then read all of it
+static int run_batch_into(const char *text, FILE *out, char *output, size_t output_size,
+                          int jobs)
+{
+    FILE *in = tmpfile();
+    if (!in)
+    {
+        return -1;
+    }
+    fwrite(text, 1, strlen(text), in);
+    rewind(in);
+    int status = batch_process_stream(in, out, jobs);
+    fclose(in);
+
+    rewind(out);
+    size_t length = fread(output, 1, output_size - 1, out);
+    output[length] = '\0';
+    return status;
+}
+
+int test_batch_checkpoint(void)
+{
+    printf("Testing batch checkpoints...\n");
+
+    char path[] = "/tmp/calculator_checkpoint_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT(fd >= 0, "Checkpoint file should be created");
+    close(fd);
+    remove(path);
+
+    const char *input = "1+1\n2+2\n3+3\n4+4\n5+5\n6+6\n";
+    char output[256];
+    char expected[256];
+    int status;
+    TEST_ASSERT(run_batch_text(input, expected, sizeof(expected), &status, 1),
+                "Batch run should start");
+
+    // A fresh run records the whole input as done
+    batch_set_checkpoint(path);
+    FILE *out = tmpfile();
+    int fresh = run_batch_into(input, out, output, sizeof(output), 1) == BATCH_EXIT_OK &&
+                strcmp(output, expected) == 0;
+    int again = run_batch_into(input, out, output, sizeof(output), 1) == BATCH_EXIT_OK &&
+                strcmp(output, expected) == 0;
+    fclose(out);
+
+    // A run killed after three lines, with a partial fourth result
+    FILE *checkpoint = fopen(path, "w");
+    fprintf(checkpoint, "calculator batch checkpoint 1\nshard 0/1\ninput 12\nlines 3\noutput 6\n");
+    fclose(checkpoint);
+    out = tmpfile();
+    fputs("2\n4\n6\n8", out);
+    int resumed = run_batch_into(input, out, output, sizeof(output), 4) == BATCH_EXIT_OK &&
+                  strcmp(output, expected) == 0;
+    fclose(out);
+
+    // Output that lost what the checkpoint records cannot be resumed
+    out = tmpfile();
+    int short_output = run_batch_into(input, out, output, sizeof(output), 1) ==
+                       BATCH_EXIT_IO_ERROR;
+    fclose(out);
+
+    batch_set_checkpoint(NULL);
+    remove(path);
+
+    TEST_ASSERT(fresh, "A checkpointed run should produce the usual output");
+    TEST_ASSERT(again, "A finished run should resume at the end of the input");
+    TEST_ASSERT(resumed, "A resumed run should drop the partial line and finish the output");
+    TEST_ASSERT(short_output, "A truncated output should be refused");
+
+    printf("  ✅ Batch checkpoint tests passed\n");
+    return 1;
+}
+
+int test_batch_checkpoint_kill(void)
+{
+    printf("Testing batch runs killed before their first checkpoint...\n");
+
+    char path[] = "/tmp/calculator_checkpoint_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT(fd >= 0, "Checkpoint file should be created");
+    close(fd);
+    remove(path);
+
+    // Enough results to spill out of the stdio buffer long before a timed
+    // checkpoint is due
+    enum
+    {
+        KILL_LINES = 5000
+    };
+    size_t input_size = KILL_LINES * 4 + 1;
+    size_t output_size = KILL_LINES * 2 + 1;
+    char *input = malloc(input_size);
+    char *expected = malloc(output_size);
+    char *output = malloc(output_size * 2);
+    TEST_ASSERT(input && expected && output, "Buffers should be allocated");
+    for (int i = 0; i < KILL_LINES; i++)
+    {
+        memcpy(input + i * 4, "1+1\n", 4);
+        memcpy(expected + i * 2, "2\n", 2);
+    }
+    input[input_size - 1] = '\0';
+    expected[output_size - 1] = '\0';
+
+    FILE *out = tmpfile();
+    int pipe_fds[2];
+    TEST_ASSERT(out && pipe(pipe_fds) == 0, "Output and pipe should be created");
+
+    // The child evaluates what the pipe holds, then waits for more input
+    batch_set_checkpoint(path);
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(pipe_fds[1]);
+        FILE *in = fdopen(pipe_fds[0], "r");
+        batch_process_stream(in, out, 1);
+        _exit(0);
+    }
+    close(pipe_fds[0]);
+    ssize_t written = child > 0 ? write(pipe_fds[1], input, input_size - 1) : -1;
+
+    // Kill it once some results reached the output
+    struct stat info;
+    int started = 0;
+    for (int i = 0; i < 1000 && child > 0 && !started; i++)
+    {
+        started = fstat(fileno(out), &info) == 0 && info.st_size > 0;
+        nanosleep(&(struct timespec){0, 10000000}, NULL);
+    }
+    if (child > 0)
+    {
+        kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+    }
+    close(pipe_fds[1]);
+
+    int resumed = started && run_batch_into(input, out, output, output_size * 2, 1) ==
+                                 BATCH_EXIT_OK &&
+                  strcmp(output, expected) == 0;
+    fclose(out);
+    batch_set_checkpoint(NULL);
+    remove(path);
+    free(input);
+    free(expected);
+    free(output);
+
+    TEST_ASSERT(written == (ssize_t)(input_size - 1), "The child should get its input");
+    TEST_ASSERT(started, "The child should write results before it is killed");
+    TEST_ASSERT(resumed, "A rerun should replace the results of the killed run");
+
+    printf("  ✅ Batch kill tests passed\n");
+    return 1;
+}
+
+int run_batch_tests(void)
+{
+    printf("Running Batch Test Suite\n");
+    printf("========================\n\n");
+
+    batch_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_batch_results())
+        passed++;
+    total++;
+    if (test_batch_errors())
+        passed++;
+    total++;
+    if (test_batch_long_lines())
+        passed++;
+    total++;
+    if (test_batch_jobs())
+        passed++;
+    total++;
+    if (test_batch_shards())
+        passed++;
+    total++;
+    if (test_batch_checkpoint())
+        passed++;
+    total++;
+    if (test_batch_checkpoint_kill())
+        passed++;
+
+    printf("\n========================\n");
+    printf("Batch Tests: %d/%d passed\n", passed, total);
+
+    batch_cleanup();
+
+    return (passed == total) ? 0 : 1;
+}
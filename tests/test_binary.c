@@ -0,0 +1,318 @@
+#include "binary.h"
+#include "batch.h"
+#include "evaluator.h"
+#include "precision.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+static uint64_t binary_test_get_u64(const unsigned char *in)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+/*
+ * Reader for the record format described in binary.h, as a consumer would
+ * write it. Decodes the record at *offset and advances past it; value
+ * records are loaded into value with their precision, error records into
+ * message. Returns the record type, or -1 if the data is malformed.
+ */
+static int binary_test_read(const unsigned char *data, size_t length, size_t *offset,
+                            mpfr_t value, char *message, size_t message_size)
+{
+    if (length - *offset < BINARY_LENGTH_SIZE + 1)
+    {
+        return -1;
+    }
+    const unsigned char *record = data + *offset;
+    size_t payload = (size_t)record[0] | (size_t)record[1] << 8 | (size_t)record[2] << 16 |
+                     (size_t)record[3] << 24;
+    if (payload < 1 || payload > length - *offset - BINARY_LENGTH_SIZE)
+    {
+        return -1;
+    }
+    const unsigned char *body = record + BINARY_LENGTH_SIZE;
+    *offset += BINARY_LENGTH_SIZE + payload;
+
+    switch (body[0])
+    {
+    case BINARY_RECORD_EMPTY:
+        return payload == 1 ? BINARY_RECORD_EMPTY : -1;
+    case BINARY_RECORD_ERROR:
+        snprintf(message, message_size, "%.*s", (int)(payload - 1), (const char *)body + 1);
+        return BINARY_RECORD_ERROR;
+    case BINARY_RECORD_VALUE:
+        break;
+    default:
+        return -1;
+    }
+
+    if (payload < 11)
+    {
+        return -1;
+    }
+    int value_class = body[1];
+    int negative = body[2];
+    mpfr_set_prec(value, (mpfr_prec_t)binary_test_get_u64(body + 3));
+    switch (value_class)
+    {
+    case BINARY_CLASS_ZERO:
+        mpfr_set_zero(value, negative ? -1 : 1);
+        return BINARY_RECORD_VALUE;
+    case BINARY_CLASS_INF:
+        mpfr_set_inf(value, negative ? -1 : 1);
+        return BINARY_RECORD_VALUE;
+    case BINARY_CLASS_NAN:
+        mpfr_set_nan(value);
+        return BINARY_RECORD_VALUE;
+    case BINARY_CLASS_REGULAR:
+        break;
+    default:
+        return -1;
+    }
+
+    size_t bytes = ((size_t)mpfr_get_prec(value) + 7) / 8;
+    if (payload != 19 + bytes)
+    {
+        return -1;
+    }
+    int64_t exponent = (int64_t)binary_test_get_u64(body + 11);
+
+    // 0.<bytes> * 2^exponent is the integer <bytes> * 2^(exponent - 8 bytes)
+    mpz_t significand;
+    mpz_init(significand);
+    mpz_import(significand, bytes, 1, 1, 1, 0, body + 19);
+    if (negative)
+    {
+        mpz_neg(significand, significand);
+    }
+    int inexact = mpfr_set_z_2exp(value, significand, (mpfr_exp_t)(exponent - 8 * (int64_t)bytes),
+                                  MPFR_RNDN);
+    mpz_clear(significand);
+    return inexact == 0 ? BINARY_RECORD_VALUE : -1;
+}
+
+// Check that two values have the same precision and the same bits
+static int binary_test_identical(mpfr_srcptr a, mpfr_srcptr b)
+{
+    if (mpfr_get_prec(a) != mpfr_get_prec(b))
+    {
+        return 0;
+    }
+    if (mpfr_nan_p(a) || mpfr_nan_p(b))
+    {
+        return mpfr_nan_p(a) && mpfr_nan_p(b);
+    }
+    return mpfr_equal_p(a, b) && mpfr_signbit(a) == mpfr_signbit(b);
+}
+
+// Encode one value, decode it again and compare
+static int binary_test_round_trip(mpfr_srcptr value)
+{
+    FormatBuffer buffer;
+    format_buffer_init(&buffer);
+    mpfr_t decoded;
+    mpfr_init2(decoded, 2);
+
+    size_t offset = 0;
+    char message[64];
+    int ok = binary_append_value(&buffer, value) &&
+             binary_test_read((const unsigned char *)buffer.data, buffer.length, &offset, decoded,
+                              message, sizeof(message)) == BINARY_RECORD_VALUE &&
+             offset == buffer.length && binary_test_identical(value, decoded);
+
+    mpfr_clear(decoded);
+    format_buffer_free(&buffer);
+    return ok;
+}
+
+int test_binary_round_trips(void)
+{
+    printf("Testing binary round trips...\n");
+
+    // Odd precisions leave partial bytes and limbs
+    const mpfr_prec_t precisions[] = {2, 53, 64, 67, 113, 256, 1000, 4096, 8192};
+    for (size_t i = 0; i < sizeof(precisions) / sizeof(precisions[0]); i++)
+    {
+        mpfr_t value;
+        mpfr_init2(value, precisions[i]);
+
+        mpfr_const_pi(value, MPFR_RNDN);
+        TEST_ASSERT(binary_test_round_trip(value), "pi should round trip");
+        mpfr_set_si(value, -1, MPFR_RNDN);
+        mpfr_div_ui(value, value, 3, MPFR_RNDN);
+        TEST_ASSERT(binary_test_round_trip(value), "-1/3 should round trip");
+        mpfr_set_ui_2exp(value, 1, -1000000, MPFR_RNDN);
+        TEST_ASSERT(binary_test_round_trip(value), "Tiny exponents should round trip");
+        mpfr_set_ui_2exp(value, 3, 1000000, MPFR_RNDN);
+        TEST_ASSERT(binary_test_round_trip(value), "Huge exponents should round trip");
+
+        mpfr_clear(value);
+    }
+
+    mpfr_t special;
+    mpfr_init2(special, 128);
+    mpfr_set_zero(special, 1);
+    TEST_ASSERT(binary_test_round_trip(special), "Zero should round trip");
+    mpfr_set_zero(special, -1);
+    TEST_ASSERT(binary_test_round_trip(special), "Negative zero should keep its sign");
+    mpfr_set_inf(special, -1);
+    TEST_ASSERT(binary_test_round_trip(special), "Infinities should round trip");
+    mpfr_set_nan(special);
+    TEST_ASSERT(binary_test_round_trip(special), "NaN should round trip");
+    mpfr_clear(special);
+
+    printf("  ✅ Binary round trip tests passed\n");
+    return 1;
+}
+
+// Run batch mode in binary output over a text and return the records
+static unsigned char *binary_test_batch(const char *text, int jobs, size_t *length, int *status)
+{
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    unsigned char *data = NULL;
+    if (in && out)
+    {
+        fwrite(text, 1, strlen(text), in);
+        rewind(in);
+
+        batch_set_output(BATCH_OUTPUT_BINARY);
+        *status = batch_process_stream(in, out, jobs);
+        batch_set_output(BATCH_OUTPUT_TEXT);
+
+        long size = ftell(out);
+        data = size > 0 ? malloc((size_t)size) : NULL;
+        rewind(out);
+        *length = data ? fread(data, 1, (size_t)size, out) : 0;
+    }
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+    return data;
+}
+
+int test_binary_batch(void)
+{
+    printf("Testing binary batch output...\n");
+
+    size_t length = 0;
+    int status;
+    unsigned char *data = binary_test_batch("1/3\n\n1/0\n2^-3000\n", 1, &length, &status);
+    TEST_ASSERT(data, "Batch run should produce records");
+    TEST_ASSERT(status == BATCH_EXIT_LINE_ERROR, "Error lines should still set the exit status");
+
+    mpfr_t value, expected;
+    mpfr_init2(value, 2);
+    mpfr_init2(expected, global_precision);
+    char message[128];
+    size_t offset = 0;
+
+    TEST_ASSERT(binary_test_read(data, length, &offset, value, message, sizeof(message)) ==
+                    BINARY_RECORD_VALUE,
+                "First line should be a value");
+    mpfr_set_ui(expected, 1, MPFR_RNDN);
+    mpfr_div_ui(expected, expected, 3, MPFR_RNDN);
+    TEST_ASSERT(binary_test_identical(value, expected), "1/3 should arrive exactly");
+
+    TEST_ASSERT(binary_test_read(data, length, &offset, value, message, sizeof(message)) ==
+                    BINARY_RECORD_EMPTY,
+                "Blank lines should give empty records");
+    TEST_ASSERT(binary_test_read(data, length, &offset, value, message, sizeof(message)) ==
+                        BINARY_RECORD_ERROR &&
+                    strcmp(message, "Division by zero") == 0,
+                "Errors should give error records");
+    TEST_ASSERT(binary_test_read(data, length, &offset, value, message, sizeof(message)) ==
+                    BINARY_RECORD_VALUE,
+                "Last line should be a value");
+    mpfr_set_ui_2exp(expected, 1, -3000, MPFR_RNDN);
+    TEST_ASSERT(binary_test_identical(value, expected), "Powers of two should arrive exactly");
+    TEST_ASSERT(offset == length, "Records should cover the output");
+    free(data);
+
+    // Exact integers wider than the working precision keep every bit
+    data = binary_test_batch("2^521-1\n", 1, &length, &status);
+    offset = 0;
+    TEST_ASSERT(data && binary_test_read(data, length, &offset, value, message,
+                                         sizeof(message)) == BINARY_RECORD_VALUE,
+                "Exact integers should give a value");
+    mpz_t mersenne;
+    mpz_init(mersenne);
+    mpz_ui_pow_ui(mersenne, 2, 521);
+    mpz_sub_ui(mersenne, mersenne, 1);
+    int whole = mpfr_cmp_z(value, mersenne) == 0;
+    mpz_clear(mersenne);
+    TEST_ASSERT(global_precision < 521, "The integer should be wider than the precision");
+    TEST_ASSERT(whole, "2^521-1 should arrive exactly");
+
+    // Threads write the same records in the same order
+    char text[4096] = "";
+    for (int i = 1; i <= 300; i++)
+    {
+        snprintf(text + strlen(text), sizeof(text) - strlen(text), "sqrt(%d)\n", i);
+    }
+    size_t serial_length = 0, parallel_length = 0;
+    unsigned char *serial = binary_test_batch(text, 1, &serial_length, &status);
+    unsigned char *parallel = binary_test_batch(text, 4, &parallel_length, &status);
+    TEST_ASSERT(serial && parallel && serial_length == parallel_length &&
+                    memcmp(serial, parallel, serial_length) == 0,
+                "Threaded records should match serial ones");
+    offset = 0;
+    int records = 0;
+    while (offset < serial_length &&
+           binary_test_read(serial, serial_length, &offset, value, message, sizeof(message)) ==
+               BINARY_RECORD_VALUE)
+    {
+        records++;
+    }
+    TEST_ASSERT(records == 300 && offset == serial_length, "Every line should give a record");
+
+    free(serial);
+    free(parallel);
+    free(data);
+    mpfr_clear(value);
+    mpfr_clear(expected);
+    printf("  ✅ Binary batch output tests passed\n");
+    return 1;
+}
+
+int run_binary_tests(void)
+{
+    printf("Running Binary Output Test Suite\n");
+    printf("================================\n\n");
+
+    batch_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_binary_round_trips())
+        passed++;
+    total++;
+    if (test_binary_batch())
+        passed++;
+
+    printf("\n================================\n");
+    printf("Binary Output Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
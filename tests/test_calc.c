@@ -0,0 +1,253 @@
+#include "calc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Evaluate and compare with a double; 0 on error or mismatch
+static int calc_test_value(const CalcExpression *expression, CalcContext *ctx, double expected)
+{
+    mpfr_t result;
+    mpfr_init2(result, calc_context_get_precision(ctx));
+    int ok = calc_eval(expression, ctx, result) == 0 &&
+             mpfr_cmp_d(result, expected - 1e-12) > 0 && mpfr_cmp_d(result, expected + 1e-12) < 0;
+    mpfr_clear(result);
+    return ok;
+}
+
+static int test_calc_compile(void)
+{
+    printf("Testing compile once, evaluate many...\n");
+
+    CalcExpression *identity = calc_compile("sin(x)^2 + cos(x)^2 + x/4", 256);
+    TEST_ASSERT(identity != NULL, "Expression should compile");
+    CalcContext *ctx = calc_context_create(256);
+    TEST_ASSERT(ctx != NULL, "Context should be created");
+
+    TEST_ASSERT(calc_bind_d(ctx, "x", 0.5) == 0, "x should be bound");
+    TEST_ASSERT(calc_test_value(identity, ctx, 1.125), "Should evaluate with x = 0.5");
+    TEST_ASSERT(calc_bind_d(ctx, "x", 2) == 0, "x should be rebound");
+    TEST_ASSERT(calc_test_value(identity, ctx, 1.5), "Should follow the new binding");
+
+    // The same expression in another context, at another precision
+    CalcContext *other = calc_context_create(64);
+    TEST_ASSERT(calc_bind_d(other, "x", -4) == 0, "x should be bound");
+    TEST_ASSERT(calc_test_value(identity, other, 0.0), "Contexts should be independent");
+    TEST_ASSERT(calc_test_value(identity, ctx, 1.5), "The first context should be unchanged");
+    calc_context_set_precision(other, 512);
+    TEST_ASSERT(calc_context_get_precision(other) == 512, "Precision should be changed");
+    calc_context_destroy(other);
+
+    // Errors
+    TEST_ASSERT(calc_compile("1 +", 256) == NULL && calc_get_error()[0],
+                "An incomplete expression should not compile");
+    TEST_ASSERT(calc_compile("2 3)", 256) == NULL && strstr(calc_get_error(), "Unexpected"),
+                "Trailing input should not compile");
+    CalcExpression *unknown = calc_compile("y + 1", 256);
+    mpfr_t result;
+    mpfr_init2(result, 256);
+    TEST_ASSERT(calc_eval(unknown, ctx, result) != 0 && calc_context_get_error(ctx),
+                "An unbound variable should be an error");
+    mpfr_clear(result);
+
+    // Definitions follow the variables they read
+    CalcExpression *twice = calc_compile("2x", 256);
+    TEST_ASSERT(calc_define(ctx, "y", twice) == 0, "y should be defined");
+    calc_free(twice);
+    TEST_ASSERT(calc_test_value(unknown, ctx, 5), "y should be 2x");
+    TEST_ASSERT(calc_bind_d(ctx, "x", 10) == 0 && calc_test_value(unknown, ctx, 21),
+                "y should follow x");
+    CalcExpression *loop = calc_compile("y - 1", 256);
+    TEST_ASSERT(calc_define(ctx, "x", loop) != 0 && strstr(calc_context_get_error(ctx), "Circular"),
+                "Circular definitions should be refused");
+    calc_free(loop);
+
+    calc_free(unknown);
+    calc_free(identity);
+    calc_context_destroy(ctx);
+    printf("  ✅ Compile and evaluate tests passed\n");
+    return 1;
+}
+
+// Evaluate over count points at a precision and compare with calc_eval()
+static int calc_test_batch(const char *text, mpfr_prec_t precision, size_t count,
+                           size_t *failures)
+{
+    CalcExpression *expression = calc_compile(text, precision);
+    CalcContext *ctx = calc_context_create(precision);
+    mpfr_t *inputs = malloc(count * sizeof(mpfr_t));
+    mpfr_t *outputs = malloc(count * sizeof(mpfr_t));
+    mpfr_t expected;
+    mpfr_init2(expected, precision);
+    for (size_t i = 0; i < count; i++)
+    {
+        mpfr_init2(inputs[i], precision);
+        mpfr_init2(outputs[i], precision);
+        mpfr_set_si(inputs[i], (long)i - (long)count / 2, MPFR_RNDN);
+        mpfr_div_ui(inputs[i], inputs[i], 8, MPFR_RNDN);
+    }
+
+    *failures = calc_eval_batch(expression, ctx, "x", inputs, outputs, count);
+    int ok = 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        calc_bind(ctx, "x", inputs[i]);
+        if (calc_eval(expression, ctx, expected) != 0)
+        {
+            ok = ok && mpfr_nan_p(outputs[i]);
+        }
+        else
+        {
+            ok = ok && mpfr_equal_p(expected, outputs[i]);
+        }
+        mpfr_clear(inputs[i]);
+        mpfr_clear(outputs[i]);
+    }
+
+    mpfr_clear(expected);
+    free(inputs);
+    free(outputs);
+    calc_context_destroy(ctx);
+    calc_free(expression);
+    return ok;
+}
+
+static int test_calc_batch(void)
+{
+    printf("Testing batch evaluation...\n");
+
+    size_t failures;
+    TEST_ASSERT(calc_test_batch("x*x - 3x + exp(x/16)", 53, 1000, &failures) && failures == 0,
+                "Hardware batches should match single evaluations");
+    TEST_ASSERT(calc_test_batch("x*x - 3x + exp(x/16)", 256, 300, &failures) && failures == 0,
+                "MPFR batches should match single evaluations");
+    TEST_ASSERT(calc_test_batch("1/x", 53, 17, &failures) && failures == 1,
+                "The failing point should be counted and set to NaN");
+    TEST_ASSERT(calc_test_batch("x", 53, 0, &failures) && failures == 0,
+                "An empty batch should do nothing");
+
+    printf("  ✅ Batch evaluation tests passed\n");
+    return 1;
+}
+
+static int calc_test_hypot(mpfr_ptr result, mpfr_t args[], mpfr_rnd_t rounding, void *data)
+{
+    (void)data;
+    return mpfr_hypot(result, args[0], args[1], rounding);
+}
+
+// log2 that counts its calls in data
+static int calc_test_log2(mpfr_ptr result, mpfr_t args[], mpfr_rnd_t rounding, void *data)
+{
+    (*(int *)data)++;
+    return mpfr_log2(result, args[0], rounding);
+}
+
+static int calc_test_positive(mpfr_t args[], void *data)
+{
+    (void)data;
+    return mpfr_sgn(args[0]) > 0;
+}
+
+static int test_calc_functions(void)
+{
+    printf("Testing registered functions...\n");
+
+    int calls = 0;
+    TEST_ASSERT(calc_register_function("hypot", 2, calc_test_hypot, NULL, NULL) == 0,
+                "hypot should be registered");
+    TEST_ASSERT(calc_register_function("lg", 1, calc_test_log2, calc_test_positive, &calls) == 0,
+                "lg should be registered");
+
+    TEST_ASSERT(calc_register_function("hypot", 1, calc_test_hypot, NULL, NULL) != 0 &&
+                    strstr(calc_get_error(), "taken"),
+                "A registered name should not be registered again");
+    TEST_ASSERT(calc_register_function("sqrt", 1, calc_test_hypot, NULL, NULL) != 0 &&
+                    calc_register_function("pi", 1, calc_test_hypot, NULL, NULL) != 0,
+                "Built-in names should be taken");
+    TEST_ASSERT(calc_register_function("2x", 1, calc_test_hypot, NULL, NULL) != 0 &&
+                    calc_register_function("f-g", 1, calc_test_hypot, NULL, NULL) != 0,
+                "Names should be identifiers");
+    TEST_ASSERT(calc_register_function("f", 3, calc_test_hypot, NULL, NULL) != 0 &&
+                    calc_register_function("g", 1, NULL, NULL, NULL) != 0,
+                "Arity and kernel should be checked");
+
+    CalcContext *ctx = calc_context_create(128);
+    CalcExpression *sides = calc_compile("hypot(x, 4) + lg(8)", 128);
+    TEST_ASSERT(ctx && sides, "A call to registered functions should compile");
+    TEST_ASSERT(calc_bind_d(ctx, "x", 3) == 0 && calc_test_value(sides, ctx, 8),
+                "Registered functions should be called");
+    TEST_ASSERT(calls == 1, "The kernel should get its data");
+
+    TEST_ASSERT(calc_compile("hypot(3)", 128) == NULL &&
+                    strstr(calc_get_error(), "expects 2 arguments"),
+                "Arity should be checked when parsing");
+    TEST_ASSERT(calc_compile("lg", 128) == NULL, "A registered name should need a call");
+
+    CalcExpression *outside = calc_compile("lg(x - 5)", 128);
+    TEST_ASSERT(outside != NULL, "The call should compile");
+    mpfr_t result;
+    mpfr_init2(result, 128);
+    TEST_ASSERT(calc_eval(outside, ctx, result) == 0 && mpfr_zero_p(result),
+                "Outside the domain the call should give 0, as built-ins do");
+    TEST_ASSERT(calls == 1, "The kernel should not run outside the domain");
+
+    // The hardware batch declines the call and leaves it to MPFR
+    mpfr_t inputs[3], outputs[3];
+    for (int i = 0; i < 3; i++)
+    {
+        mpfr_inits2(53, inputs[i], outputs[i], (mpfr_ptr)0);
+        mpfr_set_si(inputs[i], i == 0 ? 4 : 5 + i, MPFR_RNDN);
+    }
+    TEST_ASSERT(calc_eval_batch(outside, ctx, "x", inputs, outputs, 3) == 0 &&
+                    mpfr_zero_p(outputs[0]) && mpfr_cmp_ui(outputs[1], 0) == 0 &&
+                    mpfr_cmp_ui(outputs[2], 1) == 0,
+                "Batches should call registered functions");
+    for (int i = 0; i < 3; i++)
+    {
+        mpfr_clears(inputs[i], outputs[i], (mpfr_ptr)0);
+    }
+
+    mpfr_clear(result);
+    calc_free(outside);
+    calc_free(sides);
+    calc_context_destroy(ctx);
+    printf("  ✅ Registered function tests passed\n");
+    return 1;
+}
+
+int run_calc_tests(void)
+{
+    printf("Running Embedding API Test Suite\n");
+    printf("================================\n\n");
+
+    calc_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_calc_compile())
+        passed++;
+    total++;
+    if (test_calc_batch())
+        passed++;
+    total++;
+    if (test_calc_functions())
+        passed++;
+
+    printf("\n================================\n");
+    printf("Embedding API Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -101,8 +101,8 @@ int test_lexer_basic()
     Token token = lexer_get_next_token(&lexer);
     TEST_ASSERT(token.type == TOKEN_INT, "First token should be INT");
     TEST_ASSERT(token.int_value == 123, "First token value should be 123");
-    TEST_ASSERT(token.number_string != NULL, "Should have number string");
-    TEST_ASSERT(strcmp(token.number_string, "123") == 0, "Number string should match");
+    TEST_ASSERT(token.length == 3 && strncmp(lexer_token_text(&lexer, &token), "123", 3) == 0,
+                "Number text should match");
     token_free(&token);
 
     token = lexer_get_next_token(&lexer);
@@ -112,8 +112,8 @@ int test_lexer_basic()
     token = lexer_get_next_token(&lexer);
     TEST_ASSERT(token.type == TOKEN_FLOAT, "Third token should be FLOAT");
     TEST_ASSERT(fabs(token.float_value - 45.67) < EPSILON, "Third token value should be 45.67");
-    TEST_ASSERT(token.number_string != NULL, "Should have number string");
-    TEST_ASSERT(strcmp(token.number_string, "45.67") == 0, "Number string should match");
+    TEST_ASSERT(token.length == 5 && strncmp(lexer_token_text(&lexer, &token), "45.67", 5) == 0,
+                "Number text should match");
     token_free(&token);
 
     token = lexer_get_next_token(&lexer);
@@ -184,7 +184,7 @@ int test_lexer_scientific_notation()
         TEST_ASSERT(token.type == TOKEN_FLOAT, "Should parse as FLOAT");
         TEST_ASSERT_DOUBLE_EQ(token.float_value, tests[i].expected,
                               "Scientific notation value");
-        TEST_ASSERT(token.number_string != NULL, "Should have number string");
+        TEST_ASSERT(token.length == strlen(tests[i].input), "Number text should span the input");
 
         token_free(&token);
     }
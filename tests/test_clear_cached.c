@@ -1,5 +1,6 @@
 #include "precision.h"
 #include "constants.h"
+#include "context.h"
 #include <stdio.h>
 #include <mpfr.h>
 
@@ -71,6 +72,59 @@ int test_enum_based_api(void)
     return 1;
 }
 
+/**
+ * Test that constants are served from the highest precision computed so far
+ * and are correctly rounded at every precision and rounding mode
+ */
+int test_multi_precision_cache(void)
+{
+    printf("Testing multi-precision constant cache...\n");
+
+    constants_clear_cache();
+    TEST_ASSERT(!constants_is_cached("gamma"), "Cleared cache should be empty");
+
+    set_precision(1024);
+    mpfr_t value, expected;
+    mpfr_init2(value, global_precision);
+    mpfr_init2(expected, global_precision);
+    constants_get_gamma(value);
+    TEST_ASSERT(constants_is_cached("gamma"), "Computed constant should be cached");
+
+    // Lower precisions are derived from the 1024-bit value
+    set_precision(128);
+    TEST_ASSERT(constants_is_cached("gamma"), "Lower precisions should not need recomputation");
+    set_precision(DEFAULT_PRECISION);
+
+    const mpfr_prec_t precisions[] = {2, 53, 64, 113, 256, 300, 1000, 1100};
+    const mpfr_rnd_t modes[] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD};
+    EvalContext ctx;
+    eval_context_init(&ctx, DEFAULT_PRECISION);
+    for (size_t i = 0; i < sizeof(precisions) / sizeof(precisions[0]); i++)
+    {
+        for (size_t j = 0; j < sizeof(modes) / sizeof(modes[0]); j++)
+        {
+            ctx.rounding = modes[j];
+            mpfr_set_prec(value, precisions[i]);
+            mpfr_set_prec(expected, precisions[i]);
+
+            TEST_ASSERT(constants_get_by_name_ctx(&ctx, value, "gamma"), "gamma should be known");
+            mpfr_const_euler(expected, modes[j]);
+            TEST_ASSERT(mpfr_equal_p(value, expected), "gamma should be correctly rounded");
+
+            TEST_ASSERT(constants_get_by_name_ctx(&ctx, value, "pi"), "pi should be known");
+            mpfr_const_pi(expected, modes[j]);
+            TEST_ASSERT(mpfr_equal_p(value, expected), "pi should be correctly rounded");
+        }
+    }
+    eval_context_cleanup(&ctx);
+
+    mpfr_clear(value);
+    mpfr_clear(expected);
+
+    printf("  ✅ Multi-precision cache tests passed\n");
+    return 1;
+}
+
 int run_clear_cached_tests(void)
 {
     printf("\n=== Running clear_cached Tests ===\n");
@@ -79,12 +133,14 @@ int run_clear_cached_tests(void)
     constants_init();
 
     int passed = 0;
-    int total = 2;
+    int total = 3;
 
     if (test_clear_cached_helper())
         passed++;
     if (test_enum_based_api())
         passed++;
+    if (test_multi_precision_cache())
+        passed++;
 
     precision_cleanup();
     constants_cleanup();
@@ -0,0 +1,363 @@
+#include "compiler.h"
+#include "context.h"
+#include "evaluator.h"
+#include "precision.h"
+#include "constants.h"
+#include "functions.h"
+#include "function_table.h"
+#include "variables.h"
+#include "test_parse.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Expressions covering every node type, operator and function
+static const char *compiler_corpus[] = {
+    "42",
+    "0.1",
+    "pi",
+    "gamma",
+    "-5",
+    "+7",
+    "--3",
+    "2+3*4",
+    "(1+2)*(3+4)/(5+6)",
+    "2^3^2",
+    "2^0.5",
+    "1/3 + 1/7 - 1/11",
+    "1e-30 + 1",
+    "5 > 3",
+    "2 < 1",
+    "4 == 4",
+    "3 != 3",
+    "5 >= 5",
+    "3 <= 2",
+    "sin(pi/6)*2",
+    "cos(pi)",
+    "tan(1)",
+    "asin(0.5) + acos(0.5) + atan(2)",
+    "atan2(1, 2)",
+    "sinh(1) - cosh(1) + tanh(0.5)",
+    "asinh(2) + acosh(2) + atanh(0.25)",
+    "sqrt(pow(3,2) + pow(4,2))",
+    "log(e) + ln(10) + log10(1000)",
+    "exp(1) - e",
+    "abs(-3) + floor(3.7) + ceil(-2.8)",
+    "sin(pi)",
+    "2pi * sqrt2 - ln2 * ln10",
+    "pow(atan2(sin(1), cos(1)), 3)",
+    "atan2(exp(1), pow(2, sqrt(2)))",
+    "sqrt(-1)",
+    "log(0)",
+    "asin(2)",
+    "1/0",
+    "(2)(3)(4) - 2(3+4)",
+    "2^100 + pi - 2^100 + e - sqrt(2)",
+    "1.1 * 2.2 * 3.3 * sin(1) * 4.4",
+};
+
+// Bit-identical: same value, same sign of zero, or both NaN
+static int mpfr_identical(const mpfr_t a, const mpfr_t b)
+{
+    if (mpfr_nan_p(a) || mpfr_nan_p(b))
+    {
+        return mpfr_nan_p(a) && mpfr_nan_p(b);
+    }
+    return mpfr_equal_p(a, b) && mpfr_signbit(a) == mpfr_signbit(b);
+}
+
+// Same error message, or no error on either side
+static int same_error(const char *a, const char *b)
+{
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+// Run a program and the tree walker on one value of x and compare them
+static int compiler_test_agrees(EvalContext *ctx, CompiledProgram *program, const ASTNode *ast,
+                                VariableTable *variables, const char *x)
+{
+    mpfr_t value, expected, actual;
+    mpfr_init2(value, ctx->precision + BINOP_PRECISION_BOOST);
+    mpfr_init2(expected, ctx->precision);
+    mpfr_init2(actual, ctx->precision);
+    mpfr_set_str(value, x, 10, MPFR_RNDN);
+
+    char error[EVAL_CONTEXT_ERROR_SIZE] = "";
+    variables_set_value(variables, "x", value);
+    evaluator_eval_ctx(ctx, expected, ast);
+    const char *expected_error = eval_context_get_error(ctx);
+    if (expected_error)
+    {
+        snprintf(error, sizeof(error), "%s", expected_error);
+    }
+    compiler_run(ctx, actual, program, value);
+
+    int same = mpfr_identical(expected, actual) &&
+               same_error(error[0] ? error : NULL, eval_context_get_error(ctx));
+    mpfr_clears(value, expected, actual, (mpfr_ptr)0);
+    return same;
+}
+
+int test_compiler_matches_tree_walker(void)
+{
+    printf("Testing bytecode results against the tree walker...\n");
+
+    mpfr_prec_t precisions[] = {53, 256, 1024};
+    int corpus_size = sizeof(compiler_corpus) / sizeof(compiler_corpus[0]);
+
+    for (int exact = 0; exact < 2; exact++)
+    {
+        for (int p = 0; p < 3; p++)
+        {
+            set_precision(precisions[p]);
+            EvalContext ctx;
+            eval_context_init(&ctx, precisions[p]);
+            ctx.native = 0;
+            ctx.exact = exact;
+
+            for (int i = 0; i < corpus_size; i++)
+            {
+                ASTNode *ast = test_parse(compiler_corpus[i]);
+                TEST_ASSERT(ast != NULL, compiler_corpus[i]);
+
+                // Only trees the exact tier computes whole are left to it
+                CompiledProgram *program = compiler_compile(&ctx, ast, NULL);
+                if (!program)
+                {
+                    TEST_ASSERT(exact && ast->exact, compiler_corpus[i]);
+                    ast_free(ast);
+                    continue;
+                }
+
+                mpfr_t expected, actual;
+                mpfr_init2(expected, ctx.precision);
+                mpfr_init2(actual, ctx.precision);
+
+                char error[EVAL_CONTEXT_ERROR_SIZE] = "";
+                evaluator_eval_ctx(&ctx, expected, ast);
+                if (eval_context_get_error(&ctx))
+                {
+                    snprintf(error, sizeof(error), "%s", eval_context_get_error(&ctx));
+                }
+                compiler_run(&ctx, actual, program, NULL);
+
+                int identical = mpfr_identical(expected, actual) &&
+                                same_error(error[0] ? error : NULL, eval_context_get_error(&ctx));
+                if (!identical)
+                {
+                    mpfr_printf("    %s at %ld bits: tree %.30Rg, bytecode %.30Rg\n",
+                                compiler_corpus[i], (long)ctx.precision, expected, actual);
+                }
+
+                mpfr_clear(expected);
+                mpfr_clear(actual);
+                compiler_free(program);
+                ast_free(ast);
+
+                TEST_ASSERT(identical, "Bytecode result should be bit-identical");
+            }
+            eval_context_cleanup(&ctx);
+        }
+    }
+
+    set_precision(DEFAULT_PRECISION);
+
+    printf("  ✅ Bytecode matches tree walker tests passed\n");
+    return 1;
+}
+
+int test_compiler_input(void)
+{
+    printf("Testing programs with an input variable...\n");
+
+    const char *bodies[] = {"x^2 - sin(x)/3 + sqrt(x) * pi",
+                            "(1/3 + 2^-3) * x - exp(-x)",
+                            "atan2(x, 1 - x) * (2 + x + 1/7)",
+                            "x",
+                            "1/x",
+                            "log(x) + 1/(x - x)"};
+    const char *values[] = {"-1", "0", "0.5", "2", "1e10"};
+
+    VariableTable *variables = variables_create();
+    TEST_ASSERT(variables != NULL, "Variables should be created");
+    EvalContext ctx;
+    eval_context_init(&ctx, 256);
+    ctx.variables = variables;
+
+    for (int strict = 0; strict < 2; strict++)
+    {
+        ctx.strict_mode = strict;
+        for (size_t b = 0; b < sizeof(bodies) / sizeof(bodies[0]); b++)
+        {
+            ASTNode *ast = test_parse(bodies[b]);
+            CompiledProgram *program = ast ? compiler_compile(&ctx, ast, "x") : NULL;
+            TEST_ASSERT(program != NULL, bodies[b]);
+            for (size_t v = 0; v < sizeof(values) / sizeof(values[0]); v++)
+            {
+                int same = compiler_test_agrees(&ctx, program, ast, variables, values[v]);
+                if (!same)
+                {
+                    printf("    %s at x = %s\n", bodies[b], values[v]);
+                }
+                TEST_ASSERT(same, "A run should match the tree walker for every input");
+            }
+            compiler_free(program);
+            ast_free(ast);
+        }
+    }
+
+    // Trees and settings the evaluator does more for are declined
+    const char *declined[] = {"x + y", "sum(k * x, k, 1, 3)", "1/3 + 2"};
+    for (size_t i = 0; i < sizeof(declined) / sizeof(declined[0]); i++)
+    {
+        ASTNode *ast = test_parse(declined[i]);
+        TEST_ASSERT(ast && !compiler_compile(&ctx, ast, "x"), declined[i]);
+        ast_free(ast);
+    }
+    ASTNode *ast = test_parse("sin(x)");
+    TEST_ASSERT(ast && !compiler_compile(&ctx, ast, NULL), "Other variables are not known");
+    eval_context_set_precision(&ctx, 53);
+    TEST_ASSERT(!compiler_compile(&ctx, ast, "x"), "The hardware backends serve 53 bits");
+    ctx.native = 0;
+    ctx.interval = 1;
+    TEST_ASSERT(!compiler_compile(&ctx, ast, "x"), "Interval evaluation is not replayed");
+    ast_free(ast);
+
+    eval_context_cleanup(&ctx);
+    variables_destroy(variables);
+    printf("  ✅ Input variable tests passed\n");
+    return 1;
+}
+
+int test_compiler_repeated_runs(void)
+{
+    printf("Testing repeated runs of one program...\n");
+
+    ASTNode *ast = test_parse("sqrt(2) * sin(1) + pow(e, 2) - 1/3");
+    TEST_ASSERT(ast != NULL, "Expression should parse");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 256);
+    CompiledProgram *program = compiler_compile(&ctx, ast, NULL);
+    TEST_ASSERT(program != NULL, "Expression should compile");
+    // Three terms and the sum written above them
+    TEST_ASSERT(program->temp_count <= 4, "Scratch registers should be reused");
+
+    mpfr_t first, again;
+    mpfr_init2(first, ctx.precision);
+    mpfr_init2(again, ctx.precision);
+
+    compiler_run(&ctx, first, program, NULL);
+    for (int i = 0; i < 100; i++)
+    {
+        compiler_run(&ctx, again, program, NULL);
+        if (!mpfr_identical(first, again))
+        {
+            break;
+        }
+    }
+    int identical = mpfr_identical(first, again);
+
+    mpfr_clear(first);
+    mpfr_clear(again);
+    compiler_free(program);
+    eval_context_cleanup(&ctx);
+    ast_free(ast);
+
+    TEST_ASSERT(identical, "Every run should produce the same result");
+
+    printf("  ✅ Repeated run tests passed\n");
+    return 1;
+}
+
+int test_compiler_errors(void)
+{
+    printf("Testing bytecode error handling...\n");
+
+    ASTNode *ast = test_parse("1 + x/0");
+    TEST_ASSERT(ast != NULL, "Expression should parse");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 256);
+    CompiledProgram *program = compiler_compile(&ctx, ast, "x");
+    TEST_ASSERT(program != NULL, "Expression should compile");
+
+    mpfr_t result;
+    mpfr_init2(result, ctx.precision);
+
+    compiler_run(&ctx, result, program, result);
+    TEST_ASSERT(eval_context_get_error(&ctx) != NULL, "Division by zero should be reported");
+    compiler_run(&ctx, result, program, NULL);
+    TEST_ASSERT(eval_context_get_error(&ctx) != NULL, "A missing input should be reported");
+
+    atomic_int cancel = 1;
+    ctx.cancel = &cancel;
+    compiler_run(&ctx, result, program, result);
+    const char *error = eval_context_get_error(&ctx);
+    TEST_ASSERT(error && strstr(error, "interrupted"), "A cancelled run should stop");
+    ctx.cancel = NULL;
+
+    // A program is bound to the settings it was compiled for
+    eval_context_set_precision(&ctx, 512);
+    TEST_ASSERT(!compiler_is_current(program, &ctx),
+                "Program should be stale after precision change");
+    compiler_run(&ctx, result, program, result);
+    TEST_ASSERT(eval_context_get_error(&ctx) != NULL, "Stale program should report an error");
+
+    TEST_ASSERT(compiler_compile(&ctx, NULL, NULL) == NULL, "NULL AST should not compile");
+
+    mpfr_clear(result);
+    compiler_free(program);
+    eval_context_cleanup(&ctx);
+    ast_free(ast);
+
+    printf("  ✅ Bytecode error handling tests passed\n");
+    return 1;
+}
+
+int run_compiler_tests(void)
+{
+    printf("Running Compiler Test Suite\n");
+    printf("===========================\n\n");
+
+    precision_init();
+    constants_init();
+    functions_init();
+    function_table_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_compiler_matches_tree_walker())
+        passed++;
+    total++;
+    if (test_compiler_input())
+        passed++;
+    total++;
+    if (test_compiler_repeated_runs())
+        passed++;
+    total++;
+    if (test_compiler_errors())
+        passed++;
+
+    printf("\n===========================\n");
+    printf("Compiler Tests: %d/%d passed\n", passed, total);
+
+    constants_cleanup();
+    functions_cleanup();
+    precision_cleanup();
+
+    return (passed == total) ? 0 : 1;
+}
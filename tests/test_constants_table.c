@@ -0,0 +1,196 @@
+#include "constants_table.h"
+#include "constants.h"
+#include "context.h"
+#include "profile.h"
+#include <stdio.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+#define TABLE_TEST_PATH "test_constants.tbl"
+#define TABLE_TEST_BROKEN "test_constants_broken.tbl"
+
+// Get a constant through a fresh context, so only the shared caches and the
+// table can serve it
+static void table_test_get(mpfr_t result, ConstantType type, mpfr_rnd_t rounding)
+{
+    EvalContext ctx;
+    eval_context_init(&ctx, mpfr_get_prec(result));
+    ctx.rounding = rounding;
+    constants_get_by_type_ctx(&ctx, result, type);
+    eval_context_cleanup(&ctx);
+}
+
+// Copy the test table, overwriting one byte or cutting it short
+static int table_test_break(long offset, int byte, long truncate)
+{
+    FILE *in = fopen(TABLE_TEST_PATH, "rb");
+    FILE *out = fopen(TABLE_TEST_BROKEN, "wb");
+    int ok = in && out;
+    long position = 0;
+    int c;
+    while (ok && (c = fgetc(in)) != EOF && (truncate < 0 || position < truncate))
+    {
+        fputc(position == offset ? byte : c, out);
+        position++;
+    }
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+    return ok;
+}
+
+int test_constants_table_round_trip(void)
+{
+    printf("Testing constants table round trip...\n");
+
+    TEST_ASSERT(constants_table_export(TABLE_TEST_PATH, 1000) == 0, "Export should succeed");
+    TEST_ASSERT(constants_table_load(TABLE_TEST_PATH) == 0, "Fresh tables should load");
+    TEST_ASSERT(constants_table_precision() == 1000, "The table should report its precision");
+    TEST_ASSERT(constants_table_get_error() == NULL, "Loading should clear the error");
+
+    // Nothing comfortably below the ceiling is computed
+    constants_clear_cache();
+    profile_set_enabled(1);
+    profile_reset();
+    const mpfr_prec_t precisions[] = {53, 256, 900};
+    const mpfr_rnd_t roundings[] = {MPFR_RNDN, MPFR_RNDD, MPFR_RNDU, MPFR_RNDZ};
+    mpfr_t stored[3][4][CONST_COUNT];
+    for (int p = 0; p < 3; p++)
+    {
+        for (int r = 0; r < 4; r++)
+        {
+            for (int i = 0; i < CONST_COUNT; i++)
+            {
+                mpfr_init2(stored[p][r][i], precisions[p]);
+                table_test_get(stored[p][r][i], (ConstantType)i, roundings[r]);
+            }
+        }
+    }
+    profile_set_enabled(0);
+    ProfileStats stats;
+    profile_get_stats(&stats);
+    profile_reset();
+    if (profile_available())
+    {
+        TEST_ASSERT(stats.counters[PROFILE_CONSTANT_MISSES] == 0,
+                    "The table should serve every precision below its ceiling");
+    }
+
+    // Computed values agree in every rounding mode
+    constants_table_unload();
+    TEST_ASSERT(constants_table_precision() == 0, "Unloading should drop the table");
+    constants_clear_cache();
+    int agree = 1;
+    for (int p = 0; p < 3; p++)
+    {
+        for (int r = 0; r < 4; r++)
+        {
+            for (int i = 0; i < CONST_COUNT; i++)
+            {
+                mpfr_t computed;
+                mpfr_init2(computed, precisions[p]);
+                table_test_get(computed, (ConstantType)i, roundings[r]);
+                agree = agree && mpfr_equal_p(computed, stored[p][r][i]);
+                mpfr_clear(computed);
+                mpfr_clear(stored[p][r][i]);
+            }
+        }
+    }
+    TEST_ASSERT(agree, "Stored constants should round like computed ones");
+
+    // Above the ceiling the constants are computed as before
+    TEST_ASSERT(constants_table_load(TABLE_TEST_PATH) == 0, "Reloading should succeed");
+    mpfr_t high, expected;
+    mpfr_init2(high, 2000);
+    mpfr_init2(expected, 2000);
+    table_test_get(high, CONST_GAMMA, MPFR_RNDN);
+    mpfr_const_euler(expected, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(high, expected), "Precisions above the table should be computed");
+    mpfr_clear(high);
+    mpfr_clear(expected);
+
+    constants_table_unload();
+    constants_clear_cache();
+    printf("  ✅ Constants table round trip tests passed\n");
+    return 1;
+}
+
+int test_constants_table_rejects(void)
+{
+    printf("Testing stale and corrupt constants tables...\n");
+
+    TEST_ASSERT(constants_table_export(TABLE_TEST_PATH, 512) == 0, "Export should succeed");
+
+    // The MPFR version, a deep limb, the last byte and a truncated file
+    const long offsets[] = {17, 400, -1, -1};
+    const long truncates[] = {-1, -1, -1, 100};
+    for (int i = 0; i < 4; i++)
+    {
+        long offset = offsets[i];
+        if (i == 2)
+        {
+            FILE *file = fopen(TABLE_TEST_PATH, "rb");
+            TEST_ASSERT(file && fseek(file, 0, SEEK_END) == 0, "Table should be readable");
+            offset = ftell(file) - 1;
+            fclose(file);
+        }
+        TEST_ASSERT(table_test_break(offset, 0x55, truncates[i]), "Broken copy should be written");
+        TEST_ASSERT(constants_table_load(TABLE_TEST_BROKEN) != 0,
+                    "Broken tables should be refused");
+        TEST_ASSERT(constants_table_get_error() != NULL, "Refusals should say why");
+        TEST_ASSERT(constants_table_precision() == 0, "Refused tables should not be used");
+    }
+    TEST_ASSERT(constants_table_load("no_such_constants.tbl") != 0, "Missing files should fail");
+    TEST_ASSERT(strstr(constants_table_get_error(), "no_such_constants.tbl") != NULL,
+                "The error should name the file");
+
+    // Constants still come out right afterwards
+    mpfr_t value, expected;
+    mpfr_init2(value, 300);
+    mpfr_init2(expected, 300);
+    table_test_get(value, CONST_PI, MPFR_RNDN);
+    mpfr_const_pi(expected, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(value, expected), "Constants should be computed without a table");
+    mpfr_clear(value);
+    mpfr_clear(expected);
+
+    remove(TABLE_TEST_PATH);
+    remove(TABLE_TEST_BROKEN);
+    printf("  ✅ Stale and corrupt table tests passed\n");
+    return 1;
+}
+
+int run_constants_table_tests(void)
+{
+    printf("Running Constants Table Test Suite\n");
+    printf("==================================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_constants_table_round_trip())
+        passed++;
+    total++;
+    if (test_constants_table_rejects())
+        passed++;
+
+    remove(TABLE_TEST_PATH);
+    remove(TABLE_TEST_BROKEN);
+
+    printf("\n==================================\n");
+    printf("Constants Table Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,283 @@
+#include "context.h"
+#include "evaluator.h"
+#include "functions.h"
+#include "formatter.h"
+#include "precision.h"
+#include "test_parse.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Evaluate through the global API at a given precision
+static void context_test_eval_global(mpfr_t result, const char *input, mpfr_prec_t precision)
+{
+    mpfr_prec_t saved = get_precision();
+    set_precision(precision);
+    ASTNode *ast = test_parse_at(input, 0);
+    mpfr_set_prec(result, precision);
+    evaluator_eval(result, ast);
+    ast_free(ast);
+    set_precision(saved);
+}
+
+static const char *context_corpus[] = {
+    "2*pi/3 + 0.1",
+    "sqrt(2) * e - gamma",
+    "atan2(exp(1), pow(2, sqrt(2)))",
+    "log(ln10) + sqrt2 * ln2",
+    "sin(pi) + 1e-30",
+};
+
+int test_context_precisions(void)
+{
+    printf("Testing contexts at different precisions...\n");
+
+    EvalContext low;
+    EvalContext high;
+    eval_context_init(&low, 64);
+    eval_context_init(&high, 1024);
+
+    size_t count = sizeof(context_corpus) / sizeof(context_corpus[0]);
+    for (size_t i = 0; i < count; i++)
+    {
+        ASTNode *low_ast = test_parse_at(context_corpus[i], 64);
+        ASTNode *high_ast = test_parse_at(context_corpus[i], 1024);
+        TEST_ASSERT(low_ast && high_ast, "Corpus expression should parse");
+
+        mpfr_t low_result, high_result, expected;
+        mpfr_init2(low_result, 64);
+        mpfr_init2(high_result, 1024);
+        mpfr_init2(expected, 64);
+
+        // Interleave the two contexts; neither may disturb the other
+        evaluator_eval_ctx(&low, low_result, low_ast);
+        evaluator_eval_ctx(&high, high_result, high_ast);
+        evaluator_eval_ctx(&low, low_result, low_ast);
+
+        context_test_eval_global(expected, context_corpus[i], 64);
+        int low_ok = mpfr_equal_p(low_result, expected) ||
+                     (mpfr_nan_p(low_result) && mpfr_nan_p(expected));
+        context_test_eval_global(expected, context_corpus[i], 1024);
+        int high_ok = mpfr_equal_p(high_result, expected) ||
+                      (mpfr_nan_p(high_result) && mpfr_nan_p(expected));
+
+        mpfr_clears(low_result, high_result, expected, (mpfr_ptr)0);
+        ast_free(low_ast);
+        ast_free(high_ast);
+
+        if (!low_ok || !high_ok)
+        {
+            printf("    expression: %s\n", context_corpus[i]);
+        }
+        TEST_ASSERT(low_ok, "64-bit context should match set_precision(64)");
+        TEST_ASSERT(high_ok, "1024-bit context should match set_precision(1024)");
+    }
+
+    TEST_ASSERT(get_precision() == DEFAULT_PRECISION, "Contexts should not touch the global precision");
+
+    eval_context_cleanup(&low);
+    eval_context_cleanup(&high);
+
+    printf("  ✅ Context precision tests passed\n");
+    return 1;
+}
+
+int test_context_isolation(void)
+{
+    printf("Testing context error and mode isolation...\n");
+
+    EvalContext a;
+    EvalContext b;
+    eval_context_init(&a, DEFAULT_PRECISION);
+    eval_context_init(&b, DEFAULT_PRECISION);
+    a.strict_mode = 1;
+
+    ASTNode *div = test_parse_at("1/0", 0);
+    ASTNode *domain = test_parse_at("sqrt(-1)", 0);
+    TEST_ASSERT(div && domain, "Expressions should parse");
+
+    mpfr_t result;
+    mpfr_init2(result, DEFAULT_PRECISION);
+
+    evaluator_clear_error();
+    evaluator_eval_ctx(&a, result, div);
+    TEST_ASSERT(eval_context_get_error(&a) != NULL, "Division by zero should be reported");
+    TEST_ASSERT(eval_context_get_error(&b) == NULL, "Other contexts should not see the error");
+    TEST_ASSERT(evaluator_get_last_error() == NULL, "The default context should not see the error");
+
+    evaluator_eval_ctx(&a, result, domain);
+    int strict_error = eval_context_get_error(&a) != NULL;
+    evaluator_eval_ctx(&b, result, domain);
+    int lenient_error = eval_context_get_error(&b) != NULL;
+    TEST_ASSERT(strict_error, "Strict context should report domain errors");
+    TEST_ASSERT(!lenient_error, "Non-strict context should not report domain errors");
+    TEST_ASSERT(b.function_error[0] != '\0', "Function error should land in its context");
+    TEST_ASSERT(functions_get_last_error() == NULL, "Global function error should be untouched");
+    TEST_ASSERT(!evaluator_get_strict_mode(), "Global strict mode should be untouched");
+
+    mpfr_clear(result);
+    ast_free(div);
+    ast_free(domain);
+    eval_context_cleanup(&a);
+    eval_context_cleanup(&b);
+
+    printf("  ✅ Context isolation tests passed\n");
+    return 1;
+}
+
+// Format a value into a fixed buffer
+static void context_test_format(const EvalContext *ctx, const mpfr_t value, char *buffer, size_t size)
+{
+    FILE *out = tmpfile();
+    buffer[0] = '\0';
+    if (!out)
+    {
+        return;
+    }
+    formatter_fprint_value_ctx(ctx, out, value, 0);
+    rewind(out);
+    size_t length = fread(buffer, 1, size - 1, out);
+    buffer[length] = '\0';
+    fclose(out);
+}
+
+int test_context_formatting(void)
+{
+    printf("Testing context formatting...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 64);
+
+    mpfr_t third;
+    mpfr_init2(third, 64);
+    mpfr_set_ui(third, 1, MPFR_RNDN);
+    mpfr_div_ui(third, third, 3, MPFR_RNDN);
+
+    char buffer[128];
+    context_test_format(&ctx, third, buffer, sizeof(buffer));
+    TEST_ASSERT(strcmp(buffer, "0.3333333333333333333") == 0, "64-bit context should print 19 digits");
+
+    ctx.format.max_decimal_places = 5;
+    context_test_format(&ctx, third, buffer, sizeof(buffer));
+    TEST_ASSERT(strcmp(buffer, "0.33333") == 0, "Context should cap decimal places");
+
+    ctx.format.mode = FORMAT_SCIENTIFIC;
+    mpfr_mul_ui(third, third, 30000000, MPFR_RNDN);
+    context_test_format(&ctx, third, buffer, sizeof(buffer));
+    TEST_ASSERT(strcmp(buffer, "1e7") == 0, "Context should use its own display mode");
+    TEST_ASSERT(formatter_get_default_mode() == FORMAT_SMART, "Global display mode should be untouched");
+
+    mpfr_clear(third);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Context formatting tests passed\n");
+    return 1;
+}
+
+typedef struct
+{
+    mpfr_prec_t precision;
+    int ok;
+} ContextThreadJob;
+
+static void *context_test_thread(void *arg)
+{
+    ContextThreadJob *job = arg;
+    EvalContext ctx;
+    eval_context_init(&ctx, job->precision);
+
+    ASTNode *ast = test_parse_at("pi * e + sqrt(0.5)", job->precision);
+    mpfr_t result, first;
+    mpfr_init2(result, job->precision);
+    mpfr_init2(first, job->precision);
+
+    job->ok = ast != NULL;
+    for (int i = 0; i < 200 && job->ok; i++)
+    {
+        evaluator_eval_ctx(&ctx, result, ast);
+        if (i == 0)
+        {
+            mpfr_set(first, result, MPFR_RNDN);
+        }
+        job->ok = !eval_context_get_error(&ctx) && mpfr_equal_p(result, first);
+    }
+
+    mpfr_clears(result, first, (mpfr_ptr)0);
+    ast_free(ast);
+    eval_context_cleanup(&ctx);
+    mpfr_free_cache();
+    return NULL;
+}
+
+int test_context_threads(void)
+{
+    printf("Testing contexts on concurrent threads...\n");
+
+    ContextThreadJob jobs[4] = {{53, 0}, {200, 0}, {777, 0}, {2048, 0}};
+    pthread_t threads[4];
+    int started = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (pthread_create(&threads[i], NULL, context_test_thread, &jobs[i]) == 0)
+        {
+            started++;
+        }
+        else
+        {
+            context_test_thread(&jobs[i]);
+        }
+    }
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT(jobs[i].ok, "Each thread should get stable results in its own context");
+    }
+
+    printf("  ✅ Context thread tests passed\n");
+    return 1;
+}
+
+int run_context_tests(void)
+{
+    printf("Running Context Test Suite\n");
+    printf("==========================\n\n");
+
+    precision_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_context_precisions())
+        passed++;
+    total++;
+    if (test_context_isolation())
+        passed++;
+    total++;
+    if (test_context_formatting())
+        passed++;
+    total++;
+    if (test_context_threads())
+        passed++;
+
+    printf("\n==========================\n");
+    printf("Context Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -1,11 +1,15 @@
 #include "evaluator.h"
+#include "context.h"
 #include "parser.h"
 #include "lexer.h"
 #include "precision.h"
 #include "constants.h"
 #include "functions.h"
+#include "test_parse.h"
 #include "function_table.h" // Added for function_table_init()
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #define EPSILON 1e-9
@@ -331,6 +335,451 @@ int test_evaluator_implicit_multiplication(void)
     return 1;
 }
 
+int test_evaluator_scratch_pool(void)
+{
+    printf("Testing evaluator scratch pool...\n");
+
+    // Nest deeper than the pool's initial size so it has to grow mid-evaluation
+    char deep[256];
+    int length = 0;
+    for (int i = 0; i < 40; i++)
+    {
+        length += snprintf(deep + length, sizeof(deep) - length, "1+(");
+    }
+    deep[length++] = '0';
+    for (int i = 0; i < 40; i++)
+    {
+        deep[length++] = ')';
+    }
+    deep[length] = '\0';
+
+    int success;
+    double result = eval_test_expression(deep, &success);
+    TEST_ASSERT(success, "Deep expression should evaluate successfully");
+    TEST_ASSERT_DOUBLE_EQ(result, 40.0, "Deeply nested sum");
+
+    result = eval_test_expression("sqrt(sqrt(sqrt(sqrt(sqrt(sqrt(sqrt(sqrt(256))))))))", &success);
+    TEST_ASSERT(success, "Nested functions should evaluate successfully");
+    TEST_ASSERT_DOUBLE_EQ(result, pow(256.0, 1.0 / 256.0), "Nested function calls");
+
+    // The pool must follow precision changes in both directions
+    mpfr_prec_t precisions[] = {512, 53, 256};
+    for (int p = 0; p < 3; p++)
+    {
+        set_precision(precisions[p]);
+
+        Lexer lexer;
+        lexer_init(&lexer, "1/3");
+        Parser parser;
+        parser_init(&parser, &lexer);
+        ASTNode *ast = parser_parse_expression(&parser);
+        TEST_ASSERT(ast != NULL, "Expression should parse");
+
+        mpfr_t actual, expected;
+        mpfr_init2(actual, global_precision);
+        mpfr_init2(expected, global_precision);
+        evaluator_eval(actual, ast);
+        mpfr_set_ui(expected, 3, global_rounding);
+        mpfr_ui_div(expected, 1, expected, global_rounding);
+
+        int equal = mpfr_equal_p(actual, expected);
+        mpfr_clear(actual);
+        mpfr_clear(expected);
+        ast_free(ast);
+        TEST_ASSERT(equal, "Result should be correctly rounded at the new precision");
+    }
+    set_precision(DEFAULT_PRECISION);
+
+    // Releasing the pool leaves the evaluator usable
+    evaluator_cleanup();
+    result = eval_test_expression("2*(3+4)", &success);
+    TEST_ASSERT(success, "Expression should evaluate after cleanup");
+    TEST_ASSERT_DOUBLE_EQ(result, 14.0, "Evaluation after cleanup");
+
+    printf("  ✅ Scratch pool tests passed\n");
+    return 1;
+}
+
+int test_evaluator_adaptive(void)
+{
+    printf("Testing adaptive precision...\n");
+
+    static const char *corpus[] = {
+        "sqrt(2) + sin(3) * exp(1/7)",
+        "(2^300 + pi) - 2^300",
+        "atan2(exp(1), pow(2, sqrt(2)))",
+        "log(10) / log(2) - 3.3",
+        "tan(1.5) * cosh(2) - asin(0.5)",
+        "floor(100 * pi) + acos(0.25) - atanh(0.5)",
+        "(1 + 2^-80)^(2^80)",
+        "1e-20 * sinh(0.001) - log10(7)",
+    };
+    const mpfr_prec_t precisions[] = {53, 113, 256};
+    const mpfr_rnd_t modes[] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU};
+
+    EvalContext ctx;
+    EvalContext reference;
+    eval_context_init(&ctx, DEFAULT_PRECISION);
+    eval_context_init(&reference, DEFAULT_PRECISION);
+    ctx.adaptive = 1;
+    ctx.native = 0; // Exercise the MPFR passes even at 53 bits
+    ctx.exact = 0;  // and for integer expressions
+    reference.native = 0;
+
+    mpfr_t actual, expected, wide;
+    mpfr_inits2(DEFAULT_PRECISION, actual, expected, wide, (mpfr_ptr)0);
+
+    // Results match a much wider fixed evaluation of the same tree, correctly
+    // rounded in each mode
+    for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++)
+    {
+        ASTNode *ast = test_parse(corpus[i]);
+        TEST_ASSERT(ast != NULL, "Corpus expression should parse");
+        for (size_t p = 0; p < sizeof(precisions) / sizeof(precisions[0]); p++)
+        {
+            eval_context_set_precision(&reference, precisions[p] + 1000);
+            mpfr_set_prec(wide, precisions[p] + 1000);
+            evaluator_eval_ctx(&reference, wide, ast);
+
+            for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+            {
+                eval_context_set_precision(&ctx, precisions[p]);
+                ctx.rounding = modes[m];
+                mpfr_set_prec(actual, precisions[p]);
+                mpfr_set_prec(expected, precisions[p]);
+                evaluator_eval_ctx(&ctx, actual, ast);
+                mpfr_set(expected, wide, modes[m]);
+
+                if (!mpfr_equal_p(actual, expected))
+                {
+                    printf("    expression: %s (%ld bits)\n", corpus[i], (long)precisions[p]);
+                    ast_free(ast);
+                    TEST_ASSERT(0, "Adaptive result should be correctly rounded");
+                }
+            }
+        }
+        ast_free(ast);
+    }
+
+    // Cancellation beyond the fixed boost loses everything in the fixed mode.
+    // The product keeps the sum from joining the difference, which would
+    // round it only once.
+    ASTNode *cancel = test_parse("2*(2^300 + pi) - 2^301");
+    eval_context_set_precision(&ctx, 53);
+    eval_context_set_precision(&reference, 53);
+    ctx.rounding = MPFR_RNDN;
+    mpfr_set_prec(actual, 53);
+    mpfr_set_prec(expected, 53);
+    evaluator_eval_ctx(&reference, expected, cancel);
+    evaluator_eval_ctx(&ctx, actual, cancel);
+    int fixed_lost = mpfr_zero_p(expected);
+    int retried = ctx.adaptive_passes > 1;
+    mpfr_const_pi(expected, MPFR_RNDN);
+    mpfr_mul_2ui(expected, expected, 1, MPFR_RNDN);
+    int adaptive_kept = mpfr_equal_p(actual, expected);
+    ast_free(cancel);
+    TEST_ASSERT(fixed_lost, "Fixed boost should lose pi to cancellation");
+    TEST_ASSERT(adaptive_kept && retried, "Adaptive precision should recover 2pi");
+
+    // Simple expressions settle in one pass
+    ASTNode *simple = test_parse("1/3 + 2/7");
+    evaluator_eval_ctx(&ctx, actual, simple);
+    ast_free(simple);
+    TEST_ASSERT(ctx.adaptive_passes == 1, "Simple expression should need one pass");
+
+    // Exact zeros never settle but still come out as zero, and errors stay errors
+    ASTNode *zero = test_parse("sin(pi)");
+    evaluator_eval_ctx(&ctx, actual, zero);
+    ast_free(zero);
+    TEST_ASSERT(mpfr_zero_p(actual) && !eval_context_get_error(&ctx), "sin(pi) should be 0");
+
+    ASTNode *div = test_parse("1/(2 - 2)");
+    evaluator_eval_ctx(&ctx, actual, div);
+    ast_free(div);
+    TEST_ASSERT(eval_context_get_error(&ctx) != NULL && ctx.adaptive_passes == 1,
+                "Division by zero should be reported without retrying");
+
+    // Non-finite intermediate values have no exponent to bound errors with,
+    // and give what the fixed evaluator gives
+    const char *non_finite[] = {"1/(-2)^0.5", "1/(0^-1)", "2^(1/0^-1)", "sqrt(0^-1)", "0^(1/3)"};
+    for (size_t i = 0; i < sizeof(non_finite) / sizeof(non_finite[0]); i++)
+    {
+        ASTNode *ast = test_parse(non_finite[i]);
+        evaluator_eval_ctx(&ctx, actual, ast);
+        ctx.adaptive = 0;
+        evaluator_eval_ctx(&ctx, expected, ast);
+        ctx.adaptive = 1;
+        ast_free(ast);
+        TEST_ASSERT(mpfr_equal_p(actual, expected) ||
+                        (mpfr_nan_p(actual) && mpfr_nan_p(expected)),
+                    "Non-finite intermediate values should evaluate as without adaptivity");
+    }
+
+    mpfr_clears(actual, expected, wide, (mpfr_ptr)0);
+    eval_context_cleanup(&ctx);
+    eval_context_cleanup(&reference);
+
+    printf("  ✅ Adaptive precision tests passed\n");
+    return 1;
+}
+
+// Evaluate an expression under a budget, reporting whether it was stopped
+static int budget_test_stopped(EvalContext *ctx, const char *input, const char *reason)
+{
+    ASTNode *ast = test_parse(input);
+    mpfr_t result;
+    mpfr_init2(result, ctx->precision);
+    evaluator_eval_ctx(ctx, result, ast);
+    const char *error = eval_context_get_error(ctx);
+    int stopped = error && strstr(error, reason) && mpfr_nan_p(result);
+    mpfr_clear(result);
+    ast_free(ast);
+    return stopped;
+}
+
+int test_evaluator_budget(void)
+{
+    printf("Testing evaluation budgets...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 256);
+    ctx.native = 0;
+
+    TEST_ASSERT(!budget_test_stopped(&ctx, "1+2+3+4", "Budget"), "No budget should mean no limit");
+
+    ctx.budget.max_operations = 2;
+    TEST_ASSERT(budget_test_stopped(&ctx, "1+2+3+4", "Budget exceeded"),
+                "Too many operations should stop the evaluation");
+    TEST_ASSERT(!budget_test_stopped(&ctx, "1+2+3", "Budget"), "The count should restart");
+    ctx.adaptive = 1;
+    TEST_ASSERT(budget_test_stopped(&ctx, "sin(1)*cos(1)", "Budget exceeded"),
+                "Adaptive passes should count against the budget");
+    ctx.adaptive = 0;
+    ctx.budget.max_operations = 0;
+
+    ctx.budget.max_exponent = 1000;
+    TEST_ASSERT(budget_test_stopped(&ctx, "2^2000 - 2^2000", "Budget exceeded"),
+                "Huge intermediate values should stop the evaluation");
+    TEST_ASSERT(budget_test_stopped(&ctx, "1/2^2000", "Budget exceeded"),
+                "Tiny values count as well");
+    TEST_ASSERT(!budget_test_stopped(&ctx, "2^999", "Budget"), "Values in range should pass");
+    ctx.budget.max_exponent = 0;
+
+    ctx.budget.seconds = 1e-9;
+    TEST_ASSERT(budget_test_stopped(&ctx, "sqrt(2)*sqrt(3)*sqrt(5)", "Budget exceeded"),
+                "Slow evaluations should stop");
+    ctx.budget.seconds = 0;
+
+    // Strict mode errors from the abandoned tree do not hide the reason
+    ctx.strict_mode = 1;
+    evaluator_cancel();
+    TEST_ASSERT(budget_test_stopped(&ctx, "sqrt(2)+log(3)", "interrupted"),
+                "Cancelled evaluations should say so");
+    evaluator_clear_cancel();
+    TEST_ASSERT(!budget_test_stopped(&ctx, "sqrt(2)+log(3)", "interrupted"),
+                "Evaluations should run again after clearing the cancel");
+
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Evaluation budget tests passed\n");
+    return 1;
+}
+
+// Bit-identical values with the same sign of ternary value
+static int lowering_same(mpfr_srcptr a, int ta, mpfr_srcptr b, int tb)
+{
+    int same_value = (mpfr_nan_p(a) && mpfr_nan_p(b)) ||
+                     (mpfr_equal_p(a, b) && mpfr_signbit(a) == mpfr_signbit(b)) ||
+                     (mpfr_inf_p(a) && mpfr_inf_p(b) && mpfr_signbit(a) == mpfr_signbit(b));
+    return same_value && (ta > 0) == (tb > 0) && (ta < 0) == (tb < 0);
+}
+
+// Special values, powers of two, integers and ordinary values
+static void lowering_value(mpfr_t value, int which)
+{
+    static const char *values[] = {"0", "1", "-1", "2", "-2", "0.5", "-0.5", "3", "-3", "7",
+                                   "-8", "17", "1.5", "0.1", "-2.75", "1e100", "123456789"};
+    const int count = sizeof(values) / sizeof(values[0]);
+    if (which < count)
+    {
+        mpfr_set_str(value, values[which], 10, MPFR_RNDN);
+        return;
+    }
+    switch (which - count)
+    {
+    case 0:
+        mpfr_set_zero(value, -1);
+        break;
+    case 1:
+        mpfr_set_inf(value, 1);
+        break;
+    case 2:
+        mpfr_set_inf(value, -1);
+        break;
+    case 3:
+        mpfr_set_nan(value);
+        break;
+    case 4:
+        mpfr_const_pi(value, MPFR_RNDN);
+        break;
+    case 5:
+        mpfr_set_ui_2exp(value, 3, mpfr_get_emax() - 3, MPFR_RNDN); // Overflows when squared
+        break;
+    case 6:
+        mpfr_set_si_2exp(value, -1, mpfr_get_emin() + 4, MPFR_RNDN); // Underflows when squared
+        break;
+    default:
+        mpfr_set_ui_2exp(value, 1, 70, MPFR_RNDN); // Integer beyond a long
+        mpfr_neg(value, value, MPFR_RNDN);
+    }
+}
+
+#define LOWERING_VALUES 25
+
+int test_evaluator_strength_reduction(void)
+{
+    printf("Testing cheaper primitives for powers, products and quotients...\n");
+
+    const mpfr_prec_t precisions[] = {53, 64, 65, 256, 2048};
+    const mpfr_rnd_t roundings[] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD, MPFR_RNDA};
+    mpfr_t x, y, expected, actual;
+    mpfr_inits2(256, x, y, (mpfr_ptr)0);
+    mpfr_inits2(53, expected, actual, (mpfr_ptr)0);
+    for (int p = 0; p < 5; p++)
+    {
+        mpfr_set_prec(expected, precisions[p]);
+        mpfr_set_prec(actual, precisions[p]);
+        for (int i = 0; i < LOWERING_VALUES; i++)
+        {
+            for (int j = 0; j < LOWERING_VALUES; j++)
+            {
+                lowering_value(x, i);
+                lowering_value(y, j);
+                for (int r = 0; r < 5; r++)
+                {
+                    mpfr_rnd_t rnd = roundings[r];
+                    int te = mpfr_pow(expected, x, y, rnd);
+                    int ta = functions_pow(actual, x, y, rnd);
+                    if (!lowering_same(expected, te, actual, ta))
+                        mpfr_printf("  pow(%Rg, %Rg) at %ld bits\n", x, y, (long)precisions[p]);
+                    TEST_ASSERT(lowering_same(expected, te, actual, ta), "Powers should match");
+
+                    te = mpfr_mul(expected, x, y, rnd);
+                    ta = functions_mul(actual, x, y, rnd);
+                    if (!lowering_same(expected, te, actual, ta))
+                        mpfr_printf("  %Rg * %Rg at %ld bits\n", x, y, (long)precisions[p]);
+                    TEST_ASSERT(lowering_same(expected, te, actual, ta), "Products should match");
+
+                    te = mpfr_div(expected, x, y, rnd);
+                    ta = functions_div(actual, x, y, rnd);
+                    if (!lowering_same(expected, te, actual, ta))
+                        mpfr_printf("  %Rg / %Rg at %ld bits\n", x, y, (long)precisions[p]);
+                    TEST_ASSERT(lowering_same(expected, te, actual, ta), "Quotients should match");
+                }
+
+                // Squares of equal operands
+                mpfr_set(y, x, MPFR_RNDN);
+                int te = mpfr_mul(expected, x, y, MPFR_RNDN);
+                int ta = functions_mul(actual, x, y, MPFR_RNDN);
+                TEST_ASSERT(lowering_same(expected, te, actual, ta), "Squares should match");
+            }
+        }
+    }
+    mpfr_clears(x, y, expected, actual, (mpfr_ptr)0);
+
+    // Through the evaluator, in both modes
+    int success;
+    set_precision(256);
+    TEST_ASSERT_DOUBLE_EQ(eval_test_expression("16^0.5 + 4^-0.5 + 2^-1 + 3^2 + 2^10 / 8", &success),
+                          4.0 + 0.5 + 0.5 + 9.0 + 128.0, "Lowered operations should evaluate");
+    evaluator_set_adaptive(1);
+    TEST_ASSERT_DOUBLE_EQ(eval_test_expression("(1/3)^3 * 27 + 10/4 * 2", &success), 6.0,
+                          "Lowered operations should evaluate adaptively");
+    evaluator_set_adaptive(0);
+    set_precision(DEFAULT_PRECISION);
+
+    printf("  ✅ Cheaper primitive tests passed\n");
+    return 1;
+}
+
+int test_evaluator_nary(void)
+{
+    printf("Testing n-ary sums and products...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 53);
+    ctx.native = 0;
+    ctx.exact = 0;
+    mpfr_t actual, expected;
+    mpfr_inits2(53, actual, expected, (mpfr_ptr)0);
+    mpfr_const_pi(expected, MPFR_RNDN);
+
+    // A sum is rounded once, so cancellation between its terms loses nothing
+    ASTNode *ast = test_parse("2^300 + pi - 2^300");
+    evaluator_eval_ctx(&ctx, actual, ast);
+    TEST_ASSERT(mpfr_equal_p(actual, expected), "Cancelling terms should leave pi");
+    ctx.adaptive = 1;
+    evaluator_eval_ctx(&ctx, actual, ast);
+    TEST_ASSERT(mpfr_equal_p(actual, expected) && ctx.adaptive_passes == 1,
+                "Adaptive sum should settle in one pass");
+    ctx.adaptive = 0;
+    ctx.interval = 1;
+    evaluator_eval_ctx(&ctx, actual, ast);
+    mpfr_srcptr lo;
+    mpfr_srcptr hi;
+    TEST_ASSERT(evaluator_interval_bounds(&ctx, &lo, &hi), "Interval sum should give bounds");
+    TEST_ASSERT(mpfr_cmp(lo, expected) <= 0 && mpfr_cmp(hi, expected) >= 0,
+                "Interval sum should enclose pi");
+    ctx.interval = 0;
+    ast_free(ast);
+
+    // Products against a much more precise evaluation
+    EvalContext reference;
+    eval_context_init(&reference, 1024);
+    mpfr_set_prec(expected, 1024);
+    ast = test_parse("1.1 * 2.2 * sqrt(3) * 4.4 * 5.5");
+    evaluator_eval_ctx(&ctx, actual, ast);
+    evaluator_eval_ctx(&reference, expected, ast);
+    mpfr_sub(expected, expected, actual, MPFR_RNDN);
+    mpfr_div(expected, expected, actual, MPFR_RNDN);
+    TEST_ASSERT(mpfr_cmp_d(expected, 0x1p-52) < 0 && mpfr_cmp_d(expected, -0x1p-52) > 0,
+                "Product should be accurate");
+    ast_free(ast);
+    eval_context_cleanup(&reference);
+
+    // A long sum needs no deeper scratch pool than one of two terms. It is
+    // longer than lexer_init() accepts.
+    int terms = 20000;
+    size_t length = (size_t)terms * 4 - 1;
+    char *chain = malloc(length + 1);
+    TEST_ASSERT(chain != NULL, "Input should be built");
+    for (int i = 0; i < terms; i++)
+    {
+        memcpy(chain + 4 * i, "0.5+", 4);
+    }
+    chain[length] = '\0';
+    Lexer lexer;
+    lexer_init_length(&lexer, chain, length);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    ast = parser_parse_expression(&parser);
+    TEST_ASSERT(!parser_has_error(&parser), "Long sum should parse without errors");
+    token_free(&parser.previous_token);
+    token_free(&parser.current_token);
+    free(chain);
+    TEST_ASSERT(ast != NULL, "Long sum should parse");
+    evaluator_release_scratch(&ctx);
+    evaluator_eval_ctx(&ctx, actual, ast);
+    TEST_ASSERT(mpfr_cmp_ui(actual, (unsigned long)terms / 2) == 0, "Long sum should be exact");
+    TEST_ASSERT(ctx.scratch_count <= 2, "Long sum should stay shallow");
+    ast_free(ast);
+
+    mpfr_clears(actual, expected, (mpfr_ptr)0);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ N-ary node tests passed\n");
+    return 1;
+}
+
 int run_evaluator_tests(void)
 {
     printf("Running Evaluator Test Suite\n");
@@ -372,11 +821,27 @@ int run_evaluator_tests(void)
     total++;
     if (test_evaluator_implicit_multiplication())
         passed++;
+    total++;
+    if (test_evaluator_scratch_pool())
+        passed++;
+    total++;
+    if (test_evaluator_adaptive())
+        passed++;
+    total++;
+    if (test_evaluator_budget())
+        passed++;
+    total++;
+    if (test_evaluator_strength_reduction())
+        passed++;
+    total++;
+    if (test_evaluator_nary())
+        passed++;
 
     printf("\n============================\n");
     printf("Evaluator Tests: %d/%d passed\n", passed, total);
 
     // Cleanup
+    evaluator_cleanup();
     constants_cleanup();
     functions_cleanup();
     precision_cleanup();
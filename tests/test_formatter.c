@@ -0,0 +1,196 @@
+#include "formatter.h"
+#include "context.h"
+#include "precision.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Format a decimal string in a context and compare with the expected text
+static int formatter_test_is(EvalContext *ctx, const char *input, NumberFormat format,
+                             const char *expected)
+{
+    FormatBuffer buffer;
+    format_buffer_init(&buffer);
+    mpfr_t value;
+    mpfr_init2(value, ctx->precision);
+    mpfr_set_str(value, input, 10, MPFR_RNDN);
+
+    int ok = formatter_format_number_ctx(ctx, &buffer, value, format) &&
+             strcmp(buffer.data, expected) == 0 && buffer.length == strlen(expected);
+    if (!ok)
+    {
+        printf("  %s formatted as \"%s\", expected \"%s\"\n", input,
+               buffer.data ? buffer.data : "", expected);
+    }
+
+    mpfr_clear(value);
+    format_buffer_free(&buffer);
+    return ok;
+}
+
+int test_formatter_modes(void)
+{
+    printf("Testing formatter modes...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 64);
+
+    TEST_ASSERT(formatter_test_is(&ctx, "0", FORMAT_SMART, "0"), "Zero should print bare");
+    TEST_ASSERT(formatter_test_is(&ctx, "12345", FORMAT_SMART, "12345"), "Integers stay whole");
+    TEST_ASSERT(formatter_test_is(&ctx, "-2.5", FORMAT_SMART, "-2.5"), "Signs should print");
+    TEST_ASSERT(formatter_test_is(&ctx, "0.00001", FORMAT_SMART, "0.00001"),
+                "Small values should get leading zeros");
+    TEST_ASSERT(formatter_test_is(&ctx, "1.5e20", FORMAT_SMART, "150000000000000000000"),
+                "Large values should get trailing zeros");
+    TEST_ASSERT(formatter_test_is(&ctx, "1e600", FORMAT_SMART, "1e600"),
+                "Long zero runs should switch to scientific notation");
+    TEST_ASSERT(formatter_test_is(&ctx, "12345", FORMAT_SCIENTIFIC, "1.2345e4"),
+                "Scientific notation should drop trailing zeros");
+    TEST_ASSERT(formatter_test_is(&ctx, "-0.000125", FORMAT_SCIENTIFIC, "-1.25e-4"),
+                "Negative exponents should print");
+    TEST_ASSERT(formatter_test_is(&ctx, "25", FORMAT_SCIENTIFIC, "25"),
+                "Small exponents should read normally");
+
+    // Non-finite values read the same in every mode
+    NumberFormat modes[] = {FORMAT_SMART, FORMAT_SCIENTIFIC, FORMAT_FIXED, FORMAT_AUTO};
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        TEST_ASSERT(formatter_test_is(&ctx, "@NaN@", modes[i], "nan"), "NaN should print nan");
+        TEST_ASSERT(formatter_test_is(&ctx, "@Inf@", modes[i], "inf"), "Infinity should print");
+        TEST_ASSERT(formatter_test_is(&ctx, "-@Inf@", modes[i], "-inf"),
+                    "Negative infinity should print");
+    }
+
+    ctx.format.max_decimal_places = 3;
+    TEST_ASSERT(formatter_test_is(&ctx, "1.5", FORMAT_FIXED, "1.500"),
+                "Fixed notation should pad to the decimal places");
+    TEST_ASSERT(formatter_test_is(&ctx, "3.14159", FORMAT_SMART, "3.14"),
+                "Decimal places should cap the digits");
+
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Formatter mode tests passed\n");
+    return 1;
+}
+
+int test_formatter_thresholds(void)
+{
+    printf("Testing formatter thresholds...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 64);
+
+    // Both signs compare by magnitude
+    TEST_ASSERT(formatter_test_is(&ctx, "1e-7", FORMAT_AUTO, "1e-7"), "Tiny values go scientific");
+    TEST_ASSERT(formatter_test_is(&ctx, "-1e-7", FORMAT_AUTO, "-1e-7"),
+                "Tiny negative values go scientific");
+    TEST_ASSERT(formatter_test_is(&ctx, "-1e16", FORMAT_AUTO, "-1e16"),
+                "Huge negative values go scientific");
+    TEST_ASSERT(formatter_test_is(&ctx, "-0.5", FORMAT_AUTO, "-0.5"), "Others stay normal");
+    TEST_ASSERT(formatter_test_is(&ctx, "1e15", FORMAT_AUTO, "1000000000000000"),
+                "The threshold itself stays normal");
+
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Formatter threshold tests passed\n");
+    return 1;
+}
+
+int test_formatter_buffers(void)
+{
+    printf("Testing formatter buffers...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 256);
+    mpfr_t value;
+    mpfr_init2(value, 256);
+    mpfr_const_pi(value, MPFR_RNDN);
+
+    // Values append, so one buffer can hold a whole line
+    FormatBuffer buffer;
+    format_buffer_init(&buffer);
+    for (int i = 0; i < 100; i++)
+    {
+        TEST_ASSERT(formatter_format_value_ctx(&ctx, &buffer, value, 0), "Values should append");
+        TEST_ASSERT(format_buffer_append_char(&buffer, ' '), "Characters should append");
+    }
+    TEST_ASSERT(buffer.length == strlen(buffer.data), "Length should track the text");
+    TEST_ASSERT(strncmp(buffer.data, "3.14159265358979", 16) == 0, "Text should start with pi");
+    size_t line_length = buffer.length;
+
+    // A reset buffer keeps its memory and gives the same text again
+    size_t capacity = buffer.capacity;
+    format_buffer_reset(&buffer);
+    TEST_ASSERT(buffer.length == 0 && buffer.data[0] == '\0', "Reset should empty the buffer");
+    for (int i = 0; i < 100; i++)
+    {
+        formatter_format_value_ctx(&ctx, &buffer, value, 0);
+        format_buffer_append_char(&buffer, ' ');
+    }
+    TEST_ASSERT(buffer.length == line_length && buffer.capacity == capacity,
+                "Reusing a buffer should not grow it");
+
+    // Streams get the same text as buffers
+    FILE *out = tmpfile();
+    TEST_ASSERT(out, "Temporary file should open");
+    formatter_fprint_value_ctx(&ctx, out, value, 0);
+    char text[256];
+    rewind(out);
+    text[fread(text, 1, sizeof(text) - 1, out)] = '\0';
+    fclose(out);
+    format_buffer_reset(&buffer);
+    formatter_format_value_ctx(&ctx, &buffer, value, 0);
+    TEST_ASSERT(strcmp(text, buffer.data) == 0, "Streams and buffers should agree");
+    format_buffer_free(&buffer);
+    TEST_ASSERT(!buffer.data && buffer.capacity == 0, "Freed buffers should be empty");
+
+    // formatter_to_string uses the global settings
+    char *string = formatter_to_string(value, FORMAT_SCIENTIFIC);
+    TEST_ASSERT(string && strncmp(string, "3.14159", 7) == 0, "to_string should format");
+    free(string);
+    mpfr_set_ui(value, 0, MPFR_RNDN);
+    string = formatter_to_string(value, FORMAT_SMART);
+    TEST_ASSERT(string && strcmp(string, "0") == 0, "to_string should format zero");
+    free(string);
+
+    mpfr_clear(value);
+    eval_context_cleanup(&ctx);
+    formatter_cleanup();
+    printf("  ✅ Formatter buffer tests passed\n");
+    return 1;
+}
+
+int run_formatter_tests(void)
+{
+    printf("Running Formatter Test Suite\n");
+    printf("============================\n\n");
+
+    precision_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_formatter_modes())
+        passed++;
+    total++;
+    if (test_formatter_thresholds())
+        passed++;
+    total++;
+    if (test_formatter_buffers())
+        passed++;
+
+    printf("\n============================\n");
+    printf("Formatter Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,264 @@
+#include "precision.h"
+#include "context.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// About 120000 digits, more than a stream chunk
+#define HUGE_TEST_PRECISION 400000
+
+// Evaluate an expression in a context
+static int huge_test_eval(EvalContext *ctx, mpfr_t result, const char *expression)
+{
+    ASTNode *ast = test_parse(expression);
+    if (!ast)
+    {
+        return 0;
+    }
+    evaluator_eval_ctx(ctx, result, ast);
+    ast_free(ast);
+    return 1;
+}
+
+// Read a whole stream back
+static char *huge_test_read(FILE *file)
+{
+    long length = ftell(file);
+    char *text = length >= 0 ? malloc((size_t)length + 1) : NULL;
+    rewind(file);
+    if (text && fread(text, 1, (size_t)length, file) != (size_t)length)
+    {
+        free(text);
+        return NULL;
+    }
+    if (text)
+    {
+        text[length] = '\0';
+    }
+    return text;
+}
+
+typedef struct
+{
+    long calls;
+    long last_done;
+    long total;
+} ProgressLog;
+
+static void huge_test_progress(void *data, long done, long total, double seconds)
+{
+    ProgressLog *log = data;
+    log->calls++;
+    log->last_done = done;
+    log->total = total;
+    (void)seconds;
+}
+
+int test_huge_precision_cap(void)
+{
+    printf("Testing the huge precision cap...\n");
+
+    mpfr_prec_t saved_precision = global_precision;
+    TEST_ASSERT(!precision_get_huge(), "Huge precision should start off");
+    set_precision(MAX_PRECISION * 4);
+    TEST_ASSERT(get_precision() == MAX_PRECISION, "Without huge mode the cap should hold");
+
+    precision_set_huge(1);
+    TEST_ASSERT(precision_max() == HUGE_MAX_PRECISION, "Huge mode should raise the cap");
+    set_precision(MAX_PRECISION * 4);
+    TEST_ASSERT(get_precision() == MAX_PRECISION * 4, "Huge precisions should be accepted");
+    EvalContext ctx;
+    eval_context_init(&ctx, HUGE_MAX_PRECISION * 2);
+    TEST_ASSERT(ctx.precision == HUGE_MAX_PRECISION, "Contexts should clamp to the huge cap");
+    eval_context_cleanup(&ctx);
+
+    precision_set_huge(0);
+    TEST_ASSERT(get_precision() == MAX_PRECISION, "Leaving huge mode should clamp back");
+    set_precision(saved_precision);
+
+    printf("  ✅ Huge precision cap tests passed\n");
+    return 1;
+}
+
+int test_huge_memory_limit(void)
+{
+    printf("Testing the huge precision memory limit...\n");
+
+    precision_set_huge(1);
+    EvalContext ctx;
+    eval_context_init(&ctx, 1L << 24);
+    ASTNode *ast = test_parse("sqrt(2)*(1+pi)");
+    TEST_ASSERT(ast != NULL, "Expression should parse");
+
+    size_t estimate = evaluator_estimate_memory(&ctx, ast);
+    size_t value_bytes = precision_value_bytes(ctx.precision);
+    TEST_ASSERT(estimate > 8 * value_bytes, "The estimate should count the scratch values");
+    TEST_ASSERT(estimate < 256 * value_bytes, "The estimate should stay in proportion");
+
+    precision_set_memory_limit(estimate / 2);
+    mpfr_t result;
+    mpfr_init2(result, ctx.precision);
+    evaluator_eval_ctx(&ctx, result, ast);
+    const char *error = eval_context_get_error(&ctx);
+    TEST_ASSERT(error && strstr(error, "Not enough memory"), "Evaluations too big should fail");
+    TEST_ASSERT(mpfr_nan_p(result), "A refused evaluation should give NaN");
+    TEST_ASSERT(ctx.scratch_count == 0, "Nothing should be allocated for a refused evaluation");
+    mpfr_clear(result);
+
+    // The limit only applies above the normal cap
+    eval_context_set_precision(&ctx, MAX_PRECISION);
+    precision_set_memory_limit(1);
+    mpfr_init2(result, ctx.precision);
+    evaluator_eval_ctx(&ctx, result, ast);
+    TEST_ASSERT(!eval_context_get_error(&ctx), "Normal precisions should not be limited");
+    mpfr_clear(result);
+
+    precision_set_memory_limit(0);
+    ast_free(ast);
+    eval_context_cleanup(&ctx);
+    precision_set_huge(0);
+
+    printf("  ✅ Huge precision memory limit tests passed\n");
+    return 1;
+}
+
+int test_huge_evaluation(void)
+{
+    printf("Testing huge precision evaluation and progress...\n");
+
+    precision_set_huge(1);
+    EvalContext ctx;
+    eval_context_init(&ctx, HUGE_TEST_PRECISION);
+    ctx.native = 0;
+    ctx.exact = 0;
+    ProgressLog log = {0, 0, 0};
+    ctx.progress = huge_test_progress;
+    ctx.progress_data = &log;
+    ctx.progress_interval = 0;
+
+    mpfr_t result, expected;
+    mpfr_init2(result, HUGE_TEST_PRECISION);
+    TEST_ASSERT(huge_test_eval(&ctx, result, "sqrt(2)*pi"), "Expression should parse");
+    TEST_ASSERT(!eval_context_get_error(&ctx), "Huge evaluations should succeed");
+    TEST_ASSERT(log.calls == 2 && log.last_done == 2 && log.total == 2,
+                "Every operation should be reported");
+
+    // Evaluating straight into the operands must round as before
+    mpfr_t sqrt2;
+    mpfr_init2(sqrt2, HUGE_TEST_PRECISION + BINOP_PRECISION_BOOST);
+    mpfr_init2(expected, HUGE_TEST_PRECISION + BINOP_PRECISION_BOOST);
+    mpfr_sqrt_ui(sqrt2, 2, MPFR_RNDN);
+    mpfr_const_pi(expected, MPFR_RNDN);
+    mpfr_mul(expected, sqrt2, expected, MPFR_RNDN);
+    mpfr_prec_round(expected, HUGE_TEST_PRECISION, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(result, expected), "Huge results should match MPFR");
+    mpfr_clear(sqrt2);
+
+    // Adaptive passes count again from zero
+    log.calls = 0;
+    ctx.adaptive = 1;
+    TEST_ASSERT(huge_test_eval(&ctx, result, "1+1/3"), "Expression should parse");
+    TEST_ASSERT(log.calls >= 2 && log.last_done == 2, "Adaptive passes should be reported");
+
+    mpfr_clear(result);
+    mpfr_clear(expected);
+    eval_context_cleanup(&ctx);
+    precision_set_huge(0);
+
+    printf("  ✅ Huge precision evaluation tests passed\n");
+    return 1;
+}
+
+int test_huge_streaming(void)
+{
+    printf("Testing streamed output of huge values...\n");
+
+    mpfr_prec_t saved_precision = global_precision;
+    precision_set_huge(1);
+    set_precision(HUGE_TEST_PRECISION);
+
+    mpfr_t value;
+    mpfr_init2(value, HUGE_TEST_PRECISION);
+    const NumberFormat formats[] = {FORMAT_SMART, FORMAT_SCIENTIFIC, FORMAT_FIXED};
+    const char *names[] = {"smart", "scientific", "fixed"};
+    for (int v = 0; v < 2; v++)
+    {
+        // A long digit string, and one that needs long runs of zeros
+        if (v == 0)
+        {
+            mpfr_const_pi(value, MPFR_RNDN);
+        }
+        else
+        {
+            mpfr_ui_pow_ui(value, 2, 300000, MPFR_RNDN);
+        }
+        for (int f = 0; f < 3; f++)
+        {
+            char *whole = formatter_to_string(value, formats[f]);
+            FILE *file = tmpfile();
+            TEST_ASSERT(whole && file, "Formatting should succeed");
+            formatter_fprint_number(file, value, formats[f]);
+            char *streamed = huge_test_read(file);
+            fclose(file);
+            int same = streamed && strcmp(whole, streamed) == 0;
+            if (!same)
+            {
+                printf("  %s output differs\n", names[f]);
+            }
+            int long_enough = strlen(whole) > FORMAT_STREAM_CHUNK;
+            free(whole);
+            free(streamed);
+            TEST_ASSERT(same, "Streamed output should equal the buffered text");
+            TEST_ASSERT(long_enough, "The test values should span chunks");
+        }
+    }
+    mpfr_clear(value);
+
+    precision_set_huge(0);
+    set_precision(saved_precision);
+    formatter_cleanup();
+
+    printf("  ✅ Streamed output tests passed\n");
+    return 1;
+}
+
+int run_huge_tests(void)
+{
+    printf("Running Huge Precision Test Suite\n");
+    printf("=================================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_huge_precision_cap())
+        passed++;
+    total++;
+    if (test_huge_memory_limit())
+        passed++;
+    total++;
+    if (test_huge_evaluation())
+        passed++;
+    total++;
+    if (test_huge_streaming())
+        passed++;
+
+    printf("\n=================================\n");
+    printf("Huge Precision Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #define TEST_ASSERT(condition, message)         \
     do                                          \
@@ -17,6 +18,29 @@
         }                                       \
     } while (0)
 
+// Process a line and capture what it prints
+static int integration_capture(const char *line, char *output, size_t size)
+{
+    FILE *capture = tmpfile();
+    if (!capture)
+    {
+        return 0;
+    }
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(capture), STDOUT_FILENO);
+    ReplResult result = repl_process_line(line);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    rewind(capture);
+    size_t length = fread(output, 1, size - 1, capture);
+    output[length] = '\0';
+    fclose(capture);
+    return result == REPL_CONTINUE;
+}
+
 int test_integration_full_pipeline(void)
 {
     printf("Testing full calculation pipeline...\n");
@@ -66,6 +90,27 @@ int test_integration_command_processing(void)
     result = repl_process_line("test");
     TEST_ASSERT(result == REPL_CONTINUE, "Test command should work");
 
+    // Budget limits are listed apart
+    char output[256];
+    repl_process_line("budget time 2");
+    repl_process_line("budget operations 1000");
+    TEST_ASSERT(integration_capture("budget exponent 64", output, sizeof(output)) &&
+                    strcmp(output, "Evaluation budget: 2 s, 1000 operations, exponents up to "
+                                   "2^64 (Ctrl-C stops an evaluation)\n") == 0,
+                "Budget limits should be separated by commas");
+    TEST_ASSERT(integration_capture("budget off", output, sizeof(output)) &&
+                    strcmp(output, "Evaluation budget: none (Ctrl-C stops an evaluation)\n") == 0,
+                "No budget should read none");
+
+    // A few cached bytes still show, and exact results are said to skip the cache
+    repl_process_line("cache 64");
+    repl_process_line("sqrt(2)");
+    TEST_ASSERT(integration_capture("cache", output, sizeof(output)) &&
+                    strstr(output, "1 entries, 1 of 64 KiB used\n") != NULL &&
+                    strstr(output, "Exact integer and rational results are not cached") != NULL,
+                "The cache status should round memory up and mention exact results");
+    repl_process_line("cache off");
+
     // Reset precision
     set_precision(DEFAULT_PRECISION);
 
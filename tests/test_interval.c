@@ -0,0 +1,345 @@
+#include "interval.h"
+#include "context.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+static void interval_test_set(Interval *x, double lo, double hi)
+{
+    mpfr_set_d(x->lo, lo, MPFR_RNDD);
+    mpfr_set_d(x->hi, hi, MPFR_RNDU);
+}
+
+static int interval_test_is(const Interval *x, double lo, double hi)
+{
+    return mpfr_cmp_d(x->lo, lo) == 0 && mpfr_cmp_d(x->hi, hi) == 0;
+}
+
+static int interval_test_is_entire(const Interval *x)
+{
+    return mpfr_inf_p(x->lo) && mpfr_sgn(x->lo) < 0 && mpfr_inf_p(x->hi) && mpfr_sgn(x->hi) > 0;
+}
+
+static int test_interval_arithmetic(void)
+{
+    printf("Testing interval arithmetic...\n");
+
+    Interval x, y, r;
+    interval_init2(&x, 64);
+    interval_init2(&y, 64);
+    interval_init2(&r, 64);
+
+    interval_test_set(&x, 1, 2);
+    interval_test_set(&y, 3, 4);
+    interval_add(&r, &x, &y);
+    TEST_ASSERT(interval_test_is(&r, 4, 6), "[1, 2] + [3, 4] should be [4, 6]");
+    interval_sub(&r, &x, &y);
+    TEST_ASSERT(interval_test_is(&r, -3, -1), "[1, 2] - [3, 4] should be [-3, -1]");
+
+    interval_test_set(&x, -1, 2);
+    interval_mul(&r, &x, &y);
+    TEST_ASSERT(interval_test_is(&r, -4, 8), "[-1, 2] * [3, 4] should be [-4, 8]");
+    interval_div(&r, &y, &x);
+    TEST_ASSERT(interval_test_is_entire(&r), "Dividing by an interval holding zero is unbounded");
+
+    interval_test_set(&x, -2, 3);
+    interval_test_set(&y, 2, 2);
+    interval_pow(&r, &x, &y);
+    TEST_ASSERT(interval_test_is(&r, 0, 9), "[-2, 3]^2 should be [0, 9]");
+    interval_test_set(&y, 3, 3);
+    interval_pow(&r, &x, &y);
+    TEST_ASSERT(interval_test_is(&r, -8, 27), "[-2, 3]^3 should be [-8, 27]");
+
+    // One third is not a double: the bounds must straddle it
+    interval_test_set(&x, 1, 1);
+    interval_test_set(&y, 3, 3);
+    interval_div(&r, &x, &y);
+    TEST_ASSERT(!interval_is_point(&r), "1/3 should not be a single double");
+    mpfr_t third;
+    mpfr_init2(third, 256);
+    mpfr_set_ui(third, 1, MPFR_RNDN);
+    mpfr_div_ui(third, third, 3, MPFR_RNDN);
+    TEST_ASSERT(mpfr_cmp(r.lo, third) < 0 && mpfr_cmp(r.hi, third) > 0,
+                "Bounds of 1/3 should enclose it");
+    mpfr_clear(third);
+
+    interval_clear(&r);
+    interval_clear(&y);
+    interval_clear(&x);
+    printf("  ✅ Interval arithmetic tests passed\n");
+    return 1;
+}
+
+static int test_interval_functions(void)
+{
+    printf("Testing interval functions...\n");
+
+    Interval x, r;
+    interval_init2(&x, 64);
+    interval_init2(&r, 64);
+
+    // The maximum of sin lies inside [1, 2]
+    interval_test_set(&x, 1, 2);
+    interval_sin(&r, &x);
+    TEST_ASSERT(mpfr_cmp_ui(r.hi, 1) == 0, "sin over [1, 2] should reach 1");
+    TEST_ASSERT(mpfr_cmp_d(r.lo, 0.84) > 0 && mpfr_cmp_d(r.lo, 0.842) < 0,
+                "sin over [1, 2] should not go below sin(1)");
+
+    interval_tan(&r, &x);
+    TEST_ASSERT(interval_test_is_entire(&r), "tan across its pole should be unbounded");
+
+    interval_cos(&r, &x);
+    TEST_ASSERT(mpfr_sgn(r.lo) < 0 && mpfr_sgn(r.hi) > 0, "cos over [1, 2] should change sign");
+
+    // Zero bounds have no exponent to size the search for extremes with
+    interval_test_set(&x, 0, 0);
+    interval_sin(&r, &x);
+    TEST_ASSERT(interval_test_is(&r, 0, 0), "sin(0) should be exactly 0");
+    interval_cos(&r, &x);
+    TEST_ASSERT(interval_test_is(&r, 1, 1), "cos(0) should be exactly 1");
+    interval_tan(&r, &x);
+    TEST_ASSERT(interval_test_is(&r, 0, 0), "tan(0) should be exactly 0");
+
+    interval_test_set(&x, -0.5, 0);
+    interval_sin(&r, &x);
+    TEST_ASSERT(mpfr_cmp_d(r.lo, -0.47) < 0 && mpfr_sgn(r.hi) == 0,
+                "sin over [-0.5, 0] should end at 0");
+    interval_test_set(&x, -0.5, 0.5);
+    interval_cos(&r, &x);
+    TEST_ASSERT(mpfr_cmp_ui(r.hi, 1) == 0 && mpfr_cmp_d(r.lo, 0.87) > 0,
+                "cos across 0 should reach 1");
+    interval_tan(&r, &x);
+    TEST_ASSERT(mpfr_sgn(r.lo) < 0 && mpfr_sgn(r.hi) > 0 && mpfr_cmp_d(r.hi, 0.55) < 0,
+                "tan across 0 should be bounded and change sign");
+
+    // Only the part inside the domain counts
+    interval_test_set(&x, -1, 4);
+    interval_sqrt(&r, &x);
+    TEST_ASSERT(interval_test_is(&r, 0, 2), "sqrt([-1, 4]) should be [0, 2]");
+
+    interval_abs(&r, &x);
+    TEST_ASSERT(interval_test_is(&r, 0, 4), "abs([-1, 4]) should be [0, 4]");
+
+    interval_test_set(&x, -0.5, 0.5);
+    interval_cosh(&r, &x);
+    TEST_ASSERT(mpfr_cmp_ui(r.lo, 1) == 0, "cosh should be smallest at zero");
+
+    interval_test_set(&x, 2, 2);
+    interval_sqrt(&r, &x);
+    mpfr_t root;
+    mpfr_init2(root, 256);
+    mpfr_sqrt_ui(root, 2, MPFR_RNDN);
+    TEST_ASSERT(mpfr_cmp(r.lo, root) < 0 && mpfr_cmp(r.hi, root) > 0,
+                "Bounds of sqrt(2) should enclose it");
+    mpfr_clear(root);
+
+    interval_set_constant(&r, CONST_PI);
+    mpfr_t pi;
+    mpfr_init2(pi, 256);
+    mpfr_const_pi(pi, MPFR_RNDN);
+    TEST_ASSERT(mpfr_cmp(r.lo, pi) < 0 && mpfr_cmp(r.hi, pi) > 0, "Bounds of pi should enclose it");
+    mpfr_clear(pi);
+
+    interval_clear(&r);
+    interval_clear(&x);
+    printf("  ✅ Interval function tests passed\n");
+    return 1;
+}
+
+static const char *interval_corpus[] = {
+    "1/3 + 0.1",
+    "sqrt(2) * e - gamma",
+    "sin(pi/7)^2 + cos(pi/7)^2",
+    "atan2(exp(1), 2^sqrt(2))",
+    "log(10) * tanh(0.5) - asinh(3)",
+    "(1 + 1e-20)^(10^20)",
+};
+
+static int test_interval_evaluator(void)
+{
+    printf("Testing interval evaluation...\n");
+
+    EvalContext ctx;
+    EvalContext reference;
+    eval_context_init(&ctx, 128);
+    eval_context_init(&reference, 1024);
+    ctx.interval = 1;
+
+    mpfr_t value, expected, width;
+    mpfr_init2(value, 128);
+    mpfr_init2(expected, 1024);
+    mpfr_init2(width, 64);
+
+    for (size_t i = 0; i < sizeof(interval_corpus) / sizeof(interval_corpus[0]); i++)
+    {
+        ASTNode *ast = test_parse(interval_corpus[i]);
+        TEST_ASSERT(ast != NULL, "Expression should parse");
+
+        evaluator_eval_ctx(&ctx, value, ast);
+        evaluator_eval_ctx(&reference, expected, ast);
+        ast_free(ast);
+
+        mpfr_srcptr lo;
+        mpfr_srcptr hi;
+        TEST_ASSERT(evaluator_interval_bounds(&ctx, &lo, &hi), "Interval evaluation should give bounds");
+        TEST_ASSERT(mpfr_cmp(lo, expected) <= 0 && mpfr_cmp(hi, expected) >= 0,
+                    "Bounds should enclose the high precision value");
+
+        // Guard bits keep the enclosure tight at the requested precision
+        mpfr_sub(width, hi, lo, MPFR_RNDU);
+        mpfr_div(width, width, expected, MPFR_RNDU);
+        mpfr_abs(width, width, MPFR_RNDU);
+        TEST_ASSERT(mpfr_cmp_d(width, 0x1p-100) < 0, "Bounds should be narrow");
+    }
+
+    // Off, the context keeps no bounds
+    ctx.interval = 0;
+    ASTNode *ast = test_parse("1/3");
+    evaluator_eval_ctx(&ctx, value, ast);
+    mpfr_srcptr lo;
+    mpfr_srcptr hi;
+    TEST_ASSERT(!evaluator_interval_bounds(&ctx, &lo, &hi), "Point evaluation should give no bounds");
+
+    // Trigonometry at and around zero
+    ast_free(ast);
+    ctx.interval = 1;
+    const char *zero_trig[] = {"sin(0)", "tan(0)", "cos(0) - 1", "sin(0*-1)", "tan(1-1)"};
+    for (size_t i = 0; i < sizeof(zero_trig) / sizeof(zero_trig[0]); i++)
+    {
+        ast = test_parse(zero_trig[i]);
+        evaluator_eval_ctx(&ctx, value, ast);
+        ast_free(ast);
+        TEST_ASSERT(eval_context_get_error(&ctx) == NULL && mpfr_zero_p(value),
+                    "Trigonometry at zero should be exactly zero");
+        TEST_ASSERT(evaluator_interval_bounds(&ctx, &lo, &hi) && mpfr_zero_p(lo) &&
+                        mpfr_zero_p(hi),
+                    "Trigonometry at zero should have zero width");
+    }
+
+    // Cancellation exposes the rounding of a literal read at a coarser
+    // precision than the interval's
+    const char *cancelling[] = {"0.1*10^80 - 10^79", "(0.3 - 0.1*3)*10^40", "e*10^60 - e*10^60"};
+    for (size_t i = 0; i < sizeof(cancelling) / sizeof(cancelling[0]); i++)
+    {
+        ast = test_parse(cancelling[i]);
+        evaluator_eval_ctx(&ctx, value, ast);
+        ast_free(ast);
+        TEST_ASSERT(evaluator_interval_bounds(&ctx, &lo, &hi) && mpfr_sgn(lo) <= 0 &&
+                        mpfr_sgn(hi) >= 0,
+                    "Bounds should enclose the exact zero");
+    }
+
+    // Errors are reported as in point evaluation
+    ast = test_parse("1/(2-2)");
+    evaluator_eval_ctx(&ctx, value, ast);
+    TEST_ASSERT(eval_context_get_error(&ctx) != NULL, "Division by an exact zero should fail");
+    ast_free(ast);
+    eval_context_clear_error(&ctx);
+
+    mpfr_clear(width);
+    mpfr_clear(expected);
+    mpfr_clear(value);
+    eval_context_cleanup(&reference);
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Interval evaluation tests passed\n");
+    return 1;
+}
+
+// Evaluate in interval mode and format the result
+static int interval_test_format(const char *input, FormatBuffer *buffer)
+{
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    ctx.interval = 1;
+
+    mpfr_t value;
+    mpfr_init2(value, 128);
+    ASTNode *ast = test_parse(input);
+    int ok = ast != NULL;
+    if (ok)
+    {
+        evaluator_eval_ctx(&ctx, value, ast);
+        format_buffer_reset(buffer);
+        ok = formatter_format_result_ctx(&ctx, buffer, value, 0);
+    }
+    ast_free(ast);
+    mpfr_clear(value);
+    eval_context_cleanup(&ctx);
+    return ok;
+}
+
+static int test_interval_format(void)
+{
+    printf("Testing interval output...\n");
+
+    FormatBuffer buffer;
+    format_buffer_init(&buffer);
+
+    TEST_ASSERT(interval_test_format("1/3", &buffer), "1/3 should evaluate");
+    TEST_ASSERT(strstr(buffer.data, "0.333") == buffer.data, "Midpoint should come first");
+    TEST_ASSERT(strstr(buffer.data, " ± ") != NULL, "Radius should follow the midpoint");
+
+    // Exact results have no radius
+    TEST_ASSERT(interval_test_format("2 + 3", &buffer), "2 + 3 should evaluate");
+    TEST_ASSERT(strcmp(buffer.data, "5") == 0, "Exact results should print as usual");
+
+    // Cancellation leaves fewer certified digits than the display shows
+    TEST_ASSERT(interval_test_format("(1 + 1e-30/3) - 1", &buffer), "Cancellation should evaluate");
+    TEST_ASSERT(strstr(buffer.data, " ± ") != NULL, "Cancelled result should carry a radius");
+    size_t threes = 0;
+    for (const char *c = buffer.data; *c && *c != ' '; c++)
+    {
+        threes += *c == '3';
+    }
+    TEST_ASSERT(threes >= 20 && threes <= 30, "Only certified digits should be shown");
+
+    // Dividing by a difference that may be zero has no finite bound
+    TEST_ASSERT(interval_test_format("1/(sin(pi) - sin(pi))", &buffer),
+                "Unbounded result should evaluate");
+    TEST_ASSERT(strncmp(buffer.data, "[-inf", 5) == 0, "Unbounded result should print its bounds");
+
+    format_buffer_free(&buffer);
+    printf("  ✅ Interval output tests passed\n");
+    return 1;
+}
+
+int run_interval_tests(void)
+{
+    printf("Running Interval Arithmetic Test Suite\n");
+    printf("======================================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_interval_arithmetic())
+        passed++;
+    total++;
+    if (test_interval_functions())
+        passed++;
+    total++;
+    if (test_interval_evaluator())
+        passed++;
+    total++;
+    if (test_interval_format())
+        passed++;
+
+    printf("\n======================================\n");
+    printf("Interval Arithmetic Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -1,7 +1,163 @@
+#include "lexer.h"
+#include "function_table.h"
+#include "constants.h"
 #include <stdio.h>
+#include <string.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Check that a token covers exactly the given text of the input
+static int lexer_test_text_is(const Lexer *lexer, const Token *token, const char *text)
+{
+    return token->length == strlen(text) &&
+           strncmp(lexer_token_text(lexer, token), text, token->length) == 0;
+}
+
+int test_lexer_slices(void)
+{
+    printf("Testing lexer token slices...\n");
+
+    const char *input = "  sqrt(2.5e3) + foo_bar*pi >= 17";
+    Lexer lexer;
+    lexer_init(&lexer, input);
+
+    struct
+    {
+        TokenType type;
+        const char *text;
+        size_t offset;
+    } expected[] = {
+        {TOKEN_SQRT, "sqrt", 2},        {TOKEN_LPAREN, "(", 6}, {TOKEN_FLOAT, "2.5e3", 7},
+        {TOKEN_RPAREN, ")", 12},        {TOKEN_PLUS, "+", 14},  {TOKEN_IDENTIFIER, "foo_bar", 16},
+        {TOKEN_STAR, "*", 23},          {TOKEN_CONSTANT, "pi", 24}, {TOKEN_GTE, ">=", 27},
+        {TOKEN_INT, "17", 30},          {TOKEN_EOF, "", 32},
+    };
+
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        Token token = lexer_get_next_token(&lexer);
+        if (token.type != expected[i].type || token.offset != expected[i].offset ||
+            !lexer_test_text_is(&lexer, &token, expected[i].text))
+        {
+            printf("    token %zu: %s at %zu+%zu\n", i, token_type_str(token.type), token.offset,
+                   token.length);
+        }
+        TEST_ASSERT(token.type == expected[i].type, "Token type should match");
+        TEST_ASSERT(token.offset == expected[i].offset, "Token offset should match");
+        TEST_ASSERT(lexer_test_text_is(&lexer, &token, expected[i].text),
+                    "Token text should match");
+        token_free(&token);
+    }
+
+    // Slices never read past the given length
+    const char buffer[] = {'l', 'n', '2', '0'};
+    lexer_init_length(&lexer, buffer, 2);
+    Token token = lexer_get_next_token(&lexer);
+    TEST_ASSERT(token.type == TOKEN_LOG && token.length == 2, "Only 'ln' should be lexed");
+    lexer_init_length(&lexer, buffer + 2, 2);
+    token = lexer_get_next_token(&lexer);
+    TEST_ASSERT(token.type == TOKEN_INT && token.int_value == 20 && token.length == 2,
+                "Unterminated numbers should be lexed");
+
+    printf("  ✅ Token slice tests passed\n");
+    return 1;
+}
+
+int test_lexer_constants(void)
+{
+    printf("Testing lexer constant types...\n");
+
+    struct
+    {
+        const char *input;
+        ConstantType constant;
+    } expected[] = {
+        {"pi", CONST_PI},       {"PI", CONST_PI},     {"e", CONST_E},
+        {"E", CONST_E},         {"ln2", CONST_LN2},   {"LN10", CONST_LN10},
+        {"gamma", CONST_GAMMA}, {"sqrt2", CONST_SQRT2},
+    };
+
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        Lexer lexer;
+        lexer_init(&lexer, expected[i].input);
+        Token token = lexer_get_next_token(&lexer);
+        TEST_ASSERT(token.type == TOKEN_CONSTANT, "Constant names should lex as constants");
+        TEST_ASSERT(token.constant == expected[i].constant, "Constant type should match");
+    }
+
+    printf("  ✅ Constant type tests passed\n");
+    return 1;
+}
+
+int test_lexer_function_hash(void)
+{
+    printf("Testing function table perfect hash...\n");
+
+    // Every name resolves to its own entry
+    int entries = 0;
+    for (const FunctionInfo *info; (info = function_table_entry(entries)) != NULL; entries++)
+    {
+        const FunctionInfo *found = function_table_lookup(info->name);
+        if (found != info)
+        {
+            printf("    name: %s\n", info->name);
+        }
+        TEST_ASSERT(found == info, "Table names should resolve to their entry");
+        TEST_ASSERT(info->arg_count < 0 || function_table_get_arg_count(info->token) ==
+                                               info->arg_count,
+                    "Function names should agree with the registry on arity");
+    }
+    TEST_ASSERT(entries > 30, "The table should be walked");
+
+    // Near misses must not match
+    static const char *unknown[] = {"", "s", "si", "sinx", "Sin", "Pi", "ln210", "arctan3",
+                                    "sqrt22", "gammas", "x", "_", "log1", "powpow"};
+    for (size_t i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++)
+    {
+        TEST_ASSERT(function_table_lookup(unknown[i]) == NULL, "Unknown names should not match");
+    }
+
+    // Prefixes of a longer buffer
+    const FunctionInfo *info = function_table_lookup_length("atan2(", 4);
+    TEST_ASSERT(info && info->token == TOKEN_ATAN, "Prefix lookups should use the length");
+    info = function_table_lookup_length("atan2(", 5);
+    TEST_ASSERT(info && info->token == TOKEN_ATAN2 && info->arg_count == 2,
+                "Prefix lookups should use the length");
+    TEST_ASSERT(function_table_lookup_length("sinh", 0) == NULL, "Empty names should not match");
+
+    printf("  ✅ Function hash tests passed\n");
+    return 1;
+}
 
 int run_lexer_tests(void)
 {
-    printf("Lexer tests not implemented yet\n");
-    return 0; // Return 0 for success (no tests to fail)
-}
\ No newline at end of file
+    printf("Running Lexer Test Suite\n");
+    printf("========================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_lexer_slices())
+        passed++;
+    total++;
+    if (test_lexer_constants())
+        passed++;
+    total++;
+    if (test_lexer_function_hash())
+        passed++;
+
+    printf("\n========================\n");
+    printf("Lexer Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
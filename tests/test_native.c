@@ -0,0 +1,235 @@
+#include "native.h"
+#include "context.h"
+#include "evaluator.h"
+#include "precision.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Compare the native backend with the MPFR path on one expression.
+// Returns 1 if they agree or the backend declined, 0 on a mismatch; taken
+// counts the expressions the backend answered.
+static int native_test_compare(const char *input, mpfr_prec_t precision, mpfr_rnd_t rounding,
+                               int *taken)
+{
+    ASTNode *ast = test_parse_at(input, precision);
+    if (!ast)
+    {
+        printf("    could not parse: %s\n", input);
+        return 0;
+    }
+
+    EvalContext ctx;
+    eval_context_init(&ctx, precision);
+    ctx.rounding = rounding;
+    ctx.native = 0;
+
+    mpfr_t native, expected;
+    mpfr_init2(native, precision);
+    mpfr_init2(expected, precision);
+
+    int ok = 1;
+    if (native_eval(&ctx, native, ast))
+    {
+        (*taken)++;
+        evaluator_eval_ctx(&ctx, expected, ast);
+        ok = mpfr_equal_p(native, expected) && mpfr_signbit(native) == mpfr_signbit(expected) &&
+             !eval_context_get_error(&ctx);
+        if (!ok)
+        {
+            mpfr_printf("    %s at %ld bits: native %.20Rg, mpfr %.20Rg\n", input,
+                        (long)precision, native, expected);
+        }
+    }
+
+    mpfr_clears(native, expected, (mpfr_ptr)0);
+    eval_context_cleanup(&ctx);
+    ast_free(ast);
+    return ok;
+}
+
+static const char *native_corpus[] = {
+    "2 + 3 * 4",
+    "1/3 + 2/7",
+    "sqrt(2) * sqrt(3)",
+    "sin(1) + cos(2) * tan(0.5)",
+    "exp(1.5) - log(7) / log10(3)",
+    "atan2(exp(1), pow(2, sqrt(2)))",
+    "asin(0.3) + acos(-0.7) - atan(5)",
+    "sinh(2) * cosh(0.5) / tanh(3)",
+    "asinh(4) + acosh(3) - atanh(0.25)",
+    "abs(-2.5) + floor(pi * 10) + ceil(-e)",
+    "2^0.5 + 10^-3 + (-2)^3",
+    "pi * e - gamma + ln2 * ln10 + sqrt2",
+    "-(3^0.5) / (1 + 1e-10)",
+    "1e300 * 1e-290 + 1.5e10 / 3e8",
+    "(1 + 2 < 4) + (5 >= 5) + (pi != e)",
+};
+
+int test_native_corpus(void)
+{
+    printf("Testing native backend against MPFR...\n");
+
+    const mpfr_prec_t precisions[] = {53, 24, 11};
+    const mpfr_rnd_t modes[] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD};
+    size_t count = sizeof(native_corpus) / sizeof(native_corpus[0]);
+
+    int taken = 0;
+    for (size_t p = 0; p < sizeof(precisions) / sizeof(precisions[0]); p++)
+    {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                TEST_ASSERT(native_test_compare(native_corpus[i], precisions[p], modes[m], &taken),
+                            "Native result should match MPFR");
+            }
+        }
+    }
+
+    int rnd_taken = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        native_test_compare(native_corpus[i], 53, MPFR_RNDN, &rnd_taken);
+    }
+    TEST_ASSERT(rnd_taken >= (int)count - 2, "Corpus expressions should stay native at 53 bits");
+    TEST_ASSERT(taken > (int)(count * 12 * 3 / 4), "Most evaluations should stay native");
+
+    printf("  ✅ Native corpus tests passed\n");
+    return 1;
+}
+
+int test_native_random(void)
+{
+    printf("Testing native backend on generated expressions...\n");
+
+    static const char *functions[] = {"sin", "cos", "exp", "sqrt", "log", "atan", "tanh", "abs"};
+    static const char operators[] = {'+', '-', '*', '/'};
+    unsigned long state = 12345;
+    int taken = 0;
+    const int total = 2000;
+
+    for (int i = 0; i < total; i++)
+    {
+        long values[4];
+        for (int j = 0; j < 4; j++)
+        {
+            state = state * 6364136223846793005UL + 1442695040888963407UL;
+            values[j] = (long)((state >> 33) % 20000) + 1;
+        }
+        char input[128];
+        snprintf(input, sizeof(input), "(%ld.%02ld %c %ld) %c %s(%ld / 997)", values[0] / 100,
+                 values[0] % 100, operators[values[1] % 4], values[1], operators[values[2] % 4],
+                 functions[values[3] % 8], values[3]);
+
+        mpfr_rnd_t rounding = (i % 3 == 0) ? MPFR_RNDZ : MPFR_RNDN;
+        TEST_ASSERT(native_test_compare(input, 53, rounding, &taken),
+                    "Native result should match MPFR");
+    }
+    TEST_ASSERT(taken > total * 9 / 10, "Nearly all generated expressions should stay native");
+
+    printf("  ✅ Native generated expression tests passed (%d/%d native)\n", taken, total);
+    return 1;
+}
+
+int test_native_fallbacks(void)
+{
+    printf("Testing native backend fallbacks...\n");
+
+    static const char *declined[] = {
+        "1/0",          // Division by zero is reported by MPFR
+        "sqrt(-1)",     // Domain errors too
+        "log(0)",
+        "asin(2)",
+        "sin(pi)",      // Flushed to zero by the MPFR path
+        "sin(1e-30)",
+        "pi == pi",     // Undecidable comparison
+        "floor(3 - 1e-30)",
+        "2^100000",     // Overflows long double but not MPFR
+        "2^-20000 * 3", // Underflows long double
+    };
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 53);
+    mpfr_t result;
+    mpfr_init2(result, 53);
+    for (size_t i = 0; i < sizeof(declined) / sizeof(declined[0]); i++)
+    {
+        ASTNode *ast = test_parse_at(declined[i], 53);
+        TEST_ASSERT(ast != NULL, "Expression should parse");
+        int native = native_eval(&ctx, result, ast);
+        ast_free(ast);
+        if (native)
+        {
+            printf("    expression: %s\n", declined[i]);
+        }
+        TEST_ASSERT(!native, "Untrustworthy results should fall back to MPFR");
+    }
+
+    // Falling back keeps the MPFR path's behavior
+    ASTNode *div = test_parse_at("1/(2 - 2)", 53);
+    evaluator_eval_ctx(&ctx, result, div);
+    ast_free(div);
+    TEST_ASSERT(eval_context_get_error(&ctx) != NULL, "Division by zero should still be reported");
+
+    ASTNode *zero = test_parse_at("sin(pi)", 53);
+    evaluator_eval_ctx(&ctx, result, zero);
+    ast_free(zero);
+    TEST_ASSERT(mpfr_zero_p(result) && !mpfr_signbit(result), "sin(pi) should still be 0");
+
+    // Exact results are native in every rounding mode
+    ASTNode *exact = test_parse_at("2 + 3 * 4 - 0.5", 53);
+    ctx.rounding = MPFR_RNDZ;
+    TEST_ASSERT(native_eval(&ctx, result, exact) && mpfr_cmp_d(result, 13.5) == 0,
+                "Exact arithmetic should stay native");
+
+    // Higher precisions are never native
+    eval_context_set_precision(&ctx, 64);
+    mpfr_set_prec(result, 64);
+    int wide = native_eval(&ctx, result, exact);
+    ast_free(exact);
+    TEST_ASSERT(!wide, "Precisions above NATIVE_MAX_PRECISION should use MPFR");
+
+    mpfr_clear(result);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Native fallback tests passed\n");
+    return 1;
+}
+
+int run_native_tests(void)
+{
+    printf("Running Native Backend Test Suite\n");
+    printf("=================================\n\n");
+
+    precision_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_native_corpus())
+        passed++;
+    total++;
+    if (test_native_random())
+        passed++;
+    total++;
+    if (test_native_fallbacks())
+        passed++;
+
+    printf("\n=================================\n");
+    printf("Native Backend Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
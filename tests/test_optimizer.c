@@ -0,0 +1,511 @@
+#include "optimizer.h"
+#include "compiler.h"
+#include "evaluator.h"
+#include "precision.h"
+#include "constants.h"
+#include "functions.h"
+#include "function_table.h"
+#include "context.h"
+#include "variables.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+static const char *optimizer_corpus[] = {
+    "42",
+    "pi",
+    "-pi",
+    "2*pi/3 + sqrt(2)",
+    "(1+2)*(3+4)/(5+6)",
+    "1/3 + 1/7 - 1/11",
+    "2^3^2",
+    "sin(pi/6)*2",
+    "sin(pi)",
+    "sin(pi) + 1",
+    "exp(1) - e",
+    "atan2(exp(1), pow(2, sqrt(2)))",
+    "log(e) + ln(10) + log10(1000)",
+    "2pi * sqrt2 - ln2 * ln10",
+    "5 > 3",
+    "1e-30 + 1",
+    "sqrt(-1) + 1",
+    "1 + sqrt(-1)",
+    "log(0)",
+    "1/0",
+    "1 + 1/0",
+};
+
+// Expressions with repeated subexpressions; x and y are variables
+static const char *share_corpus[] = {
+    "sin(x/7)^2 + cos(x/7)^2 + sin(x/7)*cos(x/7)",
+    "exp(x*y) - exp(x*y)/(1 + exp(x*y))",
+    "sqrt(x^2 + y^2) * atan2(y, x) + sqrt(x^2 + y^2)",
+    "-(x*x) + -(x*x) * 2",
+    "(x/3)*(x/3)*(x/3) - x/3",
+    "sin(pi/7) + sin(pi/7) + sin(2/7)",
+    "log(x - y) + log(x - y)",
+    "sqrt(y - x) * 2 + sqrt(y - x)",
+    "1/(x - x) + 1/(x - x)",
+    "(x < y) + (x < y) * (x*y)",
+    "sin(1e-30*x) + sin(1e-30*x)",
+};
+
+static ASTNode *optimizer_test_parse_shared(ASTArena *arena, const char *input, int share)
+{
+    TestParseOptions options = {0};
+    options.arena = arena;
+    options.no_sharing = !share;
+    return test_parse_with(input, &options);
+}
+
+static ASTNode *optimizer_test_parse(ASTArena *arena, const char *input)
+{
+    return optimizer_test_parse_shared(arena, input, 1);
+}
+
+// Bit-identical: same value, same sign of zero, or both NaN
+static int optimizer_identical(const mpfr_t a, const mpfr_t b)
+{
+    if (mpfr_nan_p(a) || mpfr_nan_p(b))
+    {
+        return mpfr_nan_p(a) && mpfr_nan_p(b);
+    }
+    return mpfr_equal_p(a, b) && mpfr_signbit(a) == mpfr_signbit(b);
+}
+
+// Evaluate two trees and compare results and error state
+static int optimizer_same_result(const ASTNode *expected_ast, const ASTNode *actual_ast)
+{
+    mpfr_t expected, actual;
+    mpfr_init2(expected, global_precision);
+    mpfr_init2(actual, global_precision);
+
+    evaluator_eval(expected, expected_ast);
+    int expected_error = evaluator_get_last_error() != NULL;
+    evaluator_eval(actual, actual_ast);
+    int actual_error = evaluator_get_last_error() != NULL;
+
+    int same = optimizer_identical(expected, actual) && expected_error == actual_error;
+
+    mpfr_clear(expected);
+    mpfr_clear(actual);
+    return same;
+}
+
+int test_optimizer_preserves_results(void)
+{
+    printf("Testing folded trees against the original...\n");
+
+    mpfr_prec_t precisions[] = {53, 256};
+    int corpus_size = sizeof(optimizer_corpus) / sizeof(optimizer_corpus[0]);
+
+    for (int p = 0; p < 2; p++)
+    {
+        set_precision(precisions[p]);
+
+        for (int i = 0; i < corpus_size; i++)
+        {
+            ASTNode *original = optimizer_test_parse(NULL, optimizer_corpus[i]);
+            ASTNode *folded = optimizer_fold_constants(optimizer_test_parse(NULL, optimizer_corpus[i]));
+            TEST_ASSERT(original != NULL && folded != NULL, optimizer_corpus[i]);
+
+            int same = optimizer_same_result(original, folded);
+
+            // The bytecode compiler sees through folded nodes as well, and
+            // leaves trees the exact tier computes whole to it
+            EvalContext ctx;
+            eval_context_init(&ctx, global_precision);
+            ctx.native = 0;
+            CompiledProgram *program = compiler_compile(&ctx, folded, NULL);
+            mpfr_t expected, actual;
+            mpfr_init2(expected, global_precision);
+            mpfr_init2(actual, global_precision);
+            evaluator_eval_ctx(&ctx, expected, original);
+            if (program)
+            {
+                compiler_run(&ctx, actual, program, NULL);
+            }
+            int compiled_same = program ? optimizer_identical(expected, actual)
+                                        : folded->exact && folded->type != NODE_NUMBER;
+            mpfr_clear(expected);
+            mpfr_clear(actual);
+            compiler_free(program);
+            eval_context_cleanup(&ctx);
+
+            ast_free(original);
+            ast_free(folded);
+
+            TEST_ASSERT(same, optimizer_corpus[i]);
+            TEST_ASSERT(compiled_same, optimizer_corpus[i]);
+        }
+    }
+
+    set_precision(DEFAULT_PRECISION);
+
+    printf("  ✅ Folded result tests passed\n");
+    return 1;
+}
+
+int test_optimizer_fold_shapes(void)
+{
+    printf("Testing which subtrees are folded...\n");
+
+    ASTNode *ast = optimizer_fold_constants(optimizer_test_parse(NULL, "2*pi/3 + sqrt(2)"));
+    TEST_ASSERT(ast && ast->type == NODE_NUMBER, "Constant expression should fold to one number");
+    TEST_ASSERT(optimizer_count_folds(ast) == 1, "Whole expression should be a single fold");
+    ast_free(ast);
+
+    // Lone constants and root calls keep their own final rounding
+    ast = optimizer_fold_constants(optimizer_test_parse(NULL, "pi"));
+    TEST_ASSERT(ast && ast->type == NODE_CONSTANT, "Root constant should not fold");
+    ast_free(ast);
+
+    ast = optimizer_fold_constants(optimizer_test_parse(NULL, "sin(pi/6)"));
+    TEST_ASSERT(ast && ast->type == NODE_FUNCTION, "Root call should not fold");
+    TEST_ASSERT(ast->function.args[0]->type == NODE_NUMBER, "Call argument should fold");
+    ast_free(ast);
+
+    // Errors and NaN are left for evaluation to report
+    ast = optimizer_fold_constants(optimizer_test_parse(NULL, "1/0"));
+    TEST_ASSERT(ast && ast->type == NODE_BINOP, "Division by zero should not fold");
+    ast_free(ast);
+
+    ast = optimizer_fold_constants(optimizer_test_parse(NULL, "(2 + 3) * sqrt(-1)"));
+    TEST_ASSERT(ast && ast->type == NODE_BINOP, "Domain error should not fold");
+    TEST_ASSERT(ast->binop.left->type == NODE_NUMBER, "Sibling subtree should still fold");
+    TEST_ASSERT(ast->binop.right->type == NODE_FUNCTION, "Failing call should stay");
+    ast_free(ast);
+
+    ast = optimizer_fold_constants(optimizer_test_parse(NULL, "(-8)^0.5 + 1"));
+    TEST_ASSERT(ast && ast->type == NODE_BINOP, "NaN result should not fold");
+    ast_free(ast);
+
+    printf("  ✅ Fold shape tests passed\n");
+    return 1;
+}
+
+int test_optimizer_precision_change(void)
+{
+    printf("Testing folded values across precision changes...\n");
+
+    const char *expr = "sqrt(2) * pi - e / 3";
+    ASTNode *folded = optimizer_fold_constants(optimizer_test_parse(NULL, expr));
+    TEST_ASSERT(folded && optimizer_count_folds(folded) == 1, "Expression should fold");
+
+    set_precision(512);
+    TEST_ASSERT(optimizer_count_folds(folded) == 0, "Precision change should invalidate folds");
+
+    ASTNode *reference = optimizer_test_parse(NULL, expr);
+    TEST_ASSERT(reference != NULL, "Expression should parse");
+
+    // Literals keep their parse precision, so compare against the same
+    // unfolded tree evaluated through the stale fold
+    TEST_ASSERT(optimizer_same_result(folded->number.literal->folded_from, folded),
+                "Stale fold should evaluate its original subtree");
+
+    folded = optimizer_fold_constants(folded);
+    TEST_ASSERT(optimizer_count_folds(folded) == 1, "Refolding should refresh the value");
+    TEST_ASSERT(mpfr_get_prec(folded->number.literal->value) == 512 + BINOP_PRECISION_BOOST,
+                "Refreshed value should use the new working precision");
+
+    mpfr_t expected, actual;
+    mpfr_init2(expected, global_precision);
+    mpfr_init2(actual, global_precision);
+    evaluator_eval(expected, reference);
+    evaluator_eval(actual, folded);
+    int close = mpfr_cmp(expected, actual) == 0;
+    mpfr_clear(expected);
+    mpfr_clear(actual);
+
+    ast_free(reference);
+    ast_free(folded);
+    set_precision(DEFAULT_PRECISION);
+
+    TEST_ASSERT(close, "Refreshed fold should match a fresh parse");
+
+    printf("  ✅ Precision change tests passed\n");
+    return 1;
+}
+
+int test_optimizer_arena_trees(void)
+{
+    printf("Testing folding of arena-allocated trees...\n");
+
+    ASTArena *arena = ast_arena_create(256);
+    TEST_ASSERT(arena != NULL, "Arena should be created");
+
+    for (int round = 0; round < 3; round++)
+    {
+        ASTNode *original = optimizer_test_parse(NULL, "atan2(1, 2) + sqrt(-1) * 0 - ln2");
+        ASTNode *folded = optimizer_fold_constants(
+            optimizer_test_parse(arena, "atan2(1, 2) + sqrt(-1) * 0 - ln2"));
+        TEST_ASSERT(folded != NULL && folded->arena == arena, "Folded tree should stay in the arena");
+
+        int same = optimizer_same_result(original, folded);
+        ast_free(original);
+        ast_free(folded);
+        ast_arena_reset(arena);
+
+        TEST_ASSERT(same, "Arena fold should match the original");
+    }
+
+    ast_arena_destroy(arena);
+
+    printf("  ✅ Arena folding tests passed\n");
+    return 1;
+}
+
+int test_optimizer_sharing_shapes(void)
+{
+    printf("Testing which subexpressions are shared...\n");
+
+    const char *expr = "sin(x/7)^2 + cos(x/7)^2 + sin(x/7)*cos(x/7)";
+    ASTNode *ast = optimizer_test_parse_shared(NULL, expr, 0);
+    TEST_ASSERT(ast != NULL, "Expression should parse");
+    TEST_ASSERT(optimizer_share_subexpressions(ast) == 3, "sin, cos and x/7 should be shared");
+
+    // sin^2 + cos^2 + sin*cos, one sum of three terms
+    TEST_ASSERT(ast->type == NODE_NARY && ast->nary.count == 3, "Terms should form one sum");
+    ASTNode *square = ast->nary.operands[0];
+    ASTNode *product = ast->nary.operands[2];
+    ASTNode *sine = square->binop.left;
+    ASTNode *cosine = ast->nary.operands[1]->binop.left;
+    TEST_ASSERT(product->binop.left == sine && product->binop.right == cosine,
+                "Repeated calls should be one node");
+    TEST_ASSERT(sine->function.args[0] == cosine->function.args[0], "x/7 should be one node");
+    TEST_ASSERT(sine->refs == 2 && sine->function.args[0]->refs == 2,
+                "Shared nodes should count their parents");
+    TEST_ASSERT(sine->share >= 0 && ast->share < 0 && square->share < 0,
+                "Only repeated subexpressions should get a slot");
+    ast_free(ast);
+
+    // Cheap repeats are merged but not kept
+    ast = optimizer_test_parse_shared(NULL, "-(x+1) + -(x+1)", 0);
+    TEST_ASSERT(ast != NULL, "Expression should parse");
+    TEST_ASSERT(optimizer_share_subexpressions(ast) == 0, "Sums should not be worth a slot");
+    TEST_ASSERT(ast->binop.left == ast->binop.right, "Equal operands should be merged");
+    ast_free(ast);
+
+    // Literals must agree exactly, names by spelling
+    ast = optimizer_test_parse_shared(NULL, "sin(x/7) + sin(x/7.0000001) + sin(y/7)", 0);
+    TEST_ASSERT(ast && optimizer_share_subexpressions(ast) == 0, "Different operands differ");
+    ast_free(ast);
+
+    // The parser shares by default, in arenas too
+    ASTArena *arena = ast_arena_create(0);
+    ast = optimizer_test_parse(arena, expr);
+    TEST_ASSERT(ast && ast->type == NODE_NARY, "Arena terms should form one sum");
+    TEST_ASSERT(ast->nary.operands[2]->binop.left == ast->nary.operands[0]->binop.left,
+                "Parsed trees should be shared");
+    TEST_ASSERT(ast->nary.operands[2]->binop.left->refs == 2,
+                "Dropped arena nodes should not count");
+    ast_arena_destroy(arena);
+
+    printf("  ✅ Sharing shape tests passed\n");
+    return 1;
+}
+
+// Evaluate every shared expression with and without sharing
+static int optimizer_compare_sharing(const char *label)
+{
+    int corpus_size = sizeof(share_corpus) / sizeof(share_corpus[0]);
+    for (int i = 0; i < corpus_size; i++)
+    {
+        ASTNode *plain = optimizer_test_parse_shared(NULL, share_corpus[i], 0);
+        ASTNode *shared = optimizer_test_parse(NULL, share_corpus[i]);
+        ASTNode *folded = optimizer_fold_constants(optimizer_test_parse(NULL, share_corpus[i]));
+        TEST_ASSERT(plain && shared && folded, share_corpus[i]);
+
+        // Folding works on shared trees as well
+        int same = optimizer_same_result(plain, shared) && optimizer_same_result(plain, folded);
+        ast_free(plain);
+        ast_free(shared);
+        ast_free(folded);
+        if (!same)
+        {
+            printf("  %s: %s\n", label, share_corpus[i]);
+        }
+        TEST_ASSERT(same, "Sharing should not change results or errors");
+    }
+    return 1;
+}
+
+int test_optimizer_sharing_results(void)
+{
+    printf("Testing shared trees against plain ones...\n");
+
+    VariableTable *table = variables_create();
+    EvalContext *ctx = eval_context_default();
+    ctx->variables = table;
+    const char *values[][2] = {{"1.25", "3"}, {"3", "3"}, {"-2", "0.5"}};
+    const mpfr_prec_t precisions[] = {53, 256};
+    int ok = table != NULL;
+    for (int v = 0; v < 3 && ok; v++)
+    {
+        mpfr_t value;
+        mpfr_init2(value, 64);
+        mpfr_set_str(value, values[v][0], 10, MPFR_RNDN);
+        variables_set_value(table, "x", value);
+        mpfr_set_str(value, values[v][1], 10, MPFR_RNDN);
+        variables_set_value(table, "y", value);
+        mpfr_clear(value);
+
+        for (int p = 0; p < 2 && ok; p++)
+        {
+            set_precision(precisions[p]);
+            ok = optimizer_compare_sharing("fixed");
+            for (int strict = 0; strict < 2 && ok; strict++)
+            {
+                evaluator_set_strict_mode(strict);
+                evaluator_set_adaptive(1);
+                ok = optimizer_compare_sharing("adaptive");
+                evaluator_set_adaptive(0);
+            }
+            evaluator_set_strict_mode(0);
+        }
+    }
+    ctx->variables = NULL;
+    variables_destroy(table);
+    set_precision(DEFAULT_PRECISION);
+    TEST_ASSERT(ok, "Shared trees should evaluate like plain ones");
+
+    printf("  ✅ Shared result tests passed\n");
+    return 1;
+}
+
+typedef struct
+{
+    long last_done;
+    long total;
+} ShareProgress;
+
+static void share_test_progress(void *data, long done, long total, double seconds)
+{
+    ShareProgress *log = data;
+    log->last_done = done;
+    log->total = total;
+    (void)seconds;
+}
+
+int test_optimizer_sharing_evaluation(void)
+{
+    printf("Testing evaluation of shared subexpressions...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 256);
+    ctx.native = 0;
+    ShareProgress log = {0, 0};
+    ctx.progress = share_test_progress;
+    ctx.progress_data = &log;
+    ctx.progress_interval = 0;
+
+    ASTNode *ast = optimizer_test_parse(NULL, "sin(pi/7)^2 + cos(pi/7)^2 + sin(pi/7)*cos(pi/7)");
+    mpfr_t result;
+    mpfr_init2(result, 256);
+    for (int adaptive = 0; adaptive < 2; adaptive++)
+    {
+        ctx.adaptive = adaptive;
+        evaluator_eval_ctx(&ctx, result, ast);
+        TEST_ASSERT(!eval_context_get_error(&ctx), "Shared evaluation should succeed");
+        TEST_ASSERT(log.last_done == log.total && log.total == 13,
+                    "Reused values should count as done");
+    }
+
+    // Only the evaluated operations count against a budget: 3 shared ones,
+    // two squares, two sums and a product
+    ctx.progress = NULL;
+    ctx.adaptive = 0;
+    ctx.budget.max_operations = 8;
+    evaluator_eval_ctx(&ctx, result, ast);
+    TEST_ASSERT(!eval_context_get_error(&ctx), "Reused values should not use the budget");
+    ctx.budget.max_operations = 7;
+    evaluator_eval_ctx(&ctx, result, ast);
+    TEST_ASSERT(eval_context_get_error(&ctx) != NULL, "The budget should still apply");
+    ctx.budget.max_operations = 0;
+
+    // Values kept at one precision are not reused at another
+    ast_free(ast);
+    ast = optimizer_test_parse(NULL, "sqrt(pi) * sqrt(pi)");
+    mpfr_t expected;
+    mpfr_init2(expected, 512);
+    mpfr_set_prec(result, 512);
+    for (int i = 0; i < 2; i++)
+    {
+        eval_context_set_precision(&ctx, i ? 512 : 256);
+        evaluator_eval_ctx(&ctx, result, ast);
+    }
+    mpfr_t exact;
+    mpfr_init2(exact, 512 + BINOP_PRECISION_BOOST);
+    mpfr_const_pi(exact, MPFR_RNDN);
+    mpfr_sqrt(exact, exact, MPFR_RNDN);
+    mpfr_mul(exact, exact, exact, MPFR_RNDN);
+    mpfr_set(expected, exact, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(result, expected), "Shared values should follow the precision");
+    mpfr_clear(exact);
+
+    mpfr_clear(expected);
+    mpfr_clear(result);
+    ast_free(ast);
+    eval_context_cleanup(&ctx);
+    TEST_ASSERT(ctx.shared == NULL && ctx.shared_capacity == 0,
+                "Cleanup should release the shared values");
+
+    printf("  ✅ Shared evaluation tests passed\n");
+    return 1;
+}
+
+int run_optimizer_tests(void)
+{
+    printf("Running Optimizer Test Suite\n");
+    printf("============================\n\n");
+
+    precision_init();
+    constants_init();
+    functions_init();
+    function_table_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_optimizer_preserves_results())
+        passed++;
+    total++;
+    if (test_optimizer_fold_shapes())
+        passed++;
+    total++;
+    if (test_optimizer_precision_change())
+        passed++;
+    total++;
+    if (test_optimizer_arena_trees())
+        passed++;
+    total++;
+    if (test_optimizer_sharing_shapes())
+        passed++;
+    total++;
+    if (test_optimizer_sharing_results())
+        passed++;
+    total++;
+    if (test_optimizer_sharing_evaluation())
+        passed++;
+
+    printf("\n============================\n");
+    printf("Optimizer Tests: %d/%d passed\n", passed, total);
+
+    evaluator_cleanup();
+    constants_cleanup();
+    functions_cleanup();
+    precision_cleanup();
+
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+#include "test_parse.h"
+#include "lexer.h"
+#include "parser.h"
+#include <stdio.h>
+
+ASTNode *test_parse(const char *input)
+{
+    TestParseOptions options = {0};
+    return test_parse_with(input, &options);
+}
+
+ASTNode *test_parse_at(const char *input, mpfr_prec_t precision)
+{
+    TestParseOptions options = {0};
+    options.precision = precision;
+    return test_parse_with(input, &options);
+}
+
+ASTNode *test_parse_with(const char *input, const TestParseOptions *options)
+{
+    Lexer lexer;
+    lexer_init(&lexer, input);
+
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_quiet(&parser, 1);
+    parser_set_arena(&parser, options->arena);
+    parser_set_precision(&parser, options->precision);
+    parser_set_sharing(&parser, !options->no_sharing);
+
+    ASTNode *ast = parser_parse_expression(&parser);
+    if (options->error && options->error_size > 0)
+    {
+        options->error[0] = '\0';
+    }
+    if (!ast || parser_has_error(&parser) || parser.current_token.type != TOKEN_EOF)
+    {
+        const char *message = parser_get_error_message(&parser);
+        if (options->error && options->error_size > 0)
+        {
+            snprintf(options->error, options->error_size, "%s", message ? message : "");
+        }
+        ast_free(ast);
+        ast = NULL;
+    }
+    token_free(&parser.previous_token);
+    token_free(&parser.current_token);
+    return ast;
+}
@@ -0,0 +1,46 @@
+#ifndef TEST_PARSE_H
+#define TEST_PARSE_H
+
+#include "ast.h"
+#include "ast_arena.h"
+#include <stddef.h>
+#include <mpfr.h>
+
+/**
+ * How test_parse_with() parses; a zeroed struct gives test_parse()
+ */
+typedef struct
+{
+    ASTArena *arena;       // Arena to build the tree in, NULL for the heap
+    mpfr_prec_t precision; // Literal precision, 0 for the global one
+    int no_sharing;        // Leave repeated subexpressions unshared
+    char *error;           // Buffer for the parser's message, or NULL
+    size_t error_size;     // Size of error
+} TestParseOptions;
+
+/**
+ * Parse a whole expression quietly, for tests
+ * @param input Expression text
+ * @return The tree, or NULL if the text does not parse to its end
+ */
+ASTNode *test_parse(const char *input);
+
+/**
+ * Parse a whole expression quietly, reading literals at a given precision
+ * @param input Expression text
+ * @param precision Literal precision in bits, 0 for the global one
+ * @return The tree, or NULL if the text does not parse to its end
+ */
+ASTNode *test_parse_at(const char *input, mpfr_prec_t precision);
+
+/**
+ * Parse a whole expression quietly with the given options
+ * On failure the parser's message, or an empty string, goes to
+ * options->error if it is set.
+ * @param input Expression text
+ * @param options How to parse
+ * @return The tree, or NULL if the text does not parse to its end
+ */
+ASTNode *test_parse_with(const char *input, const TestParseOptions *options);
+
+#endif // TEST_PARSE_H
@@ -5,6 +5,7 @@
 #include "function_table.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #define TEST_ASSERT(condition, message)         \
@@ -286,6 +287,263 @@ int test_parser_complex_expressions(void)
     return 1;
 }
 
+// Parse an expression into an arena
+static ASTNode *parse_arena_expression(ASTArena *arena, const char *input)
+{
+    Lexer lexer;
+    lexer_init(&lexer, input);
+
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_arena(&parser, arena);
+
+    ASTNode *ast = parser_parse_expression(&parser);
+
+    if (!ast || parser_has_error(&parser) || parser.current_token.type != TOKEN_EOF)
+    {
+        return NULL;
+    }
+
+    return ast;
+}
+
+int test_parser_arena(void)
+{
+    printf("Testing arena-allocated parsing...\n");
+
+    // A tiny block size forces the arena to chain blocks
+    ASTArena *arena = ast_arena_create(128);
+    TEST_ASSERT(arena != NULL, "Arena should be created");
+
+    for (int round = 0; round < 3; round++)
+    {
+        ASTNode *ast = parse_arena_expression(arena, "sin(pi/6) + atan2(1, 2.5) * -3");
+        TEST_ASSERT(ast != NULL, "Expression should parse into the arena");
+        TEST_ASSERT(ast->arena == arena, "Node should be owned by the arena");
+        TEST_ASSERT(ast->type == NODE_BINOP && ast->binop.op == TOKEN_PLUS, "Root should be addition");
+
+        ASTNode *call = ast->binop.left;
+        TEST_ASSERT(call->type == NODE_FUNCTION && call->function.arg_count == 1, "sin() call");
+        ASTNode *product = ast->binop.right;
+        TEST_ASSERT(product->binop.left->function.arg_count == 2, "atan2() call");
+        ASTNode *literal = product->binop.left->function.args[1];
+        TEST_ASSERT(literal->type == NODE_NUMBER &&
+                    mpfr_cmp_d(literal->number.literal->value, 2.5) == 0,
+                    "Literal should be parsed");
+        ASTNode *constant = call->function.args[0]->binop.left;
+        TEST_ASSERT(constant->type == NODE_CONSTANT && strcmp(constant->constant.name, "pi") == 0,
+                    "Constant name should be copied into the arena");
+
+        // Literals live in the pool, apart from the nodes
+        size_t literal_bytes;
+        size_t node_bytes = ast_arena_used(arena, &literal_bytes);
+        TEST_ASSERT(node_bytes >= 10 * sizeof(ASTNode) && literal_bytes > 0,
+                    "Nodes and literals should be counted separately");
+        TEST_ASSERT((char *)literal->number.literal->value < (char *)literal ||
+                        (char *)literal->number.literal->value >= (char *)(literal + 1),
+                    "The literal should not be stored in its node");
+
+        // Freeing an arena tree is a no-op; the reset releases it
+        ast_free(ast);
+        ast_arena_reset(arena);
+    }
+
+    // Failed parses leave nothing that needs freeing beyond the reset
+    TEST_ASSERT(parse_arena_expression(arena, "atan2(1, 2") == NULL, "Incomplete call should fail");
+    TEST_ASSERT(parse_arena_expression(arena, "2 + (3 * 4") == NULL, "Missing ')' should fail");
+    ast_arena_reset(arena);
+    size_t literal_bytes;
+    TEST_ASSERT(ast_arena_used(arena, &literal_bytes) == 0 && literal_bytes == 0,
+                "A reset should release everything");
+
+    ast_arena_destroy(arena);
+
+    printf("  ✅ Arena parsing tests passed\n");
+    return 1;
+}
+
+// Parse a long generated expression, bypassing lexer_init()'s input limit
+static ASTNode *parse_long_expression(const char *input, int max_depth, Parser *parser)
+{
+    static Lexer lexer;
+    lexer_init_length(&lexer, input, strlen(input));
+    parser_init(parser, &lexer);
+    parser_set_quiet(parser, 1);
+    parser_set_max_recursion_depth(parser, max_depth);
+
+    ASTNode *ast = parser_parse_expression(parser);
+    if (!ast || parser_has_error(parser) || parser->current_token.type != TOKEN_EOF)
+    {
+        ast_free(ast);
+        return NULL;
+    }
+    return ast;
+}
+
+// Build prefix repeated count times, then "1", then suffix repeated count times
+static char *repeat_around(const char *prefix, const char *suffix, int count)
+{
+    size_t length = (strlen(prefix) + strlen(suffix)) * (size_t)count + 2;
+    char *text = malloc(length);
+    if (!text)
+    {
+        return NULL;
+    }
+    char *end = text;
+    for (int i = 0; i < count; i++)
+    {
+        end += sprintf(end, "%s", prefix);
+    }
+    *end++ = '1';
+    for (int i = 0; i < count; i++)
+    {
+        end += sprintf(end, "%s", suffix);
+    }
+    *end = '\0';
+    return text;
+}
+
+int test_parser_deep_nesting(void)
+{
+    printf("Testing deeply nested input...\n");
+
+    Parser parser;
+
+    // Parentheses add no depth to the tree, however many there are
+    char *parens = repeat_around("(", ")", 200000);
+    TEST_ASSERT(parens != NULL, "Input should be built");
+    ASTNode *ast = parse_long_expression(parens, 10, &parser);
+    free(parens);
+    TEST_ASSERT(ast && ast->type == NODE_NUMBER, "Nested parentheses should parse to a number");
+    ast_free(ast);
+
+    // Nested operators and calls are bounded by the nesting limit
+    char *powers = repeat_around("2^(", ")", 5000);
+    TEST_ASSERT(powers != NULL, "Input should be built");
+    ast = parse_long_expression(powers, 0, &parser);
+    TEST_ASSERT(ast != NULL, "Deep nesting should parse without a limit");
+    TEST_ASSERT(parser_get_recursion_depth(&parser) == 5000, "Nesting depth should be reported");
+    int depth = 0;
+    for (ASTNode *node = ast; node->type == NODE_BINOP; node = node->binop.right)
+    {
+        depth++;
+    }
+    TEST_ASSERT(depth == 5000, "Every power should be nested in the tree");
+    ast_free(ast);
+
+    ast = parse_long_expression(powers, 4999, &parser);
+    free(powers);
+    TEST_ASSERT(ast == NULL, "Nesting beyond the limit should fail");
+    TEST_ASSERT(strstr(parser_get_error_message(&parser), "nesting") != NULL,
+                "The error should name the nesting limit");
+
+    char *calls = repeat_around("sqrt(-", ")", 3000);
+    TEST_ASSERT(calls != NULL, "Input should be built");
+    ast = parse_long_expression(calls, 0, &parser);
+    free(calls);
+    TEST_ASSERT(ast && ast->type == NODE_FUNCTION && ast->function.args[0]->type == NODE_UNARY,
+                "Nested calls should parse");
+    ast_free(ast);
+
+    printf("  ✅ Deep nesting tests passed\n");
+    return 1;
+}
+
+int test_parser_flattening(void)
+{
+    printf("Testing n-ary sums and products...\n");
+
+    // Chains of + and - become one sum, subtracted terms negated
+    ASTNode *ast = parse_test_expression("a + b - c + d");
+    TEST_ASSERT(ast && ast->type == NODE_NARY, "Sum of four terms should be one node");
+    TEST_ASSERT(ast->nary.op == TOKEN_PLUS && ast->nary.count == 4, "Sum should hold every term");
+    ASTNode *negated = ast->nary.operands[2];
+    TEST_ASSERT(negated->type == NODE_UNARY && negated->unary.op == TOKEN_MINUS &&
+                    negated->unary.operand->type == NODE_VARIABLE,
+                "Subtracted term should be negated");
+    ast_free(ast);
+
+    ast = parse_test_expression("a * b * c + d * e");
+    TEST_ASSERT(ast && ast->type == NODE_BINOP && ast->binop.op == TOKEN_PLUS,
+                "Two terms should stay a binary sum");
+    TEST_ASSERT(ast->binop.left->type == NODE_NARY && ast->binop.left->nary.op == TOKEN_STAR &&
+                    ast->binop.left->nary.count == 3,
+                "Three factors should be one product");
+    ast_free(ast);
+
+    // Division and powers keep their binary shape
+    ast = parse_test_expression("a / b / c");
+    TEST_ASSERT(ast && ast->type == NODE_BINOP && ast->binop.left->type == NODE_BINOP,
+                "Quotients should not be flattened");
+    ast_free(ast);
+
+    // A chain as long as the input adds no depth
+    int terms = 100000;
+    char *chain = malloc((size_t)terms * 2 + 1);
+    TEST_ASSERT(chain != NULL, "Input should be built");
+    for (int i = 0; i < terms; i++)
+    {
+        chain[2 * i] = 'x';
+        chain[2 * i + 1] = i + 1 < terms ? (i % 2 ? '-' : '+') : '\0';
+    }
+    Parser parser;
+    ast = parse_long_expression(chain, 0, &parser);
+    free(chain);
+    TEST_ASSERT(ast && ast->type == NODE_NARY && ast->nary.count == terms,
+                "Long chain should be one sum");
+    TEST_ASSERT(ast->nary.operands[terms - 1]->type == NODE_VARIABLE ||
+                    ast->nary.operands[terms - 1]->type == NODE_UNARY,
+                "Terms should be leaves");
+    ast_free(ast);
+
+    printf("  ✅ N-ary node tests passed\n");
+    return 1;
+}
+
+int test_parser_grammar_levels(void)
+{
+    printf("Testing grammar level entry points...\n");
+
+    // Each level stops at the first operator binding more loosely
+    struct
+    {
+        ASTNode *(*parse)(Parser *);
+        const char *input;
+        TokenType stop;
+    } cases[] = {
+        {parser_parse_term, "1 + 2 * 3 < 4", TOKEN_LT},
+        {parser_parse_factor, "2 * 3 ^ 2 + 1", TOKEN_PLUS},
+        {parser_parse_power, "2 ^ 3 * 4", TOKEN_STAR},
+        {parser_parse_power, "2 ^ 3(4)", TOKEN_LPAREN},
+        {parser_parse_unary, "-2 ^ 3", TOKEN_CARET},
+        {parser_parse_primary, "(1 + 2) * 3", TOKEN_STAR},
+        {parser_parse_primary, "sin(1) + 2", TOKEN_PLUS},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        Lexer lexer;
+        lexer_init(&lexer, cases[i].input);
+        Parser parser;
+        parser_init(&parser, &lexer);
+        ASTNode *ast = cases[i].parse(&parser);
+        TEST_ASSERT(ast != NULL && !parser_has_error(&parser), cases[i].input);
+        TEST_ASSERT(parser.current_token.type == cases[i].stop, cases[i].input);
+        ast_free(ast);
+    }
+
+    // Primaries take no sign
+    Lexer lexer;
+    lexer_init(&lexer, "-1");
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_quiet(&parser, 1);
+    TEST_ASSERT(parser_parse_primary(&parser) == NULL, "A sign is not a primary");
+
+    printf("  ✅ Grammar level tests passed\n");
+    return 1;
+}
+
 int run_parser_tests(void)
 {
     printf("Running Parser Test Suite\n");
@@ -325,6 +583,18 @@ int run_parser_tests(void)
     total++;
     if (test_parser_complex_expressions())
         passed++;
+    total++;
+    if (test_parser_arena())
+        passed++;
+    total++;
+    if (test_parser_deep_nesting())
+        passed++;
+    total++;
+    if (test_parser_flattening())
+        passed++;
+    total++;
+    if (test_parser_grammar_levels())
+        passed++;
 
     printf("\n=========================\n");
     printf("Parser Tests: %d/%d passed\n", passed, total);
@@ -0,0 +1,142 @@
+#include "plan_cache.h"
+#include "parser.h"
+#include "lexer.h"
+#include <stdio.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Parse a line into its own arena and store it at a precision, like the REPL
+static int plan_test_store(const char *input, mpfr_prec_t precision)
+{
+    ASTArena *arena = ast_arena_create(PLAN_CACHE_ARENA_BLOCK_SIZE);
+    Lexer lexer;
+    lexer_init(&lexer, input);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_quiet(&parser, 1);
+    parser_set_arena(&parser, arena);
+    parser_set_precision(&parser, precision);
+
+    ASTNode *ast = parser_parse_expression(&parser);
+    int ok = ast && !parser_has_error(&parser) && parser.current_token.type == TOKEN_EOF;
+    token_free(&parser.previous_token);
+    token_free(&parser.current_token);
+    if (!ok)
+    {
+        ast_arena_destroy(arena);
+        return 0;
+    }
+    plan_cache_store(input, arena, ast, precision, MPFR_RNDN, parser.inexact_literals == 0);
+    return 1;
+}
+
+static int test_plan_cache_lookup(void)
+{
+    printf("Testing plan lookups...\n");
+
+    plan_cache_cleanup();
+    TEST_ASSERT(plan_cache_enabled(), "The cache should start enabled");
+    TEST_ASSERT(plan_cache_lookup("sqrt(2) * 3", 256, MPFR_RNDN) == NULL,
+                "An unseen line should miss");
+    TEST_ASSERT(plan_test_store("sqrt(2) * 3", 256), "The line should parse");
+
+    const ASTNode *plan = plan_cache_lookup("sqrt(2) * 3", 256, MPFR_RNDN);
+    TEST_ASSERT(plan && plan->type == NODE_BINOP, "A stored line should hit");
+    TEST_ASSERT(plan_cache_lookup("  sqrt(2)   *\t3 ", 256, MPFR_RNDN) == plan,
+                "Whitespace runs should not matter");
+    TEST_ASSERT(plan_cache_lookup("sqrt(2)*3", 256, MPFR_RNDN) == NULL,
+                "Removing whitespace is a different line");
+
+    // Exact integer literals read the same at every precision
+    TEST_ASSERT(plan_cache_lookup("sqrt(2) * 3", 1024, MPFR_RNDZ) == plan,
+                "An exact line should hit at any precision");
+
+    // A rounded literal ties the plan to its parse settings
+    TEST_ASSERT(plan_test_store("0.1 + 2", 256), "The line should parse");
+    TEST_ASSERT(plan_cache_lookup("0.1 + 2", 256, MPFR_RNDN) != NULL,
+                "The inexact line should hit at its precision");
+    TEST_ASSERT(plan_cache_lookup("0.1 + 2", 512, MPFR_RNDN) == NULL,
+                "The inexact line should miss at another precision");
+    TEST_ASSERT(plan_cache_lookup("0.1 + 2", 256, MPFR_RNDU) == NULL,
+                "The inexact line should miss with another rounding");
+    TEST_ASSERT(plan_test_store("0.1 + 2", 512), "The line should parse again");
+    const ASTNode *reparsed = plan_cache_lookup("0.1 + 2", 512, MPFR_RNDN);
+    TEST_ASSERT(reparsed && mpfr_get_prec(reparsed->binop.left->number.literal->value) == 512,
+                "The new parse should replace the old one");
+
+    PlanCacheStats stats;
+    plan_cache_get_stats(&stats);
+    TEST_ASSERT(stats.entries == 2, "Each line should be cached once");
+    TEST_ASSERT(stats.hits == 5 && stats.misses == 4, "Hits and misses should be counted");
+
+    plan_cache_cleanup();
+    printf("  ✅ Plan lookup tests passed\n");
+    return 1;
+}
+
+static int test_plan_cache_eviction(void)
+{
+    printf("Testing plan eviction...\n");
+
+    plan_cache_cleanup();
+    TEST_ASSERT(plan_test_store("1 + 2", 128), "The line should parse");
+    PlanCacheStats stats;
+    plan_cache_get_stats(&stats);
+    size_t one = stats.bytes;
+
+    // Room for three plans of the same size
+    plan_cache_set_capacity(3 * one + one / 2);
+    TEST_ASSERT(plan_test_store("1 + 3", 128) && plan_test_store("1 + 4", 128),
+                "The lines should parse");
+    TEST_ASSERT(plan_cache_lookup("1 + 2", 128, MPFR_RNDN) != NULL,
+                "The oldest line should be marked recently used");
+    TEST_ASSERT(plan_test_store("1 + 5", 128), "The line should parse");
+    TEST_ASSERT(plan_cache_lookup("1 + 3", 128, MPFR_RNDN) == NULL,
+                "The least recently used line should be evicted");
+    TEST_ASSERT(plan_cache_lookup("1 + 2", 128, MPFR_RNDN) != NULL &&
+                    plan_cache_lookup("1 + 5", 128, MPFR_RNDN) != NULL,
+                "Recently used lines should be kept");
+    plan_cache_get_stats(&stats);
+    TEST_ASSERT(stats.evictions == 1 && stats.entries == 3 && stats.bytes <= stats.capacity,
+                "The cap should be kept");
+
+    plan_cache_set_capacity(0);
+    TEST_ASSERT(!plan_cache_enabled(), "A zero cap should disable the cache");
+    TEST_ASSERT(plan_test_store("1 + 2", 128), "Storing while disabled should be harmless");
+    TEST_ASSERT(plan_cache_lookup("1 + 2", 128, MPFR_RNDN) == NULL,
+                "A disabled cache should never hit");
+
+    plan_cache_cleanup();
+    printf("  ✅ Plan eviction tests passed\n");
+    return 1;
+}
+
+int run_plan_cache_tests(void)
+{
+    printf("Running Plan Cache Test Suite\n");
+    printf("=============================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_plan_cache_lookup())
+        passed++;
+    total++;
+    if (test_plan_cache_eviction())
+        passed++;
+
+    printf("\n=============================\n");
+    printf("Plan Cache Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -5,8 +5,11 @@
 #include "functions.h"
 #include "function_table.h"
 #include "lexer.h"
+#include "context.h"
+#include "multidouble.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define TEST_ASSERT(condition, message)         \
     do                                          \
@@ -308,6 +311,203 @@ int test_precision_edge_cases(void)
     return 1;
 }
 
+static ASTNode *parse_at_precision(const char *expr, mpfr_prec_t precision)
+{
+    Lexer lexer;
+    lexer_init(&lexer, expr);
+
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_quiet(&parser, 1);
+    parser_set_precision(&parser, precision);
+
+    ASTNode *ast = parser_parse_expression(&parser);
+    if (!ast || parser_has_error(&parser) || parser.current_token.type != TOKEN_EOF)
+    {
+        ast_free(ast);
+        ast = NULL;
+    }
+    token_free(&parser.previous_token);
+    token_free(&parser.current_token);
+    return ast;
+}
+
+// Compare the double-double/quad-double backend with MPFR on one
+// expression. Returns 1 if they agree or the backend declined; taken
+// counts the expressions the backend answered.
+static int multidouble_matches_mpfr(const char *expr, mpfr_prec_t precision, mpfr_rnd_t rounding,
+                                    int *taken)
+{
+    ASTNode *ast = parse_at_precision(expr, precision);
+    if (!ast)
+    {
+        printf("    could not parse: %s\n", expr);
+        return 0;
+    }
+
+    EvalContext ctx;
+    eval_context_init(&ctx, precision);
+    ctx.rounding = rounding;
+    ctx.native = 0;
+
+    mpfr_t fast, expected;
+    mpfr_init2(fast, precision);
+    mpfr_init2(expected, precision);
+
+    int ok = 1;
+    if (multidouble_eval(&ctx, fast, ast))
+    {
+        (*taken)++;
+        evaluator_eval_ctx(&ctx, expected, ast);
+        ok = mpfr_equal_p(fast, expected) && !eval_context_get_error(&ctx);
+        if (!ok)
+        {
+            mpfr_printf("    %s at %ld bits: multidouble %.40Rg, mpfr %.40Rg\n", expr,
+                        (long)precision, fast, expected);
+        }
+    }
+
+    mpfr_clears(fast, expected, (mpfr_ptr)0);
+    eval_context_cleanup(&ctx);
+    ast_free(ast);
+    return ok;
+}
+
+static const char *multidouble_corpus[] = {
+    "2 + 3 * 4",
+    "1/3 + 2/7",
+    "sqrt(2) * sqrt(3)",
+    "sin(1) + cos(2) * tan(0.5)",
+    "exp(1.5) - log(7) / log10(3)",
+    "atan2(exp(1), pow(2, sqrt(2)))",
+    "atan2(-1, -2) + atan(1e10)",
+    "asin(0.3) + acos(-0.7) - atan(5)",
+    "sinh(2) * cosh(0.5) / tanh(3)",
+    "asinh(4) + acosh(3) - atanh(0.25)",
+    "sinh(1e-5) + tanh(-0.001) + asinh(-0.01)",
+    "abs(-2.5) + floor(pi * 10) + ceil(-e)",
+    "2^0.5 + 10^-3 + (-2)^3 + 1.5^-7",
+    "pi * e - gamma + ln2 * ln10 + sqrt2",
+    "-(3^0.5) / (1 + 1e-10)",
+    "1e100 * 1e-90 + 1.5e10 / 3e8",
+    "sin(100) + cos(-1000.5)",
+    "exp(-20) + log(1e-5)",
+    "(1 + 2 < 4) + (5 >= 5) + (pi != e)",
+};
+
+int test_precision_multidouble_backend(void)
+{
+    printf("Testing double-double and quad-double backend against MPFR...\n");
+
+    const mpfr_prec_t precisions[] = {53, 64, 80, MULTIDOUBLE_DD_MAX_PRECISION, 106, 128, 160,
+                                      MULTIDOUBLE_QD_MAX_PRECISION};
+    const mpfr_rnd_t modes[] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD};
+    size_t count = sizeof(multidouble_corpus) / sizeof(multidouble_corpus[0]);
+    size_t precision_count = sizeof(precisions) / sizeof(precisions[0]);
+    size_t mode_count = sizeof(modes) / sizeof(modes[0]);
+
+    int taken = 0;
+    for (size_t p = 0; p < precision_count; p++)
+    {
+        for (size_t m = 0; m < mode_count; m++)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                TEST_ASSERT(multidouble_matches_mpfr(multidouble_corpus[i], precisions[p],
+                                                     modes[m], &taken),
+                            "Multidouble result should match MPFR");
+            }
+        }
+    }
+    TEST_ASSERT(taken > (int)(count * precision_count * mode_count * 3 / 4),
+                "Most evaluations should stay in hardware arithmetic");
+
+    // Generated expressions at both widths
+    static const char *functions[] = {"sin", "cos", "exp", "sqrt", "log", "atan", "tanh", "cosh"};
+    static const char operators[] = {'+', '-', '*', '/'};
+    unsigned long state = 54321;
+    int generated = 0;
+    const int total = 1000;
+    for (int i = 0; i < total; i++)
+    {
+        long values[4];
+        for (int j = 0; j < 4; j++)
+        {
+            state = state * 6364136223846793005UL + 1442695040888963407UL;
+            values[j] = (long)((state >> 33) % 20000) + 1;
+        }
+        char expr[128];
+        snprintf(expr, sizeof(expr), "(%ld.%02ld %c %ld) %c %s(%ld / 997)", values[0] / 100,
+                 values[0] % 100, operators[values[1] % 4], values[1], operators[values[2] % 4],
+                 functions[values[3] % 8], values[3]);
+
+        mpfr_prec_t precision = (i % 2) ? 100 : 192;
+        mpfr_rnd_t rounding = (i % 3 == 0) ? MPFR_RNDZ : MPFR_RNDN;
+        TEST_ASSERT(multidouble_matches_mpfr(expr, precision, rounding, &generated),
+                    "Multidouble result should match MPFR");
+    }
+    TEST_ASSERT(generated > total * 9 / 10, "Nearly all generated expressions should be taken");
+
+    // Untrustworthy results fall back, and wide precisions never start here
+    static const char *declined[] = {"1/0", "sqrt(-1)", "log(0)", "sin(pi)", "pi == pi",
+                                     "2^10000", "1e-300 * 2"};
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    mpfr_t result;
+    mpfr_init2(result, 128);
+    for (size_t i = 0; i < sizeof(declined) / sizeof(declined[0]); i++)
+    {
+        ASTNode *ast = parse_at_precision(declined[i], 128);
+        TEST_ASSERT(ast != NULL, "Expression should parse");
+        int fast = multidouble_eval(&ctx, result, ast);
+        ast_free(ast);
+        if (fast)
+        {
+            printf("    expression: %s\n", declined[i]);
+        }
+        TEST_ASSERT(!fast, "Untrustworthy results should fall back to MPFR");
+    }
+    TEST_ASSERT(strcmp(evaluator_backend_name(&ctx), "quad-double") == 0,
+                "128 bits should report the quad-double backend");
+    eval_context_set_precision(&ctx, MULTIDOUBLE_QD_MAX_PRECISION + 1);
+    mpfr_set_prec(result, MULTIDOUBLE_QD_MAX_PRECISION + 1);
+    ASTNode *ast = parse_at_precision("1/3", MULTIDOUBLE_QD_MAX_PRECISION + 1);
+    int wide = multidouble_eval(&ctx, result, ast);
+    ast_free(ast);
+    TEST_ASSERT(!wide && strcmp(evaluator_backend_name(&ctx), "MPFR") == 0,
+                "Precisions above MULTIDOUBLE_QD_MAX_PRECISION should use MPFR");
+
+    // Only elementary functions make the backend worth trying; trees parsed
+    // at another precision keep their folded subtrees
+    static const struct
+    {
+        const char *expr;
+        mpfr_prec_t precision;
+        int pays_off;
+    } gains[] = {
+        {"exp(1) + 2", 128, 1}, {"1/3 + 2/7", 128, 0}, {"sqrt(2) * 3", 80, 0},
+        {"sin(1)", 80, 1},      {"sin(1)", 128, 0},    {"atan(sin(1))", 128, 1},
+    };
+    for (size_t i = 0; i < sizeof(gains) / sizeof(gains[0]); i++)
+    {
+        eval_context_set_precision(&ctx, gains[i].precision);
+        mpfr_set_prec(result, gains[i].precision);
+        ast = parse_at_precision(gains[i].expr, 64);
+        int pays_off = multidouble_pays_off(&ctx, result, ast);
+        ast_free(ast);
+        if (pays_off != gains[i].pays_off)
+        {
+            printf("    expression: %s at %ld bits\n", gains[i].expr, (long)gains[i].precision);
+        }
+        TEST_ASSERT(pays_off == gains[i].pays_off, "Only elementary functions should pay off");
+    }
+    mpfr_clear(result);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Multidouble backend tests passed (%d/%d generated taken)\n", generated, total);
+    return 1;
+}
+
 int run_precision_tests(void)
 {
     printf("Running Precision Test Suite\n");
@@ -343,6 +543,9 @@ int run_precision_tests(void)
     total++;
     if (test_precision_edge_cases())
         passed++;
+    total++;
+    if (test_precision_multidouble_backend())
+        passed++;
 
     printf("\n============================\n");
     printf("Precision Tests: %d/%d passed\n", passed, total);
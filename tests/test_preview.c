@@ -0,0 +1,239 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "preview.h"
+#include "context.h"
+#include "evaluator.h"
+#include "lexer.h"
+#include "parser.h"
+#include "variables.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Check that tokens kept by re-lexing are those of lexing the whole line
+static int preview_test_same_as_lexer(const PreviewTokens *tokens, const char *text)
+{
+    Lexer lexer;
+    lexer_init(&lexer, text);
+    for (size_t i = 0; i < tokens->count; i++)
+    {
+        Token expected = lexer_get_next_token(&lexer);
+        const Token *token = &tokens->tokens[i];
+        if (token->type != expected.type || token->offset != expected.offset ||
+            token->length != expected.length ||
+            (token->type == TOKEN_INT && token->int_value != expected.int_value) ||
+            (token->type == TOKEN_FLOAT && token->float_value != expected.float_value))
+        {
+            return 0;
+        }
+        if (expected.type == TOKEN_EOF)
+        {
+            return i + 1 == tokens->count;
+        }
+    }
+    return 0;
+}
+
+// Wait for the worker to finish with the current text; returns its preview
+static unsigned long preview_test_wait(char *text, size_t size)
+{
+    struct timespec pause = {0, 10000000};
+    for (int i = 0; i < 500 && preview_pending(); i++)
+    {
+        nanosleep(&pause, NULL);
+    }
+    return preview_get(text, size);
+}
+
+static int preview_test_shows(const char *line, const char *expected)
+{
+    char text[PREVIEW_TEXT_SIZE];
+    preview_update(line);
+    return preview_test_wait(text, sizeof(text)) != 0 && strcmp(text, expected) == 0;
+}
+
+static int test_preview_relex(void)
+{
+    printf("Testing incremental re-lexing...\n");
+
+    PreviewTokens tokens;
+    memset(&tokens, 0, sizeof(tokens));
+    TEST_ASSERT(preview_relex(&tokens, "sqrt(2) + 1") == 0, "A first line keeps nothing");
+    TEST_ASSERT(preview_test_same_as_lexer(&tokens, "sqrt(2) + 1"), "First line lexed wrong");
+
+    // Only "1" and the tokens a lookahead away from it are lexed again
+    TEST_ASSERT(preview_relex(&tokens, "sqrt(2) + 10") == 4, "The prefix should be kept");
+    TEST_ASSERT(preview_test_same_as_lexer(&tokens, "sqrt(2) + 10"), "Appended line lexed wrong");
+    TEST_ASSERT(preview_relex(&tokens, "sqrt(2) + 10") == (long)tokens.count,
+                "An unchanged line keeps every token");
+
+    // An edit can change a token that ended before it
+    TEST_ASSERT(preview_relex(&tokens, "1e") == 0 && preview_test_same_as_lexer(&tokens, "1e"),
+                "Replaced line lexed wrong");
+    TEST_ASSERT(preview_relex(&tokens, "1e5") == 0 && tokens.count == 2 &&
+                    tokens.tokens[0].type == TOKEN_FLOAT,
+                "The exponent should join the number before it");
+
+    // Typing, deleting and editing in the middle all match a full lex
+    const char *edits[] = {"2",
+                           "2p",
+                           "2pi",
+                           "2pi ",
+                           "2pi +",
+                           "2pi + s",
+                           "2pi + sin(",
+                           "2pi + sin(x",
+                           "2pi + sin(x)",
+                           "2pi + sin(x) == 3e+",
+                           "2pi + sin(x) == 3e+2",
+                           "2pi + sin(x) == 3e",
+                           "2pi + sin(x) == 3",
+                           "2*pi + sin(x) == 3",
+                           "2*pi + asin(x) == 3",
+                           "x = 2*pi + asin(x) == 3",
+                           "",
+                           "1..2 ! 3"};
+    for (size_t i = 0; i < sizeof(edits) / sizeof(edits[0]); i++)
+    {
+        TEST_ASSERT(preview_relex(&tokens, edits[i]) >= 0, "Re-lexing should succeed");
+        TEST_ASSERT(preview_test_same_as_lexer(&tokens, edits[i]),
+                    "Edited line should lex as a whole line does");
+    }
+
+    preview_tokens_free(&tokens);
+    TEST_ASSERT(tokens.count == 0 && tokens.tokens == NULL, "Freed tokens should be empty");
+    printf("  ✅ Incremental re-lexing tests passed\n");
+    return 1;
+}
+
+static int test_preview_cancel_flag(void)
+{
+    printf("Testing per-context cancellation...\n");
+
+    Lexer lexer;
+    lexer_init(&lexer, "sqrt(2) + sin(1)");
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_quiet(&parser, 1);
+    ASTNode *ast = parser_parse_expression(&parser);
+    TEST_ASSERT(ast != NULL, "The expression should parse");
+
+    atomic_int cancel = 1;
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    ctx.cancel = &cancel;
+    mpfr_t result;
+    mpfr_init2(result, 128);
+    evaluator_eval_ctx(&ctx, result, ast);
+    const char *error = eval_context_get_error(&ctx);
+    TEST_ASSERT(error && strstr(error, "interrupted"), "A set flag should stop the evaluation");
+
+    // Other contexts are not affected
+    EvalContext other;
+    eval_context_init(&other, 128);
+    evaluator_eval_ctx(&other, result, ast);
+    TEST_ASSERT(eval_context_get_error(&other) == NULL, "Another context should evaluate");
+
+    atomic_store(&cancel, 0);
+    evaluator_eval_ctx(&ctx, result, ast);
+    TEST_ASSERT(eval_context_get_error(&ctx) == NULL && mpfr_cmp_d(result, 2.255) > 0,
+                "A cleared flag should let the evaluation run");
+
+    mpfr_clear(result);
+    eval_context_cleanup(&ctx);
+    eval_context_cleanup(&other);
+    ast_free(ast);
+    printf("  ✅ Per-context cancellation tests passed\n");
+    return 1;
+}
+
+static int test_preview_worker(void)
+{
+    printf("Testing background previews...\n");
+
+    // The line takes the variables of the thread that begins it
+    VariableTable *variables = variables_create();
+    Lexer lexer;
+    lexer_init(&lexer, "7");
+    Parser parser;
+    parser_init(&parser, &lexer);
+    ASTNode *definition = parser_parse_expression(&parser);
+    TEST_ASSERT(variables && variables_define(variables, "x", definition) == 0,
+                "The variable should be defined");
+    EvalContext *ctx = eval_context_default();
+    VariableTable *saved = ctx->variables;
+    ctx->variables = variables;
+
+    TEST_ASSERT(preview_start() == 0 && preview_running(), "The worker should start");
+    preview_begin_line();
+    TEST_ASSERT(!preview_pending() && preview_get(NULL, 0) == 0, "An empty line has no preview");
+
+    TEST_ASSERT(preview_test_shows("2+3", "5"), "A sum should be previewed");
+    TEST_ASSERT(preview_test_shows("x * 6", "42"), "Variables should be resolved");
+    TEST_ASSERT(preview_test_shows("  x*6 ", "42"), "Respacing should keep the preview");
+    TEST_ASSERT(preview_test_shows("y = x + 1", "8"), "An assignment previews its value");
+
+    char text[PREVIEW_TEXT_SIZE];
+    preview_update("x * (6");
+    TEST_ASSERT(preview_test_wait(text, sizeof(text)) == 0, "An incomplete line has no preview");
+    preview_update("precision 512");
+    TEST_ASSERT(preview_test_wait(text, sizeof(text)) == 0, "A command has no preview");
+    preview_update("pi = 3");
+    TEST_ASSERT(preview_test_wait(text, sizeof(text)) == 0, "Built-in names cannot be assigned");
+
+    // A stale evaluation is cancelled in favour of the new text
+    preview_update("sum(sin(k)^2, k, 1, 100000000)");
+    preview_update("3*3");
+    TEST_ASSERT(preview_test_wait(text, sizeof(text)) != 0 && strcmp(text, "9") == 0,
+                "The latest text should be previewed");
+
+    preview_end_line();
+    TEST_ASSERT(preview_get(text, sizeof(text)) == 0, "An ended line has no preview");
+    preview_update("1+1");
+    TEST_ASSERT(!preview_pending(), "Text after the line ended should be ignored");
+
+    preview_stop();
+    TEST_ASSERT(!preview_running(), "The worker should stop");
+    ctx->variables = saved;
+    variables_destroy(variables);
+    printf("  ✅ Background preview tests passed\n");
+    return 1;
+}
+
+int run_preview_tests(void)
+{
+    printf("Running Preview Test Suite\n");
+    printf("==========================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_preview_relex())
+        passed++;
+    total++;
+    if (test_preview_cancel_flag())
+        passed++;
+    total++;
+    if (test_preview_worker())
+        passed++;
+
+    printf("\n==========================\n");
+    printf("Preview Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+#include "profile.h"
+#include "batch.h"
+#include "precision.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Run batch mode over a text, discarding the output
+static int profile_test_batch(const char *text, int jobs)
+{
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    int status = -1;
+    if (in && out)
+    {
+        fwrite(text, 1, strlen(text), in);
+        rewind(in);
+        status = batch_process_stream(in, out, jobs);
+    }
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+    return status;
+}
+
+int test_profile_counters(void)
+{
+    printf("Testing profile counters...\n");
+
+    // Above hardware precision, so every function goes through MPFR
+    mpfr_prec_t saved_precision = global_precision;
+    set_precision(256);
+    profile_set_enabled(1);
+    profile_reset();
+    profile_test_batch("sin(1)+pi\nsqrt(2)*2\n1+\n", 1);
+    profile_set_enabled(0);
+    set_precision(saved_precision);
+
+    ProfileStats stats;
+    profile_get_stats(&stats);
+    TEST_ASSERT(stats.counters[PROFILE_LINES] == 3, "Every line should be counted");
+    TEST_ASSERT(stats.counters[PROFILE_TOKENS] >= 10, "Tokens should be counted");
+    TEST_ASSERT(stats.counters[PROFILE_AST_NODES] >= 7, "Nodes should be counted");
+    TEST_ASSERT(stats.counters[PROFILE_MPFR_TEMPS] >= 2, "Result temporaries should be counted");
+    TEST_ASSERT(stats.counters[PROFILE_CONSTANT_HITS] + stats.counters[PROFILE_CONSTANT_MISSES] ==
+                    1,
+                "The constant lookup should be counted once");
+    TEST_ASSERT(stats.function_calls[TOKEN_SIN] == 1 && stats.function_calls[TOKEN_SQRT] == 1,
+                "Function calls should be counted per function");
+    TEST_ASSERT(stats.function_calls[TOKEN_COS] == 0, "Uncalled functions should stay at zero");
+    TEST_ASSERT(stats.phase_ns[PROFILE_PARSE] > 0 && stats.phase_ns[PROFILE_EVAL] > 0 &&
+                    stats.phase_ns[PROFILE_FORMAT] > 0,
+                "Every phase should be timed");
+
+    profile_reset();
+    profile_get_stats(&stats);
+    TEST_ASSERT(stats.counters[PROFILE_LINES] == 0 && stats.function_calls[TOKEN_SIN] == 0 &&
+                    stats.phase_ns[PROFILE_EVAL] == 0,
+                "Reset should zero the totals");
+
+    printf("  ✅ Profile counter tests passed\n");
+    return 1;
+}
+
+int test_profile_threads(void)
+{
+    printf("Testing profile counts from worker threads...\n");
+
+    char text[4096] = "";
+    for (int i = 1; i <= 300; i++)
+    {
+        snprintf(text + strlen(text), sizeof(text) - strlen(text), "sqrt(%d)\n", i);
+    }
+
+    mpfr_prec_t saved_precision = global_precision;
+    set_precision(256);
+    profile_set_enabled(1);
+    profile_reset();
+    profile_test_batch(text, 4);
+    profile_set_enabled(0);
+    set_precision(saved_precision);
+
+    ProfileStats stats;
+    profile_get_stats(&stats);
+    TEST_ASSERT(stats.counters[PROFILE_LINES] == 300, "Workers should merge their line counts");
+    TEST_ASSERT(stats.function_calls[TOKEN_SQRT] == 300, "Workers should merge their call counts");
+
+    profile_reset();
+    printf("  ✅ Profile thread tests passed\n");
+    return 1;
+}
+
+int test_profile_disabled(void)
+{
+    printf("Testing disabled profiling...\n");
+
+    TEST_ASSERT(!profile_is_enabled(), "Profiling should start off");
+    profile_reset();
+    profile_test_batch("sin(1)+pi\nsqrt(2)\n", 1);
+
+    ProfileStats stats;
+    profile_get_stats(&stats);
+    ProfileStats zero;
+    memset(&zero, 0, sizeof(zero));
+    TEST_ASSERT(memcmp(&stats, &zero, sizeof(stats)) == 0, "Nothing should be counted while off");
+
+    printf("  ✅ Disabled profiling tests passed\n");
+    return 1;
+}
+
+int run_profile_tests(void)
+{
+    printf("Running Profiling Test Suite\n");
+    printf("============================\n\n");
+
+    if (!profile_available())
+    {
+        printf("Profiling compiled out (NO_PROFILE); skipping\n");
+        return 0;
+    }
+
+    batch_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_profile_disabled())
+        passed++;
+    total++;
+    if (test_profile_counters())
+        passed++;
+    total++;
+    if (test_profile_threads())
+        passed++;
+
+    printf("\n============================\n");
+    printf("Profiling Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
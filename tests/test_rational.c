@@ -0,0 +1,392 @@
+#include "context.h"
+#include "evaluator.h"
+#include "formatter.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+#define RATIONAL_TEST_PRECISION 64
+
+// Evaluate an expression in a context
+static int rational_test_eval(EvalContext *ctx, mpfr_t result, const char *expression)
+{
+    ASTNode *ast = test_parse(expression);
+    if (!ast)
+    {
+        return 0;
+    }
+    evaluator_eval_ctx(ctx, result, ast);
+    ast_free(ast);
+    return 1;
+}
+
+// Check the exact integer a context kept against its decimal digits
+static int rational_test_integer_is(const EvalContext *ctx, const char *digits)
+{
+    mpz_srcptr exact = evaluator_exact_integer(ctx);
+    if (!exact)
+    {
+        return 0;
+    }
+    mpz_t expected;
+    mpz_init_set_str(expected, digits, 10);
+    int same = mpz_cmp(exact, expected) == 0;
+    mpz_clear(expected);
+    return same;
+}
+
+static int test_rational_flags(void)
+{
+    printf("Testing exact subtree flags...\n");
+
+    const char *exact[] = {"2^521 - 1", "-(7 / 3)", "abs(-4) + floor(5/2)", "pow(3, 40)",
+                           "sqrt(16) * ceil(1/3)", "1 < 2", "12345678901234567890 + 1"};
+    const char *inexact[] = {"1.5 + 2", "pi * 2", "sin(1)", "x + 1", "log(8)"};
+
+    for (size_t i = 0; i < sizeof(exact) / sizeof(exact[0]); i++)
+    {
+        ASTNode *ast = test_parse(exact[i]);
+        int flagged = ast && ast->exact;
+        if (!flagged)
+        {
+            printf("  %s not flagged\n", exact[i]);
+        }
+        ast_free(ast);
+        TEST_ASSERT(flagged, "Integer expressions should be flagged exact");
+    }
+    for (size_t i = 0; i < sizeof(inexact) / sizeof(inexact[0]); i++)
+    {
+        ASTNode *ast = test_parse(inexact[i]);
+        int flagged = ast && ast->exact;
+        if (flagged)
+        {
+            printf("  %s flagged\n", inexact[i]);
+        }
+        ast_free(ast);
+        TEST_ASSERT(!flagged, "Decimals, constants and variables are not exact");
+    }
+
+    // The integer part of a mixed expression keeps its flag
+    ASTNode *ast = test_parse("sin(10^20 + 1)");
+    TEST_ASSERT(ast && ast->type == NODE_FUNCTION, "Parse should succeed");
+    TEST_ASSERT(!ast->exact && ast->function.args[0]->exact,
+                "Only the argument of sin should be exact");
+    ast_free(ast);
+
+    printf("  ✅ Exact subtree flag tests passed\n");
+    return 1;
+}
+
+static int test_rational_integers(void)
+{
+    printf("Testing exact integers...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, RATIONAL_TEST_PRECISION);
+    mpfr_t result;
+    mpfr_init2(result, RATIONAL_TEST_PRECISION);
+
+    // A Mersenne prime far past 64 bits keeps every digit
+    TEST_ASSERT(rational_test_eval(&ctx, result, "2^521 - 1"), "Parse should succeed");
+    TEST_ASSERT(!eval_context_get_error(&ctx), "Evaluation should succeed");
+    mpz_t expected;
+    mpz_init(expected);
+    mpz_ui_pow_ui(expected, 2, 521);
+    mpz_sub_ui(expected, expected, 1);
+    mpz_srcptr exact = evaluator_exact_integer(&ctx);
+    TEST_ASSERT(exact && mpz_cmp(exact, expected) == 0, "2^521 - 1 should be exact");
+    mpz_clear(expected);
+
+    // The rounded value is the exact one rounded once
+    mpfr_t rounded;
+    mpfr_init2(rounded, RATIONAL_TEST_PRECISION);
+    mpfr_set_z(rounded, exact, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(result, rounded), "Result should be correctly rounded");
+    mpfr_clear(rounded);
+
+    // Cancellation that floating point loses at this precision
+    TEST_ASSERT(rational_test_eval(&ctx, result, "(10^30 + 1) - 10^30"), "Parse should succeed");
+    TEST_ASSERT(mpfr_cmp_ui(result, 1) == 0, "The difference should be exactly 1");
+    TEST_ASSERT(rational_test_integer_is(&ctx, "1"), "The difference should be kept exact");
+
+    TEST_ASSERT(rational_test_eval(&ctx, result, "10^30 + 1 == 10^30"), "Parse should succeed");
+    TEST_ASSERT(mpfr_zero_p(result), "Comparisons should compare exact values");
+
+    TEST_ASSERT(rational_test_eval(&ctx, result, "pow(-3, 41) + abs(-5) * floor(7/2)"),
+                "Parse should succeed");
+    TEST_ASSERT(rational_test_integer_is(&ctx, "-36472996377170786388"),
+                "Functions should keep integers exact");
+
+    TEST_ASSERT(rational_test_eval(&ctx, result, "sqrt(152415787532388367501905199875019052100)"),
+                "Parse should succeed");
+    TEST_ASSERT(rational_test_integer_is(&ctx, "12345678901234567890"),
+                "Square roots of perfect squares should be exact");
+
+    mpfr_clear(result);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Exact integer tests passed\n");
+    return 1;
+}
+
+static int test_rational_fractions(void)
+{
+    printf("Testing exact fractions...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, RATIONAL_TEST_PRECISION);
+    mpfr_t result, expected;
+    mpfr_init2(result, RATIONAL_TEST_PRECISION);
+    mpfr_init2(expected, RATIONAL_TEST_PRECISION);
+
+    // 1/3 + 1/6 is exactly 1/2
+    TEST_ASSERT(rational_test_eval(&ctx, result, "1/3 + 1/6"), "Parse should succeed");
+    TEST_ASSERT(mpfr_cmp_d(result, 0.5) == 0, "1/3 + 1/6 should be exactly 1/2");
+    TEST_ASSERT(!evaluator_exact_integer(&ctx), "A fraction is not an exact integer");
+
+    // A non-terminating fraction is rounded once, correctly
+    TEST_ASSERT(rational_test_eval(&ctx, result, "22/7 - 3"), "Parse should succeed");
+    mpfr_set_ui(expected, 1, MPFR_RNDN);
+    mpfr_div_ui(expected, expected, 7, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(result, expected), "22/7 - 3 should round 1/7 once");
+
+    TEST_ASSERT(rational_test_eval(&ctx, result, "(2/3)^-3 * 8"), "Parse should succeed");
+    TEST_ASSERT(rational_test_integer_is(&ctx, "27"), "Negative powers should be exact");
+
+    TEST_ASSERT(rational_test_eval(&ctx, result, "sqrt(9/49) * 7"), "Parse should succeed");
+    TEST_ASSERT(rational_test_integer_is(&ctx, "3"), "Square fractions should be exact");
+
+    mpfr_clear(result);
+    mpfr_clear(expected);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Exact fraction tests passed\n");
+    return 1;
+}
+
+static int test_rational_fallback(void)
+{
+    printf("Testing fallback to MPFR...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, RATIONAL_TEST_PRECISION);
+    mpfr_t result, expected;
+    mpfr_init2(result, RATIONAL_TEST_PRECISION);
+    mpfr_init2(expected, RATIONAL_TEST_PRECISION);
+
+    // Values that are not rational go to MPFR
+    TEST_ASSERT(rational_test_eval(&ctx, result, "2^(1/2)"), "Parse should succeed");
+    mpfr_sqrt_ui(expected, 2, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(result, expected), "2^(1/2) should be computed by MPFR");
+    TEST_ASSERT(!evaluator_exact_integer(&ctx), "2^(1/2) is not exact");
+
+    TEST_ASSERT(rational_test_eval(&ctx, result, "sqrt(2)"), "Parse should succeed");
+    TEST_ASSERT(mpfr_equal_p(result, expected), "sqrt(2) should be computed by MPFR");
+
+    // Errors are still reported the usual way
+    TEST_ASSERT(rational_test_eval(&ctx, result, "1/0"), "Parse should succeed");
+    TEST_ASSERT(eval_context_get_error(&ctx), "Division by zero should be an error");
+    TEST_ASSERT(rational_test_eval(&ctx, result, "sqrt(-4)"), "Parse should succeed");
+    TEST_ASSERT(!evaluator_exact_integer(&ctx), "Negative square roots should not be exact");
+
+    // An exact argument is rounded once before the inexact function
+    TEST_ASSERT(rational_test_eval(&ctx, result, "sin(1/3 + 2/3)"), "Parse should succeed");
+    mpfr_set_ui(expected, 1, MPFR_RNDN);
+    mpfr_sin(expected, expected, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(result, expected), "sin(1/3 + 2/3) should be sin(1)");
+    TEST_ASSERT(!evaluator_exact_integer(&ctx), "sin(1) is not exact");
+
+    // Huge exponents are left to MPFR rather than expanded
+    TEST_ASSERT(rational_test_eval(&ctx, result, "3^(10^8)"), "Parse should succeed");
+    TEST_ASSERT(!evaluator_exact_integer(&ctx), "3^(10^8) is too large to expand");
+    TEST_ASSERT(mpfr_number_p(result) && mpfr_sgn(result) > 0, "3^(10^8) should be finite");
+
+    // The tier can be switched off
+    ctx.exact = 0;
+    TEST_ASSERT(rational_test_eval(&ctx, result, "2^521 - 1"), "Parse should succeed");
+    TEST_ASSERT(!evaluator_exact_integer(&ctx), "Without the tier nothing is exact");
+    TEST_ASSERT(mpfr_cmp_ui_2exp(result, 1, 521) == 0, "64 bits round 2^521 - 1 up");
+
+    mpfr_clear(result);
+    mpfr_clear(expected);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Fallback tests passed\n");
+    return 1;
+}
+
+static const char *rational_signed_zero_corpus[] = {
+    "atan2(-0, -1)",
+    "atan2(0*-1, -1)",
+    "atan2(-(1 - 1), -1)",
+    "atan2(0/-3, -1)",
+    "atan2((-0)^3, -1)",
+    "atan2((-0)^2, -1)",
+    "atan2(pow(-0, 5), -1)",
+    "atan2(-0 - 0, -1)",
+    "atan2(-0 + 0, -1)",
+    "atan2(ceil(-1/2), -1)",
+    "atan2(floor(-1/2) + 1, -1)",
+    "atan2(abs(-0), -1)",
+    "atan2(sqrt(-0), -1)",
+    "atan2(-0 * 2 * 3, -1)",
+    "atan2(2 - 3 + 1, -1)",
+};
+
+static int test_rational_signed_zero(void)
+{
+    printf("Testing signed zeros...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, RATIONAL_TEST_PRECISION);
+    mpfr_t result, expected;
+    mpfr_init2(result, RATIONAL_TEST_PRECISION);
+    mpfr_init2(expected, RATIONAL_TEST_PRECISION);
+
+    // atan2() tells -0 from +0, so the tier has to give zeros MPFR's sign
+    mpfr_rnd_t roundings[] = {MPFR_RNDN, MPFR_RNDD};
+    for (size_t r = 0; r < sizeof(roundings) / sizeof(roundings[0]); r++)
+    {
+        ctx.rounding = roundings[r];
+        size_t count = sizeof(rational_signed_zero_corpus) / sizeof(rational_signed_zero_corpus[0]);
+        for (size_t i = 0; i < count; i++)
+        {
+            ctx.exact = 1;
+            TEST_ASSERT(rational_test_eval(&ctx, result, rational_signed_zero_corpus[i]),
+                        "Parse should succeed");
+            ctx.exact = 0;
+            TEST_ASSERT(rational_test_eval(&ctx, expected, rational_signed_zero_corpus[i]),
+                        "Parse should succeed");
+            TEST_ASSERT(mpfr_equal_p(result, expected),
+                        "A zero from the exact tier should keep MPFR's sign");
+        }
+    }
+
+    ctx.rounding = MPFR_RNDN;
+    ctx.exact = 1;
+    TEST_ASSERT(rational_test_eval(&ctx, result, "atan2(-0, -1)"), "Parse should succeed");
+    TEST_ASSERT(mpfr_sgn(result) < 0, "atan2(-0, -1) should be -pi");
+
+    mpfr_clear(result);
+    mpfr_clear(expected);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Signed zero tests passed\n");
+    return 1;
+}
+
+static int test_rational_adaptive(void)
+{
+    printf("Testing exact subtrees in adaptive mode...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, RATIONAL_TEST_PRECISION);
+    ctx.adaptive = 1;
+    mpfr_t result;
+    mpfr_init2(result, RATIONAL_TEST_PRECISION);
+
+    // An exact subtree needs no extra passes, whatever its cancellation
+    TEST_ASSERT(rational_test_eval(&ctx, result, "(10^40 + 7) - 10^40"), "Parse should succeed");
+    TEST_ASSERT(mpfr_cmp_ui(result, 7) == 0, "The difference should be exactly 7");
+    TEST_ASSERT(ctx.adaptive_passes == 0, "Exact results take no adaptive passes");
+
+    // Inside an inexact tree it is one exact operand among others
+    TEST_ASSERT(rational_test_eval(&ctx, result, "pi * ((10^40 + 1) - 10^40)"),
+                "Parse should succeed");
+    mpfr_t pi;
+    mpfr_init2(pi, RATIONAL_TEST_PRECISION);
+    mpfr_const_pi(pi, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(result, pi), "pi * 1 should be pi");
+    mpfr_clear(pi);
+
+    mpfr_clear(result);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Adaptive exact tests passed\n");
+    return 1;
+}
+
+static int test_rational_format(void)
+{
+    printf("Testing exact result formatting...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, RATIONAL_TEST_PRECISION);
+    mpfr_t result;
+    mpfr_init2(result, RATIONAL_TEST_PRECISION);
+
+    // Every digit of 2^200 is printed, not just the 64 bits the value holds
+    TEST_ASSERT(rational_test_eval(&ctx, result, "2^200"), "Parse should succeed");
+    FormatBuffer buffer;
+    format_buffer_init(&buffer);
+    TEST_ASSERT(formatter_format_result_ctx(&ctx, &buffer, result, 1), "Formatting should succeed");
+    int full = strcmp(buffer.data,
+                      "1606938044258990275541962092341162602522202993782792835301376") == 0;
+    if (!full)
+    {
+        printf("  got %s\n", buffer.data);
+    }
+    TEST_ASSERT(full, "2^200 should be printed in full");
+
+    // Other modes and fractions format the rounded value as before
+    format_buffer_reset(&buffer);
+    TEST_ASSERT(rational_test_eval(&ctx, result, "1/4"), "Parse should succeed");
+    TEST_ASSERT(formatter_format_result_ctx(&ctx, &buffer, result, 0), "Formatting should succeed");
+    TEST_ASSERT(strcmp(buffer.data, "0.25") == 0, "1/4 should print as 0.25");
+    format_buffer_free(&buffer);
+
+    mpfr_clear(result);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Exact formatting tests passed\n");
+    return 1;
+}
+
+int run_rational_tests(void)
+{
+    printf("Running Exact Arithmetic Test Suite\n");
+    printf("===================================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_rational_flags())
+        passed++;
+    total++;
+    if (test_rational_integers())
+        passed++;
+    total++;
+    if (test_rational_fractions())
+        passed++;
+    total++;
+    if (test_rational_fallback())
+        passed++;
+    total++;
+    if (test_rational_signed_zero())
+        passed++;
+    total++;
+    if (test_rational_adaptive())
+        passed++;
+    total++;
+    if (test_rational_format())
+        passed++;
+
+    printf("\n===================================\n");
+    printf("Exact Arithmetic Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+#include "context.h"
+#include "evaluator.h"
+#include "reduce.h"
+#include "variables.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+static char reduce_test_parse_error[256];
+
+static ASTNode *reduce_test_parse(const char *input)
+{
+    TestParseOptions options = {0};
+    options.error = reduce_test_parse_error;
+    options.error_size = sizeof(reduce_test_parse_error);
+    return test_parse_with(input, &options);
+}
+
+// Evaluate an expression into result; 0 if it does not parse or fails
+static int reduce_test_eval(EvalContext *ctx, const char *input, mpfr_t result)
+{
+    ASTNode *ast = reduce_test_parse(input);
+    if (!ast)
+    {
+        return 0;
+    }
+    eval_context_clear_error(ctx);
+    evaluator_eval_ctx(ctx, result, ast);
+    ast_free(ast);
+    return eval_context_get_error(ctx) == NULL;
+}
+
+// Evaluate and compare with the value of another expression to 2^-bits
+static int reduce_test_close(EvalContext *ctx, const char *input, const char *expected, int bits)
+{
+    mpfr_t value, reference;
+    mpfr_inits2(ctx->precision, value, reference, (mpfr_ptr)0);
+    int ok = reduce_test_eval(ctx, input, value) && reduce_test_eval(ctx, expected, reference);
+    if (ok)
+    {
+        mpfr_sub(value, value, reference, MPFR_RNDN);
+        ok = mpfr_zero_p(value) || mpfr_get_exp(value) < -bits;
+    }
+    mpfr_clears(value, reference, (mpfr_ptr)0);
+    return ok;
+}
+
+// Evaluate an expression that should fail; 1 if the error contains text
+static int reduce_test_error(EvalContext *ctx, const char *input, const char *text)
+{
+    mpfr_t value;
+    mpfr_init2(value, ctx->precision);
+    ASTNode *ast = reduce_test_parse(input);
+    int ok;
+    if (!ast)
+    {
+        ok = strstr(reduce_test_parse_error, text) != NULL;
+    }
+    else
+    {
+        eval_context_clear_error(ctx);
+        evaluator_eval_ctx(ctx, value, ast);
+        const char *error = eval_context_get_error(ctx);
+        ok = error && strstr(error, text) != NULL;
+        ast_free(ast);
+    }
+    mpfr_clear(value);
+    return ok;
+}
+
+static int test_reduce_sum(void)
+{
+    printf("Testing sums...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 256);
+    mpfr_t result;
+    mpfr_init2(result, 256);
+
+    TEST_ASSERT(reduce_test_eval(&ctx, "sum(k^2, k, 1, 100)", result) &&
+                    mpfr_cmp_ui(result, 338350) == 0,
+                "Sum of squares to 100 should be 338350");
+    TEST_ASSERT(reduce_test_eval(&ctx, "sum(k, k, 5, 4)", result) && mpfr_zero_p(result),
+                "An empty range should sum to 0");
+    TEST_ASSERT(reduce_test_eval(&ctx, "sum(sum(i*j, j, 1, i), i, 1, 4)", result) &&
+                    mpfr_cmp_ui(result, 65) == 0,
+                "Nested sums should see both variables");
+    TEST_ASSERT(reduce_test_close(&ctx, "sum(1/2^k, k, 0, 200)", "2 - 1/2^200", 240),
+                "A geometric sum should be accurate");
+
+    // Long enough to be split over threads
+    TEST_ASSERT(reduce_test_close(&ctx, "sum(1/k^2, k, 1, 100000)",
+                                  "pi^2/6 - 1/100000 + 1/(2*100000^2) - 1/(6*100000^3)", 80),
+                "A long sum should be accurate");
+
+    TEST_ASSERT(reduce_test_error(&ctx, "sum(k, 2, 1, 3)", "expects a variable"),
+                "The second argument should be a variable");
+    TEST_ASSERT(reduce_test_error(&ctx, "sum(k, k, 1, 2.5)", "must be integers"),
+                "Bounds should be integers");
+    TEST_ASSERT(reduce_test_error(&ctx, "sum(1/(k - 3), k, 1, 5)", "Division by zero"),
+                "A failing term should fail the sum");
+
+    mpfr_clear(result);
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Sum tests passed\n");
+    return 1;
+}
+
+static int test_reduce_integrate(void)
+{
+    printf("Testing integrals...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 256);
+    mpfr_t result;
+    mpfr_init2(result, 256);
+
+    TEST_ASSERT(reduce_test_close(&ctx, "integrate(exp(x), x, 0, 1)", "e - 1", 250),
+                "The integral of exp should be e - 1");
+    TEST_ASSERT(reduce_test_close(&ctx, "4*integrate(sqrt(1 - x^2), x, 0, 1)", "pi", 250),
+                "A quarter circle should give pi");
+    TEST_ASSERT(reduce_test_close(&ctx, "integrate(1/sqrt(x), x, 0, 1)", "2", 250),
+                "A singularity at 0 should be integrated");
+    TEST_ASSERT(reduce_test_close(&ctx, "integrate(ln(x), x, 0, 1)", "-1", 250),
+                "A logarithmic singularity should be integrated");
+    TEST_ASSERT(reduce_test_close(&ctx, "integrate(x^2, x, 1, 0)", "-1/3", 250),
+                "Reversed bounds should change the sign");
+    TEST_ASSERT(reduce_test_eval(&ctx, "integrate(x, x, 2, 2)", result) && mpfr_zero_p(result),
+                "An empty range should integrate to 0");
+    TEST_ASSERT(reduce_test_close(&ctx, "integrate(sum(x^k, k, 0, 3), x, 0, 1)", "25/12", 250),
+                "A sum should be integrable");
+    TEST_ASSERT(reduce_test_close(&ctx, "integrate(1/(1 + x^2), x, -100, 100)", "2*atan(100)",
+                                  250),
+                "Poles close to a wide range should take the levels 256 bits need");
+
+    TEST_ASSERT(reduce_test_error(&ctx, "integrate(abs(x), x, -1, 2)", "did not converge"),
+                "A kink inside the range should be reported");
+    TEST_ASSERT(reduce_test_error(&ctx, "integrate(x, x, 0, 1/0)", "Division by zero"),
+                "A failing bound should fail the integral");
+
+    mpfr_clear(result);
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Integral tests passed\n");
+    return 1;
+}
+
+// Evaluate with a thread setting; 0 if it fails
+static int reduce_test_threads(EvalContext *ctx, const char *input, int threads, mpfr_t result)
+{
+    reduce_set_threads(threads);
+    int ok = reduce_test_eval(ctx, input, result);
+    reduce_set_threads(0);
+    return ok;
+}
+
+static int test_reduce_determinism(void)
+{
+    printf("Testing results across thread counts...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    mpfr_t serial, parallel;
+    mpfr_inits2(128, serial, parallel, (mpfr_ptr)0);
+
+    const char *inputs[] = {"sum(sin(k)/k, k, 1, 20000)", "integrate(cos(x)^2, x, 0, 3)",
+                            "sum(integrate(x^k, x, 0, 1), k, 1, 600)"};
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        TEST_ASSERT(reduce_test_threads(&ctx, inputs[i], 1, serial), "Serial run should succeed");
+        TEST_ASSERT(reduce_test_threads(&ctx, inputs[i], 4, parallel),
+                    "Parallel run should succeed");
+        TEST_ASSERT(mpfr_equal_p(serial, parallel), "Thread count should not change the result");
+    }
+    TEST_ASSERT(reduce_get_threads() == 0, "The setting should be restored");
+
+    // The first failing term is reported whichever thread reaches it
+    reduce_set_threads(4);
+    int failed = reduce_test_error(&ctx, "sum(1/(k - 3000), k, 1, 6000)", "Division by zero");
+    reduce_set_threads(0);
+    TEST_ASSERT(failed, "A failing term on a worker should fail the sum");
+
+    mpfr_clears(serial, parallel, (mpfr_ptr)0);
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Determinism tests passed\n");
+    return 1;
+}
+
+static int test_reduce_variables(void)
+{
+    printf("Testing variables and modes...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    VariableTable *variables = variables_create();
+    ctx.variables = variables;
+
+    mpfr_t value;
+    mpfr_init2(value, 128);
+    mpfr_set_ui(value, 3, MPFR_RNDN);
+    variables_set_value(variables, "a", value);
+
+    // Free variables are read from the table, the bound one shadows it
+    TEST_ASSERT(reduce_test_close(&ctx, "sum(a*k, k, 1, 4)", "30", 120),
+                "The body should read table variables");
+    variables_set_value(variables, "k", value);
+    TEST_ASSERT(reduce_test_close(&ctx, "sum(k, k, 1, 4) + k", "13", 120),
+                "The bound variable should shadow the table only inside the call");
+    TEST_ASSERT(reduce_test_error(&ctx, "integrate(y, x, 0, 1)", "y"),
+                "An unknown variable in the body should be an error");
+
+    // Adaptive precision gives the same values
+    ctx.adaptive = 1;
+    TEST_ASSERT(reduce_test_close(&ctx, "sum(k^3, k, 1, 10)", "3025", 120),
+                "Adaptive sums should work");
+    TEST_ASSERT(reduce_test_close(&ctx, "integrate(1/(1 + x^2), x, 0, 1)", "pi/4", 120),
+                "Adaptive integrals should work");
+    ctx.adaptive = 0;
+
+    mpfr_clear(value);
+    eval_context_cleanup(&ctx);
+    variables_destroy(variables);
+    printf("  ✅ Variable tests passed\n");
+    return 1;
+}
+
+int run_reduce_tests(void)
+{
+    printf("Running Reduction Test Suite\n");
+    printf("============================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_reduce_sum())
+        passed++;
+    total++;
+    if (test_reduce_integrate())
+        passed++;
+    total++;
+    if (test_reduce_determinism())
+        passed++;
+    total++;
+    if (test_reduce_variables())
+        passed++;
+
+    printf("\n============================\n");
+    printf("Reduction Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "replay.h"
+#include "precision.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Write lines to a new temporary file; path receives its name
+static int replay_test_file(char *path, const char *contents)
+{
+    strcpy(path, "/tmp/replay_test_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    size_t length = strlen(contents);
+    int ok = write(fd, contents, length) == (ssize_t)length;
+    close(fd);
+    return ok;
+}
+
+// Replay a file and read the report back
+static int replay_test_report(const char *path, ReplayReport format, char *report, size_t size)
+{
+    FILE *out = tmpfile();
+    if (!out)
+    {
+        return 0;
+    }
+    int ok = replay_run(path, out, format) == 0;
+    rewind(out);
+    size_t read = fread(report, 1, size - 1, out);
+    report[read] = '\0';
+    fclose(out);
+    return ok;
+}
+
+static int test_replay_percentiles(void)
+{
+    printf("Testing latency percentiles...\n");
+
+    uint64_t sorted[100];
+    for (int i = 0; i < 100; i++)
+    {
+        sorted[i] = (uint64_t)(i + 1);
+    }
+    TEST_ASSERT(replay_percentile(sorted, 100, 50) == 50, "p50 of 1..100 should be 50");
+    TEST_ASSERT(replay_percentile(sorted, 100, 99) == 99, "p99 of 1..100 should be 99");
+    TEST_ASSERT(replay_percentile(sorted, 100, 100) == 100, "p100 should be the maximum");
+    TEST_ASSERT(replay_percentile(sorted, 3, 50) == 2, "p50 of three should be the middle");
+    TEST_ASSERT(replay_percentile(sorted, 1, 95) == 1, "One latency is every percentile");
+    TEST_ASSERT(replay_percentile(sorted, 0, 50) == 0, "No latencies should give 0");
+
+    printf("  ✅ Latency percentile tests passed\n");
+    return 1;
+}
+
+static int test_replay_report(void)
+{
+    printf("Testing replay reports...\n");
+
+    mpfr_prec_t precision = global_precision;
+    char path[64];
+    char report[4096];
+    TEST_ASSERT(replay_test_file(path, "#1700000000\n1+2\n\nprecision 256\nsqrt(2)*exp(3)\n"
+                                       "quit\nsin(1)\n"),
+                "Replay file should be written");
+
+    TEST_ASSERT(replay_test_report(path, REPLAY_REPORT_TEXT, report, sizeof(report)),
+                "Replay should succeed");
+    TEST_ASSERT(strstr(report, "Replayed 5 lines") != NULL,
+                "Blank and timestamp lines should be skipped, quit should not end the replay");
+    TEST_ASSERT(strstr(report, "p95") != NULL && strstr(report, "Slowest lines:") != NULL,
+                "Text report should give percentiles and the slowest lines");
+    TEST_ASSERT(global_precision == 256, "Replayed commands should take effect");
+    set_precision(precision);
+
+    TEST_ASSERT(replay_test_report(path, REPLAY_REPORT_JSON, report, sizeof(report)),
+                "JSON replay should succeed");
+    TEST_ASSERT(report[0] == '{' && strstr(report, "\"lines\": 5,") != NULL,
+                "JSON report should count the lines");
+    TEST_ASSERT(strstr(report, "\"p99_ns\": ") != NULL && strstr(report, "\"max_ns\": ") != NULL,
+                "JSON report should give percentiles");
+    TEST_ASSERT(strstr(report, "{\"ns\": ") != NULL && strstr(report, "\"line\": \"sin(1)\"}"),
+                "JSON report should list the slowest lines");
+    set_precision(precision);
+    remove(path);
+
+    // A replayed replay command does not recurse
+    char nested[128];
+    snprintf(nested, sizeof(nested), "replay %s\n2+2\n", path);
+    TEST_ASSERT(replay_test_file(path, nested), "Replay file should be written");
+    TEST_ASSERT(replay_test_report(path, REPLAY_REPORT_TEXT, report, sizeof(report)),
+                "Replay should succeed");
+    TEST_ASSERT(strstr(report, "Replayed 2 lines") != NULL, "Nested replays should not run");
+    remove(path);
+
+    TEST_ASSERT(replay_run("/nonexistent/replay", stdout, REPLAY_REPORT_TEXT) != 0,
+                "A missing file should fail");
+    TEST_ASSERT(strstr(replay_get_error(), "Cannot open") != NULL, "The error should say why");
+
+    printf("  ✅ Replay report tests passed\n");
+    return 1;
+}
+
+int run_replay_tests(void)
+{
+    printf("Running Replay Test Suite\n");
+    printf("=========================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_replay_percentiles())
+        passed++;
+    total++;
+    if (test_replay_report())
+        passed++;
+
+    printf("\n=========================\n");
+    printf("Replay Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
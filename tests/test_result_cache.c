@@ -0,0 +1,268 @@
+#include "result_cache.h"
+#include "context.h"
+#include "evaluator.h"
+#include "optimizer.h"
+#include "precision.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+static const char *cache_corpus[] = {
+    "2*pi/3 + sqrt(2)",
+    "sin(pi/6)*2",
+    "exp(1) - e",
+    "atan2(exp(1), pow(2, sqrt(2)))",
+    "1e-30 + 1",
+    "log10(1000) + 2^-3",
+    "-(3^0.5)",
+};
+
+int test_result_cache_hits(void)
+{
+    printf("Testing result cache hits and misses...\n");
+
+    enum
+    {
+        CORPUS_SIZE = sizeof(cache_corpus) / sizeof(cache_corpus[0])
+    };
+    size_t count = CORPUS_SIZE;
+
+    // Reference values with the cache off
+    mpfr_t expected[CORPUS_SIZE];
+    result_cache_set_capacity(0);
+    for (size_t i = 0; i < count; i++)
+    {
+        ASTNode *ast = test_parse(cache_corpus[i]);
+        TEST_ASSERT(ast != NULL, "Corpus expression should parse");
+        mpfr_init2(expected[i], global_precision);
+        evaluator_eval(expected[i], ast);
+        ast_free(ast);
+    }
+
+    // The first pass fills the cache and the second is served from it;
+    // separately parsed trees with the same shape share an entry
+    result_cache_set_capacity(1 << 20);
+    result_cache_reset_stats();
+    int same = 1;
+    for (size_t pass = 0; pass < 2; pass++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            ASTNode *ast = test_parse(cache_corpus[i]);
+            mpfr_t cached;
+            mpfr_init2(cached, global_precision);
+            evaluator_eval(cached, ast);
+            if (!mpfr_equal_p(expected[i], cached) ||
+                mpfr_signbit(expected[i]) != mpfr_signbit(cached))
+            {
+                printf("    expression: %s\n", cache_corpus[i]);
+                same = 0;
+            }
+            mpfr_clear(cached);
+            ast_free(ast);
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        mpfr_clear(expected[i]);
+    }
+    TEST_ASSERT(same, "Cached results should be bit-identical");
+
+    ResultCacheStats stats;
+    result_cache_get_stats(&stats);
+    TEST_ASSERT(stats.hits == count, "Second evaluation of each expression should hit");
+    TEST_ASSERT(stats.misses == count, "First evaluation of each expression should miss");
+    TEST_ASSERT(stats.entries == count, "Each expression should have one entry");
+
+    // Different literals, constants or result precisions are different keys
+    ASTNode *a = test_parse("0.1 + pi");
+    ASTNode *b = test_parse("0.10000000000000000001 + pi");
+    ASTNode *c = test_parse("0.1 + e");
+    mpfr_t result, narrow;
+    mpfr_init2(result, global_precision);
+    mpfr_init2(narrow, 53);
+    result_cache_reset_stats();
+    evaluator_eval(result, a);
+    evaluator_eval(result, b);
+    evaluator_eval(result, c);
+    evaluator_eval(narrow, a);
+    result_cache_get_stats(&stats);
+    TEST_ASSERT(stats.hits == 0 && stats.misses == 4, "Distinct evaluations should not collide");
+    TEST_ASSERT(mpfr_get_prec(narrow) == 53, "A hit should not change the result precision");
+    mpfr_clears(result, narrow, (mpfr_ptr)0);
+    ast_free(a);
+    ast_free(b);
+    ast_free(c);
+
+    result_cache_set_capacity(0);
+    printf("  ✅ Result cache hit tests passed\n");
+    return 1;
+}
+
+int test_result_cache_errors(void)
+{
+    printf("Testing that errors are not cached...\n");
+
+    result_cache_set_capacity(1 << 20);
+    result_cache_reset_stats();
+
+    ASTNode *ast = test_parse("1 + 1/0");
+    TEST_ASSERT(ast != NULL, "Expression should parse");
+
+    mpfr_t result;
+    mpfr_init2(result, global_precision);
+    for (int i = 0; i < 2; i++)
+    {
+        evaluator_eval(result, ast);
+        TEST_ASSERT(evaluator_get_last_error() != NULL, "Every evaluation should report the error");
+    }
+
+    // Strict mode is part of the key
+    ASTNode *domain = test_parse("sqrt(-4)");
+    evaluator_eval(result, domain);
+    TEST_ASSERT(evaluator_get_last_error() == NULL, "Non-strict domain error is not an error");
+    evaluator_set_strict_mode(1);
+    evaluator_eval(result, domain);
+    int strict_error = evaluator_get_last_error() != NULL;
+    evaluator_set_strict_mode(0);
+    TEST_ASSERT(strict_error, "Strict mode should not be served a non-strict result");
+
+    ResultCacheStats stats;
+    result_cache_get_stats(&stats);
+    TEST_ASSERT(stats.hits == 0, "Failed evaluations should never hit");
+
+    mpfr_clear(result);
+    ast_free(ast);
+    ast_free(domain);
+    result_cache_set_capacity(0);
+    evaluator_clear_error();
+
+    printf("  ✅ Result cache error tests passed\n");
+    return 1;
+}
+
+int test_result_cache_limits(void)
+{
+    printf("Testing result cache memory cap and invalidation...\n");
+
+    // Room for only a few entries
+    result_cache_set_capacity(2048);
+    result_cache_reset_stats();
+
+    mpfr_t result;
+    mpfr_init2(result, global_precision);
+    char input[32];
+    for (int i = 0; i < 50; i++)
+    {
+        snprintf(input, sizeof(input), "sqrt(%d)", i + 2);
+        ASTNode *ast = test_parse(input);
+        TEST_ASSERT(ast != NULL, "Expression should parse");
+        evaluator_eval(result, ast);
+        ast_free(ast);
+    }
+
+    ResultCacheStats stats;
+    result_cache_get_stats(&stats);
+    TEST_ASSERT(stats.bytes <= stats.capacity, "Cache should stay under its cap");
+    TEST_ASSERT(stats.evictions > 0 && stats.entries > 0, "Old entries should be evicted");
+
+    // The most recent entry survives, the oldest does not
+    ASTNode *recent = test_parse("sqrt(51)");
+    ASTNode *old = test_parse("sqrt(2)");
+    result_cache_reset_stats();
+    evaluator_eval(result, recent);
+    evaluator_eval(result, old);
+    result_cache_get_stats(&stats);
+    TEST_ASSERT(stats.hits == 1 && stats.misses == 1, "Eviction should be least recently used first");
+
+    // Changing the precision drops everything
+    set_precision(global_precision + 64);
+    result_cache_get_stats(&stats);
+    TEST_ASSERT(stats.entries == 0 && stats.bytes == 0, "set_precision() should invalidate the cache");
+    set_precision(DEFAULT_PRECISION);
+
+    mpfr_clear(result);
+    ast_free(recent);
+    ast_free(old);
+    result_cache_set_capacity(0);
+    result_cache_get_stats(&stats);
+    TEST_ASSERT(!result_cache_enabled() && stats.entries == 0, "A zero cap should disable the cache");
+
+    printf("  ✅ Result cache limit tests passed\n");
+    return 1;
+}
+
+int test_result_cache_folds(void)
+{
+    printf("Testing result cache with folded trees...\n");
+
+    result_cache_set_capacity(1 << 20);
+
+    ASTNode *plain = test_parse("(2 + 3) * pi + 1");
+    ASTNode *folded = optimizer_fold_constants(test_parse("(2 + 3) * pi + 1"));
+    TEST_ASSERT(plain && folded, "Expressions should parse");
+
+    mpfr_t expected, result;
+    mpfr_init2(expected, global_precision);
+    mpfr_init2(result, global_precision);
+
+    // A stale fold must not be mistaken for its old value
+    set_precision(DEFAULT_PRECISION + 32);
+    mpfr_set_prec(expected, global_precision);
+    mpfr_set_prec(result, global_precision);
+    evaluator_eval(expected, plain);
+    evaluator_eval(result, folded);
+    int same = mpfr_equal_p(expected, result);
+    set_precision(DEFAULT_PRECISION);
+
+    mpfr_clears(expected, result, (mpfr_ptr)0);
+    ast_free(plain);
+    ast_free(folded);
+    result_cache_set_capacity(0);
+
+    TEST_ASSERT(same, "Stale folds should be keyed by their original subtree");
+
+    printf("  ✅ Result cache fold tests passed\n");
+    return 1;
+}
+
+int run_result_cache_tests(void)
+{
+    printf("Running Result Cache Test Suite\n");
+    printf("===============================\n\n");
+
+    precision_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_result_cache_hits())
+        passed++;
+    total++;
+    if (test_result_cache_errors())
+        passed++;
+    total++;
+    if (test_result_cache_limits())
+        passed++;
+    total++;
+    if (test_result_cache_folds())
+        passed++;
+
+    printf("\n===============================\n");
+    printf("Result Cache Tests: %d/%d passed\n", passed, total);
+
+    result_cache_cleanup();
+    return (passed == total) ? 0 : 1;
+}
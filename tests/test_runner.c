@@ -9,6 +9,29 @@ extern int run_evaluator_tests(void);
 extern int run_precision_tests(void);
 extern int run_integration_tests(void);
 extern int run_clear_cached_tests(void);
+extern int run_compiler_tests(void);
+extern int run_optimizer_tests(void);
+extern int run_batch_tests(void);
+extern int run_context_tests(void);
+extern int run_result_cache_tests(void);
+extern int run_native_tests(void);
+extern int run_variables_tests(void);
+extern int run_sweep_tests(void);
+extern int run_formatter_tests(void);
+extern int run_binary_tests(void);
+extern int run_profile_tests(void);
+extern int run_constants_table_tests(void);
+extern int run_huge_tests(void);
+extern int run_rational_tests(void);
+extern int run_symbolic_tests(void);
+extern int run_interval_tests(void);
+extern int run_server_tests(void);
+extern int run_analysis_tests(void);
+extern int run_replay_tests(void);
+extern int run_calc_tests(void);
+extern int run_reduce_tests(void);
+extern int run_plan_cache_tests(void);
+extern int run_preview_tests(void);
 
 typedef struct
 {
@@ -23,6 +46,29 @@ static TestSuite test_suites[] = {
     {"precision", run_precision_tests},
     {"integration", run_integration_tests},
     {"constants", run_clear_cached_tests},
+    {"compiler", run_compiler_tests},
+    {"optimizer", run_optimizer_tests},
+    {"batch", run_batch_tests},
+    {"context", run_context_tests},
+    {"cache", run_result_cache_tests},
+    {"native", run_native_tests},
+    {"variables", run_variables_tests},
+    {"sweep", run_sweep_tests},
+    {"formatter", run_formatter_tests},
+    {"binary", run_binary_tests},
+    {"profile", run_profile_tests},
+    {"table", run_constants_table_tests},
+    {"huge", run_huge_tests},
+    {"rational", run_rational_tests},
+    {"symbolic", run_symbolic_tests},
+    {"interval", run_interval_tests},
+    {"server", run_server_tests},
+    {"analysis", run_analysis_tests},
+    {"replay", run_replay_tests},
+    {"calc", run_calc_tests},
+    {"reduce", run_reduce_tests},
+    {"plans", run_plan_cache_tests},
+    {"preview", run_preview_tests},
     {NULL, NULL}};
 
 void print_usage(const char *program_name)
@@ -0,0 +1,236 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "server.h"
+#include "batch.h"
+#include "context.h"
+#include "formatter.h"
+#include "precision.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+#define SERVER_TEST_PATH "test_server.sock"
+
+typedef struct
+{
+    EvalContext settings;
+    int jobs;
+    int status;
+} ServerTest;
+
+static void *server_test_thread(void *arg)
+{
+    ServerTest *test = arg;
+    test->status = server_run(&test->settings, SERVER_TEST_PATH, test->jobs);
+    return NULL;
+}
+
+// Start a server in the background with the default settings
+static int server_test_start(ServerTest *test, pthread_t *thread, int jobs)
+{
+    remove(SERVER_TEST_PATH);
+    eval_context_init(&test->settings, get_precision());
+    test->settings.format = formatter_get_settings();
+    test->jobs = jobs;
+    test->status = -2;
+    return pthread_create(thread, NULL, server_test_thread, test) == 0;
+}
+
+static int server_test_stop(ServerTest *test, pthread_t thread)
+{
+    server_stop();
+    pthread_join(thread, NULL);
+    eval_context_cleanup(&test->settings);
+    return test->status;
+}
+
+// Connect to the test server, waiting for it to come up
+static int server_test_connect(void)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, SERVER_TEST_PATH);
+
+    for (int attempt = 0; attempt < 500; attempt++)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0)
+        {
+            return fd;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        struct timespec pause = {0, 10000000};
+        nanosleep(&pause, NULL);
+    }
+    return -1;
+}
+
+// Read until the given number of response lines has arrived
+static int server_test_read(int fd, char *output, size_t size, int lines)
+{
+    size_t length = 0;
+    int seen = 0;
+    while (seen < lines && length < size - 1)
+    {
+        ssize_t got = read(fd, output + length, size - 1 - length);
+        if (got <= 0)
+        {
+            break;
+        }
+        for (ssize_t i = 0; i < got; i++)
+        {
+            seen += output[length + i] == '\n';
+        }
+        length += (size_t)got;
+    }
+    output[length] = '\0';
+    return seen == lines;
+}
+
+int test_server_pipelining(void)
+{
+    printf("Testing pipelined server requests...\n");
+
+    ServerTest test;
+    pthread_t thread;
+    TEST_ASSERT(server_test_start(&test, &thread, 2), "Server thread should start");
+    int fd = server_test_connect();
+    TEST_ASSERT(fd >= 0, "The server should accept connections");
+
+    // Everything in one write; the answers still come back in order
+    const char *requests = "2+3*4\n"
+                           "@format=scientific 12345\n"
+                           "@precision=20 1/3\n"
+                           "\n"
+                           "1/0\n"
+                           "@colour=red 1\n"
+                           "2*(3\n"
+                           "@precision=256 @format=fixed 1/4\r\n"
+                           "sqrt(16)\n"
+                           "@precision=1 1/3\n"
+                           "@precision=99999999999 1/3\n";
+    TEST_ASSERT(write(fd, requests, strlen(requests)) == (ssize_t)strlen(requests),
+                "Requests should be sent");
+    char output[1024];
+    TEST_ASSERT(server_test_read(fd, output, sizeof(output), 11),
+                "Every request should be answered");
+
+    char lines[11][256];
+    char *position = output;
+    for (int i = 0; i < 11; i++)
+    {
+        char *end = strchr(position, '\n');
+        size_t length = (size_t)(end - position);
+        memcpy(lines[i], position, length);
+        lines[i][length] = '\0';
+        position = end + 1;
+    }
+    TEST_ASSERT(strcmp(lines[0], "14") == 0, "Plain requests should be evaluated");
+    TEST_ASSERT(strchr(lines[1], 'e') != NULL, "@format should apply to its request");
+    TEST_ASSERT(strncmp(lines[2], "0.333333", 8) == 0 && strlen(lines[2]) < 12,
+                "@precision should apply to its request");
+    TEST_ASSERT(lines[3][0] == '\0', "Empty requests should get empty responses");
+    TEST_ASSERT(strncmp(lines[4], "error: ", 7) == 0, "Evaluation errors should be reported");
+    TEST_ASSERT(strstr(lines[5], "Unknown option") != NULL, "Unknown options should be refused");
+    TEST_ASSERT(strncmp(lines[6], "error: ", 7) == 0, "Parse errors should be reported");
+    TEST_ASSERT(strncmp(lines[7], "0.2500000000", 12) == 0 && strlen(lines[7]) > 60,
+                "Several options and CRLF should be accepted");
+    TEST_ASSERT(strcmp(lines[8], "4") == 0, "Options should not outlive their request");
+    TEST_ASSERT(strstr(lines[9], "error: Precision must be between") == lines[9] &&
+                    strstr(lines[10], "error: Precision must be between") == lines[10],
+                "Out-of-range precisions should be refused, not clamped");
+
+    // A second client is served while the first is still connected
+    int second = server_test_connect();
+    TEST_ASSERT(second >= 0, "A second client should connect");
+    TEST_ASSERT(write(second, "7*6\n", 4) == 4, "Request should be sent");
+    TEST_ASSERT(server_test_read(second, output, sizeof(output), 1) && strcmp(output, "42\n") == 0,
+                "Clients should be served concurrently");
+    close(second);
+    close(fd);
+
+    TEST_ASSERT(server_test_stop(&test, thread) == 0, "The server should stop cleanly");
+    struct stat info;
+    TEST_ASSERT(stat(SERVER_TEST_PATH, &info) != 0, "The socket should be removed");
+
+    printf("  ✅ Pipelined server request tests passed\n");
+    return 1;
+}
+
+int test_server_errors(void)
+{
+    printf("Testing server setup errors...\n");
+
+    EvalContext settings;
+    eval_context_init(&settings, get_precision());
+    TEST_ASSERT(server_run(&settings, SERVER_TEST_PATH, 0) != 0, "Zero workers should be refused");
+    TEST_ASSERT(server_get_error() != NULL, "Failures should say why");
+    TEST_ASSERT(server_run(&settings, "no_such_dir/test.sock", 1) != 0,
+                "Unusable paths should fail");
+    TEST_ASSERT(strstr(server_get_error(), "no_such_dir/test.sock") != NULL,
+                "The error should name the address");
+    eval_context_cleanup(&settings);
+
+    // Stopping with a client connected shuts its connection down
+    ServerTest test;
+    pthread_t thread;
+    TEST_ASSERT(server_test_start(&test, &thread, 1), "Server thread should start");
+    int fd = server_test_connect();
+    TEST_ASSERT(fd >= 0, "The server should accept connections");
+    char output[64];
+    TEST_ASSERT(write(fd, "1+1\n", 4) == 4 && server_test_read(fd, output, sizeof(output), 1),
+                "Request should be answered");
+    TEST_ASSERT(server_test_stop(&test, thread) == 0, "Open connections should not block stop");
+    TEST_ASSERT(read(fd, output, sizeof(output)) <= 0, "The connection should be closed");
+    close(fd);
+
+    printf("  ✅ Server setup error tests passed\n");
+    return 1;
+}
+
+int run_server_tests(void)
+{
+    printf("Running Server Test Suite\n");
+    printf("=========================\n\n");
+
+    batch_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_server_pipelining())
+        passed++;
+    total++;
+    if (test_server_errors())
+        passed++;
+
+    remove(SERVER_TEST_PATH);
+    batch_cleanup();
+
+    printf("\n=========================\n");
+    printf("Server Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
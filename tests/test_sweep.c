@@ -0,0 +1,245 @@
+#include "sweep.h"
+#include "variables.h"
+#include "context.h"
+#include "evaluator.h"
+#include "precision.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Count the points of "from to to step step"; returns 0 on error
+static unsigned long sweep_test_count(const char *from, const char *to, const char *step)
+{
+    mpfr_t bounds[3];
+    const char *text[3] = {from, to, step};
+    for (int i = 0; i < 3; i++)
+    {
+        mpfr_init2(bounds[i], 256);
+        mpfr_set_str(bounds[i], text[i], 10, MPFR_RNDN);
+    }
+
+    unsigned long count = 0;
+    if (!sweep_count(bounds[0], bounds[1], bounds[2], &count))
+    {
+        count = 0;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        mpfr_clear(bounds[i]);
+    }
+    return count;
+}
+
+// Sweep an expression over from, from + step, ... and return the rows
+// (heap string, NULL on failure)
+static char *sweep_test_run(EvalContext *settings, const char *body, const char *from,
+                            const char *step, unsigned long count, const VariableTable *variables,
+                            int jobs, SweepStats *stats)
+{
+    ASTNode *ast = test_parse(body);
+    FILE *out = tmpfile();
+    if (!ast || !out)
+    {
+        ast_free(ast);
+        if (out)
+            fclose(out);
+        return NULL;
+    }
+
+    mpfr_t start, distance;
+    mpfr_init2(start, settings->precision + BINOP_PRECISION_BOOST);
+    mpfr_init2(distance, settings->precision + BINOP_PRECISION_BOOST);
+    mpfr_set_str(start, from, 10, MPFR_RNDN);
+    mpfr_set_str(distance, step, 10, MPFR_RNDN);
+
+    SweepSpec spec = {ast, "x", start, distance, count, variables, jobs};
+    char *text = NULL;
+    if (sweep_run(settings, &spec, out, stats))
+    {
+        long length = ftell(out);
+        text = length >= 0 ? malloc((size_t)length + 1) : NULL;
+        rewind(out);
+        if (text)
+        {
+            text[fread(text, 1, (size_t)length, out)] = '\0';
+        }
+    }
+
+    mpfr_clear(start);
+    mpfr_clear(distance);
+    fclose(out);
+    ast_free(ast);
+    return text;
+}
+
+static unsigned long sweep_test_lines(const char *text)
+{
+    unsigned long lines = 0;
+    for (; *text; text++)
+    {
+        lines += *text == '\n';
+    }
+    return lines;
+}
+
+int test_sweep_count(void)
+{
+    printf("Testing sweep point counts...\n");
+
+    TEST_ASSERT(sweep_test_count("0", "1", "0.1") == 11, "The end should count despite rounding");
+    TEST_ASSERT(sweep_test_count("0", "10", "0.001") == 10001, "Small steps should reach the end");
+    TEST_ASSERT(sweep_test_count("0", "1", "0.3") == 4, "Steps past the end should stop short");
+    TEST_ASSERT(sweep_test_count("1", "0", "-0.25") == 5, "Negative steps should count down");
+    TEST_ASSERT(sweep_test_count("2", "2", "1") == 1, "Equal bounds should give one point");
+
+    TEST_ASSERT(sweep_test_count("1", "0", "0.25") == 0, "Steps leading away should fail");
+    TEST_ASSERT(sweep_get_error() && strstr(sweep_get_error(), "away"),
+                "Direction errors should be reported");
+    TEST_ASSERT(sweep_test_count("0", "1", "0") == 0, "Zero steps should fail");
+    TEST_ASSERT(sweep_test_count("0", "1", "1e-9") == 0, "Oversized sweeps should fail");
+    TEST_ASSERT(sweep_test_count("0", "inf", "1") == 0, "Infinite bounds should fail");
+
+    printf("  ✅ Sweep count tests passed\n");
+    return 1;
+}
+
+int test_sweep_rows(void)
+{
+    printf("Testing sweep rows...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    ctx.native = 0;
+
+    SweepStats stats;
+    char *rows = sweep_test_run(&ctx, "1/x", "-1", "0.5", 5, NULL, 1, &stats);
+    TEST_ASSERT(rows, "Sweep should run");
+    TEST_ASSERT(strcmp(rows, "-1\t-1\n-0.5\t-2\n0\terror: Division by zero\n0.5\t2\n1\t1\n") == 0,
+                "One row per point, errors in place of values");
+    TEST_ASSERT(stats.points == 5 && stats.errors == 1 && stats.native_points == 0,
+                "Stats should count points and errors");
+    free(rows);
+
+    // Threads split the range but rows keep their order
+    char *serial = sweep_test_run(&ctx, "sin(x)*exp(-x)", "0", "0.01", 2000, NULL, 1, NULL);
+    char *threaded = sweep_test_run(&ctx, "sin(x)*exp(-x)", "0", "0.01", 2000, NULL, 4, &stats);
+    TEST_ASSERT(serial && threaded, "Sweeps should run");
+    TEST_ASSERT(sweep_test_lines(serial) == 2000, "Every point should have a row");
+    TEST_ASSERT(strcmp(serial, threaded) == 0, "Threaded rows should match serial ones");
+    TEST_ASSERT(stats.points == 2000, "Threaded stats should add up");
+    free(serial);
+    free(threaded);
+
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Sweep row tests passed\n");
+    return 1;
+}
+
+int test_sweep_native(void)
+{
+    printf("Testing sweep hardware batches...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 30);
+    ctx.native = 1;
+
+    SweepStats stats;
+    char *fast = sweep_test_run(&ctx, "sin(x)*exp(-x) + x^2/3", "0", "0.001", 1000, NULL, 2, &stats);
+    TEST_ASSERT(fast, "Sweep should run");
+    TEST_ASSERT(stats.native_points > 900, "Most points should take the hardware path");
+
+    ctx.native = 0;
+    char *exact = sweep_test_run(&ctx, "sin(x)*exp(-x) + x^2/3", "0", "0.001", 1000, NULL, 2, &stats);
+    TEST_ASSERT(exact && stats.native_points == 0, "Disabling native should use MPFR only");
+    TEST_ASSERT(strcmp(fast, exact) == 0, "Hardware batches should round like MPFR");
+    free(fast);
+    free(exact);
+
+    // Above the batch path's precision every point goes through MPFR
+    eval_context_set_precision(&ctx, 128);
+    ctx.native = 1;
+    char *rows = sweep_test_run(&ctx, "x*3", "0", "1", 10, NULL, 1, &stats);
+    TEST_ASSERT(rows && stats.native_points == 0, "High precisions should skip the batch path");
+    free(rows);
+
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Sweep hardware batch tests passed\n");
+    return 1;
+}
+
+int test_sweep_variables(void)
+{
+    printf("Testing sweeps over variables...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 64);
+    VariableTable *table = variables_create();
+    TEST_ASSERT(table, "Table should be created");
+    ctx.variables = table;
+
+    // Definitions reading the swept name follow it
+    ASTNode *k = test_parse("10");
+    ASTNode *y = test_parse("x*2 + k");
+    TEST_ASSERT(k && y, "Definitions should parse");
+    TEST_ASSERT(variables_define(table, "k", k) >= 0, "k should be defined");
+    TEST_ASSERT(variables_define(table, "y", y) >= 0, "y should be defined");
+
+    for (int jobs = 1; jobs <= 3; jobs += 2)
+    {
+        char *rows = sweep_test_run(&ctx, "y - k", "1", "1", 600, table, jobs, NULL);
+        TEST_ASSERT(rows, "Sweep should run");
+        TEST_ASSERT(strncmp(rows, "1\t2\n2\t4\n3\t6\n", 12) == 0, "Rows should read y");
+        TEST_ASSERT(strstr(rows, "\n600\t1200\n"), "Late batches should read y too");
+        free(rows);
+    }
+
+    Variable *x = variables_find(table, "x");
+    TEST_ASSERT(x && !x->definition, "Sweeps should not define the name in the caller's table");
+
+    variables_destroy(table);
+    eval_context_cleanup(&ctx);
+    printf("  ✅ Sweep variable tests passed\n");
+    return 1;
+}
+
+int run_sweep_tests(void)
+{
+    printf("Running Sweep Test Suite\n");
+    printf("========================\n\n");
+
+    precision_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_sweep_count())
+        passed++;
+    total++;
+    if (test_sweep_rows())
+        passed++;
+    total++;
+    if (test_sweep_native())
+        passed++;
+    total++;
+    if (test_sweep_variables())
+        passed++;
+
+    printf("\n========================\n");
+    printf("Sweep Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
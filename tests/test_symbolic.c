@@ -0,0 +1,336 @@
+#include "symbolic.h"
+#include "simplify_rules.h"
+#include "printer.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+// Simplify an expression and compare it with what the rules should make of it
+static int symbolic_test_simplifies_to(const char *input, const char *expected_input)
+{
+    ASTNode *ast = test_parse(input);
+    ASTNode *expected = test_parse(expected_input);
+    ASTNode *result = ast ? symbolic_eval(ast) : NULL;
+
+    // The expected form is already simple, so simplify it too: the parser
+    // may have folded its literals
+    ASTNode *expected_simple = expected ? symbolic_eval(expected) : NULL;
+    int same = result && expected_simple && symbolic_equals(result, expected_simple);
+    if (!same)
+    {
+        printf("  simplify(%s) gave ", input);
+        if (result)
+        {
+            printer_print_ast_infix(result);
+        }
+        printf(", expected %s\n", expected_input);
+    }
+
+    ast_free(expected_simple);
+    ast_free(result);
+    ast_free(expected);
+    ast_free(ast);
+    return same;
+}
+
+static int test_symbolic_arithmetic(void)
+{
+    printf("Testing arithmetic rules...\n");
+
+    static const char *cases[][2] = {
+        {"x + 0", "x"},           {"0 + x", "x"},         {"x - 0", "x"},
+        {"x - x", "0"},           {"x + x", "2*x"},       {"x/2 + x/3", "5/6*x"},
+        {"x * 1", "x"},           {"0 * x", "0"},         {"x * x * x", "x^3"},
+        {"(x^2)^3", "x^6"},       {"x^1", "x"},           {"x^0", "1"},
+        {"x / 1", "x"},           {"x / x", "1"},         {"-(-x)", "x"},
+        {"x + (-3)", "x - 3"},    {"x - 2 - 3", "x - 5"}, {"1/3 + 1/6", "1/2"},
+        {"2^100 - 1", "1267650600228229401496703205375"}, {"y - (-2)*x", "y + 2*x"},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        TEST_ASSERT(symbolic_test_simplifies_to(cases[i][0], cases[i][1]),
+                    "Arithmetic identity should apply");
+    }
+
+    printf("  ✅ Arithmetic rule tests passed\n");
+    return 1;
+}
+
+static int test_symbolic_functions(void)
+{
+    printf("Testing trigonometric and radical rules...\n");
+
+    static const char *cases[][2] = {
+        {"sin(0)", "0"},
+        {"sin(pi)", "0"},
+        {"cos(pi/3)", "1/2"},
+        {"tan(pi/3)", "sqrt(3)"},
+        {"sin(5*pi/6) + cos(3*pi/4)", "1/2 - 1/2*sqrt(2)"},
+        {"sqrt(8)", "2*sqrt(2)"},
+        {"sqrt(x^2)", "abs(x)"},
+        {"abs(abs(x))", "abs(x)"},
+        {"log(exp(y*1))", "y"},
+        {"exp(0)", "1"},
+        {"log10(1000)", "3"},
+        {"(sqrt(2) + 5)/sqrt(2)", "1 + 5/2*sqrt(2)"},
+        {"sin(0) + sin(pi) + 2*sin(sqrt(2))/2", "sin(sqrt(2))"},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        TEST_ASSERT(symbolic_test_simplifies_to(cases[i][0], cases[i][1]),
+                    "Function identity should apply");
+    }
+
+    printf("  ✅ Function rule tests passed\n");
+    return 1;
+}
+
+static int test_symbolic_undefined(void)
+{
+    printf("Testing expressions left alone...\n");
+
+    // Nothing is known about these, so they come back as they were
+    static const char *kept[] = {"1/0", "x/0", "sin(x)", "log(0)", "x + y", "1.5 * x"};
+
+    for (size_t i = 0; i < sizeof(kept) / sizeof(kept[0]); i++)
+    {
+        TEST_ASSERT(symbolic_test_simplifies_to(kept[i], kept[i]),
+                    "Expression without a rule should stay as it is");
+    }
+
+    printf("  ✅ Unchanged expression tests passed\n");
+    return 1;
+}
+
+static int test_symbolic_memo(void)
+{
+    printf("Testing shared subexpressions...\n");
+
+    // The same subtree four times is simplified once
+    ASTNode *ast = test_parse("sin(x + 0)*2 + sin(x + 0)*2 + sin(x + 0)*2 + sin(x + 0)*2");
+    TEST_ASSERT(ast != NULL, "Expression should parse");
+
+    SymbolicStats stats;
+    ASTNode *result = symbolic_simplify(ast, SYMBOLIC_DEFAULT_MAX_STEPS, &stats);
+    TEST_ASSERT(result != NULL, "Simplification should succeed");
+    TEST_ASSERT(stats.memo_hits >= 3, "Repeated subtrees should be found in the table");
+    TEST_ASSERT(!stats.truncated, "Small expression should not hit the step cap");
+
+    ASTNode *expected = test_parse("8*sin(x)");
+    ASTNode *expected_simple = symbolic_eval(expected);
+    TEST_ASSERT(symbolic_equals(result, expected_simple), "Repeated terms should be collected");
+    ast_free(expected_simple);
+    ast_free(expected);
+    ast_free(result);
+    ast_free(ast);
+
+    // Equal parts of a result are one node
+    ast = test_parse("sin(x) + cos(x) * sin(x)");
+    result = symbolic_eval(ast);
+    TEST_ASSERT(result && result->type == NODE_BINOP, "Sum should stay a sum");
+    const ASTNode *product = result->binop.right;
+    TEST_ASSERT(product->type == NODE_BINOP, "Product should stay a product");
+    TEST_ASSERT(result->binop.left == product->binop.left ||
+                    result->binop.left == product->binop.right,
+                "Equal subtrees should be shared");
+    ast_free(result);
+    ast_free(ast);
+
+    printf("  ✅ Shared subexpression tests passed\n");
+    return 1;
+}
+
+static int test_symbolic_limits(void)
+{
+    printf("Testing the step cap...\n");
+
+    ASTNode *ast = test_parse("a*1 + b*1 + c*1 + d*1 + g^1 + h^1");
+    TEST_ASSERT(ast != NULL, "Expression should parse");
+
+    SymbolicStats stats;
+    ASTNode *result = symbolic_simplify(ast, 2, &stats);
+    TEST_ASSERT(result != NULL, "Capped simplification should still return a tree");
+    TEST_ASSERT(stats.truncated, "Cap should be reported");
+    TEST_ASSERT(stats.steps == 2, "No more rewrites than the cap should be made");
+    TEST_ASSERT(!symbolic_equals(result, ast) && result->type == NODE_BINOP,
+                "Capped result should be partly simplified");
+    ast_free(result);
+
+    result = symbolic_simplify(ast, SYMBOLIC_DEFAULT_MAX_STEPS, &stats);
+    TEST_ASSERT(result != NULL && !stats.truncated, "Uncapped run should finish");
+    TEST_ASSERT(stats.steps == 6, "Every factor of one and power of one should go");
+    ast_free(result);
+    ast_free(ast);
+
+    printf("  ✅ Step cap tests passed\n");
+    return 1;
+}
+
+static int test_symbolic_index(void)
+{
+    printf("Testing the rule index...\n");
+
+    int count;
+    ASTNode *ast = test_parse("x * y");
+    TEST_ASSERT(ast != NULL, "Expression should parse");
+    const SimplifyRule *rules = simplify_rules_for(ast, &count);
+    TEST_ASSERT(rules && count > 0, "Products should have rules");
+    TEST_ASSERT(count < simplify_rules_count() / 2, "Only the product rules should be offered");
+    ast_free(ast);
+
+    ast = test_parse("y");
+    rules = simplify_rules_for(ast, &count);
+    TEST_ASSERT(count == 0 && !rules, "Variables should have no rules");
+    ast_free(ast);
+
+    // Each node only sees its own rules
+    ast = test_parse("sin(x) + cos(y)");
+    SymbolicStats stats;
+    ASTNode *result = symbolic_simplify(ast, SYMBOLIC_DEFAULT_MAX_STEPS, &stats);
+    TEST_ASSERT(result && stats.steps == 0, "Nothing should be rewritten");
+    TEST_ASSERT(stats.rules_tried < (unsigned long)simplify_rules_count(),
+                "Fewer rules than the table holds should be tried");
+    ast_free(result);
+    ast_free(ast);
+
+    printf("  ✅ Rule index tests passed\n");
+    return 1;
+}
+
+// Write an expression in input syntax, parse the text and compare the trees,
+// simplifying both first if simplify is set
+static int symbolic_test_prints_back(const char *input, int simplify, const char *expected_text)
+{
+    ASTNode *ast = test_parse(input);
+    ASTNode *tree = ast && simplify ? symbolic_eval(ast) : ast;
+    FormatBuffer text;
+    format_buffer_init(&text);
+    int written = tree && printer_format_expression(&text, tree);
+
+    ASTNode *reparsed = written ? test_parse(text.data) : NULL;
+    ASTNode *back = reparsed && simplify ? symbolic_eval(reparsed) : reparsed;
+    int same = back && symbolic_equals(tree, back);
+    for (size_t i = 0; same && i < text.length; i++)
+    {
+        // Nothing outside ASCII, such as × or π, which the lexer would refuse
+        same = (unsigned char)text.data[i] < 0x80;
+    }
+    if (same && expected_text)
+    {
+        same = strcmp(text.data, expected_text) == 0;
+    }
+    if (!same)
+    {
+        printf("  %s printed as %s\n", input, written ? text.data : "(nothing)");
+    }
+
+    format_buffer_free(&text);
+    if (back != reparsed)
+    {
+        ast_free(back);
+    }
+    ast_free(reparsed);
+    if (tree != ast)
+    {
+        ast_free(tree);
+    }
+    ast_free(ast);
+    return same;
+}
+
+static int test_symbolic_printer(void)
+{
+    printf("Testing the input syntax printer...\n");
+
+    // Parenthesized where associativity or a sign would regroup the operands
+    static const char *cases[][2] = {
+        {"(2^x)^y", "(2^x)^y"},
+        {"2^x^y", "2^x^y"},
+        {"(x^2)^0.5", "(x^2)^0.5"},
+        {"(-x)^2", "(-x)^2"},
+        {"-(x^2)", "-(x^2)"},
+        {"2^(-x)", "2^(-x)"},
+        {"a - (b - c)", "a - (b - c)"},
+        {"(a - b) - c", "a - b - c"},
+        {"a/(b*c)", "a/(b*c)"},
+        {"a - (-b)", "a - (-b)"},
+        {"-(-x)", "-(-x)"},
+        {"pi*x", "pi*x"},
+        {"x <= y", "x <= y"},
+        {"x != y", "x != y"},
+        {"sin(x)^2 + atan2(y, x)", "sin(x)^2 + atan2(y, x)"},
+        {"0.1*x", "0.1*x"},
+        {"1.5e-30*x", "1.5e-30*x"},
+        {"3.14159265358979323846264338327950288*x", "3.14159265358979323846264338327950288*x"},
+        {"123456789012345678901234567890", "123456789012345678901234567890"},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        TEST_ASSERT(symbolic_test_prints_back(cases[i][0], 0, cases[i][1]),
+                    "Printed expressions should parse back to the same tree");
+    }
+
+    // Simplified results, n-ary sums and products included
+    static const char *simplified[] = {
+        "(x^2)^0.5",   "(2^x)^y",       "(-x)^2",      "x/2 + x/3",       "y - (-2)*x",
+        "x - 2 - 3",   "0.1*x + 0.2*x", "-(x^2) + 1",  "x*y*(a + b)",     "1 - x*sin(x)^3",
+        "x^(-1) * y",  "2^100 - 1",     "e^(x + 1)",   "-(-x)*pi - 0.25", "(a + b)^(c - d)",
+    };
+    for (size_t i = 0; i < sizeof(simplified) / sizeof(simplified[0]); i++)
+    {
+        TEST_ASSERT(symbolic_test_prints_back(simplified[i], 1, NULL),
+                    "Printed simplifications should parse back to the same tree");
+    }
+
+    printf("  ✅ Input syntax printer tests passed\n");
+    return 1;
+}
+
+int run_symbolic_tests(void)
+{
+    printf("Running Symbolic Simplification Test Suite\n");
+    printf("==========================================\n\n");
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_symbolic_arithmetic())
+        passed++;
+    total++;
+    if (test_symbolic_functions())
+        passed++;
+    total++;
+    if (test_symbolic_undefined())
+        passed++;
+    total++;
+    if (test_symbolic_memo())
+        passed++;
+    total++;
+    if (test_symbolic_limits())
+        passed++;
+    total++;
+    if (test_symbolic_index())
+        passed++;
+    total++;
+    if (test_symbolic_printer())
+        passed++;
+
+    printf("\n==========================================\n");
+    printf("Symbolic Simplification Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,385 @@
+#include "variables.h"
+#include "context.h"
+#include "evaluator.h"
+#include "parser.h"
+#include "lexer.h"
+#include "precision.h"
+#include "test_parse.h"
+#include <stdio.h>
+#include <string.h>
+#include <mpfr.h>
+
+#define TEST_ASSERT(condition, message)         \
+    do                                          \
+    {                                           \
+        if (!(condition))                       \
+        {                                       \
+            printf("  ❌ FAIL: %s\n", message); \
+            return 0;                           \
+        }                                       \
+    } while (0)
+
+static int variables_test_define(VariableTable *table, const char *name, const char *input)
+{
+    ASTNode *definition = test_parse(input);
+    return definition ? variables_define(table, name, definition) : -1;
+}
+
+// Evaluate an expression in a context; returns 0 if it failed to parse
+static int variables_test_eval(EvalContext *ctx, mpfr_t result, const char *input)
+{
+    ASTNode *ast = test_parse(input);
+    if (!ast)
+    {
+        return 0;
+    }
+    evaluator_eval_ctx(ctx, result, ast);
+    ast_free(ast);
+    return 1;
+}
+
+static int variables_test_value_is(EvalContext *ctx, const char *input, double expected)
+{
+    mpfr_t result;
+    mpfr_init2(result, ctx->precision);
+    int ok = variables_test_eval(ctx, result, input) && !eval_context_get_error(ctx) &&
+             mpfr_cmp_d(result, expected) == 0;
+    mpfr_clear(result);
+    return ok;
+}
+
+static unsigned long variables_test_evaluations(VariableTable *table, const char *name)
+{
+    Variable *var = variables_find(table, name);
+    return var ? var->evaluations : 0;
+}
+
+int test_variables_definitions(void)
+{
+    printf("Testing variable definitions...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    VariableTable *table = variables_create();
+    TEST_ASSERT(table, "Table should be created");
+    ctx.variables = table;
+
+    // Names may be used before they are defined
+    TEST_ASSERT(variables_test_define(table, "x", "1.5") >= 0, "x should be defined");
+    TEST_ASSERT(variables_test_define(table, "y", "x*2 + z") >= 0, "y should be defined");
+    Variable *z = variables_find(table, "z");
+    TEST_ASSERT(z && !z->definition, "Referenced names should get an undefined entry");
+
+    TEST_ASSERT(variables_test_value_is(&ctx, "x", 1.5), "x should read back");
+    mpfr_t result;
+    mpfr_init2(result, 128);
+    TEST_ASSERT(variables_test_eval(&ctx, result, "y"), "y should parse");
+    TEST_ASSERT(eval_context_get_error(&ctx) &&
+                    strcmp(eval_context_get_error(&ctx), "Undefined variable: z") == 0,
+                "Reading through an undefined name should fail");
+
+    TEST_ASSERT(variables_test_define(table, "z", "1") >= 0, "z should be defined");
+    TEST_ASSERT(variables_test_value_is(&ctx, "y", 4), "y should see z once defined");
+    TEST_ASSERT(variables_test_value_is(&ctx, "2x + y", 7), "Variables multiply implicitly");
+    TEST_ASSERT(variables_test_value_is(&ctx, "sin(x)^2 + cos(x)^2 - 1 + y", 4),
+                "Variables should work inside function arguments");
+
+    // Errors inside a definition reach the expression reading it
+    TEST_ASSERT(variables_test_define(table, "w", "1/0") >= 0, "w should be defined");
+    variables_test_eval(&ctx, result, "w + 1");
+    TEST_ASSERT(eval_context_get_error(&ctx) &&
+                    strcmp(eval_context_get_error(&ctx), "Division by zero") == 0,
+                "Definition errors should propagate");
+    TEST_ASSERT(variables_test_evaluations(table, "w") == 0, "Failed values should not be kept");
+    variables_test_eval(&ctx, result, "1/0 + x");
+    TEST_ASSERT(eval_context_get_error(&ctx), "Earlier errors should not be cleared");
+
+    // Without a table every name is undefined
+    ctx.variables = NULL;
+    variables_test_eval(&ctx, result, "x");
+    TEST_ASSERT(eval_context_get_error(&ctx), "Contexts without variables should fail");
+    mpfr_clear(result);
+
+    variables_destroy(table);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Variable definition tests passed\n");
+    return 1;
+}
+
+int test_variables_incremental(void)
+{
+    printf("Testing incremental recomputation...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    VariableTable *table = variables_create();
+    TEST_ASSERT(table, "Table should be created");
+    ctx.variables = table;
+
+    // a <- b <- c and an unrelated d <- f
+    variables_test_define(table, "a", "1");
+    variables_test_define(table, "b", "a + 1");
+    variables_test_define(table, "c", "b * b + a");
+    variables_test_define(table, "d", "3");
+    variables_test_define(table, "f", "d * 2");
+
+    TEST_ASSERT(variables_test_value_is(&ctx, "c + f", 11), "Chain should evaluate");
+    TEST_ASSERT(variables_test_value_is(&ctx, "c + f", 11), "Chain should evaluate again");
+    TEST_ASSERT(variables_test_evaluations(table, "a") == 1 &&
+                    variables_test_evaluations(table, "b") == 1 &&
+                    variables_test_evaluations(table, "c") == 1 &&
+                    variables_test_evaluations(table, "f") == 1,
+                "Current values should be reused");
+
+    // Changing a dirties b and c only
+    variables_test_define(table, "a", "2");
+    TEST_ASSERT(!variables_find(table, "c")->current, "Transitive dependents should be dirty");
+    TEST_ASSERT(variables_find(table, "f")->current, "Unrelated values should stay current");
+    TEST_ASSERT(variables_test_value_is(&ctx, "c + f", 17), "Dependents should see the change");
+    TEST_ASSERT(variables_test_evaluations(table, "b") == 2 &&
+                    variables_test_evaluations(table, "c") == 2 &&
+                    variables_test_evaluations(table, "d") == 1 &&
+                    variables_test_evaluations(table, "f") == 1,
+                "Only dependents should be recomputed");
+
+    // Recomputation is lazy
+    variables_test_define(table, "d", "4");
+    TEST_ASSERT(variables_test_evaluations(table, "f") == 1, "Defining should not evaluate");
+    TEST_ASSERT(variables_test_value_is(&ctx, "f", 8), "Reading should evaluate");
+
+    // Redefinitions move the dependency edges
+    variables_test_define(table, "b", "d");
+    TEST_ASSERT(variables_test_value_is(&ctx, "c", 18), "c should follow b's new definition");
+    unsigned long c_evaluations = variables_test_evaluations(table, "c");
+    variables_test_define(table, "a", "3");
+    TEST_ASSERT(variables_test_value_is(&ctx, "b", 4), "b should no longer read a");
+    TEST_ASSERT(variables_test_evaluations(table, "b") == 3, "b should not be dirtied by a");
+    TEST_ASSERT(variables_test_value_is(&ctx, "c", 19), "c still reads a");
+    TEST_ASSERT(variables_test_evaluations(table, "c") == c_evaluations + 1,
+                "c should be recomputed once");
+
+    // Values computed at another precision are not reused
+    eval_context_set_precision(&ctx, 256);
+    TEST_ASSERT(variables_test_value_is(&ctx, "c", 19), "c should evaluate at a new precision");
+    TEST_ASSERT(variables_test_evaluations(table, "c") == c_evaluations + 2,
+                "A new precision should recompute");
+    TEST_ASSERT(mpfr_get_prec(variables_find(table, "c")->value) > 256,
+                "Values should keep the working precision");
+
+    // The adaptive mode evaluates definitions in place
+    ctx.adaptive = 1;
+    ctx.native = 0;
+    variables_test_define(table, "t", "sin(a)^2 + d/7");
+    mpfr_t result, expected, quotient;
+    mpfr_init2(result, 256);
+    mpfr_inits2(1024, expected, quotient, (mpfr_ptr)0);
+    TEST_ASSERT(variables_test_eval(&ctx, result, "t - 1"), "t should parse");
+    TEST_ASSERT(!eval_context_get_error(&ctx), "Adaptive reads should succeed");
+    mpfr_set_ui(expected, 3, MPFR_RNDN);
+    mpfr_sin(expected, expected, MPFR_RNDN);
+    mpfr_sqr(expected, expected, MPFR_RNDN);
+    mpfr_set_ui(quotient, 4, MPFR_RNDN);
+    mpfr_div_ui(quotient, quotient, 7, MPFR_RNDN);
+    mpfr_add(expected, expected, quotient, MPFR_RNDN);
+    mpfr_sub_ui(expected, expected, 1, MPFR_RNDN);
+    mpfr_prec_round(expected, 256, MPFR_RNDN);
+    TEST_ASSERT(mpfr_equal_p(result, expected), "Adaptive reads should be correctly rounded");
+    mpfr_clears(result, expected, quotient, (mpfr_ptr)0);
+
+    variables_destroy(table);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Incremental recomputation tests passed\n");
+    return 1;
+}
+
+int test_variables_cycles(void)
+{
+    printf("Testing circular definitions...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 128);
+    VariableTable *table = variables_create();
+    TEST_ASSERT(table, "Table should be created");
+    ctx.variables = table;
+
+    TEST_ASSERT(variables_test_define(table, "x", "x + 1") < 0, "Self references are circular");
+    TEST_ASSERT(variables_get_error(table) &&
+                    strcmp(variables_get_error(table), "Circular definition of x") == 0,
+                "Cycles should be reported");
+
+    variables_test_define(table, "x", "2");
+    variables_test_define(table, "y", "x * 3");
+    variables_test_define(table, "z", "y + 1");
+    TEST_ASSERT(variables_test_define(table, "x", "z - 1") < 0, "Longer cycles are circular");
+    TEST_ASSERT(variables_test_value_is(&ctx, "z", 7), "Rejected definitions keep the old one");
+    TEST_ASSERT(variables_test_define(table, "x", "5") >= 0, "Redefining should still work");
+    TEST_ASSERT(!variables_get_error(table), "Successful definitions clear the error");
+    TEST_ASSERT(variables_test_value_is(&ctx, "z", 16), "Old edges should still be in place");
+
+    // Diamonds are not cycles
+    TEST_ASSERT(variables_test_define(table, "w", "y + z + x") >= 0, "Diamonds are allowed");
+    TEST_ASSERT(variables_test_value_is(&ctx, "w", 36), "Diamonds should evaluate");
+
+    variables_destroy(table);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Circular definition tests passed\n");
+    return 1;
+}
+
+// Define a variable the way the REPL does, keeping its text at a precision
+static int variables_test_define_source(VariableTable *table, const char *name,
+                                        const char *input, mpfr_prec_t precision)
+{
+    Lexer lexer;
+    lexer_init(&lexer, input);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    parser_set_quiet(&parser, 1);
+    parser_set_precision(&parser, precision);
+    ASTNode *definition = parser_parse_expression(&parser);
+    int index = definition ? variables_define(table, name, definition) : -1;
+    if (index >= 0 && parser.inexact_literals)
+    {
+        variables_set_source(table, index, input, precision);
+    }
+    return index;
+}
+
+// Check a value against a decimal string read at the context's precision
+static int variables_test_value_is_str(EvalContext *ctx, const char *input, const char *expected)
+{
+    mpfr_t result, value;
+    mpfr_init2(result, ctx->precision);
+    mpfr_init2(value, ctx->precision);
+    mpfr_set_str(value, expected, 10, MPFR_RNDN);
+    int ok = variables_test_eval(ctx, result, input) && !eval_context_get_error(ctx) &&
+             mpfr_equal_p(result, value);
+    mpfr_clears(result, value, (mpfr_ptr)0);
+    return ok;
+}
+
+int test_variables_sources(void)
+{
+    printf("Testing definition sources...\n");
+
+    EvalContext ctx;
+    eval_context_init(&ctx, 64);
+    VariableTable *table = variables_create();
+    TEST_ASSERT(table, "Table should be created");
+    ctx.variables = table;
+
+    // Literals are read again at the precision of the context reading them
+    TEST_ASSERT(variables_test_define_source(table, "z", "0.1", 64) >= 0, "z should be defined");
+    TEST_ASSERT(variables_test_define_source(table, "w", "z * 3", 64) >= 0, "w should be defined");
+    TEST_ASSERT(!variables_find(table, "w")->source, "Exact literals need no text");
+    TEST_ASSERT(variables_test_value_is_str(&ctx, "z", "0.1"), "z should be 0.1 at 64 bits");
+    eval_context_set_precision(&ctx, 256);
+    TEST_ASSERT(variables_test_value_is_str(&ctx, "z", "0.1"), "z should be 0.1 at 256 bits");
+    TEST_ASSERT(variables_test_value_is_str(&ctx, "w", "0.3"), "Dependents should follow");
+    eval_context_set_precision(&ctx, 64);
+    TEST_ASSERT(variables_test_value_is_str(&ctx, "w", "0.3"), "Lowering should work as well");
+
+    // Copies keep the text, redefinitions drop it
+    VariableTable *copy = variables_copy(table);
+    TEST_ASSERT(copy && variables_find(copy, "z")->source, "Copies should keep the text");
+    variables_destroy(copy);
+    TEST_ASSERT(variables_test_define(table, "z", "1/8") >= 0 &&
+                    !variables_find(table, "z")->source,
+                "Redefinitions should drop the text");
+
+    // Definitions reading undefined names are kept but pending
+    int y = variables_test_define(table, "y", "q + 1");
+    TEST_ASSERT(y >= 0 && variables_pending(table, y) &&
+                    strcmp(variables_pending(table, y), "q") == 0,
+                "A missing name should make a definition pending");
+    int u = variables_test_define(table, "u", "y * 2 + w");
+    TEST_ASSERT(u >= 0 && variables_pending(table, u) &&
+                    strcmp(variables_pending(table, u), "q") == 0,
+                "Missing names should be found through other definitions");
+    TEST_ASSERT(!variables_pending(table, variables_test_define(table, "v", "w + 1")),
+                "Complete definitions are not pending");
+    TEST_ASSERT(variables_test_define(table, "q", "2") >= 0 && !variables_pending(table, u),
+                "Defining the name should complete its dependents");
+    TEST_ASSERT(variables_test_value_is(&ctx, "u", 6.375), "Completed definitions should evaluate");
+
+    variables_destroy(table);
+    eval_context_cleanup(&ctx);
+
+    printf("  ✅ Definition source tests passed\n");
+    return 1;
+}
+
+int test_variables_parsing(void)
+{
+    printf("Testing variable syntax...\n");
+
+    ASTNode *ast = test_parse("2x + foo_bar");
+    TEST_ASSERT(ast && ast->type == NODE_BINOP, "Identifiers should parse");
+    TEST_ASSERT(ast->binop.right->type == NODE_VARIABLE &&
+                    strcmp(ast->binop.right->variable.name, "foo_bar") == 0,
+                "Identifiers should become variable nodes");
+    TEST_ASSERT(ast->binop.left->type == NODE_BINOP &&
+                    ast->binop.left->binop.right->type == NODE_VARIABLE,
+                "Numbers followed by names multiply");
+    ast_free(ast);
+
+    TEST_ASSERT(!test_parse("foo(1)"), "Variables cannot be called");
+
+    static const struct
+    {
+        const char *input;
+        int assignment;
+    } cases[] = {
+        {"x = 1", 1}, {"x=sin(y)", 1}, {"pi = 3", 1}, {"sin = 2", 1},
+        {"x == 1", 0}, {"x + 1", 0},  {"1 = x", 0},  {"", 0},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        Lexer lexer;
+        lexer_init(&lexer, cases[i].input);
+        Parser parser;
+        parser_init(&parser, &lexer);
+        TEST_ASSERT(parser_at_assignment(&parser) == cases[i].assignment,
+                    "Assignments should be recognized");
+        TEST_ASSERT(parser.current_token.offset == 0 || !cases[i].input[0],
+                    "Looking ahead should not consume tokens");
+    }
+
+    printf("  ✅ Variable syntax tests passed\n");
+    return 1;
+}
+
+int run_variables_tests(void)
+{
+    printf("Running Variables Test Suite\n");
+    printf("============================\n\n");
+
+    precision_init();
+
+    int passed = 0;
+    int total = 0;
+
+    total++;
+    if (test_variables_definitions())
+        passed++;
+    total++;
+    if (test_variables_incremental())
+        passed++;
+    total++;
+    if (test_variables_cycles())
+        passed++;
+    total++;
+    if (test_variables_sources())
+        passed++;
+    total++;
+    if (test_variables_parsing())
+        passed++;
+
+    printf("\n============================\n");
+    printf("Variables Tests: %d/%d passed\n", passed, total);
+
+    return (passed == total) ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+// Generator for the perfect hash of src/lexer/function_table.c
+//
+//   function_hash FILE           rewrite the generated part of FILE
+//   function_hash --check FILE   fail if that part is not what the
+//                                names need, or a name does not resolve
+//
+// The names come from the compiled table through function_table_entry(),
+// so the tool links against the library being checked.
+
+#include "function_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FUNCTION_HASH_BEGIN "// BEGIN function hash, generated by make function-hash\n"
+#define FUNCTION_HASH_END "// END function hash\n"
+
+// Largest multiplier tried, and largest table; slots hold a signed char
+#define FUNCTION_HASH_MAX_MULTIPLIER 255
+#define FUNCTION_HASH_MAX_SIZE 1024
+#define FUNCTION_HASH_MAX_NAMES 127
+
+// Must match function_hash() in function_table.c
+static size_t hash(const char *name, size_t length, size_t length_factor, size_t last_factor,
+                   size_t size)
+{
+    const unsigned char *text = (const unsigned char *)name;
+    return (length * length_factor + text[0] + text[length - 1] * last_factor +
+            text[length / 2]) &
+           (size - 1);
+}
+
+// Fill slots for the given multipliers; returns 0 on a collision
+static int fill(const char **names, int count, size_t length_factor, size_t last_factor,
+                size_t size, int *slots)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        slots[i] = -1;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        size_t slot = hash(names[i], strlen(names[i]), length_factor, last_factor, size);
+        if (slots[slot] >= 0)
+        {
+            return 0;
+        }
+        slots[slot] = i;
+    }
+    return 1;
+}
+
+// Find the smallest table, then the smallest multipliers by their sum, with
+// no collisions; returns 0 if there are none
+static int search(const char **names, int count, size_t *size, size_t *length_factor,
+                  size_t *last_factor, int *slots)
+{
+    size_t first = 1;
+    while (first < (size_t)count)
+    {
+        first *= 2;
+    }
+    for (*size = first; *size <= FUNCTION_HASH_MAX_SIZE; *size *= 2)
+    {
+        for (size_t sum = 2; sum <= 2 * FUNCTION_HASH_MAX_MULTIPLIER; sum++)
+        {
+            for (size_t a = 1; a < sum && a <= FUNCTION_HASH_MAX_MULTIPLIER; a++)
+            {
+                size_t b = sum - a;
+                if (b <= FUNCTION_HASH_MAX_MULTIPLIER && fill(names, count, a, b, *size, slots))
+                {
+                    *length_factor = a;
+                    *last_factor = b;
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// The generated part of function_table.c, markers included
+static char *generate(size_t size, size_t length_factor, size_t last_factor, const int *slots)
+{
+    char *text = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&text, &length);
+    if (!out)
+    {
+        return NULL;
+    }
+    fputs(FUNCTION_HASH_BEGIN, out);
+    fprintf(out, "#define FUNCTION_HASH_SIZE %zu\n", size);
+    fprintf(out, "#define FUNCTION_HASH_LENGTH_FACTOR %zu\n", length_factor);
+    fprintf(out, "#define FUNCTION_HASH_LAST_FACTOR %zu\n\n", last_factor);
+    fputs("static const signed char function_slots[FUNCTION_HASH_SIZE] = {\n", out);
+    for (size_t i = 0; i < size; i++)
+    {
+        fprintf(out, "%s%d,%s", i % 16 == 0 ? "    " : "", slots[i],
+                i % 16 == 15 || i + 1 == size ? "\n" : " ");
+    }
+    fputs("};\n", out);
+    fputs(FUNCTION_HASH_END, out);
+    fclose(out);
+    return text;
+}
+
+static char *read_file(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return NULL;
+    }
+    char *text = NULL;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        long length = ftell(file);
+        text = length >= 0 ? malloc((size_t)length + 1) : NULL;
+        rewind(file);
+        if (text && fread(text, 1, (size_t)length, file) == (size_t)length)
+        {
+            text[length] = '\0';
+        }
+        else
+        {
+            free(text);
+            text = NULL;
+        }
+    }
+    fclose(file);
+    return text;
+}
+
+int main(int argc, char **argv)
+{
+    int check = argc == 3 && strcmp(argv[1], "--check") == 0;
+    if (argc != 2 + check)
+    {
+        fprintf(stderr, "Usage: %s [--check] function_table.c\n", argv[0]);
+        return 2;
+    }
+    const char *path = argv[1 + check];
+
+    const char *names[FUNCTION_HASH_MAX_NAMES + 1];
+    int count = 0;
+    for (const FunctionInfo *info; (info = function_table_entry(count)) != NULL; count++)
+    {
+        if (count == FUNCTION_HASH_MAX_NAMES)
+        {
+            fprintf(stderr, "More than %d names do not fit in signed char slots\n",
+                    FUNCTION_HASH_MAX_NAMES);
+            return 1;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (strcmp(names[i], info->name) == 0)
+            {
+                fprintf(stderr, "%s is in the table twice\n", info->name);
+                return 1;
+            }
+        }
+        names[count] = info->name;
+    }
+
+    int slots[FUNCTION_HASH_MAX_SIZE];
+    size_t size, length_factor, last_factor;
+    if (!search(names, count, &size, &length_factor, &last_factor, slots))
+    {
+        fprintf(stderr, "No collision-free multipliers up to %d for %d names\n",
+                FUNCTION_HASH_MAX_MULTIPLIER, count);
+        return 1;
+    }
+
+    char *source = read_file(path);
+    char *begin = source ? strstr(source, FUNCTION_HASH_BEGIN) : NULL;
+    char *end = begin ? strstr(begin, FUNCTION_HASH_END) : NULL;
+    char *generated = generate(size, length_factor, last_factor, slots);
+    if (!end || !generated)
+    {
+        fprintf(stderr, "%s: cannot read the generated part\n", path);
+        return 1;
+    }
+    end += strlen(FUNCTION_HASH_END);
+
+    int status = 0;
+    size_t current = (size_t)(end - begin);
+    if (check)
+    {
+        if (current != strlen(generated) || memcmp(begin, generated, current) != 0)
+        {
+            fprintf(stderr, "%s: the hash table is stale; run make function-hash\n", path);
+            status = 1;
+        }
+        // A stale table or a hash that differs from this one loses names
+        for (int i = 0; i < count; i++)
+        {
+            if (function_table_lookup_length(names[i], strlen(names[i])) !=
+                function_table_entry(i))
+            {
+                fprintf(stderr, "%s: %s does not resolve to its entry\n", path, names[i]);
+                status = 1;
+            }
+        }
+        if (status == 0)
+        {
+            printf("Function hash: %d names in %zu slots, no collisions\n", count, size);
+        }
+    }
+    else
+    {
+        FILE *out = fopen(path, "wb");
+        if (!out || fwrite(source, 1, (size_t)(begin - source), out) != (size_t)(begin - source) ||
+            fputs(generated, out) == EOF || fputs(end, out) == EOF || fclose(out) != 0)
+        {
+            fprintf(stderr, "%s: cannot write\n", path);
+            return 1;
+        }
+        printf("Function hash: %d names in %zu slots, multipliers %zu and %zu\n", count, size,
+               length_factor, last_factor);
+    }
+    free(generated);
+    free(source);
+    return status;
+}